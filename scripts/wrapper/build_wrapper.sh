@@ -286,7 +286,7 @@ install_build_dependencies_if_requested() {
         libxcb-shm0-dev
         libxcb-present-dev
         libxcb-sync-dev
-        libxrandr-dev
+        libxcb-randr0-dev
         wayland-protocols
     )
 
@@ -302,7 +302,7 @@ install_build_dependencies_if_requested() {
         libxcb-shm0-dev:armhf
         libxcb-present-dev:armhf
         libxcb-sync-dev:armhf
-        libxrandr-dev:armhf
+        libxcb-randr0-dev:armhf
     )
 
     echo "Installing wrapper build dependencies via apt-get"
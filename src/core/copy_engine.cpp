@@ -0,0 +1,248 @@
+#include "copy_engine.hpp"
+#include "../utils/logging.hpp"
+#include "../utils/thread_placement.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+constexpr size_t kMaxCopyWorkers = 3;
+constexpr size_t kDefaultParallelThreshold = 4ULL * 1024ULL * 1024ULL;
+constexpr size_t kDefaultChunkSize = 1ULL * 1024ULL * 1024ULL;
+
+size_t read_size_env(const char* name, size_t fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || value[0] == '\0') {
+        return fallback;
+    }
+
+    char* end = nullptr;
+    const unsigned long long parsed = std::strtoull(value, &end, 10);
+    if (end == value) {
+        return fallback;
+    }
+    return static_cast<size_t>(parsed);
+}
+
+size_t get_page_size() {
+    const long value = sysconf(_SC_PAGESIZE);
+    return (value > 0) ? static_cast<size_t>(value) : static_cast<size_t>(4096);
+}
+
+} // namespace
+
+struct CopyEngine::Job {
+    std::vector<Region> chunks;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+CopyEngine& CopyEngine::Instance() {
+    static CopyEngine instance;
+    return instance;
+}
+
+CopyEngine::CopyEngine() {
+    const unsigned int hardware_threads = std::thread::hardware_concurrency();
+    const size_t default_workers = (hardware_threads > 1)
+        ? std::min(kMaxCopyWorkers, static_cast<size_t>(hardware_threads - 1))
+        : 0;
+
+    // MALI_WRAPPER_COPY_THREADS=0 keeps every copy on the calling thread.
+    worker_count_ = std::min(read_size_env("MALI_WRAPPER_COPY_THREADS", default_workers),
+                             static_cast<size_t>(hardware_threads > 0 ? hardware_threads : 1));
+
+    const size_t page_size = get_page_size();
+    chunk_size_ = std::max(page_size, (kDefaultChunkSize / page_size) * page_size);
+    parallel_threshold_ = std::max(chunk_size_ * 2,
+                                   read_size_env("MALI_WRAPPER_COPY_PARALLEL_THRESHOLD",
+                                                 kDefaultParallelThreshold));
+}
+
+CopyEngine::~CopyEngine() {
+    Shutdown();
+}
+
+void CopyEngine::Shutdown() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        workers.swap(workers_);
+    }
+    work_available_.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool CopyEngine::EnsureWorkers() {
+    if (worker_count_ == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return false;
+    }
+    if (workers_started_) {
+        return true;
+    }
+
+    workers_started_ = true;
+    for (size_t i = 0; i < worker_count_; ++i) {
+        try {
+            workers_.emplace_back(&CopyEngine::WorkerMain, this);
+        } catch (const std::system_error& e) {
+            LOG_WARN("Failed to start copy worker: " + std::string(e.what()));
+            break;
+        }
+    }
+
+    LOG_INFO("Copy engine started " + std::to_string(workers_.size()) + " worker(s), parallel threshold " +
+             std::to_string(parallel_threshold_) + " bytes");
+    return !workers_.empty();
+}
+
+void CopyEngine::WorkerMain() {
+    // Leave asynchronous signals to the application threads. Synchronous faults
+    // (e.g. dirty-tracking SIGSEGV on a shadow page) are still delivered here.
+    sigset_t blocked;
+    sigfillset(&blocked);
+    sigdelset(&blocked, SIGSEGV);
+    sigdelset(&blocked, SIGBUS);
+    sigdelset(&blocked, SIGFPE);
+    sigdelset(&blocked, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+    ApplyThreadPlacement(ThreadRole::WORKER, "copy worker");
+
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = jobs_.front();
+        }
+
+        RunJob(job);
+    }
+}
+
+void CopyEngine::RunJob(const std::shared_ptr<Job>& job) {
+    const size_t chunk_count = job->chunks.size();
+    for (;;) {
+        const size_t index = job->next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= chunk_count) {
+            break;
+        }
+
+        const Region& chunk = job->chunks[index];
+        SelectCopyKernel(chunk.memory_type)(chunk.dst, chunk.src, chunk.size);
+
+        if (job->done.fetch_add(1, std::memory_order_acq_rel) + 1 == chunk_count) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.notify_all();
+        }
+    }
+
+    // Every chunk has been claimed; drop the job so idle workers go back to sleep.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) {
+        jobs_.erase(it);
+    }
+}
+
+void CopyEngine::AppendChunks(const Region& region, std::vector<Region>* chunks) const {
+    auto* dst = static_cast<uint8_t*>(region.dst);
+    auto* src = static_cast<const uint8_t*>(region.src);
+    size_t offset = 0;
+    while (offset < region.size) {
+        const size_t size = std::min(chunk_size_, region.size - offset);
+        chunks->push_back(Region{ dst + offset, src + offset, size, region.memory_type });
+        offset += size;
+    }
+}
+
+void CopyEngine::Submit(std::vector<Region> chunks) {
+    auto job = std::make_shared<Job>();
+    job->chunks = std::move(chunks);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    work_available_.notify_all();
+
+    // The caller works on its own job too, so progress never depends on a
+    // worker being available.
+    RunJob(job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() {
+        return job->done.load(std::memory_order_acquire) == job->chunks.size();
+    });
+}
+
+void CopyEngine::Copy(void* dst, const void* src, size_t size, CopyMemoryType memory_type) {
+    if (size == 0) {
+        return;
+    }
+    copied_bytes_.fetch_add(size, std::memory_order_relaxed);
+
+    if (size < parallel_threshold_ || !EnsureWorkers()) {
+        SelectCopyKernel(memory_type)(dst, src, size);
+        return;
+    }
+
+    std::vector<Region> chunks;
+    chunks.reserve((size + chunk_size_ - 1) / chunk_size_);
+    AppendChunks(Region{ dst, src, size, memory_type }, &chunks);
+    Submit(std::move(chunks));
+}
+
+void CopyEngine::CopyBatch(const Region* regions, size_t count) {
+    if (regions == nullptr || count == 0) {
+        return;
+    }
+
+    size_t total_size = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total_size += regions[i].size;
+    }
+    copied_bytes_.fetch_add(total_size, std::memory_order_relaxed);
+
+    if (total_size < parallel_threshold_ || !EnsureWorkers()) {
+        for (size_t i = 0; i < count; ++i) {
+            if (regions[i].size > 0) {
+                SelectCopyKernel(regions[i].memory_type)(regions[i].dst, regions[i].src, regions[i].size);
+            }
+        }
+        return;
+    }
+
+    std::vector<Region> chunks;
+    for (size_t i = 0; i < count; ++i) {
+        AppendChunks(regions[i], &chunks);
+    }
+    Submit(std::move(chunks));
+}
+
+} // namespace mali_wrapper
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "copy_kernels.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mali_wrapper {
+
+// Small persistent worker pool for large low-address shadow synchronisations.
+// Copies below the parallel threshold run inline on the calling thread; bigger
+// ones are cut into page-aligned chunks that the caller and the workers drain
+// together, each with the kernel picked for its memory type. Copy() and
+// CopyBatch() return only once every byte has landed.
+class CopyEngine {
+public:
+    struct Region {
+        void* dst;
+        const void* src;
+        size_t size;
+        CopyMemoryType memory_type = CopyMemoryType::CACHED;
+    };
+
+    static CopyEngine& Instance();
+
+    void Copy(void* dst, const void* src, size_t size, CopyMemoryType memory_type = CopyMemoryType::CACHED);
+    void CopyBatch(const Region* regions, size_t count);
+    void Shutdown();
+
+    size_t GetWorkerCount() const { return worker_count_; }
+    size_t GetParallelThreshold() const { return parallel_threshold_; }
+    // Bytes passed to Copy() and CopyBatch() so far, for rate displays.
+    uint64_t GetCopiedBytes() const { return copied_bytes_.load(std::memory_order_relaxed); }
+
+private:
+    struct Job;
+
+    CopyEngine();
+    ~CopyEngine();
+    CopyEngine(const CopyEngine&) = delete;
+    CopyEngine& operator=(const CopyEngine&) = delete;
+
+    bool EnsureWorkers();
+    void WorkerMain();
+    void RunJob(const std::shared_ptr<Job>& job);
+    void Submit(std::vector<Region> chunks);
+    void AppendChunks(const Region& region, std::vector<Region>* chunks) const;
+
+    size_t worker_count_ = 0;
+    size_t parallel_threshold_ = 0;
+    size_t chunk_size_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> workers_;
+    bool workers_started_ = false;
+    bool stopping_ = false;
+    std::atomic<uint64_t> copied_bytes_{0};
+};
+
+} // namespace mali_wrapper
@@ -0,0 +1,156 @@
+#include "copy_kernels.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#if defined(__ARM_NEON) && !defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace mali_wrapper {
+
+namespace {
+
+enum class CopyKernelOverride {
+    AUTO = 0,
+    LIBC = 1,
+    NEON = 2,
+};
+
+void libc_copy(void* dst, const void* src, size_t size) {
+    std::memcpy(dst, src, size);
+}
+
+#if defined(__aarch64__)
+
+// Streaming copy for write-combined / uncached mappings: 128-byte blocks of
+// non-temporal pair loads and stores, so neither side pollutes the caches and
+// the WC buffer always sees full-line bursts.
+void neon_stream_copy(void* dst, const void* src, size_t size) {
+    auto* d = static_cast<uint8_t*>(dst);
+    auto* s = static_cast<const uint8_t*>(src);
+
+    const size_t head = std::min<size_t>(size, (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15);
+    if (head > 0) {
+        std::memcpy(d, s, head);
+        d += head;
+        s += head;
+        size -= head;
+    }
+
+    while (size >= 128) {
+        __asm__ volatile(
+            "prfm pldl1strm, [%[s], #512]\n"
+            "ldnp q0, q1, [%[s]]\n"
+            "ldnp q2, q3, [%[s], #32]\n"
+            "ldnp q4, q5, [%[s], #64]\n"
+            "ldnp q6, q7, [%[s], #96]\n"
+            "stnp q0, q1, [%[d]]\n"
+            "stnp q2, q3, [%[d], #32]\n"
+            "stnp q4, q5, [%[d], #64]\n"
+            "stnp q6, q7, [%[d], #96]\n"
+            :
+            : [s] "r"(s), [d] "r"(d)
+            : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "memory");
+        d += 128;
+        s += 128;
+        size -= 128;
+    }
+
+    if (size > 0) {
+        std::memcpy(d, s, size);
+    }
+}
+
+constexpr bool kHasNeonStreamCopy = true;
+
+#elif defined(__ARM_NEON)
+
+// ARMv7 has no non-temporal hints; 64-byte NEON blocks with a far prefetch
+// still beat byte-granular memcpy tails on uncached source memory.
+void neon_stream_copy(void* dst, const void* src, size_t size) {
+    auto* d = static_cast<uint8_t*>(dst);
+    auto* s = static_cast<const uint8_t*>(src);
+
+    while (size >= 64) {
+        __builtin_prefetch(s + 256);
+        const uint8x16_t v0 = vld1q_u8(s);
+        const uint8x16_t v1 = vld1q_u8(s + 16);
+        const uint8x16_t v2 = vld1q_u8(s + 32);
+        const uint8x16_t v3 = vld1q_u8(s + 48);
+        vst1q_u8(d, v0);
+        vst1q_u8(d + 16, v1);
+        vst1q_u8(d + 32, v2);
+        vst1q_u8(d + 48, v3);
+        d += 64;
+        s += 64;
+        size -= 64;
+    }
+
+    if (size > 0) {
+        std::memcpy(d, s, size);
+    }
+}
+
+constexpr bool kHasNeonStreamCopy = true;
+
+#else
+
+void neon_stream_copy(void* dst, const void* src, size_t size) {
+    std::memcpy(dst, src, size);
+}
+
+constexpr bool kHasNeonStreamCopy = false;
+
+#endif
+
+CopyKernelOverride get_copy_kernel_override() {
+    static const CopyKernelOverride cached = []() {
+        const char* value = std::getenv("MALI_WRAPPER_COPY_KERNEL");
+        if (value == nullptr || value[0] == '\0' || strcasecmp(value, "auto") == 0) {
+            return CopyKernelOverride::AUTO;
+        }
+        if (strcasecmp(value, "libc") == 0 || strcasecmp(value, "memcpy") == 0) {
+            return CopyKernelOverride::LIBC;
+        }
+        if (strcasecmp(value, "neon") == 0) {
+            return CopyKernelOverride::NEON;
+        }
+        return CopyKernelOverride::AUTO;
+    }();
+    return cached;
+}
+
+bool use_stream_kernel(CopyMemoryType type) {
+    if (!kHasNeonStreamCopy) {
+        return false;
+    }
+
+    switch (get_copy_kernel_override()) {
+        case CopyKernelOverride::LIBC:
+            return false;
+        case CopyKernelOverride::NEON:
+            return true;
+        case CopyKernelOverride::AUTO:
+        default:
+            return type != CopyMemoryType::CACHED;
+    }
+}
+
+} // namespace
+
+CopyKernelFn SelectCopyKernel(CopyMemoryType type) {
+    return use_stream_kernel(type) ? neon_stream_copy : libc_copy;
+}
+
+const char* GetCopyKernelName(CopyMemoryType type) {
+    return use_stream_kernel(type) ? "neon-stream" : "libc";
+}
+
+CopyKernelFn GetStreamCopyKernel() {
+    return kHasNeonStreamCopy ? neon_stream_copy : nullptr;
+}
+
+} // namespace mali_wrapper
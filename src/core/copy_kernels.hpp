@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+namespace mali_wrapper {
+
+// How the CPU sees the non-shadow side of a low-address copy.
+enum class CopyMemoryType {
+    CACHED = 0,    // HOST_CACHED; plain memcpy is already optimal
+    COHERENT = 1,  // HOST_COHERENT without HOST_CACHED, write-combined on Mali
+    UNCACHED = 2,  // neither cached nor coherent
+};
+
+using CopyKernelFn = void (*)(void* dst, const void* src, size_t size);
+
+// Returns the copy routine for the memory type. MALI_WRAPPER_COPY_KERNEL=libc
+// forces memcpy everywhere and =neon forces the streaming kernel; the default
+// uses the streaming kernel only for memory that is not HOST_CACHED.
+CopyKernelFn SelectCopyKernel(CopyMemoryType type);
+const char* GetCopyKernelName(CopyMemoryType type);
+// The streaming kernel regardless of the override, or nullptr when this build
+// has none; lets the bench compare it with memcpy.
+CopyKernelFn GetStreamCopyKernel();
+
+} // namespace mali_wrapper
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+
+namespace mali_wrapper {
+namespace harness {
+
+// Entry points into the low-address engine for the offline tools
+// (mali_wrapper_bench). They exist only in builds with MALI_WRAPPER_HARNESS=1,
+// which compile the wrapper sources into a static library for those tools;
+// the ICD itself never has them.
+//
+// Devices registered here have no driver behind them: the caller supplies the
+// "real" mapping of every allocation, either from the Mali driver or from
+// plain high memory, and the engine treats it as the driver's pointer.
+
+// Registers a driver-less dispatch for device, as vkCreateDevice would, and
+// probes the kbase low32 alias ioctl for it. Returns whether the probe passed.
+bool RegisterDevice(VkDevice device);
+void UnregisterDevice(VkDevice device);
+
+// Pins the device to shadow copies (false) or back to the alias path (true,
+// only honoured when the probe passed).
+void SetAliasEnabled(VkDevice device, bool enabled);
+
+// Records an allocation as vkAllocateMemory does, so a VK_WHOLE_SIZE map can
+// resolve its size and the copy kernel follows its property flags.
+void TrackAllocation(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, VkMemoryPropertyFlags flags);
+// vkFreeMemory's cleanup: drops the live and parked views of the allocation.
+void FreeMemory(VkDevice device, VkDeviceMemory memory);
+
+// maybe_apply_low_address_mapping() on real_ptr; returns the pointer the
+// application would see.
+void* MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, void* real_ptr);
+// vkUnmapMemory's write-back and release (or parking) of the view.
+void UnmapMemory(VkDevice device, VkDeviceMemory memory);
+// sync_shadow_to_real() and sync_real_to_shadow(), as vkFlushMappedMemoryRanges
+// and vkInvalidateMappedMemoryRanges run them.
+void FlushRanges(VkDevice device, uint32_t range_count, const VkMappedMemoryRange* ranges);
+void InvalidateRanges(VkDevice device, uint32_t range_count, const VkMappedMemoryRange* ranges);
+// Submit-time shadow write-back for every shadow of the device.
+void SyncForSubmit(VkDevice device);
+
+// Makes queue resolve to device on the submit path, as the wsi private data
+// does for queues fetched through vkGetDeviceQueue.
+void RegisterQueue(VkQueue queue, VkDevice device);
+void UnregisterQueue(VkQueue queue);
+// The submit path's lookup of the driver's vkQueueSubmit through
+// get_queue_dispatch(), and the per-submit lookup it replaced
+// (get_queue_parent_device_safe() plus get_mali_device_proc()). Harness
+// devices have no driver, so both return nullptr; out_device tells whether
+// the queue resolved.
+PFN_vkQueueSubmit LookupQueueSubmit(VkQueue queue, VkDevice* out_device);
+PFN_vkQueueSubmit LookupQueueSubmitUncached(VkQueue queue, VkDevice* out_device);
+
+// allocate_low_address_shadow() and its release; nullptr on failure.
+void* AllocateShadow(size_t size, size_t* out_size);
+void ReleaseShadow(void* ptr, size_t size);
+// try_create_low_address_alias() with the device's kbase fds, and its release.
+void* CreateAlias(VkDevice device, const void* real_ptr, size_t size, size_t* out_unmap_size);
+void ReleaseAlias(void* ptr, size_t unmap_size);
+
+// Copy paths of the X11 SHM presenter (src/wsi/x11/shm_presenter.cpp), in
+// builds with BUILD_WSI_X11. MEMCPY_BANDS and THREADED split the frame across
+// the presenter's copy pool, as do LUT frames; SIMD and SCALAR copy it on the
+// calling thread with the row kernels.
+enum class ShmCopyPath {
+    MEMCPY_BANDS = 0,
+    THREADED,
+    SIMD,
+    SCALAR,
+    LUT,
+};
+
+// Copies one frame of 32-bit pixels: src rows are src_stride_pixels apart,
+// dst is dst_width wide and tightly packed. Only LUT scales src_width to
+// dst_width; MEMCPY_BANDS also needs unpadded source rows. Returns false when
+// the path does not apply or this build lacks it (SIMD without NEON).
+bool ShmCopyFrame(ShmCopyPath path, const uint32_t* src, uint32_t src_width, uint32_t src_stride_pixels,
+                  uint32_t* dst, uint32_t dst_width, uint32_t height);
+// Threads a pooled copy is split across, the calling thread included; set by
+// WSI_SHM_COPY_THREADS before the first copy.
+uint32_t ShmCopyThreadCount();
+
+} // namespace harness
+} // namespace mali_wrapper
@@ -1,6 +1,7 @@
 #include "library_loader.hpp"
 #include "config.hpp"
 #include "../utils/logging.hpp"
+#include "../utils/startup_profile.hpp"
 #include <dlfcn.h>
 #include <string>
 #include <vulkan/vk_layer.h>
@@ -53,6 +54,7 @@ bool LibraryLoader::LoadMaliDriver(const std::string& path) {
         return false;
     }
 
+    StartupPhaseScope symbols_scope(StartupPhase::SYMBOL_RESOLUTION);
     mali_get_instance_proc_addr_ = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
         GetSymbol(mali_handle_, "vk_icdGetInstanceProcAddr"));
     if (!mali_get_instance_proc_addr_) {
@@ -73,6 +75,7 @@ bool LibraryLoader::LoadMaliDriver(const std::string& path) {
 
 
 void* LibraryLoader::LoadLibrary(const std::string& path) {
+    StartupPhaseScope scope(StartupPhase::DLOPEN);
     void* handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_LOCAL);
     if (!handle) {
         LOG_ERROR("dlopen failed: " + std::string(dlerror()));
@@ -1,15 +1,28 @@
 #include "mali_wrapper_icd.hpp"
 #include "library_loader.hpp"
+#include "copy_engine.hpp"
+#include "memory_recorder.hpp"
+#include "metrics_page.hpp"
+#include "pipeline_cache_store.hpp"
+#include "pipeline_compile_pool.hpp"
+#include "proc_table.hpp"
+#include "submit_references.hpp"
 #include "wsi_manager.hpp"
 #include "wsi/wsi_private_data.hpp"
 #include "wsi/wsi_factory.hpp"
 #include "wsi/layer_utils/extension_list.hpp"
+#if MALI_WRAPPER_HARNESS
+#include "harness.hpp"
+#endif
 #include <vulkan/vk_icd.h>
 #include "config.hpp"
 #include "../utils/logging.hpp"
+#include "../utils/trace.hpp"
+#include "../utils/startup_profile.hpp"
 #include <cstring>
 #include <unordered_set>
 #include <unordered_map>
+#include <map>
 #include <cstdlib>
 #include <vector>
 #include <algorithm>
@@ -32,6 +45,7 @@
 #include <cerrno>
 #include <fcntl.h>
 #include <dirent.h>
+#include <strings.h>
 #include <execinfo.h>
 #include <signal.h>
 #include <setjmp.h>
@@ -62,22 +76,75 @@ struct kbase_ioctl_mem_low32_alias_create {
 #define KBASE_IOCTL_MEM_FREE _IOW(KBASE_IOCTL_TYPE, 7, struct kbase_ioctl_mem_free)
 #endif
 
+struct kbase_ioctl_mem_low32_alias_create_batch {
+    uint64_t entries;
+    uint32_t count;
+    uint32_t created;
+};
+
+struct kbase_ioctl_context_low32_mmap {
+    uint32_t enable;
+    uint32_t padding;
+};
+
 #ifndef KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE
 #define KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE \
     _IOWR(KBASE_IOCTL_EXTRA_TYPE, 0, struct kbase_ioctl_mem_low32_alias_create)
 #endif
 
+#ifndef KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE_BATCH
+#define KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE_BATCH \
+    _IOWR(KBASE_IOCTL_EXTRA_TYPE, 1, struct kbase_ioctl_mem_low32_alias_create_batch)
+#endif
+
+#ifndef KBASE_IOCTL_CONTEXT_LOW32_MMAP
+#define KBASE_IOCTL_CONTEXT_LOW32_MMAP \
+    _IOW(KBASE_IOCTL_EXTRA_TYPE, 2, struct kbase_ioctl_context_low32_mmap)
+#endif
+
+#ifndef KBASE_MEM_LOW32_ALIAS_BATCH_MAX
+#define KBASE_MEM_LOW32_ALIAS_BATCH_MAX 16
+#endif
+
 namespace mali_wrapper {
 
+// The vkCreateInstance parameters an instance parked by vkDestroyInstance
+// must have been created with to be handed back for a later create.
+struct InstanceCreateKey {
+    VkInstanceCreateFlags flags = 0;
+    bool has_application_info = false;
+    uint32_t api_version = 0;
+    uint32_t application_version = 0;
+    uint32_t engine_version = 0;
+    std::string application_name;
+    std::string engine_name;
+    std::vector<std::string> layers;
+    // As recorded for the WSI layer, wrapper-only ones included, sorted.
+    std::vector<std::string> extensions;
+
+    bool operator==(const InstanceCreateKey& other) const {
+        return flags == other.flags && has_application_info == other.has_application_info &&
+               api_version == other.api_version && application_version == other.application_version &&
+               engine_version == other.engine_version && application_name == other.application_name &&
+               engine_name == other.engine_name && layers == other.layers && extensions == other.extensions;
+    }
+};
+
 struct InstanceInfo {
     VkInstance instance;
     int ref_count;
     std::chrono::steady_clock::time_point destroy_time;
     bool marked_for_destruction;
+    // Set when the instance may be parked for reuse once destroyed.
+    std::unique_ptr<InstanceCreateKey> create_key;
 
     InstanceInfo(VkInstance inst) : instance(inst), ref_count(1), marked_for_destruction(false) {}
 };
 
+struct DeviceLowAddressMappingIndex;
+struct MaliDeviceFdCache;
+struct EagerAliasQueue;
+
 struct ManagedDeviceDispatch {
     VkDevice device = VK_NULL_HANDLE;
     VkInstance parent_instance = VK_NULL_HANDLE;
@@ -98,67 +165,29 @@ struct ManagedDeviceDispatch {
     PFN_vkQueueSubmit2KHR queue_submit2_khr = nullptr;
     PFN_vkCreateImage create_image = nullptr;
     PFN_vkCreateGraphicsPipelines create_graphics_pipelines = nullptr;
-
-    PFN_vkVoidFunction resolve_known_proc(const char* proc_name) const
-    {
-        if (proc_name == nullptr) {
-            return nullptr;
-        }
-
-        if (strcmp(proc_name, "vkGetDeviceProcAddr") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(get_device_proc_addr);
-        }
-        if (strcmp(proc_name, "vkDestroyDevice") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(destroy_device);
-        }
-        if (strcmp(proc_name, "vkAllocateMemory") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(allocate_memory);
-        }
-        if (strcmp(proc_name, "vkFreeMemory") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(free_memory);
-        }
-        if (strcmp(proc_name, "vkMapMemory") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(map_memory);
-        }
-        if (strcmp(proc_name, "vkUnmapMemory") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(unmap_memory);
-        }
-        if (strcmp(proc_name, "vkFlushMappedMemoryRanges") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(flush_mapped_memory_ranges);
-        }
-        if (strcmp(proc_name, "vkInvalidateMappedMemoryRanges") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(invalidate_mapped_memory_ranges);
-        }
-        if (strcmp(proc_name, "vkMapMemory2KHR") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(map_memory2_khr);
-        }
-        if (strcmp(proc_name, "vkMapMemory2") == 0) {
-            return map_memory2;
-        }
-        if (strcmp(proc_name, "vkUnmapMemory2KHR") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(unmap_memory2_khr);
-        }
-        if (strcmp(proc_name, "vkUnmapMemory2") == 0) {
-            return unmap_memory2;
-        }
-        if (strcmp(proc_name, "vkQueueSubmit") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(queue_submit);
-        }
-        if (strcmp(proc_name, "vkQueueSubmit2") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(queue_submit2);
-        }
-        if (strcmp(proc_name, "vkQueueSubmit2KHR") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(queue_submit2_khr);
-        }
-        if (strcmp(proc_name, "vkCreateImage") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(create_image);
-        }
-        if (strcmp(proc_name, "vkCreateGraphicsPipelines") == 0) {
-            return reinterpret_cast<PFN_vkVoidFunction>(create_graphics_pipelines);
-        }
-
-        return nullptr;
-    }
+    PFN_vkCreateComputePipelines create_compute_pipelines = nullptr;
+    PFN_vkCreatePipelineCache create_pipeline_cache = nullptr;
+    PFN_vkDestroyPipelineCache destroy_pipeline_cache = nullptr;
+    PFN_vkGetDeviceQueue get_device_queue = nullptr;
+    PFN_vkGetDeviceQueue2 get_device_queue2 = nullptr;
+    // Substituted for VK_NULL_HANDLE pipeline caches; see MALI_WRAPPER_PIPELINE_CACHE.
+    std::shared_ptr<PersistentPipelineCache> pipeline_cache;
+    std::shared_ptr<DeviceLowAddressMappingIndex> low_address_mapping_index;
+    std::shared_ptr<MaliDeviceFdCache> mali_fd_cache;
+    std::shared_ptr<EagerAliasQueue> eager_alias_queue;
+    // Narrows submit-time shadow sync to the memory the submitted command
+    // buffers reference; see should_sync_referenced_shadows_only().
+    std::shared_ptr<SubmitReferenceTracker> reference_tracker;
+    uint32_t memory_type_count = 0;
+    std::array<VkMemoryPropertyFlags, VK_MAX_MEMORY_TYPES> memory_type_flags{};
+    // VK_EXT_map_memory_placed was enabled by the application and is
+    // implemented here rather than by the driver.
+    bool wrapper_map_memory_placed = false;
+    // Memory and submit entry points resolve straight to the driver; see
+    // should_dispatch_memory_directly().
+    bool direct_memory_dispatch = false;
+
+    PFN_vkVoidFunction resolve_known_proc(const char* proc_name) const;
 
     PFN_vkVoidFunction resolve_proc(const char* proc_name) const
     {
@@ -174,6 +203,46 @@ struct ManagedDeviceDispatch {
     }
 };
 
+template <auto Member>
+static PFN_vkVoidFunction managed_dispatch_proc(const ManagedDeviceDispatch& dispatch)
+{
+    return reinterpret_cast<PFN_vkVoidFunction>(dispatch.*Member);
+}
+
+using ManagedDispatchProc = PFN_vkVoidFunction (*)(const ManagedDeviceDispatch&);
+
+static constexpr std::array<ProcTableEntry<ManagedDispatchProc>, 22> managed_dispatch_procs = {{
+    { "vkAllocateMemory", managed_dispatch_proc<&ManagedDeviceDispatch::allocate_memory> },
+    { "vkCreateComputePipelines", managed_dispatch_proc<&ManagedDeviceDispatch::create_compute_pipelines> },
+    { "vkCreateGraphicsPipelines", managed_dispatch_proc<&ManagedDeviceDispatch::create_graphics_pipelines> },
+    { "vkCreateImage", managed_dispatch_proc<&ManagedDeviceDispatch::create_image> },
+    { "vkCreatePipelineCache", managed_dispatch_proc<&ManagedDeviceDispatch::create_pipeline_cache> },
+    { "vkDestroyDevice", managed_dispatch_proc<&ManagedDeviceDispatch::destroy_device> },
+    { "vkDestroyPipelineCache", managed_dispatch_proc<&ManagedDeviceDispatch::destroy_pipeline_cache> },
+    { "vkFlushMappedMemoryRanges", managed_dispatch_proc<&ManagedDeviceDispatch::flush_mapped_memory_ranges> },
+    { "vkFreeMemory", managed_dispatch_proc<&ManagedDeviceDispatch::free_memory> },
+    { "vkGetDeviceProcAddr", managed_dispatch_proc<&ManagedDeviceDispatch::get_device_proc_addr> },
+    { "vkGetDeviceQueue", managed_dispatch_proc<&ManagedDeviceDispatch::get_device_queue> },
+    { "vkGetDeviceQueue2", managed_dispatch_proc<&ManagedDeviceDispatch::get_device_queue2> },
+    { "vkInvalidateMappedMemoryRanges", managed_dispatch_proc<&ManagedDeviceDispatch::invalidate_mapped_memory_ranges> },
+    { "vkMapMemory", managed_dispatch_proc<&ManagedDeviceDispatch::map_memory> },
+    { "vkMapMemory2", managed_dispatch_proc<&ManagedDeviceDispatch::map_memory2> },
+    { "vkMapMemory2KHR", managed_dispatch_proc<&ManagedDeviceDispatch::map_memory2_khr> },
+    { "vkQueueSubmit", managed_dispatch_proc<&ManagedDeviceDispatch::queue_submit> },
+    { "vkQueueSubmit2", managed_dispatch_proc<&ManagedDeviceDispatch::queue_submit2> },
+    { "vkQueueSubmit2KHR", managed_dispatch_proc<&ManagedDeviceDispatch::queue_submit2_khr> },
+    { "vkUnmapMemory", managed_dispatch_proc<&ManagedDeviceDispatch::unmap_memory> },
+    { "vkUnmapMemory2", managed_dispatch_proc<&ManagedDeviceDispatch::unmap_memory2> },
+    { "vkUnmapMemory2KHR", managed_dispatch_proc<&ManagedDeviceDispatch::unmap_memory2_khr> },
+}};
+static_assert(IsProcTableSorted(managed_dispatch_procs), "managed_dispatch_procs must stay sorted");
+
+PFN_vkVoidFunction ManagedDeviceDispatch::resolve_known_proc(const char* proc_name) const
+{
+    const auto* entry = FindProcTableEntry(managed_dispatch_procs, proc_name);
+    return entry != nullptr ? entry->value(*this) : nullptr;
+}
+
 static std::unordered_map<VkInstance, std::unique_ptr<InstanceInfo>> managed_instances;
 static std::unordered_map<VkDevice, std::shared_ptr<const ManagedDeviceDispatch>> managed_devices;
 static std::mutex instance_mutex;
@@ -203,6 +272,72 @@ enum class LowAddressMapMode {
     ALIAS = 1,
 };
 
+// Write tracking state for a SHADOW mapping. Shadow pages are kept read-only
+// between syncs; the first write to a page faults, marks it dirty and makes it
+// writable again, so submit-time sync only has to copy pages written since the
+// previous sync.
+struct ShadowDirtyTracker {
+    int slot = -1;
+    uintptr_t base = 0;
+    size_t page_count = 0;
+    size_t word_count = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> dirty_bits;
+    // Pages given back to the kernel under the shadow budget. They are
+    // PROT_NONE and refilled from the real mapping on their next access.
+    std::unique_ptr<std::atomic<uint64_t>[]> evicted_bits;
+    // Submit sync runs under a shared tracking lock; this keeps a second
+    // submitter from returning before pages claimed by the first are copied.
+    std::mutex sync_mutex;
+};
+
+// Atomic that ShadowMappingInfo can still be copied with. Concurrent submits
+// read and update it under the shared tracking lock.
+struct ShadowSyncStamp {
+    std::atomic<uint64_t> value{0};
+
+    ShadowSyncStamp() = default;
+    ShadowSyncStamp(const ShadowSyncStamp& other) : value(other.value.load(std::memory_order_relaxed)) {}
+    ShadowSyncStamp& operator=(const ShadowSyncStamp& other)
+    {
+        value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+};
+
+// Adaptive sync decides once per window of submit write-backs. A tracked
+// shadow whose submits find at least kAdaptiveFullCopyDensityPercent of its
+// pages dirty is cheaper to copy whole than to fault on; a FULL_COPY shadow
+// tries tracking again after retry_syncs submits, sooner when the
+// application's flushes cover only part of it.
+static constexpr uint64_t kAdaptiveWindowSyncs = 32;
+static constexpr uint64_t kAdaptiveFullCopyDensityPercent = 50;
+static constexpr uint64_t kAdaptiveRetrySyncs = 128;
+static constexpr uint64_t kAdaptiveMaxRetrySyncs = 8192;
+
+// How submits write a shadow back under MALI_WRAPPER_LOW_ADDRESS_MAP=1,adaptive:
+// page runs the dirty tracker saw written, or the whole mapping.
+enum class LowAddressShadowStrategy : uint8_t {
+    TRACKED = 0,
+    FULL_COPY = 1,
+};
+
+// Write-back history of one allocation, kept with its TrackedAllocation so it
+// outlives unmaps. Submit and flush syncs fill the window; when it closes the
+// allocation may switch strategy, and the device's next submit converts the
+// live shadow. Updated concurrently by submits under the shared tracking lock.
+struct LowAddressAdaptiveProfile {
+    std::atomic<LowAddressShadowStrategy> strategy{LowAddressShadowStrategy::TRACKED};
+    std::atomic<uint64_t> window_syncs{0};
+    std::atomic<uint64_t> window_pages{0};
+    std::atomic<uint64_t> window_flush_bytes{0};
+    // Submits a FULL_COPY shadow waits before trying tracking again; doubled
+    // each time a trial goes back to FULL_COPY.
+    std::atomic<uint64_t> retry_syncs{kAdaptiveRetrySyncs};
+    // Set while tracking is on trial after a FULL_COPY phase.
+    std::atomic<bool> tracked_trial{false};
+    std::atomic<uint32_t> migrations{0};
+};
+
 struct ShadowMappingInfo {
     void* real_ptr = nullptr;
     void* shadow_ptr = nullptr;
@@ -213,12 +348,94 @@ struct ShadowMappingInfo {
     void* unmap_ptr = nullptr;
     size_t unmap_size = 0;
     int mali_fd = -1;
+    VkMemoryPropertyFlags memory_flags = 0;
+    // Placed mappings sit at an address chosen by the application
+    // (VK_EXT_map_memory_placed); they are never parked or returned to the
+    // arena. reserve_on_release leaves a PROT_NONE reservation behind
+    // (VK_MEMORY_UNMAP_RESERVE_BIT_EXT).
+    bool placed = false;
+    bool reserve_on_release = false;
+    // Alias created at vkAllocateMemory time from a temporary driver mapping;
+    // it can back any later whole-allocation map, whatever pointer the driver
+    // returns then.
+    bool eager = false;
+    std::shared_ptr<ShadowDirtyTracker> dirty_tracker;
+    // Tracker of a shadow that adaptive sync moved to FULL_COPY. Its region
+    // stays registered until the device's next migration pass, so a write
+    // that faulted just before the shadow was unprotected is still handled.
+    std::shared_ptr<ShadowDirtyTracker> retired_dirty_tracker;
+    std::shared_ptr<LowAddressAdaptiveProfile> adaptive_profile;
+    std::shared_ptr<DeviceLowAddressMappingIndex> device_index;
+    size_t device_index_slot = std::numeric_limits<size_t>::max();
+    // What the shadow looked like at its last submit write-back; 0 until the
+    // first one. See shadow_submit_sync_stamp().
+    ShadowSyncStamp submit_sync_stamp;
+};
+
+struct DeviceLowAddressMappingEntry {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    ShadowMappingInfo* mapping = nullptr;
+};
+
+// Dense per-device lists of the low-address mappings owned by one VkDevice,
+// split by mode so submit-time sync walks only that device's SHADOW mappings.
+// Entries point into shadow_mappings nodes, which unordered_map keeps stable.
+struct DeviceLowAddressMappingIndex {
+    std::vector<DeviceLowAddressMappingEntry> shadow_entries;
+    std::vector<DeviceLowAddressMappingEntry> alias_entries;
+    // Set when an adaptive profile of one of the device's shadows changed
+    // strategy, or a retired tracker is left to unregister.
+    std::atomic<bool> adaptive_migration_pending{false};
+
+    std::vector<DeviceLowAddressMappingEntry>& entries_for(LowAddressMapMode mode)
+    {
+        return (mode == LowAddressMapMode::SHADOW) ? shadow_entries : alias_entries;
+    }
+};
+
+enum class LowAddressAliasSupport : uint8_t {
+    UNKNOWN = 0,
+    SUPPORTED = 1,
+    UNSUPPORTED = 2,
+};
+
+// /dev/mali0 fds found for a device by the alias path. The list is only
+// rebuilt when an fd stops answering kbase ioctls, and preferred_fd is the
+// fd the last successful alias was created on. alias_support is probed once
+// at device creation; UNSUPPORTED sends every map straight to the shadow path.
+// alias_batch_supported is set when the kernel also has the batched ioctl,
+// and low32_placement when it places the device's mappings below 4 GiB.
+struct MaliDeviceFdCache {
+    std::mutex mutex;
+    std::vector<int> fds;
+    int preferred_fd = -1;
+    std::atomic<LowAddressAliasSupport> alias_support{LowAddressAliasSupport::UNKNOWN};
+    std::atomic<bool> alias_batch_supported{false};
+    std::atomic<bool> low32_placement{false};
+};
+
+struct PendingEagerAlias {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    VkMemoryPropertyFlags memory_flags = 0;
+};
+
+// HOST_VISIBLE allocations whose eager alias is deferred so that up to
+// KBASE_MEM_LOW32_ALIAS_BATCH_MAX of them share one batched alias ioctl. An
+// allocation is flushed early when the application maps it and dropped when
+// it is freed first. pending_count lets map and free skip the mutex while the
+// queue is empty.
+struct EagerAliasQueue {
+    std::mutex mutex;
+    std::vector<PendingEagerAlias> pending;
+    std::atomic<size_t> pending_count{0};
 };
 
 enum class ShadowAllocationMethod {
     NONE = 0,
     MAP_32BIT = 1,
     FIXED_SEARCH = 2,
+    ARENA = 3,
 };
 
 enum class LowAddressCopyKind {
@@ -238,7 +455,11 @@ struct ShadowAllocationResult {
     uint64_t elapsed_ns = 0;
 };
 
-struct LowAddressMapStats {
+static constexpr size_t kLowAddressMapStatsShardCount = 16;
+
+// Event counters, bumped on every map, copy and flush. Each thread adds into
+// its own cache-line aligned shard; readers sum every shard.
+struct alignas(64) LowAddressMapCounterShard {
     std::atomic<uint64_t> successful_maps{0};
     std::atomic<uint64_t> compatible_maps{0};
     std::atomic<uint64_t> high_pointer_maps{0};
@@ -250,10 +471,6 @@ struct LowAddressMapStats {
     std::atomic<uint64_t> map32bit_allocations{0};
     std::atomic<uint64_t> fixed_search_allocations{0};
     std::atomic<uint64_t> fixed_search_attempts{0};
-    std::atomic<uint64_t> active_shadow_maps{0};
-    std::atomic<uint64_t> peak_shadow_maps{0};
-    std::atomic<uint64_t> active_shadow_bytes{0};
-    std::atomic<uint64_t> peak_shadow_bytes{0};
     std::atomic<uint64_t> total_shadow_bytes_reserved{0};
     std::atomic<uint64_t> initial_copy_bytes{0};
     std::atomic<uint64_t> flush_copy_bytes{0};
@@ -262,6 +479,74 @@ struct LowAddressMapStats {
     std::atomic<uint64_t> unmap_copy_bytes{0};
     std::atomic<uint64_t> allocation_time_ns{0};
     std::atomic<uint64_t> copy_time_ns{0};
+    std::atomic<uint64_t> dirty_tracked_maps{0};
+    std::atomic<uint64_t> dirty_tracking_failures{0};
+    std::atomic<uint64_t> dirty_write_faults{0};
+    std::atomic<uint64_t> submit_dirty_pages{0};
+    std::atomic<uint64_t> submit_clean_bytes_skipped{0};
+    std::atomic<uint64_t> submit_noncoherent_skips{0};
+    std::atomic<uint64_t> submit_unreferenced_skips{0};
+    std::atomic<uint64_t> submit_epoch_skips{0};
+    std::atomic<uint64_t> alias_fd_scans{0};
+    std::atomic<uint64_t> alias_batch_ioctls{0};
+    std::atomic<uint64_t> mapping_cache_hits{0};
+    std::atomic<uint64_t> mapping_cache_misses{0};
+    std::atomic<uint64_t> mapping_cache_evictions{0};
+    std::atomic<uint64_t> eager_aliases{0};
+    std::atomic<uint64_t> eager_alias_failures{0};
+    std::atomic<uint64_t> arena_allocations{0};
+    std::atomic<uint64_t> arena_chunks_reserved{0};
+    std::atomic<uint64_t> arena_chunks_released{0};
+    std::atomic<uint64_t> arena_reserved_bytes{0};
+    std::atomic<uint64_t> tracking_lock_acquisitions{0};
+    std::atomic<uint64_t> tracking_lock_contended{0};
+    std::atomic<uint64_t> tracking_lock_wait_ns{0};
+    std::atomic<uint64_t> budget_view_evictions{0};
+    std::atomic<uint64_t> budget_page_evictions{0};
+    std::atomic<uint64_t> budget_refaults{0};
+    std::atomic<uint64_t> lazy_fill_skipped_bytes{0};
+    std::atomic<uint64_t> adaptive_tracked_migrations{0};
+    std::atomic<uint64_t> adaptive_full_copy_migrations{0};
+    std::atomic<uint64_t> adaptive_migration_failures{0};
+};
+
+struct LowAddressMapStats {
+    std::array<LowAddressMapCounterShard, kLowAddressMapStatsShardCount> shards;
+    std::atomic<uint32_t> next_shard{0};
+
+    // Peaks need the global current value, so the active gauges stay shared.
+    // They only move when a shadow is installed or released.
+    std::atomic<uint64_t> active_shadow_maps{0};
+    std::atomic<uint64_t> peak_shadow_maps{0};
+    std::atomic<uint64_t> active_shadow_bytes{0};
+    std::atomic<uint64_t> peak_shadow_bytes{0};
+
+    // Copy traffic between presents. copy_frame_base is the copy total at
+    // the previous present.
+    std::atomic<uint64_t> copy_frames{0};
+    std::atomic<uint64_t> copy_frame_first_base{0};
+    std::atomic<uint64_t> copy_frame_base{0};
+    std::atomic<uint64_t> last_frame_copy_bytes{0};
+    std::atomic<uint64_t> peak_frame_copy_bytes{0};
+
+    LowAddressMapCounterShard& local()
+    {
+        static thread_local uint32_t shard_index = UINT32_MAX;
+        if (shard_index == UINT32_MAX) {
+            shard_index = next_shard.fetch_add(1, std::memory_order_relaxed) %
+                          static_cast<uint32_t>(kLowAddressMapStatsShardCount);
+        }
+        return shards[shard_index];
+    }
+
+    uint64_t sum(std::atomic<uint64_t> LowAddressMapCounterShard::*counter) const
+    {
+        uint64_t total = 0;
+        for (const auto& shard : shards) {
+            total += (shard.*counter).load(std::memory_order_relaxed);
+        }
+        return total;
+    }
 };
 
 struct LowAddressMapReportSnapshot {
@@ -273,18 +558,55 @@ struct LowAddressMapReportSnapshot {
     uint64_t allocation_failures = 0;
     uint64_t active_shadow_maps = 0;
     uint64_t active_shadow_bytes = 0;
+    uint64_t resident_shadow_bytes = 0;
+    uint64_t budget_evictions = 0;
+    uint64_t budget_refaults = 0;
     uint64_t total_copy_bytes = 0;
 };
 
-static std::mutex memory_tracking_mutex;
-static std::unordered_map<DeviceMemoryKey, VkDeviceSize, DeviceMemoryKeyHash> tracked_memory_allocations;
+static constexpr size_t kTrackedAllocationShardCount = 16;
+
+// Allocation sizes are only needed to resolve VK_WHOLE_SIZE maps, so they are
+// sharded by key and never contend with the mapping table below.
+struct TrackedAllocation {
+    VkDeviceSize size = 0;
+    VkMemoryPropertyFlags property_flags = 0;
+    // Created on the first shadow map under MALI_WRAPPER_LOW_ADDRESS_MAP=1,adaptive.
+    std::shared_ptr<LowAddressAdaptiveProfile> adaptive_profile;
+};
+
+struct TrackedAllocationShard {
+    std::mutex mutex;
+    std::unordered_map<DeviceMemoryKey, TrackedAllocation, DeviceMemoryKeyHash> allocations;
+};
+
+static std::array<TrackedAllocationShard, kTrackedAllocationShardCount> tracked_allocation_shards;
+
+// Guards shadow_mappings and every DeviceLowAddressMappingIndex. Flush,
+// invalidate and submit sync only read the table and take it shared; map,
+// unmap, free and device teardown take it exclusive.
+static std::shared_mutex memory_tracking_mutex;
 static std::unordered_map<DeviceMemoryKey, ShadowMappingInfo, DeviceMemoryKeyHash> shadow_mappings;
+
+// Low-address views kept alive after vkUnmapMemory so the next map of the same
+// allocation can return the same low pointer. Also guarded by
+// memory_tracking_mutex. Entries here are never synced, since the real
+// mapping is gone while they are parked.
+struct CachedLowAddressMapping {
+    ShadowMappingInfo mapping;
+    uint64_t last_use = 0;
+};
+
+static std::unordered_map<DeviceMemoryKey, CachedLowAddressMapping, DeviceMemoryKeyHash> cached_low_address_mappings;
+static size_t cached_low_address_mapping_bytes = 0;
+static uint64_t cached_low_address_mapping_clock = 0;
 static LowAddressMapStats low_address_map_stats;
 static std::mutex low_address_map_report_mutex;
 static bool low_address_map_report_initialized = false;
 static LowAddressMapReportSnapshot low_address_map_last_report_snapshot;
 static std::chrono::steady_clock::time_point low_address_map_last_report_time;
-static std::mutex graphics_pipeline_signal_guard_mutex;
+static struct sigaction graphics_pipeline_signal_guard_previous_segv_action;
+static struct sigaction graphics_pipeline_signal_guard_previous_bus_action;
 static thread_local sigjmp_buf graphics_pipeline_signal_guard_env;
 static thread_local volatile sig_atomic_t graphics_pipeline_signal_guard_active = 0;
 static thread_local volatile sig_atomic_t graphics_pipeline_signal_guard_caught_signal = 0;
@@ -293,12 +615,123 @@ static constexpr uint64_t kMax32BitAddressExclusive = 0x100000000ULL;
 static constexpr uintptr_t kShadowSearchStart = 0x10000000ULL;
 static constexpr uintptr_t kShadowSearchEnd = 0xF0000000ULL;
 static constexpr uintptr_t kShadowSearchStep = 0x00100000ULL;
+static constexpr size_t kShadowArenaChunkSize = 64ULL * 1024ULL * 1024ULL;
+static constexpr size_t kShadowHugePageSize = 2ULL * 1024ULL * 1024ULL;
+static constexpr size_t kMaxCachedLowAddressMappings = 256;
+static constexpr size_t kMaxCachedLowAddressMappingBytes = 256ULL * 1024ULL * 1024ULL;
+static constexpr size_t kMaxDirtyTrackedRegions = 1024;
+
+// Lock-free table consulted from the SIGSEGV handler. A slot is published by
+// storing dirty_bits, then end, then begin; begin == 0 marks a free slot.
+// real_base/real_size name the mapping evicted pages are refilled from and are
+// cleared while the view is parked. page_lock serialises the handler with
+// budget page-out of the same region.
+struct DirtyTrackedRegionSlot {
+    std::atomic<uintptr_t> begin{0};
+    std::atomic<uintptr_t> end{0};
+    std::atomic<std::atomic<uint64_t>*> dirty_bits{nullptr};
+    std::atomic<std::atomic<uint64_t>*> evicted_bits{nullptr};
+    std::atomic<uintptr_t> real_base{0};
+    std::atomic<size_t> real_size{0};
+    std::atomic<bool> page_lock{false};
+    std::atomic<uint64_t> last_use{0};
+    // Bumped whenever a page of the region is marked dirty; never reset, so
+    // an unchanged count means nothing was written since it was read.
+    std::atomic<uint64_t> writes{0};
+};
+
+static std::array<DirtyTrackedRegionSlot, kMaxDirtyTrackedRegions> dirty_tracked_regions;
+static std::atomic<size_t> dirty_tracked_region_count{0};
+static std::mutex dirty_tracked_region_mutex;
+static struct sigaction shadow_dirty_previous_segv_action;
+static std::atomic<uint64_t> shadow_dirty_use_clock{0};
+
+// Shadow bytes currently backed by RAM: every live or parked SHADOW view minus
+// the pages paged out under MALI_WRAPPER_LOW_ADDRESS_SHADOW_BUDGET_MB.
+static std::atomic<uint64_t> low_address_shadow_resident_bytes{0};
 
 static DeviceMemoryKey make_memory_key(VkDevice device, VkDeviceMemory memory)
 {
     return DeviceMemoryKey{ device, memory };
 }
 
+static TrackedAllocationShard& tracked_allocation_shard_for(const DeviceMemoryKey& key)
+{
+    // Handles are usually aligned pointers, so fold the higher bits down before
+    // picking a shard.
+    size_t hash = DeviceMemoryKeyHash{}(key);
+    hash ^= hash >> 17;
+    hash ^= hash >> 7;
+    return tracked_allocation_shards[hash % kTrackedAllocationShardCount];
+}
+
+static void index_low_address_mapping_locked(VkDeviceMemory memory, ShadowMappingInfo& mapping,
+                                             const std::shared_ptr<DeviceLowAddressMappingIndex>& index)
+{
+    if (index == nullptr) {
+        return;
+    }
+
+    auto& entries = index->entries_for(mapping.mode);
+    mapping.device_index = index;
+    mapping.device_index_slot = entries.size();
+    mapping.submit_sync_stamp.value.store(0, std::memory_order_relaxed);
+    entries.push_back(DeviceLowAddressMappingEntry{ memory, &mapping });
+}
+
+static void unindex_low_address_mapping_locked(ShadowMappingInfo& mapping)
+{
+    DeviceLowAddressMappingIndex* index = mapping.device_index.get();
+    if (index == nullptr) {
+        return;
+    }
+
+    auto& entries = index->entries_for(mapping.mode);
+    const size_t slot = mapping.device_index_slot;
+    if (slot < entries.size()) {
+        if (slot != entries.size() - 1) {
+            entries[slot] = entries.back();
+            entries[slot].mapping->device_index_slot = slot;
+        }
+        entries.pop_back();
+    }
+
+    mapping.device_index.reset();
+    mapping.device_index_slot = std::numeric_limits<size_t>::max();
+}
+
+// Inserts or replaces the mapping for key and keeps the device index in sync.
+// Returns true and fills out_stale when a previous mapping was replaced.
+static bool install_low_address_mapping_locked(const DeviceMemoryKey& key, const ShadowMappingInfo& mapping,
+                                               const std::shared_ptr<DeviceLowAddressMappingIndex>& index,
+                                               ShadowMappingInfo* out_stale)
+{
+    auto it = shadow_mappings.find(key);
+    bool has_stale = false;
+    if (it != shadow_mappings.end()) {
+        unindex_low_address_mapping_locked(it->second);
+        if (out_stale != nullptr) {
+            *out_stale = it->second;
+        }
+        has_stale = true;
+        it->second = mapping;
+    } else {
+        it = shadow_mappings.emplace(key, mapping).first;
+    }
+
+    index_low_address_mapping_locked(key.memory, it->second, index);
+    return has_stale;
+}
+
+static ShadowMappingInfo take_low_address_mapping_locked(
+    std::unordered_map<DeviceMemoryKey, ShadowMappingInfo, DeviceMemoryKeyHash>::iterator it)
+{
+    unindex_low_address_mapping_locked(it->second);
+    ShadowMappingInfo mapping = std::move(it->second);
+    shadow_mappings.erase(it);
+    return mapping;
+}
+
 static bool is_bool_env_enabled(const char* name, bool default_value)
 {
     const char* value = getenv(name);
@@ -346,102 +779,436 @@ static bool should_use_low_address_shadow_map()
     return cached == 1;
 }
 
-static bool should_collect_low_address_map_stats()
+// Returns true when the comma/plus separated env value contains the token
+// (case-insensitive), e.g. MALI_WRAPPER_LOW_ADDRESS_MAP=1,dirty.
+static bool is_env_token_present(const char* name, const char* token)
 {
-    return get_low_address_map_debug_level() > 0;
+    const char* value = getenv(name);
+    if (value == nullptr || token == nullptr || token[0] == '\0') {
+        return false;
+    }
+
+    const size_t token_length = std::strlen(token);
+    const char* cursor = value;
+    while (*cursor != '\0') {
+        const char* token_end = cursor;
+        while (*token_end != '\0' && *token_end != ',' && *token_end != '+') {
+            token_end++;
+        }
+
+        if (static_cast<size_t>(token_end - cursor) == token_length &&
+            strncasecmp(cursor, token, token_length) == 0) {
+            return true;
+        }
+
+        cursor = (*token_end != '\0') ? token_end + 1 : token_end;
+    }
+
+    return false;
 }
 
-static bool should_trace_low_address_map_events()
+static bool is_wine_wow64_process()
 {
-    return get_low_address_map_debug_level() > 1;
+    return getenv("WINEWOW64") != nullptr || getenv("WINE_WOW64") != nullptr;
 }
 
-static void update_peak_stat(std::atomic<uint64_t>& peak, uint64_t value)
+static bool should_track_low_address_shadow_writes()
 {
-    uint64_t current = peak.load(std::memory_order_relaxed);
-    while (current < value &&
-           !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
+
+    cached = (should_use_low_address_shadow_map() &&
+              (is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "dirty") ||
+               is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "lazy") ||
+               is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "adaptive") ||
+               is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "epoch"))) ? 1 : 0;
+    return cached == 1;
 }
 
-static std::string format_bytes(uint64_t bytes)
+// New shadows start out evicted instead of being copied from the real
+// mapping, so each page is filled by the fault handler on its first access.
+// Builds on dirty tracking, which "lazy" turns on.
+static bool should_fill_low_address_shadows_lazily()
 {
-    char buffer[64];
-    const double kib = 1024.0;
-    const double mib = kib * 1024.0;
-    const double gib = mib * 1024.0;
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
 
-    if (bytes >= static_cast<uint64_t>(gib)) {
-        std::snprintf(buffer, sizeof(buffer), "%.2f GiB", static_cast<double>(bytes) / gib);
-    } else if (bytes >= static_cast<uint64_t>(mib)) {
-        std::snprintf(buffer, sizeof(buffer), "%.2f MiB", static_cast<double>(bytes) / mib);
-    } else if (bytes >= static_cast<uint64_t>(kib)) {
-        std::snprintf(buffer, sizeof(buffer), "%.2f KiB", static_cast<double>(bytes) / kib);
-    } else {
-        std::snprintf(buffer, sizeof(buffer), "%" PRIu64 " B", bytes);
+    cached = (should_track_low_address_shadow_writes() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "lazy")) ? 1 : 0;
+    return cached == 1;
+}
+
+// Each allocation's shadows switch between dirty tracking and whole-mapping
+// submit copies according to how much of them the application writes. Builds
+// on dirty tracking, which "adaptive" turns on.
+static bool should_adapt_low_address_shadows()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
 
-    return std::string(buffer);
+    cached = (should_track_low_address_shadow_writes() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "adaptive")) ? 1 : 0;
+    return cached == 1;
 }
 
-static std::string format_duration_ms(uint64_t nanoseconds)
+// Queue submits sync only the shadows of memory the submitted command
+// buffers reference instead of every shadow on the device. The tracker falls
+// back to a full sync for anything it cannot follow.
+static bool should_sync_referenced_shadows_only()
 {
-    char buffer[64];
-    std::snprintf(buffer, sizeof(buffer), "%.3f ms", static_cast<double>(nanoseconds) / 1000000.0);
-    return std::string(buffer);
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_use_low_address_shadow_map() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "refsync")) ? 1 : 0;
+    return cached == 1;
 }
 
-static std::string format_pointer(const void* ptr)
+// Submits skip shadows already written back and not changed since: a
+// shadow's sync epoch is its region's write count, so it is skipped until the
+// region takes a write fault. Implies dirty tracking; shadows without a
+// tracker cannot be shown to be clean and are synced at every submit.
+static bool should_scope_shadow_sync_to_epochs()
 {
-    char buffer[32];
-    std::snprintf(buffer, sizeof(buffer), "%p", ptr);
-    return std::string(buffer);
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_use_low_address_shadow_map() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "epoch")) ? 1 : 0;
+    return cached == 1;
 }
 
-static std::string format_hex_u64(uint64_t value)
+static bool should_use_low_address_shadow_arena()
 {
-    char buffer[32];
-    std::snprintf(buffer, sizeof(buffer), "0x%" PRIx64, value);
-    return std::string(buffer);
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_use_low_address_shadow_map() &&
+              !is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "noarena")) ? 1 : 0;
+    return cached == 1;
 }
 
-static std::string format_device_memory_handle(VkDeviceMemory memory)
+// Backs shadows with transparent huge pages and pre-faults them on
+// allocation. Arena chunks and large shadows are then 2 MiB aligned.
+static bool should_use_low_address_shadow_huge_pages()
 {
-#if defined(VK_USE_64_BIT_PTR_DEFINES) && (VK_USE_64_BIT_PTR_DEFINES == 1)
-    return format_pointer(memory);
-#else
-    return format_hex_u64(static_cast<uint64_t>(memory));
-#endif
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_use_low_address_shadow_map() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "hugepages")) ? 1 : 0;
+    return cached == 1;
 }
 
-static const char* shadow_allocation_method_to_string(ShadowAllocationMethod method)
+static bool should_cache_low_address_mappings()
 {
-    switch (method) {
-        case ShadowAllocationMethod::MAP_32BIT:
-            return "MAP_32BIT";
-        case ShadowAllocationMethod::FIXED_SEARCH:
-            return "fixed-search";
-        case ShadowAllocationMethod::NONE:
-        default:
-            return "none";
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
+
+    cached = (should_use_low_address_shadow_map() &&
+              !is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "nocache")) ? 1 : 0;
+    return cached == 1;
 }
 
-static const char* low_address_map_mode_to_string(LowAddressMapMode mode)
+// ",noalias" skips the kbase alias ioctl so every high mapping takes the
+// shadow path, e.g. to compare the two modes on the same workload.
+static bool should_try_low_address_alias()
 {
-    switch (mode) {
-        case LowAddressMapMode::ALIAS:
-            return "alias";
-        case LowAddressMapMode::SHADOW:
-        default:
-            return "shadow";
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
+
+    cached = is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "noalias") ? 0 : 1;
+    return cached == 1;
 }
 
-static const char* low_address_copy_kind_to_string(LowAddressCopyKind kind)
+// ",alias" skips the capability probe and tries the alias ioctl on every high
+// mapping, even on kernels the probe would have written off.
+static bool should_force_low_address_alias()
 {
-    switch (kind) {
-        case LowAddressCopyKind::MAP_TO_SHADOW:
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_try_low_address_alias() &&
+              is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "alias")) ? 1 : 0;
+    return cached == 1;
+}
+
+// Eager aliasing needs the reuse cache to park the alias until the first map.
+// It defaults on for WoW64 processes; ",eager" forces it and ",noeager" turns
+// it off.
+static bool should_eagerly_alias_allocations()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    const bool requested = is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "eager") ||
+                           (is_wine_wow64_process() &&
+                            !is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "noeager"));
+    cached = (requested && should_try_low_address_alias() && should_cache_low_address_mappings()) ? 1 : 0;
+    return cached == 1;
+}
+
+// Asks the kernel to place CPU mappings below 4 GiB from the start, so maps
+// need neither an alias nor a shadow. It defaults on for WoW64 processes;
+// ",lowplace" forces it and ",nolowplace" turns it off.
+static bool should_request_low32_placement()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "lowplace") ||
+              (is_wine_wow64_process() &&
+               !is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "nolowplace"))) ? 1 : 0;
+    return cached == 1;
+}
+
+// Non-coherent memory has to be flushed by the application before the GPU
+// may read it, and flushes are already copied to the real mapping, so the
+// implicit per-submit copy is only needed for coherent types. "syncall"
+// restores it for applications that forget to flush.
+static bool should_sync_noncoherent_shadows_on_submit()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "syncall") ? 1 : 0;
+    return cached == 1;
+}
+
+// MALI_WRAPPER_LOW_ADDRESS_SHADOW_BUDGET_MB caps resident shadow memory;
+// 0 or unset means unlimited.
+static size_t get_low_address_shadow_budget_bytes()
+{
+    static const size_t cached = []() -> size_t {
+        const char* value = getenv("MALI_WRAPPER_LOW_ADDRESS_SHADOW_BUDGET_MB");
+        if (value == nullptr || value[0] < '0' || value[0] > '9') {
+            return 0;
+        }
+        const unsigned long long megabytes = std::strtoull(value, nullptr, 10);
+        if (megabytes > std::numeric_limits<size_t>::max() / (1024ULL * 1024ULL)) {
+            return std::numeric_limits<size_t>::max();
+        }
+        return static_cast<size_t>(megabytes) * 1024ULL * 1024ULL;
+    }();
+    return cached;
+}
+
+// VK_EXT_memory_budget reports are reduced by the wrapper's own shadow memory
+// and the low address space left; ",nobudget" passes the driver's through.
+static bool should_adjust_memory_budget()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (should_use_low_address_shadow_map() &&
+              !is_env_token_present("MALI_WRAPPER_LOW_ADDRESS_MAP", "nobudget")) ? 1 : 0;
+    return cached == 1;
+}
+
+// Counters are kept for the debug log and for the live metrics page; only the
+// former writes anything to the log.
+static bool should_log_low_address_map_stats()
+{
+    return get_low_address_map_debug_level() > 0;
+}
+
+static bool should_collect_low_address_map_stats()
+{
+    return should_log_low_address_map_stats() || MetricsPage::Instance().IsEnabled();
+}
+
+static bool should_trace_low_address_map_events()
+{
+    return get_low_address_map_debug_level() > 1;
+}
+
+// Without the low-address engine the memory and submit hooks have nothing to
+// do, so vkGetDeviceProcAddr hands out the driver's entry points instead.
+// WoW64 processes, stats, tracing, memory recording and
+// MALI_WRAPPER_DIRECT_DISPATCH=0 keep the hooks so high pointers are still
+// detected and counted.
+static bool should_dispatch_memory_directly()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    cached = (!should_use_low_address_shadow_map() && !is_wine_wow64_process() &&
+              !should_collect_low_address_map_stats() && !IsTraceEnabled() && !IsMemoryRecordingEnabled() &&
+              is_bool_env_enabled("MALI_WRAPPER_DIRECT_DISPATCH", true)) ? 1 : 0;
+    return cached == 1;
+}
+
+template <typename Lock>
+static Lock acquire_memory_tracking_lock(typename Lock::mutex_type& mutex)
+{
+    Lock lock(mutex, std::try_to_lock);
+    if (!should_collect_low_address_map_stats()) {
+        if (!lock.owns_lock()) {
+            lock.lock();
+        }
+        return lock;
+    }
+
+    low_address_map_stats.local().tracking_lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (!lock.owns_lock()) {
+        const auto wait_start = std::chrono::steady_clock::now();
+        lock.lock();
+        low_address_map_stats.local().tracking_lock_contended.fetch_add(1, std::memory_order_relaxed);
+        low_address_map_stats.local().tracking_lock_wait_ns.fetch_add(
+            static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - wait_start).count()),
+            std::memory_order_relaxed);
+    }
+    return lock;
+}
+
+static std::shared_lock<std::shared_mutex> lock_shadow_mappings_shared()
+{
+    return acquire_memory_tracking_lock<std::shared_lock<std::shared_mutex>>(memory_tracking_mutex);
+}
+
+static std::unique_lock<std::shared_mutex> lock_shadow_mappings_exclusive()
+{
+    return acquire_memory_tracking_lock<std::unique_lock<std::shared_mutex>>(memory_tracking_mutex);
+}
+
+static std::unique_lock<std::mutex> lock_tracked_allocation_shard(TrackedAllocationShard& shard)
+{
+    return acquire_memory_tracking_lock<std::unique_lock<std::mutex>>(shard.mutex);
+}
+
+static void update_peak_stat(std::atomic<uint64_t>& peak, uint64_t value)
+{
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (current < value &&
+           !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+static std::string format_bytes(uint64_t bytes)
+{
+    char buffer[64];
+    const double kib = 1024.0;
+    const double mib = kib * 1024.0;
+    const double gib = mib * 1024.0;
+
+    if (bytes >= static_cast<uint64_t>(gib)) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f GiB", static_cast<double>(bytes) / gib);
+    } else if (bytes >= static_cast<uint64_t>(mib)) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f MiB", static_cast<double>(bytes) / mib);
+    } else if (bytes >= static_cast<uint64_t>(kib)) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f KiB", static_cast<double>(bytes) / kib);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%" PRIu64 " B", bytes);
+    }
+
+    return std::string(buffer);
+}
+
+static std::string format_duration_ms(uint64_t nanoseconds)
+{
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.3f ms", static_cast<double>(nanoseconds) / 1000000.0);
+    return std::string(buffer);
+}
+
+static std::string format_pointer(const void* ptr)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%p", ptr);
+    return std::string(buffer);
+}
+
+static std::string format_hex_u64(uint64_t value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "0x%" PRIx64, value);
+    return std::string(buffer);
+}
+
+static std::string format_device_memory_handle(VkDeviceMemory memory)
+{
+#if defined(VK_USE_64_BIT_PTR_DEFINES) && (VK_USE_64_BIT_PTR_DEFINES == 1)
+    return format_pointer(memory);
+#else
+    return format_hex_u64(static_cast<uint64_t>(memory));
+#endif
+}
+
+static uint64_t recorded_memory_handle(VkDeviceMemory memory)
+{
+#if defined(VK_USE_64_BIT_PTR_DEFINES) && (VK_USE_64_BIT_PTR_DEFINES == 1)
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(memory));
+#else
+    return static_cast<uint64_t>(memory);
+#endif
+}
+
+static uint64_t recorded_queue_handle(VkQueue queue)
+{
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(queue));
+}
+
+static const char* shadow_allocation_method_to_string(ShadowAllocationMethod method)
+{
+    switch (method) {
+        case ShadowAllocationMethod::MAP_32BIT:
+            return "MAP_32BIT";
+        case ShadowAllocationMethod::FIXED_SEARCH:
+            return "fixed-search";
+        case ShadowAllocationMethod::ARENA:
+            return "arena";
+        case ShadowAllocationMethod::NONE:
+        default:
+            return "none";
+    }
+}
+
+static const char* low_address_map_mode_to_string(LowAddressMapMode mode)
+{
+    switch (mode) {
+        case LowAddressMapMode::ALIAS:
+            return "alias";
+        case LowAddressMapMode::SHADOW:
+        default:
+            return "shadow";
+    }
+}
+
+static const char* low_address_copy_kind_to_string(LowAddressCopyKind kind)
+{
+    switch (kind) {
+        case LowAddressCopyKind::MAP_TO_SHADOW:
             return "map-to-shadow";
         case LowAddressCopyKind::FLUSH_TO_REAL:
             return "flush-to-real";
@@ -462,39 +1229,54 @@ static void record_low_address_copy(LowAddressCopyKind kind, size_t size, uint64
         return;
     }
 
-    low_address_map_stats.copy_time_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+    low_address_map_stats.local().copy_time_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
     switch (kind) {
         case LowAddressCopyKind::MAP_TO_SHADOW:
-            low_address_map_stats.initial_copy_bytes.fetch_add(size, std::memory_order_relaxed);
+            low_address_map_stats.local().initial_copy_bytes.fetch_add(size, std::memory_order_relaxed);
             break;
         case LowAddressCopyKind::FLUSH_TO_REAL:
-            low_address_map_stats.flush_copy_bytes.fetch_add(size, std::memory_order_relaxed);
+            low_address_map_stats.local().flush_copy_bytes.fetch_add(size, std::memory_order_relaxed);
             break;
         case LowAddressCopyKind::INVALIDATE_TO_SHADOW:
-            low_address_map_stats.invalidate_copy_bytes.fetch_add(size, std::memory_order_relaxed);
+            low_address_map_stats.local().invalidate_copy_bytes.fetch_add(size, std::memory_order_relaxed);
             break;
         case LowAddressCopyKind::SUBMIT_TO_REAL:
-            low_address_map_stats.submit_copy_bytes.fetch_add(size, std::memory_order_relaxed);
+            low_address_map_stats.local().submit_copy_bytes.fetch_add(size, std::memory_order_relaxed);
             break;
         case LowAddressCopyKind::UNMAP_TO_REAL:
-            low_address_map_stats.unmap_copy_bytes.fetch_add(size, std::memory_order_relaxed);
+            low_address_map_stats.local().unmap_copy_bytes.fetch_add(size, std::memory_order_relaxed);
             break;
     }
 }
 
-static void tracked_memcpy(void* dst, const void* src, size_t size, LowAddressCopyKind kind)
+static CopyMemoryType get_copy_memory_type(VkMemoryPropertyFlags flags)
+{
+    if ((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0) {
+        return CopyMemoryType::CACHED;
+    }
+    if ((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0) {
+        return CopyMemoryType::COHERENT;
+    }
+    // Untracked allocations report no flags; keep them on memcpy.
+    return flags != 0 ? CopyMemoryType::UNCACHED : CopyMemoryType::CACHED;
+}
+
+static void tracked_memcpy(void* dst, const void* src, size_t size, LowAddressCopyKind kind,
+                           VkMemoryPropertyFlags memory_flags)
 {
     if (size == 0) {
         return;
     }
 
+    MALI_TRACE_SCOPE(COPY, size, static_cast<uint64_t>(kind));
+    const CopyMemoryType memory_type = get_copy_memory_type(memory_flags);
     if (!should_collect_low_address_map_stats()) {
-        std::memcpy(dst, src, size);
+        CopyEngine::Instance().Copy(dst, src, size, memory_type);
         return;
     }
 
     const auto start = std::chrono::steady_clock::now();
-    std::memcpy(dst, src, size);
+    CopyEngine::Instance().Copy(dst, src, size, memory_type);
     const uint64_t elapsed_ns = static_cast<uint64_t>(
         std::chrono::duration_cast<std::chrono::nanoseconds>(
             std::chrono::steady_clock::now() - start).count());
@@ -506,6 +1288,45 @@ static void tracked_memcpy(void* dst, const void* src, size_t size, LowAddressCo
                               ", size=" + format_bytes(static_cast<uint64_t>(size)) +
                               ", src=" + format_pointer(src) +
                               ", dst=" + format_pointer(dst) +
+                              ", copy_kernel=" + std::string(GetCopyKernelName(memory_type)) +
+                              ", elapsed=" + format_duration_ms(elapsed_ns));
+    }
+}
+
+// Copies several regions as one batch so the copy engine can spread them
+// across its workers. Stats are recorded per kind for the whole batch.
+static void tracked_memcpy_batch(const std::vector<CopyEngine::Region>& regions, LowAddressCopyKind kind)
+{
+    if (regions.empty()) {
+        return;
+    }
+
+    const bool collect_stats = should_collect_low_address_map_stats();
+    size_t total_size = 0;
+    if (collect_stats || IsTraceEnabled()) {
+        for (const auto& region : regions) {
+            total_size += region.size;
+        }
+    }
+
+    MALI_TRACE_SCOPE(COPY, total_size, static_cast<uint64_t>(kind));
+    if (!collect_stats) {
+        CopyEngine::Instance().CopyBatch(regions.data(), regions.size());
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    CopyEngine::Instance().CopyBatch(regions.data(), regions.size());
+    const uint64_t elapsed_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    record_low_address_copy(kind, total_size, elapsed_ns);
+
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_DEBUG("Low-address batched copy: kind=" +
+                              std::string(low_address_copy_kind_to_string(kind)) +
+                              ", regions=" + std::to_string(regions.size()) +
+                              ", size=" + format_bytes(static_cast<uint64_t>(total_size)) +
                               ", elapsed=" + format_duration_ms(elapsed_ns));
     }
 }
@@ -518,17 +1339,20 @@ static void record_shadow_mapping_installed(size_t new_shadow_size,
         return;
     }
 
-    low_address_map_stats.shadow_maps.fetch_add(1, std::memory_order_relaxed);
-    low_address_map_stats.total_shadow_bytes_reserved.fetch_add(new_shadow_size, std::memory_order_relaxed);
-    low_address_map_stats.allocation_time_ns.fetch_add(allocation.elapsed_ns, std::memory_order_relaxed);
-    low_address_map_stats.fixed_search_attempts.fetch_add(allocation.fixed_search_attempts, std::memory_order_relaxed);
+    low_address_map_stats.local().shadow_maps.fetch_add(1, std::memory_order_relaxed);
+    low_address_map_stats.local().total_shadow_bytes_reserved.fetch_add(new_shadow_size, std::memory_order_relaxed);
+    low_address_map_stats.local().allocation_time_ns.fetch_add(allocation.elapsed_ns, std::memory_order_relaxed);
+    low_address_map_stats.local().fixed_search_attempts.fetch_add(allocation.fixed_search_attempts, std::memory_order_relaxed);
 
     switch (allocation.method) {
         case ShadowAllocationMethod::MAP_32BIT:
-            low_address_map_stats.map32bit_allocations.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().map32bit_allocations.fetch_add(1, std::memory_order_relaxed);
             break;
         case ShadowAllocationMethod::FIXED_SEARCH:
-            low_address_map_stats.fixed_search_allocations.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().fixed_search_allocations.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case ShadowAllocationMethod::ARENA:
+            low_address_map_stats.local().arena_allocations.fetch_add(1, std::memory_order_relaxed);
             break;
         case ShadowAllocationMethod::NONE:
         default:
@@ -568,32 +1392,39 @@ static LowAddressMapReportSnapshot capture_low_address_map_report_snapshot()
 {
     LowAddressMapReportSnapshot snapshot{};
     snapshot.successful_maps =
-        low_address_map_stats.successful_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::successful_maps);
     snapshot.compatible_maps =
-        low_address_map_stats.compatible_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::compatible_maps);
     snapshot.high_pointer_maps =
-        low_address_map_stats.high_pointer_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::high_pointer_maps);
     snapshot.shadow_maps =
-        low_address_map_stats.shadow_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::shadow_maps);
     snapshot.disabled_high_pointer_maps =
-        low_address_map_stats.disabled_high_pointer_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::disabled_high_pointer_maps);
     snapshot.allocation_failures =
-        low_address_map_stats.allocation_failures.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::allocation_failures);
     snapshot.active_shadow_maps =
         low_address_map_stats.active_shadow_maps.load(std::memory_order_relaxed);
     snapshot.active_shadow_bytes =
         low_address_map_stats.active_shadow_bytes.load(std::memory_order_relaxed);
+    snapshot.resident_shadow_bytes =
+        low_address_shadow_resident_bytes.load(std::memory_order_relaxed);
+    snapshot.budget_evictions =
+        low_address_map_stats.sum(&LowAddressMapCounterShard::budget_view_evictions) +
+        low_address_map_stats.sum(&LowAddressMapCounterShard::budget_page_evictions);
+    snapshot.budget_refaults =
+        low_address_map_stats.sum(&LowAddressMapCounterShard::budget_refaults);
 
     const uint64_t initial_copy_bytes =
-        low_address_map_stats.initial_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::initial_copy_bytes);
     const uint64_t flush_copy_bytes =
-        low_address_map_stats.flush_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::flush_copy_bytes);
     const uint64_t invalidate_copy_bytes =
-        low_address_map_stats.invalidate_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::invalidate_copy_bytes);
     const uint64_t submit_copy_bytes =
-        low_address_map_stats.submit_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::submit_copy_bytes);
     const uint64_t unmap_copy_bytes =
-        low_address_map_stats.unmap_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::unmap_copy_bytes);
     snapshot.total_copy_bytes =
         initial_copy_bytes + flush_copy_bytes + invalidate_copy_bytes + submit_copy_bytes +
         unmap_copy_bytes;
@@ -612,12 +1443,66 @@ static bool low_address_map_report_changed(const LowAddressMapReportSnapshot& pr
            previous.allocation_failures != current.allocation_failures ||
            previous.active_shadow_maps != current.active_shadow_maps ||
            previous.active_shadow_bytes != current.active_shadow_bytes ||
+           previous.budget_evictions != current.budget_evictions ||
+           previous.budget_refaults != current.budget_refaults ||
            previous.total_copy_bytes != current.total_copy_bytes;
 }
 
+static void fill_metrics_page_low_address_counters(uint64_t* values)
+{
+    const auto sum = [](std::atomic<uint64_t> LowAddressMapCounterShard::*counter) {
+        return low_address_map_stats.sum(counter);
+    };
+
+    values[metrics_counter::successful_maps] = sum(&LowAddressMapCounterShard::successful_maps);
+    values[metrics_counter::compatible_maps] = sum(&LowAddressMapCounterShard::compatible_maps);
+    values[metrics_counter::high_pointer_maps] = sum(&LowAddressMapCounterShard::high_pointer_maps);
+    values[metrics_counter::shadow_maps] = sum(&LowAddressMapCounterShard::shadow_maps);
+    values[metrics_counter::allocation_failures] = sum(&LowAddressMapCounterShard::allocation_failures);
+    values[metrics_counter::active_shadow_maps] =
+        low_address_map_stats.active_shadow_maps.load(std::memory_order_relaxed);
+    values[metrics_counter::active_shadow_bytes] =
+        low_address_map_stats.active_shadow_bytes.load(std::memory_order_relaxed);
+    values[metrics_counter::peak_shadow_bytes] =
+        low_address_map_stats.peak_shadow_bytes.load(std::memory_order_relaxed);
+    values[metrics_counter::resident_shadow_bytes] =
+        low_address_shadow_resident_bytes.load(std::memory_order_relaxed);
+    values[metrics_counter::arena_reserved_bytes] = sum(&LowAddressMapCounterShard::arena_reserved_bytes);
+    values[metrics_counter::initial_copy_bytes] = sum(&LowAddressMapCounterShard::initial_copy_bytes);
+    values[metrics_counter::flush_copy_bytes] = sum(&LowAddressMapCounterShard::flush_copy_bytes);
+    values[metrics_counter::invalidate_copy_bytes] = sum(&LowAddressMapCounterShard::invalidate_copy_bytes);
+    values[metrics_counter::submit_copy_bytes] = sum(&LowAddressMapCounterShard::submit_copy_bytes);
+    values[metrics_counter::unmap_copy_bytes] = sum(&LowAddressMapCounterShard::unmap_copy_bytes);
+    values[metrics_counter::copy_time_ns] = sum(&LowAddressMapCounterShard::copy_time_ns);
+    values[metrics_counter::allocation_time_ns] = sum(&LowAddressMapCounterShard::allocation_time_ns);
+    values[metrics_counter::dirty_write_faults] = sum(&LowAddressMapCounterShard::dirty_write_faults);
+    values[metrics_counter::submit_dirty_pages] = sum(&LowAddressMapCounterShard::submit_dirty_pages);
+    values[metrics_counter::submit_clean_bytes_skipped] =
+        sum(&LowAddressMapCounterShard::submit_clean_bytes_skipped);
+    values[metrics_counter::mapping_cache_hits] = sum(&LowAddressMapCounterShard::mapping_cache_hits);
+    values[metrics_counter::mapping_cache_misses] = sum(&LowAddressMapCounterShard::mapping_cache_misses);
+    values[metrics_counter::mapping_cache_evictions] = sum(&LowAddressMapCounterShard::mapping_cache_evictions);
+    values[metrics_counter::budget_evictions] = sum(&LowAddressMapCounterShard::budget_view_evictions) +
+                                                sum(&LowAddressMapCounterShard::budget_page_evictions);
+    values[metrics_counter::budget_refaults] = sum(&LowAddressMapCounterShard::budget_refaults);
+    values[metrics_counter::lazy_fill_skipped_bytes] = sum(&LowAddressMapCounterShard::lazy_fill_skipped_bytes);
+    values[metrics_counter::submit_epoch_skips] = sum(&LowAddressMapCounterShard::submit_epoch_skips);
+    values[metrics_counter::adaptive_tracked_migrations] =
+        sum(&LowAddressMapCounterShard::adaptive_tracked_migrations);
+    values[metrics_counter::adaptive_full_copy_migrations] =
+        sum(&LowAddressMapCounterShard::adaptive_full_copy_migrations);
+    values[metrics_counter::adaptive_migration_failures] =
+        sum(&LowAddressMapCounterShard::adaptive_migration_failures);
+    values[metrics_counter::last_frame_copy_bytes] =
+        low_address_map_stats.last_frame_copy_bytes.load(std::memory_order_relaxed);
+    values[metrics_counter::peak_frame_copy_bytes] =
+        low_address_map_stats.peak_frame_copy_bytes.load(std::memory_order_relaxed);
+}
+
 static void maybe_log_low_address_map_progress(const char* reason, bool force)
 {
-    if (!should_collect_low_address_map_stats()) {
+    MetricsPage::Instance().PublishLowAddressCounters();
+    if (!should_log_low_address_map_stats()) {
         return;
     }
 
@@ -661,57 +1546,63 @@ static void maybe_log_low_address_map_progress(const char* reason, bool force)
                          ", allocation_failures=" + std::to_string(snapshot.allocation_failures) +
                          ", active_shadows=" + std::to_string(snapshot.active_shadow_maps) +
                          ", active_shadow_bytes=" + format_bytes(snapshot.active_shadow_bytes) +
+                         ", resident_shadow_bytes=" + format_bytes(snapshot.resident_shadow_bytes) +
+                         ", shadow_budget=" + format_bytes(get_low_address_shadow_budget_bytes()) +
+                         ", budget_evictions=" + std::to_string(snapshot.budget_evictions) +
+                         ", budget_refaults=" + std::to_string(snapshot.budget_refaults) +
                          ", total_copy=" + format_bytes(snapshot.total_copy_bytes));
 }
 
+static bool sample_shadow_arena_huge_pages(uint64_t* rss_bytes, uint64_t* huge_bytes);
+
 static void log_low_address_map_summary()
 {
-    if (!should_collect_low_address_map_stats()) {
+    if (!should_log_low_address_map_stats()) {
         return;
     }
 
     const uint64_t successful_maps =
-        low_address_map_stats.successful_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::successful_maps);
     const uint64_t compatible_maps =
-        low_address_map_stats.compatible_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::compatible_maps);
     const uint64_t high_pointer_maps =
-        low_address_map_stats.high_pointer_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::high_pointer_maps);
     const uint64_t shadow_maps =
-        low_address_map_stats.shadow_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::shadow_maps);
     const uint64_t disabled_high_pointer_maps =
-        low_address_map_stats.disabled_high_pointer_maps.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::disabled_high_pointer_maps);
     const uint64_t resolve_failures =
-        low_address_map_stats.resolve_failures.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::resolve_failures);
     const uint64_t unsupported_size_failures =
-        low_address_map_stats.unsupported_size_failures.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::unsupported_size_failures);
     const uint64_t allocation_failures =
-        low_address_map_stats.allocation_failures.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::allocation_failures);
     const uint64_t map32bit_allocations =
-        low_address_map_stats.map32bit_allocations.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::map32bit_allocations);
     const uint64_t fixed_search_allocations =
-        low_address_map_stats.fixed_search_allocations.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::fixed_search_allocations);
     const uint64_t fixed_search_attempts =
-        low_address_map_stats.fixed_search_attempts.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::fixed_search_attempts);
     const uint64_t total_shadow_bytes_reserved =
-        low_address_map_stats.total_shadow_bytes_reserved.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::total_shadow_bytes_reserved);
     const uint64_t peak_shadow_maps =
         low_address_map_stats.peak_shadow_maps.load(std::memory_order_relaxed);
     const uint64_t peak_shadow_bytes =
         low_address_map_stats.peak_shadow_bytes.load(std::memory_order_relaxed);
     const uint64_t initial_copy_bytes =
-        low_address_map_stats.initial_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::initial_copy_bytes);
     const uint64_t flush_copy_bytes =
-        low_address_map_stats.flush_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::flush_copy_bytes);
     const uint64_t invalidate_copy_bytes =
-        low_address_map_stats.invalidate_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::invalidate_copy_bytes);
     const uint64_t submit_copy_bytes =
-        low_address_map_stats.submit_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::submit_copy_bytes);
     const uint64_t unmap_copy_bytes =
-        low_address_map_stats.unmap_copy_bytes.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::unmap_copy_bytes);
     const uint64_t allocation_time_ns =
-        low_address_map_stats.allocation_time_ns.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::allocation_time_ns);
     const uint64_t copy_time_ns =
-        low_address_map_stats.copy_time_ns.load(std::memory_order_relaxed);
+        low_address_map_stats.sum(&LowAddressMapCounterShard::copy_time_ns);
     const uint64_t total_copy_bytes =
         initial_copy_bytes + flush_copy_bytes + invalidate_copy_bytes + submit_copy_bytes +
         unmap_copy_bytes;
@@ -731,18 +1622,115 @@ static void log_low_address_map_summary()
     LOW_ADDRESS_LOG_INFO("Low-address map allocation stats: map32bit=" + std::to_string(map32bit_allocations) +
                          ", fixed_search=" + std::to_string(fixed_search_allocations) +
                          ", fixed_search_attempts=" + std::to_string(fixed_search_attempts) +
+                         ", alias_fd_scans=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::alias_fd_scans)) +
+                         ", alias_batch_ioctls=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::alias_batch_ioctls)) +
+                         ", arena=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::arena_allocations)) +
+                         ", arena_chunks=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::arena_chunks_reserved)) +
+                         "/" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::arena_chunks_released)) +
+                         ", arena_reserved=" +
+                         format_bytes(low_address_map_stats.sum(&LowAddressMapCounterShard::arena_reserved_bytes)) +
                          ", total_shadow_reserved=" + format_bytes(total_shadow_bytes_reserved) +
                          ", peak_active_shadows=" + std::to_string(peak_shadow_maps) +
                          ", peak_shadow_bytes=" + format_bytes(peak_shadow_bytes) +
                          ", allocation_time=" + format_duration_ms(allocation_time_ns));
 
+    uint64_t arena_rss_bytes = 0;
+    uint64_t arena_huge_bytes = 0;
+    if (should_use_low_address_shadow_huge_pages() &&
+        sample_shadow_arena_huge_pages(&arena_rss_bytes, &arena_huge_bytes)) {
+        const uint64_t huge_percent = arena_rss_bytes > 0 ? (arena_huge_bytes * 100ULL) / arena_rss_bytes : 0;
+        LOW_ADDRESS_LOG_INFO("Low-address map huge page stats: arena_rss=" + format_bytes(arena_rss_bytes) +
+                             ", anon_huge=" + format_bytes(arena_huge_bytes) +
+                             ", huge_fraction=" + std::to_string(huge_percent) + "%");
+    }
+
     LOW_ADDRESS_LOG_INFO("Low-address map copy stats: initial=" + format_bytes(initial_copy_bytes) +
                          ", flush=" + format_bytes(flush_copy_bytes) +
                          ", invalidate=" + format_bytes(invalidate_copy_bytes) +
                          ", submit=" + format_bytes(submit_copy_bytes) +
                          ", unmap=" + format_bytes(unmap_copy_bytes) +
+                         ", lazy_fill_skipped=" +
+                         format_bytes(low_address_map_stats.sum(&LowAddressMapCounterShard::lazy_fill_skipped_bytes)) +
+                         ", submit_noncoherent_skips=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::submit_noncoherent_skips)) +
+                         ", submit_unreferenced_skips=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::submit_unreferenced_skips)) +
+                         ", submit_epoch_skips=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::submit_epoch_skips)) +
                          ", total=" + format_bytes(total_copy_bytes) +
                          ", copy_time=" + format_duration_ms(copy_time_ns));
+
+    const uint64_t copy_frames = low_address_map_stats.copy_frames.load(std::memory_order_relaxed);
+    if (copy_frames > 1) {
+        const uint64_t frame_copy_bytes = low_address_map_stats.copy_frame_base.load(std::memory_order_relaxed) -
+                                          low_address_map_stats.copy_frame_first_base.load(std::memory_order_relaxed);
+        LOW_ADDRESS_LOG_INFO("Low-address map per-frame copy stats: frames=" + std::to_string(copy_frames - 1) +
+                             ", mean=" + format_bytes(frame_copy_bytes / (copy_frames - 1)) +
+                             ", last=" +
+                             format_bytes(low_address_map_stats.last_frame_copy_bytes.load(std::memory_order_relaxed)) +
+                             ", peak=" +
+                             format_bytes(low_address_map_stats.peak_frame_copy_bytes.load(std::memory_order_relaxed)));
+    }
+
+    if (should_track_low_address_shadow_writes()) {
+        LOW_ADDRESS_LOG_INFO("Low-address map dirty tracking stats: tracked_shadows=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::dirty_tracked_maps)) +
+                             ", tracking_failures=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::dirty_tracking_failures)) +
+                             ", write_faults=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::dirty_write_faults)) +
+                             ", submit_dirty_pages=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::submit_dirty_pages)) +
+                             ", submit_skipped=" +
+                             format_bytes(low_address_map_stats.sum(&LowAddressMapCounterShard::submit_clean_bytes_skipped)));
+    }
+
+    if (should_adapt_low_address_shadows()) {
+        LOW_ADDRESS_LOG_INFO("Low-address map adaptive sync stats: to_tracked=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::adaptive_tracked_migrations)) +
+                             ", to_full_copy=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::adaptive_full_copy_migrations)) +
+                             ", failures=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::adaptive_migration_failures)));
+    }
+
+    if (should_cache_low_address_mappings()) {
+        LOW_ADDRESS_LOG_INFO("Low-address map reuse cache stats: hits=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::mapping_cache_hits)) +
+                             ", misses=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::mapping_cache_misses)) +
+                             ", evictions=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::mapping_cache_evictions)) +
+                             ", eager_aliases=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::eager_aliases)) +
+                             ", eager_alias_failures=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::eager_alias_failures)));
+    }
+
+    if (get_low_address_shadow_budget_bytes() > 0) {
+        LOW_ADDRESS_LOG_INFO("Low-address map shadow budget stats: budget=" +
+                             format_bytes(get_low_address_shadow_budget_bytes()) +
+                             ", resident=" +
+                             format_bytes(low_address_shadow_resident_bytes.load(std::memory_order_relaxed)) +
+                             ", parked_views_evicted=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::budget_view_evictions)) +
+                             ", pages_evicted=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::budget_page_evictions)) +
+                             ", refaults=" +
+                             std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::budget_refaults)));
+    }
+
+    LOW_ADDRESS_LOG_INFO("Low-address map tracking lock stats: acquisitions=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::tracking_lock_acquisitions)) +
+                         ", contended=" +
+                         std::to_string(low_address_map_stats.sum(&LowAddressMapCounterShard::tracking_lock_contended)) +
+                         ", wait_time=" +
+                         format_duration_ms(low_address_map_stats.sum(&LowAddressMapCounterShard::tracking_lock_wait_ns)));
 }
 
 struct DxvkFeatureSpoofConfig {
@@ -929,24 +1917,37 @@ static bool is_pointer_32bit_compatible(const void* ptr)
     return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)) < kMax32BitAddressExclusive;
 }
 
-static bool resolve_map_size_locked(const DeviceMemoryKey& key, VkDeviceSize offset,
-                                    VkDeviceSize requested_size, VkDeviceSize* out_size)
+static bool resolve_map_size(const DeviceMemoryKey& key, VkDeviceSize offset,
+                             VkDeviceSize requested_size, VkDeviceSize* out_size,
+                             VkMemoryPropertyFlags* out_flags)
 {
-    if (out_size == nullptr) {
+    if (out_size == nullptr || out_flags == nullptr) {
         return false;
     }
 
+    bool tracked = false;
+    TrackedAllocation allocation{};
+    {
+        TrackedAllocationShard& shard = tracked_allocation_shard_for(key);
+        auto lock = lock_tracked_allocation_shard(shard);
+        auto alloc_it = shard.allocations.find(key);
+        if (alloc_it != shard.allocations.end()) {
+            allocation = alloc_it->second;
+            tracked = true;
+        }
+    }
+    *out_flags = allocation.property_flags;
+
     if (requested_size != VK_WHOLE_SIZE) {
         *out_size = requested_size;
         return requested_size > 0;
     }
 
-    auto alloc_it = tracked_memory_allocations.find(key);
-    if (alloc_it == tracked_memory_allocations.end()) {
+    if (!tracked) {
         return false;
     }
 
-    const VkDeviceSize allocation_size = alloc_it->second;
+    const VkDeviceSize allocation_size = allocation.size;
     if (offset >= allocation_size) {
         return false;
     }
@@ -955,6 +1956,29 @@ static bool resolve_map_size_locked(const DeviceMemoryKey& key, VkDeviceSize off
     return *out_size > 0;
 }
 
+// The allocation's adaptive profile, created on first use. nullptr unless
+// adaptive sync is on and submits write its shadows back: untracked memory
+// and non-coherent memory flushed by the application keep the fixed policy.
+static std::shared_ptr<LowAddressAdaptiveProfile> get_low_address_adaptive_profile(const DeviceMemoryKey& key,
+                                                                                   VkMemoryPropertyFlags flags)
+{
+    if (!should_adapt_low_address_shadows() || flags == 0 ||
+        ((flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0 && !should_sync_noncoherent_shadows_on_submit())) {
+        return nullptr;
+    }
+
+    TrackedAllocationShard& shard = tracked_allocation_shard_for(key);
+    auto lock = lock_tracked_allocation_shard(shard);
+    auto alloc_it = shard.allocations.find(key);
+    if (alloc_it == shard.allocations.end()) {
+        return nullptr;
+    }
+    if (alloc_it->second.adaptive_profile == nullptr) {
+        alloc_it->second.adaptive_profile = std::make_shared<LowAddressAdaptiveProfile>();
+    }
+    return alloc_it->second.adaptive_profile;
+}
+
 static bool compute_copy_region(const ShadowMappingInfo& mapping, VkDeviceSize range_offset,
                                 VkDeviceSize range_size, size_t* out_offset, size_t* out_size)
 {
@@ -1012,716 +2036,2684 @@ static size_t align_up_to_page(size_t value)
     return (value + (page_size - 1)) & ~(page_size - 1);
 }
 
-static std::vector<int> enumerate_mali_device_fds()
+static void lock_dirty_tracked_region_pages(DirtyTrackedRegionSlot& slot)
 {
-    std::vector<int> fds;
-    DIR* dir = opendir("/proc/self/fd");
-    if (dir == nullptr) {
-        return fds;
+    while (slot.page_lock.exchange(true, std::memory_order_acquire)) {
     }
+}
 
-    const int proc_dir_fd = dirfd(dir);
-    for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
-        if (entry->d_name[0] == '.') {
-            continue;
-        }
+static void unlock_dirty_tracked_region_pages(DirtyTrackedRegionSlot& slot)
+{
+    slot.page_lock.store(false, std::memory_order_release);
+}
 
-        char* end = nullptr;
-        const long parsed_fd = std::strtol(entry->d_name, &end, 10);
-        if (end == nullptr || *end != '\0' || parsed_fd < 0 ||
-            parsed_fd > std::numeric_limits<int>::max()) {
-            continue;
-        }
+// Refills a page evicted under the shadow budget from the real mapping. The
+// page is left read-only so a pending write still takes the dirty path.
+// Async-signal-safe; called with the slot's page_lock held.
+static bool refault_evicted_shadow_page_locked(DirtyTrackedRegionSlot& slot, uintptr_t begin,
+                                               std::atomic<uint64_t>* evicted_bits, size_t page_index)
+{
+    const uint64_t page_bit = 1ULL << (page_index % 64);
+    if ((evicted_bits[page_index / 64].load(std::memory_order_acquire) & page_bit) == 0) {
+        return true;
+    }
 
-        const int fd = static_cast<int>(parsed_fd);
-        if (fd == proc_dir_fd) {
-            continue;
-        }
+    const uintptr_t real_base = slot.real_base.load(std::memory_order_acquire);
+    if (real_base == 0) {
+        return false;
+    }
 
-        std::array<char, 64> proc_path{};
-        std::snprintf(proc_path.data(), proc_path.size(), "/proc/self/fd/%d", fd);
+    const size_t page_size = get_page_size();
+    const size_t page_offset = page_index * page_size;
+    void* page = reinterpret_cast<void*>(begin + page_offset);
+    if (mprotect(page, page_size, PROT_READ | PROT_WRITE) != 0) {
+        return false;
+    }
 
-        std::array<char, 256> target_path{};
-        const ssize_t link_size =
-            readlink(proc_path.data(), target_path.data(), target_path.size() - 1);
-        if (link_size <= 0) {
+    const size_t real_size = slot.real_size.load(std::memory_order_acquire);
+    if (page_offset < real_size) {
+        std::memcpy(page, reinterpret_cast<const void*>(real_base + page_offset),
+                    std::min(page_size, real_size - page_offset));
+    }
+    mprotect(page, page_size, PROT_READ);
+
+    evicted_bits[page_index / 64].fetch_and(~page_bit, std::memory_order_acq_rel);
+    low_address_shadow_resident_bytes.fetch_add(page_size, std::memory_order_relaxed);
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().budget_refaults.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Async-signal-safe: only touches the lock-free region table and the
+// pre-allocated dirty bitmaps.
+static bool handle_shadow_dirty_write_fault(const void* fault_addr)
+{
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(fault_addr);
+    const size_t page_size = get_page_size();
+    const size_t region_count = dirty_tracked_region_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < region_count; i++) {
+        DirtyTrackedRegionSlot& slot = dirty_tracked_regions[i];
+        const uintptr_t begin = slot.begin.load(std::memory_order_acquire);
+        if (begin == 0 || addr < begin) {
+            continue;
+        }
+        const uintptr_t end = slot.end.load(std::memory_order_acquire);
+        std::atomic<uint64_t>* dirty_bits = slot.dirty_bits.load(std::memory_order_acquire);
+        if (addr >= end || dirty_bits == nullptr) {
             continue;
         }
 
-        target_path[static_cast<size_t>(link_size)] = '\0';
-        if (std::strcmp(target_path.data(), "/dev/mali0") == 0) {
-            fds.push_back(fd);
+        const size_t page_index = static_cast<size_t>(addr - begin) / page_size;
+        const uint64_t page_bit = 1ULL << (page_index % 64);
+        std::atomic<uint64_t>* evicted_bits = slot.evicted_bits.load(std::memory_order_acquire);
+        slot.last_use.store(shadow_dirty_use_clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+
+        lock_dirty_tracked_region_pages(slot);
+        bool handled = false;
+        if (evicted_bits != nullptr &&
+            (evicted_bits[page_index / 64].load(std::memory_order_acquire) & page_bit) != 0) {
+            handled = refault_evicted_shadow_page_locked(slot, begin, evicted_bits, page_index);
+        } else {
+            dirty_bits[page_index / 64].fetch_or(page_bit, std::memory_order_acq_rel);
+            slot.writes.fetch_add(1, std::memory_order_acq_rel);
+            void* page = reinterpret_cast<void*>(begin + page_index * page_size);
+            handled = mprotect(page, page_size, PROT_READ | PROT_WRITE) == 0;
+            if (handled && should_collect_low_address_map_stats()) {
+                low_address_map_stats.local().dirty_write_faults.fetch_add(1, std::memory_order_relaxed);
+            }
         }
+        unlock_dirty_tracked_region_pages(slot);
+        return handled;
     }
 
-    closedir(dir);
+    return false;
+}
 
-    std::sort(fds.begin(), fds.end());
-    fds.erase(std::unique(fds.begin(), fds.end()), fds.end());
-    return fds;
+// Hands a signal the wrapper's handler does not own to the handler installed
+// before it, or to the default action.
+static void forward_to_previous_signal_action(const struct sigaction& previous, int sig, siginfo_t* info,
+                                              void* ctx)
+{
+    if ((previous.sa_flags & SA_SIGINFO) != 0 && previous.sa_sigaction != nullptr) {
+        previous.sa_sigaction(sig, info, ctx);
+        return;
+    }
+    if ((previous.sa_flags & SA_SIGINFO) == 0 && previous.sa_handler != SIG_DFL &&
+        previous.sa_handler != SIG_IGN && previous.sa_handler != nullptr) {
+        previous.sa_handler(sig);
+        return;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = SIG_DFL;
+    sigemptyset(&sa.sa_mask);
+    sigaction(sig, &sa, nullptr);
+    raise(sig);
 }
 
-static void release_alias_cookie(int fd, uint64_t cookie)
+static void shadow_dirty_fault_handler(int sig, siginfo_t* info, void* ctx)
 {
-    if (fd < 0 || cookie == 0) {
+    if (info != nullptr && handle_shadow_dirty_write_fault(info->si_addr)) {
         return;
     }
 
-    struct kbase_ioctl_mem_free free_request{};
-    free_request.gpu_addr = cookie;
-    ioctl(fd, KBASE_IOCTL_MEM_FREE, &free_request);
+    forward_to_previous_signal_action(shadow_dirty_previous_segv_action, sig, info, ctx);
 }
 
-static bool try_create_low_address_alias(const void* real_ptr, size_t mapped_size,
-                                         ShadowMappingInfo* out_mapping)
+static bool install_shadow_dirty_fault_handler()
 {
-    if (real_ptr == nullptr || mapped_size == 0 || out_mapping == nullptr) {
-        return false;
+    static std::once_flag install_once;
+    static bool installed = false;
+    std::call_once(install_once, []() {
+        struct sigaction action{};
+        action.sa_sigaction = shadow_dirty_fault_handler;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        installed = sigaction(SIGSEGV, &action, &shadow_dirty_previous_segv_action) == 0;
+        if (installed) {
+            LOW_ADDRESS_LOG_INFO("Low-address shadow dirty tracking enabled (write-fault based)");
+        } else {
+            LOW_ADDRESS_LOG_WARN("Low-address shadow dirty tracking unavailable: sigaction failed, errno=" +
+                                 std::to_string(errno));
+        }
+    });
+    return installed;
+}
+
+static std::shared_ptr<ShadowDirtyTracker> register_shadow_dirty_tracking(void* shadow_ptr, size_t shadow_size)
+{
+    const size_t page_size = get_page_size();
+    if (shadow_ptr == nullptr || shadow_size == 0 || (shadow_size % page_size) != 0 ||
+        !install_shadow_dirty_fault_handler()) {
+        return nullptr;
     }
 
-    const uintptr_t real_addr = reinterpret_cast<uintptr_t>(real_ptr);
-    const uintptr_t aligned_real_addr = align_down_to_page(real_addr);
-    const size_t page_offset = static_cast<size_t>(real_addr - aligned_real_addr);
-    if (page_offset > std::numeric_limits<size_t>::max() - mapped_size) {
-        return false;
+    auto tracker = std::make_shared<ShadowDirtyTracker>();
+    tracker->base = reinterpret_cast<uintptr_t>(shadow_ptr);
+    tracker->page_count = shadow_size / page_size;
+    tracker->word_count = (tracker->page_count + 63) / 64;
+    tracker->dirty_bits.reset(new std::atomic<uint64_t>[tracker->word_count]);
+    tracker->evicted_bits.reset(new std::atomic<uint64_t>[tracker->word_count]);
+    for (size_t i = 0; i < tracker->word_count; i++) {
+        tracker->dirty_bits[i].store(0, std::memory_order_relaxed);
+        tracker->evicted_bits[i].store(0, std::memory_order_relaxed);
     }
 
-    const size_t mmap_size = align_up_to_page(page_offset + mapped_size);
-    if (mmap_size == 0) {
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(dirty_tracked_region_mutex);
+        const size_t region_count = dirty_tracked_region_count.load(std::memory_order_relaxed);
+        size_t slot_index = region_count;
+        for (size_t i = 0; i < region_count; i++) {
+            if (dirty_tracked_regions[i].begin.load(std::memory_order_relaxed) == 0) {
+                slot_index = i;
+                break;
+            }
+        }
+        if (slot_index >= kMaxDirtyTrackedRegions) {
+            return nullptr;
+        }
+
+        DirtyTrackedRegionSlot& slot = dirty_tracked_regions[slot_index];
+        slot.dirty_bits.store(tracker->dirty_bits.get(), std::memory_order_release);
+        slot.evicted_bits.store(tracker->evicted_bits.get(), std::memory_order_release);
+        slot.real_base.store(0, std::memory_order_release);
+        slot.real_size.store(0, std::memory_order_release);
+        slot.last_use.store(shadow_dirty_use_clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        slot.end.store(tracker->base + shadow_size, std::memory_order_release);
+        slot.begin.store(tracker->base, std::memory_order_release);
+        if (slot_index == region_count) {
+            dirty_tracked_region_count.store(region_count + 1, std::memory_order_release);
+        }
+        tracker->slot = static_cast<int>(slot_index);
     }
 
-    const std::vector<int> mali_fds = enumerate_mali_device_fds();
-    int last_fd = -1;
-    int last_ioctl_errno = 0;
-    int last_mmap_errno = 0;
-    const char* failure_reason = "no-mali-fd";
-    if (should_trace_low_address_map_events()) {
-        LOW_ADDRESS_LOG_DEBUG("Low-address alias discovery: real=" + format_pointer(real_ptr) +
-                              ", aligned_real=" + format_hex_u64(static_cast<uint64_t>(aligned_real_addr)) +
-                              ", page_offset=" + std::to_string(page_offset) +
-                              ", mmap_size=" + format_bytes(static_cast<uint64_t>(mmap_size)) +
-                              ", candidate_fds=" + std::to_string(mali_fds.size()));
+    if (mprotect(shadow_ptr, shadow_size, PROT_READ) != 0) {
+        std::lock_guard<std::mutex> lock(dirty_tracked_region_mutex);
+        DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker->slot)];
+        slot.begin.store(0, std::memory_order_release);
+        slot.end.store(0, std::memory_order_release);
+        slot.dirty_bits.store(nullptr, std::memory_order_release);
+        slot.evicted_bits.store(nullptr, std::memory_order_release);
+        return nullptr;
     }
 
-    if (mali_fds.empty()) {
-        if (should_collect_low_address_map_stats()) {
-            LOW_ADDRESS_LOG_WARN("Low-address alias unavailable: no /dev/mali0 fd found for real=" +
-                                 format_pointer(real_ptr) +
-                                 ", size=" + format_bytes(static_cast<uint64_t>(mapped_size)));
-        }
-        return false;
+    return tracker;
+}
+
+static void unregister_shadow_dirty_tracking(const ShadowDirtyTracker& tracker)
+{
+    if (tracker.slot < 0) {
+        return;
     }
 
-    for (const int fd : mali_fds) {
-        last_fd = fd;
-        struct kbase_ioctl_mem_low32_alias_create request{};
-        request.user_addr = static_cast<uint64_t>(aligned_real_addr);
-        request.size = static_cast<uint64_t>(mmap_size);
+    std::lock_guard<std::mutex> lock(dirty_tracked_region_mutex);
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker.slot)];
+    slot.begin.store(0, std::memory_order_release);
+    slot.end.store(0, std::memory_order_release);
+    slot.dirty_bits.store(nullptr, std::memory_order_release);
+    slot.evicted_bits.store(nullptr, std::memory_order_release);
+    slot.real_base.store(0, std::memory_order_release);
+    slot.real_size.store(0, std::memory_order_release);
+}
 
-        if (should_trace_low_address_map_events()) {
-            LOW_ADDRESS_LOG_DEBUG("Low-address alias ioctl attempt: fd=" + std::to_string(fd) +
-                                  ", user_addr=" + format_hex_u64(request.user_addr) +
-                                  ", size=" + format_bytes(request.size));
-        }
+// Points evicted-page refills at the current real mapping; nullptr while the
+// view is parked and the real mapping is gone.
+static void set_shadow_dirty_tracking_source(const ShadowDirtyTracker& tracker, void* real_ptr, size_t real_size)
+{
+    if (tracker.slot < 0) {
+        return;
+    }
 
-        if (ioctl(fd, KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE, &request) != 0) {
-            last_ioctl_errno = errno;
-            failure_reason = "ioctl-failed";
-            if (should_collect_low_address_map_stats()) {
-                LOW_ADDRESS_LOG_INFO("Low-address alias ioctl failed: fd=" + std::to_string(fd) +
-                                     ", user_addr=" + format_hex_u64(request.user_addr) +
-                                     ", size=" + format_bytes(request.size) +
-                                     ", errno=" + std::to_string(last_ioctl_errno));
-            }
-            continue;
-        }
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker.slot)];
+    slot.real_size.store(real_ptr != nullptr ? real_size : 0, std::memory_order_release);
+    slot.real_base.store(reinterpret_cast<uintptr_t>(real_ptr), std::memory_order_release);
+    slot.last_use.store(shadow_dirty_use_clock.fetch_add(1, std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+}
 
-        if (should_trace_low_address_map_events()) {
-            LOW_ADDRESS_LOG_DEBUG("Low-address alias ioctl succeeded: fd=" + std::to_string(fd) +
-                                  ", cookie=" + format_hex_u64(request.cookie));
-        }
+static size_t get_shadow_resident_bytes(const ShadowMappingInfo& mapping)
+{
+    if (mapping.mode != LowAddressMapMode::SHADOW) {
+        return 0;
+    }
 
-        void* mapped_base =
-            mmap(nullptr, mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, request.cookie);
-        if (mapped_base == MAP_FAILED) {
-            last_mmap_errno = errno;
-            failure_reason = "mmap-failed";
-            if (should_trace_low_address_map_events()) {
-                LOW_ADDRESS_LOG_DEBUG("Low-address alias mmap failed: fd=" + std::to_string(fd) +
-                                      ", cookie=" + format_hex_u64(request.cookie) +
-                                      ", errno=" + std::to_string(last_mmap_errno));
-            }
-            release_alias_cookie(fd, request.cookie);
-            continue;
+    size_t evicted_pages = 0;
+    if (mapping.dirty_tracker != nullptr) {
+        for (size_t i = 0; i < mapping.dirty_tracker->word_count; i++) {
+            evicted_pages += static_cast<size_t>(
+                __builtin_popcountll(mapping.dirty_tracker->evicted_bits[i].load(std::memory_order_acquire)));
         }
+    }
+    return mapping.shadow_size - std::min(mapping.shadow_size, evicted_pages * get_page_size());
+}
 
-        void* low_ptr = static_cast<void*>(static_cast<uint8_t*>(mapped_base) + page_offset);
-        if (!is_pointer_32bit_compatible(low_ptr)) {
-            failure_reason = "landed-above-4g";
-            if (should_trace_low_address_map_events()) {
-                LOW_ADDRESS_LOG_DEBUG("Low-address alias landed above 4 GiB: fd=" +
-                                      std::to_string(fd) +
-                                      ", mapped_base=" + format_pointer(mapped_base) +
-                                      ", low_ptr=" + format_pointer(low_ptr));
-            }
-            munmap(mapped_base, mmap_size);
-            continue;
-        }
+// For callers about to overwrite the whole shadow with the pages unprotected;
+// the contents of evicted pages no longer matter.
+static void forget_evicted_shadow_pages(const ShadowDirtyTracker& tracker)
+{
+    size_t evicted_pages = 0;
+    for (size_t i = 0; i < tracker.word_count; i++) {
+        evicted_pages += static_cast<size_t>(
+            __builtin_popcountll(tracker.evicted_bits[i].exchange(0, std::memory_order_acq_rel)));
+    }
+    low_address_shadow_resident_bytes.fetch_add(evicted_pages * get_page_size(), std::memory_order_relaxed);
+}
 
-        out_mapping->real_ptr = const_cast<void*>(real_ptr);
-        out_mapping->shadow_ptr = low_ptr;
-        out_mapping->shadow_size = 0;
-        out_mapping->mode = LowAddressMapMode::ALIAS;
-        out_mapping->unmap_ptr = mapped_base;
-        out_mapping->unmap_size = mmap_size;
-        out_mapping->mali_fd = fd;
-        return true;
+// Discards every page of a dirty-tracked shadow and marks it evicted, so the
+// fault handler fills each page from the real mapping on its first access
+// instead of the whole shadow being copied up front. The tracking source must
+// already point at the real mapping. Returns false, leaving the shadow as it
+// was, when the pages cannot be protected.
+static bool evict_shadow_for_lazy_fill(ShadowDirtyTracker& tracker, size_t shadow_size, size_t copy_size)
+{
+    if (tracker.slot < 0) {
+        return false;
     }
 
-    if (should_collect_low_address_map_stats()) {
-        LOW_ADDRESS_LOG_INFO("Low-address alias attempt failed: real=" + format_pointer(real_ptr) +
-                             ", aligned_real=" + format_hex_u64(static_cast<uint64_t>(aligned_real_addr)) +
-                             ", mmap_size=" + format_bytes(static_cast<uint64_t>(mmap_size)) +
-                             ", candidate_fds=" + std::to_string(mali_fds.size()) +
-                             ", last_fd=" + std::to_string(last_fd) +
-                             ", reason=" + std::string(failure_reason) +
-                             ", last_ioctl_errno=" + std::to_string(last_ioctl_errno) +
-                             ", last_mmap_errno=" + std::to_string(last_mmap_errno));
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker.slot)];
+    void* shadow = reinterpret_cast<void*>(tracker.base);
+    size_t evicted_pages = 0;
+    lock_dirty_tracked_region_pages(slot);
+    if (mprotect(shadow, shadow_size, PROT_NONE) != 0) {
+        unlock_dirty_tracked_region_pages(slot);
+        return false;
     }
+    madvise(shadow, shadow_size, MADV_DONTNEED);
+    for (size_t i = 0; i < tracker.word_count; i++) {
+        const size_t pages_in_word = std::min<size_t>(64, tracker.page_count - i * 64);
+        const uint64_t word_mask = pages_in_word == 64 ? ~0ULL : (1ULL << pages_in_word) - 1;
+        tracker.dirty_bits[i].store(0, std::memory_order_release);
+        const uint64_t previous = tracker.evicted_bits[i].exchange(word_mask, std::memory_order_acq_rel);
+        evicted_pages += static_cast<size_t>(__builtin_popcountll(word_mask & ~previous));
+    }
+    unlock_dirty_tracked_region_pages(slot);
 
-    return false;
+    low_address_shadow_resident_bytes.fetch_sub(evicted_pages * get_page_size(), std::memory_order_relaxed);
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().lazy_fill_skipped_bytes.fetch_add(copy_size, std::memory_order_relaxed);
+    }
+    return true;
 }
 
-static ShadowAllocationResult allocate_low_address_shadow(size_t requested_size)
+// Refills evicted pages covering the byte range before a caller unprotects
+// them, so partially overwritten pages keep their surrounding contents.
+static void restore_evicted_shadow_pages(const ShadowMappingInfo& mapping, size_t byte_offset, size_t byte_count)
 {
-    ShadowAllocationResult result{};
-    if (requested_size == 0) {
-        return result;
+    const ShadowDirtyTracker* tracker = mapping.dirty_tracker.get();
+    if (tracker == nullptr || tracker->slot < 0 || byte_count == 0) {
+        return;
     }
 
-    long page_size_value = sysconf(_SC_PAGESIZE);
-    if (page_size_value <= 0) {
-        page_size_value = 4096;
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker->slot)];
+    const size_t page_size = get_page_size();
+    const size_t first_page = byte_offset / page_size;
+    const size_t last_page = std::min((byte_offset + byte_count - 1) / page_size, tracker->page_count - 1);
+    lock_dirty_tracked_region_pages(slot);
+    for (size_t page = first_page; page <= last_page; page++) {
+        refault_evicted_shadow_page_locked(slot, tracker->base, tracker->evicted_bits.get(), page);
     }
+    unlock_dirty_tracked_region_pages(slot);
+}
 
-    const size_t page_size = static_cast<size_t>(page_size_value);
-    const size_t aligned_size = ((requested_size + page_size - 1) / page_size) * page_size;
-    if (aligned_size == 0 || aligned_size < requested_size) {
-        return result;
+static void mark_shadow_range_dirty(const ShadowMappingInfo& mapping, size_t byte_offset, size_t byte_count)
+{
+    const ShadowDirtyTracker* tracker = mapping.dirty_tracker.get();
+    if (tracker == nullptr || byte_count == 0) {
+        return;
     }
 
-    if (should_trace_low_address_map_events()) {
-        LOW_ADDRESS_LOG_DEBUG("Low-address allocation request: requested=" +
-                              format_bytes(static_cast<uint64_t>(requested_size)) +
-                              ", aligned=" + format_bytes(static_cast<uint64_t>(aligned_size)));
+    const size_t page_size = get_page_size();
+    const size_t first_page = byte_offset / page_size;
+    const size_t last_page = std::min((byte_offset + byte_count - 1) / page_size, tracker->page_count - 1);
+    for (size_t page = first_page; page <= last_page; page++) {
+        tracker->dirty_bits[page / 64].fetch_or(1ULL << (page % 64), std::memory_order_acq_rel);
+    }
+    if (tracker->slot >= 0) {
+        dirty_tracked_regions[static_cast<size_t>(tracker->slot)].writes.fetch_add(1, std::memory_order_acq_rel);
     }
+}
 
-    const bool collect_stats = should_collect_low_address_map_stats();
-    const auto start_time = collect_stats ? std::chrono::steady_clock::now()
-                                          : std::chrono::steady_clock::time_point{};
+// Writes back only the shadow pages dirtied since the previous sync. Each
+// dirty run is re-protected before it is copied so writes racing with the
+// copy fault again and are picked up by the next sync. Returns the number of
+// pages copied.
+static uint64_t sync_dirty_shadow_pages_locked(ShadowMappingInfo& mapping, LowAddressCopyKind kind)
+{
+    ShadowDirtyTracker* tracker = mapping.dirty_tracker.get();
+    std::lock_guard<std::mutex> sync_lock(tracker->sync_mutex);
+    const size_t page_size = get_page_size();
+    const size_t mapped_size = static_cast<size_t>(mapping.mapped_size);
+    const size_t page_count = std::min(tracker->page_count, (mapped_size + page_size - 1) / page_size);
+    const size_t word_count = (page_count + 63) / 64;
+    auto* shadow_bytes = static_cast<uint8_t*>(mapping.shadow_ptr);
+    auto* real_bytes = static_cast<uint8_t*>(mapping.real_ptr);
+
+    // The fault handler marks a page dirty and unprotects it under the slot's
+    // page lock. Claiming the bits and re-protecting their runs under the same
+    // lock keeps a handler from unprotecting a page after this sync has
+    // claimed and re-protected it, which would let the faulting write land
+    // unrecorded. The copies run after the lock is dropped.
+    thread_local std::vector<std::pair<size_t, size_t>> runs;
+    runs.clear();
+    auto flush_run = [&](size_t first_page, size_t end_page) {
+        mprotect(shadow_bytes + first_page * page_size, (end_page - first_page) * page_size, PROT_READ);
+        runs.emplace_back(first_page, end_page);
+    };
+
+    DirtyTrackedRegionSlot* slot =
+        tracker->slot >= 0 ? &dirty_tracked_regions[static_cast<size_t>(tracker->slot)] : nullptr;
+    if (slot != nullptr) {
+        lock_dirty_tracked_region_pages(*slot);
+    }
+
+    constexpr size_t kNoRun = std::numeric_limits<size_t>::max();
+    size_t run_start = kNoRun;
+    for (size_t word = 0; word < word_count; word++) {
+        const uint64_t bits = tracker->dirty_bits[word].exchange(0, std::memory_order_acq_rel);
+        if ((bits == 0 && run_start == kNoRun) || (bits == ~0ULL && run_start != kNoRun)) {
+            continue;
+        }
 
-#ifdef MAP_32BIT
-    void* mapped = mmap(nullptr, aligned_size, PROT_READ | PROT_WRITE,
-                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
-    if (mapped != MAP_FAILED) {
-        const uint64_t mapped_addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(mapped));
-        const uint64_t mapped_end = mapped_addr + static_cast<uint64_t>(aligned_size);
-        if (mapped_end <= kMax32BitAddressExclusive) {
-            result.ptr = mapped;
-            result.size = aligned_size;
-            result.method = ShadowAllocationMethod::MAP_32BIT;
-            if (collect_stats) {
-                result.elapsed_ns = static_cast<uint64_t>(
-                    std::chrono::duration_cast<std::chrono::nanoseconds>(
-                        std::chrono::steady_clock::now() - start_time).count());
+        for (size_t bit = 0; bit < 64; bit++) {
+            const size_t page = word * 64 + bit;
+            if (page >= page_count) {
+                break;
             }
-            return result;
-        }
-        if (should_trace_low_address_map_events()) {
-            LOW_ADDRESS_LOG_DEBUG("Low-address MAP_32BIT candidate discarded: ptr=" +
-                                  format_pointer(mapped) +
-                                  ", size=" + format_bytes(static_cast<uint64_t>(aligned_size)));
-        }
-        munmap(mapped, aligned_size);
-    } else {
-        result.last_errno = errno;
-    }
-#endif
 
-    for (uintptr_t addr = kShadowSearchStart;
-         addr < kShadowSearchEnd &&
-             static_cast<uint64_t>(addr) + static_cast<uint64_t>(aligned_size) < kMax32BitAddressExclusive;
-         addr += kShadowSearchStep) {
-        result.fixed_search_attempts++;
-        void* mapped = mmap(reinterpret_cast<void*>(addr), aligned_size, PROT_READ | PROT_WRITE,
-                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
-        if (mapped != MAP_FAILED) {
-            result.ptr = mapped;
-            result.size = aligned_size;
-            result.method = ShadowAllocationMethod::FIXED_SEARCH;
-            if (collect_stats) {
-                result.elapsed_ns = static_cast<uint64_t>(
-                    std::chrono::duration_cast<std::chrono::nanoseconds>(
-                        std::chrono::steady_clock::now() - start_time).count());
+            if ((bits & (1ULL << bit)) != 0) {
+                if (run_start == kNoRun) {
+                    run_start = page;
+                }
+            } else if (run_start != kNoRun) {
+                flush_run(run_start, page);
+                run_start = kNoRun;
             }
-            return result;
         }
+    }
+    if (run_start != kNoRun) {
+        flush_run(run_start, page_count);
+    }
+    if (slot != nullptr) {
+        unlock_dirty_tracked_region_pages(*slot);
+    }
 
-        result.last_errno = errno;
-        if (result.last_errno != EEXIST && result.last_errno != EINVAL &&
-            result.last_errno != ENOMEM && result.last_errno != EBUSY) {
-            break;
-        }
+    uint64_t dirty_pages = 0;
+    size_t copied_bytes = 0;
+    for (const auto& run : runs) {
+        const size_t run_offset = run.first * page_size;
+        const size_t copy_size = std::min((run.second - run.first) * page_size, mapped_size - run_offset);
+        tracked_memcpy(real_bytes + run_offset, shadow_bytes + run_offset, copy_size, kind, mapping.memory_flags);
+        dirty_pages += static_cast<uint64_t>(run.second - run.first);
+        copied_bytes += copy_size;
     }
 
-    if (collect_stats) {
-        result.elapsed_ns = static_cast<uint64_t>(
-            std::chrono::duration_cast<std::chrono::nanoseconds>(
-                std::chrono::steady_clock::now() - start_time).count());
+    if (dirty_pages > 0 && tracker->slot >= 0) {
+        dirty_tracked_regions[static_cast<size_t>(tracker->slot)].last_use.store(
+            shadow_dirty_use_clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     }
-    return result;
+
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().submit_dirty_pages.fetch_add(dirty_pages, std::memory_order_relaxed);
+        low_address_map_stats.local().submit_clean_bytes_skipped.fetch_add(
+            static_cast<uint64_t>(mapped_size - copied_bytes), std::memory_order_relaxed);
+    }
+    return dirty_pages;
 }
 
-static void remove_tracking_for_device(VkDevice device)
+// Flushes the byte range of a dirty-tracked shadow. Clean pages, evicted ones
+// included, have not been written since they were last synced and are
+// skipped. Dirty pages the range covers completely are re-protected, copied
+// whole and marked clean, so the next submit does not copy them again. Pages
+// the range only partly covers get just the covered bytes copied and stay
+// dirty, since the rest of the page may hold writes that were not flushed.
+static void flush_dirty_shadow_range_locked(ShadowMappingInfo& mapping, size_t byte_offset, size_t byte_count)
 {
-    std::vector<ShadowMappingInfo> stale_mappings;
-
-    {
-        std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-        for (auto it = shadow_mappings.begin(); it != shadow_mappings.end(); ) {
-            if (it->first.device == device) {
-                stale_mappings.push_back(it->second);
-                it = shadow_mappings.erase(it);
-            } else {
-                ++it;
-            }
+    ShadowDirtyTracker* tracker = mapping.dirty_tracker.get();
+    std::lock_guard<std::mutex> sync_lock(tracker->sync_mutex);
+    const size_t page_size = get_page_size();
+    const size_t mapped_size = static_cast<size_t>(mapping.mapped_size);
+    const size_t range_end = byte_offset + byte_count;
+    auto* shadow_bytes = static_cast<uint8_t*>(mapping.shadow_ptr);
+    auto* real_bytes = static_cast<uint8_t*>(mapping.real_ptr);
+
+    // Bits are claimed and runs re-protected under the slot's page lock, as
+    // in sync_dirty_shadow_pages_locked(); the copies run after it.
+    thread_local std::vector<std::pair<size_t, size_t>> copies;
+    copies.clear();
+    size_t run_begin = 0;
+    size_t run_end = 0;
+    auto flush_run = [&]() {
+        if (run_end == run_begin) {
+            return;
         }
-
-        for (auto it = tracked_memory_allocations.begin(); it != tracked_memory_allocations.end(); ) {
-            if (it->first.device == device) {
-                it = tracked_memory_allocations.erase(it);
-            } else {
-                ++it;
+        mprotect(shadow_bytes + run_begin, align_up_to_page(run_end - run_begin), PROT_READ);
+        copies.emplace_back(run_begin, run_end);
+        run_begin = run_end = 0;
+    };
+
+    DirtyTrackedRegionSlot* slot =
+        tracker->slot >= 0 ? &dirty_tracked_regions[static_cast<size_t>(tracker->slot)] : nullptr;
+    if (slot != nullptr) {
+        lock_dirty_tracked_region_pages(*slot);
+    }
+
+    const size_t last_page = std::min((range_end - 1) / page_size, tracker->page_count - 1);
+    for (size_t page = byte_offset / page_size; page <= last_page; page++) {
+        const size_t page_begin = page * page_size;
+        const size_t page_limit = std::min(page_begin + page_size, mapped_size);
+        const uint64_t page_bit = 1ULL << (page % 64);
+        std::atomic<uint64_t>& dirty_word = tracker->dirty_bits[page / 64];
+
+        if (byte_offset <= page_begin && range_end >= page_limit) {
+            if ((dirty_word.fetch_and(~page_bit, std::memory_order_acq_rel) & page_bit) == 0) {
+                flush_run();
+                continue;
             }
+            if (run_end != page_begin) {
+                flush_run();
+                run_begin = page_begin;
+            }
+            run_end = page_limit;
+            continue;
         }
-    }
 
-    uint64_t released_mapping_bytes = 0;
-    for (const auto& mapping : stale_mappings) {
-        if (mapping.mode == LowAddressMapMode::SHADOW && mapping.shadow_size > 0) {
-            record_shadow_mapping_removed(mapping.shadow_size);
-        }
-        if (mapping.unmap_ptr != nullptr && mapping.unmap_size > 0) {
-            released_mapping_bytes += static_cast<uint64_t>(mapping.unmap_size);
-            munmap(mapping.unmap_ptr, mapping.unmap_size);
+        flush_run();
+        if ((dirty_word.load(std::memory_order_acquire) & page_bit) != 0) {
+            copies.emplace_back(std::max(byte_offset, page_begin), std::min(range_end, page_limit));
         }
     }
+    flush_run();
+    if (slot != nullptr) {
+        unlock_dirty_tracked_region_pages(*slot);
+    }
 
-    if (!stale_mappings.empty()) {
-        LOW_ADDRESS_LOG_INFO("Low-address device cleanup: device=" + format_pointer(device) +
-                             ", stale_mappings=" + std::to_string(stale_mappings.size()) +
-                             ", released=" + format_bytes(released_mapping_bytes));
+    for (const auto& copy : copies) {
+        tracked_memcpy(real_bytes + copy.first, shadow_bytes + copy.first, copy.second - copy.first,
+                       LowAddressCopyKind::FLUSH_TO_REAL, mapping.memory_flags);
     }
 }
 
-void add_instance_reference(VkInstance instance) {
-    std::lock_guard<std::mutex> lock(instance_mutex);
-    auto it = managed_instances.find(instance);
-    if (it != managed_instances.end()) {
-        it->second->ref_count++;
+// Writes back a dirty-tracked shadow and hands its clean pages back to the
+// kernel. The address range stays reserved; evicted pages are PROT_NONE and
+// refilled from the real mapping by the fault handler on their next access.
+// Returns the number of bytes reclaimed.
+static size_t page_out_shadow_mapping_locked(ShadowMappingInfo& mapping)
+{
+    ShadowDirtyTracker* tracker = mapping.dirty_tracker.get();
+    if (mapping.mode != LowAddressMapMode::SHADOW || tracker == nullptr || tracker->slot < 0 ||
+        mapping.real_ptr == nullptr || mapping.shadow_ptr == nullptr) {
+        return 0;
+    }
+
+    sync_dirty_shadow_pages_locked(mapping, LowAddressCopyKind::FLUSH_TO_REAL);
+
+    std::lock_guard<std::mutex> sync_lock(tracker->sync_mutex);
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker->slot)];
+    const size_t page_size = get_page_size();
+    auto* shadow_bytes = static_cast<uint8_t*>(mapping.shadow_ptr);
+    size_t evicted_pages = 0;
+
+    auto evict_run = [&](size_t first_page, size_t end_page) {
+        void* run = shadow_bytes + first_page * page_size;
+        const size_t run_bytes = (end_page - first_page) * page_size;
+        if (mprotect(run, run_bytes, PROT_NONE) != 0) {
+            return;
+        }
+        madvise(run, run_bytes, MADV_DONTNEED);
+        for (size_t page = first_page; page < end_page; page++) {
+            tracker->evicted_bits[page / 64].fetch_or(1ULL << (page % 64), std::memory_order_acq_rel);
+        }
+        evicted_pages += end_page - first_page;
+    };
+
+    // Holding page_lock keeps writers in the fault handler until the run is
+    // evicted, so a page cannot turn dirty between the check and the discard.
+    lock_dirty_tracked_region_pages(slot);
+    constexpr size_t kNoRun = std::numeric_limits<size_t>::max();
+    size_t run_start = kNoRun;
+    for (size_t page = 0; page < tracker->page_count; page++) {
+        const uint64_t page_bit = 1ULL << (page % 64);
+        const bool evictable =
+            ((tracker->dirty_bits[page / 64].load(std::memory_order_acquire) |
+              tracker->evicted_bits[page / 64].load(std::memory_order_acquire)) & page_bit) == 0;
+        if (evictable) {
+            if (run_start == kNoRun) {
+                run_start = page;
+            }
+        } else if (run_start != kNoRun) {
+            evict_run(run_start, page);
+            run_start = kNoRun;
+        }
     }
+    if (run_start != kNoRun) {
+        evict_run(run_start, tracker->page_count);
+    }
+    unlock_dirty_tracked_region_pages(slot);
+
+    const size_t evicted_bytes = evicted_pages * page_size;
+    low_address_shadow_resident_bytes.fetch_sub(evicted_bytes, std::memory_order_relaxed);
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().budget_page_evictions.fetch_add(evicted_pages, std::memory_order_relaxed);
+    }
+    return evicted_bytes;
 }
 
-void remove_instance_reference(VkInstance instance) {
-    bool should_cleanup = false;
+static bool release_to_shadow_arena(void* ptr, size_t size);
+
+static void release_low_address_mapping(const ShadowMappingInfo& mapping)
+{
+    if (mapping.mode == LowAddressMapMode::SHADOW) {
+        low_address_shadow_resident_bytes.fetch_sub(get_shadow_resident_bytes(mapping), std::memory_order_relaxed);
+    }
+    if (mapping.dirty_tracker != nullptr) {
+        unregister_shadow_dirty_tracking(*mapping.dirty_tracker);
+    }
+    if (mapping.retired_dirty_tracker != nullptr) {
+        unregister_shadow_dirty_tracking(*mapping.retired_dirty_tracker);
+    }
+    if (mapping.unmap_ptr != nullptr && mapping.unmap_size > 0) {
+        if (mapping.placed) {
+            if (mapping.reserve_on_release &&
+                mmap(mapping.unmap_ptr, mapping.unmap_size, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0) != MAP_FAILED) {
+                return;
+            }
+        } else if (mapping.mode == LowAddressMapMode::SHADOW &&
+                   release_to_shadow_arena(mapping.unmap_ptr, mapping.unmap_size)) {
+            return;
+        }
+        munmap(mapping.unmap_ptr, mapping.unmap_size);
+    }
+}
+
+static void release_low_address_mappings(const std::vector<ShadowMappingInfo>& mappings)
+{
+    for (const auto& mapping : mappings) {
+        if (mapping.mode == LowAddressMapMode::SHADOW && mapping.shadow_size > 0) {
+            record_shadow_mapping_removed(mapping.shadow_size);
+        }
+        release_low_address_mapping(mapping);
+    }
+}
+
+static void evict_cached_low_address_mapping_locked(
+    std::unordered_map<DeviceMemoryKey, CachedLowAddressMapping, DeviceMemoryKeyHash>::iterator it,
+    std::vector<ShadowMappingInfo>* out_evicted)
+{
+    cached_low_address_mapping_bytes -= it->second.mapping.unmap_size;
+    out_evicted->push_back(std::move(it->second.mapping));
+    cached_low_address_mappings.erase(it);
+}
+
+// Parks an unmapped view for reuse and evicts least recently parked entries
+// once the cache is over its entry or byte budget.
+static bool cache_low_address_mapping_locked(const DeviceMemoryKey& key, const ShadowMappingInfo& mapping,
+                                             std::vector<ShadowMappingInfo>* out_evicted)
+{
+    if (mapping.placed || mapping.unmap_ptr == nullptr || mapping.unmap_size == 0 ||
+        mapping.unmap_size > kMaxCachedLowAddressMappingBytes) {
+        return false;
+    }
+
+    auto existing = cached_low_address_mappings.find(key);
+    if (existing != cached_low_address_mappings.end()) {
+        evict_cached_low_address_mapping_locked(existing, out_evicted);
+    }
+
+    CachedLowAddressMapping entry{};
+    entry.mapping = mapping;
+    entry.last_use = ++cached_low_address_mapping_clock;
+    cached_low_address_mappings.emplace(key, std::move(entry));
+    cached_low_address_mapping_bytes += mapping.unmap_size;
+
+    while (cached_low_address_mappings.size() > kMaxCachedLowAddressMappings ||
+           cached_low_address_mapping_bytes > kMaxCachedLowAddressMappingBytes) {
+        auto oldest = std::min_element(
+            cached_low_address_mappings.begin(), cached_low_address_mappings.end(),
+            [](const auto& lhs, const auto& rhs) { return lhs.second.last_use < rhs.second.last_use; });
+        evict_cached_low_address_mapping_locked(oldest, out_evicted);
+        if (should_collect_low_address_map_stats()) {
+            low_address_map_stats.local().mapping_cache_evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
+
+// Removes the parked view for key. Returns true only when it can back a map of
+// real_ptr/offset/size; a mismatching view is handed back for release instead.
+// Alias views must see the same real pages, while shadows are refilled by the
+// caller and only need the same size. Eager aliases were made from a mapping
+// that no longer exists and only need the same offset and size.
+static bool take_cached_low_address_mapping_locked(const DeviceMemoryKey& key, const void* real_ptr,
+                                                   VkDeviceSize offset, VkDeviceSize size,
+                                                   ShadowMappingInfo* out_mapping,
+                                                   std::vector<ShadowMappingInfo>* out_evicted)
+{
+    auto it = cached_low_address_mappings.find(key);
+    if (it == cached_low_address_mappings.end()) {
+        return false;
+    }
+
+    const ShadowMappingInfo& cached = it->second.mapping;
+    const bool reusable = cached.mapped_size == size &&
+        (cached.mode == LowAddressMapMode::SHADOW ||
+         ((cached.real_ptr == real_ptr || cached.eager) && cached.offset == offset));
+    if (!reusable) {
+        evict_cached_low_address_mapping_locked(it, out_evicted);
+        return false;
+    }
+
+    cached_low_address_mapping_bytes -= cached.unmap_size;
+    *out_mapping = std::move(it->second.mapping);
+    cached_low_address_mappings.erase(it);
+    return true;
+}
+
+static void drop_cached_low_address_mappings_locked(VkDevice device, std::vector<ShadowMappingInfo>* out_evicted)
+{
+    for (auto it = cached_low_address_mappings.begin(); it != cached_low_address_mappings.end(); ) {
+        auto current = it++;
+        if (device == VK_NULL_HANDLE || current->first.device == device) {
+            evict_cached_low_address_mapping_locked(current, out_evicted);
+        }
+    }
+}
+
+// Brings resident shadow memory back under the budget before incoming_bytes
+// more are committed. Parked shadow views are dropped first, least recently
+// parked first; after that the least recently used dirty-tracked shadows are
+// paged out. Plain shadows cannot be refilled lazily and are never evicted.
+static void enforce_low_address_shadow_budget(size_t incoming_bytes)
+{
+    const size_t budget = get_low_address_shadow_budget_bytes();
+    if (budget == 0) {
+        return;
+    }
+
+    uint64_t resident = low_address_shadow_resident_bytes.load(std::memory_order_relaxed);
+    auto over_budget = [&]() { return resident + incoming_bytes > budget; };
+    if (!over_budget()) {
+        return;
+    }
+
+    std::vector<ShadowMappingInfo> evicted;
     {
-        std::lock_guard<std::mutex> lock(instance_mutex);
-        auto it = managed_instances.find(instance);
-        if (it != managed_instances.end()) {
-            it->second->ref_count--;
+        auto lock = lock_shadow_mappings_exclusive();
+        while (over_budget()) {
+            auto oldest = cached_low_address_mappings.end();
+            for (auto it = cached_low_address_mappings.begin(); it != cached_low_address_mappings.end(); ++it) {
+                if (it->second.mapping.mode == LowAddressMapMode::SHADOW &&
+                    (oldest == cached_low_address_mappings.end() || it->second.last_use < oldest->second.last_use)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == cached_low_address_mappings.end()) {
+                break;
+            }
+            resident -= std::min<uint64_t>(resident, get_shadow_resident_bytes(oldest->second.mapping));
+            evict_cached_low_address_mapping_locked(oldest, &evicted);
+        }
 
-            if (it->second->marked_for_destruction && it->second->ref_count <= 0) {
-                should_cleanup = true;
-                managed_instances.erase(it);
+        if (over_budget()) {
+            std::vector<std::pair<uint64_t, ShadowMappingInfo*>> candidates;
+            for (auto& entry : shadow_mappings) {
+                const ShadowMappingInfo& mapping = entry.second;
+                if (mapping.mode == LowAddressMapMode::SHADOW && mapping.dirty_tracker != nullptr &&
+                    mapping.dirty_tracker->slot >= 0) {
+                    const DirtyTrackedRegionSlot& slot =
+                        dirty_tracked_regions[static_cast<size_t>(mapping.dirty_tracker->slot)];
+                    candidates.emplace_back(slot.last_use.load(std::memory_order_relaxed), &entry.second);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+            for (const auto& candidate : candidates) {
+                if (!over_budget()) {
+                    break;
+                }
+                resident -= std::min<uint64_t>(resident, page_out_shadow_mapping_locked(*candidate.second));
             }
         }
     }
 
-    if (should_cleanup) {
-        LOG_INFO("Performing delayed instance cleanup for instance with 0 references");
-        GetWSIManager().release_instance(instance);
+    if (!evicted.empty() && should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().budget_view_evictions.fetch_add(evicted.size(), std::memory_order_relaxed);
     }
+    release_low_address_mappings(evicted);
 }
 
-bool is_instance_valid(VkInstance instance) {
-    std::lock_guard<std::mutex> lock(instance_mutex);
-    auto it = managed_instances.find(instance);
-    return (it != managed_instances.end() && !it->second->marked_for_destruction);
+static std::vector<int> enumerate_mali_device_fds()
+{
+    std::vector<int> fds;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == nullptr) {
+        return fds;
+    }
+
+    const int proc_dir_fd = dirfd(dir);
+    for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        char* end = nullptr;
+        const long parsed_fd = std::strtol(entry->d_name, &end, 10);
+        if (end == nullptr || *end != '\0' || parsed_fd < 0 ||
+            parsed_fd > std::numeric_limits<int>::max()) {
+            continue;
+        }
+
+        const int fd = static_cast<int>(parsed_fd);
+        if (fd == proc_dir_fd) {
+            continue;
+        }
+
+        std::array<char, 64> proc_path{};
+        std::snprintf(proc_path.data(), proc_path.size(), "/proc/self/fd/%d", fd);
+
+        std::array<char, 256> target_path{};
+        const ssize_t link_size =
+            readlink(proc_path.data(), target_path.data(), target_path.size() - 1);
+        if (link_size <= 0) {
+            continue;
+        }
+
+        target_path[static_cast<size_t>(link_size)] = '\0';
+        if (std::strcmp(target_path.data(), "/dev/mali0") == 0) {
+            fds.push_back(fd);
+        }
+    }
+
+    closedir(dir);
+
+    std::sort(fds.begin(), fds.end());
+    fds.erase(std::unique(fds.begin(), fds.end()), fds.end());
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().alias_fd_scans.fetch_add(1, std::memory_order_relaxed);
+    }
+    return fds;
 }
 
-template <typename T>
-static T resolve_mali_device_proc(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device, const char* proc_name)
+// Returns the candidate fds for an alias attempt, preferred fd first. The
+// /proc/self/fd scan only runs when the cache is empty or rescan is set.
+static std::vector<int> get_mali_device_fds(MaliDeviceFdCache* cache, bool rescan)
 {
-    if (get_device_proc_addr == nullptr || proc_name == nullptr) {
-        return nullptr;
+    if (cache == nullptr) {
+        return enumerate_mali_device_fds();
     }
 
-    return reinterpret_cast<T>(get_device_proc_addr(device, proc_name));
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+        if (!rescan && !cache->fds.empty()) {
+            std::vector<int> fds = cache->fds;
+            auto preferred = std::find(fds.begin(), fds.end(), cache->preferred_fd);
+            if (preferred != fds.end()) {
+                std::rotate(fds.begin(), preferred, preferred + 1);
+            }
+            return fds;
+        }
+    }
+
+    std::vector<int> fds = enumerate_mali_device_fds();
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->fds = fds;
+    if (std::find(fds.begin(), fds.end(), cache->preferred_fd) == fds.end()) {
+        cache->preferred_fd = -1;
+    }
+    return fds;
 }
 
-static std::shared_ptr<const ManagedDeviceDispatch> create_managed_device_dispatch(VkDevice device, VkInstance parent_instance)
+static void remember_mali_alias_fd(MaliDeviceFdCache* cache, int fd)
 {
-    auto dispatch = std::make_shared<ManagedDeviceDispatch>();
-    dispatch->device = device;
-    dispatch->parent_instance = parent_instance;
+    if (cache == nullptr) {
+        return;
+    }
 
-    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
-    if (mali_proc_addr == nullptr || device == VK_NULL_HANDLE || parent_instance == VK_NULL_HANDLE) {
-        return dispatch;
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    cache->preferred_fd = fd;
+}
+
+static void release_alias_cookie(int fd, uint64_t cookie)
+{
+    if (fd < 0 || cookie == 0) {
+        return;
     }
 
-    dispatch->get_device_proc_addr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
-        mali_proc_addr(parent_instance, "vkGetDeviceProcAddr"));
-    if (dispatch->get_device_proc_addr == nullptr) {
-        return dispatch;
+    struct kbase_ioctl_mem_free free_request{};
+    free_request.gpu_addr = cookie;
+    ioctl(fd, KBASE_IOCTL_MEM_FREE, &free_request);
+}
+
+// Sends an empty alias request to the device's kbase fds. Unpatched kernels
+// reject the unknown ioctl number with ENOTTY, while the patched one rejects
+// the zero size with a different errno. EPERM and EBADF come from fds that
+// are not set-up kbase contexts and say nothing either way.
+static LowAddressAliasSupport probe_low_address_alias_support(MaliDeviceFdCache* fd_cache)
+{
+    const std::vector<int> mali_fds = get_mali_device_fds(fd_cache, false);
+    LowAddressAliasSupport support = LowAddressAliasSupport::UNKNOWN;
+    for (const int fd : mali_fds) {
+        struct kbase_ioctl_mem_low32_alias_create request{};
+        if (ioctl(fd, KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE, &request) == 0) {
+            release_alias_cookie(fd, request.cookie);
+            return LowAddressAliasSupport::SUPPORTED;
+        }
+
+        const int probe_errno = errno;
+        if (probe_errno == ENOTTY) {
+            support = LowAddressAliasSupport::UNSUPPORTED;
+        } else if (probe_errno != EPERM && probe_errno != EBADF) {
+            return LowAddressAliasSupport::SUPPORTED;
+        }
     }
 
-    dispatch->destroy_device = resolve_mali_device_proc<PFN_vkDestroyDevice>(
-        dispatch->get_device_proc_addr, device, "vkDestroyDevice");
-    dispatch->allocate_memory = resolve_mali_device_proc<PFN_vkAllocateMemory>(
-        dispatch->get_device_proc_addr, device, "vkAllocateMemory");
-    dispatch->free_memory = resolve_mali_device_proc<PFN_vkFreeMemory>(
-        dispatch->get_device_proc_addr, device, "vkFreeMemory");
-    dispatch->map_memory = resolve_mali_device_proc<PFN_vkMapMemory>(
-        dispatch->get_device_proc_addr, device, "vkMapMemory");
-    dispatch->unmap_memory = resolve_mali_device_proc<PFN_vkUnmapMemory>(
-        dispatch->get_device_proc_addr, device, "vkUnmapMemory");
-    dispatch->flush_mapped_memory_ranges = resolve_mali_device_proc<PFN_vkFlushMappedMemoryRanges>(
-        dispatch->get_device_proc_addr, device, "vkFlushMappedMemoryRanges");
-    dispatch->invalidate_mapped_memory_ranges = resolve_mali_device_proc<PFN_vkInvalidateMappedMemoryRanges>(
-        dispatch->get_device_proc_addr, device, "vkInvalidateMappedMemoryRanges");
-    dispatch->map_memory2_khr = resolve_mali_device_proc<PFN_vkMapMemory2KHR>(
-        dispatch->get_device_proc_addr, device, "vkMapMemory2KHR");
-    dispatch->map_memory2 = resolve_mali_device_proc<PFN_vkVoidFunction>(
-        dispatch->get_device_proc_addr, device, "vkMapMemory2");
-    dispatch->unmap_memory2_khr = resolve_mali_device_proc<PFN_vkUnmapMemory2KHR>(
-        dispatch->get_device_proc_addr, device, "vkUnmapMemory2KHR");
-    dispatch->unmap_memory2 = resolve_mali_device_proc<PFN_vkVoidFunction>(
-        dispatch->get_device_proc_addr, device, "vkUnmapMemory2");
-    dispatch->queue_submit = resolve_mali_device_proc<PFN_vkQueueSubmit>(
-        dispatch->get_device_proc_addr, device, "vkQueueSubmit");
-    dispatch->queue_submit2 = resolve_mali_device_proc<PFN_vkQueueSubmit2>(
-        dispatch->get_device_proc_addr, device, "vkQueueSubmit2");
-    dispatch->queue_submit2_khr = resolve_mali_device_proc<PFN_vkQueueSubmit2KHR>(
-        dispatch->get_device_proc_addr, device, "vkQueueSubmit2KHR");
-    dispatch->create_image = resolve_mali_device_proc<PFN_vkCreateImage>(
-        dispatch->get_device_proc_addr, device, "vkCreateImage");
-    dispatch->create_graphics_pipelines = resolve_mali_device_proc<PFN_vkCreateGraphicsPipelines>(
-        dispatch->get_device_proc_addr, device, "vkCreateGraphicsPipelines");
-    return dispatch;
+    return support;
+}
+
+// An empty batch is rejected with EINVAL by kernels that have the batched
+// ioctl and with ENOTTY by the ones that only have the single variant.
+static bool probe_low_address_alias_batch_support(MaliDeviceFdCache* fd_cache)
+{
+    for (const int fd : get_mali_device_fds(fd_cache, false)) {
+        struct kbase_ioctl_mem_low32_alias_create_batch request{};
+        if (ioctl(fd, KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE_BATCH, &request) == 0 || errno == EINVAL) {
+            return true;
+        }
+        if (errno == ENOTTY) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+// Sets KBASE_IOCTL_CONTEXT_LOW32_MMAP on the device's kbase contexts. Kernels
+// without it answer ENOTTY and mappings keep their usual high placement.
+static bool enable_low32_placement(MaliDeviceFdCache* fd_cache)
+{
+    bool enabled = false;
+    for (const int fd : get_mali_device_fds(fd_cache, false)) {
+        struct kbase_ioctl_context_low32_mmap request{};
+        request.enable = 1;
+        if (ioctl(fd, KBASE_IOCTL_CONTEXT_LOW32_MMAP, &request) == 0) {
+            enabled = true;
+        }
+    }
+
+    return enabled;
+}
+
+static void probe_device_low_address_alias_support(MaliDeviceFdCache* fd_cache)
+{
+    if (fd_cache == nullptr || !should_use_low_address_shadow_map()) {
+        return;
+    }
+
+    const char* decision = nullptr;
+    LowAddressAliasSupport support = LowAddressAliasSupport::UNKNOWN;
+    if (!should_try_low_address_alias()) {
+        support = LowAddressAliasSupport::UNSUPPORTED;
+        decision = "shadow (forced by noalias)";
+    } else if (should_force_low_address_alias()) {
+        support = LowAddressAliasSupport::SUPPORTED;
+        decision = "alias (forced by alias)";
+    } else {
+        support = probe_low_address_alias_support(fd_cache);
+        decision = (support == LowAddressAliasSupport::SUPPORTED) ? "alias (kernel supports low32 alias)" :
+                   (support == LowAddressAliasSupport::UNSUPPORTED) ? "shadow (kernel lacks low32 alias)" :
+                   "alias with shadow fallback (no kbase fd to probe yet)";
+    }
+
+    const bool batched = support == LowAddressAliasSupport::SUPPORTED &&
+                         probe_low_address_alias_batch_support(fd_cache);
+    fd_cache->alias_support.store(support, std::memory_order_relaxed);
+    const bool low32_placement = should_request_low32_placement() && enable_low32_placement(fd_cache);
+    fd_cache->alias_batch_supported.store(batched, std::memory_order_relaxed);
+    fd_cache->low32_placement.store(low32_placement, std::memory_order_relaxed);
+    LOW_ADDRESS_LOG_INFO("Low-address map mode for device: " + std::string(decision) +
+                         (batched ? ", batched alias ioctl available" : "") +
+                         (low32_placement ? ", kernel places mappings below 4 GiB" : ""));
+}
+
+// Page-aligned range the kernel aliases for [real_ptr, real_ptr + mapped_size).
+static bool get_low_address_alias_range(const void* real_ptr, size_t mapped_size, uintptr_t* aligned_real_addr,
+                                        size_t* page_offset, size_t* mmap_size)
+{
+    const uintptr_t real_addr = reinterpret_cast<uintptr_t>(real_ptr);
+    *aligned_real_addr = align_down_to_page(real_addr);
+    *page_offset = static_cast<size_t>(real_addr - *aligned_real_addr);
+    if (*page_offset > std::numeric_limits<size_t>::max() - mapped_size) {
+        return false;
+    }
+
+    *mmap_size = align_up_to_page(*page_offset + mapped_size);
+    return *mmap_size != 0;
+}
+
+// Maps the alias a kbase cookie stands for and describes it in out_mapping.
+// The cookie is consumed whether or not this succeeds.
+static bool map_low_address_alias_cookie(int fd, uint64_t cookie, const void* real_ptr, size_t page_offset,
+                                         size_t mmap_size, void* placed_addr, ShadowMappingInfo* out_mapping,
+                                         const char** failure_reason, int* mmap_errno)
+{
+    void* mapped_base =
+        mmap(placed_addr, mmap_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | (placed_addr != nullptr ? MAP_FIXED : 0), fd, cookie);
+    if (mapped_base == MAP_FAILED) {
+        *mmap_errno = errno;
+        *failure_reason = "mmap-failed";
+        if (should_trace_low_address_map_events()) {
+            LOW_ADDRESS_LOG_DEBUG("Low-address alias mmap failed: fd=" + std::to_string(fd) +
+                                  ", cookie=" + format_hex_u64(cookie) +
+                                  ", errno=" + std::to_string(*mmap_errno));
+        }
+        release_alias_cookie(fd, cookie);
+        return false;
+    }
+
+    void* low_ptr = static_cast<void*>(static_cast<uint8_t*>(mapped_base) + page_offset);
+    if (placed_addr == nullptr && !is_pointer_32bit_compatible(low_ptr)) {
+        *failure_reason = "landed-above-4g";
+        if (should_trace_low_address_map_events()) {
+            LOW_ADDRESS_LOG_DEBUG("Low-address alias landed above 4 GiB: fd=" +
+                                  std::to_string(fd) +
+                                  ", mapped_base=" + format_pointer(mapped_base) +
+                                  ", low_ptr=" + format_pointer(low_ptr));
+        }
+        munmap(mapped_base, mmap_size);
+        return false;
+    }
+
+    out_mapping->real_ptr = const_cast<void*>(real_ptr);
+    out_mapping->shadow_ptr = low_ptr;
+    out_mapping->shadow_size = 0;
+    out_mapping->mode = LowAddressMapMode::ALIAS;
+    out_mapping->unmap_ptr = mapped_base;
+    out_mapping->unmap_size = mmap_size;
+    out_mapping->mali_fd = fd;
+    out_mapping->placed = placed_addr != nullptr;
+    return true;
+}
+
+// placed_addr, when set, is the page-aligned address the alias must land on
+// (VK_EXT_map_memory_placed); otherwise the kernel picks a low address.
+static bool try_create_low_address_alias(const void* real_ptr, size_t mapped_size, void* placed_addr,
+                                         MaliDeviceFdCache* fd_cache, ShadowMappingInfo* out_mapping)
+{
+    if (real_ptr == nullptr || mapped_size == 0 || out_mapping == nullptr || !should_try_low_address_alias()) {
+        return false;
+    }
+    if (fd_cache != nullptr &&
+        fd_cache->alias_support.load(std::memory_order_relaxed) == LowAddressAliasSupport::UNSUPPORTED) {
+        return false;
+    }
+
+    TraceScope trace_scope(TraceEvent::ALIAS_CREATE, mapped_size, 0);
+    uintptr_t aligned_real_addr = 0;
+    size_t page_offset = 0;
+    size_t mmap_size = 0;
+    if (!get_low_address_alias_range(real_ptr, mapped_size, &aligned_real_addr, &page_offset, &mmap_size)) {
+        return false;
+    }
+    if (placed_addr != nullptr && page_offset != 0) {
+        return false;
+    }
+
+    std::vector<int> mali_fds = get_mali_device_fds(fd_cache, false);
+    int last_fd = -1;
+    int last_ioctl_errno = 0;
+    int last_mmap_errno = 0;
+    const char* failure_reason = "no-mali-fd";
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_DEBUG("Low-address alias discovery: real=" + format_pointer(real_ptr) +
+                              ", aligned_real=" + format_hex_u64(static_cast<uint64_t>(aligned_real_addr)) +
+                              ", page_offset=" + std::to_string(page_offset) +
+                              ", mmap_size=" + format_bytes(static_cast<uint64_t>(mmap_size)) +
+                              ", candidate_fds=" + std::to_string(mali_fds.size()));
+    }
+
+    if (mali_fds.empty()) {
+        if (should_log_low_address_map_stats()) {
+            LOW_ADDRESS_LOG_WARN("Low-address alias unavailable: no /dev/mali0 fd found for real=" +
+                                 format_pointer(real_ptr) +
+                                 ", size=" + format_bytes(static_cast<uint64_t>(mapped_size)));
+        }
+        return false;
+    }
+
+    bool rescanned = fd_cache == nullptr;
+    for (size_t fd_index = 0; fd_index < mali_fds.size(); fd_index++) {
+        const int fd = mali_fds[fd_index];
+        last_fd = fd;
+        struct kbase_ioctl_mem_low32_alias_create request{};
+        request.user_addr = static_cast<uint64_t>(aligned_real_addr);
+        request.size = static_cast<uint64_t>(mmap_size);
+
+        if (should_trace_low_address_map_events()) {
+            LOW_ADDRESS_LOG_DEBUG("Low-address alias ioctl attempt: fd=" + std::to_string(fd) +
+                                  ", user_addr=" + format_hex_u64(request.user_addr) +
+                                  ", size=" + format_bytes(request.size));
+        }
+
+        if (ioctl(fd, KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE, &request) != 0) {
+            last_ioctl_errno = errno;
+            failure_reason = "ioctl-failed";
+            if (should_log_low_address_map_stats()) {
+                LOW_ADDRESS_LOG_INFO("Low-address alias ioctl failed: fd=" + std::to_string(fd) +
+                                     ", user_addr=" + format_hex_u64(request.user_addr) +
+                                     ", size=" + format_bytes(request.size) +
+                                     ", errno=" + std::to_string(last_ioctl_errno));
+            }
+            // EBADF/ENOTTY mean the cached fd was closed or now refers to a
+            // different file, so refresh the cached list once and start over.
+            if (!rescanned && (last_ioctl_errno == EBADF || last_ioctl_errno == ENOTTY)) {
+                rescanned = true;
+                mali_fds = get_mali_device_fds(fd_cache, true);
+                fd_index = static_cast<size_t>(-1);
+            }
+            continue;
+        }
+
+        if (should_trace_low_address_map_events()) {
+            LOW_ADDRESS_LOG_DEBUG("Low-address alias ioctl succeeded: fd=" + std::to_string(fd) +
+                                  ", cookie=" + format_hex_u64(request.cookie));
+        }
+
+        if (!map_low_address_alias_cookie(fd, request.cookie, real_ptr, page_offset, mmap_size, placed_addr,
+                                          out_mapping, &failure_reason, &last_mmap_errno)) {
+            continue;
+        }
+
+        remember_mali_alias_fd(fd_cache, fd);
+        trace_scope.SetArgs(mapped_size, 1);
+        return true;
+    }
+
+    if (should_log_low_address_map_stats()) {
+        LOW_ADDRESS_LOG_INFO("Low-address alias attempt failed: real=" + format_pointer(real_ptr) +
+                             ", aligned_real=" + format_hex_u64(static_cast<uint64_t>(aligned_real_addr)) +
+                             ", mmap_size=" + format_bytes(static_cast<uint64_t>(mmap_size)) +
+                             ", candidate_fds=" + std::to_string(mali_fds.size()) +
+                             ", last_fd=" + std::to_string(last_fd) +
+                             ", reason=" + std::string(failure_reason) +
+                             ", last_ioctl_errno=" + std::to_string(last_ioctl_errno) +
+                             ", last_mmap_errno=" + std::to_string(last_mmap_errno));
+    }
+
+    return false;
+}
+
+struct LowAddressAliasRequest {
+    const void* real_ptr = nullptr;
+    size_t mapped_size = 0;
+    ShadowMappingInfo mapping{};
+    bool created = false;
+};
+
+// Aliases several mappings with one batched ioctl per fd and
+// KBASE_MEM_LOW32_ALIAS_BATCH_MAX requests, then one mmap per returned cookie.
+// Requests the kernel refuses on one fd are retried on the next. Without the
+// batched ioctl each request goes through try_create_low_address_alias().
+// Returns the number of requests that were aliased.
+static size_t try_create_low_address_alias_batch(std::vector<LowAddressAliasRequest>& requests,
+                                                 MaliDeviceFdCache* fd_cache)
+{
+    if (requests.empty() || !should_try_low_address_alias()) {
+        return 0;
+    }
+
+    size_t created = 0;
+    if (requests.size() == 1 || fd_cache == nullptr ||
+        !fd_cache->alias_batch_supported.load(std::memory_order_relaxed)) {
+        for (LowAddressAliasRequest& request : requests) {
+            request.created = try_create_low_address_alias(request.real_ptr, request.mapped_size, nullptr,
+                                                           fd_cache, &request.mapping);
+            created += request.created ? 1 : 0;
+        }
+        return created;
+    }
+
+    uint64_t total_size = 0;
+    for (const LowAddressAliasRequest& request : requests) {
+        total_size += static_cast<uint64_t>(request.mapped_size);
+    }
+    TraceScope trace_scope(TraceEvent::ALIAS_CREATE, total_size, 0);
+
+    int last_ioctl_errno = 0;
+    int last_mmap_errno = 0;
+    const char* failure_reason = "no-mali-fd";
+    for (const int fd : get_mali_device_fds(fd_cache, false)) {
+        std::vector<struct kbase_ioctl_mem_low32_alias_create> entries;
+        std::vector<size_t> entry_requests;
+        std::vector<size_t> entry_page_offsets;
+        for (size_t i = 0; i < requests.size(); i++) {
+            uintptr_t aligned_real_addr = 0;
+            size_t page_offset = 0;
+            size_t mmap_size = 0;
+            if (requests[i].created || requests[i].real_ptr == nullptr || requests[i].mapped_size == 0 ||
+                !get_low_address_alias_range(requests[i].real_ptr, requests[i].mapped_size, &aligned_real_addr,
+                                             &page_offset, &mmap_size)) {
+                continue;
+            }
+
+            struct kbase_ioctl_mem_low32_alias_create entry{};
+            entry.user_addr = static_cast<uint64_t>(aligned_real_addr);
+            entry.size = static_cast<uint64_t>(mmap_size);
+            entries.push_back(entry);
+            entry_requests.push_back(i);
+            entry_page_offsets.push_back(page_offset);
+        }
+        if (entries.empty()) {
+            break;
+        }
+
+        for (size_t first = 0; first < entries.size(); first += KBASE_MEM_LOW32_ALIAS_BATCH_MAX) {
+            struct kbase_ioctl_mem_low32_alias_create_batch batch{};
+            batch.entries = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(entries.data() + first));
+            batch.count = static_cast<uint32_t>(
+                std::min<size_t>(entries.size() - first, KBASE_MEM_LOW32_ALIAS_BATCH_MAX));
+            if (ioctl(fd, KBASE_IOCTL_MEM_LOW32_ALIAS_CREATE_BATCH, &batch) != 0) {
+                last_ioctl_errno = errno;
+                failure_reason = "ioctl-failed";
+                break;
+            }
+            if (should_collect_low_address_map_stats()) {
+                low_address_map_stats.local().alias_batch_ioctls.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (should_trace_low_address_map_events()) {
+                LOW_ADDRESS_LOG_DEBUG("Low-address alias batch ioctl: fd=" + std::to_string(fd) +
+                                      ", count=" + std::to_string(batch.count) +
+                                      ", created=" + std::to_string(batch.created));
+            }
+
+            for (size_t j = first; j < first + batch.count; j++) {
+                if (entries[j].cookie == 0) {
+                    continue;
+                }
+
+                LowAddressAliasRequest& request = requests[entry_requests[j]];
+                if (map_low_address_alias_cookie(fd, entries[j].cookie, request.real_ptr, entry_page_offsets[j],
+                                                 static_cast<size_t>(entries[j].size), nullptr, &request.mapping,
+                                                 &failure_reason, &last_mmap_errno)) {
+                    request.created = true;
+                    created++;
+                    remember_mali_alias_fd(fd_cache, fd);
+                }
+            }
+        }
+
+        if (created == requests.size()) {
+            break;
+        }
+    }
+
+    if (created < requests.size() && should_log_low_address_map_stats()) {
+        LOW_ADDRESS_LOG_INFO("Low-address alias batch incomplete: requests=" + std::to_string(requests.size()) +
+                             ", created=" + std::to_string(created) +
+                             ", reason=" + std::string(failure_reason) +
+                             ", last_ioctl_errno=" + std::to_string(last_ioctl_errno) +
+                             ", last_mmap_errno=" + std::to_string(last_mmap_errno));
+    }
+    trace_scope.SetArgs(total_size, created);
+    return created;
+}
+
+// Maps aligned_size bytes below 4 GiB. MAP_32BIT is tried first and the
+// fixed-address probe is the fallback; result->method and the probe counters
+// describe the path that was used.
+static void* map_low_address_region(size_t aligned_size, int prot, int extra_flags,
+                                    ShadowAllocationResult* result)
+{
+#ifdef MAP_32BIT
+    void* mapped = mmap(nullptr, aligned_size, prot,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | extra_flags, -1, 0);
+    if (mapped != MAP_FAILED) {
+        const uint64_t mapped_addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(mapped));
+        const uint64_t mapped_end = mapped_addr + static_cast<uint64_t>(aligned_size);
+        if (mapped_end <= kMax32BitAddressExclusive) {
+            result->method = ShadowAllocationMethod::MAP_32BIT;
+            return mapped;
+        }
+        if (should_trace_low_address_map_events()) {
+            LOW_ADDRESS_LOG_DEBUG("Low-address MAP_32BIT candidate discarded: ptr=" +
+                                  format_pointer(mapped) +
+                                  ", size=" + format_bytes(static_cast<uint64_t>(aligned_size)));
+        }
+        munmap(mapped, aligned_size);
+    } else {
+        result->last_errno = errno;
+    }
+#endif
+
+    for (uintptr_t addr = kShadowSearchStart;
+         addr < kShadowSearchEnd &&
+             static_cast<uint64_t>(addr) + static_cast<uint64_t>(aligned_size) < kMax32BitAddressExclusive;
+         addr += kShadowSearchStep) {
+        result->fixed_search_attempts++;
+        void* mapped = mmap(reinterpret_cast<void*>(addr), aligned_size, prot,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | extra_flags, -1, 0);
+        if (mapped != MAP_FAILED) {
+            result->method = ShadowAllocationMethod::FIXED_SEARCH;
+            return mapped;
+        }
+
+        result->last_errno = errno;
+        if (result->last_errno != EEXIST && result->last_errno != EINVAL &&
+            result->last_errno != ENOMEM && result->last_errno != EBUSY) {
+            break;
+        }
+    }
+
+    return nullptr;
+}
+
+// Low-address reservation that shadow buffers are carved from. Each chunk is
+// reserved PROT_NONE once; blocks are committed with MAP_FIXED on allocation
+// and decommitted back to PROT_NONE on release, so map/unmap churn does not go
+// through the fixed-address probe again.
+struct ShadowArenaChunk {
+    uintptr_t base = 0;
+    size_t size = 0;
+    size_t used = 0;
+    // Free extents keyed by start address, coalesced on release.
+    std::map<uintptr_t, size_t> free_extents;
+};
+
+static std::mutex shadow_arena_mutex;
+static std::vector<std::unique_ptr<ShadowArenaChunk>> shadow_arena_chunks;
+
+// Best-fit search over every chunk. alignment is a power of two; the part of
+// an extent skipped to reach an aligned start stays free.
+static bool take_shadow_arena_extent_locked(size_t aligned_size, size_t alignment, uintptr_t* out_addr)
+{
+    auto aligned_start = [alignment](uintptr_t addr) {
+        return (addr + (alignment - 1)) & ~static_cast<uintptr_t>(alignment - 1);
+    };
+
+    ShadowArenaChunk* best_chunk = nullptr;
+    std::map<uintptr_t, size_t>::iterator best_extent;
+    for (auto& chunk : shadow_arena_chunks) {
+        for (auto it = chunk->free_extents.begin(); it != chunk->free_extents.end(); ++it) {
+            const size_t skip = static_cast<size_t>(aligned_start(it->first) - it->first);
+            if (it->second < skip || it->second - skip < aligned_size) {
+                continue;
+            }
+            if (best_chunk == nullptr || it->second < best_extent->second) {
+                best_chunk = chunk.get();
+                best_extent = it;
+            }
+        }
+    }
+
+    if (best_chunk == nullptr) {
+        return false;
+    }
+
+    const uintptr_t extent_addr = best_extent->first;
+    const size_t extent_size = best_extent->second;
+    const uintptr_t addr = aligned_start(extent_addr);
+    const size_t skip = static_cast<size_t>(addr - extent_addr);
+    const size_t remaining = extent_size - skip - aligned_size;
+    best_chunk->free_extents.erase(best_extent);
+    if (skip > 0) {
+        best_chunk->free_extents.emplace(extent_addr, skip);
+    }
+    if (remaining > 0) {
+        best_chunk->free_extents.emplace(addr + aligned_size, remaining);
+    }
+    best_chunk->used += aligned_size;
+    *out_addr = addr;
+    return true;
+}
+
+static ShadowArenaChunk* find_shadow_arena_chunk_locked(uintptr_t addr, size_t size)
+{
+    for (auto& chunk : shadow_arena_chunks) {
+        if (addr >= chunk->base && addr - chunk->base < chunk->size &&
+            size <= chunk->size - (addr - chunk->base)) {
+            return chunk.get();
+        }
+    }
+    return nullptr;
+}
+
+static void return_shadow_arena_extent_locked(ShadowArenaChunk& chunk, uintptr_t addr, size_t size)
+{
+    auto next = chunk.free_extents.lower_bound(addr);
+    if (next != chunk.free_extents.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == addr) {
+            addr = prev->first;
+            size += prev->second;
+            chunk.free_extents.erase(prev);
+        }
+    }
+    if (next != chunk.free_extents.end() && addr + size == next->first) {
+        size += next->second;
+        chunk.free_extents.erase(next);
+    }
+    chunk.free_extents.emplace(addr, size);
+}
+
+static bool reserve_shadow_arena_chunk_locked(size_t min_size, ShadowAllocationResult* result)
+{
+    const bool huge_pages = should_use_low_address_shadow_huge_pages();
+    const size_t granule = huge_pages ? kShadowHugePageSize : get_page_size();
+    size_t chunk_size = std::max(kShadowArenaChunkSize, min_size);
+    chunk_size = ((chunk_size + granule - 1) / granule) * granule;
+
+    // Over-reserve by one huge page and trim, so the chunk starts on a 2 MiB
+    // boundary and huge allocations carved from it can be THP backed.
+    const size_t reserve_size = huge_pages ? chunk_size + kShadowHugePageSize : chunk_size;
+    ShadowAllocationResult reserve_result{};
+    void* base = map_low_address_region(reserve_size, PROT_NONE, MAP_NORESERVE, &reserve_result);
+    result->fixed_search_attempts += reserve_result.fixed_search_attempts;
+    if (base == nullptr) {
+        result->last_errno = reserve_result.last_errno;
+        return false;
+    }
+    if (huge_pages) {
+        const uintptr_t raw_base = reinterpret_cast<uintptr_t>(base);
+        const uintptr_t aligned_base = (raw_base + (kShadowHugePageSize - 1)) &
+                                       ~static_cast<uintptr_t>(kShadowHugePageSize - 1);
+        const size_t head = static_cast<size_t>(aligned_base - raw_base);
+        if (head > 0) {
+            munmap(base, head);
+        }
+        if (reserve_size - head > chunk_size) {
+            munmap(reinterpret_cast<void*>(aligned_base + chunk_size), reserve_size - head - chunk_size);
+        }
+        base = reinterpret_cast<void*>(aligned_base);
+    }
+
+    auto chunk = std::make_unique<ShadowArenaChunk>();
+    chunk->base = reinterpret_cast<uintptr_t>(base);
+    chunk->size = chunk_size;
+    chunk->free_extents.emplace(chunk->base, chunk_size);
+    shadow_arena_chunks.push_back(std::move(chunk));
+
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().arena_chunks_reserved.fetch_add(1, std::memory_order_relaxed);
+        low_address_map_stats.local().arena_reserved_bytes.fetch_add(chunk_size, std::memory_order_relaxed);
+    }
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_DEBUG("Low-address arena chunk reserved: base=" + format_pointer(base) +
+                              ", size=" + format_bytes(static_cast<uint64_t>(chunk_size)) +
+                              ", method=" + std::string(shadow_allocation_method_to_string(reserve_result.method)) +
+                              ", chunks=" + std::to_string(shadow_arena_chunks.size()));
+    }
+    return true;
+}
+
+static void* allocate_from_shadow_arena(size_t aligned_size, ShadowAllocationResult* result)
+{
+    const size_t alignment = (should_use_low_address_shadow_huge_pages() && aligned_size >= kShadowHugePageSize)
+        ? kShadowHugePageSize
+        : get_page_size();
+    uintptr_t addr = 0;
+    {
+        std::lock_guard<std::mutex> lock(shadow_arena_mutex);
+        if (!take_shadow_arena_extent_locked(aligned_size, alignment, &addr)) {
+            if (!reserve_shadow_arena_chunk_locked(aligned_size, result) ||
+                !take_shadow_arena_extent_locked(aligned_size, alignment, &addr)) {
+                return nullptr;
+            }
+        }
+    }
+
+    void* mapped = mmap(reinterpret_cast<void*>(addr), aligned_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (mapped != MAP_FAILED) {
+        return mapped;
+    }
+
+    result->last_errno = errno;
+    std::lock_guard<std::mutex> lock(shadow_arena_mutex);
+    ShadowArenaChunk* chunk = find_shadow_arena_chunk_locked(addr, aligned_size);
+    if (chunk != nullptr) {
+        chunk->used -= aligned_size;
+        return_shadow_arena_extent_locked(*chunk, addr, aligned_size);
+    }
+    return nullptr;
+}
+
+// Returns an arena block and its pages to the reservation. Returns false when
+// ptr was not carved from the arena and has to be munmap()ed by the caller.
+static bool release_to_shadow_arena(void* ptr, size_t size)
+{
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+    {
+        std::lock_guard<std::mutex> lock(shadow_arena_mutex);
+        if (find_shadow_arena_chunk_locked(addr, size) == nullptr) {
+            return false;
+        }
+    }
+
+    // Drop the pages and any dirty-tracking protection in one call; the block
+    // stays reserved so nothing else can be mapped into the arena.
+    mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1, 0);
+
+    std::lock_guard<std::mutex> lock(shadow_arena_mutex);
+    ShadowArenaChunk* chunk = find_shadow_arena_chunk_locked(addr, size);
+    if (chunk == nullptr) {
+        return true;
+    }
+
+    chunk->used -= size;
+    return_shadow_arena_extent_locked(*chunk, addr, size);
+    if (chunk->used != 0) {
+        return true;
+    }
+
+    // Keep a single empty chunk around for reuse and give the rest of the low
+    // address space back to the process.
+    const size_t empty_chunks = static_cast<size_t>(std::count_if(
+        shadow_arena_chunks.begin(), shadow_arena_chunks.end(),
+        [](const std::unique_ptr<ShadowArenaChunk>& candidate) { return candidate->used == 0; }));
+    if (empty_chunks <= 1) {
+        return true;
+    }
+
+    for (auto it = shadow_arena_chunks.begin(); it != shadow_arena_chunks.end(); ++it) {
+        if (it->get() == chunk) {
+            munmap(reinterpret_cast<void*>(chunk->base), chunk->size);
+            if (should_collect_low_address_map_stats()) {
+                low_address_map_stats.local().arena_chunks_released.fetch_add(1, std::memory_order_relaxed);
+                low_address_map_stats.local().arena_reserved_bytes.fetch_sub(chunk->size, std::memory_order_relaxed);
+            }
+            shadow_arena_chunks.erase(it);
+            break;
+        }
+    }
+    return true;
+}
+
+// Sums Rss and AnonHugePages over the VMAs inside arena chunks, as reported by
+// /proc/self/smaps. Only used for the shutdown summary.
+static bool sample_shadow_arena_huge_pages(uint64_t* rss_bytes, uint64_t* huge_bytes)
+{
+    std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+    {
+        std::lock_guard<std::mutex> lock(shadow_arena_mutex);
+        for (const auto& chunk : shadow_arena_chunks) {
+            ranges.emplace_back(chunk->base, chunk->base + chunk->size);
+        }
+    }
+
+    FILE* smaps = std::fopen("/proc/self/smaps", "r");
+    if (smaps == nullptr) {
+        return false;
+    }
+
+    *rss_bytes = 0;
+    *huge_bytes = 0;
+    bool in_arena = false;
+    char line[512];
+    while (std::fgets(line, sizeof(line), smaps) != nullptr) {
+        unsigned long long start = 0;
+        unsigned long long end = 0;
+        unsigned long long kib = 0;
+        if (std::sscanf(line, "%llx-%llx ", &start, &end) == 2) {
+            in_arena = std::any_of(ranges.begin(), ranges.end(), [start, end](const auto& range) {
+                return start >= range.first && end <= range.second;
+            });
+        } else if (!in_arena) {
+            continue;
+        } else if (std::sscanf(line, "Rss: %llu kB", &kib) == 1) {
+            *rss_bytes += kib * 1024ULL;
+        } else if (std::sscanf(line, "AnonHugePages: %llu kB", &kib) == 1) {
+            *huge_bytes += kib * 1024ULL;
+        }
+    }
+    std::fclose(smaps);
+    return true;
+}
+
+// Address space still unmapped below 4 GiB, which low aliases, shadows and
+// low kernel placements all draw from. Budget queries can arrive every frame,
+// so /proc/self/maps is rescanned at most every 250 ms.
+static uint64_t get_free_low_address_space_bytes()
+{
+    static std::mutex cache_mutex;
+    static bool cache_valid = false;
+    static uint64_t cached_free_bytes = 0;
+    static std::chrono::steady_clock::time_point cached_at;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (cache_valid && now - cached_at < std::chrono::milliseconds(250)) {
+        return cached_free_bytes;
+    }
+
+    FILE* maps = std::fopen("/proc/self/maps", "r");
+    if (maps == nullptr) {
+        return cache_valid ? cached_free_bytes : kMax32BitAddressExclusive;
+    }
+
+    uint64_t free_bytes = 0;
+    uint64_t cursor = static_cast<uint64_t>(get_page_size());
+    char line[512];
+    while (std::fgets(line, sizeof(line), maps) != nullptr) {
+        unsigned long long start = 0;
+        unsigned long long end = 0;
+        if (std::sscanf(line, "%llx-%llx ", &start, &end) != 2) {
+            continue;
+        }
+        if (start >= kMax32BitAddressExclusive) {
+            break;
+        }
+        if (start > cursor) {
+            free_bytes += start - cursor;
+        }
+        cursor = std::max<uint64_t>(cursor, end);
+    }
+    std::fclose(maps);
+    if (cursor < kMax32BitAddressExclusive) {
+        free_bytes += kMax32BitAddressExclusive - cursor;
+    }
+
+    cache_valid = true;
+    cached_free_bytes = free_bytes;
+    cached_at = now;
+    return free_bytes;
+}
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+// Asks for THP backing and pre-faults the whole block, so the initial copy and
+// later full syncs run on huge TLB entries. Both calls are best effort.
+static void prepare_shadow_huge_pages(void* ptr, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    madvise(ptr, size, MADV_POPULATE_WRITE);
+}
+
+static ShadowAllocationResult allocate_low_address_shadow(size_t requested_size)
+{
+    ShadowAllocationResult result{};
+    if (requested_size == 0) {
+        return result;
+    }
+
+    // Shadows of at least one huge page are rounded to whole huge pages so
+    // their tail can be THP backed too.
+    const size_t granule = (should_use_low_address_shadow_huge_pages() && requested_size >= kShadowHugePageSize)
+        ? kShadowHugePageSize
+        : get_page_size();
+    const size_t aligned_size = ((requested_size + granule - 1) / granule) * granule;
+    if (aligned_size == 0 || aligned_size < requested_size) {
+        return result;
+    }
+
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_DEBUG("Low-address allocation request: requested=" +
+                              format_bytes(static_cast<uint64_t>(requested_size)) +
+                              ", aligned=" + format_bytes(static_cast<uint64_t>(aligned_size)));
+    }
+
+    const bool collect_stats = should_collect_low_address_map_stats();
+    const auto start_time = collect_stats ? std::chrono::steady_clock::now()
+                                          : std::chrono::steady_clock::time_point{};
+    TraceScope trace_scope(TraceEvent::SHADOW_CREATE, aligned_size, 0);
+
+    void* mapped = nullptr;
+    if (should_use_low_address_shadow_arena()) {
+        mapped = allocate_from_shadow_arena(aligned_size, &result);
+        if (mapped != nullptr) {
+            result.method = ShadowAllocationMethod::ARENA;
+        }
+    }
+    if (mapped == nullptr) {
+        mapped = map_low_address_region(aligned_size, PROT_READ | PROT_WRITE, 0, &result);
+    }
+
+    if (mapped != nullptr) {
+        result.ptr = mapped;
+        result.size = aligned_size;
+        if (should_use_low_address_shadow_huge_pages()) {
+            prepare_shadow_huge_pages(mapped, aligned_size);
+        }
+    }
+
+    if (collect_stats) {
+        result.elapsed_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_time).count());
+    }
+    trace_scope.SetArgs(aligned_size, static_cast<uint64_t>(result.method));
+    return result;
+}
+
+static std::shared_ptr<const ManagedDeviceDispatch> get_managed_device_dispatch(VkDevice device);
+
+static void remove_tracking_for_device(VkDevice device)
+{
+    std::vector<ShadowMappingInfo> stale_mappings;
+    auto dispatch = get_managed_device_dispatch(device);
+    DeviceLowAddressMappingIndex* index =
+        dispatch != nullptr ? dispatch->low_address_mapping_index.get() : nullptr;
+
+    {
+        auto lock = lock_shadow_mappings_exclusive();
+        if (index != nullptr) {
+            std::vector<VkDeviceMemory> indexed_memories;
+            indexed_memories.reserve(index->shadow_entries.size() + index->alias_entries.size());
+            for (const auto& entry : index->shadow_entries) {
+                indexed_memories.push_back(entry.memory);
+            }
+            for (const auto& entry : index->alias_entries) {
+                indexed_memories.push_back(entry.memory);
+            }
+
+            for (VkDeviceMemory memory : indexed_memories) {
+                auto it = shadow_mappings.find(make_memory_key(device, memory));
+                if (it != shadow_mappings.end()) {
+                    stale_mappings.push_back(take_low_address_mapping_locked(it));
+                }
+            }
+        } else {
+            for (auto it = shadow_mappings.begin(); it != shadow_mappings.end(); ) {
+                if (it->first.device == device) {
+                    unindex_low_address_mapping_locked(it->second);
+                    stale_mappings.push_back(it->second);
+                    it = shadow_mappings.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        drop_cached_low_address_mappings_locked(device, &stale_mappings);
+    }
+
+    for (auto& shard : tracked_allocation_shards) {
+        auto lock = lock_tracked_allocation_shard(shard);
+        for (auto it = shard.allocations.begin(); it != shard.allocations.end(); ) {
+            if (it->first.device == device) {
+                it = shard.allocations.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    uint64_t released_mapping_bytes = 0;
+    for (const auto& mapping : stale_mappings) {
+        if (mapping.mode == LowAddressMapMode::SHADOW && mapping.shadow_size > 0) {
+            record_shadow_mapping_removed(mapping.shadow_size);
+        }
+        if (mapping.unmap_ptr != nullptr && mapping.unmap_size > 0) {
+            released_mapping_bytes += static_cast<uint64_t>(mapping.unmap_size);
+        }
+        release_low_address_mapping(mapping);
+    }
+
+    if (!stale_mappings.empty()) {
+        LOW_ADDRESS_LOG_INFO("Low-address device cleanup: device=" + format_pointer(device) +
+                             ", stale_mappings=" + std::to_string(stale_mappings.size()) +
+                             ", released=" + format_bytes(released_mapping_bytes));
+    }
+}
+
+void add_instance_reference(VkInstance instance) {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    auto it = managed_instances.find(instance);
+    if (it != managed_instances.end()) {
+        it->second->ref_count++;
+    }
+}
+
+void remove_instance_reference(VkInstance instance) {
+    bool should_cleanup = false;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        auto it = managed_instances.find(instance);
+        if (it != managed_instances.end()) {
+            it->second->ref_count--;
+
+            if (it->second->marked_for_destruction && it->second->ref_count <= 0) {
+                should_cleanup = true;
+                managed_instances.erase(it);
+            }
+        }
+    }
+
+    if (should_cleanup) {
+        LOG_INFO("Performing delayed instance cleanup for instance with 0 references");
+        GetWSIManager().release_instance(instance);
+    }
+}
+
+bool is_instance_valid(VkInstance instance) {
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    auto it = managed_instances.find(instance);
+    return (it != managed_instances.end() && !it->second->marked_for_destruction);
+}
+
+template <typename T>
+static T resolve_mali_device_proc(PFN_vkGetDeviceProcAddr get_device_proc_addr, VkDevice device, const char* proc_name)
+{
+    if (get_device_proc_addr == nullptr || proc_name == nullptr) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<T>(get_device_proc_addr(device, proc_name));
+}
+
+static std::shared_ptr<const ManagedDeviceDispatch> create_managed_device_dispatch(VkDevice device, VkInstance parent_instance,
+                                                                                   VkPhysicalDevice physical_device,
+                                                                                   bool wrapper_map_memory_placed)
+{
+    auto dispatch = std::make_shared<ManagedDeviceDispatch>();
+    dispatch->device = device;
+    dispatch->parent_instance = parent_instance;
+    dispatch->wrapper_map_memory_placed = wrapper_map_memory_placed;
+    dispatch->direct_memory_dispatch = !wrapper_map_memory_placed && should_dispatch_memory_directly();
+    dispatch->low_address_mapping_index = std::make_shared<DeviceLowAddressMappingIndex>();
+    dispatch->mali_fd_cache = std::make_shared<MaliDeviceFdCache>();
+    dispatch->eager_alias_queue = std::make_shared<EagerAliasQueue>();
+    probe_device_low_address_alias_support(dispatch->mali_fd_cache.get());
+
+    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
+    if (mali_proc_addr == nullptr || device == VK_NULL_HANDLE || parent_instance == VK_NULL_HANDLE) {
+        return dispatch;
+    }
+
+    // Memory type flags pick the copy kernel for low-address shadow traffic.
+    auto get_memory_properties = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties>(
+        mali_proc_addr(parent_instance, "vkGetPhysicalDeviceMemoryProperties"));
+    if (get_memory_properties != nullptr && physical_device != VK_NULL_HANDLE) {
+        VkPhysicalDeviceMemoryProperties memory_properties{};
+        get_memory_properties(physical_device, &memory_properties);
+        dispatch->memory_type_count = std::min<uint32_t>(memory_properties.memoryTypeCount, VK_MAX_MEMORY_TYPES);
+        for (uint32_t i = 0; i < dispatch->memory_type_count; i++) {
+            dispatch->memory_type_flags[i] = memory_properties.memoryTypes[i].propertyFlags;
+        }
+    }
+
+    dispatch->get_device_proc_addr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+        mali_proc_addr(parent_instance, "vkGetDeviceProcAddr"));
+    if (dispatch->get_device_proc_addr == nullptr) {
+        return dispatch;
+    }
+
+    dispatch->destroy_device = resolve_mali_device_proc<PFN_vkDestroyDevice>(
+        dispatch->get_device_proc_addr, device, "vkDestroyDevice");
+    dispatch->allocate_memory = resolve_mali_device_proc<PFN_vkAllocateMemory>(
+        dispatch->get_device_proc_addr, device, "vkAllocateMemory");
+    dispatch->free_memory = resolve_mali_device_proc<PFN_vkFreeMemory>(
+        dispatch->get_device_proc_addr, device, "vkFreeMemory");
+    dispatch->map_memory = resolve_mali_device_proc<PFN_vkMapMemory>(
+        dispatch->get_device_proc_addr, device, "vkMapMemory");
+    dispatch->unmap_memory = resolve_mali_device_proc<PFN_vkUnmapMemory>(
+        dispatch->get_device_proc_addr, device, "vkUnmapMemory");
+    dispatch->flush_mapped_memory_ranges = resolve_mali_device_proc<PFN_vkFlushMappedMemoryRanges>(
+        dispatch->get_device_proc_addr, device, "vkFlushMappedMemoryRanges");
+    dispatch->invalidate_mapped_memory_ranges = resolve_mali_device_proc<PFN_vkInvalidateMappedMemoryRanges>(
+        dispatch->get_device_proc_addr, device, "vkInvalidateMappedMemoryRanges");
+    dispatch->map_memory2_khr = resolve_mali_device_proc<PFN_vkMapMemory2KHR>(
+        dispatch->get_device_proc_addr, device, "vkMapMemory2KHR");
+    dispatch->map_memory2 = resolve_mali_device_proc<PFN_vkVoidFunction>(
+        dispatch->get_device_proc_addr, device, "vkMapMemory2");
+    dispatch->unmap_memory2_khr = resolve_mali_device_proc<PFN_vkUnmapMemory2KHR>(
+        dispatch->get_device_proc_addr, device, "vkUnmapMemory2KHR");
+    dispatch->unmap_memory2 = resolve_mali_device_proc<PFN_vkVoidFunction>(
+        dispatch->get_device_proc_addr, device, "vkUnmapMemory2");
+    dispatch->queue_submit = resolve_mali_device_proc<PFN_vkQueueSubmit>(
+        dispatch->get_device_proc_addr, device, "vkQueueSubmit");
+    dispatch->queue_submit2 = resolve_mali_device_proc<PFN_vkQueueSubmit2>(
+        dispatch->get_device_proc_addr, device, "vkQueueSubmit2");
+    dispatch->queue_submit2_khr = resolve_mali_device_proc<PFN_vkQueueSubmit2KHR>(
+        dispatch->get_device_proc_addr, device, "vkQueueSubmit2KHR");
+    dispatch->create_image = resolve_mali_device_proc<PFN_vkCreateImage>(
+        dispatch->get_device_proc_addr, device, "vkCreateImage");
+    dispatch->create_graphics_pipelines = resolve_mali_device_proc<PFN_vkCreateGraphicsPipelines>(
+        dispatch->get_device_proc_addr, device, "vkCreateGraphicsPipelines");
+    dispatch->create_compute_pipelines = resolve_mali_device_proc<PFN_vkCreateComputePipelines>(
+        dispatch->get_device_proc_addr, device, "vkCreateComputePipelines");
+    dispatch->get_device_queue = resolve_mali_device_proc<PFN_vkGetDeviceQueue>(
+        dispatch->get_device_proc_addr, device, "vkGetDeviceQueue");
+    dispatch->get_device_queue2 = resolve_mali_device_proc<PFN_vkGetDeviceQueue2>(
+        dispatch->get_device_proc_addr, device, "vkGetDeviceQueue2");
+    dispatch->create_pipeline_cache = resolve_mali_device_proc<PFN_vkCreatePipelineCache>(
+        dispatch->get_device_proc_addr, device, "vkCreatePipelineCache");
+    dispatch->destroy_pipeline_cache = resolve_mali_device_proc<PFN_vkDestroyPipelineCache>(
+        dispatch->get_device_proc_addr, device, "vkDestroyPipelineCache");
+
+    auto get_properties = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties>(
+        mali_proc_addr(parent_instance, "vkGetPhysicalDeviceProperties"));
+    if (PersistentPipelineCache::IsEnabled() && get_properties != nullptr && physical_device != VK_NULL_HANDLE) {
+        VkPhysicalDeviceProperties properties{};
+        get_properties(physical_device, &properties);
+        PersistentPipelineCache::DriverFunctions functions;
+        functions.create_pipeline_cache = dispatch->create_pipeline_cache;
+        functions.destroy_pipeline_cache = dispatch->destroy_pipeline_cache;
+        functions.get_pipeline_cache_data = resolve_mali_device_proc<PFN_vkGetPipelineCacheData>(
+            dispatch->get_device_proc_addr, device, "vkGetPipelineCacheData");
+        dispatch->pipeline_cache = PersistentPipelineCache::Create(device, properties, functions);
+    }
+    if (should_sync_referenced_shadows_only()) {
+        dispatch->reference_tracker = SubmitReferenceTracker::Create(device, dispatch->get_device_proc_addr);
+    }
+    return dispatch;
+}
+
+static void remember_managed_device(VkDevice device, VkInstance parent_instance, VkPhysicalDevice physical_device,
+                                    bool wrapper_map_memory_placed)
+{
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    auto dispatch = create_managed_device_dispatch(device, parent_instance, physical_device,
+                                                   wrapper_map_memory_placed);
+    {
+        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
+        managed_devices[device] = std::move(dispatch);
+        managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+}
+
+static std::shared_ptr<const ManagedDeviceDispatch> get_managed_device_dispatch(VkDevice device)
+{
+    if (device == VK_NULL_HANDLE) {
+        return nullptr;
+    }
+
+    thread_local uint64_t cached_generation = 0;
+    thread_local VkDevice cached_device = VK_NULL_HANDLE;
+    thread_local std::shared_ptr<const ManagedDeviceDispatch> cached_dispatch;
+
+    const uint64_t generation = managed_device_generation.load(std::memory_order_acquire);
+    if (cached_generation == generation && cached_device == device) {
+        return cached_dispatch;
+    }
+
+    std::shared_ptr<const ManagedDeviceDispatch> dispatch;
+    {
+        std::shared_lock<std::shared_mutex> lock(managed_device_mutex);
+        auto it = managed_devices.find(device);
+        if (it != managed_devices.end()) {
+            dispatch = it->second;
+        }
+    }
+
+    cached_generation = generation;
+    cached_device = device;
+    cached_dispatch = dispatch;
+    return dispatch;
+}
+
+static std::shared_ptr<const ManagedDeviceDispatch> forget_managed_device(VkDevice device)
+{
+    std::shared_ptr<const ManagedDeviceDispatch> dispatch;
+    {
+        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
+        auto it = managed_devices.find(device);
+        if (it != managed_devices.end()) {
+            dispatch = std::move(it->second);
+            managed_devices.erase(it);
+            managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+    return dispatch;
+}
+
+static std::vector<VkDevice> forget_managed_devices_for_instance(VkInstance instance)
+{
+    std::vector<VkDevice> devices;
+    {
+        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
+        for (auto it = managed_devices.begin(); it != managed_devices.end(); ) {
+            if (it->second != nullptr && it->second->parent_instance == instance) {
+                devices.push_back(it->first);
+                it = managed_devices.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!devices.empty()) {
+            managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+    return devices;
+}
+
+static VkInstance get_device_parent_instance(VkDevice device)
+{
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch != nullptr) {
+        return dispatch->parent_instance;
+    }
+
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (latest_instance != VK_NULL_HANDLE)
+    {
+        auto latest_it = managed_instances.find(latest_instance);
+        if (latest_it != managed_instances.end())
+        {
+            return latest_it->second->instance;
+        }
+    }
+
+    if (!managed_instances.empty())
+    {
+        return managed_instances.begin()->second->instance;
+    }
+
+    return VK_NULL_HANDLE;
+}
+
+static VkDevice get_any_managed_device()
+{
+    std::shared_lock<std::shared_mutex> lock(managed_device_mutex);
+    if (managed_devices.empty()) {
+        return VK_NULL_HANDLE;
+    }
+
+    return managed_devices.begin()->first;
+}
+
+static VkInstance get_any_managed_instance()
+{
+    std::lock_guard<std::mutex> lock(instance_mutex);
+    if (latest_instance != VK_NULL_HANDLE) {
+        auto latest_it = managed_instances.find(latest_instance);
+        if (latest_it != managed_instances.end()) {
+            return latest_it->second->instance;
+        }
+    }
+
+    if (managed_instances.empty()) {
+        return VK_NULL_HANDLE;
+    }
+
+    return managed_instances.begin()->second->instance;
+}
+
+template <typename T>
+static T resolve_mali_instance_proc(PFN_vkGetInstanceProcAddr mali_proc_addr, VkInstance instance,
+                                    const char* proc_name)
+{
+    if (instance != VK_NULL_HANDLE) {
+        auto proc = mali_proc_addr(instance, proc_name);
+        if (proc != nullptr) {
+            return reinterpret_cast<T>(proc);
+        }
+    }
+
+    auto global_proc = mali_proc_addr(VK_NULL_HANDLE, proc_name);
+    if (global_proc != nullptr) {
+        return reinterpret_cast<T>(global_proc);
+    }
+
+    return reinterpret_cast<T>(LibraryLoader::Instance().GetMaliProcAddr(proc_name));
+}
+
+// Mali entry points behind the interposed physical-device queries. They are
+// resolved together the first time a physical device is queried, and dropped
+// with the rest of the per-physical-device state when an instance goes away.
+struct MaliPhysicalDeviceProcs {
+    PFN_vkEnumerateDeviceExtensionProperties enumerate_device_extension_properties = nullptr;
+    PFN_vkGetPhysicalDeviceFeatures get_physical_device_features = nullptr;
+    PFN_vkGetPhysicalDeviceFeatures2 get_physical_device_features2 = nullptr;
+    PFN_vkGetPhysicalDeviceFeatures2KHR get_physical_device_features2_khr = nullptr;
+    PFN_vkGetPhysicalDeviceProperties2 get_physical_device_properties2 = nullptr;
+    PFN_vkGetPhysicalDeviceProperties2KHR get_physical_device_properties2_khr = nullptr;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 get_physical_device_memory_properties2 = nullptr;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_physical_device_memory_properties2_khr = nullptr;
+};
+
+static std::shared_mutex physical_device_procs_mutex;
+static std::unordered_map<VkPhysicalDevice, std::shared_ptr<const MaliPhysicalDeviceProcs>> physical_device_procs;
+
+static std::shared_ptr<const MaliPhysicalDeviceProcs> create_mali_physical_device_procs(
+    VkPhysicalDevice physicalDevice)
+{
+    auto procs = std::make_shared<MaliPhysicalDeviceProcs>();
+    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
+    if (mali_proc_addr == nullptr) {
+        return procs;
+    }
+
+    VkInstance instance = VK_NULL_HANDLE;
+    try {
+        auto& instance_data = instance_private_data::get(physicalDevice);
+        instance = instance_data.get_instance_handle();
+    } catch (...) {
+        instance = VK_NULL_HANDLE;
+    }
+
+    if (instance == VK_NULL_HANDLE) {
+        instance = get_any_managed_instance();
+    }
+
+    procs->enumerate_device_extension_properties = resolve_mali_instance_proc<PFN_vkEnumerateDeviceExtensionProperties>(
+        mali_proc_addr, instance, "vkEnumerateDeviceExtensionProperties");
+    procs->get_physical_device_features = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceFeatures>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceFeatures");
+    procs->get_physical_device_features2 = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceFeatures2>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceFeatures2");
+    procs->get_physical_device_features2_khr = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceFeatures2KHR");
+    procs->get_physical_device_properties2 = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceProperties2>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceProperties2");
+    procs->get_physical_device_properties2_khr = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceProperties2KHR>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceProperties2KHR");
+    procs->get_physical_device_memory_properties2 = resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+        mali_proc_addr, instance, "vkGetPhysicalDeviceMemoryProperties2");
+    procs->get_physical_device_memory_properties2_khr =
+        resolve_mali_instance_proc<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+            mali_proc_addr, instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+    return procs;
+}
+
+template <typename T>
+static T get_mali_instance_proc_for_physical_device(VkPhysicalDevice physicalDevice,
+                                                    T MaliPhysicalDeviceProcs::*member)
+{
+    std::shared_ptr<const MaliPhysicalDeviceProcs> procs;
+    {
+        std::shared_lock<std::shared_mutex> lock(physical_device_procs_mutex);
+        auto it = physical_device_procs.find(physicalDevice);
+        if (it != physical_device_procs.end()) {
+            procs = it->second;
+        }
+    }
+
+    if (procs == nullptr) {
+        procs = create_mali_physical_device_procs(physicalDevice);
+        std::unique_lock<std::shared_mutex> lock(physical_device_procs_mutex);
+        procs = physical_device_procs.emplace(physicalDevice, procs).first->second;
+    }
+
+    return procs.get()->*member;
+}
+
+struct DeviceCreateInfoFeatureSpoofCopies {
+    VkPhysicalDeviceFeatures enabled_features{};
+    VkPhysicalDeviceFeatures2 features2{};
+};
+
+static void sanitize_device_create_info_for_driver(VkDeviceCreateInfo* create_info,
+                                                   DeviceCreateInfoFeatureSpoofCopies* spoof_copies)
+{
+    if (create_info == nullptr || spoof_copies == nullptr || !is_any_dxvk_feature_spoof_enabled()) {
+        return;
+    }
+
+    if (create_info->pEnabledFeatures != nullptr) {
+        spoof_copies->enabled_features = *create_info->pEnabledFeatures;
+        sanitize_requested_physical_features_for_driver(&spoof_copies->enabled_features);
+        create_info->pEnabledFeatures = &spoof_copies->enabled_features;
+    }
+
+    const auto* base = reinterpret_cast<const VkBaseInStructure*>(create_info->pNext);
+    if (base != nullptr && base->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2) {
+        spoof_copies->features2 = *reinterpret_cast<const VkPhysicalDeviceFeatures2*>(base);
+        sanitize_requested_physical_features_for_driver(&spoof_copies->features2.features);
+        sanitize_requested_physical_feature_chain_for_driver(spoof_copies->features2.pNext);
+        create_info->pNext = &spoof_copies->features2;
+    } else {
+        sanitize_requested_physical_feature_chain_for_driver(create_info->pNext);
+    }
+}
+
+
+// Sorted for IsInProcTable().
+static constexpr std::array<std::string_view, 39> wsi_functions = {{
+    "vkAcquireNextImage2KHR",
+    "vkAcquireNextImageKHR",
+    "vkCreateDisplayModeKHR",
+    "vkCreateDisplayPlaneSurfaceKHR",
+    "vkCreateHeadlessSurfaceEXT",
+    "vkCreateSharedSwapchainsKHR",
+    "vkCreateSwapchainKHR",
+    "vkCreateWaylandSurfaceKHR",
+    "vkCreateXcbSurfaceKHR",
+    "vkCreateXlibSurfaceKHR",
+    "vkDestroySurfaceKHR",
+    "vkDestroySwapchainKHR",
+    "vkGetDisplayModeProperties2KHR",
+    "vkGetDisplayModePropertiesKHR",
+    "vkGetDisplayPlaneCapabilities2KHR",
+    "vkGetDisplayPlaneCapabilitiesKHR",
+    "vkGetDisplayPlaneSupportedDisplaysKHR",
+    "vkGetPastPresentationTimingEXT",
+    "vkGetPhysicalDeviceDisplayPlaneProperties2KHR",
+    "vkGetPhysicalDeviceDisplayPlanePropertiesKHR",
+    "vkGetPhysicalDeviceDisplayProperties2KHR",
+    "vkGetPhysicalDeviceDisplayPropertiesKHR",
+    "vkGetPhysicalDeviceSurfaceCapabilities2KHR",
+    "vkGetPhysicalDeviceSurfaceCapabilitiesKHR",
+    "vkGetPhysicalDeviceSurfaceFormats2KHR",
+    "vkGetPhysicalDeviceSurfaceFormatsKHR",
+    "vkGetPhysicalDeviceSurfacePresentModesKHR",
+    "vkGetPhysicalDeviceSurfaceSupportKHR",
+    "vkGetPhysicalDeviceWaylandPresentationSupportKHR",
+    "vkGetPhysicalDeviceXcbPresentationSupportKHR",
+    "vkGetPhysicalDeviceXlibPresentationSupportKHR",
+    "vkGetSwapchainImagesKHR",
+    "vkGetSwapchainStatusKHR",
+    "vkGetSwapchainTimeDomainPropertiesEXT",
+    "vkGetSwapchainTimingPropertiesEXT",
+    "vkQueuePresentKHR",
+    "vkReleaseDisplayEXT",
+    "vkReleaseSwapchainImagesEXT",
+    "vkSetSwapchainPresentTimingQueueSizeEXT",
+}};
+static_assert(IsProcTableSorted(wsi_functions), "wsi_functions must stay sorted");
+
+static bool IsWSIFunction(const char* name) {
+    return IsInProcTable(wsi_functions, name);
+}
+
+static bool should_install_crash_handler()
+{
+    // Keep crash handler opt-in because it can interfere with app/runtime handlers.
+    return is_bool_env_enabled("MALI_WRAPPER_CRASH_SIGNAL_HANDLER", false);
+}
+
+static bool should_filter_external_memory_host_extension()
+{
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    const bool forced = getenv("MALI_WRAPPER_FILTER_EXTERNAL_MEMORY_HOST") != nullptr;
+    if (forced) {
+        cached = is_bool_env_enabled("MALI_WRAPPER_FILTER_EXTERNAL_MEMORY_HOST", false) ? 1 : 0;
+    } else {
+        cached = is_wine_wow64_process() ? 1 : 0;
+    }
+
+    if (cached == 1) {
+        LOG_WARN("Filtering VK_EXT_external_memory_host from device extension list");
+    }
+    return cached == 1;
+}
+
+static bool is_filtered_device_extension(const char* extension_name)
+{
+    if (extension_name == nullptr) {
+        return false;
+    }
+
+    return should_filter_external_memory_host_extension() &&
+           strcmp(extension_name, "VK_EXT_external_memory_host") == 0;
+}
+
+static size_t filter_device_extension_vector(std::vector<const char*>* extensions)
+{
+    if (extensions == nullptr || extensions->empty()) {
+        return 0;
+    }
+
+    const size_t before = extensions->size();
+    extensions->erase(
+        std::remove_if(extensions->begin(), extensions->end(),
+                       [](const char* extension_name) {
+                           return is_filtered_device_extension(extension_name);
+                       }),
+        extensions->end());
+    return before - extensions->size();
+}
+
+static PFN_vkEnumerateDeviceExtensionProperties get_mali_enumerate_device_extension_properties(
+    VkPhysicalDevice physical_device)
+{
+    auto mali_enumerate = get_mali_instance_proc_for_physical_device(
+        physical_device, &MaliPhysicalDeviceProcs::enumerate_device_extension_properties);
+    if (mali_enumerate == nullptr) {
+        mali_enumerate = reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(
+            LibraryLoader::Instance().GetMaliProcAddr("vkEnumerateDeviceExtensionProperties"));
+    }
+    return mali_enumerate;
+}
+
+static VkResult enumerate_mali_device_extensions(PFN_vkEnumerateDeviceExtensionProperties mali_enumerate,
+                                                 VkPhysicalDevice physical_device,
+                                                 std::vector<VkExtensionProperties>* out_extensions)
+{
+    uint32_t mali_count = 0;
+    VkResult result = mali_enumerate(physical_device, nullptr, &mali_count, nullptr);
+    if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+        return result;
+    }
+
+    out_extensions->resize(mali_count);
+    if (mali_count > 0) {
+        result = mali_enumerate(physical_device, nullptr, &mali_count, out_extensions->data());
+        if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+            return result;
+        }
+        out_extensions->resize(mali_count);
+    }
+    return VK_SUCCESS;
 }
 
-static void remember_managed_device(VkDevice device, VkInstance parent_instance)
+// VK_EXT_map_memory_placed is provided on top of the low-address alias and
+// shadow paths; MALI_WRAPPER_MAP_MEMORY_PLACED=0 stops advertising it.
+static bool should_provide_map_memory_placed()
 {
-    if (device == VK_NULL_HANDLE) {
-        return;
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
 
-    auto dispatch = create_managed_device_dispatch(device, parent_instance);
-    {
-        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
-        managed_devices[device] = std::move(dispatch);
-        managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+#ifdef VK_EXT_map_memory_placed
+    cached = (should_use_low_address_shadow_map() &&
+              is_bool_env_enabled("MALI_WRAPPER_MAP_MEMORY_PLACED", true)) ? 1 : 0;
+#else
+    cached = 0;
+#endif
+    return cached == 1;
+}
+
+static bool is_map_memory_placed_provided_by_wrapper(const std::vector<VkExtensionProperties>& driver_extensions)
+{
+#ifdef VK_EXT_map_memory_placed
+    if (!should_provide_map_memory_placed()) {
+        return false;
+    }
+
+    bool has_map_memory2 = false;
+    for (const auto& extension : driver_extensions) {
+        if (strcmp(extension.extensionName, VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME) == 0) {
+            return false;
+        }
+        if (strcmp(extension.extensionName, VK_KHR_MAP_MEMORY_2_EXTENSION_NAME) == 0) {
+            has_map_memory2 = true;
+        }
     }
+    return has_map_memory2;
+#else
+    (void)driver_extensions;
+    return false;
+#endif
 }
 
-static std::shared_ptr<const ManagedDeviceDispatch> get_managed_device_dispatch(VkDevice device)
+// VK_KHR_incremental_present only adds a hint to vkQueuePresentKHR, which the
+// WSI layer reads itself, so it is advertised even when the driver lacks it.
+// MALI_WRAPPER_INCREMENTAL_PRESENT=0 stops advertising it.
+static bool should_provide_incremental_present()
 {
-    if (device == VK_NULL_HANDLE) {
-        return nullptr;
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
     }
 
-    thread_local uint64_t cached_generation = 0;
-    thread_local VkDevice cached_device = VK_NULL_HANDLE;
-    thread_local std::shared_ptr<const ManagedDeviceDispatch> cached_dispatch;
+#ifdef VK_KHR_incremental_present
+    cached = is_bool_env_enabled("MALI_WRAPPER_INCREMENTAL_PRESENT", true) ? 1 : 0;
+#else
+    cached = 0;
+#endif
+    return cached == 1;
+}
 
-    const uint64_t generation = managed_device_generation.load(std::memory_order_acquire);
-    if (cached_generation == generation && cached_device == device) {
-        return cached_dispatch;
+static bool is_incremental_present_provided_by_wrapper(const std::vector<VkExtensionProperties>& driver_extensions)
+{
+#ifdef VK_KHR_incremental_present
+    if (!should_provide_incremental_present()) {
+        return false;
     }
 
-    std::shared_ptr<const ManagedDeviceDispatch> dispatch;
-    {
-        std::shared_lock<std::shared_mutex> lock(managed_device_mutex);
-        auto it = managed_devices.find(device);
-        if (it != managed_devices.end()) {
-            dispatch = it->second;
+    for (const auto& extension : driver_extensions) {
+        if (strcmp(extension.extensionName, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME) == 0) {
+            return false;
         }
     }
-
-    cached_generation = generation;
-    cached_device = device;
-    cached_dispatch = dispatch;
-    return dispatch;
+    return true;
+#else
+    (void)driver_extensions;
+    return false;
+#endif
 }
 
-static std::shared_ptr<const ManagedDeviceDispatch> forget_managed_device(VkDevice device)
+// Answers to physical device queries, kept per physical device. The driver's
+// cannot change while its instance lives and the env config that filters and
+// spoofs them is only read once, so each is computed on first use: DXVK and
+// vkd3d-proton repeat these queries dozens of times while starting up.
+// Entries are dropped when an instance is destroyed; callers hold a reference
+// to the entry they read the extension fields of.
+struct PhysicalDeviceQueryCache {
+    // The extension fields are written once, before extensions_valid is set
+    // under the exclusive lock, and read without it afterwards.
+    bool extensions_valid = false;
+    std::vector<VkExtensionProperties> wrapper_extensions;
+    bool map_memory_placed_provided = false;
+    bool incremental_present_provided = false;
+
+    // Guarded by physical_device_cache_mutex. Core features as advertised,
+    // and the bodies after the sType/pNext header of the feature structs
+    // vkGetPhysicalDeviceFeatures2 returned so far.
+    bool features_valid = false;
+    VkPhysicalDeviceFeatures features{};
+    std::unordered_map<VkStructureType, std::vector<uint8_t>> feature_structs;
+};
+
+static std::shared_mutex physical_device_cache_mutex;
+static std::unordered_map<VkPhysicalDevice, std::shared_ptr<PhysicalDeviceQueryCache>> physical_device_cache;
+
+static void forget_physical_device_queries()
 {
-    std::shared_ptr<const ManagedDeviceDispatch> dispatch;
     {
-        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
-        auto it = managed_devices.find(device);
-        if (it != managed_devices.end()) {
-            dispatch = std::move(it->second);
-            managed_devices.erase(it);
-            managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
-        }
+        std::unique_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+        physical_device_cache.clear();
     }
-    return dispatch;
+    std::unique_lock<std::shared_mutex> lock(physical_device_procs_mutex);
+    physical_device_procs.clear();
 }
 
-static std::vector<VkDevice> forget_managed_devices_for_instance(VkInstance instance)
+// Instances vkDestroyInstance parked instead of destroying, oldest first, so
+// Wine/DXVK re-creating the same instance while enumerating adapters get the
+// driver's instance back without initializing it again. They keep their WSI
+// association and the physical device query caches. Guarded by
+// instance_mutex.
+static std::vector<std::unique_ptr<InstanceInfo>> parked_instances;
+
+constexpr size_t kMaxParkedInstances = 2;
+
+// MALI_WRAPPER_INSTANCE_REUSE_MS, 0 disables parking.
+static std::chrono::milliseconds get_instance_reuse_window()
 {
-    std::vector<VkDevice> devices;
-    {
-        std::unique_lock<std::shared_mutex> lock(managed_device_mutex);
-        for (auto it = managed_devices.begin(); it != managed_devices.end(); ) {
-            if (it->second != nullptr && it->second->parent_instance == instance) {
-                devices.push_back(it->first);
-                it = managed_devices.erase(it);
-            } else {
-                ++it;
-            }
-        }
-        if (!devices.empty()) {
-            managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+    static const std::chrono::milliseconds window = []() {
+        const char* value = getenv("MALI_WRAPPER_INSTANCE_REUSE_MS");
+        if (value == nullptr || value[0] < '0' || value[0] > '9') {
+            return std::chrono::milliseconds(2000);
         }
-    }
-    return devices;
+        return std::chrono::milliseconds(std::strtoul(value, nullptr, 10));
+    }();
+    return window;
 }
 
-static VkInstance get_device_parent_instance(VkDevice device)
+// Returns the key of a create that may be served from, or parked for, the
+// pool, or nullptr. Application allocators and pNext chains (debug
+// messengers, validation features, ...) are passed through as they are.
+static std::unique_ptr<InstanceCreateKey> make_instance_create_key(const VkInstanceCreateInfo& create_info,
+                                                                    const VkAllocationCallbacks* pAllocator)
 {
-    auto dispatch = get_managed_device_dispatch(device);
-    if (dispatch != nullptr) {
-        return dispatch->parent_instance;
+    if (get_instance_reuse_window().count() == 0 || pAllocator != nullptr || create_info.pNext != nullptr) {
+        return nullptr;
     }
 
-    std::lock_guard<std::mutex> lock(instance_mutex);
-    if (latest_instance != VK_NULL_HANDLE)
-    {
-        auto latest_it = managed_instances.find(latest_instance);
-        if (latest_it != managed_instances.end())
-        {
-            return latest_it->second->instance;
+    auto key = std::make_unique<InstanceCreateKey>();
+    key->flags = create_info.flags;
+    if (const VkApplicationInfo* app_info = create_info.pApplicationInfo) {
+        if (app_info->pNext != nullptr) {
+            return nullptr;
         }
+        key->has_application_info = true;
+        key->api_version = app_info->apiVersion;
+        key->application_version = app_info->applicationVersion;
+        key->engine_version = app_info->engineVersion;
+        key->application_name = app_info->pApplicationName != nullptr ? app_info->pApplicationName : "";
+        key->engine_name = app_info->pEngineName != nullptr ? app_info->pEngineName : "";
     }
-
-    if (!managed_instances.empty())
-    {
-        return managed_instances.begin()->second->instance;
+    for (uint32_t i = 0; i < create_info.enabledLayerCount; ++i) {
+        key->layers.emplace_back(create_info.ppEnabledLayerNames[i]);
     }
-
-    return VK_NULL_HANDLE;
+    for (uint32_t i = 0; i < create_info.enabledExtensionCount; ++i) {
+        key->extensions.emplace_back(create_info.ppEnabledExtensionNames[i]);
+    }
+    std::sort(key->extensions.begin(), key->extensions.end());
+    return key;
 }
 
-static VkDevice get_any_managed_device()
+static void destroy_driver_instance(VkInstance instance, const VkAllocationCallbacks* pAllocator)
 {
-    std::shared_lock<std::shared_mutex> lock(managed_device_mutex);
-    if (managed_devices.empty()) {
-        return VK_NULL_HANDLE;
+    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
+    if (mali_proc_addr) {
+        auto mali_destroy = reinterpret_cast<PFN_vkDestroyInstance>(
+            mali_proc_addr(instance, "vkDestroyInstance"));
+        if (mali_destroy) {
+            mali_destroy(instance, pAllocator);
+        }
     }
 
-    return managed_devices.begin()->first;
+    // Its physical device handles may be reused by a later instance.
+    forget_physical_device_queries();
+    GetWSIManager().release_instance(instance);
 }
 
-static VkInstance get_any_managed_instance()
+// Moves parked instances older than the reuse window, or all of them, out of
+// the pool. The caller holds instance_mutex and destroys them after dropping it.
+static std::vector<std::unique_ptr<InstanceInfo>> take_expired_parked_instances(bool all)
 {
-    std::lock_guard<std::mutex> lock(instance_mutex);
-    if (latest_instance != VK_NULL_HANDLE) {
-        auto latest_it = managed_instances.find(latest_instance);
-        if (latest_it != managed_instances.end()) {
-            return latest_it->second->instance;
+    std::vector<std::unique_ptr<InstanceInfo>> expired;
+    const auto now = std::chrono::steady_clock::now();
+    auto it = parked_instances.begin();
+    while (it != parked_instances.end()) {
+        if (all || now - (*it)->destroy_time >= get_instance_reuse_window()) {
+            expired.push_back(std::move(*it));
+            it = parked_instances.erase(it);
+        } else {
+            ++it;
         }
     }
+    return expired;
+}
 
-    if (managed_instances.empty()) {
-        return VK_NULL_HANDLE;
+static void destroy_parked_instances(std::vector<std::unique_ptr<InstanceInfo>> instances)
+{
+    for (const auto& info : instances) {
+        destroy_driver_instance(info->instance, nullptr);
+        LOG_INFO("Parked instance destroyed");
     }
-
-    return managed_instances.begin()->second->instance;
 }
 
-template <typename T>
-static T get_mali_instance_proc_for_physical_device(VkPhysicalDevice physicalDevice, const char* proc_name)
+static void shutdown_instance_pool()
 {
-    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
-    if (mali_proc_addr == nullptr || proc_name == nullptr) {
-        return nullptr;
+    std::vector<std::unique_ptr<InstanceInfo>> parked;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        parked = take_expired_parked_instances(true);
     }
+    destroy_parked_instances(std::move(parked));
+}
 
-    VkInstance instance = VK_NULL_HANDLE;
-    try {
-        auto& instance_data = instance_private_data::get(physicalDevice);
-        instance = instance_data.get_instance_handle();
-    } catch (...) {
-        instance = VK_NULL_HANDLE;
+static std::vector<VkExtensionProperties> build_wrapper_device_extensions(
+    const std::vector<VkExtensionProperties>& driver_extensions)
+{
+    std::vector<VkExtensionProperties> wrapper_extensions;
+    wrapper_extensions.reserve(driver_extensions.size() + 2);
+    for (const auto& extension : driver_extensions) {
+        if (!is_filtered_device_extension(extension.extensionName)) {
+            wrapper_extensions.push_back(extension);
+        }
     }
-
-    if (instance == VK_NULL_HANDLE) {
-        instance = get_any_managed_instance();
+#ifdef VK_EXT_map_memory_placed
+    if (is_map_memory_placed_provided_by_wrapper(driver_extensions)) {
+        VkExtensionProperties placed{};
+        std::snprintf(placed.extensionName, sizeof(placed.extensionName), "%s",
+                      VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME);
+        placed.specVersion = VK_EXT_MAP_MEMORY_PLACED_SPEC_VERSION;
+        wrapper_extensions.push_back(placed);
     }
-
-    if (instance != VK_NULL_HANDLE) {
-        auto proc = mali_proc_addr(instance, proc_name);
-        if (proc != nullptr) {
-            return reinterpret_cast<T>(proc);
-        }
+#endif
+#ifdef VK_KHR_incremental_present
+    if (is_incremental_present_provided_by_wrapper(driver_extensions)) {
+        VkExtensionProperties incremental{};
+        std::snprintf(incremental.extensionName, sizeof(incremental.extensionName), "%s",
+                      VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+        incremental.specVersion = VK_KHR_INCREMENTAL_PRESENT_SPEC_VERSION;
+        wrapper_extensions.push_back(incremental);
     }
+#endif
+    return wrapper_extensions;
+}
 
-    auto global_proc = mali_proc_addr(VK_NULL_HANDLE, proc_name);
-    if (global_proc != nullptr) {
-        return reinterpret_cast<T>(global_proc);
+// Entry of the physical device, created if it has none. Called with
+// physical_device_cache_mutex held exclusively.
+static PhysicalDeviceQueryCache& get_physical_device_cache_locked(VkPhysicalDevice physical_device)
+{
+    auto& entry = physical_device_cache[physical_device];
+    if (entry == nullptr) {
+        entry = std::make_shared<PhysicalDeviceQueryCache>();
     }
-
-    return reinterpret_cast<T>(LibraryLoader::Instance().GetMaliProcAddr(proc_name));
+    return *entry;
 }
 
-struct DeviceCreateInfoFeatureSpoofCopies {
-    VkPhysicalDeviceFeatures enabled_features{};
-    VkPhysicalDeviceFeatures2 features2{};
-};
-
-static void sanitize_device_create_info_for_driver(VkDeviceCreateInfo* create_info,
-                                                   DeviceCreateInfoFeatureSpoofCopies* spoof_copies)
+// Returns the physical device's cache entry with its extension fields filled,
+// asking the driver on first use.
+static VkResult get_device_extension_cache(VkPhysicalDevice physical_device,
+                                           std::shared_ptr<const PhysicalDeviceQueryCache>* out)
 {
-    if (create_info == nullptr || spoof_copies == nullptr || !is_any_dxvk_feature_spoof_enabled()) {
-        return;
+    {
+        std::shared_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+        auto it = physical_device_cache.find(physical_device);
+        if (it != physical_device_cache.end() && it->second->extensions_valid) {
+            *out = it->second;
+            return VK_SUCCESS;
+        }
     }
 
-    if (create_info->pEnabledFeatures != nullptr) {
-        spoof_copies->enabled_features = *create_info->pEnabledFeatures;
-        sanitize_requested_physical_features_for_driver(&spoof_copies->enabled_features);
-        create_info->pEnabledFeatures = &spoof_copies->enabled_features;
+    auto mali_enumerate = get_mali_enumerate_device_extension_properties(physical_device);
+    if (mali_enumerate == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    std::vector<VkExtensionProperties> driver_extensions;
+    const VkResult result = enumerate_mali_device_extensions(mali_enumerate, physical_device, &driver_extensions);
+    if (result != VK_SUCCESS) {
+        return result;
     }
+    std::vector<VkExtensionProperties> wrapper_extensions = build_wrapper_device_extensions(driver_extensions);
+    const bool placed = is_map_memory_placed_provided_by_wrapper(driver_extensions);
+    const bool incremental = is_incremental_present_provided_by_wrapper(driver_extensions);
 
-    const auto* base = reinterpret_cast<const VkBaseInStructure*>(create_info->pNext);
-    if (base != nullptr && base->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2) {
-        spoof_copies->features2 = *reinterpret_cast<const VkPhysicalDeviceFeatures2*>(base);
-        sanitize_requested_physical_features_for_driver(&spoof_copies->features2.features);
-        sanitize_requested_physical_feature_chain_for_driver(spoof_copies->features2.pNext);
-        create_info->pNext = &spoof_copies->features2;
-    } else {
-        sanitize_requested_physical_feature_chain_for_driver(create_info->pNext);
+    std::unique_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+    auto& entry = get_physical_device_cache_locked(physical_device);
+    if (!entry.extensions_valid) {
+        entry.wrapper_extensions = std::move(wrapper_extensions);
+        entry.map_memory_placed_provided = placed;
+        entry.incremental_present_provided = incremental;
+        entry.extensions_valid = true;
     }
+    *out = physical_device_cache[physical_device];
+    return VK_SUCCESS;
 }
 
+static bool is_map_memory_placed_provided_by_wrapper(VkPhysicalDevice physical_device)
+{
+    if (!should_provide_map_memory_placed()) {
+        return false;
+    }
 
-static const std::unordered_set<std::string> wsi_functions = {
-    // Surface functions
-    "vkCreateXlibSurfaceKHR",
-    "vkCreateXcbSurfaceKHR",
-    "vkCreateWaylandSurfaceKHR",
-    "vkCreateDisplaySurfaceKHR",
-    "vkCreateHeadlessSurfaceEXT",
-    "vkDestroySurfaceKHR",
-    "vkGetPhysicalDeviceSurfaceSupportKHR",
-    "vkGetPhysicalDeviceSurfaceCapabilitiesKHR",
-    "vkGetPhysicalDeviceSurfaceCapabilities2KHR",
-    "vkGetPhysicalDeviceSurfaceFormatsKHR",
-    "vkGetPhysicalDeviceSurfaceFormats2KHR",
-    "vkGetPhysicalDeviceSurfacePresentModesKHR",
-
-    // Swapchain functions
-    "vkCreateSwapchainKHR",
-    "vkCreateSharedSwapchainsKHR",
-    "vkDestroySwapchainKHR",
-    "vkGetSwapchainImagesKHR",
-    "vkAcquireNextImageKHR",
-    "vkAcquireNextImage2KHR",
-    "vkQueuePresentKHR",
-    "vkGetSwapchainStatusKHR",
-    "vkReleaseSwapchainImagesEXT",
-
-    // Display functions
-    "vkGetPhysicalDeviceDisplayPropertiesKHR",
-    "vkGetPhysicalDeviceDisplayProperties2KHR",
-    "vkGetPhysicalDeviceDisplayPlanePropertiesKHR",
-    "vkGetPhysicalDeviceDisplayPlaneProperties2KHR",
-    "vkGetDisplayPlaneSupportedDisplaysKHR",
-    "vkGetDisplayModePropertiesKHR",
-    "vkGetDisplayModeProperties2KHR",
-    "vkCreateDisplayModeKHR",
-    "vkGetDisplayPlaneCapabilitiesKHR",
-    "vkGetDisplayPlaneCapabilities2KHR",
-
-    // Present timing functions
-    "vkGetSwapchainTimingPropertiesEXT",
-    "vkGetSwapchainTimeDomainPropertiesEXT",
-    "vkGetPastPresentationTimingEXT",
-    "vkSetSwapchainPresentTimingQueueSizeEXT",
+    std::shared_ptr<const PhysicalDeviceQueryCache> cache;
+    return get_device_extension_cache(physical_device, &cache) == VK_SUCCESS && cache->map_memory_placed_provided;
+}
 
-    // Presentation support functions
-    "vkGetPhysicalDeviceWaylandPresentationSupportKHR",
-    "vkGetPhysicalDeviceXlibPresentationSupportKHR",
-    "vkGetPhysicalDeviceXcbPresentationSupportKHR"
-};
+static bool is_incremental_present_provided_by_wrapper(VkPhysicalDevice physical_device)
+{
+    if (!should_provide_incremental_present()) {
+        return false;
+    }
 
-static bool IsWSIFunction(const char* name) {
-    return wsi_functions.find(name) != wsi_functions.end();
+    std::shared_ptr<const PhysicalDeviceQueryCache> cache;
+    return get_device_extension_cache(physical_device, &cache) == VK_SUCCESS && cache->incremental_present_provided;
 }
 
-static bool should_install_crash_handler()
+// Drops wrapper-implemented extensions from the list handed to the driver and
+// returns true when the application enabled VK_EXT_map_memory_placed.
+static bool strip_wrapper_device_extensions(VkPhysicalDevice physical_device, const char* const** names,
+                                            size_t* count, std::vector<const char*>* storage)
 {
-    // Keep crash handler opt-in because it can interfere with app/runtime handlers.
-    return is_bool_env_enabled("MALI_WRAPPER_CRASH_SIGNAL_HANDLER", false);
-}
+    if (*names == nullptr || *count == 0 ||
+        (!should_provide_map_memory_placed() && !should_provide_incremental_present())) {
+        return false;
+    }
+
+    bool placed_requested = false;
+    bool incremental_requested = false;
+    for (size_t i = 0; i < *count; i++) {
+        const char* name = (*names)[i];
+        if (name == nullptr) {
+            continue;
+        }
+#ifdef VK_EXT_map_memory_placed
+        placed_requested = placed_requested || strcmp(name, VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME) == 0;
+#endif
+#ifdef VK_KHR_incremental_present
+        incremental_requested = incremental_requested || strcmp(name, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME) == 0;
+#endif
+    }
 
-static bool should_filter_external_memory_host_extension()
-{
-    static int cached = -1;
-    if (cached >= 0) {
-        return cached == 1;
+    const bool strip_placed = placed_requested && is_map_memory_placed_provided_by_wrapper(physical_device);
+    const bool strip_incremental =
+        incremental_requested && is_incremental_present_provided_by_wrapper(physical_device);
+    if (!strip_placed && !strip_incremental) {
+        return false;
     }
 
-    const bool forced = getenv("MALI_WRAPPER_FILTER_EXTERNAL_MEMORY_HOST") != nullptr;
-    if (forced) {
-        cached = is_bool_env_enabled("MALI_WRAPPER_FILTER_EXTERNAL_MEMORY_HOST", false) ? 1 : 0;
-    } else {
-        cached = (getenv("WINEWOW64") != nullptr || getenv("WINE_WOW64") != nullptr) ? 1 : 0;
+    std::vector<const char*> kept;
+    kept.reserve(*count);
+    for (size_t i = 0; i < *count; i++) {
+        const char* name = (*names)[i];
+        bool drop = false;
+#ifdef VK_EXT_map_memory_placed
+        drop = drop || (strip_placed && name != nullptr && strcmp(name, VK_EXT_MAP_MEMORY_PLACED_EXTENSION_NAME) == 0);
+#endif
+#ifdef VK_KHR_incremental_present
+        drop = drop ||
+               (strip_incremental && name != nullptr && strcmp(name, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME) == 0);
+#endif
+        if (!drop) {
+            kept.push_back(name);
+        }
     }
 
-    if (cached == 1) {
-        LOG_WARN("Filtering VK_EXT_external_memory_host from device extension list");
+    *storage = std::move(kept);
+    *names = storage->data();
+    *count = storage->size();
+    if (strip_placed) {
+        LOG_INFO("VK_EXT_map_memory_placed enabled; placed maps are handled by the wrapper");
     }
-    return cached == 1;
+    if (strip_incremental) {
+        LOG_INFO("VK_KHR_incremental_present enabled; present regions are handled by the WSI layer");
+    }
+    return strip_placed;
 }
 
-static bool is_filtered_device_extension(const char* extension_name)
+static void advertise_wrapper_device_feature_chain(VkPhysicalDevice physical_device, void* pnext)
 {
-    if (extension_name == nullptr) {
-        return false;
+#ifdef VK_EXT_map_memory_placed
+    for (auto* current = reinterpret_cast<VkBaseOutStructure*>(pnext); current != nullptr; current = current->pNext) {
+        if (current->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_FEATURES_EXT &&
+            is_map_memory_placed_provided_by_wrapper(physical_device)) {
+            auto* placed = reinterpret_cast<VkPhysicalDeviceMapMemoryPlacedFeaturesEXT*>(current);
+            placed->memoryMapPlaced = VK_TRUE;
+            placed->memoryMapRangePlaced = VK_TRUE;
+            placed->memoryUnmapReserve = VK_TRUE;
+        }
     }
-
-    return should_filter_external_memory_host_extension() &&
-           strcmp(extension_name, "VK_EXT_external_memory_host") == 0;
+#else
+    (void)physical_device;
+    (void)pnext;
+#endif
 }
 
-static size_t filter_device_extension_vector(std::vector<const char*>* extensions)
+static void advertise_wrapper_device_property_chain(VkPhysicalDevice physical_device, void* pnext)
 {
-    if (extensions == nullptr || extensions->empty()) {
-        return 0;
+#ifdef VK_EXT_map_memory_placed
+    for (auto* current = reinterpret_cast<VkBaseOutStructure*>(pnext); current != nullptr; current = current->pNext) {
+        if (current->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_PROPERTIES_EXT &&
+            is_map_memory_placed_provided_by_wrapper(physical_device)) {
+            auto* placed = reinterpret_cast<VkPhysicalDeviceMapMemoryPlacedPropertiesEXT*>(current);
+            placed->minPlacedMemoryMapAlignment = static_cast<VkDeviceSize>(get_page_size());
+        }
     }
-
-    const size_t before = extensions->size();
-    extensions->erase(
-        std::remove_if(extensions->begin(), extensions->end(),
-                       [](const char* extension_name) {
-                           return is_filtered_device_extension(extension_name);
-                       }),
-        extensions->end());
-    return before - extensions->size();
+#else
+    (void)physical_device;
+    (void)pnext;
+#endif
 }
 
 static bool should_guard_graphics_pipeline_create_with_signals()
@@ -1741,18 +4733,40 @@ static bool should_guard_graphics_pipeline_create_with_signals()
     return cached == 1;
 }
 
-static void graphics_pipeline_signal_guard_handler(int sig, siginfo_t* /*info*/, void* /*ctx*/)
+static void graphics_pipeline_signal_guard_handler(int sig, siginfo_t* info, void* ctx)
 {
+    // Shadow write-tracking faults from any thread can land here when the
+    // guard was installed after the dirty-tracking handler.
+    if (sig == SIGSEGV && info != nullptr && handle_shadow_dirty_write_fault(info->si_addr)) {
+        return;
+    }
+
+    // Synchronous faults are delivered to the faulting thread, so only a
+    // thread inside a guarded call jumps back to it.
     if (graphics_pipeline_signal_guard_active) {
         graphics_pipeline_signal_guard_caught_signal = sig;
         siglongjmp(graphics_pipeline_signal_guard_env, 1);
     }
 
-    struct sigaction sa{};
-    sa.sa_handler = SIG_DFL;
-    sigemptyset(&sa.sa_mask);
-    sigaction(sig, &sa, nullptr);
-    raise(sig);
+    forward_to_previous_signal_action(sig == SIGBUS ? graphics_pipeline_signal_guard_previous_bus_action
+                                                    : graphics_pipeline_signal_guard_previous_segv_action,
+                                      sig, info, ctx);
+}
+
+// Installs the guard handler for the whole process once. Each thread only
+// arms it around its own calls, so guarded creates run concurrently.
+static void install_graphics_pipeline_signal_guard()
+{
+    static std::once_flag install_once;
+    std::call_once(install_once, []() {
+        struct sigaction guard_action{};
+        guard_action.sa_sigaction = graphics_pipeline_signal_guard_handler;
+        sigemptyset(&guard_action.sa_mask);
+        guard_action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+
+        sigaction(SIGSEGV, &guard_action, &graphics_pipeline_signal_guard_previous_segv_action);
+        sigaction(SIGBUS, &guard_action, &graphics_pipeline_signal_guard_previous_bus_action);
+    });
 }
 
 static VkResult call_vkCreateGraphicsPipelines_with_signal_guard(
@@ -1774,17 +4788,7 @@ static VkResult call_vkCreateGraphicsPipelines_with_signal_guard(
             device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
     }
 
-    std::lock_guard<std::mutex> lock(graphics_pipeline_signal_guard_mutex);
-
-    struct sigaction guard_action{};
-    guard_action.sa_sigaction = graphics_pipeline_signal_guard_handler;
-    sigemptyset(&guard_action.sa_mask);
-    guard_action.sa_flags = SA_SIGINFO;
-
-    struct sigaction old_segv{};
-    struct sigaction old_bus{};
-    sigaction(SIGSEGV, &guard_action, &old_segv);
-    sigaction(SIGBUS, &guard_action, &old_bus);
+    install_graphics_pipeline_signal_guard();
 
     graphics_pipeline_signal_guard_caught_signal = 0;
     graphics_pipeline_signal_guard_active = 1;
@@ -1798,8 +4802,6 @@ static VkResult call_vkCreateGraphicsPipelines_with_signal_guard(
     }
 
     graphics_pipeline_signal_guard_active = 0;
-    sigaction(SIGSEGV, &old_segv, nullptr);
-    sigaction(SIGBUS, &old_bus, nullptr);
 
     if (trapped_signal != nullptr && *trapped_signal) {
         LOG_ERROR("vkCreateGraphicsPipelines trapped signal " +
@@ -1828,6 +4830,8 @@ static void crash_signal_handler(int sig, siginfo_t* info, void* /*ctx*/)
     write(STDERR_FILENO, sigbuf, len);
     write(STDERR_FILENO, "\n", 1);
     backtrace_symbols_fd(frames, n, STDERR_FILENO);
+    // Messages still queued by MALI_WRAPPER_LOG_ASYNC often explain the crash.
+    Logger::Instance().FlushFromSignal();
     // Re-raise with default handler to produce core dump
     struct sigaction sa{};
     sa.sa_handler = SIG_DFL;
@@ -1837,11 +4841,23 @@ static void crash_signal_handler(int sig, siginfo_t* info, void* /*ctx*/)
 }
 
 bool InitializeWrapper() {
+    // Starts the clock the first-instance time in the startup summary is measured from.
+    StartupProfile::Instance();
+
     if (getenv("MALI_WRAPPER_DEBUG")) {
         Logger::Instance().SetLevel(LogLevel::DEBUG);
     }
 
-    if (should_collect_low_address_map_stats()) {
+    MetricsPage::Instance().SetLowAddressSource(fill_metrics_page_low_address_counters);
+    if (IsTraceEnabled()) {
+        // Creating the tracer installs the SIGUSR2 dump handler.
+        Tracer::Instance();
+    }
+    if (IsMemoryRecordingEnabled()) {
+        MemoryRecorder::Instance();
+    }
+
+    if (should_log_low_address_map_stats()) {
         LOW_ADDRESS_LOG_INFO("Low-address map debug enabled: level=" +
                              std::to_string(get_low_address_map_debug_level()) +
                              ", workaround=" +
@@ -1874,7 +4890,15 @@ bool InitializeWrapper() {
 
 void ShutdownWrapper() {
     log_low_address_map_summary();
+    MetricsPage::Instance().Shutdown();
+    Tracer::Instance().Dump("unload");
+    if (IsMemoryRecordingEnabled()) {
+        MemoryRecorder::Instance().Flush("unload");
+    }
+    CopyEngine::Instance().Shutdown();
+    PipelineCompilePool::Instance().Shutdown();
     LOG_INFO("Shutting down Mali Wrapper ICD");
+    shutdown_instance_pool();
     GetWSIManager().cleanup();
     LibraryLoader::Instance().UnloadLibraries();
 }
@@ -1895,6 +4919,10 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkEnumerateDeviceExtensionPropert
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures* pFeatures);
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2* pFeatures);
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR* pFeatures);
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2* pProperties);
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceProperties2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties2KHR* pProperties);
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties);
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceMemoryProperties2KHR(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2KHR* pMemoryProperties);
 static VKAPI_ATTR VkResult VKAPI_CALL mali_driver_create_device(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDevice* pDevice);
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkAllocateMemory(
     VkDevice device,
@@ -1973,6 +5001,59 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL filtered_mali_get_instance_proc_
     return nullptr;
 }
 
+// The driver's instance extensions cannot change while it is loaded, so they
+// are asked for once; applications and the loader enumerate them repeatedly
+// during startup.
+static const std::vector<VkExtensionProperties>& get_mali_instance_extensions() {
+    using namespace mali_wrapper;
+
+    static std::once_flag once;
+    static std::vector<VkExtensionProperties> mali_extensions;
+    if (!LibraryLoader::Instance().IsLoaded()) {
+        static const std::vector<VkExtensionProperties> none;
+        return none;
+    }
+    std::call_once(once, []() {
+        auto mali_enumerate = reinterpret_cast<PFN_vkEnumerateInstanceExtensionProperties>(
+            LibraryLoader::Instance().GetMaliProcAddr("vkEnumerateInstanceExtensionProperties"));
+        if (mali_enumerate) {
+            uint32_t mali_count = 0;
+            VkResult result = mali_enumerate(nullptr, &mali_count, nullptr);
+            if (result == VK_SUCCESS && mali_count > 0) {
+                mali_extensions.resize(mali_count);
+                if (mali_enumerate(nullptr, &mali_count, mali_extensions.data()) < 0) {
+                    mali_count = 0;
+                }
+                mali_extensions.resize(mali_count);
+            }
+        }
+    });
+    return mali_extensions;
+}
+
+#if BUILD_WSI_DISPLAY
+// VK_KHR_display is implemented by the WSI layer on top of KMS, and Mali builds
+// for a window system lack it: asking Mali for it would fail instance creation.
+static void remove_wrapper_only_instance_extensions(std::vector<const char*>& extensions) {
+    static constexpr const char* wrapper_extensions[] = {
+        VK_KHR_DISPLAY_EXTENSION_NAME,
+        VK_EXT_DIRECT_MODE_DISPLAY_EXTENSION_NAME,
+    };
+
+    const std::vector<VkExtensionProperties>& mali_extensions = get_mali_instance_extensions();
+    auto is_wrapper_only = [&](const char* name) {
+        bool provided_by_wrapper = std::any_of(std::begin(wrapper_extensions), std::end(wrapper_extensions),
+                                               [&](const char* ext) { return strcmp(ext, name) == 0; });
+        if (!provided_by_wrapper) {
+            return false;
+        }
+        return std::none_of(mali_extensions.begin(), mali_extensions.end(),
+                            [&](const VkExtensionProperties& ext) { return strcmp(ext.extensionName, name) == 0; });
+    };
+    extensions.erase(std::remove_if(extensions.begin(), extensions.end(), is_wrapper_only), extensions.end());
+}
+#endif
+
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
     const VkInstanceCreateInfo* pCreateInfo,
     const VkAllocationCallbacks* pAllocator,
@@ -1985,6 +5066,10 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
+    if (pCreateInfo->pApplicationInfo != nullptr) {
+        PersistentPipelineCache::SetApplicationName(pCreateInfo->pApplicationInfo->pApplicationName);
+    }
+
     std::vector<const char *> enabled_extensions;
     std::unique_ptr<util::extension_list> instance_extension_list;
     util::wsi_platform_set enabled_platforms;
@@ -1999,9 +5084,13 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
 #if BUILD_WSI_HEADLESS
     enabled_platforms.add(VK_ICD_WSI_PLATFORM_HEADLESS);
 #endif
+#if BUILD_WSI_DISPLAY
+    enabled_platforms.add(VK_ICD_WSI_PLATFORM_DISPLAY);
+#endif
 
     try
     {
+        StartupPhaseScope extensions_scope(StartupPhase::EXTENSION_ENUMERATION);
         util::allocator base_allocator = util::allocator::get_generic();
         util::allocator extension_allocator(base_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
         instance_extension_list = std::make_unique<util::extension_list>(extension_allocator);
@@ -2059,19 +5148,72 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
     modified_create_info.enabledExtensionCount = static_cast<uint32_t>(instance_extension_count);
     modified_create_info.ppEnabledExtensionNames = instance_extension_ptr;
 
-    auto mali_create_instance = LibraryLoader::Instance().GetMaliCreateInstance();
-    if (!mali_create_instance) {
-        LOG_ERROR("Mali driver not available for instance creation");
-        return VK_ERROR_INITIALIZATION_FAILED;
+#if BUILD_WSI_DISPLAY
+    // The full list is still recorded below, so the WSI layer sees the extensions it implements.
+    std::vector<const char*> driver_extensions;
+    if (instance_extension_ptr != nullptr) {
+        driver_extensions.assign(instance_extension_ptr, instance_extension_ptr + instance_extension_count);
+    }
+    remove_wrapper_only_instance_extensions(driver_extensions);
+    modified_create_info.enabledExtensionCount = static_cast<uint32_t>(driver_extensions.size());
+    modified_create_info.ppEnabledExtensionNames = driver_extensions.data();
+#endif
+
+    // Keyed on the full list that is recorded for the WSI layer: under
+    // BUILD_WSI_DISPLAY the driver list lacks the display extensions, and a
+    // reused instance keeps the recorded list of the create that made it.
+    VkInstanceCreateInfo key_create_info = modified_create_info;
+    key_create_info.enabledExtensionCount = static_cast<uint32_t>(instance_extension_count);
+    key_create_info.ppEnabledExtensionNames = instance_extension_ptr;
+    std::unique_ptr<InstanceCreateKey> create_key = make_instance_create_key(key_create_info, pAllocator);
+    std::unique_ptr<InstanceInfo> reused_instance;
+    std::vector<std::unique_ptr<InstanceInfo>> expired_instances;
+    {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        expired_instances = take_expired_parked_instances(false);
+        if (create_key) {
+            auto parked = std::find_if(parked_instances.begin(), parked_instances.end(),
+                                       [&](const std::unique_ptr<InstanceInfo>& info) {
+                                           return *info->create_key == *create_key;
+                                       });
+            if (parked != parked_instances.end()) {
+                reused_instance = std::move(*parked);
+                parked_instances.erase(parked);
+            }
+        }
     }
+    destroy_parked_instances(std::move(expired_instances));
+
+    VkResult result;
+    if (reused_instance) {
+        *pInstance = reused_instance->instance;
+        result = VK_SUCCESS;
+    } else {
+        auto mali_create_instance = LibraryLoader::Instance().GetMaliCreateInstance();
+        if (!mali_create_instance) {
+            LOG_ERROR("Mali driver not available for instance creation");
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
 
-    VkResult result = mali_create_instance(&modified_create_info, pAllocator, pInstance);
+        StartupPhaseScope create_scope(StartupPhase::MALI_CREATE_INSTANCE);
+        result = mali_create_instance(&modified_create_info, pAllocator, pInstance);
+    }
 
-    if (result == VK_SUCCESS) {
+    if (result == VK_SUCCESS && reused_instance) {
+        std::lock_guard<std::mutex> lock(instance_mutex);
+        reused_instance->ref_count = 1;
+        reused_instance->marked_for_destruction = false;
+        reused_instance->destroy_time = {};
+        managed_instances[*pInstance] = std::move(reused_instance);
+        latest_instance = *pInstance;
+
+        // The driver instance, its WSI association and the recorded extensions are all as the parked one left them.
+        LOG_INFO("Instance reused from the parked pool, skipping driver initialization");
+    } else if (result == VK_SUCCESS) {
         std::lock_guard<std::mutex> lock(instance_mutex);
         auto existing = managed_instances.find(*pInstance);
         if (existing == managed_instances.end()) {
-            managed_instances.emplace(*pInstance, std::make_unique<InstanceInfo>(*pInstance));
+            existing = managed_instances.emplace(*pInstance, std::make_unique<InstanceInfo>(*pInstance)).first;
         } else {
             LOG_WARN("Instance handle reused - resetting tracking state");
             existing->second->instance = *pInstance;
@@ -2079,9 +5221,14 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
             existing->second->marked_for_destruction = false;
             existing->second->destroy_time = {};
         }
+        existing->second->create_key = std::move(create_key);
         latest_instance = *pInstance;
 
-        VkResult wsi_result = GetWSIManager().initialize(*pInstance, VK_NULL_HANDLE);
+        VkResult wsi_result;
+        {
+            StartupPhaseScope wsi_scope(StartupPhase::WSI_INSTANCE_ASSOCIATION);
+            wsi_result = GetWSIManager().initialize(*pInstance, VK_NULL_HANDLE);
+        }
         if (wsi_result != VK_SUCCESS) {
             LOG_ERROR("Failed to initialize WSI manager for instance, error: " + std::to_string(wsi_result));
         }
@@ -2100,6 +5247,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateInstance(
         }
 
         LOG_INFO("Instance created successfully through WSI layer -> Mali driver chain");
+        StartupProfile::Instance().LogSummary();
     } else {
         LOG_ERROR("Failed to create instance through WSI layer, error: " + std::to_string(result));
     }
@@ -2154,90 +5302,88 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkDestroyInstance(
         GetWSIManager().release_device(device);
     }
 
-    auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
-    if (mali_proc_addr) {
-        auto mali_destroy = reinterpret_cast<PFN_vkDestroyInstance>(
-            mali_proc_addr(instance, "vkDestroyInstance"));
-        if (mali_destroy) {
-            mali_destroy(instance, pAllocator);
+    if (instance_info->create_key && pAllocator == nullptr && devices_to_release.empty()) {
+        std::vector<std::unique_ptr<InstanceInfo>> evicted;
+        {
+            std::lock_guard<std::mutex> lock(instance_mutex);
+            evicted = take_expired_parked_instances(false);
+            if (parked_instances.size() >= kMaxParkedInstances) {
+                evicted.push_back(std::move(parked_instances.front()));
+                parked_instances.erase(parked_instances.begin());
+            }
+            parked_instances.push_back(std::move(instance_info));
         }
+        destroy_parked_instances(std::move(evicted));
+        LOG_INFO("Instance parked for reuse by an identical vkCreateInstance");
+        return;
     }
 
-    GetWSIManager().release_instance(instance);
+    destroy_driver_instance(instance, pAllocator);
     LOG_INFO("Instance destroyed successfully");
 }
 
-static VKAPI_ATTR VkResult VKAPI_CALL internal_vkEnumerateInstanceExtensionProperties(
-    const char* pLayerName,
-    uint32_t* pPropertyCount,
-    VkExtensionProperties* pProperties) {
-
+// The driver's instance extensions plus those the WSI layer implements. Built
+// once the driver is loaded, as neither changes afterwards.
+static const std::vector<VkExtensionProperties>& get_wrapper_instance_extensions() {
     using namespace mali_wrapper;
 
-
-    if (pLayerName != nullptr) {
-        *pPropertyCount = 0;
-        return VK_SUCCESS;
-    }
-
-    std::vector<VkExtensionProperties> mali_extensions;
-
-    if (LibraryLoader::Instance().IsLoaded()) {
-        auto mali_enumerate = reinterpret_cast<PFN_vkEnumerateInstanceExtensionProperties>(
-            LibraryLoader::Instance().GetMaliProcAddr("vkEnumerateInstanceExtensionProperties"));
-        if (mali_enumerate) {
-            uint32_t mali_count = 0;
-            VkResult result = mali_enumerate(nullptr, &mali_count, nullptr);
-            if (result == VK_SUCCESS && mali_count > 0) {
-                mali_extensions.resize(mali_count);
-                mali_enumerate(nullptr, &mali_count, mali_extensions.data());
-            }
-        }
-    }
-
-    std::vector<VkExtensionProperties> wsi_extensions;
-    bool wsi_available = false;
-    try {
-        wsi_available = LibraryLoader::Instance().IsLoaded();
-    } catch (...) {
-        LOG_WARN("Exception checking WSI availability during extension enumeration");
-        wsi_available = false;
+    static std::once_flag once;
+    static std::vector<VkExtensionProperties> combined_extensions;
+    if (!LibraryLoader::Instance().IsLoaded()) {
+        static const std::vector<VkExtensionProperties> none;
+        return none;
     }
-
-    if (wsi_available) {
-        const char* wsi_extension_names[] = {
+    std::call_once(once, []() {
+        static const char* const wsi_extension_names[] = {
             "VK_KHR_surface",
             "VK_KHR_wayland_surface",
             "VK_KHR_xcb_surface",
             "VK_KHR_xlib_surface",
             "VK_KHR_get_surface_capabilities2",
             "VK_EXT_surface_maintenance1",
-            "VK_EXT_headless_surface"
+            "VK_EXT_headless_surface",
+#if BUILD_WSI_DISPLAY
+            "VK_KHR_display",
+            "VK_EXT_direct_mode_display",
+#endif
         };
 
+        const std::vector<VkExtensionProperties>& mali_extensions = get_mali_instance_extensions();
+        combined_extensions = mali_extensions;
         for (const char* ext_name : wsi_extension_names) {
-            VkExtensionProperties ext = {};
-            strncpy(ext.extensionName, ext_name, VK_MAX_EXTENSION_NAME_SIZE - 1);
-            ext.specVersion = 1;  // Default spec version
-            wsi_extensions.push_back(ext);
+            bool found = false;
+            for (const auto& mali_ext : mali_extensions) {
+                if (strcmp(ext_name, mali_ext.extensionName) == 0) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                VkExtensionProperties ext = {};
+                strncpy(ext.extensionName, ext_name, VK_MAX_EXTENSION_NAME_SIZE - 1);
+                ext.specVersion = 1;  // Default spec version
+                combined_extensions.push_back(ext);
+            }
         }
+    });
+    return combined_extensions;
+}
 
-    }
+static VKAPI_ATTR VkResult VKAPI_CALL internal_vkEnumerateInstanceExtensionProperties(
+    const char* pLayerName,
+    uint32_t* pPropertyCount,
+    VkExtensionProperties* pProperties) {
 
-    std::vector<VkExtensionProperties> combined_extensions = mali_extensions;
-    for (const auto& wsi_ext : wsi_extensions) {
-        bool found = false;
-        for (const auto& mali_ext : mali_extensions) {
-            if (strcmp(wsi_ext.extensionName, mali_ext.extensionName) == 0) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            combined_extensions.push_back(wsi_ext);
-        }
+    using namespace mali_wrapper;
+
+
+    if (pLayerName != nullptr) {
+        *pPropertyCount = 0;
+        return VK_SUCCESS;
     }
 
+    StartupPhaseScope extensions_scope(StartupPhase::EXTENSION_ENUMERATION);
+    const std::vector<VkExtensionProperties>& combined_extensions = get_wrapper_instance_extensions();
 
     if (pProperties == nullptr) {
         *pPropertyCount = combined_extensions.size();
@@ -2265,44 +5411,22 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkEnumerateDeviceExtensionPropert
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    auto mali_enumerate = get_mali_instance_proc_for_physical_device<PFN_vkEnumerateDeviceExtensionProperties>(
-        physicalDevice, "vkEnumerateDeviceExtensionProperties");
-    if (mali_enumerate == nullptr) {
-        mali_enumerate = reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(
-            LibraryLoader::Instance().GetMaliProcAddr("vkEnumerateDeviceExtensionProperties"));
-    }
-
-    if (mali_enumerate == nullptr) {
-        *pPropertyCount = 0;
-        return VK_ERROR_INITIALIZATION_FAILED;
-    }
-
-    if (pLayerName != nullptr || !should_filter_external_memory_host_extension()) {
+    if (pLayerName != nullptr) {
+        auto mali_enumerate = get_mali_enumerate_device_extension_properties(physicalDevice);
+        if (mali_enumerate == nullptr) {
+            *pPropertyCount = 0;
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
         return mali_enumerate(physicalDevice, pLayerName, pPropertyCount, pProperties);
     }
 
-    uint32_t mali_count = 0;
-    VkResult result = mali_enumerate(physicalDevice, pLayerName, &mali_count, nullptr);
-    if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
+    std::shared_ptr<const PhysicalDeviceQueryCache> cache;
+    const VkResult result = get_device_extension_cache(physicalDevice, &cache);
+    if (result != VK_SUCCESS) {
+        *pPropertyCount = 0;
         return result;
     }
-
-    std::vector<VkExtensionProperties> mali_extensions(mali_count);
-    if (mali_count > 0) {
-        result = mali_enumerate(physicalDevice, pLayerName, &mali_count, mali_extensions.data());
-        if (result != VK_SUCCESS && result != VK_INCOMPLETE) {
-            return result;
-        }
-        mali_extensions.resize(mali_count);
-    }
-
-    std::vector<VkExtensionProperties> filtered_extensions;
-    filtered_extensions.reserve(mali_extensions.size());
-    for (const auto& extension : mali_extensions) {
-        if (!is_filtered_device_extension(extension.extensionName)) {
-            filtered_extensions.push_back(extension);
-        }
-    }
+    const std::vector<VkExtensionProperties>& filtered_extensions = cache->wrapper_extensions;
 
     if (pProperties == nullptr) {
         *pPropertyCount = static_cast<uint32_t>(filtered_extensions.size());
@@ -2325,49 +5449,28 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL internal_vkGetInstanceProcAddr(V
         return nullptr;
     }
 
-
-    if (strcmp(pName, "vkGetInstanceProcAddr") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetInstanceProcAddr);
-    }
-
-    if (strcmp(pName, "vkCreateInstance") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkCreateInstance);
-    }
-
-    if (strcmp(pName, "vkDestroyInstance") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkDestroyInstance);
-    }
-
-    if (strcmp(pName, "vkDestroyDevice") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkDestroyDevice);
-    }
-
-    if (strcmp(pName, "vkEnumerateInstanceExtensionProperties") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkEnumerateInstanceExtensionProperties);
-    }
-
-    if (strcmp(pName, "vkEnumerateDeviceExtensionProperties") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkEnumerateDeviceExtensionProperties);
-    }
-
-    if (strcmp(pName, "vkGetDeviceProcAddr") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetDeviceProcAddr);
-    }
-
-    if (strcmp(pName, "vkCreateDevice") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkCreateDevice);
-    }
-
-    if (strcmp(pName, "vkGetPhysicalDeviceFeatures") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetPhysicalDeviceFeatures);
-    }
-
-    if (strcmp(pName, "vkGetPhysicalDeviceFeatures2") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetPhysicalDeviceFeatures2);
-    }
-
-    if (strcmp(pName, "vkGetPhysicalDeviceFeatures2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetPhysicalDeviceFeatures2KHR);
+    static constexpr std::array<ProcTableEntry<ProcTableGetter>, 15> wrapper_instance_procs = {{
+        { "vkCreateDevice", ProcTableFunction<internal_vkCreateDevice> },
+        { "vkCreateInstance", ProcTableFunction<internal_vkCreateInstance> },
+        { "vkDestroyDevice", ProcTableFunction<internal_vkDestroyDevice> },
+        { "vkDestroyInstance", ProcTableFunction<internal_vkDestroyInstance> },
+        { "vkEnumerateDeviceExtensionProperties", ProcTableFunction<internal_vkEnumerateDeviceExtensionProperties> },
+        { "vkEnumerateInstanceExtensionProperties", ProcTableFunction<internal_vkEnumerateInstanceExtensionProperties> },
+        { "vkGetDeviceProcAddr", ProcTableFunction<internal_vkGetDeviceProcAddr> },
+        { "vkGetInstanceProcAddr", ProcTableFunction<internal_vkGetInstanceProcAddr> },
+        { "vkGetPhysicalDeviceFeatures", ProcTableFunction<internal_vkGetPhysicalDeviceFeatures> },
+        { "vkGetPhysicalDeviceFeatures2", ProcTableFunction<internal_vkGetPhysicalDeviceFeatures2> },
+        { "vkGetPhysicalDeviceFeatures2KHR", ProcTableFunction<internal_vkGetPhysicalDeviceFeatures2KHR> },
+        { "vkGetPhysicalDeviceMemoryProperties2", ProcTableFunction<internal_vkGetPhysicalDeviceMemoryProperties2> },
+        { "vkGetPhysicalDeviceMemoryProperties2KHR",
+          ProcTableFunction<internal_vkGetPhysicalDeviceMemoryProperties2KHR> },
+        { "vkGetPhysicalDeviceProperties2", ProcTableFunction<internal_vkGetPhysicalDeviceProperties2> },
+        { "vkGetPhysicalDeviceProperties2KHR", ProcTableFunction<internal_vkGetPhysicalDeviceProperties2KHR> },
+    }};
+    static_assert(IsProcTableSorted(wrapper_instance_procs), "wrapper_instance_procs must stay sorted");
+
+    if (const auto* entry = FindProcTableEntry(wrapper_instance_procs, pName)) {
+        return entry->value();
     }
 
     if (GetWSIManager().is_wsi_function(pName)) {
@@ -2391,7 +5494,176 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL internal_vkGetInstanceProcAddr(V
         }
     }
 
-    return nullptr;
+    return nullptr;
+}
+
+// Feature structs whose answers are cached, with their sizes. A chain holding
+// any other struct goes to the driver every time, since its size is unknown.
+static size_t get_cacheable_feature_struct_size(VkStructureType type)
+{
+#define FEATURE_STRUCT(stype, struct_type) \
+    case stype:                              \
+        return sizeof(struct_type)
+
+    switch (type) {
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_16BIT_STORAGE_FEATURES, VkPhysicalDevice16BitStorageFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES, VkPhysicalDeviceMultiviewFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VARIABLE_POINTERS_FEATURES,
+                   VkPhysicalDeviceVariablePointersFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES,
+                   VkPhysicalDeviceSamplerYcbcrConversionFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES,
+                   VkPhysicalDeviceShaderDrawParametersFeatures);
+#ifdef VK_VERSION_1_2
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES, VkPhysicalDeviceVulkan11Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, VkPhysicalDeviceVulkan12Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_8BIT_STORAGE_FEATURES, VkPhysicalDevice8BitStorageFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES,
+                   VkPhysicalDeviceShaderFloat16Int8Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES,
+                   VkPhysicalDeviceDescriptorIndexingFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SCALAR_BLOCK_LAYOUT_FEATURES,
+                   VkPhysicalDeviceScalarBlockLayoutFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES,
+                   VkPhysicalDeviceHostQueryResetFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+                   VkPhysicalDeviceTimelineSemaphoreFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES,
+                   VkPhysicalDeviceBufferDeviceAddressFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_MEMORY_MODEL_FEATURES,
+                   VkPhysicalDeviceVulkanMemoryModelFeatures);
+#endif
+#ifdef VK_VERSION_1_3
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES, VkPhysicalDeviceVulkan13Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+                   VkPhysicalDeviceDynamicRenderingFeatures);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
+                   VkPhysicalDeviceSynchronization2Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_4_FEATURES, VkPhysicalDeviceMaintenance4Features);
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DEMOTE_TO_HELPER_INVOCATION_FEATURES,
+                   VkPhysicalDeviceShaderDemoteToHelperInvocationFeatures);
+#endif
+#ifdef VK_EXT_robustness2
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT, VkPhysicalDeviceRobustness2FeaturesEXT);
+#endif
+#ifdef VK_EXT_custom_border_color
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_CUSTOM_BORDER_COLOR_FEATURES_EXT,
+                   VkPhysicalDeviceCustomBorderColorFeaturesEXT);
+#endif
+#ifdef VK_EXT_depth_clip_enable
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_CLIP_ENABLE_FEATURES_EXT,
+                   VkPhysicalDeviceDepthClipEnableFeaturesEXT);
+#endif
+#ifdef VK_EXT_transform_feedback
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TRANSFORM_FEEDBACK_FEATURES_EXT,
+                   VkPhysicalDeviceTransformFeedbackFeaturesEXT);
+#endif
+#ifdef VK_EXT_extended_dynamic_state
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+                   VkPhysicalDeviceExtendedDynamicStateFeaturesEXT);
+#endif
+#ifdef VK_EXT_extended_dynamic_state2
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT,
+                   VkPhysicalDeviceExtendedDynamicState2FeaturesEXT);
+#endif
+#ifdef VK_EXT_4444_formats
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_4444_FORMATS_FEATURES_EXT, VkPhysicalDevice4444FormatsFeaturesEXT);
+#endif
+#ifdef VK_EXT_memory_priority
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT,
+                   VkPhysicalDeviceMemoryPriorityFeaturesEXT);
+#endif
+#ifdef VK_EXT_graphics_pipeline_library
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+                   VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT);
+#endif
+#ifdef VK_EXT_non_seamless_cube_map
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_NON_SEAMLESS_CUBE_MAP_FEATURES_EXT,
+                   VkPhysicalDeviceNonSeamlessCubeMapFeaturesEXT);
+#endif
+#ifdef VK_KHR_present_id
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR, VkPhysicalDevicePresentIdFeaturesKHR);
+#endif
+#ifdef VK_KHR_present_wait
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, VkPhysicalDevicePresentWaitFeaturesKHR);
+#endif
+#ifdef VK_KHR_maintenance5
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_5_FEATURES_KHR,
+                   VkPhysicalDeviceMaintenance5FeaturesKHR);
+#endif
+#ifdef VK_EXT_map_memory_placed
+    FEATURE_STRUCT(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAP_MEMORY_PLACED_FEATURES_EXT,
+                   VkPhysicalDeviceMapMemoryPlacedFeaturesEXT);
+#endif
+    default:
+        return 0;
+    }
+#undef FEATURE_STRUCT
+}
+
+static bool copy_cached_core_features(VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures* features)
+{
+    std::shared_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+    auto it = physical_device_cache.find(physical_device);
+    if (it == physical_device_cache.end() || !it->second->features_valid) {
+        return false;
+    }
+    *features = it->second->features;
+    return true;
+}
+
+static void store_core_features(VkPhysicalDevice physical_device, const VkPhysicalDeviceFeatures& features)
+{
+    std::unique_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+    auto& entry = get_physical_device_cache_locked(physical_device);
+    entry.features = features;
+    entry.features_valid = true;
+}
+
+// Serves vkGetPhysicalDeviceFeatures2 from the cache when every struct in the
+// chain was returned before. Each struct's answer does not depend on what else
+// is in the chain, so structs cached from different chains can be combined.
+static bool copy_cached_features2(VkPhysicalDevice physical_device, VkPhysicalDeviceFeatures2* features)
+{
+    std::shared_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+    auto it = physical_device_cache.find(physical_device);
+    if (it == physical_device_cache.end() || !it->second->features_valid) {
+        return false;
+    }
+    const auto& entry = *it->second;
+
+    for (auto* current = reinterpret_cast<VkBaseOutStructure*>(features->pNext); current != nullptr;
+         current = current->pNext) {
+        if (get_cacheable_feature_struct_size(current->sType) == 0 ||
+            entry.feature_structs.find(current->sType) == entry.feature_structs.end()) {
+            return false;
+        }
+    }
+
+    features->features = entry.features;
+    for (auto* current = reinterpret_cast<VkBaseOutStructure*>(features->pNext); current != nullptr;
+         current = current->pNext) {
+        const auto& body = entry.feature_structs.at(current->sType);
+        std::memcpy(reinterpret_cast<uint8_t*>(current) + sizeof(VkBaseOutStructure), body.data(), body.size());
+    }
+    return true;
+}
+
+static void store_features2(VkPhysicalDevice physical_device, const VkPhysicalDeviceFeatures2& features)
+{
+    std::unique_lock<std::shared_mutex> lock(physical_device_cache_mutex);
+    auto& entry = get_physical_device_cache_locked(physical_device);
+    entry.features = features.features;
+    entry.features_valid = true;
+    for (auto* current = reinterpret_cast<const VkBaseOutStructure*>(features.pNext); current != nullptr;
+         current = current->pNext) {
+        const size_t size = get_cacheable_feature_struct_size(current->sType);
+        if (size == 0) {
+            continue;
+        }
+        const auto* body = reinterpret_cast<const uint8_t*>(current) + sizeof(VkBaseOutStructure);
+        entry.feature_structs[current->sType].assign(body, body + (size - sizeof(VkBaseOutStructure)));
+    }
 }
 
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures(
@@ -2400,12 +5672,12 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures(
 {
     using namespace mali_wrapper;
 
-    if (pFeatures == nullptr) {
+    if (pFeatures == nullptr || copy_cached_core_features(physicalDevice, pFeatures)) {
         return;
     }
 
-    auto mali_get_features = get_mali_instance_proc_for_physical_device<PFN_vkGetPhysicalDeviceFeatures>(
-        physicalDevice, "vkGetPhysicalDeviceFeatures");
+    auto mali_get_features = get_mali_instance_proc_for_physical_device(
+        physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_features);
     if (mali_get_features != nullptr) {
         mali_get_features(physicalDevice, pFeatures);
     } else {
@@ -2413,6 +5685,7 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures(
     }
 
     advertise_spoofed_physical_features(pFeatures);
+    store_core_features(physicalDevice, *pFeatures);
 }
 
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2(
@@ -2421,18 +5694,17 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2(
 {
     using namespace mali_wrapper;
 
-    if (pFeatures == nullptr) {
+    if (pFeatures == nullptr || copy_cached_features2(physicalDevice, pFeatures)) {
         return;
     }
 
-    auto mali_get_features2 = get_mali_instance_proc_for_physical_device<PFN_vkGetPhysicalDeviceFeatures2>(
-        physicalDevice, "vkGetPhysicalDeviceFeatures2");
+    auto mali_get_features2 = get_mali_instance_proc_for_physical_device(
+        physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_features2);
     if (mali_get_features2 != nullptr) {
         mali_get_features2(physicalDevice, pFeatures);
     } else {
-        auto mali_get_features2_khr =
-            get_mali_instance_proc_for_physical_device<PFN_vkGetPhysicalDeviceFeatures2KHR>(
-                physicalDevice, "vkGetPhysicalDeviceFeatures2KHR");
+        auto mali_get_features2_khr = get_mali_instance_proc_for_physical_device(
+            physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_features2_khr);
         if (mali_get_features2_khr != nullptr) {
             mali_get_features2_khr(physicalDevice, reinterpret_cast<VkPhysicalDeviceFeatures2KHR*>(pFeatures));
         } else {
@@ -2443,6 +5715,8 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2(
 
     advertise_spoofed_physical_features(&pFeatures->features);
     advertise_spoofed_physical_feature_chain(pFeatures->pNext);
+    advertise_wrapper_device_feature_chain(physicalDevice, pFeatures->pNext);
+    store_features2(physicalDevice, *pFeatures);
 }
 
 static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2KHR(
@@ -2452,15 +5726,112 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceFeatures2KHR(
     internal_vkGetPhysicalDeviceFeatures2(physicalDevice, reinterpret_cast<VkPhysicalDeviceFeatures2*>(pFeatures));
 }
 
-template <typename T>
-static T get_mali_device_proc(VkDevice device, const char* proc_name)
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceProperties2(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceProperties2* pProperties)
 {
-    auto dispatch = mali_wrapper::get_managed_device_dispatch(device);
-    if (dispatch == nullptr) {
-        return nullptr;
+    using namespace mali_wrapper;
+
+    if (pProperties == nullptr) {
+        return;
+    }
+
+    auto mali_get_properties2 = get_mali_instance_proc_for_physical_device(
+        physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_properties2);
+    if (mali_get_properties2 == nullptr) {
+        mali_get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+            get_mali_instance_proc_for_physical_device(
+                physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_properties2_khr));
+    }
+    if (mali_get_properties2 == nullptr) {
+        return;
+    }
+
+    mali_get_properties2(physicalDevice, pProperties);
+    advertise_wrapper_device_property_chain(physicalDevice, pProperties->pNext);
+}
+
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceProperties2KHR(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceProperties2KHR* pProperties)
+{
+    internal_vkGetPhysicalDeviceProperties2(physicalDevice, reinterpret_cast<VkPhysicalDeviceProperties2*>(pProperties));
+}
+
+// Shadows are system memory the driver does not account for, and every
+// host-visible allocation of a 32-bit process has to be mapped below 4 GiB.
+// Taking both out of the budget lets DXVK-style memory-pressure logic evict
+// before shadow allocation starts failing.
+static void adjust_memory_budget_for_low_address_map(const VkPhysicalDeviceMemoryProperties& properties,
+                                                     VkPhysicalDeviceMemoryBudgetPropertiesEXT* budget)
+{
+    using namespace mali_wrapper;
+
+    std::array<bool, VK_MAX_MEMORY_HEAPS> host_visible_heaps{};
+    const uint32_t type_count = std::min<uint32_t>(properties.memoryTypeCount, VK_MAX_MEMORY_TYPES);
+    for (uint32_t i = 0; i < type_count; i++) {
+        const VkMemoryType& type = properties.memoryTypes[i];
+        if ((type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && type.heapIndex < VK_MAX_MEMORY_HEAPS) {
+            host_visible_heaps[type.heapIndex] = true;
+        }
+    }
+
+    const VkDeviceSize shadow_bytes = low_address_shadow_resident_bytes.load(std::memory_order_relaxed);
+    const VkDeviceSize free_low_bytes = get_free_low_address_space_bytes();
+    const uint32_t heap_count = std::min<uint32_t>(properties.memoryHeapCount, VK_MAX_MEMORY_HEAPS);
+    for (uint32_t heap = 0; heap < heap_count; heap++) {
+        if (!host_visible_heaps[heap]) {
+            continue;
+        }
+
+        VkDeviceSize heap_budget = budget->heapBudget[heap];
+        heap_budget -= std::min(heap_budget, shadow_bytes);
+        heap_budget = std::min(heap_budget, budget->heapUsage[heap] + free_low_bytes);
+        budget->heapBudget[heap] = heap_budget;
+    }
+}
+
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceMemoryProperties2(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties2* pMemoryProperties)
+{
+    using namespace mali_wrapper;
+
+    if (pMemoryProperties == nullptr) {
+        return;
+    }
+
+    auto mali_get_memory_properties2 = get_mali_instance_proc_for_physical_device(
+        physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_memory_properties2);
+    if (mali_get_memory_properties2 == nullptr) {
+        mali_get_memory_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+            get_mali_instance_proc_for_physical_device(
+                physicalDevice, &MaliPhysicalDeviceProcs::get_physical_device_memory_properties2_khr));
+    }
+    if (mali_get_memory_properties2 == nullptr) {
+        return;
+    }
+
+    mali_get_memory_properties2(physicalDevice, pMemoryProperties);
+    if (!should_adjust_memory_budget()) {
+        return;
+    }
+
+    for (auto* next = static_cast<VkBaseOutStructure*>(pMemoryProperties->pNext); next != nullptr;
+         next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT) {
+            adjust_memory_budget_for_low_address_map(
+                pMemoryProperties->memoryProperties, reinterpret_cast<VkPhysicalDeviceMemoryBudgetPropertiesEXT*>(next));
+        }
     }
+}
 
-    return reinterpret_cast<T>(dispatch->resolve_proc(proc_name));
+static VKAPI_ATTR void VKAPI_CALL internal_vkGetPhysicalDeviceMemoryProperties2KHR(
+    VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties2KHR* pMemoryProperties)
+{
+    internal_vkGetPhysicalDeviceMemoryProperties2(physicalDevice,
+                                                  reinterpret_cast<VkPhysicalDeviceMemoryProperties2*>(pMemoryProperties));
 }
 
 template <typename T>
@@ -2484,12 +5855,12 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
     }
 
     if (should_collect_low_address_map_stats()) {
-        low_address_map_stats.successful_maps.fetch_add(1, std::memory_order_relaxed);
+        low_address_map_stats.local().successful_maps.fetch_add(1, std::memory_order_relaxed);
     }
 
     if (is_pointer_32bit_compatible(*ppData)) {
         if (should_collect_low_address_map_stats()) {
-            low_address_map_stats.compatible_maps.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().compatible_maps.fetch_add(1, std::memory_order_relaxed);
         }
         if (should_trace_low_address_map_events()) {
             LOW_ADDRESS_LOG_DEBUG("Low-address map bypassed: pointer already 32-bit-compatible, ptr=" +
@@ -2502,7 +5873,7 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
     }
 
     if (should_collect_low_address_map_stats()) {
-        low_address_map_stats.high_pointer_maps.fetch_add(1, std::memory_order_relaxed);
+        low_address_map_stats.local().high_pointer_maps.fetch_add(1, std::memory_order_relaxed);
     }
 
     if (should_trace_low_address_map_events()) {
@@ -2513,7 +5884,7 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
 
     if (!should_use_low_address_shadow_map()) {
         if (should_collect_low_address_map_stats()) {
-            low_address_map_stats.disabled_high_pointer_maps.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().disabled_high_pointer_maps.fetch_add(1, std::memory_order_relaxed);
         }
         static std::once_flag warning_once;
         std::call_once(warning_once, []() {
@@ -2525,56 +5896,152 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
     }
 
     const DeviceMemoryKey key = make_memory_key(device, memory);
+    auto dispatch = get_managed_device_dispatch(device);
+    const std::shared_ptr<DeviceLowAddressMappingIndex> mapping_index =
+        dispatch != nullptr ? dispatch->low_address_mapping_index : nullptr;
 
     VkDeviceSize resolved_size = 0;
-    {
-        std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-        if (!resolve_map_size_locked(key, offset, size, &resolved_size)) {
-            if (should_collect_low_address_map_stats()) {
-                low_address_map_stats.resolve_failures.fetch_add(1, std::memory_order_relaxed);
-            }
-            LOW_ADDRESS_LOG_WARN("Low-address map workaround skipped: unable to resolve mapping size");
-            maybe_log_low_address_map_progress("resolve-failed", true);
-            return;
+    VkMemoryPropertyFlags memory_flags = 0;
+    if (!resolve_map_size(key, offset, size, &resolved_size, &memory_flags)) {
+        if (should_collect_low_address_map_stats()) {
+            low_address_map_stats.local().resolve_failures.fetch_add(1, std::memory_order_relaxed);
         }
+        LOW_ADDRESS_LOG_WARN("Low-address map workaround skipped: unable to resolve mapping size");
+        maybe_log_low_address_map_progress("resolve-failed", true);
+        return;
     }
 
     if (resolved_size == 0 || resolved_size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
         if (should_collect_low_address_map_stats()) {
-            low_address_map_stats.unsupported_size_failures.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().unsupported_size_failures.fetch_add(1, std::memory_order_relaxed);
         }
         LOW_ADDRESS_LOG_WARN("Low-address map workaround skipped: mapping size is unsupported");
         maybe_log_low_address_map_progress("size-unsupported", true);
         return;
     }
 
+    const std::shared_ptr<LowAddressAdaptiveProfile> adaptive_profile =
+        get_low_address_adaptive_profile(key, memory_flags);
     const void* real_ptr = *ppData;
+    if (should_cache_low_address_mappings()) {
+        ShadowMappingInfo cached_mapping{};
+        std::vector<ShadowMappingInfo> mismatched_mappings;
+        bool cache_hit = false;
+        {
+            auto lock = lock_shadow_mappings_exclusive();
+            cache_hit = take_cached_low_address_mapping_locked(key, real_ptr, offset, resolved_size,
+                                                               &cached_mapping, &mismatched_mappings);
+        }
+        release_low_address_mappings(mismatched_mappings);
+
+        if (should_collect_low_address_map_stats()) {
+            (cache_hit ? low_address_map_stats.mapping_cache_hits
+                       : low_address_map_stats.mapping_cache_misses).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (cache_hit) {
+            if (cached_mapping.retired_dirty_tracker != nullptr) {
+                // The view was parked after tracking was retired; no fault on
+                // it can still be in flight.
+                unregister_shadow_dirty_tracking(*cached_mapping.retired_dirty_tracker);
+                cached_mapping.retired_dirty_tracker.reset();
+            }
+            if (cached_mapping.mode == LowAddressMapMode::SHADOW && cached_mapping.dirty_tracker != nullptr &&
+                should_fill_low_address_shadows_lazily()) {
+                // Drop the stale pages; the fault handler refills each one
+                // from the new real mapping when it is first touched.
+                set_shadow_dirty_tracking_source(*cached_mapping.dirty_tracker, const_cast<void*>(real_ptr),
+                                                 static_cast<size_t>(resolved_size));
+                if (!evict_shadow_for_lazy_fill(*cached_mapping.dirty_tracker, cached_mapping.shadow_size,
+                                                static_cast<size_t>(resolved_size))) {
+                    mprotect(cached_mapping.shadow_ptr, cached_mapping.shadow_size, PROT_READ | PROT_WRITE);
+                    forget_evicted_shadow_pages(*cached_mapping.dirty_tracker);
+                    tracked_memcpy(cached_mapping.shadow_ptr, real_ptr, static_cast<size_t>(resolved_size),
+                                   LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+                    mprotect(cached_mapping.shadow_ptr, cached_mapping.shadow_size, PROT_READ);
+                }
+                cached_mapping.real_ptr = const_cast<void*>(real_ptr);
+                cached_mapping.offset = offset;
+                cached_mapping.memory_flags = memory_flags;
+            } else if (cached_mapping.mode == LowAddressMapMode::SHADOW) {
+                // The GPU may have written the allocation while it was unmapped.
+                // Refill with tracking paused so the copy is not counted as
+                // application writes.
+                if (cached_mapping.dirty_tracker != nullptr) {
+                    mprotect(cached_mapping.shadow_ptr, cached_mapping.shadow_size, PROT_READ | PROT_WRITE);
+                    forget_evicted_shadow_pages(*cached_mapping.dirty_tracker);
+                }
+                tracked_memcpy(cached_mapping.shadow_ptr, real_ptr, static_cast<size_t>(resolved_size),
+                               LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+                if (cached_mapping.dirty_tracker != nullptr) {
+                    mprotect(cached_mapping.shadow_ptr, cached_mapping.shadow_size, PROT_READ);
+                    set_shadow_dirty_tracking_source(*cached_mapping.dirty_tracker, const_cast<void*>(real_ptr),
+                                                     static_cast<size_t>(resolved_size));
+                }
+                cached_mapping.real_ptr = const_cast<void*>(real_ptr);
+                cached_mapping.offset = offset;
+                cached_mapping.memory_flags = memory_flags;
+            } else if (cached_mapping.eager) {
+                cached_mapping.real_ptr = const_cast<void*>(real_ptr);
+            }
+
+            // A view parked before its allocation changed strategy is
+            // converted by the device's next submit.
+            bool needs_adaptive_migration = false;
+            if (cached_mapping.mode == LowAddressMapMode::SHADOW && adaptive_profile != nullptr) {
+                cached_mapping.adaptive_profile = adaptive_profile;
+                needs_adaptive_migration =
+                    (adaptive_profile->strategy.load(std::memory_order_acquire) ==
+                     LowAddressShadowStrategy::TRACKED) != (cached_mapping.dirty_tracker != nullptr);
+            }
+
+            ShadowMappingInfo stale_mapping{};
+            bool has_stale_mapping = false;
+            {
+                auto lock = lock_shadow_mappings_exclusive();
+                has_stale_mapping =
+                    install_low_address_mapping_locked(key, cached_mapping, mapping_index, &stale_mapping);
+            }
+            if (has_stale_mapping) {
+                release_low_address_mappings({ stale_mapping });
+            }
+            if (needs_adaptive_migration && mapping_index != nullptr) {
+                mapping_index->adaptive_migration_pending.store(true, std::memory_order_release);
+            }
+
+            if (should_trace_low_address_map_events()) {
+                LOW_ADDRESS_LOG_DEBUG("Low-address mapping reused: mode=" +
+                                      std::string(low_address_map_mode_to_string(cached_mapping.mode)) +
+                                      ", real=" + format_pointer(real_ptr) +
+                                      ", low=" + format_pointer(cached_mapping.shadow_ptr) +
+                                      ", size=" + format_bytes(static_cast<uint64_t>(resolved_size)));
+            }
+            maybe_log_low_address_map_progress("cache-hit", false);
+            *ppData = cached_mapping.shadow_ptr;
+            return;
+        }
+    }
+
     ShadowMappingInfo new_mapping{};
-    if (try_create_low_address_alias(real_ptr, static_cast<size_t>(resolved_size), &new_mapping)) {
+    MaliDeviceFdCache* fd_cache = dispatch != nullptr ? dispatch->mali_fd_cache.get() : nullptr;
+    if (try_create_low_address_alias(real_ptr, static_cast<size_t>(resolved_size), nullptr, fd_cache,
+                                     &new_mapping)) {
         new_mapping.offset = offset;
         new_mapping.mapped_size = resolved_size;
+        new_mapping.memory_flags = memory_flags;
 
         ShadowMappingInfo stale_mapping{};
         bool has_stale_mapping = false;
         {
-            std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-            auto it = shadow_mappings.find(key);
-            if (it != shadow_mappings.end()) {
-                stale_mapping = it->second;
-                has_stale_mapping = true;
-                it->second = new_mapping;
-            } else {
-                shadow_mappings.emplace(key, new_mapping);
-            }
+            auto lock = lock_shadow_mappings_exclusive();
+            has_stale_mapping = install_low_address_mapping_locked(key, new_mapping, mapping_index, &stale_mapping);
         }
 
         if (has_stale_mapping) {
             if (stale_mapping.mode == LowAddressMapMode::SHADOW && stale_mapping.shadow_size > 0) {
                 record_shadow_mapping_removed(stale_mapping.shadow_size);
             }
-            if (stale_mapping.unmap_ptr != nullptr && stale_mapping.unmap_size > 0) {
-                munmap(stale_mapping.unmap_ptr, stale_mapping.unmap_size);
-            }
+            release_low_address_mapping(stale_mapping);
         }
 
         LOW_ADDRESS_LOG_INFO("Low-address alias map applied: real=" + format_pointer(real_ptr) +
@@ -2587,13 +6054,30 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
         return;
     }
 
-    const ShadowAllocationResult allocation =
+    enforce_low_address_shadow_budget(align_up_to_page(static_cast<size_t>(resolved_size)));
+
+    ShadowAllocationResult allocation =
         allocate_low_address_shadow(static_cast<size_t>(resolved_size));
+    if (allocation.ptr == nullptr && should_cache_low_address_mappings()) {
+        // Low address space is exhausted; give back parked views and retry once.
+        std::vector<ShadowMappingInfo> evicted;
+        {
+            auto lock = lock_shadow_mappings_exclusive();
+            drop_cached_low_address_mappings_locked(VK_NULL_HANDLE, &evicted);
+        }
+        if (!evicted.empty()) {
+            if (should_collect_low_address_map_stats()) {
+                low_address_map_stats.local().mapping_cache_evictions.fetch_add(evicted.size(), std::memory_order_relaxed);
+            }
+            release_low_address_mappings(evicted);
+            allocation = allocate_low_address_shadow(static_cast<size_t>(resolved_size));
+        }
+    }
     if (allocation.ptr == nullptr) {
         if (should_collect_low_address_map_stats()) {
-            low_address_map_stats.allocation_failures.fetch_add(1, std::memory_order_relaxed);
-            low_address_map_stats.allocation_time_ns.fetch_add(allocation.elapsed_ns, std::memory_order_relaxed);
-            low_address_map_stats.fixed_search_attempts.fetch_add(
+            low_address_map_stats.local().allocation_failures.fetch_add(1, std::memory_order_relaxed);
+            low_address_map_stats.local().allocation_time_ns.fetch_add(allocation.elapsed_ns, std::memory_order_relaxed);
+            low_address_map_stats.local().fixed_search_attempts.fetch_add(
                 allocation.fixed_search_attempts, std::memory_order_relaxed);
         }
         LOW_ADDRESS_LOG_WARN("Low-address map workaround failed: unable to allocate shadow mapping");
@@ -2607,31 +6091,62 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
         return;
     }
 
-    tracked_memcpy(allocation.ptr, real_ptr, static_cast<size_t>(resolved_size),
-                   LowAddressCopyKind::MAP_TO_SHADOW);
+    low_address_shadow_resident_bytes.fetch_add(allocation.size, std::memory_order_relaxed);
+    const bool lazy_fill = should_fill_low_address_shadows_lazily();
+    if (!lazy_fill) {
+        tracked_memcpy(allocation.ptr, real_ptr, static_cast<size_t>(resolved_size),
+                       LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+    }
+
+    std::shared_ptr<ShadowDirtyTracker> dirty_tracker;
+    if (should_track_low_address_shadow_writes() &&
+        (adaptive_profile == nullptr ||
+         adaptive_profile->strategy.load(std::memory_order_acquire) == LowAddressShadowStrategy::TRACKED)) {
+        dirty_tracker = register_shadow_dirty_tracking(allocation.ptr, allocation.size);
+        if (dirty_tracker != nullptr) {
+            set_shadow_dirty_tracking_source(*dirty_tracker, const_cast<void*>(real_ptr),
+                                             static_cast<size_t>(resolved_size));
+        }
+        if (should_collect_low_address_map_stats()) {
+            if (dirty_tracker != nullptr) {
+                low_address_map_stats.local().dirty_tracked_maps.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                low_address_map_stats.local().dirty_tracking_failures.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    if (lazy_fill && (dirty_tracker == nullptr ||
+                      !evict_shadow_for_lazy_fill(*dirty_tracker, allocation.size,
+                                                  static_cast<size_t>(resolved_size)))) {
+        // Copy it up front after all, with tracking paused as on a reuse.
+        if (dirty_tracker != nullptr) {
+            mprotect(allocation.ptr, allocation.size, PROT_READ | PROT_WRITE);
+        }
+        tracked_memcpy(allocation.ptr, real_ptr, static_cast<size_t>(resolved_size),
+                       LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+        if (dirty_tracker != nullptr) {
+            mprotect(allocation.ptr, allocation.size, PROT_READ);
+        }
+    }
 
     ShadowMappingInfo stale_mapping{};
     bool has_stale_mapping = false;
     {
-        std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-        auto it = shadow_mappings.find(key);
+        auto lock = lock_shadow_mappings_exclusive();
         ShadowMappingInfo mapping{};
         mapping.real_ptr = const_cast<void*>(real_ptr);
         mapping.shadow_ptr = allocation.ptr;
         mapping.shadow_size = allocation.size;
         mapping.offset = offset;
         mapping.mapped_size = resolved_size;
+        mapping.memory_flags = memory_flags;
         mapping.mode = LowAddressMapMode::SHADOW;
         mapping.unmap_ptr = allocation.ptr;
         mapping.unmap_size = allocation.size;
+        mapping.dirty_tracker = dirty_tracker;
+        mapping.adaptive_profile = adaptive_profile;
 
-        if (it != shadow_mappings.end()) {
-            stale_mapping = it->second;
-            has_stale_mapping = true;
-            it->second = mapping;
-        } else {
-            shadow_mappings.emplace(key, mapping);
-        }
+        has_stale_mapping = install_low_address_mapping_locked(key, mapping, mapping_index, &stale_mapping);
     }
 
     record_shadow_mapping_installed(allocation.size,
@@ -2648,9 +6163,7 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
         if (stale_mapping.mode == LowAddressMapMode::SHADOW && stale_mapping.shadow_size > 0) {
             record_shadow_mapping_removed(stale_mapping.shadow_size);
         }
-        if (stale_mapping.unmap_ptr != nullptr && stale_mapping.unmap_size > 0) {
-            munmap(stale_mapping.unmap_ptr, stale_mapping.unmap_size);
-        }
+        release_low_address_mapping(stale_mapping);
     }
 
     if (should_trace_low_address_map_events()) {
@@ -2668,6 +6181,312 @@ static void maybe_apply_low_address_mapping(VkDevice device, VkDeviceMemory memo
     *ppData = allocation.ptr;
 }
 
+// Parks a freshly created eager alias in the reuse cache and counts it.
+static void park_eager_low_address_alias(VkDevice device, VkDeviceMemory memory, VkDeviceSize size,
+                                         VkMemoryPropertyFlags memory_flags, bool created,
+                                         mali_wrapper::ShadowMappingInfo mapping)
+{
+    using namespace mali_wrapper;
+
+    if (should_collect_low_address_map_stats()) {
+        (created ? low_address_map_stats.eager_aliases
+                 : low_address_map_stats.eager_alias_failures).fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!created) {
+        return;
+    }
+
+    mapping.offset = 0;
+    mapping.mapped_size = size;
+    mapping.memory_flags = memory_flags;
+    mapping.eager = true;
+
+    std::vector<ShadowMappingInfo> evicted;
+    bool cached = false;
+    {
+        auto lock = lock_shadow_mappings_exclusive();
+        cached = cache_low_address_mapping_locked(make_memory_key(device, memory), mapping, &evicted);
+    }
+    if (!cached) {
+        evicted.push_back(mapping);
+    }
+    release_low_address_mappings(evicted);
+
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_DEBUG("Low-address eager alias " + std::string(cached ? "parked" : "dropped") +
+                              ": memory=" + format_device_memory_handle(memory) +
+                              ", low=" + format_pointer(mapping.shadow_ptr) +
+                              ", size=" + format_bytes(static_cast<uint64_t>(size)));
+    }
+}
+
+// Builds the low-address alias of a fresh HOST_VISIBLE allocation through a
+// temporary driver mapping and parks it in the reuse cache, so the first
+// whole-allocation vkMapMemory is a cache hit instead of an fd scan, alias
+// ioctl and mmap on the application's thread.
+static void create_eager_low_address_alias(VkDevice device, VkDeviceMemory memory, VkDeviceSize size,
+                                           VkMemoryPropertyFlags memory_flags)
+{
+    using namespace mali_wrapper;
+
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch == nullptr || dispatch->map_memory == nullptr || dispatch->unmap_memory == nullptr ||
+        size == 0 || size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
+        return;
+    }
+
+    void* real_ptr = nullptr;
+    if (dispatch->map_memory(device, memory, 0, VK_WHOLE_SIZE, 0, &real_ptr) != VK_SUCCESS ||
+        real_ptr == nullptr) {
+        return;
+    }
+
+    if (is_pointer_32bit_compatible(real_ptr)) {
+        dispatch->unmap_memory(device, memory);
+        return;
+    }
+
+    ShadowMappingInfo mapping{};
+    const bool created = try_create_low_address_alias(real_ptr, static_cast<size_t>(size), nullptr,
+                                                      dispatch->mali_fd_cache.get(), &mapping);
+    dispatch->unmap_memory(device, memory);
+    park_eager_low_address_alias(device, memory, size, memory_flags, created, mapping);
+}
+
+// Aliases every queued allocation of the device in one batch. Runs with
+// queue.mutex held, so none of them can be mapped or freed meanwhile.
+static void flush_eager_low_address_aliases_locked(VkDevice device, const mali_wrapper::ManagedDeviceDispatch& dispatch,
+                                                   mali_wrapper::EagerAliasQueue& queue)
+{
+    using namespace mali_wrapper;
+
+    std::vector<PendingEagerAlias> pending;
+    pending.swap(queue.pending);
+    queue.pending_count.store(0, std::memory_order_relaxed);
+
+    // The kernel finds each allocation through its CPU mapping, so all of
+    // them stay mapped in the driver until the batch has been created.
+    std::vector<LowAddressAliasRequest> requests;
+    std::vector<size_t> request_owners;
+    requests.reserve(pending.size());
+    request_owners.reserve(pending.size());
+    for (size_t i = 0; i < pending.size(); i++) {
+        void* real_ptr = nullptr;
+        if (dispatch.map_memory(device, pending[i].memory, 0, VK_WHOLE_SIZE, 0, &real_ptr) != VK_SUCCESS ||
+            real_ptr == nullptr) {
+            continue;
+        }
+        if (is_pointer_32bit_compatible(real_ptr)) {
+            dispatch.unmap_memory(device, pending[i].memory);
+            continue;
+        }
+
+        LowAddressAliasRequest request{};
+        request.real_ptr = real_ptr;
+        request.mapped_size = static_cast<size_t>(pending[i].size);
+        requests.push_back(request);
+        request_owners.push_back(i);
+    }
+
+    try_create_low_address_alias_batch(requests, dispatch.mali_fd_cache.get());
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        const PendingEagerAlias& allocation = pending[request_owners[i]];
+        dispatch.unmap_memory(device, allocation.memory);
+        park_eager_low_address_alias(device, allocation.memory, allocation.size, allocation.memory_flags,
+                                     requests[i].created, requests[i].mapping);
+    }
+}
+
+// Eager aliasing entry point for vkAllocateMemory. With the batched alias
+// ioctl the allocation is queued and the queue is flushed once it holds a
+// full batch; otherwise the alias is created right away.
+static void queue_eager_low_address_alias(VkDevice device, VkDeviceMemory memory, VkDeviceSize size,
+                                          VkMemoryPropertyFlags memory_flags)
+{
+    using namespace mali_wrapper;
+
+    auto dispatch = get_managed_device_dispatch(device);
+    // With kernel low placement the allocation is normally low already; the
+    // rare one that spilled above 4 GiB is aliased when it is mapped.
+    if (dispatch != nullptr && dispatch->mali_fd_cache != nullptr &&
+        dispatch->mali_fd_cache->low32_placement.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (dispatch == nullptr || dispatch->eager_alias_queue == nullptr || dispatch->mali_fd_cache == nullptr ||
+        !dispatch->mali_fd_cache->alias_batch_supported.load(std::memory_order_relaxed)) {
+        create_eager_low_address_alias(device, memory, size, memory_flags);
+        return;
+    }
+    if (dispatch->map_memory == nullptr || dispatch->unmap_memory == nullptr ||
+        size == 0 || size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
+        return;
+    }
+
+    EagerAliasQueue& queue = *dispatch->eager_alias_queue;
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.pending.push_back(PendingEagerAlias{ memory, size, memory_flags });
+    queue.pending_count.store(queue.pending.size(), std::memory_order_relaxed);
+    if (queue.pending.size() >= KBASE_MEM_LOW32_ALIAS_BATCH_MAX) {
+        flush_eager_low_address_aliases_locked(device, *dispatch, queue);
+    }
+}
+
+// Called before the driver maps or frees memory. A queued allocation that is
+// about to be mapped is aliased now, together with the rest of the queue, so
+// the map hits the reuse cache; one that is about to be freed is dropped.
+static void settle_queued_eager_low_address_alias(VkDevice device, VkDeviceMemory memory, bool freeing)
+{
+    using namespace mali_wrapper;
+
+    if (!should_use_low_address_shadow_map() || !should_eagerly_alias_allocations()) {
+        return;
+    }
+
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch == nullptr || dispatch->eager_alias_queue == nullptr) {
+        return;
+    }
+
+    EagerAliasQueue& queue = *dispatch->eager_alias_queue;
+    if (queue.pending_count.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    auto it = std::find_if(queue.pending.begin(), queue.pending.end(),
+                           [memory](const PendingEagerAlias& pending) { return pending.memory == memory; });
+    if (it == queue.pending.end()) {
+        return;
+    }
+
+    if (freeing) {
+        queue.pending.erase(it);
+        queue.pending_count.store(queue.pending.size(), std::memory_order_relaxed);
+        return;
+    }
+    flush_eager_low_address_aliases_locked(device, *dispatch, queue);
+}
+
+// VK_EXT_map_memory_placed on top of the driver's own mapping: the allocation
+// is aliased at the application's address, or shadowed there when the alias
+// ioctl is unavailable. *ppData holds the driver pointer on entry. On failure
+// the driver mapping is undone, as the placed map never happened.
+static VkResult apply_placed_memory_mapping(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset,
+                                            VkDeviceSize size, void* placed_addr, void** ppData)
+{
+    using namespace mali_wrapper;
+
+    const DeviceMemoryKey key = make_memory_key(device, memory);
+    auto dispatch = get_managed_device_dispatch(device);
+    const std::shared_ptr<DeviceLowAddressMappingIndex> mapping_index =
+        dispatch != nullptr ? dispatch->low_address_mapping_index : nullptr;
+    auto fail = [&](const char* reason) {
+        LOW_ADDRESS_LOG_WARN(std::string("Placed memory map failed: ") + reason +
+                             ", placed=" + format_pointer(placed_addr));
+        if (dispatch != nullptr && dispatch->unmap_memory != nullptr) {
+            dispatch->unmap_memory(device, memory);
+        }
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    };
+
+    VkDeviceSize resolved_size = 0;
+    VkMemoryPropertyFlags memory_flags = 0;
+    if (!resolve_map_size(key, offset, size, &resolved_size, &memory_flags) || resolved_size == 0 ||
+        resolved_size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
+        return fail("unable to resolve mapping size");
+    }
+
+    const void* real_ptr = *ppData;
+    MaliDeviceFdCache* fd_cache = dispatch != nullptr ? dispatch->mali_fd_cache.get() : nullptr;
+    ShadowMappingInfo mapping{};
+    ShadowAllocationResult allocation{};
+    if (!try_create_low_address_alias(real_ptr, static_cast<size_t>(resolved_size), placed_addr, fd_cache,
+                                      &mapping)) {
+        const size_t shadow_size = align_up_to_page(static_cast<size_t>(resolved_size));
+        enforce_low_address_shadow_budget(shadow_size);
+        void* shadow = (shadow_size > 0)
+            ? mmap(placed_addr, shadow_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0)
+            : MAP_FAILED;
+        if (shadow == MAP_FAILED) {
+            return fail("unable to map a shadow at the placed address");
+        }
+        if (should_use_low_address_shadow_huge_pages()) {
+            prepare_shadow_huge_pages(shadow, shadow_size);
+        }
+
+        low_address_shadow_resident_bytes.fetch_add(shadow_size, std::memory_order_relaxed);
+        const bool lazy_fill = should_fill_low_address_shadows_lazily();
+        if (!lazy_fill) {
+            tracked_memcpy(shadow, real_ptr, static_cast<size_t>(resolved_size),
+                           LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+        }
+
+        mapping.real_ptr = const_cast<void*>(real_ptr);
+        mapping.shadow_ptr = shadow;
+        mapping.shadow_size = shadow_size;
+        mapping.mode = LowAddressMapMode::SHADOW;
+        mapping.unmap_ptr = shadow;
+        mapping.unmap_size = shadow_size;
+        mapping.placed = true;
+        if (should_track_low_address_shadow_writes()) {
+            mapping.dirty_tracker = register_shadow_dirty_tracking(shadow, shadow_size);
+            if (mapping.dirty_tracker != nullptr) {
+                set_shadow_dirty_tracking_source(*mapping.dirty_tracker, const_cast<void*>(real_ptr),
+                                                 static_cast<size_t>(resolved_size));
+            }
+        }
+        if (lazy_fill && (mapping.dirty_tracker == nullptr ||
+                          !evict_shadow_for_lazy_fill(*mapping.dirty_tracker, shadow_size,
+                                                      static_cast<size_t>(resolved_size)))) {
+            if (mapping.dirty_tracker != nullptr) {
+                mprotect(shadow, shadow_size, PROT_READ | PROT_WRITE);
+            }
+            tracked_memcpy(shadow, real_ptr, static_cast<size_t>(resolved_size),
+                           LowAddressCopyKind::MAP_TO_SHADOW, memory_flags);
+            if (mapping.dirty_tracker != nullptr) {
+                mprotect(shadow, shadow_size, PROT_READ);
+            }
+        }
+        allocation.ptr = shadow;
+        allocation.size = shadow_size;
+    }
+    mapping.offset = offset;
+    mapping.mapped_size = resolved_size;
+    mapping.memory_flags = memory_flags;
+
+    ShadowMappingInfo stale_mapping{};
+    bool has_stale_mapping = false;
+    {
+        auto lock = lock_shadow_mappings_exclusive();
+        has_stale_mapping = install_low_address_mapping_locked(key, mapping, mapping_index, &stale_mapping);
+    }
+
+    if (mapping.mode == LowAddressMapMode::SHADOW) {
+        record_shadow_mapping_installed(allocation.size,
+                                        has_stale_mapping ? stale_mapping.shadow_size : 0,
+                                        allocation);
+    }
+    if (has_stale_mapping) {
+        if (stale_mapping.mode == LowAddressMapMode::SHADOW && stale_mapping.shadow_size > 0) {
+            record_shadow_mapping_removed(stale_mapping.shadow_size);
+        }
+        release_low_address_mapping(stale_mapping);
+    }
+
+    if (should_trace_low_address_map_events()) {
+        LOW_ADDRESS_LOG_INFO("Placed memory map applied: mode=" +
+                             std::string(low_address_map_mode_to_string(mapping.mode)) +
+                             ", real=" + format_pointer(real_ptr) +
+                             ", placed=" + format_pointer(placed_addr) +
+                             ", size=" + format_bytes(static_cast<uint64_t>(resolved_size)));
+    }
+    maybe_log_low_address_map_progress("placed", false);
+
+    *ppData = placed_addr;
+    return VK_SUCCESS;
+}
+
 static void sync_shadow_to_real(VkDevice device, uint32_t memoryRangeCount, const VkMappedMemoryRange* pMemoryRanges)
 {
     using namespace mali_wrapper;
@@ -2676,8 +6495,15 @@ static void sync_shadow_to_real(VkDevice device, uint32_t memoryRangeCount, cons
         return;
     }
 
+    struct FlushRange {
+        ShadowMappingInfo* mapping;
+        size_t offset;
+        size_t end;
+    };
+
     bool copied_anything = false;
-    std::lock_guard<std::mutex> lock(memory_tracking_mutex);
+    std::vector<FlushRange> untracked_ranges;
+    auto lock = lock_shadow_mappings_shared();
     for (uint32_t i = 0; i < memoryRangeCount; i++) {
         const VkMappedMemoryRange& range = pMemoryRanges[i];
         const DeviceMemoryKey key = make_memory_key(device, range.memory);
@@ -2695,11 +6521,51 @@ static void sync_shadow_to_real(VkDevice device, uint32_t memoryRangeCount, cons
             continue;
         }
 
-        auto* shadow_bytes = static_cast<const uint8_t*>(map_it->second.shadow_ptr);
-        auto* real_bytes = static_cast<uint8_t*>(map_it->second.real_ptr);
-        tracked_memcpy(real_bytes + byte_offset, shadow_bytes + byte_offset, byte_count,
-                       LowAddressCopyKind::FLUSH_TO_REAL);
-        copied_anything = true;
+        if (map_it->second.adaptive_profile != nullptr) {
+            map_it->second.adaptive_profile->window_flush_bytes.fetch_add(byte_count, std::memory_order_relaxed);
+        }
+
+        // Tracked pages are marked clean as they are copied, so ranges that
+        // overlap an earlier one find those pages clean and skip them.
+        if (map_it->second.dirty_tracker != nullptr) {
+            flush_dirty_shadow_range_locked(map_it->second, byte_offset, byte_count);
+        } else {
+            untracked_ranges.push_back(FlushRange{ &map_it->second, byte_offset, byte_offset + byte_count });
+        }
+        copied_anything = true;
+    }
+
+    // Merge overlapping and adjacent ranges of the same mapping so every byte
+    // is copied once, then copy them as one batch.
+    if (!untracked_ranges.empty()) {
+        std::sort(untracked_ranges.begin(), untracked_ranges.end(), [](const FlushRange& a, const FlushRange& b) {
+            if (a.mapping != b.mapping) {
+                return reinterpret_cast<uintptr_t>(a.mapping) < reinterpret_cast<uintptr_t>(b.mapping);
+            }
+            return a.offset < b.offset;
+        });
+
+        std::vector<CopyEngine::Region> batch;
+        batch.reserve(untracked_ranges.size());
+        size_t merged = 0;
+        for (size_t i = 1; i < untracked_ranges.size(); i++) {
+            FlushRange& current = untracked_ranges[merged];
+            const FlushRange& next = untracked_ranges[i];
+            if (next.mapping == current.mapping && next.offset <= current.end) {
+                current.end = std::max(current.end, next.end);
+            } else {
+                untracked_ranges[++merged] = next;
+            }
+        }
+        untracked_ranges.resize(merged + 1);
+
+        for (const FlushRange& range : untracked_ranges) {
+            batch.push_back(CopyEngine::Region{ static_cast<uint8_t*>(range.mapping->real_ptr) + range.offset,
+                                                static_cast<const uint8_t*>(range.mapping->shadow_ptr) + range.offset,
+                                                range.end - range.offset,
+                                                get_copy_memory_type(range.mapping->memory_flags) });
+        }
+        tracked_memcpy_batch(batch, LowAddressCopyKind::FLUSH_TO_REAL);
     }
 
     if (copied_anything) {
@@ -2716,7 +6582,7 @@ static void sync_real_to_shadow(VkDevice device, uint32_t memoryRangeCount, cons
     }
 
     bool copied_anything = false;
-    std::lock_guard<std::mutex> lock(memory_tracking_mutex);
+    auto lock = lock_shadow_mappings_shared();
     for (uint32_t i = 0; i < memoryRangeCount; i++) {
         const VkMappedMemoryRange& range = pMemoryRanges[i];
         const DeviceMemoryKey key = make_memory_key(device, range.memory);
@@ -2736,8 +6602,18 @@ static void sync_real_to_shadow(VkDevice device, uint32_t memoryRangeCount, cons
 
         auto* shadow_bytes = static_cast<uint8_t*>(map_it->second.shadow_ptr);
         auto* real_bytes = static_cast<const uint8_t*>(map_it->second.real_ptr);
+        if (map_it->second.dirty_tracker != nullptr) {
+            // Unprotect first so the copy does not fault; the pages stay writable,
+            // so they must be treated as dirty from here on.
+            restore_evicted_shadow_pages(map_it->second, byte_offset, byte_count);
+            const uintptr_t first_page = align_down_to_page(reinterpret_cast<uintptr_t>(shadow_bytes + byte_offset));
+            const uintptr_t range_end = reinterpret_cast<uintptr_t>(shadow_bytes + byte_offset + byte_count);
+            mprotect(reinterpret_cast<void*>(first_page), align_up_to_page(range_end - first_page),
+                     PROT_READ | PROT_WRITE);
+            mark_shadow_range_dirty(map_it->second, byte_offset, byte_count);
+        }
         tracked_memcpy(shadow_bytes + byte_offset, real_bytes + byte_offset, byte_count,
-                       LowAddressCopyKind::INVALIDATE_TO_SHADOW);
+                       LowAddressCopyKind::INVALIDATE_TO_SHADOW, map_it->second.memory_flags);
         copied_anything = true;
     }
 
@@ -2746,78 +6622,474 @@ static void sync_real_to_shadow(VkDevice device, uint32_t memoryRangeCount, cons
     }
 }
 
-static void sync_all_shadows_for_device(VkDevice device)
+static const char* low_address_shadow_strategy_to_string(mali_wrapper::LowAddressShadowStrategy strategy)
+{
+    return strategy == mali_wrapper::LowAddressShadowStrategy::TRACKED ? "tracked" : "full-copy";
+}
+
+// Switches the allocation's strategy and leaves the live shadow to the
+// device's next migration pass. Concurrent submits closing the same window
+// switch it once.
+static void request_adaptive_shadow_strategy(mali_wrapper::ShadowMappingInfo& mapping,
+                                             mali_wrapper::LowAddressShadowStrategy from,
+                                             mali_wrapper::LowAddressShadowStrategy to, const std::string& reason)
 {
     using namespace mali_wrapper;
 
-    if (device == VK_NULL_HANDLE) {
+    if (!mapping.adaptive_profile->strategy.compare_exchange_strong(from, to, std::memory_order_acq_rel)) {
         return;
     }
+    if (mapping.device_index != nullptr) {
+        mapping.device_index->adaptive_migration_pending.store(true, std::memory_order_release);
+    }
 
-    bool copied_anything = false;
-    std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-    for (auto& entry : shadow_mappings) {
-        if (entry.first.device != device) {
-            continue;
+    LOW_ADDRESS_LOG_INFO("Low-address adaptive sync: shadow " + format_pointer(mapping.shadow_ptr) +
+                         " (" + format_bytes(static_cast<uint64_t>(mapping.mapped_size)) + ") " +
+                         low_address_shadow_strategy_to_string(from) + " -> " +
+                         low_address_shadow_strategy_to_string(to) + ": " + reason + ", switch " +
+                         std::to_string(mapping.adaptive_profile->migrations.load(std::memory_order_relaxed) + 1));
+}
+
+// Records one submit write-back of pages pages and closes the window when it
+// is full.
+static void note_adaptive_shadow_submit(mali_wrapper::ShadowMappingInfo& mapping, uint64_t pages)
+{
+    using namespace mali_wrapper;
+
+    LowAddressAdaptiveProfile* profile = mapping.adaptive_profile.get();
+    if (profile == nullptr) {
+        return;
+    }
+
+    const LowAddressShadowStrategy current = mapping.dirty_tracker != nullptr ? LowAddressShadowStrategy::TRACKED
+                                                                              : LowAddressShadowStrategy::FULL_COPY;
+    if (profile->strategy.load(std::memory_order_acquire) != current) {
+        return; // Waiting for the migration pass.
+    }
+
+    profile->window_pages.fetch_add(pages, std::memory_order_relaxed);
+    const uint64_t syncs = profile->window_syncs.fetch_add(1, std::memory_order_acq_rel) + 1;
+    if (syncs < kAdaptiveWindowSyncs) {
+        return;
+    }
+
+    const uint64_t page_size = get_page_size();
+    const uint64_t mapped_size = static_cast<uint64_t>(mapping.mapped_size);
+    const uint64_t page_count = (mapped_size + page_size - 1) / page_size;
+    if (current == LowAddressShadowStrategy::TRACKED) {
+        const uint64_t window_pages = profile->window_pages.exchange(0, std::memory_order_acq_rel);
+        profile->window_syncs.store(0, std::memory_order_release);
+        profile->window_flush_bytes.store(0, std::memory_order_relaxed);
+
+        const uint64_t density_percent = (window_pages * 100) / (syncs * page_count);
+        if (density_percent < kAdaptiveFullCopyDensityPercent) {
+            if (profile->tracked_trial.exchange(false, std::memory_order_acq_rel)) {
+                profile->retry_syncs.store(kAdaptiveRetrySyncs, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        if (profile->tracked_trial.exchange(false, std::memory_order_acq_rel)) {
+            const uint64_t retry = profile->retry_syncs.load(std::memory_order_relaxed);
+            profile->retry_syncs.store(std::min(retry * 2, kAdaptiveMaxRetrySyncs), std::memory_order_relaxed);
+        }
+        request_adaptive_shadow_strategy(mapping, current, LowAddressShadowStrategy::FULL_COPY,
+                                         std::to_string(density_percent) + "% of pages dirty over " +
+                                             std::to_string(syncs) + " submits");
+        return;
+    }
+
+    // Flushes that cover less than half of what the submits copied say the
+    // application writes only part of the mapping; try tracking sooner.
+    const uint64_t flush_bytes = profile->window_flush_bytes.load(std::memory_order_relaxed);
+    const bool partial_flushes = flush_bytes > 0 && flush_bytes * 2 < syncs * mapped_size;
+    const uint64_t retry = profile->retry_syncs.load(std::memory_order_relaxed);
+    if (syncs < (partial_flushes ? std::max(kAdaptiveWindowSyncs, retry / 4) : retry)) {
+        return;
+    }
+
+    profile->window_pages.store(0, std::memory_order_relaxed);
+    profile->window_syncs.store(0, std::memory_order_release);
+    profile->window_flush_bytes.store(0, std::memory_order_relaxed);
+    profile->tracked_trial.store(true, std::memory_order_release);
+    const std::string reason =
+        partial_flushes
+            ? "flushes cover " + std::to_string((flush_bytes * 100) / (syncs * mapped_size)) + "% of " +
+                  std::to_string(syncs) + " submit copies"
+            : "retrying after " + std::to_string(syncs) + " submits";
+    request_adaptive_shadow_strategy(mapping, current, LowAddressShadowStrategy::TRACKED, reason);
+}
+
+// TRACKED -> FULL_COPY: refill evicted pages and unprotect the shadow. Pages
+// written since the last submit are copied by the whole-mapping write-back
+// that follows. The tracker is retired rather than unregistered; see
+// ShadowMappingInfo::retired_dirty_tracker.
+static bool stop_adaptive_shadow_tracking_locked(mali_wrapper::ShadowMappingInfo& mapping)
+{
+    using namespace mali_wrapper;
+
+    ShadowDirtyTracker& tracker = *mapping.dirty_tracker;
+    restore_evicted_shadow_pages(mapping, 0, mapping.shadow_size);
+    if (tracker.slot < 0 || get_shadow_resident_bytes(mapping) != mapping.shadow_size) {
+        return false;
+    }
+
+    DirtyTrackedRegionSlot& slot = dirty_tracked_regions[static_cast<size_t>(tracker.slot)];
+    lock_dirty_tracked_region_pages(slot);
+    const bool unprotected = mprotect(mapping.shadow_ptr, mapping.shadow_size, PROT_READ | PROT_WRITE) == 0;
+    unlock_dirty_tracked_region_pages(slot);
+    if (!unprotected) {
+        mprotect(mapping.shadow_ptr, mapping.shadow_size, PROT_READ);
+        return false;
+    }
+
+    mapping.retired_dirty_tracker = std::move(mapping.dirty_tracker);
+    return true;
+}
+
+// FULL_COPY -> TRACKED: protect the shadow, then write all of it back once,
+// since writes made before the protection are not marked dirty.
+static bool start_adaptive_shadow_tracking_locked(mali_wrapper::ShadowMappingInfo& mapping)
+{
+    using namespace mali_wrapper;
+
+    std::shared_ptr<ShadowDirtyTracker> tracker = register_shadow_dirty_tracking(mapping.shadow_ptr,
+                                                                                 mapping.shadow_size);
+    if (tracker == nullptr) {
+        return false;
+    }
+
+    set_shadow_dirty_tracking_source(*tracker, mapping.real_ptr, static_cast<size_t>(mapping.mapped_size));
+    tracked_memcpy(mapping.real_ptr, mapping.shadow_ptr, static_cast<size_t>(mapping.mapped_size),
+                   LowAddressCopyKind::SUBMIT_TO_REAL, mapping.memory_flags);
+    mapping.dirty_tracker = std::move(tracker);
+    return true;
+}
+
+// Converts the device's live shadows to their allocation's strategy and
+// unregisters trackers retired by the previous pass. Runs from a submit,
+// under the exclusive tracking lock, before the shadows are synced.
+static void migrate_adaptive_shadows_locked(mali_wrapper::DeviceLowAddressMappingIndex& index)
+{
+    using namespace mali_wrapper;
+
+    bool retired_any = false;
+    for (auto& entry : index.shadow_entries) {
+        ShadowMappingInfo& mapping = *entry.mapping;
+        if (mapping.retired_dirty_tracker != nullptr) {
+            unregister_shadow_dirty_tracking(*mapping.retired_dirty_tracker);
+            mapping.retired_dirty_tracker.reset();
         }
 
-        auto& mapping = entry.second;
-        if (mapping.mode != LowAddressMapMode::SHADOW) {
+        LowAddressAdaptiveProfile* profile = mapping.adaptive_profile.get();
+        if (profile == nullptr || mapping.real_ptr == nullptr) {
             continue;
         }
-        if (mapping.real_ptr == nullptr || mapping.shadow_ptr == nullptr ||
-            mapping.mapped_size == 0 ||
-            mapping.mapped_size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
+        const LowAddressShadowStrategy target = profile->strategy.load(std::memory_order_acquire);
+        const bool tracked = mapping.dirty_tracker != nullptr;
+        if ((target == LowAddressShadowStrategy::TRACKED) == tracked) {
             continue;
         }
 
-        tracked_memcpy(mapping.real_ptr, mapping.shadow_ptr, static_cast<size_t>(mapping.mapped_size),
-                       LowAddressCopyKind::SUBMIT_TO_REAL);
-        copied_anything = true;
+        const bool migrated = tracked ? stop_adaptive_shadow_tracking_locked(mapping)
+                                      : start_adaptive_shadow_tracking_locked(mapping);
+        if (!migrated) {
+            // Stay as it is and back off before the next attempt.
+            const LowAddressShadowStrategy current =
+                tracked ? LowAddressShadowStrategy::TRACKED : LowAddressShadowStrategy::FULL_COPY;
+            profile->strategy.store(current, std::memory_order_release);
+            profile->tracked_trial.store(false, std::memory_order_relaxed);
+            const uint64_t retry = profile->retry_syncs.load(std::memory_order_relaxed);
+            profile->retry_syncs.store(std::min(retry * 2, kAdaptiveMaxRetrySyncs), std::memory_order_relaxed);
+            if (should_collect_low_address_map_stats()) {
+                low_address_map_stats.local().adaptive_migration_failures.fetch_add(1, std::memory_order_relaxed);
+            }
+            LOW_ADDRESS_LOG_WARN("Low-address adaptive sync: shadow " + format_pointer(mapping.shadow_ptr) +
+                                 " stays " + low_address_shadow_strategy_to_string(current) +
+                                 ", switching to " + low_address_shadow_strategy_to_string(target) + " failed");
+            continue;
+        }
+
+        // Stamps of one strategy mean nothing to the other.
+        mapping.submit_sync_stamp.value.store(0, std::memory_order_release);
+        profile->migrations.fetch_add(1, std::memory_order_relaxed);
+        retired_any |= tracked;
+        if (should_collect_low_address_map_stats()) {
+            (tracked ? low_address_map_stats.local().adaptive_full_copy_migrations
+                     : low_address_map_stats.local().adaptive_tracked_migrations)
+                .fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (retired_any) {
+        index.adaptive_migration_pending.store(true, std::memory_order_release);
+    }
+}
+
+// Plain shadows are queued on batch and copied together by the caller; dirty
+// tracked ones are synced page run by page run right away.
+static bool sync_shadow_mapping_for_submit_locked(mali_wrapper::ShadowMappingInfo& mapping,
+                                                  std::vector<mali_wrapper::CopyEngine::Region>* batch)
+{
+    using namespace mali_wrapper;
+
+    if (mapping.mode != LowAddressMapMode::SHADOW) {
+        return false;
+    }
+    if (mapping.real_ptr == nullptr || mapping.shadow_ptr == nullptr ||
+        mapping.mapped_size == 0 ||
+        mapping.mapped_size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
+        return false;
+    }
+
+    // memory_flags is 0 when the allocation was not seen by vkAllocateMemory;
+    // keep syncing those since the memory type is unknown.
+    if (mapping.memory_flags != 0 &&
+        (mapping.memory_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0 &&
+        !should_sync_noncoherent_shadows_on_submit()) {
+        if (should_collect_low_address_map_stats()) {
+            low_address_map_stats.local().submit_noncoherent_skips.fetch_add(1, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    if (mapping.dirty_tracker != nullptr) {
+        const uint64_t dirty_pages = sync_dirty_shadow_pages_locked(mapping, LowAddressCopyKind::SUBMIT_TO_REAL);
+        note_adaptive_shadow_submit(mapping, dirty_pages);
+    } else {
+        batch->push_back(CopyEngine::Region{ mapping.real_ptr, mapping.shadow_ptr,
+                                             static_cast<size_t>(mapping.mapped_size),
+                                             get_copy_memory_type(mapping.memory_flags) });
+        note_adaptive_shadow_submit(mapping, 0);
+    }
+    return true;
+}
+
+// referenced, when given, is the sorted list of memory the submission uses;
+// shadows of any other memory are left for a later submit, flush or unmap.
+static bool is_shadow_referenced(const std::vector<VkDeviceMemory>* referenced, VkDeviceMemory memory)
+{
+    using namespace mali_wrapper;
+
+    if (referenced == nullptr || std::binary_search(referenced->begin(), referenced->end(), memory)) {
+        return true;
+    }
+    if (should_collect_low_address_map_stats()) {
+        low_address_map_stats.local().submit_unreferenced_skips.fetch_add(1, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+// Stamp a shadow carries once it has been written back: the region's write
+// count, plus one so it is never 0. 0 when the shadow always has to be
+// synced, as when nothing tracks its writes.
+static uint64_t shadow_submit_sync_stamp(const mali_wrapper::ShadowMappingInfo& mapping)
+{
+    using namespace mali_wrapper;
+
+    if (mapping.dirty_tracker == nullptr || mapping.dirty_tracker->slot < 0) {
+        return 0;
+    }
+    return dirty_tracked_regions[static_cast<size_t>(mapping.dirty_tracker->slot)].writes.load(
+               std::memory_order_acquire) + 1;
+}
+
+static void sync_all_shadows_for_device(VkDevice device, const std::vector<VkDeviceMemory>* referenced = nullptr)
+{
+    using namespace mali_wrapper;
+
+    if (device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    auto dispatch = get_managed_device_dispatch(device);
+    DeviceLowAddressMappingIndex* index =
+        dispatch != nullptr ? dispatch->low_address_mapping_index.get() : nullptr;
+
+    TraceScope trace_scope(TraceEvent::SUBMIT_SYNC);
+    bool copied_anything = false;
+    std::vector<CopyEngine::Region> batch;
+    // Stamps are stored only once the batch is copied, so a concurrent submit
+    // never skips a shadow whose write-back is still in flight.
+    std::vector<std::pair<ShadowSyncStamp*, uint64_t>> stamps;
+    if (index != nullptr && index->adaptive_migration_pending.exchange(false, std::memory_order_acq_rel)) {
+        auto migration_lock = lock_shadow_mappings_exclusive();
+        migrate_adaptive_shadows_locked(*index);
+    }
+    auto lock = lock_shadow_mappings_shared();
+    if (index != nullptr) {
+        const bool use_stamps = should_scope_shadow_sync_to_epochs();
+        // Only shadow-mode mappings need a copy; alias mappings are kept in a separate list.
+        batch.reserve(index->shadow_entries.size());
+        for (auto& entry : index->shadow_entries) {
+            if (!is_shadow_referenced(referenced, entry.memory)) {
+                continue;
+            }
+
+            const uint64_t stamp = use_stamps ? shadow_submit_sync_stamp(*entry.mapping) : 0;
+            if (stamp != 0 && entry.mapping->submit_sync_stamp.value.load(std::memory_order_acquire) == stamp) {
+                if (should_collect_low_address_map_stats()) {
+                    low_address_map_stats.local().submit_epoch_skips.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+
+            if (sync_shadow_mapping_for_submit_locked(*entry.mapping, &batch)) {
+                copied_anything = true;
+                if (stamp != 0) {
+                    stamps.emplace_back(&entry.mapping->submit_sync_stamp, stamp);
+                }
+            }
+        }
+    } else {
+        for (auto& entry : shadow_mappings) {
+            if (entry.first.device == device && is_shadow_referenced(referenced, entry.first.memory)) {
+                copied_anything |= sync_shadow_mapping_for_submit_locked(entry.second, &batch);
+            }
+        }
+    }
+    tracked_memcpy_batch(batch, LowAddressCopyKind::SUBMIT_TO_REAL);
+    for (const auto& stamp : stamps) {
+        stamp.first->value.store(stamp.second, std::memory_order_release);
     }
+    trace_scope.SetArgs(batch.size(), copied_anything ? 1 : 0);
 
     if (copied_anything) {
         maybe_log_low_address_map_progress("queue-submit", false);
     }
 }
 
+// Submit-time sync for a queue's device, narrowed to the referenced memory
+// when the device has a SubmitReferenceTracker that can follow the submission.
+template <typename SubmitInfo>
+static void sync_shadows_for_submit(VkDevice device, const mali_wrapper::ManagedDeviceDispatch* dispatch,
+                                    uint32_t submit_count, const SubmitInfo* submits)
+{
+    bool synced = false;
+    if (dispatch != nullptr && dispatch->reference_tracker != nullptr) {
+        thread_local std::vector<VkDeviceMemory> referenced;
+        if (dispatch->reference_tracker->CollectReferences(submit_count, submits, &referenced)) {
+            sync_all_shadows_for_device(device, &referenced);
+            synced = true;
+        }
+    }
+    if (!synced) {
+        sync_all_shadows_for_device(device);
+    }
+}
+
 static void sync_all_shadows()
 {
     using namespace mali_wrapper;
 
+    TraceScope trace_scope(TraceEvent::SUBMIT_SYNC);
     bool copied_anything = false;
-    std::lock_guard<std::mutex> lock(memory_tracking_mutex);
+    std::vector<CopyEngine::Region> batch;
+    auto lock = lock_shadow_mappings_shared();
     for (auto& entry : shadow_mappings) {
-        auto& mapping = entry.second;
-        if (mapping.mode != LowAddressMapMode::SHADOW) {
-            continue;
-        }
-        if (mapping.real_ptr == nullptr || mapping.shadow_ptr == nullptr ||
-            mapping.mapped_size == 0 ||
-            mapping.mapped_size > static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
-            continue;
-        }
-
-        tracked_memcpy(mapping.real_ptr, mapping.shadow_ptr, static_cast<size_t>(mapping.mapped_size),
-                       LowAddressCopyKind::SUBMIT_TO_REAL);
-        copied_anything = true;
+        copied_anything |= sync_shadow_mapping_for_submit_locked(entry.second, &batch);
     }
+    tracked_memcpy_batch(batch, LowAddressCopyKind::SUBMIT_TO_REAL);
+    trace_scope.SetArgs(batch.size(), copied_anything ? 1 : 0);
 
     if (copied_anything) {
         maybe_log_low_address_map_progress("queue-submit", false);
     }
 }
 
+#if MALI_WRAPPER_HARNESS
+// Queues of harness devices, which have no wsi private data.
+static std::shared_mutex harness_queue_mutex;
+static std::unordered_map<VkQueue, VkDevice> harness_queue_devices;
+#endif
+
 static VkDevice get_queue_parent_device_safe(VkQueue queue)
 {
     if (queue == VK_NULL_HANDLE) {
         return VK_NULL_HANDLE;
     }
 
+#if MALI_WRAPPER_HARNESS
+    {
+        std::shared_lock<std::shared_mutex> lock(harness_queue_mutex);
+        auto it = harness_queue_devices.find(queue);
+        if (it != harness_queue_devices.end()) {
+            return it->second;
+        }
+    }
+#endif
+
     auto* queue_device_data = mali_wrapper::device_private_data::try_get(queue);
     return queue_device_data != nullptr ? queue_device_data->device : VK_NULL_HANDLE;
 }
 
+// Submit-path lookup of the queue's parent device and its driver dispatch.
+// The thread-local entry owns a reference, so a steady-state submit takes no
+// lock and touches no refcount; any device create or destroy bumps
+// managed_device_generation and forces a fresh lookup. The returned pointer is
+// valid until this thread's next call.
+static const mali_wrapper::ManagedDeviceDispatch* get_queue_dispatch(VkQueue queue, VkDevice* out_device)
+{
+    using namespace mali_wrapper;
+
+    thread_local uint64_t cached_generation = 0;
+    thread_local VkQueue cached_queue = VK_NULL_HANDLE;
+    thread_local VkDevice cached_device = VK_NULL_HANDLE;
+    thread_local std::shared_ptr<const ManagedDeviceDispatch> cached_dispatch;
+
+    const uint64_t generation = managed_device_generation.load(std::memory_order_acquire);
+    if (queue != VK_NULL_HANDLE && cached_queue == queue && cached_generation == generation) {
+        *out_device = cached_device;
+        return cached_dispatch.get();
+    }
+
+    const VkDevice device = get_queue_parent_device_safe(queue);
+    auto dispatch = get_managed_device_dispatch(device);
+    *out_device = device;
+    if (device == VK_NULL_HANDLE) {
+        // The queue may simply not be registered yet; do not cache the miss.
+        return nullptr;
+    }
+
+    cached_generation = generation;
+    cached_queue = queue;
+    cached_device = device;
+    cached_dispatch = std::move(dispatch);
+    return cached_dispatch.get();
+}
+
+// The first present only sets the baseline, so map-time copies made while
+// loading do not count as a frame.
+static void record_low_address_frame_copies()
+{
+    using namespace mali_wrapper;
+
+    if (!should_collect_low_address_map_stats()) {
+        return;
+    }
+
+    const uint64_t total = low_address_map_stats.sum(&LowAddressMapCounterShard::initial_copy_bytes) +
+                           low_address_map_stats.sum(&LowAddressMapCounterShard::flush_copy_bytes) +
+                           low_address_map_stats.sum(&LowAddressMapCounterShard::invalidate_copy_bytes) +
+                           low_address_map_stats.sum(&LowAddressMapCounterShard::submit_copy_bytes) +
+                           low_address_map_stats.sum(&LowAddressMapCounterShard::unmap_copy_bytes);
+    const uint64_t previous = low_address_map_stats.copy_frame_base.exchange(total, std::memory_order_relaxed);
+    if (low_address_map_stats.copy_frames.fetch_add(1, std::memory_order_relaxed) == 0) {
+        low_address_map_stats.copy_frame_first_base.store(total, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint64_t frame_bytes = total > previous ? total - previous : 0;
+    low_address_map_stats.last_frame_copy_bytes.store(frame_bytes, std::memory_order_relaxed);
+    update_peak_stat(low_address_map_stats.peak_frame_copy_bytes, frame_bytes);
+}
+
+void mali_wrapper::NotifyQueuePresented(VkQueue queue)
+{
+    (void)queue;
+    record_low_address_frame_copies();
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkAllocateMemory(
     VkDevice device,
     const VkMemoryAllocateInfo* pAllocateInfo,
@@ -2833,8 +7105,32 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkAllocateMemory(
 
     const VkResult result = mali_allocate_memory(device, pAllocateInfo, pAllocator, pMemory);
     if (result == VK_SUCCESS && pMemory != nullptr && *pMemory != VK_NULL_HANDLE && pAllocateInfo != nullptr) {
-        std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-        tracked_memory_allocations[make_memory_key(device, *pMemory)] = pAllocateInfo->allocationSize;
+        if (IsMemoryRecordingEnabled()) {
+            MemoryRecorder::Instance().RecordAllocate(recorded_memory_handle(*pMemory), pAllocateInfo->allocationSize,
+                                                      pAllocateInfo->memoryTypeIndex);
+        }
+
+        TrackedAllocation allocation{};
+        allocation.size = pAllocateInfo->allocationSize;
+        auto dispatch = get_managed_device_dispatch(device);
+        if (dispatch != nullptr && pAllocateInfo->memoryTypeIndex < dispatch->memory_type_count) {
+            allocation.property_flags = dispatch->memory_type_flags[pAllocateInfo->memoryTypeIndex];
+        }
+        if (dispatch != nullptr && dispatch->reference_tracker != nullptr) {
+            dispatch->reference_tracker->NoteMemoryAllocated(*pMemory, *pAllocateInfo);
+        }
+
+        const DeviceMemoryKey key = make_memory_key(device, *pMemory);
+        {
+            TrackedAllocationShard& shard = tracked_allocation_shard_for(key);
+            auto lock = lock_tracked_allocation_shard(shard);
+            shard.allocations[key] = allocation;
+        }
+
+        if ((allocation.property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 &&
+            should_use_low_address_shadow_map() && should_eagerly_alias_allocations()) {
+            queue_eager_low_address_alias(device, *pMemory, allocation.size, allocation.property_flags);
+        }
     }
 
     return result;
@@ -2847,21 +7143,41 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkFreeMemory(
 {
     using namespace mali_wrapper;
 
+    if (IsMemoryRecordingEnabled()) {
+        MemoryRecorder::Instance().RecordFree(recorded_memory_handle(memory));
+    }
+    settle_queued_eager_low_address_alias(device, memory, true);
+
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch != nullptr && dispatch->reference_tracker != nullptr) {
+        dispatch->reference_tracker->NoteMemoryFreed(memory);
+    }
+
     ShadowMappingInfo stale_mapping{};
     bool has_stale_mapping = false;
 
+    const DeviceMemoryKey key = make_memory_key(device, memory);
     {
-        std::lock_guard<std::mutex> lock(memory_tracking_mutex);
-        const DeviceMemoryKey key = make_memory_key(device, memory);
-        tracked_memory_allocations.erase(key);
+        TrackedAllocationShard& shard = tracked_allocation_shard_for(key);
+        auto lock = lock_tracked_allocation_shard(shard);
+        shard.allocations.erase(key);
+    }
 
+    std::vector<ShadowMappingInfo> cached_mappings;
+    {
+        auto lock = lock_shadow_mappings_exclusive();
         auto mapping_it = shadow_mappings.find(key);
         if (mapping_it != shadow_mappings.end()) {
-            stale_mapping = mapping_it->second;
+            stale_mapping = take_low_address_mapping_locked(mapping_it);
             has_stale_mapping = true;
-            shadow_mappings.erase(mapping_it);
+        }
+
+        auto cached_it = cached_low_address_mappings.find(key);
+        if (cached_it != cached_low_address_mappings.end()) {
+            evict_cached_low_address_mapping_locked(cached_it, &cached_mappings);
         }
     }
+    release_low_address_mappings(cached_mappings);
 
     if (has_stale_mapping && stale_mapping.unmap_ptr != nullptr && stale_mapping.unmap_size > 0) {
         LOW_ADDRESS_LOG_INFO("Low-address free cleanup: memory=" +
@@ -2872,7 +7188,7 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkFreeMemory(
         if (stale_mapping.mode == LowAddressMapMode::SHADOW && stale_mapping.shadow_size > 0) {
             record_shadow_mapping_removed(stale_mapping.shadow_size);
         }
-        munmap(stale_mapping.unmap_ptr, stale_mapping.unmap_size);
+        release_low_address_mapping(stale_mapping);
     }
 
     auto mali_free_memory = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::free_memory);
@@ -2894,9 +7210,15 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkMapMemory(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
+    MALI_TRACE_SCOPE(MAP_MEMORY, size, offset);
+    settle_queued_eager_low_address_alias(device, memory, false);
     VkResult result = mali_map_memory(device, memory, offset, size, flags, ppData);
     if (result == VK_SUCCESS) {
         maybe_apply_low_address_mapping(device, memory, offset, size, ppData);
+        if (mali_wrapper::IsMemoryRecordingEnabled()) {
+            mali_wrapper::MemoryRecorder::Instance().RecordMap(recorded_memory_handle(memory), offset, size, flags,
+                                                               ppData != nullptr ? *ppData : nullptr);
+        }
     }
 
     return result;
@@ -2910,19 +7232,18 @@ static bool pop_shadow_mapping(VkDevice device, VkDeviceMemory memory, mali_wrap
         return false;
     }
 
-    std::lock_guard<std::mutex> lock(memory_tracking_mutex);
+    auto lock = lock_shadow_mappings_exclusive();
     const DeviceMemoryKey key = make_memory_key(device, memory);
     auto mapping_it = shadow_mappings.find(key);
     if (mapping_it == shadow_mappings.end()) {
         return false;
     }
 
-    *out_mapping = mapping_it->second;
-    shadow_mappings.erase(mapping_it);
+    *out_mapping = take_low_address_mapping_locked(mapping_it);
     return true;
 }
 
-static void finalize_shadow_mapping(mali_wrapper::ShadowMappingInfo& mapping)
+static void finalize_shadow_mapping(const mali_wrapper::DeviceMemoryKey& key, mali_wrapper::ShadowMappingInfo& mapping)
 {
     using namespace mali_wrapper;
 
@@ -2930,8 +7251,36 @@ static void finalize_shadow_mapping(mali_wrapper::ShadowMappingInfo& mapping)
         mapping.real_ptr != nullptr && mapping.shadow_ptr != nullptr &&
         mapping.mapped_size > 0 &&
         mapping.mapped_size <= static_cast<VkDeviceSize>(std::numeric_limits<size_t>::max())) {
-        tracked_memcpy(mapping.real_ptr, mapping.shadow_ptr, static_cast<size_t>(mapping.mapped_size),
-                       LowAddressCopyKind::UNMAP_TO_REAL);
+        if (mapping.dirty_tracker != nullptr) {
+            sync_dirty_shadow_pages_locked(mapping, LowAddressCopyKind::UNMAP_TO_REAL);
+        } else {
+            tracked_memcpy(mapping.real_ptr, mapping.shadow_ptr, static_cast<size_t>(mapping.mapped_size),
+                           LowAddressCopyKind::UNMAP_TO_REAL, mapping.memory_flags);
+        }
+    }
+
+    if (should_cache_low_address_mappings()) {
+        if (mapping.dirty_tracker != nullptr) {
+            set_shadow_dirty_tracking_source(*mapping.dirty_tracker, nullptr, 0);
+        }
+
+        std::vector<ShadowMappingInfo> evicted;
+        bool cached = false;
+        {
+            auto lock = lock_shadow_mappings_exclusive();
+            cached = cache_low_address_mapping_locked(key, mapping, &evicted);
+        }
+        release_low_address_mappings(evicted);
+        if (cached) {
+            if (should_trace_low_address_map_events()) {
+                LOW_ADDRESS_LOG_INFO("Low-address mapping parked for reuse: mode=" +
+                                     std::string(low_address_map_mode_to_string(mapping.mode)) +
+                                     ", low=" + format_pointer(mapping.shadow_ptr) +
+                                     ", size=" + format_bytes(static_cast<uint64_t>(mapping.unmap_size)));
+            }
+            maybe_log_low_address_map_progress("unmap", true);
+            return;
+        }
     }
 
     if (mapping.unmap_ptr != nullptr && mapping.unmap_size > 0) {
@@ -2945,7 +7294,7 @@ static void finalize_shadow_mapping(mali_wrapper::ShadowMappingInfo& mapping)
         if (mapping.mode == LowAddressMapMode::SHADOW && mapping.shadow_size > 0) {
             record_shadow_mapping_removed(mapping.shadow_size);
         }
-        munmap(mapping.unmap_ptr, mapping.unmap_size);
+        release_low_address_mapping(mapping);
         maybe_log_low_address_map_progress("unmap", true);
     }
 }
@@ -2954,9 +7303,13 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkUnmapMemory(
     VkDevice device,
     VkDeviceMemory memory)
 {
+    if (mali_wrapper::IsMemoryRecordingEnabled()) {
+        mali_wrapper::MemoryRecorder::Instance().RecordUnmap(recorded_memory_handle(memory));
+    }
+
     mali_wrapper::ShadowMappingInfo mapping{};
     if (pop_shadow_mapping(device, memory, &mapping)) {
-        finalize_shadow_mapping(mapping);
+        finalize_shadow_mapping(mali_wrapper::make_memory_key(device, memory), mapping);
     }
 
     auto mali_unmap_memory = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::unmap_memory);
@@ -2965,6 +7318,20 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkUnmapMemory(
     }
 }
 
+static void record_memory_ranges(mali_wrapper::RecordedCall call, uint32_t memoryRangeCount,
+                                 const VkMappedMemoryRange* pMemoryRanges)
+{
+    if (!mali_wrapper::IsMemoryRecordingEnabled() || pMemoryRanges == nullptr) {
+        return;
+    }
+
+    auto& recorder = mali_wrapper::MemoryRecorder::Instance();
+    for (uint32_t i = 0; i < memoryRangeCount; ++i) {
+        recorder.RecordRange(call, recorded_memory_handle(pMemoryRanges[i].memory), pMemoryRanges[i].offset,
+                             pMemoryRanges[i].size);
+    }
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkFlushMappedMemoryRanges(
     VkDevice device,
     uint32_t memoryRangeCount,
@@ -2975,6 +7342,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkFlushMappedMemoryRanges(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
+    record_memory_ranges(mali_wrapper::RecordedCall::FLUSH_RANGE, memoryRangeCount, pMemoryRanges);
     sync_shadow_to_real(device, memoryRangeCount, pMemoryRanges);
     return mali_flush(device, memoryRangeCount, pMemoryRanges);
 }
@@ -2989,11 +7357,68 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkInvalidateMappedMemoryRanges(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    const VkResult result = mali_invalidate(device, memoryRangeCount, pMemoryRanges);
-    if (result == VK_SUCCESS) {
-        sync_real_to_shadow(device, memoryRangeCount, pMemoryRanges);
+    const VkResult result = mali_invalidate(device, memoryRangeCount, pMemoryRanges);
+    if (result == VK_SUCCESS) {
+        sync_real_to_shadow(device, memoryRangeCount, pMemoryRanges);
+        record_memory_ranges(mali_wrapper::RecordedCall::INVALIDATE_RANGE, memoryRangeCount, pMemoryRanges);
+    }
+    return result;
+}
+
+// Returns the requested address of a VK_EXT_map_memory_placed map the wrapper
+// has to honour, and strips the placement from the info passed to the driver.
+static void* take_wrapper_placed_map_address(VkDevice device, const VkMemoryMapInfoKHR* info,
+                                             VkMemoryMapInfoKHR* driver_info)
+{
+#ifdef VK_EXT_map_memory_placed
+    if ((info->flags & VK_MEMORY_MAP_PLACED_BIT_EXT) == 0) {
+        return nullptr;
+    }
+
+    auto dispatch = mali_wrapper::get_managed_device_dispatch(device);
+    if (dispatch == nullptr || !dispatch->wrapper_map_memory_placed) {
+        return nullptr;
+    }
+
+    for (auto* current = reinterpret_cast<const VkBaseInStructure*>(info->pNext); current != nullptr;
+         current = current->pNext) {
+        if (current->sType == VK_STRUCTURE_TYPE_MEMORY_MAP_PLACED_INFO_EXT) {
+            // VkMemoryMapPlacedInfoEXT is the only structure VkMemoryMapInfoKHR
+            // extends, so the driver gets no chain at all.
+            driver_info->flags &= ~static_cast<VkMemoryMapFlags>(VK_MEMORY_MAP_PLACED_BIT_EXT);
+            driver_info->pNext = nullptr;
+            return reinterpret_cast<const VkMemoryMapPlacedInfoEXT*>(current)->pPlacedAddress;
+        }
+    }
+#else
+    (void)device;
+    (void)info;
+    (void)driver_info;
+#endif
+    return nullptr;
+}
+
+static bool take_wrapper_unmap_reserve(VkDevice device, const VkMemoryUnmapInfoKHR* info,
+                                       VkMemoryUnmapInfoKHR* driver_info)
+{
+#ifdef VK_EXT_map_memory_placed
+    if ((info->flags & VK_MEMORY_UNMAP_RESERVE_BIT_EXT) == 0) {
+        return false;
+    }
+
+    auto dispatch = mali_wrapper::get_managed_device_dispatch(device);
+    if (dispatch == nullptr || !dispatch->wrapper_map_memory_placed) {
+        return false;
     }
-    return result;
+
+    driver_info->flags &= ~static_cast<VkMemoryUnmapFlagsKHR>(VK_MEMORY_UNMAP_RESERVE_BIT_EXT);
+    return true;
+#else
+    (void)device;
+    (void)info;
+    (void)driver_info;
+    return false;
+#endif
 }
 
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkMapMemory2KHR(
@@ -3005,22 +7430,47 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkMapMemory2KHR(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
+    VkMemoryMapInfoKHR driver_info = *pMemoryMapInfo;
+    void* placed_addr = take_wrapper_placed_map_address(device, pMemoryMapInfo, &driver_info);
+    settle_queued_eager_low_address_alias(device, driver_info.memory, false);
+
     auto mali_map_memory2 = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::map_memory2_khr);
     if (!mali_map_memory2) {
         mali_map_memory2 = reinterpret_cast<PFN_vkMapMemory2KHR>(
             get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::map_memory2));
     }
-    if (!mali_map_memory2) {
+
+    VkResult result = VK_SUCCESS;
+    if (mali_map_memory2) {
+        result = mali_map_memory2(device, &driver_info, ppData);
+    } else if (placed_addr == nullptr) {
         // Some drivers do not expose VK_KHR_map_memory2 even though vkMapMemory works.
         return internal_vkMapMemory(device, pMemoryMapInfo->memory, pMemoryMapInfo->offset,
                                     pMemoryMapInfo->size, pMemoryMapInfo->flags, ppData);
+    } else {
+        auto mali_map_memory = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::map_memory);
+        if (!mali_map_memory) {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        result = mali_map_memory(device, driver_info.memory, driver_info.offset, driver_info.size,
+                                 driver_info.flags, ppData);
     }
 
-    VkResult result = mali_map_memory2(device, pMemoryMapInfo, ppData);
-    if (result == VK_SUCCESS) {
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+    if (placed_addr != nullptr) {
+        result = apply_placed_memory_mapping(device, pMemoryMapInfo->memory, pMemoryMapInfo->offset,
+                                             pMemoryMapInfo->size, placed_addr, ppData);
+    } else {
         maybe_apply_low_address_mapping(device, pMemoryMapInfo->memory, pMemoryMapInfo->offset,
                                         pMemoryMapInfo->size, ppData);
     }
+    if (result == VK_SUCCESS && mali_wrapper::IsMemoryRecordingEnabled()) {
+        mali_wrapper::MemoryRecorder::Instance().RecordMap(recorded_memory_handle(pMemoryMapInfo->memory),
+                                                           pMemoryMapInfo->offset, pMemoryMapInfo->size,
+                                                           pMemoryMapInfo->flags, *ppData);
+    }
     return result;
 }
 
@@ -3028,11 +7478,19 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkUnmapMemory2KHR(
     VkDevice device,
     const VkMemoryUnmapInfoKHR* pMemoryUnmapInfo)
 {
+    VkMemoryUnmapInfoKHR driver_info{};
     if (pMemoryUnmapInfo != nullptr) {
+        if (mali_wrapper::IsMemoryRecordingEnabled()) {
+            mali_wrapper::MemoryRecorder::Instance().RecordUnmap(recorded_memory_handle(pMemoryUnmapInfo->memory));
+        }
+        driver_info = *pMemoryUnmapInfo;
+        const bool reserve = take_wrapper_unmap_reserve(device, pMemoryUnmapInfo, &driver_info);
         mali_wrapper::ShadowMappingInfo mapping{};
         if (pop_shadow_mapping(device, pMemoryUnmapInfo->memory, &mapping)) {
-            finalize_shadow_mapping(mapping);
+            mapping.reserve_on_release = reserve && mapping.placed;
+            finalize_shadow_mapping(mali_wrapper::make_memory_key(device, pMemoryUnmapInfo->memory), mapping);
         }
+        pMemoryUnmapInfo = &driver_info;
     }
 
     auto mali_unmap2 = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::unmap_memory2_khr);
@@ -3053,16 +7511,24 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkQueueSubmit(
     const VkSubmitInfo* pSubmits,
     VkFence fence)
 {
-    VkDevice device = get_queue_parent_device_safe(queue);
+    if (mali_wrapper::IsMemoryRecordingEnabled()) {
+        uint64_t command_buffer_count = 0;
+        for (uint32_t i = 0; pSubmits != nullptr && i < submitCount; ++i) {
+            command_buffer_count += pSubmits[i].commandBufferCount;
+        }
+        mali_wrapper::MemoryRecorder::Instance().RecordSubmit(recorded_queue_handle(queue), submitCount,
+                                                              command_buffer_count);
+    }
+
+    VkDevice device = VK_NULL_HANDLE;
+    const auto* dispatch = get_queue_dispatch(queue, &device);
     if (device != VK_NULL_HANDLE) {
-        sync_all_shadows_for_device(device);
+        sync_shadows_for_submit(device, dispatch, submitCount, pSubmits);
     } else {
         sync_all_shadows();
     }
 
-    auto mali_queue_submit = (device != VK_NULL_HANDLE)
-                                 ? get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::queue_submit)
-                                 : nullptr;
+    auto mali_queue_submit = (dispatch != nullptr) ? dispatch->queue_submit : nullptr;
     if (!mali_queue_submit) {
         const VkDevice fallback_device = mali_wrapper::get_any_managed_device();
         if (fallback_device != VK_NULL_HANDLE) {
@@ -3076,30 +7542,49 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkQueueSubmit(
     return mali_queue_submit(queue, submitCount, pSubmits, fence);
 }
 
+static void record_submit2(VkQueue queue, uint32_t submitCount, const VkSubmitInfo2* pSubmits)
+{
+    if (!mali_wrapper::IsMemoryRecordingEnabled()) {
+        return;
+    }
+
+    uint64_t command_buffer_count = 0;
+    for (uint32_t i = 0; pSubmits != nullptr && i < submitCount; ++i) {
+        command_buffer_count += pSubmits[i].commandBufferInfoCount;
+    }
+    mali_wrapper::MemoryRecorder::Instance().RecordSubmit(recorded_queue_handle(queue), submitCount,
+                                                          command_buffer_count);
+}
+
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkQueueSubmit2(
     VkQueue queue,
     uint32_t submitCount,
     const VkSubmitInfo2* pSubmits,
     VkFence fence)
 {
-    VkDevice device = get_queue_parent_device_safe(queue);
+    record_submit2(queue, submitCount, pSubmits);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const auto* dispatch = get_queue_dispatch(queue, &device);
+    std::shared_ptr<const mali_wrapper::ManagedDeviceDispatch> fallback_dispatch;
     if (device != VK_NULL_HANDLE) {
-        sync_all_shadows_for_device(device);
+        sync_shadows_for_submit(device, dispatch, submitCount, pSubmits);
     } else {
         sync_all_shadows();
-        device = mali_wrapper::get_any_managed_device();
+        fallback_dispatch = mali_wrapper::get_managed_device_dispatch(mali_wrapper::get_any_managed_device());
+        dispatch = fallback_dispatch.get();
     }
 
-    if (device == VK_NULL_HANDLE) {
+    if (dispatch == nullptr) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    auto mali_queue_submit2 = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::queue_submit2);
+    auto mali_queue_submit2 = dispatch->queue_submit2;
     if (mali_queue_submit2) {
         return mali_queue_submit2(queue, submitCount, pSubmits, fence);
     }
 
-    auto mali_queue_submit2_khr = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::queue_submit2_khr);
+    auto mali_queue_submit2_khr = dispatch->queue_submit2_khr;
     if (!mali_queue_submit2_khr) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
@@ -3113,24 +7598,29 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkQueueSubmit2KHR(
     const VkSubmitInfo2KHR* pSubmits,
     VkFence fence)
 {
-    VkDevice device = get_queue_parent_device_safe(queue);
+    record_submit2(queue, submitCount, pSubmits);
+
+    VkDevice device = VK_NULL_HANDLE;
+    const auto* dispatch = get_queue_dispatch(queue, &device);
+    std::shared_ptr<const mali_wrapper::ManagedDeviceDispatch> fallback_dispatch;
     if (device != VK_NULL_HANDLE) {
-        sync_all_shadows_for_device(device);
+        sync_shadows_for_submit(device, dispatch, submitCount, pSubmits);
     } else {
         sync_all_shadows();
-        device = mali_wrapper::get_any_managed_device();
+        fallback_dispatch = mali_wrapper::get_managed_device_dispatch(mali_wrapper::get_any_managed_device());
+        dispatch = fallback_dispatch.get();
     }
 
-    if (device == VK_NULL_HANDLE) {
+    if (dispatch == nullptr) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    auto mali_queue_submit2_khr = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::queue_submit2_khr);
+    auto mali_queue_submit2_khr = dispatch->queue_submit2_khr;
     if (mali_queue_submit2_khr) {
         return mali_queue_submit2_khr(queue, submitCount, pSubmits, fence);
     }
 
-    auto mali_queue_submit2 = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::queue_submit2);
+    auto mali_queue_submit2 = dispatch->queue_submit2;
     if (!mali_queue_submit2) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
@@ -3144,7 +7634,8 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetDeviceQueue(
     uint32_t queueIndex,
     VkQueue* pQueue)
 {
-    auto mali_get_device_queue = get_mali_device_proc<PFN_vkGetDeviceQueue>(device, "vkGetDeviceQueue");
+    auto mali_get_device_queue =
+        get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::get_device_queue);
     if (mali_get_device_queue == nullptr) {
         if (pQueue != nullptr) {
             *pQueue = VK_NULL_HANDLE;
@@ -3168,11 +7659,13 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkGetDeviceQueue2(
         return;
     }
 
-    auto mali_get_device_queue2 = get_mali_device_proc<PFN_vkGetDeviceQueue2>(device, "vkGetDeviceQueue2");
+    auto mali_get_device_queue2 =
+        get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::get_device_queue2);
     if (mali_get_device_queue2 != nullptr) {
         mali_get_device_queue2(device, pQueueInfo, pQueue);
     } else if (pQueueInfo != nullptr && pQueueInfo->flags == 0) {
-        auto mali_get_device_queue = get_mali_device_proc<PFN_vkGetDeviceQueue>(device, "vkGetDeviceQueue");
+        auto mali_get_device_queue =
+            get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::get_device_queue);
         if (mali_get_device_queue == nullptr) {
             *pQueue = VK_NULL_HANDLE;
             return;
@@ -3195,12 +7688,182 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateImage(
     const VkAllocationCallbacks* pAllocator,
     VkImage* pImage)
 {
-    auto mali_create_image = get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::create_image);
+    auto dispatch = mali_wrapper::get_managed_device_dispatch(device);
+    auto mali_create_image = (dispatch != nullptr) ? dispatch->create_image : nullptr;
     if (mali_create_image == nullptr) {
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    return mali_create_image(device, pCreateInfo, pAllocator, pImage);
+    const VkResult result = mali_create_image(device, pCreateInfo, pAllocator, pImage);
+    if (result == VK_SUCCESS && dispatch->reference_tracker != nullptr && pCreateInfo != nullptr &&
+        pImage != nullptr) {
+        dispatch->reference_tracker->NoteImageCreated(*pImage, *pCreateInfo);
+    }
+    return result;
+}
+
+// The wrapper's persistent cache for calls that pass no cache of their own, or
+// nullptr when MALI_WRAPPER_PIPELINE_CACHE is off.
+static std::shared_ptr<mali_wrapper::PersistentPipelineCache> get_wrapper_pipeline_cache(
+    VkDevice device, VkPipelineCache pipelineCache)
+{
+    if (pipelineCache != VK_NULL_HANDLE || !mali_wrapper::PersistentPipelineCache::IsEnabled()) {
+        return nullptr;
+    }
+
+    auto dispatch = mali_wrapper::get_managed_device_dispatch(device);
+    if (dispatch == nullptr || dispatch->pipeline_cache == nullptr ||
+        dispatch->pipeline_cache->Handle() == VK_NULL_HANDLE) {
+        return nullptr;
+    }
+    return dispatch->pipeline_cache;
+}
+
+// Application caches created with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT,
+// which a batch must not use from several threads at once.
+static std::mutex externally_synchronized_pipeline_caches_mutex;
+static std::unordered_set<VkPipelineCache> externally_synchronized_pipeline_caches;
+static std::atomic<size_t> externally_synchronized_pipeline_cache_count{0};
+
+static bool is_externally_synchronized_pipeline_cache(VkPipelineCache pipelineCache)
+{
+    if (pipelineCache == VK_NULL_HANDLE ||
+        externally_synchronized_pipeline_cache_count.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(externally_synchronized_pipeline_caches_mutex);
+    return externally_synchronized_pipeline_caches.count(pipelineCache) != 0;
+}
+
+// A batch is split only when no create info ties pipelines of the batch
+// together: early return has to stop at the first failure in order, and
+// derivatives may name their base by its index in the batch. Application
+// allocators are left to a single thread, and so are flags given through
+// VkPipelineCreateFlags2CreateInfoKHR, which are not parsed here.
+static bool can_split_graphics_pipeline_batch(
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator)
+{
+    if (pCreateInfos == nullptr || pAllocator != nullptr ||
+        !mali_wrapper::PipelineCompilePool::Instance().ShouldSplit(createInfoCount) ||
+        is_externally_synchronized_pipeline_cache(pipelineCache)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < createInfoCount; i++) {
+        const VkGraphicsPipelineCreateInfo& info = pCreateInfos[i];
+        if ((info.flags & VK_PIPELINE_CREATE_EARLY_RETURN_ON_FAILURE_BIT) != 0) {
+            return false;
+        }
+        if ((info.flags & VK_PIPELINE_CREATE_DERIVATIVE_BIT) != 0 && info.basePipelineIndex >= 0) {
+            return false;
+        }
+#ifdef VK_KHR_maintenance5
+        for (auto* next = static_cast<const VkBaseInStructure*>(info.pNext); next != nullptr; next = next->pNext) {
+            if (next->sType == VK_STRUCTURE_TYPE_PIPELINE_CREATE_FLAGS_2_CREATE_INFO_KHR) {
+                return false;
+            }
+        }
+#endif
+    }
+    return true;
+}
+
+// Creates the batch in chunks, one guarded driver call each, spread over the
+// pipeline compile pool. Each chunk writes its own slice of pPipelines, so the
+// order is kept. The result is the first error in batch order, else
+// VK_PIPELINE_COMPILE_REQUIRED if any chunk returned it, else VK_SUCCESS, as a
+// single call would report it.
+static VkResult create_graphics_pipelines_in_chunks(
+    PFN_vkCreateGraphicsPipelines mali_create_graphics_pipelines,
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkGraphicsPipelineCreateInfo* pCreateInfos,
+    VkPipeline* pPipelines)
+{
+    auto& pool = mali_wrapper::PipelineCompilePool::Instance();
+    // Two chunks per thread evens out pipelines that take much longer than others.
+    const uint32_t chunk_target =
+        static_cast<uint32_t>(std::min<size_t>(createInfoCount, (pool.GetWorkerCount() + 1) * 2));
+    const uint32_t chunk_size = (createInfoCount + chunk_target - 1) / chunk_target;
+    const uint32_t chunk_count = (createInfoCount + chunk_size - 1) / chunk_size;
+
+    std::vector<VkResult> results(chunk_count, VK_SUCCESS);
+    pool.Run(chunk_count, [&](size_t chunk) {
+        const uint32_t first = static_cast<uint32_t>(chunk) * chunk_size;
+        const uint32_t count = std::min(chunk_size, createInfoCount - first);
+        bool trapped_signal = false;
+        results[chunk] = mali_wrapper::call_vkCreateGraphicsPipelines_with_signal_guard(
+            mali_create_graphics_pipelines,
+            device,
+            pipelineCache,
+            count,
+            pCreateInfos + first,
+            nullptr,
+            pPipelines + first,
+            &trapped_signal);
+        if (trapped_signal) {
+            std::fill(pPipelines + first, pPipelines + first + count, VK_NULL_HANDLE);
+        }
+    });
+
+    VkResult result = VK_SUCCESS;
+    for (VkResult chunk_result : results) {
+        if (chunk_result < VK_SUCCESS) {
+            return chunk_result;
+        }
+        if (chunk_result == VK_PIPELINE_COMPILE_REQUIRED) {
+            result = VK_PIPELINE_COMPILE_REQUIRED;
+        }
+    }
+    return result;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreatePipelineCache(
+    VkDevice device,
+    const VkPipelineCacheCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipelineCache* pPipelineCache)
+{
+    auto mali_create_pipeline_cache =
+        get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::create_pipeline_cache);
+    if (mali_create_pipeline_cache == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VkResult result = mali_create_pipeline_cache(device, pCreateInfo, pAllocator, pPipelineCache);
+    if (result == VK_SUCCESS && pCreateInfo != nullptr &&
+        (pCreateInfo->flags & VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT) != 0) {
+        std::lock_guard<std::mutex> lock(externally_synchronized_pipeline_caches_mutex);
+        if (externally_synchronized_pipeline_caches.insert(*pPipelineCache).second) {
+            externally_synchronized_pipeline_cache_count.fetch_add(1, std::memory_order_release);
+        }
+    }
+    return result;
+}
+
+static VKAPI_ATTR void VKAPI_CALL internal_vkDestroyPipelineCache(
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    const VkAllocationCallbacks* pAllocator)
+{
+    auto mali_destroy_pipeline_cache =
+        get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::destroy_pipeline_cache);
+    if (mali_destroy_pipeline_cache == nullptr) {
+        return;
+    }
+
+    if (is_externally_synchronized_pipeline_cache(pipelineCache)) {
+        std::lock_guard<std::mutex> lock(externally_synchronized_pipeline_caches_mutex);
+        if (externally_synchronized_pipeline_caches.erase(pipelineCache) != 0) {
+            externally_synchronized_pipeline_cache_count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+    mali_destroy_pipeline_cache(device, pipelineCache, pAllocator);
 }
 
 static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateGraphicsPipelines(
@@ -3217,16 +7880,58 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateGraphicsPipelines(
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    bool trapped_signal = false;
-    return mali_wrapper::call_vkCreateGraphicsPipelines_with_signal_guard(
-        mali_create_graphics_pipelines,
-        device,
-        pipelineCache,
-        createInfoCount,
-        pCreateInfos,
-        pAllocator,
-        pPipelines,
-        &trapped_signal);
+    auto wrapper_cache = get_wrapper_pipeline_cache(device, pipelineCache);
+    if (wrapper_cache != nullptr) {
+        pipelineCache = wrapper_cache->Handle();
+    }
+
+    VkResult result;
+    if (can_split_graphics_pipeline_batch(pipelineCache, createInfoCount, pCreateInfos, pAllocator)) {
+        result = create_graphics_pipelines_in_chunks(
+            mali_create_graphics_pipelines, device, pipelineCache, createInfoCount, pCreateInfos, pPipelines);
+    } else {
+        bool trapped_signal = false;
+        result = mali_wrapper::call_vkCreateGraphicsPipelines_with_signal_guard(
+            mali_create_graphics_pipelines,
+            device,
+            pipelineCache,
+            createInfoCount,
+            pCreateInfos,
+            pAllocator,
+            pPipelines,
+            &trapped_signal);
+    }
+    if (wrapper_cache != nullptr && result >= VK_SUCCESS) {
+        wrapper_cache->NoteCreated(createInfoCount);
+    }
+    return result;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateComputePipelines(
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    uint32_t createInfoCount,
+    const VkComputePipelineCreateInfo* pCreateInfos,
+    const VkAllocationCallbacks* pAllocator,
+    VkPipeline* pPipelines)
+{
+    auto mali_create_compute_pipelines =
+        get_mali_device_proc(device, &mali_wrapper::ManagedDeviceDispatch::create_compute_pipelines);
+    if (mali_create_compute_pipelines == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    auto wrapper_cache = get_wrapper_pipeline_cache(device, pipelineCache);
+    if (wrapper_cache != nullptr) {
+        pipelineCache = wrapper_cache->Handle();
+    }
+
+    VkResult result = mali_create_compute_pipelines(
+        device, pipelineCache, createInfoCount, pCreateInfos, pAllocator, pPipelines);
+    if (wrapper_cache != nullptr && result >= VK_SUCCESS) {
+        wrapper_cache->NoteCreated(createInfoCount);
+    }
+    return result;
 }
 
 static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL internal_vkGetDeviceProcAddr(VkDevice device, const char* pName) {
@@ -3236,60 +7941,66 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL internal_vkGetDeviceProcAddr(VkD
         return nullptr;
     }
 
-    if (strcmp(pName, "vkDestroyDevice") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkDestroyDevice);
-    }
+    // Hooks that only serve the low-address engine; skipped entirely on
+    // devices created with direct memory dispatch.
+    static constexpr std::array<std::string_view, 13> direct_device_procs = {{
+        "vkAllocateMemory",
+        "vkFlushMappedMemoryRanges",
+        "vkFreeMemory",
+        "vkInvalidateMappedMemoryRanges",
+        "vkMapMemory",
+        "vkMapMemory2",
+        "vkMapMemory2KHR",
+        "vkQueueSubmit",
+        "vkQueueSubmit2",
+        "vkQueueSubmit2KHR",
+        "vkUnmapMemory",
+        "vkUnmapMemory2",
+        "vkUnmapMemory2KHR",
+    }};
+    static_assert(IsProcTableSorted(direct_device_procs), "direct_device_procs must stay sorted");
 
-    if (strcmp(pName, "vkAllocateMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkAllocateMemory);
-    }
-    if (strcmp(pName, "vkCreateImage") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkCreateImage);
-    }
-    if (strcmp(pName, "vkCreateGraphicsPipelines") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkCreateGraphicsPipelines);
-    }
-    if (strcmp(pName, "vkFreeMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkFreeMemory);
-    }
-    if (strcmp(pName, "vkMapMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkMapMemory);
-    }
-    if (strcmp(pName, "vkUnmapMemory") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkUnmapMemory);
-    }
-    if (strcmp(pName, "vkFlushMappedMemoryRanges") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkFlushMappedMemoryRanges);
-    }
-    if (strcmp(pName, "vkInvalidateMappedMemoryRanges") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkInvalidateMappedMemoryRanges);
-    }
-    if (strcmp(pName, "vkQueueSubmit") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkQueueSubmit);
-    }
-    if (strcmp(pName, "vkGetDeviceQueue") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetDeviceQueue);
-    }
-    if (strcmp(pName, "vkGetDeviceQueue2") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetDeviceQueue2);
-    }
-    if (strcmp(pName, "vkQueueSubmit2") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkQueueSubmit2);
-    }
-    if (strcmp(pName, "vkQueueSubmit2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkQueueSubmit2KHR);
-    }
-    if (strcmp(pName, "vkMapMemory2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkMapMemory2KHR);
-    }
-    if (strcmp(pName, "vkMapMemory2") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkMapMemory2KHR);
-    }
-    if (strcmp(pName, "vkUnmapMemory2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkUnmapMemory2KHR);
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch != nullptr && dispatch->direct_memory_dispatch && IsInProcTable(direct_device_procs, pName)) {
+        if (auto func = dispatch->resolve_known_proc(pName)) {
+            return func;
+        }
     }
-    if (strcmp(pName, "vkUnmapMemory2") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkUnmapMemory2KHR);
+
+    static constexpr std::array<ProcTableEntry<ProcTableGetter>, 22> wrapper_device_procs = {{
+        { "vkAllocateMemory", ProcTableFunction<internal_vkAllocateMemory> },
+        { "vkCreateComputePipelines", ProcTableFunction<internal_vkCreateComputePipelines> },
+        { "vkCreateGraphicsPipelines", ProcTableFunction<internal_vkCreateGraphicsPipelines> },
+        { "vkCreateImage", ProcTableFunction<internal_vkCreateImage> },
+        { "vkCreatePipelineCache", ProcTableFunction<internal_vkCreatePipelineCache> },
+        { "vkDestroyDevice", ProcTableFunction<internal_vkDestroyDevice> },
+        { "vkDestroyPipelineCache", ProcTableFunction<internal_vkDestroyPipelineCache> },
+        { "vkFlushMappedMemoryRanges", ProcTableFunction<internal_vkFlushMappedMemoryRanges> },
+        { "vkFreeMemory", ProcTableFunction<internal_vkFreeMemory> },
+        { "vkGetDeviceProcAddr", ProcTableFunction<internal_vkGetDeviceProcAddr> },
+        { "vkGetDeviceQueue", ProcTableFunction<internal_vkGetDeviceQueue> },
+        { "vkGetDeviceQueue2", ProcTableFunction<internal_vkGetDeviceQueue2> },
+        { "vkInvalidateMappedMemoryRanges", ProcTableFunction<internal_vkInvalidateMappedMemoryRanges> },
+        { "vkMapMemory", ProcTableFunction<internal_vkMapMemory> },
+        { "vkMapMemory2", ProcTableFunction<internal_vkMapMemory2KHR> },
+        { "vkMapMemory2KHR", ProcTableFunction<internal_vkMapMemory2KHR> },
+        { "vkQueueSubmit", ProcTableFunction<internal_vkQueueSubmit> },
+        { "vkQueueSubmit2", ProcTableFunction<internal_vkQueueSubmit2> },
+        { "vkQueueSubmit2KHR", ProcTableFunction<internal_vkQueueSubmit2KHR> },
+        { "vkUnmapMemory", ProcTableFunction<internal_vkUnmapMemory> },
+        { "vkUnmapMemory2", ProcTableFunction<internal_vkUnmapMemory2KHR> },
+        { "vkUnmapMemory2KHR", ProcTableFunction<internal_vkUnmapMemory2KHR> },
+    }};
+    static_assert(IsProcTableSorted(wrapper_device_procs), "wrapper_device_procs must stay sorted");
+
+    if (const auto* entry = FindProcTableEntry(wrapper_device_procs, pName)) {
+        return entry->value();
+    }
+
+    if (dispatch != nullptr && dispatch->reference_tracker != nullptr) {
+        if (auto func = dispatch->reference_tracker->GetHook(pName)) {
+            return func;
+        }
     }
 
     if (GetWSIManager().is_wsi_function(pName)) {
@@ -3301,17 +8012,15 @@ static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL internal_vkGetDeviceProcAddr(VkD
         }
     }
 
-    if (strcmp(pName, "vkGetDeviceProcAddr") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(internal_vkGetDeviceProcAddr);
-    }
-
     if (strstr(pName, "RayTracing") || strstr(pName, "MeshTask")) {
         return nullptr;
     }
 
-    auto dispatch = get_managed_device_dispatch(device);
     if (dispatch != nullptr) {
         if (auto func = dispatch->resolve_proc(pName)) {
+            if (dispatch->reference_tracker != nullptr) {
+                dispatch->reference_tracker->NoteDriverProc(pName, func);
+            }
             return func;
         }
     }
@@ -3390,9 +8099,19 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateDevice(
         extension_list_ptr = std::make_unique<util::extension_list>(extension_allocator);
         auto &extensions = *extension_list_ptr;
 
-        if (pCreateInfo->enabledExtensionCount > 0 && pCreateInfo->ppEnabledExtensionNames != nullptr)
+        // Filter what the application asked for before the WSI adds its own extensions: the WSI
+        // may enable VK_EXT_external_memory_host for its SHM segments even when the application
+        // never gets to see it.
+        for (uint32_t i = 0; i < pCreateInfo->enabledExtensionCount && pCreateInfo->ppEnabledExtensionNames != nullptr;
+             ++i)
         {
-            extensions.add(pCreateInfo->ppEnabledExtensionNames, pCreateInfo->enabledExtensionCount);
+            const char *name = pCreateInfo->ppEnabledExtensionNames[i];
+            if (is_filtered_device_extension(name))
+            {
+                LOG_WARN(std::string("Removed filtered device extension ") + name + " before vkCreateDevice");
+                continue;
+            }
+            extensions.add(name);
         }
 
         VkResult extension_result = wsi::add_device_extensions_required_by_layer(
@@ -3440,7 +8159,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateDevice(
     }
 
     std::vector<const char*> filtered_requested_extensions;
-    if (should_filter_external_memory_host_extension() &&
+    if (should_filter_external_memory_host_extension() && enabled_extensions.empty() &&
         extension_name_ptr != nullptr && extension_name_count > 0) {
         filtered_requested_extensions.assign(extension_name_ptr, extension_name_ptr + extension_name_count);
         const size_t removed_count = filter_device_extension_vector(&filtered_requested_extensions);
@@ -3452,6 +8171,10 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateDevice(
         }
     }
 
+    std::vector<const char*> wrapper_stripped_extensions;
+    const bool wrapper_map_memory_placed = strip_wrapper_device_extensions(
+        physicalDevice, &extension_name_ptr, &extension_name_count, &wrapper_stripped_extensions);
+
     VkDeviceCreateInfo modified_create_info = *pCreateInfo;
     modified_create_info.enabledExtensionCount = static_cast<uint32_t>(extension_name_count);
     modified_create_info.ppEnabledExtensionNames = extension_name_ptr;
@@ -3485,7 +8208,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL internal_vkCreateDevice(
     if (result == VK_SUCCESS) {
         LOG_INFO("Device created successfully through Mali driver");
 
-        remember_managed_device(*pDevice, mali_instance);
+        remember_managed_device(*pDevice, mali_instance, physicalDevice, wrapper_map_memory_placed);
 
         VkInstance target_mali_instance = mali_instance;
         {
@@ -3548,10 +8271,17 @@ static VKAPI_ATTR void VKAPI_CALL internal_vkDestroyDevice(
 
     GetWSIManager().release_device(device);
 
+    if (device_dispatch != nullptr && device_dispatch->pipeline_cache != nullptr) {
+        device_dispatch->pipeline_cache->Destroy();
+    }
+    if (device_dispatch != nullptr && device_dispatch->reference_tracker != nullptr) {
+        device_dispatch->reference_tracker->Destroy();
+    }
+
     PFN_vkDestroyDevice mali_destroy = nullptr;
 
     if (device_dispatch != nullptr) {
-        mali_destroy = reinterpret_cast<PFN_vkDestroyDevice>(device_dispatch->resolve_proc("vkDestroyDevice"));
+        mali_destroy = device_dispatch->destroy_device;
     }
 
     auto mali_proc_addr = LibraryLoader::Instance().GetMaliGetInstanceProcAddr();
@@ -3605,6 +8335,10 @@ static VKAPI_ATTR VkResult VKAPI_CALL mali_driver_create_device(
         }
     }
 
+    std::vector<const char*> wrapper_stripped_extensions;
+    const bool wrapper_map_memory_placed = strip_wrapper_device_extensions(
+        physicalDevice, &extension_name_ptr, &extension_name_count, &wrapper_stripped_extensions);
+
     VkDeviceCreateInfo modified_create_info = *pCreateInfo;
     modified_create_info.enabledExtensionCount = static_cast<uint32_t>(extension_name_count);
     modified_create_info.ppEnabledExtensionNames = extension_name_ptr;
@@ -3665,7 +8399,7 @@ static VKAPI_ATTR VkResult VKAPI_CALL mali_driver_create_device(
             }
         }
 
-        remember_managed_device(*pDevice, mali_instance);
+        remember_managed_device(*pDevice, mali_instance, physicalDevice, wrapper_map_memory_placed);
 
         VkResult wsi_result = GetWSIManager().init_device(target_mali_instance, physicalDevice, *pDevice,
                                                          modified_create_info.ppEnabledExtensionNames,
@@ -3681,6 +8415,160 @@ static VKAPI_ATTR VkResult VKAPI_CALL mali_driver_create_device(
     return result;
 }
 
+#if MALI_WRAPPER_HARNESS
+namespace mali_wrapper {
+namespace harness {
+
+bool RegisterDevice(VkDevice device)
+{
+    remember_managed_device(device, VK_NULL_HANDLE, VK_NULL_HANDLE, false);
+    auto dispatch = get_managed_device_dispatch(device);
+    return dispatch != nullptr && dispatch->mali_fd_cache != nullptr &&
+           dispatch->mali_fd_cache->alias_support.load(std::memory_order_relaxed) ==
+               LowAddressAliasSupport::SUPPORTED;
+}
+
+void UnregisterDevice(VkDevice device)
+{
+    remove_tracking_for_device(device);
+    forget_managed_device(device);
+}
+
+void SetAliasEnabled(VkDevice device, bool enabled)
+{
+    auto dispatch = get_managed_device_dispatch(device);
+    if (dispatch == nullptr || dispatch->mali_fd_cache == nullptr) {
+        return;
+    }
+
+    if (enabled) {
+        probe_device_low_address_alias_support(dispatch->mali_fd_cache.get());
+    } else {
+        dispatch->mali_fd_cache->alias_support.store(LowAddressAliasSupport::UNSUPPORTED,
+                                                     std::memory_order_relaxed);
+    }
+}
+
+void TrackAllocation(VkDevice device, VkDeviceMemory memory, VkDeviceSize size, VkMemoryPropertyFlags flags)
+{
+    const DeviceMemoryKey key = make_memory_key(device, memory);
+    TrackedAllocationShard& shard = tracked_allocation_shard_for(key);
+    auto lock = lock_tracked_allocation_shard(shard);
+    TrackedAllocation allocation{};
+    allocation.size = size;
+    allocation.property_flags = flags;
+    shard.allocations[key] = allocation;
+}
+
+void FreeMemory(VkDevice device, VkDeviceMemory memory)
+{
+    internal_vkFreeMemory(device, memory, nullptr);
+}
+
+void* MapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size, void* real_ptr)
+{
+    void* data = real_ptr;
+    maybe_apply_low_address_mapping(device, memory, offset, size, &data);
+    return data;
+}
+
+void UnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+    internal_vkUnmapMemory(device, memory);
+}
+
+void FlushRanges(VkDevice device, uint32_t range_count, const VkMappedMemoryRange* ranges)
+{
+    sync_shadow_to_real(device, range_count, ranges);
+}
+
+void InvalidateRanges(VkDevice device, uint32_t range_count, const VkMappedMemoryRange* ranges)
+{
+    sync_real_to_shadow(device, range_count, ranges);
+}
+
+void SyncForSubmit(VkDevice device)
+{
+    sync_all_shadows_for_device(device);
+}
+
+void RegisterQueue(VkQueue queue, VkDevice device)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(harness_queue_mutex);
+        harness_queue_devices[queue] = device;
+    }
+    // As device creation does, so no thread keeps a stale queue entry.
+    managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void UnregisterQueue(VkQueue queue)
+{
+    {
+        std::unique_lock<std::shared_mutex> lock(harness_queue_mutex);
+        harness_queue_devices.erase(queue);
+    }
+    managed_device_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+PFN_vkQueueSubmit LookupQueueSubmit(VkQueue queue, VkDevice* out_device)
+{
+    const ManagedDeviceDispatch* dispatch = get_queue_dispatch(queue, out_device);
+    return dispatch != nullptr ? dispatch->queue_submit : nullptr;
+}
+
+PFN_vkQueueSubmit LookupQueueSubmitUncached(VkQueue queue, VkDevice* out_device)
+{
+    const VkDevice device = get_queue_parent_device_safe(queue);
+    *out_device = device;
+    return device != VK_NULL_HANDLE ? get_mali_device_proc(device, &ManagedDeviceDispatch::queue_submit) : nullptr;
+}
+
+void* AllocateShadow(size_t size, size_t* out_size)
+{
+    const ShadowAllocationResult shadow = allocate_low_address_shadow(size);
+    if (out_size != nullptr) {
+        *out_size = shadow.size;
+    }
+    return shadow.ptr;
+}
+
+void ReleaseShadow(void* ptr, size_t size)
+{
+    ShadowMappingInfo mapping{};
+    mapping.mode = LowAddressMapMode::SHADOW;
+    mapping.unmap_ptr = ptr;
+    mapping.unmap_size = size;
+    release_low_address_mapping(mapping);
+}
+
+void* CreateAlias(VkDevice device, const void* real_ptr, size_t size, size_t* out_unmap_size)
+{
+    auto dispatch = get_managed_device_dispatch(device);
+    ShadowMappingInfo mapping{};
+    if (!try_create_low_address_alias(real_ptr, size, nullptr,
+                                      dispatch != nullptr ? dispatch->mali_fd_cache.get() : nullptr, &mapping)) {
+        return nullptr;
+    }
+    if (out_unmap_size != nullptr) {
+        *out_unmap_size = mapping.unmap_size;
+    }
+    return mapping.unmap_ptr;
+}
+
+void ReleaseAlias(void* ptr, size_t unmap_size)
+{
+    ShadowMappingInfo mapping{};
+    mapping.mode = LowAddressMapMode::ALIAS;
+    mapping.unmap_ptr = ptr;
+    mapping.unmap_size = unmap_size;
+    release_low_address_mapping(mapping);
+}
+
+} // namespace harness
+} // namespace mali_wrapper
+#endif
+
 extern "C" {
 
 VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vk_icdGetInstanceProcAddr(VkInstance instance, const char* pName) {
@@ -11,6 +11,10 @@ void ShutdownWrapper();
 
 WSIManager& GetWSIManager();
 
+// Called after every vkQueuePresentKHR; ends the frame for the low-address
+// per-frame copy stats.
+void NotifyQueuePresented(VkQueue queue);
+
 
 } // namespace mali_wrapper
 
@@ -0,0 +1,309 @@
+#include "memory_recorder.hpp"
+#include "../utils/logging.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+// Records buffered before they are written; 192 KiB.
+constexpr size_t kPendingRecordLimit = 4096;
+constexpr uint64_t kWholeSize = ~0ULL;
+constexpr uint32_t kFingerprintFlag = 1U << 0;
+
+struct RecordedMapping {
+    const uint8_t* data = nullptr;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+std::string recording_path;
+bool recording_fingerprints = false;
+
+std::mutex recorder_mutex;
+std::vector<MemoryRecord> pending_records;
+std::unordered_map<uint64_t, uint64_t> allocation_sizes;
+std::unordered_map<uint64_t, RecordedMapping> recorded_mappings;
+int recording_fd = -1;
+uint64_t recording_start_ns = 0;
+uint64_t records_written = 0;
+
+std::atomic<uint16_t> next_thread_number{0};
+thread_local int thread_number = -1;
+
+bool read_recording_env() {
+    const char* value = std::getenv("MALI_WRAPPER_RECORD_MEMORY");
+    if (value == nullptr || value[0] == '\0' || std::strcmp(value, "0") == 0) {
+        return false;
+    }
+
+    if (std::strcmp(value, "1") == 0) {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/tmp/mali-wrapper-memory-%d.mwrec", static_cast<int>(getpid()));
+        recording_path = path;
+    } else {
+        recording_path = value;
+    }
+
+    const char* fingerprints = std::getenv("MALI_WRAPPER_RECORD_MEMORY_FINGERPRINTS");
+    recording_fingerprints = fingerprints != nullptr && fingerprints[0] == '1';
+    return true;
+}
+
+uint64_t now_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint16_t current_thread_number() {
+    if (thread_number < 0) {
+        thread_number = next_thread_number.fetch_add(1, std::memory_order_relaxed);
+    }
+    return static_cast<uint16_t>(thread_number);
+}
+
+// FNV-1a over 64-bit words, then the tail bytes; a word at a time keeps
+// fingerprinting multi-megabyte flushes cheap enough to leave on.
+uint64_t fingerprint_bytes(const uint8_t* data, uint64_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ULL;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void write_pending_locked() {
+    if (pending_records.empty()) {
+        return;
+    }
+    if (recording_fd >= 0 &&
+        !write_all(recording_fd, pending_records.data(), pending_records.size() * sizeof(MemoryRecord))) {
+        LOG_WARN("Failed to write memory recording to " + recording_path + ": " + std::strerror(errno) +
+                 "; recording stopped");
+        close(recording_fd);
+        recording_fd = -1;
+    }
+    if (recording_fd >= 0) {
+        records_written += pending_records.size();
+    }
+    pending_records.clear();
+}
+
+void append_record_locked(const MemoryRecord& record) {
+    if (recording_fd < 0) {
+        return;
+    }
+    pending_records.push_back(record);
+    if (pending_records.size() >= kPendingRecordLimit) {
+        write_pending_locked();
+    }
+}
+
+MemoryRecord make_record(RecordedCall call, uint64_t object, uint64_t offset, uint64_t size, uint32_t arg) {
+    MemoryRecord record{};
+    record.time_ns = now_ns() - recording_start_ns;
+    record.object = object;
+    record.offset = offset;
+    record.size = size;
+    record.arg = arg;
+    record.call = call;
+    record.thread = current_thread_number();
+    return record;
+}
+
+// Resolves [offset, offset + size) of a mapped allocation to the bytes the
+// application sees. Returns false when the range is not inside the mapping.
+bool resolve_mapped_range_locked(uint64_t memory, uint64_t offset, uint64_t size,
+                                 const uint8_t** data, uint64_t* length) {
+    auto mapping_it = recorded_mappings.find(memory);
+    if (mapping_it == recorded_mappings.end() || mapping_it->second.data == nullptr) {
+        return false;
+    }
+
+    const RecordedMapping& mapping = mapping_it->second;
+    if (offset < mapping.offset || offset - mapping.offset > mapping.size) {
+        return false;
+    }
+    const uint64_t available = mapping.size - (offset - mapping.offset);
+    *data = mapping.data + (offset - mapping.offset);
+    *length = (size == kWholeSize || size > available) ? available : size;
+    return true;
+}
+
+} // namespace
+
+namespace memory_recording_detail {
+bool enabled = read_recording_env();
+}
+
+MemoryRecorder& MemoryRecorder::Instance() {
+    static MemoryRecorder instance;
+    return instance;
+}
+
+MemoryRecorder::MemoryRecorder() {
+    if (!memory_recording_detail::enabled) {
+        return;
+    }
+
+    recording_start_ns = now_ns();
+    recording_fd = open(recording_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (recording_fd < 0) {
+        LOG_WARN("Failed to open memory recording " + recording_path + ": " + std::strerror(errno));
+        return;
+    }
+
+    MemoryRecordingHeader header{};
+    std::memcpy(header.magic, kMemoryRecordingMagic, sizeof(header.magic));
+    header.version = kMemoryRecordingVersion;
+    header.record_size = sizeof(MemoryRecord);
+    header.pid = static_cast<uint32_t>(getpid());
+    header.flags = recording_fingerprints ? kFingerprintFlag : 0;
+    if (!write_all(recording_fd, &header, sizeof(header))) {
+        close(recording_fd);
+        recording_fd = -1;
+        return;
+    }
+    pending_records.reserve(kPendingRecordLimit);
+    LOG_INFO("Recording memory calls to " + recording_path +
+             (recording_fingerprints ? " with fingerprints" : ""));
+}
+
+MemoryRecorder::~MemoryRecorder() {
+    // Records made after ShutdownWrapper(); the logger may already be gone.
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    write_pending_locked();
+    if (recording_fd >= 0) {
+        close(recording_fd);
+        recording_fd = -1;
+    }
+}
+
+void MemoryRecorder::RecordAllocate(uint64_t memory, uint64_t size, uint32_t memory_type_index) {
+    const MemoryRecord record = make_record(RecordedCall::ALLOCATE_MEMORY, memory, 0, size, memory_type_index);
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    allocation_sizes[memory] = size;
+    append_record_locked(record);
+}
+
+void MemoryRecorder::RecordFree(uint64_t memory) {
+    const MemoryRecord record = make_record(RecordedCall::FREE_MEMORY, memory, 0, 0, 0);
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    allocation_sizes.erase(memory);
+    recorded_mappings.erase(memory);
+    append_record_locked(record);
+}
+
+void MemoryRecorder::RecordMap(uint64_t memory, uint64_t offset, uint64_t size, uint32_t flags, const void* data) {
+    const MemoryRecord record = make_record(RecordedCall::MAP_MEMORY, memory, offset, size, flags);
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    RecordedMapping mapping;
+    mapping.data = static_cast<const uint8_t*>(data);
+    mapping.offset = offset;
+    mapping.size = size;
+    if (size == kWholeSize) {
+        auto size_it = allocation_sizes.find(memory);
+        mapping.size = (size_it != allocation_sizes.end() && size_it->second > offset) ? size_it->second - offset : 0;
+    }
+    recorded_mappings[memory] = mapping;
+    append_record_locked(record);
+}
+
+void MemoryRecorder::RecordUnmap(uint64_t memory) {
+    MemoryRecord record = make_record(RecordedCall::UNMAP_MEMORY, memory, 0, 0, 0);
+    const uint8_t* data = nullptr;
+    uint64_t length = 0;
+    bool resolved = false;
+    {
+        std::lock_guard<std::mutex> lock(recorder_mutex);
+        auto mapping_it = recorded_mappings.find(memory);
+        if (mapping_it != recorded_mappings.end()) {
+            record.offset = mapping_it->second.offset;
+            record.size = mapping_it->second.size;
+            resolved = recording_fingerprints &&
+                       resolve_mapped_range_locked(memory, record.offset, kWholeSize, &data, &length);
+        }
+    }
+
+    // Hashing outside the lock: the application may not touch the mapping
+    // while it unmaps it.
+    if (resolved) {
+        record.fingerprint = fingerprint_bytes(data, length);
+    }
+
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    recorded_mappings.erase(memory);
+    append_record_locked(record);
+}
+
+void MemoryRecorder::RecordRange(RecordedCall call, uint64_t memory, uint64_t offset, uint64_t size) {
+    MemoryRecord record = make_record(call, memory, offset, size, 0);
+    const uint8_t* data = nullptr;
+    uint64_t length = 0;
+    bool resolved = false;
+    if (recording_fingerprints && call == RecordedCall::FLUSH_RANGE) {
+        std::lock_guard<std::mutex> lock(recorder_mutex);
+        resolved = resolve_mapped_range_locked(memory, offset, size, &data, &length);
+    }
+    if (resolved) {
+        record.fingerprint = fingerprint_bytes(data, length);
+    }
+
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    append_record_locked(record);
+}
+
+void MemoryRecorder::RecordSubmit(uint64_t queue, uint32_t submit_count, uint64_t command_buffer_count) {
+    const MemoryRecord record = make_record(RecordedCall::QUEUE_SUBMIT, queue, 0, command_buffer_count, submit_count);
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    append_record_locked(record);
+}
+
+void MemoryRecorder::Flush(const char* reason) {
+    if (!memory_recording_detail::enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(recorder_mutex);
+    write_pending_locked();
+    if (recording_fd >= 0) {
+        LOG_INFO("Memory recording " + recording_path + " holds " + std::to_string(records_written) + " calls (" +
+                 std::string(reason != nullptr ? reason : "flush") + ")");
+    }
+}
+
+} // namespace mali_wrapper
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mali_wrapper {
+
+// Calls recorded by MemoryRecorder, in the order they go through the wrapper.
+enum class RecordedCall : uint8_t {
+    ALLOCATE_MEMORY = 0,
+    FREE_MEMORY,
+    MAP_MEMORY,
+    UNMAP_MEMORY,
+    FLUSH_RANGE,
+    INVALIDATE_RANGE,
+    QUEUE_SUBMIT,
+    COUNT
+};
+
+// File layout, little-endian as written by the device: one header, then one
+// fixed-size record per call. Flush and invalidate write one record per range.
+constexpr char kMemoryRecordingMagic[8] = { 'M', 'W', 'M', 'E', 'M', 'R', 'E', 'C' };
+constexpr uint32_t kMemoryRecordingVersion = 1;
+
+struct MemoryRecordingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t pid;
+    // Bit 0: FLUSH_RANGE and UNMAP_MEMORY records carry fingerprints.
+    uint32_t flags;
+};
+
+struct MemoryRecord {
+    // CLOCK_MONOTONIC, relative to the start of the recording.
+    uint64_t time_ns;
+    // VkDeviceMemory handle, or the VkQueue for QUEUE_SUBMIT.
+    uint64_t object;
+    // Map, flush and invalidate offset as passed by the application.
+    uint64_t offset;
+    // allocationSize, map or range size (VK_WHOLE_SIZE is kept as is), or the
+    // number of command buffers for QUEUE_SUBMIT.
+    uint64_t size;
+    // FNV-1a of the bytes the application sees in the range when fingerprints
+    // are on, else 0.
+    uint64_t fingerprint;
+    // memoryTypeIndex, map flags or submitCount.
+    uint32_t arg;
+    RecordedCall call;
+    uint8_t reserved;
+    // Small per-recording thread number, in order of first appearance.
+    uint16_t thread;
+};
+static_assert(sizeof(MemoryRecordingHeader) == 24, "memory recording header layout is part of the file format");
+static_assert(sizeof(MemoryRecord) == 48, "memory record layout is part of the file format");
+
+namespace memory_recording_detail {
+extern bool enabled;
+}
+
+// MALI_WRAPPER_RECORD_MEMORY=1 (or =<path>) records the allocate, map, flush,
+// invalidate, unmap, free and submit calls that reach the wrapper, so a
+// workload's memory traffic can be replayed against the low-address engine
+// without the application. MALI_WRAPPER_RECORD_MEMORY_FINGERPRINTS=1 also
+// hashes flushed and unmapped bytes. Default output is
+// /tmp/mali-wrapper-memory-<pid>.mwrec.
+inline bool IsMemoryRecordingEnabled()
+{
+    return memory_recording_detail::enabled;
+}
+
+class MemoryRecorder {
+public:
+    static MemoryRecorder& Instance();
+
+    void RecordAllocate(uint64_t memory, uint64_t size, uint32_t memory_type_index);
+    void RecordFree(uint64_t memory);
+    // data is the pointer returned to the application, used for fingerprints.
+    void RecordMap(uint64_t memory, uint64_t offset, uint64_t size, uint32_t flags, const void* data);
+    // Called before the memory is unmapped, while its bytes are still readable.
+    void RecordUnmap(uint64_t memory);
+    // call is FLUSH_RANGE or INVALIDATE_RANGE.
+    void RecordRange(RecordedCall call, uint64_t memory, uint64_t offset, uint64_t size);
+    void RecordSubmit(uint64_t queue, uint32_t submit_count, uint64_t command_buffer_count);
+
+    // Writes buffered records to the file.
+    void Flush(const char* reason);
+
+private:
+    MemoryRecorder();
+    ~MemoryRecorder();
+    MemoryRecorder(const MemoryRecorder&) = delete;
+    MemoryRecorder& operator=(const MemoryRecorder&) = delete;
+};
+
+} // namespace mali_wrapper
@@ -0,0 +1,363 @@
+#include "metrics_page.hpp"
+#include "../utils/logging.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+constexpr uint64_t kLowAddressRefreshIntervalNs = 100ULL * 1000ULL * 1000ULL;
+
+uint64_t monotonic_now_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+bool is_metrics_page_requested() {
+    const char* value = std::getenv("MALI_WRAPPER_METRICS_PAGE");
+    if (value == nullptr || value[0] == '\0') {
+        return false;
+    }
+    return std::strcmp(value, "0") != 0 && strcasecmp(value, "false") != 0 && strcasecmp(value, "off") != 0;
+}
+
+} // namespace
+
+MetricsPage& MetricsPage::Instance() {
+    static MetricsPage instance;
+    return instance;
+}
+
+MetricsPage::MetricsPage() : enabled_(is_metrics_page_requested()) {
+    std::snprintf(path_, sizeof(path_), "/dev/shm/mali-wrapper-%d", static_cast<int>(getpid()));
+}
+
+MetricsPage::~MetricsPage() {
+    Shutdown();
+}
+
+bool MetricsPage::EnsurePageLocked() {
+    if (page_ != nullptr) {
+        return true;
+    }
+    if (!enabled_ || failed_) {
+        return false;
+    }
+
+    const int fd = open(path_, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        failed_ = true;
+        LOG_WARN("Failed to create metrics page " + std::string(path_) + ": errno=" + std::to_string(errno));
+        return false;
+    }
+
+    void* mapped = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(sizeof(MetricsPageLayout))) == 0) {
+        mapped = mmap(nullptr, sizeof(MetricsPageLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    const int saved_errno = errno;
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        failed_ = true;
+        unlink(path_);
+        LOG_WARN("Failed to map metrics page " + std::string(path_) + ": errno=" + std::to_string(saved_errno));
+        return false;
+    }
+
+    page_ = static_cast<MetricsPageLayout*>(mapped);
+    page_->version = kMetricsPageVersion;
+    page_->size = static_cast<uint32_t>(sizeof(MetricsPageLayout));
+    page_->pid = static_cast<uint32_t>(getpid());
+    // Publish the magic last so readers never accept a half-initialised page.
+    __atomic_store_n(&page_->magic, kMetricsPageMagic, __ATOMIC_RELEASE);
+    LOG_INFO("Metrics page available at " + std::string(path_));
+    return true;
+}
+
+void MetricsPage::BeginWriteLocked() {
+    __atomic_store_n(&page_->sequence, page_->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void MetricsPage::EndWriteLocked(uint64_t now_ns) {
+    page_->update_time_ns = now_ns;
+    __atomic_store_n(&page_->sequence, page_->sequence + 1, __ATOMIC_RELEASE);
+}
+
+void MetricsPage::RefreshLowAddressLocked() {
+    if (low_address_source_ == nullptr) {
+        return;
+    }
+
+    uint64_t values[metrics_counter::count] = {};
+    low_address_source_(values);
+    std::memcpy(page_->low_address, values, sizeof(values));
+}
+
+void MetricsPage::RefreshHostAllocationsLocked() {
+    if (host_allocation_source_ == nullptr) {
+        return;
+    }
+
+    MetricsHostAllocations values[kMetricsAllocationScopes] = {};
+    host_allocation_source_(values);
+    std::memcpy(page_->host_allocations, values, sizeof(values));
+}
+
+void MetricsPage::SetLowAddressSource(LowAddressSource source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    low_address_source_ = source;
+}
+
+void MetricsPage::SetHostAllocationSource(HostAllocationSource source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    host_allocation_source_ = source;
+}
+
+void MetricsPage::PublishLowAddressCounters() {
+    if (!enabled_) {
+        return;
+    }
+
+    const uint64_t now_ns = monotonic_now_ns();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (now_ns - last_low_address_refresh_ns_ < kLowAddressRefreshIntervalNs || !EnsurePageLocked()) {
+        return;
+    }
+
+    last_low_address_refresh_ns_ = now_ns;
+    BeginWriteLocked();
+    RefreshLowAddressLocked();
+    RefreshHostAllocationsLocked();
+    EndWriteLocked(now_ns);
+}
+
+void MetricsPage::RecordPresent(uint64_t swapchain, bool success) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    const uint64_t now_ns = monotonic_now_ns();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsSwapchainSlot* slot = GetSlotLocked(swapchain);
+    slot->presents++;
+    if (!success) {
+        slot->present_failures++;
+    }
+    if (slot->last_present_ns != 0) {
+        const uint64_t frame_ns = now_ns - slot->last_present_ns;
+        const uint64_t bucket = frame_ns / (static_cast<uint64_t>(kMetricsFrameTimeBucketUs) * 1000ULL);
+        slot->frame_time_histogram[bucket < kMetricsFrameTimeBuckets ? bucket : kMetricsFrameTimeBuckets - 1]++;
+        const uint64_t frame_us = frame_ns / 1000;
+        slot->frame_time_total_ns += frame_ns;
+        slot->frame_time_sq_total_us2 += frame_us * frame_us;
+        slot->frame_time_samples++;
+    }
+    slot->last_present_ns = now_ns;
+
+    if (now_ns - last_low_address_refresh_ns_ >= kLowAddressRefreshIntervalNs) {
+        last_low_address_refresh_ns_ = now_ns;
+        RefreshLowAddressLocked();
+        RefreshHostAllocationsLocked();
+    }
+    EndWriteLocked(now_ns);
+}
+
+void MetricsPage::RecordPresentWait(uint64_t swapchain, uint64_t wait_ns) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsSwapchainSlot* slot = GetSlotLocked(swapchain);
+    slot->present_wait_total_ns += wait_ns;
+    slot->present_wait_samples++;
+    if (wait_ns > slot->present_wait_max_ns) {
+        slot->present_wait_max_ns = wait_ns;
+    }
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordPresentLatency(uint64_t swapchain, uint64_t queue_ns, uint64_t dispatch_ns) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsSwapchainSlot* slot = GetSlotLocked(swapchain);
+    slot->present_queue_total_ns += queue_ns;
+    slot->present_dispatch_total_ns += dispatch_ns;
+    slot->present_queue_samples++;
+    if (queue_ns > slot->present_queue_max_ns) {
+        slot->present_queue_max_ns = queue_ns;
+    }
+    if (dispatch_ns > slot->present_dispatch_max_ns) {
+        slot->present_dispatch_max_ns = dispatch_ns;
+    }
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordPresentAllocations(uint64_t swapchain, uint64_t allocations) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsSwapchainSlot* slot = GetSlotLocked(swapchain);
+    slot->present_allocations_total += allocations;
+    slot->present_allocation_samples++;
+    if (allocations > slot->present_allocations_max) {
+        slot->present_allocations_max = allocations;
+    }
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordPresentMode(uint64_t swapchain, uint32_t backend, uint32_t present_mode) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsSwapchainSlot* slot = GetSlotLocked(swapchain);
+    slot->backend = backend;
+    slot->present_mode = present_mode;
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordDisplayLatency(uint64_t swapchain, uint64_t latency_ns) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    MetricsStageTimingAdd(GetSlotLocked(swapchain)->display_latency, latency_ns);
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordBridgeStats(uint64_t swapchain, const MetricsBridgeStats& stats) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    GetSlotLocked(swapchain)->bridge = stats;
+    EndWriteLocked(monotonic_now_ns());
+}
+
+void MetricsPage::RecordFrameTiming(uint64_t swapchain, const MetricsFrameTiming& timing) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!EnsurePageLocked()) {
+        return;
+    }
+
+    BeginWriteLocked();
+    GetSlotLocked(swapchain)->frame_timing = timing;
+    EndWriteLocked(monotonic_now_ns());
+}
+
+MetricsSwapchainSlot* MetricsPage::GetSlotLocked(uint64_t swapchain) {
+    MetricsSwapchainSlot* free_slot = nullptr;
+    MetricsSwapchainSlot* oldest_slot = &page_->swapchains[0];
+    for (auto& candidate : page_->swapchains) {
+        if (candidate.handle == swapchain) {
+            return &candidate;
+        }
+        if (candidate.handle == 0 && free_slot == nullptr) {
+            free_slot = &candidate;
+        }
+        if (candidate.last_present_ns < oldest_slot->last_present_ns) {
+            oldest_slot = &candidate;
+        }
+    }
+
+    // More live swapchains than slots: recycle the one idle the longest.
+    MetricsSwapchainSlot* slot = (free_slot != nullptr) ? free_slot : oldest_slot;
+    std::memset(slot, 0, sizeof(*slot));
+    slot->handle = swapchain;
+    return slot;
+}
+
+void MetricsPage::ForgetSwapchain(uint64_t swapchain) {
+    if (!enabled_ || swapchain == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (page_ == nullptr) {
+        return;
+    }
+
+    for (auto& slot : page_->swapchains) {
+        if (slot.handle == swapchain) {
+            BeginWriteLocked();
+            std::memset(&slot, 0, sizeof(slot));
+            EndWriteLocked(monotonic_now_ns());
+            break;
+        }
+    }
+}
+
+void MetricsPage::Shutdown() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    low_address_source_ = nullptr;
+    host_allocation_source_ = nullptr;
+    failed_ = true;
+    if (page_ == nullptr) {
+        return;
+    }
+
+    munmap(page_, sizeof(MetricsPageLayout));
+    page_ = nullptr;
+    unlink(path_);
+}
+
+} // namespace mali_wrapper
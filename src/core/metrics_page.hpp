@@ -0,0 +1,411 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <sched.h>
+
+namespace mali_wrapper {
+
+// Layout of the live metrics page at /dev/shm/mali-wrapper-<pid>. Only fixed
+// width fields are used so 32-bit and 64-bit processes agree on it; bump
+// kMetricsPageVersion whenever a field moves.
+constexpr uint32_t kMetricsPageMagic = 0x504d574du; // "MWMP"
+constexpr uint32_t kMetricsPageVersion = 10;
+constexpr uint32_t kMetricsPageMaxSwapchains = 8;
+constexpr uint32_t kMetricsFrameTimeBuckets = 32;
+constexpr uint32_t kMetricsFrameTimeBucketUs = 2000;
+constexpr uint32_t kMetricsBridgeLatencyBuckets = 32;
+constexpr uint32_t kMetricsBridgeLatencyBucketUs = 1000;
+// Frame stage histograms have 4 buckets per power of two microseconds, from
+// 1 us up to about 8 s; see MetricsStageBucket().
+constexpr uint32_t kMetricsStageBuckets = 88;
+// One per VkSystemAllocationScope, in its order: command, object, cache,
+// device, instance.
+constexpr uint32_t kMetricsAllocationScopes = 5;
+
+#define MALI_WRAPPER_METRICS_LOW_ADDRESS_COUNTERS(X) \
+    X(successful_maps)                               \
+    X(compatible_maps)                               \
+    X(high_pointer_maps)                             \
+    X(shadow_maps)                                   \
+    X(allocation_failures)                           \
+    X(active_shadow_maps)                            \
+    X(active_shadow_bytes)                           \
+    X(peak_shadow_bytes)                             \
+    X(resident_shadow_bytes)                         \
+    X(arena_reserved_bytes)                          \
+    X(initial_copy_bytes)                            \
+    X(flush_copy_bytes)                              \
+    X(invalidate_copy_bytes)                         \
+    X(submit_copy_bytes)                             \
+    X(unmap_copy_bytes)                              \
+    X(copy_time_ns)                                  \
+    X(allocation_time_ns)                            \
+    X(dirty_write_faults)                            \
+    X(submit_dirty_pages)                            \
+    X(submit_clean_bytes_skipped)                    \
+    X(mapping_cache_hits)                            \
+    X(mapping_cache_misses)                          \
+    X(mapping_cache_evictions)                       \
+    X(budget_evictions)                              \
+    X(budget_refaults)                               \
+    X(lazy_fill_skipped_bytes)                       \
+    X(submit_epoch_skips)                            \
+    X(adaptive_tracked_migrations)                   \
+    X(adaptive_full_copy_migrations)                 \
+    X(adaptive_migration_failures)                   \
+    X(last_frame_copy_bytes)                         \
+    X(peak_frame_copy_bytes)
+
+namespace metrics_counter {
+enum : uint32_t {
+#define MALI_WRAPPER_METRICS_COUNTER_ENUM(name) name,
+    MALI_WRAPPER_METRICS_LOW_ADDRESS_COUNTERS(MALI_WRAPPER_METRICS_COUNTER_ENUM)
+#undef MALI_WRAPPER_METRICS_COUNTER_ENUM
+    count
+};
+} // namespace metrics_counter
+
+// Where the time of a frame goes, in pipeline order. present_pickup is from
+// vkQueuePresentKHR to the page flip thread taking the request,
+// present_fence_wait the wait for the present payload, present_work the
+// presenter's own work (SHM copy and put, bridge send, Wayland commit, ...)
+// including any pacing it does on that thread, and pacing_sleep every sleep
+// spent pacing frames, on whichever thread.
+#define MALI_WRAPPER_METRICS_FRAME_STAGES(X) \
+    X(acquire_wait)                          \
+    X(present_pickup)                        \
+    X(present_fence_wait)                    \
+    X(present_work)                          \
+    X(pacing_sleep)
+
+namespace metrics_stage {
+enum : uint32_t {
+#define MALI_WRAPPER_METRICS_STAGE_ENUM(name) name,
+    MALI_WRAPPER_METRICS_FRAME_STAGES(MALI_WRAPPER_METRICS_STAGE_ENUM)
+#undef MALI_WRAPPER_METRICS_STAGE_ENUM
+    count
+};
+} // namespace metrics_stage
+
+// Present path a swapchain reports in MetricsSwapchainSlot::backend.
+#define MALI_WRAPPER_METRICS_BACKENDS(X) \
+    X(unknown)                           \
+    X(headless)                          \
+    X(x11_shm)                           \
+    X(x11_dri3)                          \
+    X(xwayland_bridge)                   \
+    X(wayland)                           \
+    X(display)
+
+namespace metrics_backend {
+enum : uint32_t {
+#define MALI_WRAPPER_METRICS_BACKEND_ENUM(name) name,
+    MALI_WRAPPER_METRICS_BACKENDS(MALI_WRAPPER_METRICS_BACKEND_ENUM)
+#undef MALI_WRAPPER_METRICS_BACKEND_ENUM
+    count
+};
+} // namespace metrics_backend
+
+inline const char* GetMetricsBackendName(uint32_t index)
+{
+    static const char* const names[] = {
+#define MALI_WRAPPER_METRICS_BACKEND_NAME(name) #name,
+        MALI_WRAPPER_METRICS_BACKENDS(MALI_WRAPPER_METRICS_BACKEND_NAME)
+#undef MALI_WRAPPER_METRICS_BACKEND_NAME
+    };
+    return index < metrics_backend::count ? names[index] : "unknown";
+}
+
+inline const char* GetMetricsCounterName(uint32_t index)
+{
+    static const char* const names[] = {
+#define MALI_WRAPPER_METRICS_COUNTER_NAME(name) #name,
+        MALI_WRAPPER_METRICS_LOW_ADDRESS_COUNTERS(MALI_WRAPPER_METRICS_COUNTER_NAME)
+#undef MALI_WRAPPER_METRICS_COUNTER_NAME
+    };
+    return index < metrics_counter::count ? names[index] : "unknown";
+}
+
+// Xwayland dmabuf bridge statistics of one swapchain; all zero on other
+// present paths. The bridge client keeps them in this form as well.
+struct MetricsBridgeStats {
+    uint64_t frames_sent;
+    uint64_t frames_displayed;
+    uint64_t frames_failed;      // FAILED feedback
+    uint64_t feedback_timeouts;  // in-flight waits that gave up
+    uint64_t reconnects;
+    // Submit to feedback of the same frame. Bucket i counts frames of
+    // [i, i + 1) * kMetricsBridgeLatencyBucketUs; the last bucket also takes
+    // everything slower.
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+    uint64_t latency_samples;
+    uint64_t latency_histogram[kMetricsBridgeLatencyBuckets];
+    // Time the present thread slept in bridge pacing.
+    uint64_t throttle_total_ns;
+    uint64_t throttle_max_ns;
+    uint64_t throttle_samples;
+};
+
+// Durations of one frame stage.
+struct MetricsStageTiming {
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t samples;
+    uint64_t histogram[kMetricsStageBuckets];
+};
+
+// Per-frame breakdown of the present pipeline of one swapchain, all zero
+// unless its frame timing is enabled.
+struct MetricsFrameTiming {
+    uint64_t frames;
+    // Id of the last frame presented: the VkFrameBoundaryEXT frameID when the
+    // application passes one, the present count otherwise.
+    uint64_t last_frame_id;
+    MetricsStageTiming stages[metrics_stage::count];
+};
+
+inline const char* GetMetricsStageName(uint32_t index)
+{
+    static const char* const names[] = {
+#define MALI_WRAPPER_METRICS_STAGE_NAME(name) #name,
+        MALI_WRAPPER_METRICS_FRAME_STAGES(MALI_WRAPPER_METRICS_STAGE_NAME)
+#undef MALI_WRAPPER_METRICS_STAGE_NAME
+    };
+    return index < metrics_stage::count ? names[index] : "unknown";
+}
+
+// Buckets 0-3 hold [i, i + 1) us; above that each power of two [2^k, 2^(k+1))
+// us is split in 4 equal buckets. The last bucket also takes everything slower.
+inline uint32_t MetricsStageBucket(uint64_t duration_ns)
+{
+    const uint64_t us = duration_ns / 1000;
+    if (us < 4) {
+        return static_cast<uint32_t>(us);
+    }
+    const uint32_t msb = 63 - static_cast<uint32_t>(__builtin_clzll(us));
+    const uint32_t bucket = (msb - 1) * 4 + static_cast<uint32_t>((us >> (msb - 2)) & 3);
+    return bucket < kMetricsStageBuckets ? bucket : kMetricsStageBuckets - 1;
+}
+
+// Upper edge of a MetricsStageBucket(), in microseconds.
+inline uint64_t MetricsStageBucketUpperUs(uint32_t bucket)
+{
+    if (bucket < 4) {
+        return bucket + 1;
+    }
+    return static_cast<uint64_t>(4 + bucket % 4 + 1) << (bucket / 4 - 1);
+}
+
+inline void MetricsStageTimingAdd(MetricsStageTiming& timing, uint64_t duration_ns)
+{
+    timing.total_ns += duration_ns;
+    timing.samples++;
+    if (duration_ns > timing.max_ns) {
+        timing.max_ns = duration_ns;
+    }
+    timing.histogram[MetricsStageBucket(duration_ns)]++;
+}
+
+// Upper edge of the bucket holding the given percentile, in microseconds,
+// capped at the largest duration seen.
+inline double MetricsStagePercentileUs(const MetricsStageTiming& timing, double percentile)
+{
+    if (timing.samples == 0) {
+        return 0.0;
+    }
+
+    const uint64_t target = static_cast<uint64_t>(static_cast<double>(timing.samples) * percentile + 0.5);
+    const double max_us = static_cast<double>(timing.max_ns) / 1000.0;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kMetricsStageBuckets; ++i) {
+        seen += timing.histogram[i];
+        if (seen >= target) {
+            const double upper_us = static_cast<double>(MetricsStageBucketUpperUs(i));
+            return upper_us < max_us ? upper_us : max_us;
+        }
+    }
+    return max_us;
+}
+
+// Host memory the WSI layer allocated in one allocation scope.
+struct MetricsHostAllocations {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+    uint64_t live_bytes;
+};
+
+inline const char* GetMetricsAllocationScopeName(uint32_t index)
+{
+    static const char* const names[] = {"command", "object", "cache", "device", "instance"};
+    return index < kMetricsAllocationScopes ? names[index] : "unknown";
+}
+
+struct MetricsSwapchainSlot {
+    uint64_t handle;              // 0 when the slot is free
+    uint64_t presents;
+    uint64_t present_failures;
+    uint64_t last_present_ns;     // CLOCK_MONOTONIC
+    uint64_t frame_time_total_ns; // sum over frame_time_samples
+    uint64_t frame_time_samples;
+    // Bucket i counts frames of [i, i + 1) * kMetricsFrameTimeBucketUs; the
+    // last bucket also takes everything slower.
+    uint64_t frame_time_histogram[kMetricsFrameTimeBuckets];
+    // Time the presenter blocked before it could reuse a buffer, per frame.
+    uint64_t present_wait_total_ns;
+    uint64_t present_wait_max_ns;
+    uint64_t present_wait_samples;
+    // Page flip thread, per present: from queued to its present fence
+    // signaling, then from there to handed to the presentation engine.
+    uint64_t present_queue_total_ns;
+    uint64_t present_queue_max_ns;
+    uint64_t present_dispatch_total_ns;
+    uint64_t present_dispatch_max_ns;
+    uint64_t present_queue_samples;
+    // Host allocations made while presenting, by vkQueuePresentKHR and by
+    // the page flip thread; each of them is one sample.
+    uint64_t present_allocations_total;
+    uint64_t present_allocations_max;
+    uint64_t present_allocation_samples;
+    // metrics_backend and VkPresentModeKHR of the latest present.
+    uint32_t backend;
+    uint32_t present_mode;
+    // Sum of squared frame times in us^2, for the frame time jitter.
+    uint64_t frame_time_sq_total_us2;
+    // From vkQueuePresentKHR to the frame reaching the display, for presents
+    // whose backend learns when that was: X11 Present CompleteNotify on the
+    // DRI3 path, SHM puts paced to vblank, and Wayland presentation feedback
+    // on a CLOCK_MONOTONIC compositor.
+    MetricsStageTiming display_latency;
+    MetricsBridgeStats bridge;
+    MetricsFrameTiming frame_timing;
+};
+
+struct MetricsPageLayout {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t pid;
+    // Seqlock, accessed with __atomic builtins: odd while the wrapper is
+    // writing. Readers copy the page and retry when it changed or was odd.
+    uint64_t sequence;
+    uint64_t update_time_ns; // CLOCK_MONOTONIC
+    uint64_t low_address[metrics_counter::count];
+    MetricsHostAllocations host_allocations[kMetricsAllocationScopes];
+    MetricsSwapchainSlot swapchains[kMetricsPageMaxSwapchains];
+};
+
+// Upper edge of the bucket holding the given percentile, in milliseconds.
+inline double MetricsHistogramPercentileMs(const uint64_t* histogram, uint32_t buckets, uint32_t bucket_us,
+                                           double percentile)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < buckets; ++i) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+
+    const uint64_t target = static_cast<uint64_t>(static_cast<double>(total) * percentile + 0.5);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < buckets; ++i) {
+        seen += histogram[i];
+        if (seen >= target) {
+            return static_cast<double>((i + 1) * bucket_us) / 1000.0;
+        }
+    }
+    return static_cast<double>(buckets * bucket_us) / 1000.0;
+}
+
+static_assert(std::is_trivially_copyable<MetricsPageLayout>::value, "metrics page must stay plain data");
+static_assert(sizeof(MetricsSwapchainSlot) % 8 == 0, "metrics page slots must stay 8-byte packed");
+
+// Takes a consistent copy of a mapped page without blocking the writer.
+// Returns false if the page is not a metrics page of this version or no stable
+// copy was seen within max_attempts.
+// Header-only so the metrics CLI does not have to link the wrapper.
+inline bool ReadMetricsPage(const MetricsPageLayout* page, MetricsPageLayout* out, uint32_t max_attempts = 64)
+{
+    if (page == nullptr || out == nullptr) {
+        return false;
+    }
+
+    for (uint32_t attempt = 0; attempt < max_attempts; ++attempt) {
+        const uint64_t before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+        if ((before & 1) != 0) {
+            sched_yield();
+            continue;
+        }
+
+        std::memcpy(out, page, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == before) {
+            return out->magic == kMetricsPageMagic && out->version == kMetricsPageVersion &&
+                   out->size == sizeof(MetricsPageLayout);
+        }
+    }
+    return false;
+}
+
+// Writer side, owned by the wrapper. Everything is a no-op unless
+// MALI_WRAPPER_METRICS_PAGE is set; the page is created on first use and
+// removed on Shutdown().
+class MetricsPage {
+public:
+    using LowAddressSource = void (*)(uint64_t* values);
+    using HostAllocationSource = void (*)(MetricsHostAllocations* values);
+
+    static MetricsPage& Instance();
+
+    bool IsEnabled() const { return enabled_; }
+
+    // The source fills metrics_counter::count values. It is polled on
+    // PublishLowAddressCounters() and, rate limited, from RecordPresent().
+    void SetLowAddressSource(LowAddressSource source);
+    // Fills kMetricsAllocationScopes values; polled with the low-address
+    // counters.
+    void SetHostAllocationSource(HostAllocationSource source);
+    void PublishLowAddressCounters();
+    void RecordPresent(uint64_t swapchain, bool success);
+    void RecordPresentWait(uint64_t swapchain, uint64_t wait_ns);
+    void RecordPresentLatency(uint64_t swapchain, uint64_t queue_ns, uint64_t dispatch_ns);
+    void RecordPresentAllocations(uint64_t swapchain, uint64_t allocations);
+    void RecordPresentMode(uint64_t swapchain, uint32_t backend, uint32_t present_mode);
+    void RecordDisplayLatency(uint64_t swapchain, uint64_t latency_ns);
+    void RecordBridgeStats(uint64_t swapchain, const MetricsBridgeStats& stats);
+    void RecordFrameTiming(uint64_t swapchain, const MetricsFrameTiming& timing);
+    void ForgetSwapchain(uint64_t swapchain);
+    void Shutdown();
+
+private:
+    MetricsPage();
+    ~MetricsPage();
+    MetricsPage(const MetricsPage&) = delete;
+    MetricsPage& operator=(const MetricsPage&) = delete;
+
+    bool EnsurePageLocked();
+    void BeginWriteLocked();
+    void EndWriteLocked(uint64_t now_ns);
+    void RefreshLowAddressLocked();
+    void RefreshHostAllocationsLocked();
+    // Finds the swapchain's slot, claiming one if needed. Call between
+    // BeginWriteLocked() and EndWriteLocked().
+    MetricsSwapchainSlot* GetSlotLocked(uint64_t swapchain);
+
+    bool enabled_ = false;
+    bool failed_ = false;
+    std::mutex mutex_;
+    MetricsPageLayout* page_ = nullptr;
+    LowAddressSource low_address_source_ = nullptr;
+    HostAllocationSource host_allocation_source_ = nullptr;
+    uint64_t last_low_address_refresh_ns_ = 0;
+    char path_[64] = {};
+};
+
+} // namespace mali_wrapper
@@ -0,0 +1,357 @@
+#include "pipeline_cache_store.hpp"
+#include "library_loader.hpp"
+#include "../utils/logging.hpp"
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+constexpr uint32_t kCacheFileMagic = 0x4350574du; // "MWPC"
+constexpr uint32_t kCacheFileVersion = 1;
+constexpr uint64_t kSaveIntervalNs = 10ULL * 1000ULL * 1000ULL * 1000ULL;
+// Larger files are ignored rather than read into memory.
+constexpr uint64_t kMaxCacheDataSize = 512ULL * 1024ULL * 1024ULL;
+
+// Precedes the driver's cache data in the file. The data hash rejects files
+// torn by a crash or a full disk before the driver gets to parse them.
+struct CacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key_hash;
+    uint64_t data_size;
+    uint64_t data_hash;
+};
+
+std::mutex application_name_mutex;
+std::string application_name;
+
+uint64_t monotonic_now_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+bool is_enabled_value(const char* value) {
+    if (value == nullptr || value[0] == '\0') {
+        return false;
+    }
+    return value[0] != '0' && value[0] != 'n' && value[0] != 'N' && value[0] != 'f' && value[0] != 'F';
+}
+
+// Keeps the name usable as part of a file name.
+std::string sanitize_file_name(const std::string& name) {
+    std::string sanitized;
+    for (char c : name) {
+        if (sanitized.size() >= 64) {
+            break;
+        }
+        const bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                           c == '.' || c == '-' || c == '_';
+        sanitized += plain ? c : '_';
+    }
+    return sanitized.empty() ? std::string("unknown") : sanitized;
+}
+
+std::string get_application_name() {
+    {
+        std::lock_guard<std::mutex> lock(application_name_mutex);
+        if (!application_name.empty()) {
+            return application_name;
+        }
+    }
+    return program_invocation_short_name != nullptr ? program_invocation_short_name : "";
+}
+
+std::string get_cache_directory() {
+    const char* dir = std::getenv("MALI_WRAPPER_PIPELINE_CACHE_DIR");
+    if (dir != nullptr && dir[0] != '\0') {
+        return dir;
+    }
+    const char* xdg_cache = std::getenv("XDG_CACHE_HOME");
+    if (xdg_cache != nullptr && xdg_cache[0] == '/') {
+        return std::string(xdg_cache) + "/mali-wrapper/pipeline-cache";
+    }
+    const char* home = std::getenv("HOME");
+    if (home != nullptr && home[0] == '/') {
+        return std::string(home) + "/.cache/mali-wrapper/pipeline-cache";
+    }
+    return {};
+}
+
+bool make_directories(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos != path.size() && path[pos] != '/') {
+            continue;
+        }
+        const std::string prefix = path.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The loaded Mali library, resolved through symlinks, with its size and
+// mtime, so replacing the blob (g24p0 to g29p1, say) starts a new cache even
+// if the driver reports the same version.
+const std::string& get_driver_identity() {
+    static std::once_flag once;
+    static std::string identity;
+    std::call_once(once, []() {
+        Dl_info info{};
+        auto symbol = reinterpret_cast<void*>(LibraryLoader::Instance().GetMaliGetInstanceProcAddr());
+        if (symbol == nullptr || dladdr(symbol, &info) == 0 || info.dli_fname == nullptr) {
+            return;
+        }
+        char resolved[PATH_MAX];
+        identity = realpath(info.dli_fname, resolved) != nullptr ? resolved : info.dli_fname;
+        struct stat st{};
+        if (stat(identity.c_str(), &st) == 0) {
+            identity += "|" + std::to_string(static_cast<long long>(st.st_size)) + "|" +
+                        std::to_string(static_cast<long long>(st.st_mtime));
+        }
+    });
+    return identity;
+}
+
+bool read_cache_file(const std::string& path, uint64_t key_hash, std::vector<uint8_t>* data) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    CacheFileHeader header{};
+    bool valid = read(fd, &header, sizeof(header)) == static_cast<ssize_t>(sizeof(header)) &&
+                 header.magic == kCacheFileMagic && header.version == kCacheFileVersion &&
+                 header.key_hash == key_hash && header.data_size > 0 && header.data_size <= kMaxCacheDataSize;
+    if (valid) {
+        data->resize(static_cast<size_t>(header.data_size));
+        size_t offset = 0;
+        while (offset < data->size()) {
+            const ssize_t got = read(fd, data->data() + offset, data->size() - offset);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                break;
+            }
+            offset += static_cast<size_t>(got);
+        }
+        valid = offset == data->size() && fnv1a64(data->data(), data->size()) == header.data_hash;
+    }
+    close(fd);
+
+    if (!valid) {
+        data->clear();
+    }
+    return valid;
+}
+
+bool write_all(int fd, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Writes a temporary file next to the cache file and renames it over it, so
+// other processes running the same application only ever see whole files.
+bool write_cache_file(const std::string& path, uint64_t key_hash, const std::vector<uint8_t>& data,
+                      uint64_t data_hash) {
+    std::string temp_path = path + ".XXXXXX";
+    const int fd = mkostemp(&temp_path[0], O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    CacheFileHeader header{};
+    header.magic = kCacheFileMagic;
+    header.version = kCacheFileVersion;
+    header.key_hash = key_hash;
+    header.data_size = data.size();
+    header.data_hash = data_hash;
+
+    bool ok = fchmod(fd, 0644) == 0 && write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, data.data(), data.size());
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temp_path.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        unlink(temp_path.c_str());
+    }
+    return ok;
+}
+
+} // namespace
+
+bool PersistentPipelineCache::IsEnabled() {
+    static const bool enabled = is_enabled_value(std::getenv("MALI_WRAPPER_PIPELINE_CACHE"));
+    return enabled;
+}
+
+void PersistentPipelineCache::SetApplicationName(const char* name) {
+    if (name == nullptr || name[0] == '\0') {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(application_name_mutex);
+    application_name = name;
+}
+
+std::shared_ptr<PersistentPipelineCache> PersistentPipelineCache::Create(
+    VkDevice device, const VkPhysicalDeviceProperties& properties, const DriverFunctions& functions) {
+    if (!IsEnabled() || device == VK_NULL_HANDLE || functions.create_pipeline_cache == nullptr ||
+        functions.destroy_pipeline_cache == nullptr || functions.get_pipeline_cache_data == nullptr) {
+        return nullptr;
+    }
+
+    const std::string directory = get_cache_directory();
+    if (directory.empty() || !make_directories(directory)) {
+        LOG_WARN("Pipeline cache directory unavailable: " + directory);
+        return nullptr;
+    }
+
+    const std::string app_name = get_application_name();
+    std::string key = app_name + "|" + get_driver_identity() + "|" + std::to_string(properties.driverVersion) + "|" +
+                      std::to_string(properties.vendorID) + "|" + std::to_string(properties.deviceID);
+    uint64_t key_hash = fnv1a64(key.data(), key.size());
+    key_hash = fnv1a64(properties.pipelineCacheUUID, VK_UUID_SIZE, key_hash);
+
+    char key_hex[17];
+    snprintf(key_hex, sizeof(key_hex), "%016" PRIx64, key_hash);
+    const std::string path = directory + "/" + sanitize_file_name(app_name) + "-" + key_hex + ".bin";
+
+    std::shared_ptr<PersistentPipelineCache> store(
+        new PersistentPipelineCache(device, functions, path, key_hash));
+
+    std::vector<uint8_t> initial_data;
+    const bool loaded = read_cache_file(path, key_hash, &initial_data);
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = initial_data.size();
+    create_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+    VkResult result = functions.create_pipeline_cache(device, &create_info, nullptr, &store->cache_);
+    if (result != VK_SUCCESS && loaded) {
+        // The driver rejected the data outright; start over with an empty cache.
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        result = functions.create_pipeline_cache(device, &create_info, nullptr, &store->cache_);
+    }
+    if (result != VK_SUCCESS) {
+        LOG_WARN("Failed to create wrapper pipeline cache, error: " + std::to_string(result));
+        return nullptr;
+    }
+
+    if (loaded) {
+        store->saved_data_hash_ = fnv1a64(initial_data.data(), initial_data.size());
+        LOG_INFO("Loaded " + std::to_string(initial_data.size()) + " bytes of pipeline cache from " + path);
+    } else {
+        LOG_INFO("Using new pipeline cache " + path);
+    }
+    store->last_save_ns_.store(monotonic_now_ns(), std::memory_order_relaxed);
+    return store;
+}
+
+PersistentPipelineCache::PersistentPipelineCache(VkDevice device, const DriverFunctions& functions,
+                                                 std::string path, uint64_t key_hash)
+    : device_(device), functions_(functions), path_(std::move(path)), key_hash_(key_hash) {
+}
+
+// The dispatch holding the cache can outlive its device, so the destructor
+// never calls into the driver; Destroy() does that.
+PersistentPipelineCache::~PersistentPipelineCache() = default;
+
+void PersistentPipelineCache::NoteCreated(uint32_t pipeline_count) {
+    if (pipeline_count == 0) {
+        return;
+    }
+    unsaved_pipelines_.fetch_add(pipeline_count, std::memory_order_relaxed);
+
+    const uint64_t now = monotonic_now_ns();
+    if (now - last_save_ns_.load(std::memory_order_relaxed) < kSaveIntervalNs) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(save_mutex_, std::try_to_lock);
+    if (lock.owns_lock() && cache_ != VK_NULL_HANDLE) {
+        Save();
+    }
+}
+
+void PersistentPipelineCache::Destroy() {
+    std::lock_guard<std::mutex> lock(save_mutex_);
+    if (cache_ == VK_NULL_HANDLE) {
+        return;
+    }
+    if (unsaved_pipelines_.load(std::memory_order_relaxed) > 0) {
+        Save();
+    }
+    functions_.destroy_pipeline_cache(device_, cache_, nullptr);
+    cache_ = VK_NULL_HANDLE;
+}
+
+void PersistentPipelineCache::Save() {
+    last_save_ns_.store(monotonic_now_ns(), std::memory_order_relaxed);
+    const uint32_t pipelines = unsaved_pipelines_.exchange(0, std::memory_order_relaxed);
+
+    // Other threads may add pipelines between the size query and the copy.
+    std::vector<uint8_t> data;
+    VkResult result = VK_INCOMPLETE;
+    for (int attempt = 0; attempt < 3 && result == VK_INCOMPLETE; attempt++) {
+        size_t size = 0;
+        if (functions_.get_pipeline_cache_data(device_, cache_, &size, nullptr) != VK_SUCCESS) {
+            return;
+        }
+        data.resize(size);
+        result = functions_.get_pipeline_cache_data(device_, cache_, &size, data.data());
+        data.resize(size);
+    }
+    if (result != VK_SUCCESS || data.empty() || data.size() > kMaxCacheDataSize) {
+        return;
+    }
+
+    const uint64_t data_hash = fnv1a64(data.data(), data.size());
+    if (data_hash == saved_data_hash_) {
+        return;
+    }
+
+    if (!write_cache_file(path_, key_hash_, data, data_hash)) {
+        LOG_WARN("Failed to save pipeline cache to " + path_ + ": " + std::strerror(errno));
+        return;
+    }
+    saved_data_hash_ = data_hash;
+    LOG_DEBUG("Saved " + std::to_string(data.size()) + " bytes of pipeline cache (" +
+              std::to_string(pipelines) + " new pipelines) to " + path_);
+}
+
+} // namespace mali_wrapper
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace mali_wrapper {
+
+// Wrapper-owned VkPipelineCache that pipeline creation uses when the
+// application passes VK_NULL_HANDLE. It is loaded from and saved to
+// MALI_WRAPPER_PIPELINE_CACHE_DIR, in one file per application, driver build
+// and GPU, so the second launch of an application that never persists its own
+// cache does not recompile every pipeline.
+class PersistentPipelineCache {
+public:
+    struct DriverFunctions {
+        PFN_vkCreatePipelineCache create_pipeline_cache = nullptr;
+        PFN_vkDestroyPipelineCache destroy_pipeline_cache = nullptr;
+        PFN_vkGetPipelineCacheData get_pipeline_cache_data = nullptr;
+    };
+
+    // Whether MALI_WRAPPER_PIPELINE_CACHE is set; read once.
+    static bool IsEnabled();
+
+    // Remembers the VkApplicationInfo name the cache files are keyed by. The
+    // executable name is used when the application gives none.
+    static void SetApplicationName(const char* name);
+
+    // Creates the device's cache, seeded from its file when that exists and
+    // matches. Returns nullptr when disabled or when the driver refuses to
+    // create a cache.
+    static std::shared_ptr<PersistentPipelineCache> Create(VkDevice device,
+                                                           const VkPhysicalDeviceProperties& properties,
+                                                           const DriverFunctions& functions);
+
+    ~PersistentPipelineCache();
+    PersistentPipelineCache(const PersistentPipelineCache&) = delete;
+    PersistentPipelineCache& operator=(const PersistentPipelineCache&) = delete;
+
+    VkPipelineCache Handle() const { return cache_; }
+
+    // Called after pipelines were created with Handle(). Saves the cache at
+    // most every few seconds, on whichever thread gets there first.
+    void NoteCreated(uint32_t pipeline_count);
+
+    // Saves pending pipelines and destroys the VkPipelineCache. Must be called
+    // before the device is destroyed, with no pipeline creation in flight.
+    void Destroy();
+
+private:
+    PersistentPipelineCache(VkDevice device, const DriverFunctions& functions, std::string path,
+                            uint64_t key_hash);
+
+    void Save();
+
+    VkDevice device_;
+    DriverFunctions functions_;
+    VkPipelineCache cache_ = VK_NULL_HANDLE;
+    std::string path_;
+    uint64_t key_hash_;
+
+    std::atomic<uint32_t> unsaved_pipelines_{0};
+    std::atomic<uint64_t> last_save_ns_{0};
+    // Held while saving; creators that find it taken skip their save.
+    std::mutex save_mutex_;
+    uint64_t saved_data_hash_ = 0;
+};
+
+} // namespace mali_wrapper
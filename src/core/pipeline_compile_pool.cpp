@@ -0,0 +1,183 @@
+#include "pipeline_compile_pool.hpp"
+#include "../utils/logging.hpp"
+#include "../utils/thread_placement.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <system_error>
+#include <signal.h>
+#include <pthread.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+constexpr size_t kDefaultMinBatch = 4;
+
+size_t read_size_env(const char* name, size_t fallback) {
+    const char* value = std::getenv(name);
+    if (value == nullptr || value[0] == '\0') {
+        return fallback;
+    }
+
+    char* end = nullptr;
+    const unsigned long long parsed = std::strtoull(value, &end, 10);
+    if (end == value) {
+        return fallback;
+    }
+    return static_cast<size_t>(parsed);
+}
+
+} // namespace
+
+struct PipelineCompilePool::Job {
+    const std::function<void(size_t)>* task = nullptr;
+    size_t task_count = 0;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+};
+
+PipelineCompilePool& PipelineCompilePool::Instance() {
+    static PipelineCompilePool instance;
+    return instance;
+}
+
+PipelineCompilePool::PipelineCompilePool() {
+    const unsigned int hardware_threads = std::thread::hardware_concurrency();
+
+    // Unset or 0 keeps every batch in a single driver call.
+    worker_count_ = std::min(read_size_env("MALI_WRAPPER_PIPELINE_THREADS", 0),
+                             static_cast<size_t>(hardware_threads > 0 ? hardware_threads : 1));
+    min_batch_ = std::max<size_t>(2, read_size_env("MALI_WRAPPER_PIPELINE_PARALLEL_MIN", kDefaultMinBatch));
+}
+
+PipelineCompilePool::~PipelineCompilePool() {
+    Shutdown();
+}
+
+void PipelineCompilePool::Shutdown() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        workers.swap(workers_);
+    }
+    work_available_.notify_all();
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+bool PipelineCompilePool::ShouldSplit(size_t create_info_count) {
+    return worker_count_ > 0 && create_info_count >= min_batch_ && EnsureWorkers();
+}
+
+bool PipelineCompilePool::EnsureWorkers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return false;
+    }
+    if (workers_started_) {
+        return !workers_.empty();
+    }
+
+    workers_started_ = true;
+    for (size_t i = 0; i < worker_count_; ++i) {
+        try {
+            workers_.emplace_back(&PipelineCompilePool::WorkerMain, this);
+        } catch (const std::system_error& e) {
+            LOG_WARN("Failed to start pipeline compile worker: " + std::string(e.what()));
+            break;
+        }
+    }
+
+    LOG_INFO("Pipeline compile pool started " + std::to_string(workers_.size()) +
+             " worker(s), splitting batches of " + std::to_string(min_batch_) + " or more pipelines");
+    return !workers_.empty();
+}
+
+void PipelineCompilePool::WorkerMain() {
+    // Same signal policy as the copy workers: synchronous faults, which the
+    // pipeline signal guard traps, are still delivered here.
+    sigset_t blocked;
+    sigfillset(&blocked);
+    sigdelset(&blocked, SIGSEGV);
+    sigdelset(&blocked, SIGBUS);
+    sigdelset(&blocked, SIGFPE);
+    sigdelset(&blocked, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+    ApplyThreadPlacement(ThreadRole::WORKER, "pipeline compile worker");
+
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_available_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            job = jobs_.front();
+        }
+
+        RunJob(job);
+    }
+}
+
+void PipelineCompilePool::RunJob(const std::shared_ptr<Job>& job) {
+    for (;;) {
+        const size_t index = job->next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= job->task_count) {
+            break;
+        }
+
+        (*job->task)(index);
+
+        if (job->done.fetch_add(1, std::memory_order_acq_rel) + 1 == job->task_count) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->finished.notify_all();
+        }
+    }
+
+    // Every task has been claimed; drop the job so idle workers go back to sleep.
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) {
+        jobs_.erase(it);
+    }
+}
+
+void PipelineCompilePool::Run(size_t task_count, const std::function<void(size_t)>& task) {
+    if (task_count == 0) {
+        return;
+    }
+    if (task_count == 1 || !EnsureWorkers()) {
+        for (size_t i = 0; i < task_count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->task = &task;
+    job->task_count = task_count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    work_available_.notify_all();
+
+    RunJob(job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() {
+        return job->done.load(std::memory_order_acquire) == job->task_count;
+    });
+}
+
+} // namespace mali_wrapper
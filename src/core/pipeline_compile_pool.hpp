@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mali_wrapper {
+
+// Persistent worker pool that splits large vkCreateGraphicsPipelines batches
+// into chunks, one driver call each, so the blob compiles them on several
+// cores. Off unless MALI_WRAPPER_PIPELINE_THREADS is set. Like CopyEngine, the
+// caller drains its own job alongside the workers and Run() returns only once
+// every task has finished.
+class PipelineCompilePool {
+public:
+    static PipelineCompilePool& Instance();
+
+    // Calls task(i) for every i below task_count, on the calling thread and
+    // the workers.
+    void Run(size_t task_count, const std::function<void(size_t)>& task);
+    void Shutdown();
+
+    // Whether batches of create_info_count pipelines are worth splitting.
+    bool ShouldSplit(size_t create_info_count);
+
+    size_t GetWorkerCount() const { return worker_count_; }
+
+private:
+    struct Job;
+
+    PipelineCompilePool();
+    ~PipelineCompilePool();
+    PipelineCompilePool(const PipelineCompilePool&) = delete;
+    PipelineCompilePool& operator=(const PipelineCompilePool&) = delete;
+
+    bool EnsureWorkers();
+    void WorkerMain();
+    void RunJob(const std::shared_ptr<Job>& job);
+
+    size_t worker_count_ = 0;
+    size_t min_batch_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    std::vector<std::thread> workers_;
+    bool workers_started_ = false;
+    bool stopping_ = false;
+};
+
+} // namespace mali_wrapper
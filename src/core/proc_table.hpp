@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+#include <vulkan/vulkan.h>
+
+namespace mali_wrapper {
+
+// Compile-time sorted name -> value tables for the GetProcAddr paths.
+// Loaders and translation layers resolve thousands of names during instance
+// and device creation, so these replace strcmp chains with a binary search.
+// Keep every table in strcmp order; IsProcTableSorted() is meant to be
+// static_asserted next to the table.
+template <typename T>
+struct ProcTableEntry {
+    std::string_view name;
+    T value;
+};
+
+template <typename T, size_t N>
+constexpr bool IsProcTableSorted(const std::array<ProcTableEntry<T>, N>& table)
+{
+    for (size_t i = 1; i < N; ++i) {
+        if (!(table[i - 1].name < table[i].name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t N>
+constexpr bool IsProcTableSorted(const std::array<std::string_view, N>& names)
+{
+    for (size_t i = 1; i < N; ++i) {
+        if (!(names[i - 1] < names[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T, size_t N>
+inline const ProcTableEntry<T>* FindProcTableEntry(const std::array<ProcTableEntry<T>, N>& table, const char* name)
+{
+    if (name == nullptr) {
+        return nullptr;
+    }
+
+    const std::string_view key(name);
+    auto it = std::lower_bound(table.begin(), table.end(), key,
+                               [](const ProcTableEntry<T>& entry, std::string_view value) {
+                                   return entry.name < value;
+                               });
+    return (it != table.end() && it->name == key) ? &*it : nullptr;
+}
+
+template <size_t N>
+inline bool IsInProcTable(const std::array<std::string_view, N>& names, const char* name)
+{
+    return name != nullptr && std::binary_search(names.begin(), names.end(), std::string_view(name));
+}
+
+// Tables store a getter rather than the pointer itself: the cast to
+// PFN_vkVoidFunction is not a constant expression, the getter's address is.
+using ProcTableGetter = PFN_vkVoidFunction (*)();
+
+template <auto Function>
+PFN_vkVoidFunction ProcTableFunction()
+{
+    return reinterpret_cast<PFN_vkVoidFunction>(Function);
+}
+
+} // namespace mali_wrapper
@@ -0,0 +1,2036 @@
+#include "submit_references.hpp"
+#include "proc_table.hpp"
+#include "../utils/logging.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mali_wrapper {
+
+namespace {
+
+// Driver entry points behind the hooks, named as in the WSI dispatch tables.
+#define MALI_WRAPPER_REFERENCE_DRIVER_PROCS(X)     \
+    X(AllocateCommandBuffers)                      \
+    X(AllocateDescriptorSets)                      \
+    X(BeginCommandBuffer)                          \
+    X(BindBufferMemory)                            \
+    X(BindBufferMemory2)                           \
+    X(BindBufferMemory2KHR)                        \
+    X(BindImageMemory)                             \
+    X(BindImageMemory2)                            \
+    X(BindImageMemory2KHR)                         \
+    X(CmdBeginConditionalRenderingEXT)             \
+    X(CmdBeginRenderPass)                          \
+    X(CmdBeginRenderPass2)                         \
+    X(CmdBeginRenderPass2KHR)                      \
+    X(CmdBeginRendering)                           \
+    X(CmdBeginRenderingKHR)                        \
+    X(CmdBeginTransformFeedbackEXT)                \
+    X(CmdBindDescriptorBufferEmbeddedSamplersEXT)  \
+    X(CmdBindDescriptorBuffersEXT)                 \
+    X(CmdBindDescriptorSets)                       \
+    X(CmdBindIndexBuffer)                          \
+    X(CmdBindIndexBuffer2KHR)                      \
+    X(CmdBindTransformFeedbackBuffersEXT)          \
+    X(CmdBindVertexBuffers)                        \
+    X(CmdBindVertexBuffers2)                       \
+    X(CmdBindVertexBuffers2EXT)                    \
+    X(CmdBlitImage)                                \
+    X(CmdBlitImage2)                               \
+    X(CmdBlitImage2KHR)                            \
+    X(CmdBuildAccelerationStructuresIndirectKHR)   \
+    X(CmdBuildAccelerationStructuresKHR)           \
+    X(CmdClearColorImage)                          \
+    X(CmdClearDepthStencilImage)                   \
+    X(CmdCopyAccelerationStructureKHR)             \
+    X(CmdCopyAccelerationStructureToMemoryKHR)     \
+    X(CmdCopyBuffer)                               \
+    X(CmdCopyBuffer2)                              \
+    X(CmdCopyBuffer2KHR)                           \
+    X(CmdCopyBufferToImage)                        \
+    X(CmdCopyBufferToImage2)                       \
+    X(CmdCopyBufferToImage2KHR)                    \
+    X(CmdCopyImage)                                \
+    X(CmdCopyImage2)                               \
+    X(CmdCopyImage2KHR)                            \
+    X(CmdCopyImageToBuffer)                        \
+    X(CmdCopyImageToBuffer2)                       \
+    X(CmdCopyImageToBuffer2KHR)                    \
+    X(CmdCopyMemoryToAccelerationStructureKHR)     \
+    X(CmdCopyQueryPoolResults)                     \
+    X(CmdDispatchIndirect)                         \
+    X(CmdDrawIndexedIndirect)                      \
+    X(CmdDrawIndexedIndirectCount)                 \
+    X(CmdDrawIndexedIndirectCountKHR)              \
+    X(CmdDrawIndirect)                             \
+    X(CmdDrawIndirectByteCountEXT)                 \
+    X(CmdDrawIndirectCount)                        \
+    X(CmdDrawIndirectCountKHR)                     \
+    X(CmdEndTransformFeedbackEXT)                  \
+    X(CmdExecuteCommands)                          \
+    X(CmdFillBuffer)                               \
+    X(CmdPushDescriptorSetKHR)                     \
+    X(CmdPushDescriptorSetWithTemplateKHR)         \
+    X(CmdResolveImage)                             \
+    X(CmdResolveImage2)                            \
+    X(CmdResolveImage2KHR)                         \
+    X(CmdSetDescriptorBufferOffsetsEXT)            \
+    X(CmdTraceRaysIndirect2KHR)                    \
+    X(CmdTraceRaysIndirectKHR)                     \
+    X(CmdTraceRaysKHR)                             \
+    X(CmdUpdateBuffer)                             \
+    X(CmdWriteAccelerationStructuresPropertiesKHR) \
+    X(CmdWriteBufferMarker2AMD)                    \
+    X(CmdWriteBufferMarkerAMD)                     \
+    X(CreateBuffer)                                \
+    X(CreateBufferView)                            \
+    X(CreateFramebuffer)                           \
+    X(CreateImageView)                             \
+    X(DestroyBuffer)                               \
+    X(DestroyBufferView)                           \
+    X(DestroyCommandPool)                          \
+    X(DestroyDescriptorPool)                       \
+    X(DestroyFramebuffer)                          \
+    X(DestroyImage)                                \
+    X(DestroyImageView)                            \
+    X(FreeCommandBuffers)                          \
+    X(FreeDescriptorSets)                          \
+    X(ResetDescriptorPool)                         \
+    X(UpdateDescriptorSetWithTemplate)             \
+    X(UpdateDescriptorSetWithTemplateKHR)          \
+    X(UpdateDescriptorSets)
+struct DriverFunctions {
+#define MALI_WRAPPER_DECLARE_DRIVER_PROC(name) PFN_vk##name name = nullptr;
+    MALI_WRAPPER_REFERENCE_DRIVER_PROCS(MALI_WRAPPER_DECLARE_DRIVER_PROC)
+#undef MALI_WRAPPER_DECLARE_DRIVER_PROC
+};
+
+// vkCmd* entry points that name no buffer or image, or only as a
+// synchronization scope: barriers and events never read or write the
+// contents on their own.
+constexpr std::array<std::string_view, 127> memory_free_commands = {{
+    "vkCmdBeginDebugUtilsLabelEXT",
+    "vkCmdBeginQuery",
+    "vkCmdBeginQueryIndexedEXT",
+    "vkCmdBindPipeline",
+    "vkCmdBindShadersEXT",
+    "vkCmdClearAttachments",
+    "vkCmdDebugMarkerBeginEXT",
+    "vkCmdDebugMarkerEndEXT",
+    "vkCmdDebugMarkerInsertEXT",
+    "vkCmdDispatch",
+    "vkCmdDispatchBase",
+    "vkCmdDispatchBaseKHR",
+    "vkCmdDraw",
+    "vkCmdDrawIndexed",
+    "vkCmdDrawMultiEXT",
+    "vkCmdDrawMultiIndexedEXT",
+    "vkCmdEndConditionalRenderingEXT",
+    "vkCmdEndDebugUtilsLabelEXT",
+    "vkCmdEndQuery",
+    "vkCmdEndQueryIndexedEXT",
+    "vkCmdEndRenderPass",
+    "vkCmdEndRenderPass2",
+    "vkCmdEndRenderPass2KHR",
+    "vkCmdEndRendering",
+    "vkCmdEndRenderingKHR",
+    "vkCmdInsertDebugUtilsLabelEXT",
+    "vkCmdNextSubpass",
+    "vkCmdNextSubpass2",
+    "vkCmdNextSubpass2KHR",
+    "vkCmdPipelineBarrier",
+    "vkCmdPipelineBarrier2",
+    "vkCmdPipelineBarrier2KHR",
+    "vkCmdPushConstants",
+    "vkCmdPushConstants2",
+    "vkCmdPushConstants2KHR",
+    "vkCmdResetEvent",
+    "vkCmdResetEvent2",
+    "vkCmdResetEvent2KHR",
+    "vkCmdResetQueryPool",
+    "vkCmdSetAlphaToCoverageEnableEXT",
+    "vkCmdSetAlphaToOneEnableEXT",
+    "vkCmdSetAttachmentFeedbackLoopEnableEXT",
+    "vkCmdSetBlendConstants",
+    "vkCmdSetColorBlendAdvancedEXT",
+    "vkCmdSetColorBlendEnableEXT",
+    "vkCmdSetColorBlendEquationEXT",
+    "vkCmdSetColorWriteEnableEXT",
+    "vkCmdSetColorWriteMaskEXT",
+    "vkCmdSetConservativeRasterizationModeEXT",
+    "vkCmdSetCullMode",
+    "vkCmdSetCullModeEXT",
+    "vkCmdSetDepthBias",
+    "vkCmdSetDepthBias2EXT",
+    "vkCmdSetDepthBiasEnable",
+    "vkCmdSetDepthBiasEnableEXT",
+    "vkCmdSetDepthBounds",
+    "vkCmdSetDepthBoundsTestEnable",
+    "vkCmdSetDepthBoundsTestEnableEXT",
+    "vkCmdSetDepthClampEnableEXT",
+    "vkCmdSetDepthClampRangeEXT",
+    "vkCmdSetDepthClipEnableEXT",
+    "vkCmdSetDepthClipNegativeOneToOneEXT",
+    "vkCmdSetDepthCompareOp",
+    "vkCmdSetDepthCompareOpEXT",
+    "vkCmdSetDepthTestEnable",
+    "vkCmdSetDepthTestEnableEXT",
+    "vkCmdSetDepthWriteEnable",
+    "vkCmdSetDepthWriteEnableEXT",
+    "vkCmdSetDeviceMask",
+    "vkCmdSetDeviceMaskKHR",
+    "vkCmdSetDiscardRectangleEXT",
+    "vkCmdSetDiscardRectangleEnableEXT",
+    "vkCmdSetDiscardRectangleModeEXT",
+    "vkCmdSetEvent",
+    "vkCmdSetEvent2",
+    "vkCmdSetEvent2KHR",
+    "vkCmdSetExtraPrimitiveOverestimationSizeEXT",
+    "vkCmdSetFragmentShadingRateKHR",
+    "vkCmdSetFrontFace",
+    "vkCmdSetFrontFaceEXT",
+    "vkCmdSetLineRasterizationModeEXT",
+    "vkCmdSetLineStipple",
+    "vkCmdSetLineStippleEXT",
+    "vkCmdSetLineStippleEnableEXT",
+    "vkCmdSetLineStippleKHR",
+    "vkCmdSetLineWidth",
+    "vkCmdSetLogicOpEXT",
+    "vkCmdSetLogicOpEnableEXT",
+    "vkCmdSetPatchControlPointsEXT",
+    "vkCmdSetPolygonModeEXT",
+    "vkCmdSetPrimitiveRestartEnable",
+    "vkCmdSetPrimitiveRestartEnableEXT",
+    "vkCmdSetPrimitiveTopology",
+    "vkCmdSetPrimitiveTopologyEXT",
+    "vkCmdSetProvokingVertexModeEXT",
+    "vkCmdSetRasterizationSamplesEXT",
+    "vkCmdSetRasterizationStreamEXT",
+    "vkCmdSetRasterizerDiscardEnable",
+    "vkCmdSetRasterizerDiscardEnableEXT",
+    "vkCmdSetRenderingAttachmentLocations",
+    "vkCmdSetRenderingAttachmentLocationsKHR",
+    "vkCmdSetRenderingInputAttachmentIndices",
+    "vkCmdSetRenderingInputAttachmentIndicesKHR",
+    "vkCmdSetSampleLocationsEXT",
+    "vkCmdSetSampleLocationsEnableEXT",
+    "vkCmdSetSampleMaskEXT",
+    "vkCmdSetScissor",
+    "vkCmdSetScissorWithCount",
+    "vkCmdSetScissorWithCountEXT",
+    "vkCmdSetStencilCompareMask",
+    "vkCmdSetStencilOp",
+    "vkCmdSetStencilOpEXT",
+    "vkCmdSetStencilReference",
+    "vkCmdSetStencilTestEnable",
+    "vkCmdSetStencilTestEnableEXT",
+    "vkCmdSetStencilWriteMask",
+    "vkCmdSetTessellationDomainOriginEXT",
+    "vkCmdSetVertexInputEXT",
+    "vkCmdSetViewport",
+    "vkCmdSetViewportWithCount",
+    "vkCmdSetViewportWithCountEXT",
+    "vkCmdWaitEvents",
+    "vkCmdWaitEvents2",
+    "vkCmdWaitEvents2KHR",
+    "vkCmdWriteTimestamp",
+    "vkCmdWriteTimestamp2",
+    "vkCmdWriteTimestamp2KHR",
+}};
+static_assert(IsProcTableSorted(memory_free_commands), "memory_free_commands must stay sorted");
+
+constexpr uint32_t kMaxSecondaryDepth = 2;
+
+template <typename Handle>
+void add_unique(std::vector<Handle>& list, Handle handle)
+{
+    // Recently added handles are the likeliest repeats.
+    if (std::find(list.rbegin(), list.rend(), handle) == list.rend()) {
+        list.push_back(handle);
+    }
+}
+
+uint64_t descriptor_slot_key(uint32_t binding, uint32_t array_element)
+{
+    return (static_cast<uint64_t>(binding) << 32) | array_element;
+}
+
+template <typename T>
+const T* find_in_chain(const void* chain, VkStructureType type)
+{
+    for (auto* current = static_cast<const VkBaseInStructure*>(chain); current != nullptr; current = current->pNext) {
+        if (current->sType == type) {
+            return reinterpret_cast<const T*>(current);
+        }
+    }
+    return nullptr;
+}
+
+struct CommandBufferState {
+    SubmitReferenceTracker::Impl* owner = nullptr;
+    VkCommandPool pool = VK_NULL_HANDLE;
+    // Recording started through the hook; anything else is synced in full.
+    bool recorded = false;
+    bool references_all = false;
+    std::vector<VkDeviceMemory> memories;
+    // Resolved at submit time: update-after-bind sets may change after they
+    // were bound.
+    std::vector<VkDescriptorSet> descriptor_sets;
+    std::vector<VkCommandBuffer> secondaries;
+};
+
+struct DescriptorSetState {
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    // Written through an update template, whose layout is not followed here.
+    bool references_all = false;
+    // descriptor_slot_key() -> memory of the descriptor written there.
+    std::unordered_map<uint64_t, VkDeviceMemory> slots;
+};
+
+// Command buffers and devices of every tracker, for the hooks, which only
+// get a handle. Any removal bumps generation so the hooks' thread-local
+// lookups start over.
+struct Registry {
+    std::shared_mutex mutex;
+    std::unordered_map<VkCommandBuffer, std::unique_ptr<CommandBufferState>> command_buffers;
+    std::unordered_map<VkDevice, SubmitReferenceTracker::Impl*> devices;
+    std::atomic<uint64_t> generation{1};
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+} // namespace
+
+// Resources map to the memory they are bound to. VK_NULL_HANDLE stands for
+// resources that cannot be pinned to one allocation (sparse ones, images
+// with planes bound separately); a command buffer that names one syncs
+// everything. Resources the tracker never saw were created by the WSI layer
+// straight through the driver and never sit in application-mapped memory,
+// so they are left out.
+struct SubmitReferenceTracker::Impl {
+    VkDevice device = VK_NULL_HANDLE;
+    DriverFunctions functions;
+
+    mutable std::shared_mutex resources_mutex;
+    std::unordered_map<VkBuffer, VkDeviceMemory> buffers;
+    std::unordered_map<VkImage, VkDeviceMemory> images;
+    std::unordered_map<VkBufferView, VkDeviceMemory> buffer_views;
+    std::unordered_map<VkImageView, VkDeviceMemory> image_views;
+    std::unordered_map<VkFramebuffer, std::vector<VkDeviceMemory>> framebuffers;
+    // Shaders can reach these through any buffer device address.
+    std::unordered_set<VkDeviceMemory> device_address_memories;
+
+    mutable std::shared_mutex descriptors_mutex;
+    std::unordered_map<VkDescriptorSet, DescriptorSetState> descriptor_sets;
+    std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> pool_sets;
+
+    // A vkCmd* entry point the tracker knows nothing about was handed out;
+    // see NoteDriverProc().
+    std::atomic<bool> untracked_commands{false};
+
+    template <typename Handle>
+    static bool find_memory(const std::unordered_map<Handle, VkDeviceMemory>& map, Handle handle,
+                            VkDeviceMemory* memory)
+    {
+        if (handle == VK_NULL_HANDLE) {
+            return false;
+        }
+        auto it = map.find(handle);
+        if (it == map.end()) {
+            return false;
+        }
+        *memory = it->second;
+        return true;
+    }
+
+    // Memory behind one element of a descriptor write, with resources_mutex
+    // held. Returns false when the descriptor reaches no tracked memory.
+    bool resolve_descriptor_locked(const VkWriteDescriptorSet& write, uint32_t element, VkDeviceMemory* memory) const
+    {
+        switch (write.descriptorType) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK:
+            return false;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return write.pImageInfo != nullptr &&
+                   find_memory(image_views, write.pImageInfo[element].imageView, memory);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return write.pTexelBufferView != nullptr &&
+                   find_memory(buffer_views, write.pTexelBufferView[element], memory);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            return write.pBufferInfo != nullptr && find_memory(buffers, write.pBufferInfo[element].buffer, memory);
+        default:
+            // Acceleration structures and anything newer.
+            *memory = VK_NULL_HANDLE;
+            return true;
+        }
+    }
+
+    void forget_descriptor_sets_locked(VkDescriptorPool pool)
+    {
+        auto it = pool_sets.find(pool);
+        if (it == pool_sets.end()) {
+            return;
+        }
+        for (VkDescriptorSet set : it->second) {
+            // A freed handle may since have come back from another pool.
+            auto set_it = descriptor_sets.find(set);
+            if (set_it != descriptor_sets.end() && set_it->second.pool == pool) {
+                descriptor_sets.erase(set_it);
+            }
+        }
+        pool_sets.erase(it);
+    }
+
+    // Adds what command_buffer references, with the registry lock held.
+    // Returns false when it has to sync everything.
+    bool collect_command_buffer_locked(const Registry& reg, VkCommandBuffer command_buffer, uint32_t depth,
+                                       std::vector<VkDeviceMemory>* memories,
+                                       std::vector<VkDescriptorSet>* sets) const
+    {
+        auto it = reg.command_buffers.find(command_buffer);
+        if (it == reg.command_buffers.end()) {
+            return false;
+        }
+
+        const CommandBufferState& state = *it->second;
+        if (state.owner != this || !state.recorded || state.references_all) {
+            return false;
+        }
+
+        memories->insert(memories->end(), state.memories.begin(), state.memories.end());
+        sets->insert(sets->end(), state.descriptor_sets.begin(), state.descriptor_sets.end());
+        if (state.secondaries.empty()) {
+            return true;
+        }
+        if (depth >= kMaxSecondaryDepth) {
+            return false;
+        }
+        for (VkCommandBuffer secondary : state.secondaries) {
+            if (!collect_command_buffer_locked(reg, secondary, depth + 1, memories, sets)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename CommandBufferAt>
+    bool collect_command_buffers(uint32_t command_buffer_count, CommandBufferAt command_buffer_at,
+                                 std::vector<VkDeviceMemory>* memories, std::vector<VkDescriptorSet>* sets) const
+    {
+        Registry& reg = registry();
+        std::shared_lock<std::shared_mutex> lock(reg.mutex);
+        for (uint32_t i = 0; i < command_buffer_count; ++i) {
+            if (!collect_command_buffer_locked(reg, command_buffer_at(i), 0, memories, sets)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Adds the descriptor sets' memory and the device address memory, then
+    // sorts memories for the submit path's lookups.
+    bool finish_collection(std::vector<VkDescriptorSet>& sets, std::vector<VkDeviceMemory>* memories) const
+    {
+        if (!sets.empty()) {
+            std::sort(sets.begin(), sets.end());
+            sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+
+            std::shared_lock<std::shared_mutex> lock(descriptors_mutex);
+            for (VkDescriptorSet set : sets) {
+                auto it = descriptor_sets.find(set);
+                if (it == descriptor_sets.end()) {
+                    continue;
+                }
+                if (it->second.references_all) {
+                    return false;
+                }
+                for (const auto& slot : it->second.slots) {
+                    if (slot.second == VK_NULL_HANDLE) {
+                        return false;
+                    }
+                    memories->push_back(slot.second);
+                }
+            }
+        }
+
+        {
+            std::shared_lock<std::shared_mutex> lock(resources_mutex);
+            memories->insert(memories->end(), device_address_memories.begin(), device_address_memories.end());
+        }
+
+        std::sort(memories->begin(), memories->end());
+        memories->erase(std::unique(memories->begin(), memories->end()), memories->end());
+        return true;
+    }
+};
+
+namespace {
+
+SubmitReferenceTracker::Impl* lookup_device(VkDevice device)
+{
+    thread_local uint64_t cached_generation = 0;
+    thread_local VkDevice cached_device = VK_NULL_HANDLE;
+    thread_local SubmitReferenceTracker::Impl* cached_impl = nullptr;
+
+    Registry& reg = registry();
+    const uint64_t generation = reg.generation.load(std::memory_order_acquire);
+    if (device != VK_NULL_HANDLE && device == cached_device && generation == cached_generation) {
+        return cached_impl;
+    }
+
+    SubmitReferenceTracker::Impl* impl = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lock(reg.mutex);
+        auto it = reg.devices.find(device);
+        if (it != reg.devices.end()) {
+            impl = it->second;
+        }
+    }
+
+    if (impl != nullptr) {
+        cached_generation = generation;
+        cached_device = device;
+        cached_impl = impl;
+    }
+    return impl;
+}
+
+// What a vkCmd* hook works with: the driver entry points, and the reference
+// state of command buffers allocated through the hooks.
+class CommandReferences {
+public:
+    explicit CommandReferences(VkCommandBuffer command_buffer)
+    {
+        thread_local uint64_t cached_generation = 0;
+        thread_local VkCommandBuffer cached_command_buffer = VK_NULL_HANDLE;
+        thread_local SubmitReferenceTracker::Impl* cached_owner = nullptr;
+        thread_local CommandBufferState* cached_state = nullptr;
+
+        Registry& reg = registry();
+        const uint64_t generation = reg.generation.load(std::memory_order_acquire);
+        if (command_buffer != VK_NULL_HANDLE && command_buffer == cached_command_buffer &&
+            generation == cached_generation) {
+            owner_ = cached_owner;
+            state_ = cached_state;
+            return;
+        }
+
+        {
+            std::shared_lock<std::shared_mutex> lock(reg.mutex);
+            auto it = reg.command_buffers.find(command_buffer);
+            if (it != reg.command_buffers.end()) {
+                state_ = it->second.get();
+                owner_ = state_->owner;
+            } else if (!reg.devices.empty()) {
+                // Not allocated through the hooks; forward through any device,
+                // every one of them resolves the same driver.
+                owner_ = reg.devices.begin()->second;
+            }
+        }
+
+        if (state_ != nullptr) {
+            cached_generation = generation;
+            cached_command_buffer = command_buffer;
+            cached_owner = owner_;
+            cached_state = state_;
+        }
+    }
+
+    explicit operator bool() const { return owner_ != nullptr; }
+    const DriverFunctions& functions() const { return owner_->functions; }
+    CommandBufferState* state() const { return state_; }
+
+    void add_all()
+    {
+        if (state_ != nullptr) {
+            state_->references_all = true;
+        }
+    }
+
+    void add_memory(VkDeviceMemory memory)
+    {
+        if (memory == VK_NULL_HANDLE) {
+            state_->references_all = true;
+        } else {
+            add_unique(state_->memories, memory);
+        }
+    }
+
+    template <typename Handle>
+    void add(std::unordered_map<Handle, VkDeviceMemory> SubmitReferenceTracker::Impl::*map,
+             const Handle* handles, uint32_t count)
+    {
+        if (state_ == nullptr || handles == nullptr) {
+            return;
+        }
+        std::shared_lock<std::shared_mutex> lock(owner_->resources_mutex);
+        for (uint32_t i = 0; i < count; ++i) {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            if (SubmitReferenceTracker::Impl::find_memory(owner_->*map, handles[i], &memory)) {
+                add_memory(memory);
+            }
+        }
+    }
+
+    void add_buffer(VkBuffer buffer) { add(&SubmitReferenceTracker::Impl::buffers, &buffer, 1); }
+    void add_buffers(const VkBuffer* buffers, uint32_t count)
+    {
+        add(&SubmitReferenceTracker::Impl::buffers, buffers, count);
+    }
+    void add_image(VkImage image) { add(&SubmitReferenceTracker::Impl::images, &image, 1); }
+    void add_image_view(VkImageView view) { add(&SubmitReferenceTracker::Impl::image_views, &view, 1); }
+    void add_image_views(const VkImageView* views, uint32_t count)
+    {
+        add(&SubmitReferenceTracker::Impl::image_views, views, count);
+    }
+
+    void add_framebuffer(VkFramebuffer framebuffer)
+    {
+        if (state_ == nullptr || framebuffer == VK_NULL_HANDLE) {
+            return;
+        }
+        std::shared_lock<std::shared_mutex> lock(owner_->resources_mutex);
+        auto it = owner_->framebuffers.find(framebuffer);
+        if (it != owner_->framebuffers.end()) {
+            for (VkDeviceMemory memory : it->second) {
+                add_memory(memory);
+            }
+        }
+    }
+
+    void add_rendering_attachment(const VkRenderingAttachmentInfo* attachment)
+    {
+        if (attachment != nullptr) {
+            add_image_view(attachment->imageView);
+            add_image_view(attachment->resolveImageView);
+        }
+    }
+
+    void add_descriptor_sets(const VkDescriptorSet* sets, uint32_t count)
+    {
+        if (state_ == nullptr || sets == nullptr) {
+            return;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            if (sets[i] != VK_NULL_HANDLE) {
+                add_unique(state_->descriptor_sets, sets[i]);
+            }
+        }
+    }
+
+    void add_descriptor_writes(const VkWriteDescriptorSet* writes, uint32_t count)
+    {
+        if (state_ == nullptr || writes == nullptr) {
+            return;
+        }
+        std::shared_lock<std::shared_mutex> lock(owner_->resources_mutex);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (writes[i].descriptorType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK) {
+                continue;
+            }
+            for (uint32_t element = 0; element < writes[i].descriptorCount; ++element) {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                if (owner_->resolve_descriptor_locked(writes[i], element, &memory)) {
+                    add_memory(memory);
+                }
+            }
+        }
+    }
+
+private:
+    SubmitReferenceTracker::Impl* owner_ = nullptr;
+    CommandBufferState* state_ = nullptr;
+};
+
+void register_command_buffers(SubmitReferenceTracker::Impl* owner, VkCommandPool pool,
+                              uint32_t count, const VkCommandBuffer* command_buffers)
+{
+    Registry& reg = registry();
+    std::unique_lock<std::shared_mutex> lock(reg.mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto state = std::make_unique<CommandBufferState>();
+        state->owner = owner;
+        state->pool = pool;
+        reg.command_buffers[command_buffers[i]] = std::move(state);
+    }
+    // A handle the driver hands out again may still sit in a lookup cache.
+    reg.generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+template <typename Predicate>
+void unregister_command_buffers(Predicate matches)
+{
+    Registry& reg = registry();
+    std::unique_lock<std::shared_mutex> lock(reg.mutex);
+    for (auto it = reg.command_buffers.begin(); it != reg.command_buffers.end(); ) {
+        if (matches(*it->second)) {
+            it = reg.command_buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    reg.generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// ---- Command buffer lifetime ----
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkAllocateCommandBuffers(VkDevice device,
+                                                             const VkCommandBufferAllocateInfo* pAllocateInfo,
+                                                             VkCommandBuffer* pCommandBuffers)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.AllocateCommandBuffers(device, pAllocateInfo, pCommandBuffers);
+    if (result == VK_SUCCESS) {
+        register_command_buffers(impl, pAllocateInfo->commandPool, pAllocateInfo->commandBufferCount,
+                                 pCommandBuffers);
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkFreeCommandBuffers(VkDevice device, VkCommandPool commandPool,
+                                                     uint32_t commandBufferCount,
+                                                     const VkCommandBuffer* pCommandBuffers)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (pCommandBuffers != nullptr && commandBufferCount > 0) {
+        Registry& reg = registry();
+        std::unique_lock<std::shared_mutex> lock(reg.mutex);
+        for (uint32_t i = 0; i < commandBufferCount; ++i) {
+            reg.command_buffers.erase(pCommandBuffers[i]);
+        }
+        reg.generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+    impl->functions.FreeCommandBuffers(device, commandPool, commandBufferCount, pCommandBuffers);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool,
+                                                     const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (commandPool != VK_NULL_HANDLE) {
+        unregister_command_buffers([impl, commandPool](const CommandBufferState& state) {
+            return state.owner == impl && state.pool == commandPool;
+        });
+    }
+    impl->functions.DestroyCommandPool(device, commandPool, pAllocator);
+}
+
+// Pool resets need no hook: the command buffers must begin again before
+// they can be submitted.
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+                                                         const VkCommandBufferBeginInfo* pBeginInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (auto* state = references.state()) {
+        state->recorded = true;
+        state->references_all = false;
+        state->memories.clear();
+        state->descriptor_sets.clear();
+        state->secondaries.clear();
+    }
+    return references.functions().BeginCommandBuffer(commandBuffer, pBeginInfo);
+}
+
+// ---- Resources ----
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+                                                   const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.CreateBuffer(device, pCreateInfo, pAllocator, pBuffer);
+    if (result == VK_SUCCESS && (pCreateInfo->flags & VK_BUFFER_CREATE_SPARSE_BINDING_BIT) != 0) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->buffers[*pBuffer] = VK_NULL_HANDLE;
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+                                                const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (buffer != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->buffers.erase(buffer);
+    }
+    impl->functions.DestroyBuffer(device, buffer, pAllocator);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyImage(VkDevice device, VkImage image,
+                                               const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (image != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->images.erase(image);
+    }
+    impl->functions.DestroyImage(device, image, pAllocator);
+}
+
+void note_buffer_binds(SubmitReferenceTracker::Impl* impl, uint32_t count, const VkBindBufferMemoryInfo* infos)
+{
+    std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (infos[i].buffer != VK_NULL_HANDLE && infos[i].memory != VK_NULL_HANDLE) {
+            impl->buffers[infos[i].buffer] = infos[i].memory;
+        }
+    }
+}
+
+void note_image_binds(SubmitReferenceTracker::Impl* impl, uint32_t count, const VkBindImageMemoryInfo* infos)
+{
+    std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+    for (uint32_t i = 0; i < count; ++i) {
+        // Swapchain binds come with no memory; those images belong to the WSI.
+        if (infos[i].image == VK_NULL_HANDLE || infos[i].memory == VK_NULL_HANDLE) {
+            continue;
+        }
+        const bool plane = find_in_chain<VkBindImagePlaneMemoryInfo>(
+                               infos[i].pNext, VK_STRUCTURE_TYPE_BIND_IMAGE_PLANE_MEMORY_INFO) != nullptr;
+        impl->images[infos[i].image] = plane ? VK_NULL_HANDLE : infos[i].memory;
+    }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory,
+                                                       VkDeviceSize memoryOffset)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.BindBufferMemory(device, buffer, memory, memoryOffset);
+    if (result == VK_SUCCESS) {
+        VkBindBufferMemoryInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BIND_BUFFER_MEMORY_INFO;
+        info.buffer = buffer;
+        info.memory = memory;
+        info.memoryOffset = memoryOffset;
+        note_buffer_binds(impl, 1, &info);
+    }
+    return result;
+}
+
+template <PFN_vkBindBufferMemory2 DriverFunctions::*Driver>
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkBindBufferMemory2(VkDevice device, uint32_t bindInfoCount,
+                                                        const VkBindBufferMemoryInfo* pBindInfos)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = (impl->functions.*Driver)(device, bindInfoCount, pBindInfos);
+    if (result == VK_SUCCESS && pBindInfos != nullptr) {
+        note_buffer_binds(impl, bindInfoCount, pBindInfos);
+    }
+    return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory,
+                                                      VkDeviceSize memoryOffset)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.BindImageMemory(device, image, memory, memoryOffset);
+    if (result == VK_SUCCESS) {
+        VkBindImageMemoryInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_INFO;
+        info.image = image;
+        info.memory = memory;
+        info.memoryOffset = memoryOffset;
+        note_image_binds(impl, 1, &info);
+    }
+    return result;
+}
+
+template <PFN_vkBindImageMemory2 DriverFunctions::*Driver>
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkBindImageMemory2(VkDevice device, uint32_t bindInfoCount,
+                                                       const VkBindImageMemoryInfo* pBindInfos)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = (impl->functions.*Driver)(device, bindInfoCount, pBindInfos);
+    if (result == VK_SUCCESS && pBindInfos != nullptr) {
+        note_image_binds(impl, bindInfoCount, pBindInfos);
+    }
+    return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkCreateBufferView(VkDevice device, const VkBufferViewCreateInfo* pCreateInfo,
+                                                       const VkAllocationCallbacks* pAllocator, VkBufferView* pView)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.CreateBufferView(device, pCreateInfo, pAllocator, pView);
+    if (result == VK_SUCCESS) {
+        // Views need their resource bound already, so they resolve once, here.
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (SubmitReferenceTracker::Impl::find_memory(impl->buffers, pCreateInfo->buffer, &memory)) {
+            impl->buffer_views[*pView] = memory;
+        } else {
+            impl->buffer_views.erase(*pView);
+        }
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyBufferView(VkDevice device, VkBufferView bufferView,
+                                                    const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (bufferView != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->buffer_views.erase(bufferView);
+    }
+    impl->functions.DestroyBufferView(device, bufferView, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkCreateImageView(VkDevice device, const VkImageViewCreateInfo* pCreateInfo,
+                                                      const VkAllocationCallbacks* pAllocator, VkImageView* pView)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.CreateImageView(device, pCreateInfo, pAllocator, pView);
+    if (result == VK_SUCCESS) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (SubmitReferenceTracker::Impl::find_memory(impl->images, pCreateInfo->image, &memory)) {
+            impl->image_views[*pView] = memory;
+        } else {
+            impl->image_views.erase(*pView);
+        }
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyImageView(VkDevice device, VkImageView imageView,
+                                                   const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (imageView != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->image_views.erase(imageView);
+    }
+    impl->functions.DestroyImageView(device, imageView, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkCreateFramebuffer(VkDevice device, const VkFramebufferCreateInfo* pCreateInfo,
+                                                        const VkAllocationCallbacks* pAllocator,
+                                                        VkFramebuffer* pFramebuffer)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.CreateFramebuffer(device, pCreateInfo, pAllocator, pFramebuffer);
+    if (result == VK_SUCCESS) {
+        // Imageless framebuffers name their views in vkCmdBeginRenderPass.
+        std::vector<VkDeviceMemory> memories;
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        if ((pCreateInfo->flags & VK_FRAMEBUFFER_CREATE_IMAGELESS_BIT) == 0 && pCreateInfo->pAttachments != nullptr) {
+            for (uint32_t i = 0; i < pCreateInfo->attachmentCount; ++i) {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                if (SubmitReferenceTracker::Impl::find_memory(impl->image_views, pCreateInfo->pAttachments[i],
+                                                              &memory)) {
+                    add_unique(memories, memory);
+                }
+            }
+        }
+        impl->framebuffers[*pFramebuffer] = std::move(memories);
+    }
+    return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyFramebuffer(VkDevice device, VkFramebuffer framebuffer,
+                                                     const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    if (framebuffer != VK_NULL_HANDLE) {
+        std::unique_lock<std::shared_mutex> lock(impl->resources_mutex);
+        impl->framebuffers.erase(framebuffer);
+    }
+    impl->functions.DestroyFramebuffer(device, framebuffer, pAllocator);
+}
+
+// ---- Descriptor sets ----
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkAllocateDescriptorSets(VkDevice device,
+                                                             const VkDescriptorSetAllocateInfo* pAllocateInfo,
+                                                             VkDescriptorSet* pDescriptorSets)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    const VkResult result = impl->functions.AllocateDescriptorSets(device, pAllocateInfo, pDescriptorSets);
+    if (result == VK_SUCCESS) {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        auto& pool_sets = impl->pool_sets[pAllocateInfo->descriptorPool];
+        for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i) {
+            DescriptorSetState& state = impl->descriptor_sets[pDescriptorSets[i]];
+            if (state.pool != pAllocateInfo->descriptorPool) {
+                pool_sets.push_back(pDescriptorSets[i]);
+            }
+            state = DescriptorSetState{};
+            state.pool = pAllocateInfo->descriptorPool;
+        }
+    }
+    return result;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkFreeDescriptorSets(VkDevice device, VkDescriptorPool descriptorPool,
+                                                         uint32_t descriptorSetCount,
+                                                         const VkDescriptorSet* pDescriptorSets)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    if (pDescriptorSets != nullptr) {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        auto pool_it = impl->pool_sets.find(descriptorPool);
+        for (uint32_t i = 0; i < descriptorSetCount; ++i) {
+            if (impl->descriptor_sets.erase(pDescriptorSets[i]) == 0 || pool_it == impl->pool_sets.end()) {
+                continue;
+            }
+            auto& sets = pool_it->second;
+            auto set_it = std::find(sets.begin(), sets.end(), pDescriptorSets[i]);
+            if (set_it != sets.end()) {
+                *set_it = sets.back();
+                sets.pop_back();
+            }
+        }
+    }
+    return impl->functions.FreeDescriptorSets(device, descriptorPool, descriptorSetCount, pDescriptorSets);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL hook_vkResetDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool,
+                                                          VkDescriptorPoolResetFlags flags)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        impl->forget_descriptor_sets_locked(descriptorPool);
+    }
+    return impl->functions.ResetDescriptorPool(device, descriptorPool, flags);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool,
+                                                        const VkAllocationCallbacks* pAllocator)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        impl->forget_descriptor_sets_locked(descriptorPool);
+    }
+    impl->functions.DestroyDescriptorPool(device, descriptorPool, pAllocator);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount,
+                                                       const VkWriteDescriptorSet* pDescriptorWrites,
+                                                       uint32_t descriptorCopyCount,
+                                                       const VkCopyDescriptorSet* pDescriptorCopies)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    struct SlotWrite {
+        VkDescriptorSet set;
+        uint64_t slot;
+        bool has_memory;
+        VkDeviceMemory memory;
+    };
+    std::vector<SlotWrite> slot_writes;
+    if (pDescriptorWrites != nullptr) {
+        std::shared_lock<std::shared_mutex> lock(impl->resources_mutex);
+        for (uint32_t i = 0; i < descriptorWriteCount; ++i) {
+            const VkWriteDescriptorSet& write = pDescriptorWrites[i];
+            if (write.descriptorType == VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK) {
+                continue;
+            }
+            for (uint32_t element = 0; element < write.descriptorCount; ++element) {
+                SlotWrite slot_write{ write.dstSet,
+                                      descriptor_slot_key(write.dstBinding, write.dstArrayElement + element),
+                                      false, VK_NULL_HANDLE };
+                slot_write.has_memory = impl->resolve_descriptor_locked(write, element, &slot_write.memory);
+                slot_writes.push_back(slot_write);
+            }
+        }
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        for (const SlotWrite& slot_write : slot_writes) {
+            auto it = impl->descriptor_sets.find(slot_write.set);
+            if (it == impl->descriptor_sets.end()) {
+                continue;
+            }
+            if (slot_write.has_memory) {
+                it->second.slots[slot_write.slot] = slot_write.memory;
+            } else {
+                it->second.slots.erase(slot_write.slot);
+            }
+        }
+
+        for (uint32_t i = 0; pDescriptorCopies != nullptr && i < descriptorCopyCount; ++i) {
+            const VkCopyDescriptorSet& copy = pDescriptorCopies[i];
+            auto dst_it = impl->descriptor_sets.find(copy.dstSet);
+            if (dst_it == impl->descriptor_sets.end()) {
+                continue;
+            }
+            auto src_it = impl->descriptor_sets.find(copy.srcSet);
+            if (src_it != impl->descriptor_sets.end() && src_it->second.references_all) {
+                dst_it->second.references_all = true;
+            }
+            for (uint32_t element = 0; element < copy.descriptorCount; ++element) {
+                const uint64_t src_slot = descriptor_slot_key(copy.srcBinding, copy.srcArrayElement + element);
+                const uint64_t dst_slot = descriptor_slot_key(copy.dstBinding, copy.dstArrayElement + element);
+                bool has_memory = false;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                if (src_it != impl->descriptor_sets.end()) {
+                    auto slot_it = src_it->second.slots.find(src_slot);
+                    if (slot_it != src_it->second.slots.end()) {
+                        has_memory = true;
+                        memory = slot_it->second;
+                    }
+                }
+                if (has_memory) {
+                    dst_it->second.slots[dst_slot] = memory;
+                } else {
+                    dst_it->second.slots.erase(dst_slot);
+                }
+            }
+        }
+    }
+
+    impl->functions.UpdateDescriptorSets(device, descriptorWriteCount, pDescriptorWrites, descriptorCopyCount,
+                                         pDescriptorCopies);
+}
+
+template <PFN_vkUpdateDescriptorSetWithTemplate DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkUpdateDescriptorSetWithTemplate(VkDevice device, VkDescriptorSet descriptorSet,
+                                                                  VkDescriptorUpdateTemplate descriptorUpdateTemplate,
+                                                                  const void* pData)
+{
+    auto* impl = lookup_device(device);
+    if (impl == nullptr) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(impl->descriptors_mutex);
+        auto it = impl->descriptor_sets.find(descriptorSet);
+        if (it != impl->descriptor_sets.end()) {
+            it->second.references_all = true;
+        }
+    }
+    (impl->functions.*Driver)(device, descriptorSet, descriptorUpdateTemplate, pData);
+}
+
+// ---- Commands ----
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer,
+                                                        VkPipelineBindPoint pipelineBindPoint,
+                                                        VkPipelineLayout layout, uint32_t firstSet,
+                                                        uint32_t descriptorSetCount,
+                                                        const VkDescriptorSet* pDescriptorSets,
+                                                        uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_descriptor_sets(pDescriptorSets, descriptorSetCount);
+    references.functions().CmdBindDescriptorSets(commandBuffer, pipelineBindPoint, layout, firstSet,
+                                                 descriptorSetCount, pDescriptorSets, dynamicOffsetCount,
+                                                 pDynamicOffsets);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdPushDescriptorSetKHR(VkCommandBuffer commandBuffer,
+                                                          VkPipelineBindPoint pipelineBindPoint,
+                                                          VkPipelineLayout layout, uint32_t set,
+                                                          uint32_t descriptorWriteCount,
+                                                          const VkWriteDescriptorSet* pDescriptorWrites)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_descriptor_writes(pDescriptorWrites, descriptorWriteCount);
+    references.functions().CmdPushDescriptorSetKHR(commandBuffer, pipelineBindPoint, layout, set,
+                                                   descriptorWriteCount, pDescriptorWrites);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdPushDescriptorSetWithTemplateKHR(
+    VkCommandBuffer commandBuffer, VkDescriptorUpdateTemplate descriptorUpdateTemplate, VkPipelineLayout layout,
+    uint32_t set, const void* pData)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_all();
+    references.functions().CmdPushDescriptorSetWithTemplateKHR(commandBuffer, descriptorUpdateTemplate, layout,
+                                                               set, pData);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindVertexBuffers(VkCommandBuffer commandBuffer, uint32_t firstBinding,
+                                                       uint32_t bindingCount, const VkBuffer* pBuffers,
+                                                       const VkDeviceSize* pOffsets)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffers(pBuffers, bindingCount);
+    references.functions().CmdBindVertexBuffers(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets);
+}
+
+template <PFN_vkCmdBindVertexBuffers2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindVertexBuffers2(VkCommandBuffer commandBuffer, uint32_t firstBinding,
+                                                        uint32_t bindingCount, const VkBuffer* pBuffers,
+                                                        const VkDeviceSize* pOffsets, const VkDeviceSize* pSizes,
+                                                        const VkDeviceSize* pStrides)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffers(pBuffers, bindingCount);
+    (references.functions().*Driver)(commandBuffer, firstBinding, bindingCount, pBuffers, pOffsets, pSizes,
+                                     pStrides);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindIndexBuffer(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                                     VkDeviceSize offset, VkIndexType indexType)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(buffer);
+    references.functions().CmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindIndexBuffer2KHR(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                                         VkDeviceSize offset, VkDeviceSize size,
+                                                         VkIndexType indexType)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(buffer);
+    references.functions().CmdBindIndexBuffer2KHR(commandBuffer, buffer, offset, size, indexType);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBeginConditionalRenderingEXT(
+    VkCommandBuffer commandBuffer, const VkConditionalRenderingBeginInfoEXT* pConditionalRenderingBegin)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pConditionalRenderingBegin != nullptr) {
+        references.add_buffer(pConditionalRenderingBegin->buffer);
+    }
+    references.functions().CmdBeginConditionalRenderingEXT(commandBuffer, pConditionalRenderingBegin);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBindTransformFeedbackBuffersEXT(VkCommandBuffer commandBuffer,
+                                                                    uint32_t firstBinding, uint32_t bindingCount,
+                                                                    const VkBuffer* pBuffers,
+                                                                    const VkDeviceSize* pOffsets,
+                                                                    const VkDeviceSize* pSizes)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffers(pBuffers, bindingCount);
+    references.functions().CmdBindTransformFeedbackBuffersEXT(commandBuffer, firstBinding, bindingCount, pBuffers,
+                                                              pOffsets, pSizes);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBeginTransformFeedbackEXT(VkCommandBuffer commandBuffer,
+                                                              uint32_t firstCounterBuffer,
+                                                              uint32_t counterBufferCount,
+                                                              const VkBuffer* pCounterBuffers,
+                                                              const VkDeviceSize* pCounterBufferOffsets)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffers(pCounterBuffers, counterBufferCount);
+    references.functions().CmdBeginTransformFeedbackEXT(commandBuffer, firstCounterBuffer, counterBufferCount,
+                                                        pCounterBuffers, pCounterBufferOffsets);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdEndTransformFeedbackEXT(VkCommandBuffer commandBuffer,
+                                                            uint32_t firstCounterBuffer,
+                                                            uint32_t counterBufferCount,
+                                                            const VkBuffer* pCounterBuffers,
+                                                            const VkDeviceSize* pCounterBufferOffsets)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffers(pCounterBuffers, counterBufferCount);
+    references.functions().CmdEndTransformFeedbackEXT(commandBuffer, firstCounterBuffer, counterBufferCount,
+                                                      pCounterBuffers, pCounterBufferOffsets);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdDrawIndirectByteCountEXT(VkCommandBuffer commandBuffer, uint32_t instanceCount,
+                                                             uint32_t firstInstance, VkBuffer counterBuffer,
+                                                             VkDeviceSize counterBufferOffset,
+                                                             uint32_t counterOffset, uint32_t vertexStride)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(counterBuffer);
+    references.functions().CmdDrawIndirectByteCountEXT(commandBuffer, instanceCount, firstInstance, counterBuffer,
+                                                       counterBufferOffset, counterOffset, vertexStride);
+}
+
+template <PFN_vkCmdDrawIndirect DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdDrawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                                  VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(buffer);
+    (references.functions().*Driver)(commandBuffer, buffer, offset, drawCount, stride);
+}
+
+template <PFN_vkCmdDrawIndirectCount DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdDrawIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                                       VkDeviceSize offset, VkBuffer countBuffer,
+                                                       VkDeviceSize countBufferOffset, uint32_t maxDrawCount,
+                                                       uint32_t stride)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(buffer);
+    references.add_buffer(countBuffer);
+    (references.functions().*Driver)(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount,
+                                     stride);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer,
+                                                      VkDeviceSize offset)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(buffer);
+    references.functions().CmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer,
+                                                VkBuffer dstBuffer, uint32_t regionCount,
+                                                const VkBufferCopy* pRegions)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(srcBuffer);
+    references.add_buffer(dstBuffer);
+    references.functions().CmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyImage(VkCommandBuffer commandBuffer, VkImage srcImage,
+                                               VkImageLayout srcImageLayout, VkImage dstImage,
+                                               VkImageLayout dstImageLayout, uint32_t regionCount,
+                                               const VkImageCopy* pRegions)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(srcImage);
+    references.add_image(dstImage);
+    references.functions().CmdCopyImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+                                        regionCount, pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer,
+                                                       VkImage dstImage, VkImageLayout dstImageLayout,
+                                                       uint32_t regionCount, const VkBufferImageCopy* pRegions)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(srcBuffer);
+    references.add_image(dstImage);
+    references.functions().CmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage, dstImageLayout, regionCount,
+                                                pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyImageToBuffer(VkCommandBuffer commandBuffer, VkImage srcImage,
+                                                       VkImageLayout srcImageLayout, VkBuffer dstBuffer,
+                                                       uint32_t regionCount, const VkBufferImageCopy* pRegions)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(srcImage);
+    references.add_buffer(dstBuffer);
+    references.functions().CmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout, dstBuffer, regionCount,
+                                                pRegions);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBlitImage(VkCommandBuffer commandBuffer, VkImage srcImage,
+                                               VkImageLayout srcImageLayout, VkImage dstImage,
+                                               VkImageLayout dstImageLayout, uint32_t regionCount,
+                                               const VkImageBlit* pRegions, VkFilter filter)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(srcImage);
+    references.add_image(dstImage);
+    references.functions().CmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+                                        regionCount, pRegions, filter);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdResolveImage(VkCommandBuffer commandBuffer, VkImage srcImage,
+                                                  VkImageLayout srcImageLayout, VkImage dstImage,
+                                                  VkImageLayout dstImageLayout, uint32_t regionCount,
+                                                  const VkImageResolve* pRegions)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(srcImage);
+    references.add_image(dstImage);
+    references.functions().CmdResolveImage(commandBuffer, srcImage, srcImageLayout, dstImage, dstImageLayout,
+                                           regionCount, pRegions);
+}
+
+template <PFN_vkCmdCopyBuffer2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyBuffer2(VkCommandBuffer commandBuffer,
+                                                 const VkCopyBufferInfo2* pCopyBufferInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pCopyBufferInfo != nullptr) {
+        references.add_buffer(pCopyBufferInfo->srcBuffer);
+        references.add_buffer(pCopyBufferInfo->dstBuffer);
+    }
+    (references.functions().*Driver)(commandBuffer, pCopyBufferInfo);
+}
+
+template <PFN_vkCmdCopyImage2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyImage2(VkCommandBuffer commandBuffer, const VkCopyImageInfo2* pCopyImageInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pCopyImageInfo != nullptr) {
+        references.add_image(pCopyImageInfo->srcImage);
+        references.add_image(pCopyImageInfo->dstImage);
+    }
+    (references.functions().*Driver)(commandBuffer, pCopyImageInfo);
+}
+
+template <PFN_vkCmdCopyBufferToImage2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyBufferToImage2(VkCommandBuffer commandBuffer,
+                                                        const VkCopyBufferToImageInfo2* pCopyBufferToImageInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pCopyBufferToImageInfo != nullptr) {
+        references.add_buffer(pCopyBufferToImageInfo->srcBuffer);
+        references.add_image(pCopyBufferToImageInfo->dstImage);
+    }
+    (references.functions().*Driver)(commandBuffer, pCopyBufferToImageInfo);
+}
+
+template <PFN_vkCmdCopyImageToBuffer2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyImageToBuffer2(VkCommandBuffer commandBuffer,
+                                                        const VkCopyImageToBufferInfo2* pCopyImageToBufferInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pCopyImageToBufferInfo != nullptr) {
+        references.add_image(pCopyImageToBufferInfo->srcImage);
+        references.add_buffer(pCopyImageToBufferInfo->dstBuffer);
+    }
+    (references.functions().*Driver)(commandBuffer, pCopyImageToBufferInfo);
+}
+
+template <PFN_vkCmdBlitImage2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBlitImage2(VkCommandBuffer commandBuffer, const VkBlitImageInfo2* pBlitImageInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pBlitImageInfo != nullptr) {
+        references.add_image(pBlitImageInfo->srcImage);
+        references.add_image(pBlitImageInfo->dstImage);
+    }
+    (references.functions().*Driver)(commandBuffer, pBlitImageInfo);
+}
+
+template <PFN_vkCmdResolveImage2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdResolveImage2(VkCommandBuffer commandBuffer,
+                                                   const VkResolveImageInfo2* pResolveImageInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pResolveImageInfo != nullptr) {
+        references.add_image(pResolveImageInfo->srcImage);
+        references.add_image(pResolveImageInfo->dstImage);
+    }
+    (references.functions().*Driver)(commandBuffer, pResolveImageInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdClearColorImage(VkCommandBuffer commandBuffer, VkImage image,
+                                                     VkImageLayout imageLayout, const VkClearColorValue* pColor,
+                                                     uint32_t rangeCount, const VkImageSubresourceRange* pRanges)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(image);
+    references.functions().CmdClearColorImage(commandBuffer, image, imageLayout, pColor, rangeCount, pRanges);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdClearDepthStencilImage(VkCommandBuffer commandBuffer, VkImage image,
+                                                            VkImageLayout imageLayout,
+                                                            const VkClearDepthStencilValue* pDepthStencil,
+                                                            uint32_t rangeCount,
+                                                            const VkImageSubresourceRange* pRanges)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_image(image);
+    references.functions().CmdClearDepthStencilImage(commandBuffer, image, imageLayout, pDepthStencil, rangeCount,
+                                                     pRanges);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdUpdateBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer,
+                                                  VkDeviceSize dstOffset, VkDeviceSize dataSize, const void* pData)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(dstBuffer);
+    references.functions().CmdUpdateBuffer(commandBuffer, dstBuffer, dstOffset, dataSize, pData);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer,
+                                                VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(dstBuffer);
+    references.functions().CmdFillBuffer(commandBuffer, dstBuffer, dstOffset, size, data);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdCopyQueryPoolResults(VkCommandBuffer commandBuffer, VkQueryPool queryPool,
+                                                          uint32_t firstQuery, uint32_t queryCount,
+                                                          VkBuffer dstBuffer, VkDeviceSize dstOffset,
+                                                          VkDeviceSize stride, VkQueryResultFlags flags)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    references.add_buffer(dstBuffer);
+    references.functions().CmdCopyQueryPoolResults(commandBuffer, queryPool, firstQuery, queryCount, dstBuffer,
+                                                   dstOffset, stride, flags);
+}
+
+void add_render_pass_attachments(CommandReferences& references, const VkRenderPassBeginInfo* begin_info)
+{
+    if (begin_info == nullptr) {
+        return;
+    }
+    const auto* attachments = find_in_chain<VkRenderPassAttachmentBeginInfo>(
+        begin_info->pNext, VK_STRUCTURE_TYPE_RENDER_PASS_ATTACHMENT_BEGIN_INFO);
+    if (attachments != nullptr) {
+        references.add_image_views(attachments->pAttachments, attachments->attachmentCount);
+    } else {
+        references.add_framebuffer(begin_info->framebuffer);
+    }
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBeginRenderPass(VkCommandBuffer commandBuffer,
+                                                     const VkRenderPassBeginInfo* pRenderPassBegin,
+                                                     VkSubpassContents contents)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    add_render_pass_attachments(references, pRenderPassBegin);
+    references.functions().CmdBeginRenderPass(commandBuffer, pRenderPassBegin, contents);
+}
+
+template <PFN_vkCmdBeginRenderPass2 DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBeginRenderPass2(VkCommandBuffer commandBuffer,
+                                                      const VkRenderPassBeginInfo* pRenderPassBegin,
+                                                      const VkSubpassBeginInfo* pSubpassBeginInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    add_render_pass_attachments(references, pRenderPassBegin);
+    (references.functions().*Driver)(commandBuffer, pRenderPassBegin, pSubpassBeginInfo);
+}
+
+template <PFN_vkCmdBeginRendering DriverFunctions::*Driver>
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdBeginRendering(VkCommandBuffer commandBuffer,
+                                                    const VkRenderingInfo* pRenderingInfo)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (pRenderingInfo != nullptr) {
+        for (uint32_t i = 0; pRenderingInfo->pColorAttachments != nullptr && i < pRenderingInfo->colorAttachmentCount;
+             ++i) {
+            references.add_rendering_attachment(&pRenderingInfo->pColorAttachments[i]);
+        }
+        references.add_rendering_attachment(pRenderingInfo->pDepthAttachment);
+        references.add_rendering_attachment(pRenderingInfo->pStencilAttachment);
+    }
+    (references.functions().*Driver)(commandBuffer, pRenderingInfo);
+}
+
+VKAPI_ATTR void VKAPI_CALL hook_vkCmdExecuteCommands(VkCommandBuffer commandBuffer, uint32_t commandBufferCount,
+                                                     const VkCommandBuffer* pCommandBuffers)
+{
+    CommandReferences references(commandBuffer);
+    if (!references) {
+        return;
+    }
+    if (auto* state = references.state()) {
+        for (uint32_t i = 0; pCommandBuffers != nullptr && i < commandBufferCount; ++i) {
+            add_unique(state->secondaries, pCommandBuffers[i]);
+        }
+    }
+    references.functions().CmdExecuteCommands(commandBuffer, commandBufferCount, pCommandBuffers);
+}
+
+// Commands that reach memory in ways the tracker does not follow: descriptor
+// buffers, acceleration structures, ray tracing and buffer markers. Recording
+// one makes just that command buffer sync every shadow.
+template <typename Command>
+struct UntrackedCommand;
+
+template <typename... Args>
+struct UntrackedCommand<void(VKAPI_PTR*)(VkCommandBuffer, Args...)> {
+    template <void(VKAPI_PTR* DriverFunctions::*Driver)(VkCommandBuffer, Args...)>
+    static VKAPI_ATTR void VKAPI_CALL hook(VkCommandBuffer commandBuffer, Args... args)
+    {
+        CommandReferences references(commandBuffer);
+        if (!references) {
+            return;
+        }
+        references.add_all();
+        (references.functions().*Driver)(commandBuffer, args...);
+    }
+};
+
+struct HookEntry {
+    ProcTableGetter hook;
+    PFN_vkVoidFunction (*driver)(const DriverFunctions&);
+};
+
+template <auto Member>
+PFN_vkVoidFunction driver_proc(const DriverFunctions& functions)
+{
+    return reinterpret_cast<PFN_vkVoidFunction>(functions.*Member);
+}
+
+#define MALI_WRAPPER_HOOK(name) { "vk" #name, { ProcTableFunction<hook_vk##name>, driver_proc<&DriverFunctions::name> } }
+#define MALI_WRAPPER_ALIAS_HOOK(name, hook)                                                                    \
+    { "vk" #name, { ProcTableFunction<hook_vk##hook<&DriverFunctions::name>>, driver_proc<&DriverFunctions::name> } }
+#define MALI_WRAPPER_UNTRACKED_HOOK(name)                                                                      \
+    { "vk" #name,                                                                                              \
+      { ProcTableFunction<UntrackedCommand<PFN_vk##name>::hook<&DriverFunctions::name>>,                       \
+        driver_proc<&DriverFunctions::name> } }
+
+constexpr std::array<ProcTableEntry<HookEntry>, 89> hook_procs = {{
+    MALI_WRAPPER_HOOK(AllocateCommandBuffers),
+    MALI_WRAPPER_HOOK(AllocateDescriptorSets),
+    MALI_WRAPPER_HOOK(BeginCommandBuffer),
+    MALI_WRAPPER_HOOK(BindBufferMemory),
+    MALI_WRAPPER_ALIAS_HOOK(BindBufferMemory2, BindBufferMemory2),
+    MALI_WRAPPER_ALIAS_HOOK(BindBufferMemory2KHR, BindBufferMemory2),
+    MALI_WRAPPER_HOOK(BindImageMemory),
+    MALI_WRAPPER_ALIAS_HOOK(BindImageMemory2, BindImageMemory2),
+    MALI_WRAPPER_ALIAS_HOOK(BindImageMemory2KHR, BindImageMemory2),
+    MALI_WRAPPER_HOOK(CmdBeginConditionalRenderingEXT),
+    MALI_WRAPPER_HOOK(CmdBeginRenderPass),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBeginRenderPass2, CmdBeginRenderPass2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBeginRenderPass2KHR, CmdBeginRenderPass2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBeginRendering, CmdBeginRendering),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBeginRenderingKHR, CmdBeginRendering),
+    MALI_WRAPPER_HOOK(CmdBeginTransformFeedbackEXT),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdBindDescriptorBufferEmbeddedSamplersEXT),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdBindDescriptorBuffersEXT),
+    MALI_WRAPPER_HOOK(CmdBindDescriptorSets),
+    MALI_WRAPPER_HOOK(CmdBindIndexBuffer),
+    MALI_WRAPPER_HOOK(CmdBindIndexBuffer2KHR),
+    MALI_WRAPPER_HOOK(CmdBindTransformFeedbackBuffersEXT),
+    MALI_WRAPPER_HOOK(CmdBindVertexBuffers),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBindVertexBuffers2, CmdBindVertexBuffers2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBindVertexBuffers2EXT, CmdBindVertexBuffers2),
+    MALI_WRAPPER_HOOK(CmdBlitImage),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBlitImage2, CmdBlitImage2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdBlitImage2KHR, CmdBlitImage2),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdBuildAccelerationStructuresIndirectKHR),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdBuildAccelerationStructuresKHR),
+    MALI_WRAPPER_HOOK(CmdClearColorImage),
+    MALI_WRAPPER_HOOK(CmdClearDepthStencilImage),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdCopyAccelerationStructureKHR),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdCopyAccelerationStructureToMemoryKHR),
+    MALI_WRAPPER_HOOK(CmdCopyBuffer),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyBuffer2, CmdCopyBuffer2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyBuffer2KHR, CmdCopyBuffer2),
+    MALI_WRAPPER_HOOK(CmdCopyBufferToImage),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyBufferToImage2, CmdCopyBufferToImage2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyBufferToImage2KHR, CmdCopyBufferToImage2),
+    MALI_WRAPPER_HOOK(CmdCopyImage),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyImage2, CmdCopyImage2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyImage2KHR, CmdCopyImage2),
+    MALI_WRAPPER_HOOK(CmdCopyImageToBuffer),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyImageToBuffer2, CmdCopyImageToBuffer2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdCopyImageToBuffer2KHR, CmdCopyImageToBuffer2),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdCopyMemoryToAccelerationStructureKHR),
+    MALI_WRAPPER_HOOK(CmdCopyQueryPoolResults),
+    MALI_WRAPPER_HOOK(CmdDispatchIndirect),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndexedIndirect, CmdDrawIndirect),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndexedIndirectCount, CmdDrawIndirectCount),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndexedIndirectCountKHR, CmdDrawIndirectCount),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndirect, CmdDrawIndirect),
+    MALI_WRAPPER_HOOK(CmdDrawIndirectByteCountEXT),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndirectCount, CmdDrawIndirectCount),
+    MALI_WRAPPER_ALIAS_HOOK(CmdDrawIndirectCountKHR, CmdDrawIndirectCount),
+    MALI_WRAPPER_HOOK(CmdEndTransformFeedbackEXT),
+    MALI_WRAPPER_HOOK(CmdExecuteCommands),
+    MALI_WRAPPER_HOOK(CmdFillBuffer),
+    MALI_WRAPPER_HOOK(CmdPushDescriptorSetKHR),
+    MALI_WRAPPER_HOOK(CmdPushDescriptorSetWithTemplateKHR),
+    MALI_WRAPPER_HOOK(CmdResolveImage),
+    MALI_WRAPPER_ALIAS_HOOK(CmdResolveImage2, CmdResolveImage2),
+    MALI_WRAPPER_ALIAS_HOOK(CmdResolveImage2KHR, CmdResolveImage2),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdSetDescriptorBufferOffsetsEXT),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdTraceRaysIndirect2KHR),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdTraceRaysIndirectKHR),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdTraceRaysKHR),
+    MALI_WRAPPER_HOOK(CmdUpdateBuffer),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdWriteAccelerationStructuresPropertiesKHR),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdWriteBufferMarker2AMD),
+    MALI_WRAPPER_UNTRACKED_HOOK(CmdWriteBufferMarkerAMD),
+    MALI_WRAPPER_HOOK(CreateBuffer),
+    MALI_WRAPPER_HOOK(CreateBufferView),
+    MALI_WRAPPER_HOOK(CreateFramebuffer),
+    MALI_WRAPPER_HOOK(CreateImageView),
+    MALI_WRAPPER_HOOK(DestroyBuffer),
+    MALI_WRAPPER_HOOK(DestroyBufferView),
+    MALI_WRAPPER_HOOK(DestroyCommandPool),
+    MALI_WRAPPER_HOOK(DestroyDescriptorPool),
+    MALI_WRAPPER_HOOK(DestroyFramebuffer),
+    MALI_WRAPPER_HOOK(DestroyImage),
+    MALI_WRAPPER_HOOK(DestroyImageView),
+    MALI_WRAPPER_HOOK(FreeCommandBuffers),
+    MALI_WRAPPER_HOOK(FreeDescriptorSets),
+    MALI_WRAPPER_HOOK(ResetDescriptorPool),
+    MALI_WRAPPER_ALIAS_HOOK(UpdateDescriptorSetWithTemplate, UpdateDescriptorSetWithTemplate),
+    MALI_WRAPPER_ALIAS_HOOK(UpdateDescriptorSetWithTemplateKHR, UpdateDescriptorSetWithTemplate),
+    MALI_WRAPPER_HOOK(UpdateDescriptorSets),
+}};
+static_assert(IsProcTableSorted(hook_procs), "hook_procs must stay sorted");
+
+#undef MALI_WRAPPER_UNTRACKED_HOOK
+#undef MALI_WRAPPER_ALIAS_HOOK
+#undef MALI_WRAPPER_HOOK
+
+} // namespace
+
+std::shared_ptr<SubmitReferenceTracker> SubmitReferenceTracker::Create(VkDevice device,
+                                                                       PFN_vkGetDeviceProcAddr get_device_proc_addr)
+{
+    if (device == VK_NULL_HANDLE || get_device_proc_addr == nullptr) {
+        return nullptr;
+    }
+
+    auto impl = std::make_unique<Impl>();
+    impl->device = device;
+#define MALI_WRAPPER_RESOLVE_DRIVER_PROC(name) \
+    impl->functions.name = reinterpret_cast<PFN_vk##name>(get_device_proc_addr(device, "vk" #name));
+    MALI_WRAPPER_REFERENCE_DRIVER_PROCS(MALI_WRAPPER_RESOLVE_DRIVER_PROC)
+#undef MALI_WRAPPER_RESOLVE_DRIVER_PROC
+
+    // Without these the tracker would lose command buffers or bindings.
+    const DriverFunctions& functions = impl->functions;
+    if (functions.AllocateCommandBuffers == nullptr || functions.FreeCommandBuffers == nullptr ||
+        functions.DestroyCommandPool == nullptr || functions.BeginCommandBuffer == nullptr ||
+        functions.BindBufferMemory == nullptr || functions.BindImageMemory == nullptr ||
+        functions.AllocateDescriptorSets == nullptr || functions.UpdateDescriptorSets == nullptr) {
+        LOG_WARN("Submit reference tracking unavailable: driver lacks core command buffer entry points");
+        return nullptr;
+    }
+
+    {
+        Registry& reg = registry();
+        std::unique_lock<std::shared_mutex> lock(reg.mutex);
+        reg.devices[device] = impl.get();
+        reg.generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    LOG_INFO("Submit reference tracking enabled: submits sync only the shadows their command buffers reference");
+    return std::shared_ptr<SubmitReferenceTracker>(new SubmitReferenceTracker(std::move(impl)));
+}
+
+SubmitReferenceTracker::SubmitReferenceTracker(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+SubmitReferenceTracker::~SubmitReferenceTracker()
+{
+    Destroy();
+}
+
+void SubmitReferenceTracker::Destroy()
+{
+    Registry& reg = registry();
+    std::unique_lock<std::shared_mutex> lock(reg.mutex);
+    auto device_it = reg.devices.find(impl_->device);
+    if (device_it == reg.devices.end() || device_it->second != impl_.get()) {
+        return;
+    }
+
+    reg.devices.erase(device_it);
+    for (auto it = reg.command_buffers.begin(); it != reg.command_buffers.end(); ) {
+        if (it->second->owner == impl_.get()) {
+            it = reg.command_buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    reg.generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+PFN_vkVoidFunction SubmitReferenceTracker::GetHook(const char* name) const
+{
+    const auto* entry = FindProcTableEntry(hook_procs, name);
+    if (entry == nullptr || entry->value.driver(impl_->functions) == nullptr) {
+        return nullptr;
+    }
+    return entry->value.hook();
+}
+
+void SubmitReferenceTracker::NoteDriverProc(const char* name, PFN_vkVoidFunction proc)
+{
+    // Commands that touch memory the tracker cannot follow have hooks that
+    // fall back per command buffer when they are recorded. Only a command in
+    // neither table, whose signature is unknown here, still has to turn the
+    // tracking off for the whole device as soon as it is handed out.
+    if (proc == nullptr || name == nullptr || std::strncmp(name, "vkCmd", 5) != 0 ||
+        IsInProcTable(memory_free_commands, name)) {
+        return;
+    }
+
+    if (!impl_->untracked_commands.exchange(true, std::memory_order_relaxed)) {
+        LOG_WARN("Submit reference tracking off for this device: " + std::string(name) +
+                 " may reference memory and has no hook; every submit syncs all shadows");
+    }
+}
+
+void SubmitReferenceTracker::NoteMemoryAllocated(VkDeviceMemory memory, const VkMemoryAllocateInfo& info)
+{
+    const auto* flags_info = find_in_chain<VkMemoryAllocateFlagsInfo>(info.pNext,
+                                                                      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO);
+    if (flags_info == nullptr || (flags_info->flags & VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT) == 0) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(impl_->resources_mutex);
+    impl_->device_address_memories.insert(memory);
+}
+
+void SubmitReferenceTracker::NoteMemoryFreed(VkDeviceMemory memory)
+{
+    std::unique_lock<std::shared_mutex> lock(impl_->resources_mutex);
+    impl_->device_address_memories.erase(memory);
+}
+
+void SubmitReferenceTracker::NoteImageCreated(VkImage image, const VkImageCreateInfo& info)
+{
+    if ((info.flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT) == 0) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(impl_->resources_mutex);
+    impl_->images[image] = VK_NULL_HANDLE;
+}
+
+bool SubmitReferenceTracker::CollectReferences(uint32_t submit_count, const VkSubmitInfo* submits,
+                                               std::vector<VkDeviceMemory>* memories) const
+{
+    memories->clear();
+    if (impl_->untracked_commands.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    std::vector<VkDescriptorSet> sets;
+    for (uint32_t i = 0; submits != nullptr && i < submit_count; ++i) {
+        const VkSubmitInfo& submit = submits[i];
+        if (submit.commandBufferCount > 0 && submit.pCommandBuffers == nullptr) {
+            return false;
+        }
+        if (!impl_->collect_command_buffers(submit.commandBufferCount,
+                                            [&submit](uint32_t index) { return submit.pCommandBuffers[index]; },
+                                            memories, &sets)) {
+            return false;
+        }
+    }
+    return impl_->finish_collection(sets, memories);
+}
+
+bool SubmitReferenceTracker::CollectReferences(uint32_t submit_count, const VkSubmitInfo2* submits,
+                                               std::vector<VkDeviceMemory>* memories) const
+{
+    memories->clear();
+    if (impl_->untracked_commands.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    std::vector<VkDescriptorSet> sets;
+    for (uint32_t i = 0; submits != nullptr && i < submit_count; ++i) {
+        const VkSubmitInfo2& submit = submits[i];
+        if (submit.commandBufferInfoCount > 0 && submit.pCommandBufferInfos == nullptr) {
+            return false;
+        }
+        if (!impl_->collect_command_buffers(
+                submit.commandBufferInfoCount,
+                [&submit](uint32_t index) { return submit.pCommandBufferInfos[index].commandBuffer; }, memories,
+                &sets)) {
+            return false;
+        }
+    }
+    return impl_->finish_collection(sets, memories);
+}
+
+} // namespace mali_wrapper
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+namespace mali_wrapper {
+
+// Per-device record of the VkDeviceMemory objects each command buffer
+// references, for MALI_WRAPPER_LOW_ADDRESS_MAP=1,refsync. The wrapper hands
+// out its own memory binding, view, descriptor and vkCmd* bind/copy entry
+// points, resolves every buffer and image they name to its memory, and
+// submit-time shadow sync then writes back only the memory the submitted
+// command buffers use.
+//
+// Anything it cannot follow makes the whole submission sync as it would
+// without the tracker: descriptor update templates, sparse resources,
+// memory allocated for buffer device addresses (always synced), command
+// buffers it never saw begin, and command buffers that recorded a command
+// it does not resolve, such as descriptor buffer binds. A vkCmd* entry point
+// it does not know at all turns tracking off for the device once the
+// application resolves it.
+class SubmitReferenceTracker {
+public:
+    // Resolves the driver entry points behind the hooks. Returns nullptr when
+    // the driver lacks the core ones.
+    static std::shared_ptr<SubmitReferenceTracker> Create(VkDevice device,
+                                                          PFN_vkGetDeviceProcAddr get_device_proc_addr);
+
+    ~SubmitReferenceTracker();
+    SubmitReferenceTracker(const SubmitReferenceTracker&) = delete;
+    SubmitReferenceTracker& operator=(const SubmitReferenceTracker&) = delete;
+
+    // The wrapper's hook for a device entry point the tracker intercepts, or
+    // nullptr when it has none or the driver does not expose the function.
+    PFN_vkVoidFunction GetHook(const char* name) const;
+
+    // Called for device entry points handed out straight from the driver.
+    void NoteDriverProc(const char* name, PFN_vkVoidFunction proc);
+
+    void NoteMemoryAllocated(VkDeviceMemory memory, const VkMemoryAllocateInfo& info);
+    void NoteMemoryFreed(VkDeviceMemory memory);
+    // vkCreateImage stays with the wrapper; sparse images are noted here.
+    void NoteImageCreated(VkImage image, const VkImageCreateInfo& info);
+
+    // Fills memories, sorted and without duplicates, with what the
+    // submission's command buffers reference. Returns false when the
+    // submission has to sync every shadow.
+    bool CollectReferences(uint32_t submit_count, const VkSubmitInfo* submits,
+                           std::vector<VkDeviceMemory>* memories) const;
+    bool CollectReferences(uint32_t submit_count, const VkSubmitInfo2* submits,
+                           std::vector<VkDeviceMemory>* memories) const;
+
+    // Drops the device's command buffers from the hook lookups. Called before
+    // the device is destroyed.
+    void Destroy();
+
+    struct Impl;
+
+private:
+    explicit SubmitReferenceTracker(std::unique_ptr<Impl> impl);
+
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace mali_wrapper
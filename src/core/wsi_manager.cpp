@@ -1,12 +1,15 @@
 #include "wsi_manager.hpp"
 #include "mali_wrapper_icd.hpp"
 #include "library_loader.hpp"
+#include "metrics_page.hpp"
+#include "proc_table.hpp"
 #include "wsi/surface_api.hpp"
 #include "wsi/swapchain_api.hpp"
 #include "wsi/wsi_private_data.hpp"
 #include <vulkan/vk_layer.h>
 #include "wsi/wayland/surface_properties.hpp"
 #include "../utils/logging.hpp"
+#include "../utils/startup_profile.hpp"
 #include <unordered_map>
 #include <mutex>
 #include <algorithm>
@@ -20,6 +23,17 @@ extern "C" {
     VkResult CreateWaylandSurfaceKHR(VkInstance instance, const VkWaylandSurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
     VkResult CreateXcbSurfaceKHR(VkInstance instance, const VkXcbSurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
     VkResult CreateXlibSurfaceKHR(VkInstance instance, const VkXlibSurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
+    VkResult CreateDisplayPlaneSurfaceKHR(VkInstance instance, const VkDisplaySurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
+}
+
+extern "C" {
+    VkResult GetPhysicalDeviceDisplayPropertiesKHR(VkPhysicalDevice physicalDevice, uint32_t* pPropertyCount, VkDisplayPropertiesKHR* pProperties);
+    VkResult GetPhysicalDeviceDisplayPlanePropertiesKHR(VkPhysicalDevice physicalDevice, uint32_t* pPropertyCount, VkDisplayPlanePropertiesKHR* pProperties);
+    VkResult GetDisplayPlaneSupportedDisplaysKHR(VkPhysicalDevice physicalDevice, uint32_t planeIndex, uint32_t* pDisplayCount, VkDisplayKHR* pDisplays);
+    VkResult GetDisplayModePropertiesKHR(VkPhysicalDevice physicalDevice, VkDisplayKHR display, uint32_t* pPropertyCount, VkDisplayModePropertiesKHR* pProperties);
+    VkResult CreateDisplayModeKHR(VkPhysicalDevice physicalDevice, VkDisplayKHR display, const VkDisplayModeCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDisplayModeKHR* pMode);
+    VkResult GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkDisplayModeKHR mode, uint32_t planeIndex, VkDisplayPlaneCapabilitiesKHR* pCapabilities);
+    VkResult ReleaseDisplayEXT(VkPhysicalDevice physicalDevice, VkDisplayKHR display);
 }
 
 extern "C" {
@@ -61,6 +75,17 @@ VkResult VKAPI_CALL NoOpSetDeviceLoaderData(VkDevice device, void *object)
    }
    return VK_SUCCESS;
 }
+
+static_assert(util::ALLOCATION_SCOPE_COUNT == kMetricsAllocationScopes,
+              "metrics page host allocations must cover every allocation scope");
+
+void fill_metrics_page_host_allocations(MetricsHostAllocations* values) {
+    util::allocation_stats stats[util::ALLOCATION_SCOPE_COUNT] = {};
+    util::get_allocation_stats(stats);
+    for (uint32_t i = 0; i < util::ALLOCATION_SCOPE_COUNT; ++i) {
+        values[i] = {stats[i].allocations, stats[i].frees, stats[i].bytes, stats[i].live_bytes};
+    }
+}
 } // namespace
 
 bool is_dummy_surface(VkSurfaceKHR surface) {
@@ -100,6 +125,12 @@ struct WSIManager::Impl {
 };
 
 WSIManager::WSIManager() : pImpl(std::make_unique<Impl>()) {
+    MetricsPage& metrics = MetricsPage::Instance();
+    if (metrics.IsEnabled()) {
+        // Before the WSI layer allocates anything, so live bytes stay exact.
+        util::enable_allocation_accounting();
+        metrics.SetHostAllocationSource(fill_metrics_page_host_allocations);
+    }
 }
 
 WSIManager::~WSIManager() {
@@ -133,7 +164,11 @@ VkResult WSIManager::initialize(VkInstance instance, VkPhysicalDevice physicalDe
         return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    auto result = dispatch_table->populate(instance, mali_get_instance_proc_addr);
+    VkResult result;
+    {
+        StartupPhaseScope symbols_scope(StartupPhase::SYMBOL_RESOLUTION);
+        result = dispatch_table->populate(instance, mali_get_instance_proc_addr);
+    }
     if (result != VK_SUCCESS) {
         LOG_ERROR("Failed to populate instance dispatch table with Mali functions");
         return result;
@@ -151,6 +186,9 @@ VkResult WSIManager::initialize(VkInstance instance, VkPhysicalDevice physicalDe
 #if BUILD_WSI_HEADLESS
     platforms.add(VK_ICD_WSI_PLATFORM_HEADLESS);
 #endif
+#if BUILD_WSI_DISPLAY
+    platforms.add(VK_ICD_WSI_PLATFORM_DISPLAY);
+#endif
 
     result = instance_private_data::associate(instance, std::move(*dispatch_table), NoOpSetInstanceLoaderData,
                                               platforms, VK_API_VERSION_1_0, wsi_allocator);
@@ -390,6 +428,20 @@ VkResult WSIManager::create_surface_headless(VkInstance instance, const VkHeadle
     return VK_SUCCESS;
 }
 
+VkResult WSIManager::create_surface_display(VkInstance instance, const VkDisplaySurfaceCreateInfoKHR* pCreateInfo,
+                                           const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface) {
+
+    mali_wrapper::add_instance_reference(instance);
+
+    VkResult result = CreateDisplayPlaneSurfaceKHR(instance, pCreateInfo, pAllocator, pSurface);
+
+    if (result != VK_SUCCESS) {
+        mali_wrapper::remove_instance_reference(instance);
+    }
+
+    return result;
+}
+
 VkResult WSIManager::destroy_surface(VkInstance instance, VkSurfaceKHR surface, const VkAllocationCallbacks* pAllocator) {
 
     if (is_dummy_surface(surface)) {
@@ -564,7 +616,16 @@ VkResult WSIManager::create_swapchain(VkDevice device, const VkSwapchainCreateIn
     return result;
 }
 
+static uint64_t swapchain_metrics_key(VkSwapchainKHR swapchain) {
+#if defined(VK_USE_64_BIT_PTR_DEFINES) && (VK_USE_64_BIT_PTR_DEFINES == 1)
+    return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(swapchain));
+#else
+    return static_cast<uint64_t>(swapchain);
+#endif
+}
+
 VkResult WSIManager::destroy_swapchain(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* pAllocator) {
+    MetricsPage::Instance().ForgetSwapchain(swapchain_metrics_key(swapchain));
     wsi_layer_vkDestroySwapchainKHR(device, swapchain, pAllocator);
     return VK_SUCCESS;
 }
@@ -584,7 +645,18 @@ VkResult WSIManager::acquire_next_image2(VkDevice device, const VkAcquireNextIma
 }
 
 VkResult WSIManager::queue_present(VkQueue queue, const VkPresentInfoKHR* pPresentInfo) {
-    return wsi_layer_vkQueuePresentKHR(queue, pPresentInfo);
+    const VkResult result = wsi_layer_vkQueuePresentKHR(queue, pPresentInfo);
+    NotifyQueuePresented(queue);
+
+    MetricsPage& metrics = MetricsPage::Instance();
+    if (metrics.IsEnabled() && pPresentInfo != nullptr) {
+        for (uint32_t i = 0; i < pPresentInfo->swapchainCount; ++i) {
+            const VkResult swapchain_result =
+                (pPresentInfo->pResults != nullptr) ? pPresentInfo->pResults[i] : result;
+            metrics.RecordPresent(swapchain_metrics_key(pPresentInfo->pSwapchains[i]), swapchain_result >= 0);
+        }
+    }
+    return result;
 }
 
 VkResult WSIManager::get_swapchain_status(VkDevice device, VkSwapchainKHR swapchain) {
@@ -604,41 +676,6 @@ VkResult WSIManager::get_physical_device_present_rectangles(VkPhysicalDevice phy
     return wsi_GetPhysicalDevicePresentRectanglesKHR(physicalDevice, surface, pRectCount, pRects);
 }
 
-bool WSIManager::is_wsi_function(const char* function_name) {
-    if (!function_name) return false;
-
-    // Surface functions
-    if (strcmp(function_name, "vkCreateXlibSurfaceKHR") == 0) return true;
-    if (strcmp(function_name, "vkCreateXcbSurfaceKHR") == 0) return true;
-    if (strcmp(function_name, "vkCreateWaylandSurfaceKHR") == 0) return true;
-    if (strcmp(function_name, "vkCreateDisplaySurfaceKHR") == 0) return true;
-    if (strcmp(function_name, "vkCreateHeadlessSurfaceEXT") == 0) return true;
-    if (strcmp(function_name, "vkDestroySurfaceKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceSupportKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceCapabilities2KHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceFormatsKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceFormats2KHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfacePresentModesKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDeviceWaylandPresentationSupportKHR") == 0) return true;
-
-    // Swapchain functions
-    if (strcmp(function_name, "vkCreateSwapchainKHR") == 0) return true;
-    if (strcmp(function_name, "vkDestroySwapchainKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetSwapchainImagesKHR") == 0) return true;
-    if (strcmp(function_name, "vkAcquireNextImageKHR") == 0) return true;
-    if (strcmp(function_name, "vkAcquireNextImage2KHR") == 0) return true;
-    if (strcmp(function_name, "vkQueuePresentKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetSwapchainStatusKHR") == 0) return true;
-
-    // Device group functions
-    if (strcmp(function_name, "vkGetDeviceGroupPresentCapabilitiesKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetDeviceGroupSurfacePresentModesKHR") == 0) return true;
-    if (strcmp(function_name, "vkGetPhysicalDevicePresentRectanglesKHR") == 0) return true;
-
-    return false;
-}
-
 static VKAPI_ATTR VkResult VKAPI_CALL static_vkCreateXcbSurfaceKHR(VkInstance instance, const VkXcbSurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface) {
     return GetWSIManager().create_surface_xcb(instance, pCreateInfo, pAllocator, pSurface);
 }
@@ -655,6 +692,10 @@ static VKAPI_ATTR VkResult VKAPI_CALL static_vkCreateHeadlessSurfaceEXT(VkInstan
     return GetWSIManager().create_surface_headless(instance, pCreateInfo, pAllocator, pSurface);
 }
 
+static VKAPI_ATTR VkResult VKAPI_CALL static_vkCreateDisplayPlaneSurfaceKHR(VkInstance instance, const VkDisplaySurfaceCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface) {
+    return GetWSIManager().create_surface_display(instance, pCreateInfo, pAllocator, pSurface);
+}
+
 static VKAPI_ATTR void VKAPI_CALL static_vkDestroySurfaceKHR(VkInstance instance, VkSurfaceKHR surface, const VkAllocationCallbacks* pAllocator) {
     GetWSIManager().destroy_surface(instance, surface, pAllocator);
 }
@@ -715,75 +756,57 @@ static VKAPI_ATTR VkResult VKAPI_CALL static_vkGetSwapchainStatusKHR(VkDevice de
     return GetWSIManager().get_swapchain_status(device, swapchain);
 }
 
-PFN_vkVoidFunction WSIManager::get_function_pointer(const char* function_name) {
-    if (!function_name || !is_wsi_function(function_name)) {
-        return nullptr;
-    }
-
-    // Surface creation functions
-    if (strcmp(function_name, "vkCreateXcbSurfaceKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkCreateXcbSurfaceKHR);
-    }
-    if (strcmp(function_name, "vkCreateXlibSurfaceKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkCreateXlibSurfaceKHR);
-    }
-    if (strcmp(function_name, "vkCreateWaylandSurfaceKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkCreateWaylandSurfaceKHR);
-    }
-    if (strcmp(function_name, "vkCreateHeadlessSurfaceEXT") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkCreateHeadlessSurfaceEXT);
-    }
-    if (strcmp(function_name, "vkDestroySurfaceKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkDestroySurfaceKHR);
-    }
-
-    // Surface property functions
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceSupportKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfaceSupportKHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceCapabilities2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfaceCapabilities2KHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceFormatsKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfaceFormatsKHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfaceFormats2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfaceFormats2KHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceSurfacePresentModesKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceSurfacePresentModesKHR);
-    }
-    if (strcmp(function_name, "vkGetPhysicalDeviceWaylandPresentationSupportKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetPhysicalDeviceWaylandPresentationSupportKHR);
-    }
+// Every WSI entry point handled here, in strcmp order. A null getter marks a
+// function that is claimed but not implemented, so lookups return nullptr
+// instead of falling through to the driver. Without BUILD_WSI_DISPLAY the
+// VK_KHR_display queries are left to the driver.
+#if BUILD_WSI_DISPLAY
+#define WSI_DISPLAY_PROC(fn) ProcTableFunction<fn>
+#else
+#define WSI_DISPLAY_PROC(fn) nullptr
+#endif
+static constexpr std::array<ProcTableEntry<ProcTableGetter>, 30> wsi_procs = {{
+    { "vkAcquireNextImage2KHR", ProcTableFunction<static_vkAcquireNextImage2KHR> },
+    { "vkAcquireNextImageKHR", ProcTableFunction<static_vkAcquireNextImageKHR> },
+    { "vkCreateDisplayModeKHR", WSI_DISPLAY_PROC(CreateDisplayModeKHR) },
+    { "vkCreateDisplayPlaneSurfaceKHR", WSI_DISPLAY_PROC(static_vkCreateDisplayPlaneSurfaceKHR) },
+    { "vkCreateHeadlessSurfaceEXT", ProcTableFunction<static_vkCreateHeadlessSurfaceEXT> },
+    { "vkCreateSwapchainKHR", ProcTableFunction<static_vkCreateSwapchainKHR> },
+    { "vkCreateWaylandSurfaceKHR", ProcTableFunction<static_vkCreateWaylandSurfaceKHR> },
+    { "vkCreateXcbSurfaceKHR", ProcTableFunction<static_vkCreateXcbSurfaceKHR> },
+    { "vkCreateXlibSurfaceKHR", ProcTableFunction<static_vkCreateXlibSurfaceKHR> },
+    { "vkDestroySurfaceKHR", ProcTableFunction<static_vkDestroySurfaceKHR> },
+    { "vkDestroySwapchainKHR", ProcTableFunction<static_vkDestroySwapchainKHR> },
+    { "vkGetDeviceGroupPresentCapabilitiesKHR", nullptr },
+    { "vkGetDeviceGroupSurfacePresentModesKHR", nullptr },
+    { "vkGetDisplayModePropertiesKHR", WSI_DISPLAY_PROC(GetDisplayModePropertiesKHR) },
+    { "vkGetDisplayPlaneCapabilitiesKHR", WSI_DISPLAY_PROC(GetDisplayPlaneCapabilitiesKHR) },
+    { "vkGetDisplayPlaneSupportedDisplaysKHR", WSI_DISPLAY_PROC(GetDisplayPlaneSupportedDisplaysKHR) },
+    { "vkGetPhysicalDeviceDisplayPlanePropertiesKHR", WSI_DISPLAY_PROC(GetPhysicalDeviceDisplayPlanePropertiesKHR) },
+    { "vkGetPhysicalDeviceDisplayPropertiesKHR", WSI_DISPLAY_PROC(GetPhysicalDeviceDisplayPropertiesKHR) },
+    { "vkGetPhysicalDevicePresentRectanglesKHR", nullptr },
+    { "vkGetPhysicalDeviceSurfaceCapabilities2KHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfaceCapabilities2KHR> },
+    { "vkGetPhysicalDeviceSurfaceCapabilitiesKHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfaceCapabilitiesKHR> },
+    { "vkGetPhysicalDeviceSurfaceFormats2KHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfaceFormats2KHR> },
+    { "vkGetPhysicalDeviceSurfaceFormatsKHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfaceFormatsKHR> },
+    { "vkGetPhysicalDeviceSurfacePresentModesKHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfacePresentModesKHR> },
+    { "vkGetPhysicalDeviceSurfaceSupportKHR", ProcTableFunction<static_vkGetPhysicalDeviceSurfaceSupportKHR> },
+    { "vkGetPhysicalDeviceWaylandPresentationSupportKHR", ProcTableFunction<static_vkGetPhysicalDeviceWaylandPresentationSupportKHR> },
+    { "vkGetSwapchainImagesKHR", ProcTableFunction<static_vkGetSwapchainImagesKHR> },
+    { "vkGetSwapchainStatusKHR", ProcTableFunction<static_vkGetSwapchainStatusKHR> },
+    { "vkQueuePresentKHR", ProcTableFunction<static_vkQueuePresentKHR> },
+    { "vkReleaseDisplayEXT", WSI_DISPLAY_PROC(ReleaseDisplayEXT) },
+}};
+#undef WSI_DISPLAY_PROC
+static_assert(IsProcTableSorted(wsi_procs), "wsi_procs must stay sorted");
 
-    // Swapchain functions
-    if (strcmp(function_name, "vkCreateSwapchainKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkCreateSwapchainKHR);
-    }
-    if (strcmp(function_name, "vkDestroySwapchainKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkDestroySwapchainKHR);
-    }
-    if (strcmp(function_name, "vkGetSwapchainImagesKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetSwapchainImagesKHR);
-    }
-    if (strcmp(function_name, "vkAcquireNextImageKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkAcquireNextImageKHR);
-    }
-    if (strcmp(function_name, "vkAcquireNextImage2KHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkAcquireNextImage2KHR);
-    }
-    if (strcmp(function_name, "vkQueuePresentKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkQueuePresentKHR);
-    }
-    if (strcmp(function_name, "vkGetSwapchainStatusKHR") == 0) {
-        return reinterpret_cast<PFN_vkVoidFunction>(static_vkGetSwapchainStatusKHR);
-    }
+bool WSIManager::is_wsi_function(const char* function_name) {
+    return FindProcTableEntry(wsi_procs, function_name) != nullptr;
+}
 
-    return nullptr;
+PFN_vkVoidFunction WSIManager::get_function_pointer(const char* function_name) {
+    const auto* entry = FindProcTableEntry(wsi_procs, function_name);
+    return (entry != nullptr && entry->value != nullptr) ? entry->value() : nullptr;
 }
 
 
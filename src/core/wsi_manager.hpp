@@ -43,6 +43,8 @@ public:
                                    const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
     VkResult create_surface_headless(VkInstance instance, const VkHeadlessSurfaceCreateInfoEXT* pCreateInfo,
                                     const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
+    VkResult create_surface_display(VkInstance instance, const VkDisplaySurfaceCreateInfoKHR* pCreateInfo,
+                                   const VkAllocationCallbacks* pAllocator, VkSurfaceKHR* pSurface);
     VkResult destroy_surface(VkInstance instance, VkSurfaceKHR surface, const VkAllocationCallbacks* pAllocator);
 
     // Surface properties
@@ -0,0 +1,723 @@
+// mali_wrapper_bench: times the low-address engine outside an application and
+// prints ns/op and GB/s per case as key=value lines.
+//
+//   mali_wrapper_bench                    every case
+//   mali_wrapper_bench <case>...          only the named cases
+//   mali_wrapper_bench --host <case>...   plain high memory, even with a driver
+//
+// Shadow copies are always measured. Allocations come from the Mali driver
+// when it loads and has a host-visible memory type, otherwise from high
+// anonymous memory; ALIAS results follow only when the driver is used and the
+// kbase low32 alias ioctl probe passes. The engine options still come from
+// MALI_WRAPPER_LOW_ADDRESS_MAP, which defaults to 1 here, so the same tokens
+// (dirty, lazy, nocache, hugepages, ...) select the variant being measured.
+
+#include "../core/copy_engine.hpp"
+#include "../core/copy_kernels.hpp"
+#include "../core/harness.hpp"
+#include "../core/library_loader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+namespace harness = mali_wrapper::harness;
+
+namespace {
+
+constexpr size_t kKiB = 1024;
+constexpr size_t kMiB = 1024 * 1024;
+// Bytes each timed case moves at most, so large sizes run fewer iterations.
+constexpr size_t kCaseByteBudget = 256 * kMiB;
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+size_t iterations_for(size_t bytes_per_op, size_t min_iterations, size_t max_iterations) {
+    const size_t budgeted = bytes_per_op > 0 ? kCaseByteBudget / bytes_per_op : max_iterations;
+    return std::max(min_iterations, std::min(max_iterations, budgeted));
+}
+
+std::string size_label(size_t size) {
+    if (size >= kMiB && size % kMiB == 0) {
+        return std::to_string(size / kMiB) + "m";
+    }
+    if (size >= kKiB && size % kKiB == 0) {
+        return std::to_string(size / kKiB) + "k";
+    }
+    return std::to_string(size);
+}
+
+// One line pair per measurement; bytes of 0 leaves out gb_per_s.
+void report(const std::string& key, uint64_t elapsed_ns, uint64_t ops, uint64_t bytes) {
+    const double ns_per_op = ops > 0 ? static_cast<double>(elapsed_ns) / static_cast<double>(ops) : 0.0;
+    std::printf("%s.ops=%" PRIu64 "\n", key.c_str(), ops);
+    std::printf("%s.ns_per_op=%.1f\n", key.c_str(), ns_per_op);
+    if (bytes > 0 && elapsed_ns > 0) {
+        // Bytes per nanosecond are GB/s.
+        std::printf("%s.gb_per_s=%.3f\n", key.c_str(), static_cast<double>(bytes) / static_cast<double>(elapsed_ns));
+    }
+}
+
+template <typename T>
+T fake_handle(uint64_t value) {
+    T handle{};
+    std::memcpy(&handle, &value, std::min(sizeof(handle), sizeof(value)));
+    return handle;
+}
+
+struct Allocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void* real_ptr = nullptr;
+    size_t size = 0;
+};
+
+// Hands out "real" mappings to the engine: driver allocations when a Mali
+// device could be created, high anonymous memory otherwise.
+class MemorySource {
+public:
+    bool InitDriver();
+    void InitHost();
+    void Shutdown();
+
+    bool Allocate(size_t size, Allocation* out);
+    void Free(const Allocation& allocation);
+
+    VkDevice device() const { return device_; }
+    bool uses_driver() const { return driver_device_ != VK_NULL_HANDLE; }
+    VkMemoryPropertyFlags memory_flags() const { return memory_flags_; }
+
+private:
+    VkInstance instance_ = VK_NULL_HANDLE;
+    VkDevice driver_device_ = VK_NULL_HANDLE;
+    VkDevice device_ = VK_NULL_HANDLE;
+    uint32_t memory_type_ = 0;
+    VkMemoryPropertyFlags memory_flags_ = 0;
+    uint64_t next_handle_ = 1;
+
+    PFN_vkDestroyInstance destroy_instance_ = nullptr;
+    PFN_vkDestroyDevice destroy_device_ = nullptr;
+    PFN_vkAllocateMemory allocate_memory_ = nullptr;
+    PFN_vkFreeMemory free_memory_ = nullptr;
+    PFN_vkMapMemory map_memory_ = nullptr;
+    PFN_vkUnmapMemory unmap_memory_ = nullptr;
+};
+
+bool MemorySource::InitDriver() {
+    auto& loader = mali_wrapper::LibraryLoader::Instance();
+    if (!loader.LoadLibraries() || loader.GetMaliGetInstanceProcAddr() == nullptr) {
+        return false;
+    }
+    auto gipa = loader.GetMaliGetInstanceProcAddr();
+    auto create_instance = reinterpret_cast<PFN_vkCreateInstance>(gipa(VK_NULL_HANDLE, "vkCreateInstance"));
+    if (create_instance == nullptr) {
+        return false;
+    }
+
+    VkApplicationInfo app_info{};
+    app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    app_info.pApplicationName = "mali_wrapper_bench";
+    app_info.apiVersion = VK_API_VERSION_1_1;
+    VkInstanceCreateInfo instance_info{};
+    instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instance_info.pApplicationInfo = &app_info;
+    if (create_instance(&instance_info, nullptr, &instance_) != VK_SUCCESS) {
+        return false;
+    }
+    destroy_instance_ = reinterpret_cast<PFN_vkDestroyInstance>(gipa(instance_, "vkDestroyInstance"));
+
+    auto enumerate = reinterpret_cast<PFN_vkEnumeratePhysicalDevices>(gipa(instance_, "vkEnumeratePhysicalDevices"));
+    auto get_memory_properties = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties>(
+        gipa(instance_, "vkGetPhysicalDeviceMemoryProperties"));
+    auto create_device = reinterpret_cast<PFN_vkCreateDevice>(gipa(instance_, "vkCreateDevice"));
+    auto gdpa = reinterpret_cast<PFN_vkGetDeviceProcAddr>(gipa(instance_, "vkGetDeviceProcAddr"));
+    uint32_t physical_device_count = 1;
+    VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+    if (enumerate == nullptr || get_memory_properties == nullptr || create_device == nullptr || gdpa == nullptr ||
+        enumerate(instance_, &physical_device_count, &physical_device) < 0 || physical_device == VK_NULL_HANDLE) {
+        Shutdown();
+        return false;
+    }
+
+    // The memory DXVK uses for upload and readback heaps, and the slowest
+    // source for the shadow copies.
+    const VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    get_memory_properties(physical_device, &memory_properties);
+    bool found = false;
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount && !found; i++) {
+        if ((memory_properties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+            memory_type_ = i;
+            memory_flags_ = memory_properties.memoryTypes[i].propertyFlags;
+            found = true;
+        }
+    }
+    if (!found) {
+        Shutdown();
+        return false;
+    }
+
+    const float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info{};
+    queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_info.queueFamilyIndex = 0;
+    queue_info.queueCount = 1;
+    queue_info.pQueuePriorities = &priority;
+    VkDeviceCreateInfo device_info{};
+    device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    device_info.queueCreateInfoCount = 1;
+    device_info.pQueueCreateInfos = &queue_info;
+    if (create_device(physical_device, &device_info, nullptr, &driver_device_) != VK_SUCCESS) {
+        driver_device_ = VK_NULL_HANDLE;
+        Shutdown();
+        return false;
+    }
+
+    destroy_device_ = reinterpret_cast<PFN_vkDestroyDevice>(gdpa(driver_device_, "vkDestroyDevice"));
+    allocate_memory_ = reinterpret_cast<PFN_vkAllocateMemory>(gdpa(driver_device_, "vkAllocateMemory"));
+    free_memory_ = reinterpret_cast<PFN_vkFreeMemory>(gdpa(driver_device_, "vkFreeMemory"));
+    map_memory_ = reinterpret_cast<PFN_vkMapMemory>(gdpa(driver_device_, "vkMapMemory"));
+    unmap_memory_ = reinterpret_cast<PFN_vkUnmapMemory>(gdpa(driver_device_, "vkUnmapMemory"));
+    if (allocate_memory_ == nullptr || free_memory_ == nullptr || map_memory_ == nullptr || unmap_memory_ == nullptr) {
+        Shutdown();
+        return false;
+    }
+
+    device_ = driver_device_;
+    return true;
+}
+
+void MemorySource::InitHost() {
+    device_ = fake_handle<VkDevice>(0x10000);
+    memory_flags_ = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+void MemorySource::Shutdown() {
+    if (driver_device_ != VK_NULL_HANDLE && destroy_device_ != nullptr) {
+        destroy_device_(driver_device_, nullptr);
+    }
+    if (instance_ != VK_NULL_HANDLE && destroy_instance_ != nullptr) {
+        destroy_instance_(instance_, nullptr);
+    }
+    driver_device_ = VK_NULL_HANDLE;
+    instance_ = VK_NULL_HANDLE;
+    device_ = VK_NULL_HANDLE;
+}
+
+bool MemorySource::Allocate(size_t size, Allocation* out) {
+    *out = Allocation{};
+    out->size = size;
+    if (uses_driver()) {
+        VkMemoryAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.allocationSize = size;
+        allocate_info.memoryTypeIndex = memory_type_;
+        if (allocate_memory_(driver_device_, &allocate_info, nullptr, &out->memory) != VK_SUCCESS) {
+            return false;
+        }
+        if (map_memory_(driver_device_, out->memory, 0, VK_WHOLE_SIZE, 0, &out->real_ptr) != VK_SUCCESS) {
+            free_memory_(driver_device_, out->memory, nullptr);
+            return false;
+        }
+    } else {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        out->memory = fake_handle<VkDeviceMemory>(next_handle_++);
+        out->real_ptr = ptr;
+    }
+
+    std::memset(out->real_ptr, 0x5a, size);
+    harness::TrackAllocation(device_, out->memory, size, memory_flags_);
+    return true;
+}
+
+void MemorySource::Free(const Allocation& allocation) {
+    harness::FreeMemory(device_, allocation.memory);
+    if (uses_driver()) {
+        unmap_memory_(driver_device_, allocation.memory);
+        free_memory_(driver_device_, allocation.memory, nullptr);
+    } else {
+        munmap(allocation.real_ptr, allocation.size);
+    }
+}
+
+struct BenchContext {
+    MemorySource source;
+    bool alias_supported = false;
+    // "shadow", plus "alias" when it can be measured.
+    std::vector<const char*> modes;
+};
+
+void select_mode(BenchContext& context, const char* mode) {
+    harness::SetAliasEnabled(context.source.device(), std::strcmp(mode, "alias") == 0);
+}
+
+bool allocate_all(BenchContext& context, size_t count, size_t size, std::vector<Allocation>* out) {
+    out->clear();
+    for (size_t i = 0; i < count; i++) {
+        Allocation allocation{};
+        if (!context.source.Allocate(size, &allocation)) {
+            for (const Allocation& allocated : *out) {
+                context.source.Free(allocated);
+            }
+            out->clear();
+            return false;
+        }
+        out->push_back(allocation);
+    }
+    return true;
+}
+
+void free_all(BenchContext& context, const std::vector<Allocation>& allocations) {
+    for (const Allocation& allocation : allocations) {
+        context.source.Free(allocation);
+    }
+}
+
+// allocate_low_address_shadow() and its release, without a mapping around it.
+void bench_shadow_alloc(BenchContext&) {
+    for (const size_t size : {4 * kKiB, 64 * kKiB, 1 * kMiB, 16 * kMiB}) {
+        const size_t iterations = iterations_for(size, 64, 4096);
+        uint64_t elapsed = 0;
+        uint64_t ops = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            size_t shadow_size = 0;
+            const uint64_t start = now_ns();
+            void* shadow = harness::AllocateShadow(size, &shadow_size);
+            if (shadow == nullptr) {
+                break;
+            }
+            harness::ReleaseShadow(shadow, shadow_size);
+            elapsed += now_ns() - start;
+            ops++;
+        }
+        report("shadow_alloc." + size_label(size), elapsed, ops, 0);
+    }
+}
+
+// try_create_low_address_alias() on driver memory and its munmap.
+void bench_alias_create(BenchContext& context) {
+    if (!context.alias_supported) {
+        std::printf("alias_create.skipped=no-alias-support\n");
+        return;
+    }
+
+    for (const size_t size : {4 * kKiB, 64 * kKiB, 1 * kMiB, 16 * kMiB}) {
+        Allocation allocation{};
+        if (!context.source.Allocate(size, &allocation)) {
+            continue;
+        }
+        const size_t iterations = iterations_for(size, 64, 4096);
+        uint64_t elapsed = 0;
+        uint64_t ops = 0;
+        for (size_t i = 0; i < iterations; i++) {
+            size_t unmap_size = 0;
+            const uint64_t start = now_ns();
+            void* alias = harness::CreateAlias(context.source.device(), allocation.real_ptr, size, &unmap_size);
+            if (alias == nullptr) {
+                break;
+            }
+            harness::ReleaseAlias(alias, unmap_size);
+            elapsed += now_ns() - start;
+            ops++;
+        }
+        context.source.Free(allocation);
+        report("alias_create." + size_label(size), elapsed, ops, 0);
+    }
+}
+
+// vkMapMemory + vkUnmapMemory of many allocations at once. With the default
+// view cache every round after the first reuses the parked views.
+void bench_map_unmap(BenchContext& context) {
+    struct Shape {
+        size_t count;
+        size_t size;
+    };
+    for (const char* mode : context.modes) {
+        select_mode(context, mode);
+        for (const Shape shape : {Shape{1, 64 * kKiB}, Shape{64, 64 * kKiB}, Shape{1024, 4 * kKiB},
+                                  Shape{16, 4 * kMiB}, Shape{4, 32 * kMiB}}) {
+            std::vector<Allocation> allocations;
+            if (!allocate_all(context, shape.count, shape.size, &allocations)) {
+                continue;
+            }
+            const size_t rounds = iterations_for(shape.count * shape.size, 4, 64);
+            uint64_t elapsed = 0;
+            const uint64_t start = now_ns();
+            for (size_t round = 0; round < rounds; round++) {
+                for (const Allocation& allocation : allocations) {
+                    harness::MapMemory(context.source.device(), allocation.memory, 0, VK_WHOLE_SIZE,
+                                       allocation.real_ptr);
+                }
+                for (const Allocation& allocation : allocations) {
+                    harness::UnmapMemory(context.source.device(), allocation.memory);
+                }
+            }
+            elapsed = now_ns() - start;
+            free_all(context, allocations);
+
+            const uint64_t ops = static_cast<uint64_t>(rounds) * shape.count;
+            report(std::string("map_unmap.") + mode + "." + std::to_string(shape.count) + "x" + size_label(shape.size),
+                   elapsed, ops, ops * shape.size);
+        }
+    }
+}
+
+// vkFlushMappedMemoryRanges and vkInvalidateMappedMemoryRanges over a whole
+// mapping after the application touched every page.
+void bench_flush_invalidate(BenchContext& context) {
+    for (const char* mode : context.modes) {
+        select_mode(context, mode);
+        for (const size_t size : {64 * kKiB, 1 * kMiB, 16 * kMiB}) {
+            Allocation allocation{};
+            if (!context.source.Allocate(size, &allocation)) {
+                continue;
+            }
+            auto* view = static_cast<uint8_t*>(harness::MapMemory(context.source.device(), allocation.memory, 0,
+                                                                  VK_WHOLE_SIZE, allocation.real_ptr));
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = allocation.memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+
+            const size_t iterations = iterations_for(size, 16, 4096);
+            uint64_t flush_elapsed = 0;
+            uint64_t invalidate_elapsed = 0;
+            for (size_t i = 0; i < iterations; i++) {
+                for (size_t offset = 0; offset < size; offset += 4 * kKiB) {
+                    view[offset] = static_cast<uint8_t>(i);
+                }
+                uint64_t start = now_ns();
+                harness::FlushRanges(context.source.device(), 1, &range);
+                flush_elapsed += now_ns() - start;
+
+                start = now_ns();
+                harness::InvalidateRanges(context.source.device(), 1, &range);
+                invalidate_elapsed += now_ns() - start;
+            }
+            harness::UnmapMemory(context.source.device(), allocation.memory);
+            context.source.Free(allocation);
+
+            const std::string suffix = std::string(".") + mode + "." + size_label(size);
+            report("flush" + suffix, flush_elapsed, iterations, static_cast<uint64_t>(iterations) * size);
+            report("invalidate" + suffix, invalidate_elapsed, iterations, static_cast<uint64_t>(iterations) * size);
+        }
+    }
+}
+
+// Submit-time write-back with a number of live, persistently mapped shadows
+// of which a fraction was written since the previous submit.
+void bench_submit_sync(BenchContext& context) {
+    struct Shape {
+        size_t count;
+        size_t size;
+        size_t written;
+    };
+    for (const char* mode : context.modes) {
+        select_mode(context, mode);
+        for (const Shape shape : {Shape{8, 1 * kMiB, 8}, Shape{64, 256 * kKiB, 8}, Shape{256, 64 * kKiB, 16}}) {
+            std::vector<Allocation> allocations;
+            if (!allocate_all(context, shape.count, shape.size, &allocations)) {
+                continue;
+            }
+            std::vector<uint8_t*> views;
+            for (const Allocation& allocation : allocations) {
+                views.push_back(static_cast<uint8_t*>(harness::MapMemory(
+                    context.source.device(), allocation.memory, 0, VK_WHOLE_SIZE, allocation.real_ptr)));
+            }
+
+            const size_t submits = iterations_for(shape.count * shape.size, 16, 1024);
+            uint64_t elapsed = 0;
+            for (size_t submit = 0; submit < submits; submit++) {
+                for (size_t i = 0; i < shape.written; i++) {
+                    uint8_t* view = views[(submit * shape.written + i) % views.size()];
+                    std::memset(view, static_cast<int>(submit), 4 * kKiB);
+                }
+                const uint64_t start = now_ns();
+                harness::SyncForSubmit(context.source.device());
+                elapsed += now_ns() - start;
+            }
+
+            for (const Allocation& allocation : allocations) {
+                harness::UnmapMemory(context.source.device(), allocation.memory);
+            }
+            free_all(context, allocations);
+
+            // GB/s is over the mapped bytes each submit has to cover.
+            report(std::string("submit_sync.") + mode + "." + std::to_string(shape.count) + "x" +
+                       size_label(shape.size),
+                   elapsed, submits, static_cast<uint64_t>(submits) * shape.count * shape.size);
+        }
+    }
+}
+
+// DXVK's pattern: a few large chunks mapped once for their whole lifetime,
+// with each frame writing many small suballocations, flushing them and
+// submitting several times.
+void bench_dxvk_chunks(BenchContext& context) {
+    constexpr size_t kChunkCount = 4;
+    constexpr size_t kChunkSize = 32 * kMiB;
+    constexpr size_t kFrames = 64;
+    constexpr size_t kSubmitsPerFrame = 8;
+    for (const char* mode : context.modes) {
+        select_mode(context, mode);
+        for (const size_t suballocation : {size_t{256}, 4 * kKiB, 64 * kKiB}) {
+            std::vector<Allocation> chunks;
+            if (!allocate_all(context, kChunkCount, kChunkSize, &chunks)) {
+                continue;
+            }
+            std::vector<uint8_t*> views;
+            for (const Allocation& chunk : chunks) {
+                views.push_back(static_cast<uint8_t*>(harness::MapMemory(
+                    context.source.device(), chunk.memory, 0, VK_WHOLE_SIZE, chunk.real_ptr)));
+            }
+
+            // About 2 MiB of fresh data per frame, spread over the chunks.
+            const size_t writes_per_submit = std::max<size_t>(1, (2 * kMiB / suballocation) / kSubmitsPerFrame);
+            const size_t slots_per_chunk = kChunkSize / suballocation;
+            std::vector<VkMappedMemoryRange> ranges(writes_per_submit);
+            uint64_t cursor = 0;
+            uint64_t written = 0;
+            const uint64_t start = now_ns();
+            for (size_t frame = 0; frame < kFrames; frame++) {
+                for (size_t submit = 0; submit < kSubmitsPerFrame; submit++) {
+                    for (size_t i = 0; i < writes_per_submit; i++, cursor++) {
+                        const size_t chunk = cursor % kChunkCount;
+                        const size_t offset = ((cursor / kChunkCount) % slots_per_chunk) * suballocation;
+                        std::memset(views[chunk] + offset, static_cast<int>(frame), suballocation);
+                        ranges[i].sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+                        ranges[i].pNext = nullptr;
+                        ranges[i].memory = chunks[chunk].memory;
+                        ranges[i].offset = offset;
+                        ranges[i].size = suballocation;
+                        written += suballocation;
+                    }
+                    harness::FlushRanges(context.source.device(), static_cast<uint32_t>(ranges.size()),
+                                         ranges.data());
+                    harness::SyncForSubmit(context.source.device());
+                }
+            }
+            const uint64_t elapsed = now_ns() - start;
+
+            for (const Allocation& chunk : chunks) {
+                harness::UnmapMemory(context.source.device(), chunk.memory);
+            }
+            free_all(context, chunks);
+
+            // GB/s is over the bytes the application wrote.
+            report(std::string("dxvk_chunks.") + mode + "." + size_label(suballocation), elapsed,
+                   kFrames * kSubmitsPerFrame, written);
+        }
+    }
+}
+
+// The copy kernels on their own: glibc memcpy, the NEON streaming kernel and
+// the threaded CopyEngine, between cached memory and the source's memory in
+// both directions. With driver memory "to_real" writes and "to_shadow" reads
+// write-combined pages, as the shadow sync does.
+void bench_copy_kernels(BenchContext& context) {
+    struct Kernel {
+        const char* name;
+        mali_wrapper::CopyKernelFn copy;
+    };
+    std::vector<Kernel> kernels = {{"libc", nullptr}};
+    if (mali_wrapper::GetStreamCopyKernel() != nullptr) {
+        kernels.push_back({"neon_stream", mali_wrapper::GetStreamCopyKernel()});
+    }
+    kernels.push_back({"copy_engine", nullptr});
+
+    const auto memory_type = (context.source.memory_flags() & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0
+                                 ? mali_wrapper::CopyMemoryType::CACHED
+                                 : mali_wrapper::CopyMemoryType::COHERENT;
+    const char* memory_name = context.source.uses_driver() ? "mali" : "host";
+    for (const size_t size : {4 * kKiB, 64 * kKiB, 1 * kMiB, 16 * kMiB}) {
+        Allocation real{};
+        if (!context.source.Allocate(size, &real)) {
+            continue;
+        }
+        void* cached = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (cached == MAP_FAILED) {
+            context.source.Free(real);
+            continue;
+        }
+        std::memset(cached, 0xa5, size);
+
+        const size_t iterations = iterations_for(size, 16, 65536);
+        for (const Kernel& kernel : kernels) {
+            for (const bool to_real : {true, false}) {
+                void* dst = to_real ? real.real_ptr : cached;
+                const void* src = to_real ? cached : real.real_ptr;
+                const uint64_t start = now_ns();
+                for (size_t i = 0; i < iterations; i++) {
+                    if (kernel.copy != nullptr) {
+                        kernel.copy(dst, src, size);
+                    } else if (std::strcmp(kernel.name, "copy_engine") == 0) {
+                        mali_wrapper::CopyEngine::Instance().Copy(dst, src, size, memory_type);
+                    } else {
+                        std::memcpy(dst, src, size);
+                    }
+                }
+                const uint64_t elapsed = now_ns() - start;
+                report(std::string("copy_kernels.") + kernel.name + "." + (to_real ? "to_real" : "to_shadow") + "." +
+                           memory_name + "." + size_label(size),
+                       elapsed, iterations, static_cast<uint64_t>(iterations) * size);
+            }
+        }
+
+        munmap(cached, size);
+        context.source.Free(real);
+    }
+}
+
+// vkQueueSubmit's lookup of the queue's device and driver entry point:
+// "cached" is get_queue_dispatch(), "uncached" the private-data lookup and
+// dispatch copy each submit did before it. Every thread submits to its own
+// queue of the same device, as DXVK's submission threads do.
+void bench_queue_dispatch(BenchContext& context) {
+    constexpr size_t kLookups = 1 << 20;
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> thread_counts = {1};
+    if (max_threads > 1) {
+        thread_counts.push_back(max_threads);
+    }
+
+    const VkDevice device = context.source.device();
+    for (const size_t threads : thread_counts) {
+        std::vector<VkQueue> queues;
+        for (size_t i = 0; i < threads; i++) {
+            queues.push_back(fake_handle<VkQueue>(0x20000 + i * 0x100));
+            harness::RegisterQueue(queues.back(), device);
+        }
+
+        for (const bool cached : {true, false}) {
+            std::vector<uint64_t> elapsed(threads, 0);
+            std::vector<size_t> misses(threads, 0);
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; t++) {
+                workers.emplace_back([&, t]() {
+                    const VkQueue queue = queues[t];
+                    // Counted locally so the threads share no cache line.
+                    size_t local_misses = 0;
+                    const uint64_t start = now_ns();
+                    for (size_t i = 0; i < kLookups; i++) {
+                        VkDevice resolved = VK_NULL_HANDLE;
+                        if (cached) {
+                            harness::LookupQueueSubmit(queue, &resolved);
+                        } else {
+                            harness::LookupQueueSubmitUncached(queue, &resolved);
+                        }
+                        local_misses += resolved != device ? 1 : 0;
+                    }
+                    elapsed[t] = now_ns() - start;
+                    misses[t] = local_misses;
+                });
+            }
+            uint64_t total_elapsed = 0;
+            size_t total_misses = 0;
+            for (size_t t = 0; t < threads; t++) {
+                workers[t].join();
+                total_elapsed += elapsed[t];
+                total_misses += misses[t];
+            }
+
+            const std::string key = std::string("queue_dispatch.") + (cached ? "cached" : "uncached") + ".threads_" +
+                                    std::to_string(threads);
+            if (total_misses > 0) {
+                std::printf("%s.misses=%zu\n", key.c_str(), total_misses);
+            }
+            // Per-lookup cost as every thread saw it.
+            report(key, total_elapsed, static_cast<uint64_t>(threads) * kLookups, 0);
+        }
+
+        for (const VkQueue queue : queues) {
+            harness::UnregisterQueue(queue);
+        }
+    }
+}
+
+struct BenchCase {
+    const char* name;
+    void (*run)(BenchContext&);
+};
+
+constexpr BenchCase kCases[] = {
+    {"copy_kernels", bench_copy_kernels},
+    {"shadow_alloc", bench_shadow_alloc},
+    {"alias_create", bench_alias_create},
+    {"map_unmap", bench_map_unmap},
+    {"flush_invalidate", bench_flush_invalidate},
+    {"submit_sync", bench_submit_sync},
+    {"dxvk_chunks", bench_dxvk_chunks},
+    {"queue_dispatch", bench_queue_dispatch},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // The engine reads its options once, on first use.
+    setenv("MALI_WRAPPER_LOW_ADDRESS_MAP", "1", 0);
+
+    bool host_only = false;
+    std::vector<std::string> selected;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--host") == 0) {
+            host_only = true;
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "usage: %s [--host] [case...]\ncases:", argv[0]);
+            for (const BenchCase& bench_case : kCases) {
+                std::fprintf(stderr, " %s", bench_case.name);
+            }
+            std::fprintf(stderr, "\n");
+            return 2;
+        } else {
+            selected.push_back(argv[i]);
+        }
+    }
+
+    BenchContext context;
+    if (host_only || !context.source.InitDriver()) {
+        context.source.InitHost();
+    }
+    context.alias_supported = harness::RegisterDevice(context.source.device()) && context.source.uses_driver();
+    context.modes.push_back("shadow");
+    if (context.alias_supported) {
+        context.modes.push_back("alias");
+    }
+
+    std::printf("source=%s\n", context.source.uses_driver() ? "mali" : "host");
+    std::printf("alias_supported=%d\n", context.alias_supported ? 1 : 0);
+    const char* options = getenv("MALI_WRAPPER_LOW_ADDRESS_MAP");
+    std::printf("low_address_map=%s\n", options != nullptr ? options : "");
+
+    bool ran_any = false;
+    for (const BenchCase& bench_case : kCases) {
+        bool wanted = selected.empty();
+        for (const std::string& name : selected) {
+            wanted = wanted || name == bench_case.name;
+        }
+        if (wanted) {
+            bench_case.run(context);
+            ran_any = true;
+        }
+    }
+
+    harness::UnregisterDevice(context.source.device());
+    context.source.Shutdown();
+    if (!ran_any) {
+        std::fprintf(stderr, "mali_wrapper_bench: no such case\n");
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,315 @@
+// mali-wrapper-metrics: prints the live metrics page of one or every process
+// running the wrapper with MALI_WRAPPER_METRICS_PAGE=1, as key=value lines.
+//
+//   mali-wrapper-metrics            every /dev/shm/mali-wrapper-* page
+//   mali-wrapper-metrics <pid>      one process
+//   mali-wrapper-metrics <path>     an explicit page file
+
+#include "../core/metrics_page.hpp"
+#include <cerrno>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using mali_wrapper::MetricsPageLayout;
+using mali_wrapper::MetricsSwapchainSlot;
+
+namespace {
+
+constexpr const char* kPagePrefix = "mali-wrapper-";
+
+uint64_t monotonic_now_ns() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Upper edge of the bucket holding the given percentile, in milliseconds.
+double frame_time_percentile_ms(const MetricsSwapchainSlot& slot, double percentile) {
+    return mali_wrapper::MetricsHistogramPercentileMs(slot.frame_time_histogram, mali_wrapper::kMetricsFrameTimeBuckets,
+                                                      mali_wrapper::kMetricsFrameTimeBucketUs, percentile);
+}
+
+// VkPresentModeKHR names, without pulling in the Vulkan headers.
+const char* present_mode_name(uint32_t present_mode) {
+    switch (present_mode) {
+    case 0:
+        return "immediate";
+    case 1:
+        return "mailbox";
+    case 2:
+        return "fifo";
+    case 3:
+        return "fifo_relaxed";
+    default:
+        return "other";
+    }
+}
+
+// Standard deviation of the frame times, in milliseconds.
+double frame_time_jitter_ms(const MetricsSwapchainSlot& slot) {
+    if (slot.frame_time_samples < 2) {
+        return 0.0;
+    }
+    const double samples = static_cast<double>(slot.frame_time_samples);
+    const double mean_us = static_cast<double>(slot.frame_time_total_ns) / samples / 1e3;
+    const double variance = static_cast<double>(slot.frame_time_sq_total_us2) / samples - mean_us * mean_us;
+    return variance > 0.0 ? std::sqrt(variance) / 1e3 : 0.0;
+}
+
+void print_display_latency(const MetricsSwapchainSlot& slot) {
+    const mali_wrapper::MetricsStageTiming& latency = slot.display_latency;
+    if (latency.samples == 0) {
+        return;
+    }
+
+    std::printf("swapchain.0x%" PRIx64 ".display_latency_samples=%" PRIu64 "\n", slot.handle, latency.samples);
+    std::printf("swapchain.0x%" PRIx64 ".display_latency_mean_us=%.1f\n", slot.handle,
+                static_cast<double>(latency.total_ns) / static_cast<double>(latency.samples) / 1e3);
+    std::printf("swapchain.0x%" PRIx64 ".display_latency_p50_us=%.1f\n", slot.handle,
+                mali_wrapper::MetricsStagePercentileUs(latency, 0.50));
+    std::printf("swapchain.0x%" PRIx64 ".display_latency_p99_us=%.1f\n", slot.handle,
+                mali_wrapper::MetricsStagePercentileUs(latency, 0.99));
+    std::printf("swapchain.0x%" PRIx64 ".display_latency_max_us=%.1f\n", slot.handle,
+                static_cast<double>(latency.max_ns) / 1e3);
+}
+
+void print_bridge_stats(const MetricsSwapchainSlot& slot) {
+    const mali_wrapper::MetricsBridgeStats& bridge = slot.bridge;
+    if (bridge.frames_sent == 0) {
+        return;
+    }
+
+    std::printf("swapchain.0x%" PRIx64 ".bridge.frames_sent=%" PRIu64 "\n", slot.handle, bridge.frames_sent);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.frames_displayed=%" PRIu64 "\n", slot.handle, bridge.frames_displayed);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.frames_failed=%" PRIu64 "\n", slot.handle, bridge.frames_failed);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.feedback_timeouts=%" PRIu64 "\n", slot.handle,
+                bridge.feedback_timeouts);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.reconnects=%" PRIu64 "\n", slot.handle, bridge.reconnects);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.latency_mean_ms=%.2f\n", slot.handle,
+                bridge.latency_samples > 0
+                    ? static_cast<double>(bridge.latency_total_ns) / static_cast<double>(bridge.latency_samples) / 1e6
+                    : 0.0);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.latency_p50_ms=%.1f\n", slot.handle,
+                mali_wrapper::MetricsHistogramPercentileMs(bridge.latency_histogram,
+                                                           mali_wrapper::kMetricsBridgeLatencyBuckets,
+                                                           mali_wrapper::kMetricsBridgeLatencyBucketUs, 0.50));
+    std::printf("swapchain.0x%" PRIx64 ".bridge.latency_p99_ms=%.1f\n", slot.handle,
+                mali_wrapper::MetricsHistogramPercentileMs(bridge.latency_histogram,
+                                                           mali_wrapper::kMetricsBridgeLatencyBuckets,
+                                                           mali_wrapper::kMetricsBridgeLatencyBucketUs, 0.99));
+    std::printf("swapchain.0x%" PRIx64 ".bridge.latency_max_ms=%.2f\n", slot.handle,
+                static_cast<double>(bridge.latency_max_ns) / 1e6);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.throttle_mean_us=%.1f\n", slot.handle,
+                bridge.throttle_samples > 0
+                    ? static_cast<double>(bridge.throttle_total_ns) / static_cast<double>(bridge.throttle_samples) / 1e3
+                    : 0.0);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.throttle_max_us=%.1f\n", slot.handle,
+                static_cast<double>(bridge.throttle_max_ns) / 1e3);
+    std::printf("swapchain.0x%" PRIx64 ".bridge.latency_histogram=", slot.handle);
+    for (uint32_t i = 0; i < mali_wrapper::kMetricsBridgeLatencyBuckets; ++i) {
+        std::printf("%s%" PRIu64, i == 0 ? "" : ",", bridge.latency_histogram[i]);
+    }
+    std::printf("\n");
+}
+
+void print_frame_timing(const MetricsSwapchainSlot& slot) {
+    const mali_wrapper::MetricsFrameTiming& timing = slot.frame_timing;
+    if (timing.frames == 0) {
+        return;
+    }
+
+    std::printf("swapchain.0x%" PRIx64 ".stage.frames=%" PRIu64 "\n", slot.handle, timing.frames);
+    std::printf("swapchain.0x%" PRIx64 ".stage.last_frame_id=%" PRIu64 "\n", slot.handle, timing.last_frame_id);
+    for (uint32_t i = 0; i < mali_wrapper::metrics_stage::count; ++i) {
+        const mali_wrapper::MetricsStageTiming& stage = timing.stages[i];
+        if (stage.samples == 0) {
+            continue;
+        }
+        const char* name = mali_wrapper::GetMetricsStageName(i);
+        std::printf("swapchain.0x%" PRIx64 ".stage.%s.samples=%" PRIu64 "\n", slot.handle, name, stage.samples);
+        std::printf("swapchain.0x%" PRIx64 ".stage.%s.mean_us=%.1f\n", slot.handle, name,
+                    static_cast<double>(stage.total_ns) / static_cast<double>(stage.samples) / 1e3);
+        std::printf("swapchain.0x%" PRIx64 ".stage.%s.p50_us=%.1f\n", slot.handle, name,
+                    mali_wrapper::MetricsStagePercentileUs(stage, 0.50));
+        std::printf("swapchain.0x%" PRIx64 ".stage.%s.p99_us=%.1f\n", slot.handle, name,
+                    mali_wrapper::MetricsStagePercentileUs(stage, 0.99));
+        std::printf("swapchain.0x%" PRIx64 ".stage.%s.max_us=%.1f\n", slot.handle, name,
+                    static_cast<double>(stage.max_ns) / 1e3);
+    }
+}
+
+void print_page(const char* path, const MetricsPageLayout& page) {
+    const bool alive = kill(static_cast<pid_t>(page.pid), 0) == 0 || errno == EPERM;
+    const uint64_t now_ns = monotonic_now_ns();
+    const uint64_t age_ms = now_ns > page.update_time_ns ? (now_ns - page.update_time_ns) / 1000000ULL : 0;
+
+    std::printf("page=%s pid=%" PRIu32 " alive=%d version=%" PRIu32 " age_ms=%" PRIu64 "\n",
+                path, page.pid, alive ? 1 : 0, page.version, age_ms);
+
+    for (uint32_t i = 0; i < mali_wrapper::metrics_counter::count; ++i) {
+        std::printf("low_address.%s=%" PRIu64 "\n", mali_wrapper::GetMetricsCounterName(i), page.low_address[i]);
+    }
+
+    for (uint32_t i = 0; i < mali_wrapper::kMetricsAllocationScopes; ++i) {
+        const auto& scope = page.host_allocations[i];
+        const char* name = mali_wrapper::GetMetricsAllocationScopeName(i);
+        std::printf("host_alloc.%s.allocations=%" PRIu64 "\n", name, scope.allocations);
+        std::printf("host_alloc.%s.frees=%" PRIu64 "\n", name, scope.frees);
+        std::printf("host_alloc.%s.bytes=%" PRIu64 "\n", name, scope.bytes);
+        std::printf("host_alloc.%s.live_bytes=%" PRIu64 "\n", name, scope.live_bytes);
+    }
+
+    const uint64_t copy_bytes = page.low_address[mali_wrapper::metrics_counter::initial_copy_bytes] +
+                                page.low_address[mali_wrapper::metrics_counter::flush_copy_bytes] +
+                                page.low_address[mali_wrapper::metrics_counter::invalidate_copy_bytes] +
+                                page.low_address[mali_wrapper::metrics_counter::submit_copy_bytes] +
+                                page.low_address[mali_wrapper::metrics_counter::unmap_copy_bytes];
+    const uint64_t copy_ns = page.low_address[mali_wrapper::metrics_counter::copy_time_ns];
+    std::printf("copy.total_bytes=%" PRIu64 "\n", copy_bytes);
+    std::printf("copy.throughput_mib_s=%.1f\n",
+                copy_ns > 0 ? (static_cast<double>(copy_bytes) / (1024.0 * 1024.0)) /
+                                  (static_cast<double>(copy_ns) / 1e9)
+                            : 0.0);
+
+    for (const auto& slot : page.swapchains) {
+        if (slot.handle == 0) {
+            continue;
+        }
+
+        const double mean_ms = slot.frame_time_samples > 0
+            ? static_cast<double>(slot.frame_time_total_ns) / static_cast<double>(slot.frame_time_samples) / 1e6
+            : 0.0;
+        std::printf("swapchain.0x%" PRIx64 ".backend=%s\n", slot.handle,
+                    mali_wrapper::GetMetricsBackendName(slot.backend));
+        std::printf("swapchain.0x%" PRIx64 ".present_mode=%s\n", slot.handle, present_mode_name(slot.present_mode));
+        std::printf("swapchain.0x%" PRIx64 ".presents=%" PRIu64 "\n", slot.handle, slot.presents);
+        std::printf("swapchain.0x%" PRIx64 ".present_failures=%" PRIu64 "\n", slot.handle, slot.present_failures);
+        std::printf("swapchain.0x%" PRIx64 ".frame_time_mean_ms=%.2f\n", slot.handle, mean_ms);
+        std::printf("swapchain.0x%" PRIx64 ".present_rate_hz=%.1f\n", slot.handle, mean_ms > 0.0 ? 1e3 / mean_ms : 0.0);
+        std::printf("swapchain.0x%" PRIx64 ".frame_time_p50_ms=%.1f\n", slot.handle,
+                    frame_time_percentile_ms(slot, 0.50));
+        std::printf("swapchain.0x%" PRIx64 ".frame_time_p99_ms=%.1f\n", slot.handle,
+                    frame_time_percentile_ms(slot, 0.99));
+        std::printf("swapchain.0x%" PRIx64 ".frame_time_jitter_ms=%.2f\n", slot.handle, frame_time_jitter_ms(slot));
+        std::printf("swapchain.0x%" PRIx64 ".present_wait_mean_us=%.1f\n", slot.handle,
+                    slot.present_wait_samples > 0
+                        ? static_cast<double>(slot.present_wait_total_ns) /
+                              static_cast<double>(slot.present_wait_samples) / 1e3
+                        : 0.0);
+        std::printf("swapchain.0x%" PRIx64 ".present_wait_max_us=%.1f\n", slot.handle,
+                    static_cast<double>(slot.present_wait_max_ns) / 1e3);
+        std::printf("swapchain.0x%" PRIx64 ".present_queue_mean_us=%.1f\n", slot.handle,
+                    slot.present_queue_samples > 0
+                        ? static_cast<double>(slot.present_queue_total_ns) /
+                              static_cast<double>(slot.present_queue_samples) / 1e3
+                        : 0.0);
+        std::printf("swapchain.0x%" PRIx64 ".present_queue_max_us=%.1f\n", slot.handle,
+                    static_cast<double>(slot.present_queue_max_ns) / 1e3);
+        std::printf("swapchain.0x%" PRIx64 ".present_dispatch_mean_us=%.1f\n", slot.handle,
+                    slot.present_queue_samples > 0
+                        ? static_cast<double>(slot.present_dispatch_total_ns) /
+                              static_cast<double>(slot.present_queue_samples) / 1e3
+                        : 0.0);
+        std::printf("swapchain.0x%" PRIx64 ".present_dispatch_max_us=%.1f\n", slot.handle,
+                    static_cast<double>(slot.present_dispatch_max_ns) / 1e3);
+        std::printf("swapchain.0x%" PRIx64 ".present_allocations_mean=%.2f\n", slot.handle,
+                    slot.present_allocation_samples > 0
+                        ? static_cast<double>(slot.present_allocations_total) /
+                              static_cast<double>(slot.present_allocation_samples)
+                        : 0.0);
+        std::printf("swapchain.0x%" PRIx64 ".present_allocations_max=%" PRIu64 "\n", slot.handle,
+                    slot.present_allocations_max);
+        std::printf("swapchain.0x%" PRIx64 ".frame_time_histogram=", slot.handle);
+        for (uint32_t i = 0; i < mali_wrapper::kMetricsFrameTimeBuckets; ++i) {
+            std::printf("%s%" PRIu64, i == 0 ? "" : ",", slot.frame_time_histogram[i]);
+        }
+        std::printf("\n");
+        print_display_latency(slot);
+        print_bridge_stats(slot);
+        print_frame_timing(slot);
+    }
+}
+
+bool dump_page(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::fprintf(stderr, "mali-wrapper-metrics: cannot open %s: %s\n", path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MetricsPageLayout)) {
+        std::fprintf(stderr, "mali-wrapper-metrics: %s is not a metrics page\n", path.c_str());
+        close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, sizeof(MetricsPageLayout), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::fprintf(stderr, "mali-wrapper-metrics: cannot map %s: %s\n", path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    MetricsPageLayout page{};
+    const bool ok = mali_wrapper::ReadMetricsPage(static_cast<const MetricsPageLayout*>(mapped), &page);
+    munmap(mapped, sizeof(MetricsPageLayout));
+    if (!ok) {
+        std::fprintf(stderr, "mali-wrapper-metrics: %s has an unknown version or is being rewritten\n",
+                     path.c_str());
+        return false;
+    }
+
+    print_page(path.c_str(), page);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 2 || (argc == 2 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0))) {
+        std::fprintf(stderr, "usage: %s [pid | path]\n", argv[0]);
+        return 2;
+    }
+
+    if (argc == 2) {
+        const std::string arg = argv[1];
+        const bool is_pid = arg.find_first_not_of("0123456789") == std::string::npos;
+        return dump_page(is_pid ? "/dev/shm/" + std::string(kPagePrefix) + arg : arg) ? 0 : 1;
+    }
+
+    DIR* dir = opendir("/dev/shm");
+    if (dir == nullptr) {
+        std::fprintf(stderr, "mali-wrapper-metrics: cannot list /dev/shm: %s\n", std::strerror(errno));
+        return 1;
+    }
+
+    std::vector<std::string> pages;
+    while (const struct dirent* entry = readdir(dir)) {
+        if (std::strncmp(entry->d_name, kPagePrefix, std::strlen(kPagePrefix)) == 0) {
+            pages.push_back("/dev/shm/" + std::string(entry->d_name));
+        }
+    }
+    closedir(dir);
+
+    bool ok = true;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (i > 0) {
+            std::printf("\n");
+        }
+        ok = dump_page(pages[i]) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,822 @@
+// mali_wrapper_present_bench: presents trivial frames on every WSI backend and
+// present mode and prints acquire/present throughput, present latency and
+// frame-time jitter as key=value lines.
+//
+//   mali_wrapper_present_bench                    every available backend
+//   mali_wrapper_present_bench --backend <name>   headless, x11_shm,
+//                                                 xwayland_bridge or wayland
+//   mali_wrapper_present_bench --frames <n>       frames per present mode
+//
+// This is an ordinary Vulkan application: it goes through the system loader,
+// so VK_DRIVER_FILES (or VK_ICD_FILENAMES) selects the wrapper build under
+// test. Each backend runs in a forked child, because the wrapper reads the
+// variables that choose the X11 path (WSI_X11_DRI3, XWL_DMABUF_BRIDGE) once per
+// process. x11_shm needs DISPLAY, wayland needs WAYLAND_DISPLAY and
+// xwayland_bridge needs both plus XWL_DMABUF_BRIDGE; backends whose server is
+// missing report skipped=<reason>.
+//
+// Every frame clears the next swapchain image to a flat colour. Frame times
+// are the intervals between vkQueuePresentKHR returns and their jitter is the
+// standard deviation. Present latency, from vkQueuePresentKHR to
+// vkWaitForPresentKHR returning, is measured in a second pass that waits for
+// each frame before the next one, on devices with VK_KHR_present_wait.
+
+#include <vulkan/vulkan.h>
+#include <xcb/xcb.h>
+#include <wayland-client.h>
+#include <vulkan/vulkan_xcb.h>
+#include <vulkan/vulkan_wayland.h>
+#include "xdg-shell-client-protocol.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t kDefaultFrames = 300;
+constexpr uint32_t kWarmupFrames = 10;
+constexpr uint32_t kLatencyFrames = 60;
+constexpr uint32_t kWindowWidth = 640;
+constexpr uint32_t kWindowHeight = 480;
+constexpr uint64_t kPresentWaitTimeoutNs = 1000000000ULL;
+
+constexpr const char* kBackends[] = {"headless", "x11_shm", "xwayland_bridge", "wayland"};
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// The names the metrics page uses for present_mode.
+const char* present_mode_name(VkPresentModeKHR present_mode) {
+    switch (present_mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "fifo_relaxed";
+    default:
+        return nullptr;
+    }
+}
+
+bool env_set(const char* name) {
+    const char* value = std::getenv(name);
+    return value != nullptr && value[0] != '\0';
+}
+
+// Points the wrapper at the backend's X11 path before the instance exists;
+// returns the reason the backend cannot run here, or nullptr.
+const char* prepare_backend(const std::string& backend) {
+    if (backend == "headless") {
+        return nullptr;
+    }
+    if (backend == "x11_shm") {
+        if (!env_set("DISPLAY")) {
+            return "no-display";
+        }
+        unsetenv("XWL_DMABUF_BRIDGE");
+        setenv("WSI_X11_DRI3", "0", 1);
+        return nullptr;
+    }
+    if (backend == "xwayland_bridge") {
+        if (!env_set("DISPLAY") || !env_set("WAYLAND_DISPLAY")) {
+            return "no-xwayland";
+        }
+        if (!env_set("XWL_DMABUF_BRIDGE")) {
+            return "no-bridge";
+        }
+        unsetenv("WSI_X11_DRI3");
+        return nullptr;
+    }
+    if (backend == "wayland") {
+        return env_set("WAYLAND_DISPLAY") ? nullptr : "no-wayland-display";
+    }
+    return "unknown-backend";
+}
+
+// Mean, standard deviation and maximum of a set of durations.
+struct Stats {
+    double mean_ns = 0.0;
+    double stddev_ns = 0.0;
+    uint64_t max_ns = 0;
+};
+
+Stats summarize(const std::vector<uint64_t>& samples) {
+    Stats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    double total = 0.0;
+    double total_sq = 0.0;
+    for (const uint64_t sample : samples) {
+        total += static_cast<double>(sample);
+        total_sq += static_cast<double>(sample) * static_cast<double>(sample);
+        stats.max_ns = std::max(stats.max_ns, sample);
+    }
+    const double count = static_cast<double>(samples.size());
+    stats.mean_ns = total / count;
+    const double variance = total_sq / count - stats.mean_ns * stats.mean_ns;
+    stats.stddev_ns = variance > 0.0 ? std::sqrt(variance) : 0.0;
+    return stats;
+}
+
+// The native window a surface is created on, for the X11 and Wayland
+// backends.
+class Window {
+public:
+    ~Window() {
+        if (xdg_toplevel_ != nullptr) {
+            xdg_toplevel_destroy(xdg_toplevel_);
+        }
+        if (xdg_surface_ != nullptr) {
+            xdg_surface_destroy(xdg_surface_);
+        }
+        if (wl_surface_ != nullptr) {
+            wl_surface_destroy(wl_surface_);
+        }
+        if (wm_base_ != nullptr) {
+            xdg_wm_base_destroy(wm_base_);
+        }
+        if (compositor_ != nullptr) {
+            wl_compositor_destroy(compositor_);
+        }
+        if (registry_ != nullptr) {
+            wl_registry_destroy(registry_);
+        }
+        if (wl_display_ != nullptr) {
+            wl_display_disconnect(wl_display_);
+        }
+        if (xcb_ != nullptr) {
+            xcb_disconnect(xcb_);
+        }
+    }
+
+    bool OpenX11() {
+        xcb_ = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(xcb_)) {
+            return false;
+        }
+        const xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(xcb_)).data;
+        window_ = xcb_generate_id(xcb_);
+        xcb_create_window(xcb_, XCB_COPY_FROM_PARENT, window_, screen->root, 0, 0, kWindowWidth, kWindowHeight, 0,
+                          XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 0, nullptr);
+        xcb_map_window(xcb_, window_);
+        xcb_flush(xcb_);
+        return true;
+    }
+
+    // Connects, gives a surface the xdg toplevel role and waits for its first
+    // configure, after which the compositor shows what is committed to it.
+    bool OpenWayland() {
+        wl_display_ = wl_display_connect(nullptr);
+        if (wl_display_ == nullptr) {
+            return false;
+        }
+        registry_ = wl_display_get_registry(wl_display_);
+        static const wl_registry_listener registry_listener = {registry_global, registry_global_remove};
+        wl_registry_add_listener(registry_, &registry_listener, this);
+        wl_display_roundtrip(wl_display_);
+        if (compositor_ == nullptr || wm_base_ == nullptr) {
+            return false;
+        }
+
+        static const xdg_wm_base_listener wm_base_listener = {wm_base_ping};
+        xdg_wm_base_add_listener(wm_base_, &wm_base_listener, this);
+        wl_surface_ = wl_compositor_create_surface(compositor_);
+        xdg_surface_ = xdg_wm_base_get_xdg_surface(wm_base_, wl_surface_);
+        static const xdg_surface_listener surface_listener = {xdg_surface_configure};
+        xdg_surface_add_listener(xdg_surface_, &surface_listener, this);
+        xdg_toplevel_ = xdg_surface_get_toplevel(xdg_surface_);
+        xdg_toplevel_set_title(xdg_toplevel_, "mali_wrapper_present_bench");
+        wl_surface_commit(wl_surface_);
+        while (!configured_) {
+            if (wl_display_dispatch(wl_display_) < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    xcb_connection_t* xcb() const { return xcb_; }
+    xcb_window_t xcb_window() const { return window_; }
+    wl_display* wayland_display() const { return wl_display_; }
+    wl_surface* wayland_surface() const { return wl_surface_; }
+
+private:
+    static void registry_global(void* data, wl_registry* registry, uint32_t name, const char* interface,
+                                uint32_t version) {
+        auto* self = static_cast<Window*>(data);
+        if (std::strcmp(interface, wl_compositor_interface.name) == 0) {
+            self->compositor_ = static_cast<wl_compositor*>(
+                wl_registry_bind(registry, name, &wl_compositor_interface, std::min(version, 4u)));
+        } else if (std::strcmp(interface, xdg_wm_base_interface.name) == 0) {
+            // Version 1 has no toplevel events past configure and close.
+            self->wm_base_ = static_cast<xdg_wm_base*>(wl_registry_bind(registry, name, &xdg_wm_base_interface, 1));
+        }
+    }
+
+    static void registry_global_remove(void*, wl_registry*, uint32_t) {}
+
+    static void wm_base_ping(void*, xdg_wm_base* wm_base, uint32_t serial) { xdg_wm_base_pong(wm_base, serial); }
+
+    static void xdg_surface_configure(void* data, xdg_surface* surface, uint32_t serial) {
+        xdg_surface_ack_configure(surface, serial);
+        static_cast<Window*>(data)->configured_ = true;
+    }
+
+    xcb_connection_t* xcb_ = nullptr;
+    xcb_window_t window_ = 0;
+    wl_display* wl_display_ = nullptr;
+    wl_registry* registry_ = nullptr;
+    wl_compositor* compositor_ = nullptr;
+    xdg_wm_base* wm_base_ = nullptr;
+    wl_surface* wl_surface_ = nullptr;
+    xdg_surface* xdg_surface_ = nullptr;
+    xdg_toplevel* xdg_toplevel_ = nullptr;
+    bool configured_ = false;
+};
+
+bool has_extension(const std::vector<VkExtensionProperties>& extensions, const char* name) {
+    for (const VkExtensionProperties& extension : extensions) {
+        if (std::strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// One backend's instance, surface and device; the present modes are run on
+// it one swapchain after another.
+class PresentBench {
+public:
+    PresentBench(std::string backend, uint32_t frames) : backend_(std::move(backend)), frames_(frames) {}
+
+    ~PresentBench() {
+        if (device_ != VK_NULL_HANDLE) {
+            vkDeviceWaitIdle(device_);
+            vkDestroyCommandPool(device_, command_pool_, nullptr);
+            vkDestroyDevice(device_, nullptr);
+        }
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance_, surface_, nullptr);
+        }
+        if (instance_ != VK_NULL_HANDLE) {
+            vkDestroyInstance(instance_, nullptr);
+        }
+    }
+
+    // Returns the skip reason, or nullptr once the device is ready.
+    const char* Init() {
+        const char* surface_extension = VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME;
+        if (backend_ == "x11_shm" || backend_ == "xwayland_bridge") {
+            surface_extension = VK_KHR_XCB_SURFACE_EXTENSION_NAME;
+        } else if (backend_ == "wayland") {
+            surface_extension = VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME;
+        }
+
+        uint32_t count = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> instance_extensions(count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, instance_extensions.data());
+        if (!has_extension(instance_extensions, surface_extension)) {
+            return "no-surface-extension";
+        }
+
+        const char* enabled_instance_extensions[] = {VK_KHR_SURFACE_EXTENSION_NAME, surface_extension};
+        VkApplicationInfo app_info{};
+        app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        app_info.pApplicationName = "mali_wrapper_present_bench";
+        app_info.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instance_info{};
+        instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instance_info.pApplicationInfo = &app_info;
+        instance_info.enabledExtensionCount = 2;
+        instance_info.ppEnabledExtensionNames = enabled_instance_extensions;
+        if (vkCreateInstance(&instance_info, nullptr, &instance_) != VK_SUCCESS) {
+            instance_ = VK_NULL_HANDLE;
+            return "no-instance";
+        }
+
+        if (!CreateSurface()) {
+            return "no-surface";
+        }
+        return CreateDevice();
+    }
+
+    void RunAllModes() {
+        uint32_t count = 0;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device_, surface_, &count, nullptr);
+        std::vector<VkPresentModeKHR> modes(count);
+        vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device_, surface_, &count, modes.data());
+        std::printf("present.%s.present_wait=%d\n", backend_.c_str(), present_wait_ ? 1 : 0);
+        for (const VkPresentModeKHR mode : modes) {
+            if (present_mode_name(mode) != nullptr) {
+                RunMode(mode);
+            }
+        }
+        std::fflush(stdout);
+    }
+
+private:
+    bool CreateSurface() {
+        if (backend_ == "headless") {
+            VkHeadlessSurfaceCreateInfoEXT info{};
+            info.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+            return vkCreateHeadlessSurfaceEXT(instance_, &info, nullptr, &surface_) == VK_SUCCESS;
+        }
+        if (backend_ == "wayland") {
+            if (!window_.OpenWayland()) {
+                return false;
+            }
+            VkWaylandSurfaceCreateInfoKHR info{};
+            info.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+            info.display = window_.wayland_display();
+            info.surface = window_.wayland_surface();
+            return vkCreateWaylandSurfaceKHR(instance_, &info, nullptr, &surface_) == VK_SUCCESS;
+        }
+        if (!window_.OpenX11()) {
+            return false;
+        }
+        VkXcbSurfaceCreateInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+        info.connection = window_.xcb();
+        info.window = window_.xcb_window();
+        return vkCreateXcbSurfaceKHR(instance_, &info, nullptr, &surface_) == VK_SUCCESS;
+    }
+
+    // Takes the first device with a queue family that renders and presents to
+    // the surface, and turns on present IDs and waits where it has them.
+    const char* CreateDevice() {
+        uint32_t count = 0;
+        vkEnumeratePhysicalDevices(instance_, &count, nullptr);
+        std::vector<VkPhysicalDevice> devices(count);
+        vkEnumeratePhysicalDevices(instance_, &count, devices.data());
+        for (const VkPhysicalDevice device : devices) {
+            uint32_t family_count = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
+            std::vector<VkQueueFamilyProperties> families(family_count);
+            vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
+            for (uint32_t family = 0; family < family_count; family++) {
+                VkBool32 supported = VK_FALSE;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, family, surface_, &supported);
+                if ((families[family].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0 && supported == VK_TRUE) {
+                    physical_device_ = device;
+                    queue_family_ = family;
+                    break;
+                }
+            }
+            if (physical_device_ != VK_NULL_HANDLE) {
+                break;
+            }
+        }
+        if (physical_device_ == VK_NULL_HANDLE) {
+            return "no-present-queue";
+        }
+
+        vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> device_extensions(count);
+        vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &count, device_extensions.data());
+        std::vector<const char*> enabled_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+        VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+        present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+        present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        present_id_features.pNext = &present_wait_features;
+        VkPhysicalDeviceFeatures2 features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        if (has_extension(device_extensions, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+            has_extension(device_extensions, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+            features.pNext = &present_id_features;
+            vkGetPhysicalDeviceFeatures2(physical_device_, &features);
+            present_wait_ = present_id_features.presentId == VK_TRUE && present_wait_features.presentWait == VK_TRUE;
+        }
+        if (present_wait_) {
+            enabled_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabled_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        } else {
+            features.pNext = nullptr;
+        }
+        // Only the chained feature structs are enabled.
+        features.features = VkPhysicalDeviceFeatures{};
+
+        const float priority = 1.0f;
+        VkDeviceQueueCreateInfo queue_info{};
+        queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_info.queueFamilyIndex = queue_family_;
+        queue_info.queueCount = 1;
+        queue_info.pQueuePriorities = &priority;
+        VkDeviceCreateInfo device_info{};
+        device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        device_info.pNext = &features;
+        device_info.queueCreateInfoCount = 1;
+        device_info.pQueueCreateInfos = &queue_info;
+        device_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+        device_info.ppEnabledExtensionNames = enabled_extensions.data();
+        if (vkCreateDevice(physical_device_, &device_info, nullptr, &device_) != VK_SUCCESS) {
+            device_ = VK_NULL_HANDLE;
+            return "no-device";
+        }
+        vkGetDeviceQueue(device_, queue_family_, 0, &queue_);
+        if (present_wait_) {
+            wait_for_present_ =
+                reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device_, "vkWaitForPresentKHR"));
+            present_wait_ = wait_for_present_ != nullptr;
+        }
+
+        VkCommandPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.queueFamilyIndex = queue_family_;
+        if (vkCreateCommandPool(device_, &pool_info, nullptr, &command_pool_) != VK_SUCCESS) {
+            return "no-command-pool";
+        }
+        return nullptr;
+    }
+
+    // Per swapchain state: one clear command buffer and fence per image, and
+    // a ring of acquire semaphores one longer than the image count.
+    struct Swapchain {
+        VkSwapchainKHR handle = VK_NULL_HANDLE;
+        std::vector<VkImage> images;
+        std::vector<VkCommandBuffer> commands;
+        std::vector<VkFence> fences;
+        std::vector<VkSemaphore> rendered;
+        std::vector<VkSemaphore> acquired;
+        uint32_t next_acquired = 0;
+    };
+
+    bool CreateSwapchain(VkPresentModeKHR mode, Swapchain* swapchain) {
+        VkSurfaceCapabilitiesKHR caps{};
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device_, surface_, &caps);
+        if ((caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
+            return false;
+        }
+        VkExtent2D extent = caps.currentExtent;
+        if (extent.width == UINT32_MAX) {
+            extent.width = std::clamp(kWindowWidth, caps.minImageExtent.width, caps.maxImageExtent.width);
+            extent.height = std::clamp(kWindowHeight, caps.minImageExtent.height, caps.maxImageExtent.height);
+        }
+        uint32_t image_count = caps.minImageCount + 1;
+        if (caps.maxImageCount != 0) {
+            image_count = std::min(image_count, caps.maxImageCount);
+        }
+
+        uint32_t format_count = 0;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device_, surface_, &format_count, nullptr);
+        std::vector<VkSurfaceFormatKHR> formats(format_count);
+        vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device_, surface_, &format_count, formats.data());
+        if (formats.empty()) {
+            return false;
+        }
+        VkSurfaceFormatKHR format = formats[0];
+        for (const VkSurfaceFormatKHR& candidate : formats) {
+            if (candidate.format == VK_FORMAT_B8G8R8A8_UNORM) {
+                format = candidate;
+                break;
+            }
+        }
+
+        VkSwapchainCreateInfoKHR info{};
+        info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+        info.surface = surface_;
+        info.minImageCount = image_count;
+        info.imageFormat = format.format;
+        info.imageColorSpace = format.colorSpace;
+        info.imageExtent = extent;
+        info.imageArrayLayers = 1;
+        info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        info.preTransform = caps.currentTransform;
+        info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+        if ((caps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR) == 0) {
+            info.compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+        }
+        info.presentMode = mode;
+        info.clipped = VK_TRUE;
+        if (vkCreateSwapchainKHR(device_, &info, nullptr, &swapchain->handle) != VK_SUCCESS) {
+            swapchain->handle = VK_NULL_HANDLE;
+            return false;
+        }
+
+        vkGetSwapchainImagesKHR(device_, swapchain->handle, &image_count, nullptr);
+        swapchain->images.resize(image_count);
+        vkGetSwapchainImagesKHR(device_, swapchain->handle, &image_count, swapchain->images.data());
+        swapchain->commands.resize(image_count);
+        VkCommandBufferAllocateInfo command_info{};
+        command_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_info.commandPool = command_pool_;
+        command_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_info.commandBufferCount = image_count;
+        if (vkAllocateCommandBuffers(device_, &command_info, swapchain->commands.data()) != VK_SUCCESS) {
+            swapchain->commands.clear();
+            return false;
+        }
+
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        for (uint32_t i = 0; i < image_count; i++) {
+            VkFence fence = VK_NULL_HANDLE;
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            vkCreateFence(device_, &fence_info, nullptr, &fence);
+            vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore);
+            swapchain->fences.push_back(fence);
+            swapchain->rendered.push_back(semaphore);
+            RecordClear(swapchain->commands[i], swapchain->images[i], i);
+        }
+        for (uint32_t i = 0; i <= image_count; i++) {
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore);
+            swapchain->acquired.push_back(semaphore);
+        }
+        return true;
+    }
+
+    void DestroySwapchain(Swapchain* swapchain) {
+        vkDeviceWaitIdle(device_);
+        for (const VkFence fence : swapchain->fences) {
+            vkDestroyFence(device_, fence, nullptr);
+        }
+        for (const VkSemaphore semaphore : swapchain->rendered) {
+            vkDestroySemaphore(device_, semaphore, nullptr);
+        }
+        for (const VkSemaphore semaphore : swapchain->acquired) {
+            vkDestroySemaphore(device_, semaphore, nullptr);
+        }
+        if (!swapchain->commands.empty()) {
+            vkFreeCommandBuffers(device_, command_pool_, static_cast<uint32_t>(swapchain->commands.size()),
+                                 swapchain->commands.data());
+        }
+        if (swapchain->handle != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device_, swapchain->handle, nullptr);
+        }
+        *swapchain = Swapchain{};
+    }
+
+    // Clears the image to a grey that differs per image, so a stuck image
+    // shows on screen.
+    void RecordClear(VkCommandBuffer command, VkImage image, uint32_t index) {
+        VkCommandBufferBeginInfo begin{};
+        begin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vkBeginCommandBuffer(command, &begin);
+
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        vkCmdPipelineBarrier(command, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                             0, nullptr, 1, &barrier);
+
+        const float shade = 0.25f + 0.125f * static_cast<float>(index % 4);
+        VkClearColorValue color{};
+        color.float32[0] = shade;
+        color.float32[1] = shade;
+        color.float32[2] = shade;
+        color.float32[3] = 1.0f;
+        vkCmdClearColorImage(command, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1,
+                             &barrier.subresourceRange);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        vkCmdPipelineBarrier(command, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+        vkEndCommandBuffer(command);
+    }
+
+    // Times of one frame: the vkAcquireNextImageKHR and vkQueuePresentKHR
+    // calls, and when the latter was made.
+    struct FrameTiming {
+        uint64_t acquire_ns = 0;
+        uint64_t present_ns = 0;
+        uint64_t present_start_ns = 0;
+    };
+
+    // Acquires, clears and presents one frame. present_id is 0 for none.
+    // Returns false when the swapchain stopped accepting frames.
+    bool PresentFrame(Swapchain* swapchain, uint64_t present_id, FrameTiming* timing) {
+        const VkSemaphore acquired = swapchain->acquired[swapchain->next_acquired];
+        swapchain->next_acquired = (swapchain->next_acquired + 1) % static_cast<uint32_t>(swapchain->acquired.size());
+
+        uint32_t index = 0;
+        const uint64_t acquire_start = now_ns();
+        const VkResult acquire_result =
+            vkAcquireNextImageKHR(device_, swapchain->handle, UINT64_MAX, acquired, VK_NULL_HANDLE, &index);
+        timing->acquire_ns = now_ns() - acquire_start;
+        if (acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR) {
+            return false;
+        }
+
+        vkWaitForFences(device_, 1, &swapchain->fences[index], VK_TRUE, UINT64_MAX);
+        vkResetFences(device_, 1, &swapchain->fences[index]);
+        const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submit{};
+        submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit.waitSemaphoreCount = 1;
+        submit.pWaitSemaphores = &acquired;
+        submit.pWaitDstStageMask = &wait_stage;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &swapchain->commands[index];
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &swapchain->rendered[index];
+        if (vkQueueSubmit(queue_, 1, &submit, swapchain->fences[index]) != VK_SUCCESS) {
+            return false;
+        }
+
+        VkPresentIdKHR id_info{};
+        id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        id_info.swapchainCount = 1;
+        id_info.pPresentIds = &present_id;
+        VkPresentInfoKHR present{};
+        present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        present.pNext = present_id != 0 ? &id_info : nullptr;
+        present.waitSemaphoreCount = 1;
+        present.pWaitSemaphores = &swapchain->rendered[index];
+        present.swapchainCount = 1;
+        present.pSwapchains = &swapchain->handle;
+        present.pImageIndices = &index;
+        timing->present_start_ns = now_ns();
+        const VkResult present_result = vkQueuePresentKHR(queue_, &present);
+        timing->present_ns = now_ns() - timing->present_start_ns;
+        return present_result == VK_SUCCESS || present_result == VK_SUBOPTIMAL_KHR;
+    }
+
+    void RunMode(VkPresentModeKHR mode) {
+        const std::string key = "present." + backend_ + "." + present_mode_name(mode);
+        Swapchain swapchain;
+        if (!CreateSwapchain(mode, &swapchain)) {
+            std::printf("%s.skipped=no-swapchain\n", key.c_str());
+            DestroySwapchain(&swapchain);
+            return;
+        }
+
+        // Throughput: frames back to back, as an application renders.
+        std::vector<uint64_t> acquire_times;
+        std::vector<uint64_t> present_times;
+        std::vector<uint64_t> frame_times;
+        acquire_times.reserve(frames_);
+        present_times.reserve(frames_);
+        frame_times.reserve(frames_);
+        bool ok = true;
+        uint64_t previous_present = 0;
+        uint64_t run_start = 0;
+        uint32_t presented = 0;
+        for (uint32_t frame = 0; frame < kWarmupFrames + frames_ && ok; frame++) {
+            if (frame == kWarmupFrames) {
+                run_start = now_ns();
+            }
+            FrameTiming timing;
+            ok = PresentFrame(&swapchain, 0, &timing);
+            const uint64_t presented_at = now_ns();
+            if (ok && frame >= kWarmupFrames) {
+                acquire_times.push_back(timing.acquire_ns);
+                present_times.push_back(timing.present_ns);
+                if (previous_present != 0) {
+                    frame_times.push_back(presented_at - previous_present);
+                }
+                presented++;
+            }
+            previous_present = presented_at;
+        }
+        const uint64_t run_ns = run_start != 0 ? now_ns() - run_start : 0;
+
+        const Stats acquire = summarize(acquire_times);
+        const Stats present = summarize(present_times);
+        const Stats frame_time = summarize(frame_times);
+        std::printf("%s.frames=%u\n", key.c_str(), presented);
+        if (!ok) {
+            std::printf("%s.stopped=present-failed\n", key.c_str());
+        }
+        std::printf("%s.fps=%.1f\n", key.c_str(),
+                    run_ns > 0 ? static_cast<double>(presented) * 1e9 / static_cast<double>(run_ns) : 0.0);
+        std::printf("%s.acquire_mean_us=%.1f\n", key.c_str(), acquire.mean_ns / 1e3);
+        std::printf("%s.acquire_max_us=%.1f\n", key.c_str(), static_cast<double>(acquire.max_ns) / 1e3);
+        std::printf("%s.present_mean_us=%.1f\n", key.c_str(), present.mean_ns / 1e3);
+        std::printf("%s.present_max_us=%.1f\n", key.c_str(), static_cast<double>(present.max_ns) / 1e3);
+        std::printf("%s.frame_time_mean_ms=%.3f\n", key.c_str(), frame_time.mean_ns / 1e6);
+        std::printf("%s.frame_time_max_ms=%.3f\n", key.c_str(), static_cast<double>(frame_time.max_ns) / 1e6);
+        std::printf("%s.frame_time_jitter_ms=%.3f\n", key.c_str(), frame_time.stddev_ns / 1e6);
+
+        // Latency: each frame is waited for before the next is presented, so
+        // queued frames do not add to it.
+        if (ok && present_wait_) {
+            std::vector<uint64_t> latencies;
+            uint32_t timeouts = 0;
+            for (uint64_t id = 1; id <= kLatencyFrames && ok; id++) {
+                FrameTiming timing;
+                ok = PresentFrame(&swapchain, id, &timing);
+                if (!ok) {
+                    break;
+                }
+                const VkResult result = wait_for_present_(device_, swapchain.handle, id, kPresentWaitTimeoutNs);
+                if (result == VK_SUCCESS) {
+                    latencies.push_back(now_ns() - timing.present_start_ns);
+                } else if (result == VK_TIMEOUT) {
+                    timeouts++;
+                } else {
+                    ok = false;
+                }
+            }
+            const Stats latency = summarize(latencies);
+            std::printf("%s.latency_samples=%zu\n", key.c_str(), latencies.size());
+            std::printf("%s.latency_timeouts=%u\n", key.c_str(), timeouts);
+            std::printf("%s.latency_mean_us=%.1f\n", key.c_str(), latency.mean_ns / 1e3);
+            std::printf("%s.latency_max_us=%.1f\n", key.c_str(), static_cast<double>(latency.max_ns) / 1e3);
+        }
+
+        DestroySwapchain(&swapchain);
+    }
+
+    std::string backend_;
+    uint32_t frames_;
+    Window window_;
+    VkInstance instance_ = VK_NULL_HANDLE;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    uint32_t queue_family_ = 0;
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueue queue_ = VK_NULL_HANDLE;
+    VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    bool present_wait_ = false;
+    PFN_vkWaitForPresentKHR wait_for_present_ = nullptr;
+};
+
+// Runs one backend in this process; the environment must be set first.
+bool run_backend(const std::string& backend, uint32_t frames) {
+    const char* reason = prepare_backend(backend);
+    if (reason == nullptr) {
+        PresentBench bench(backend, frames);
+        reason = bench.Init();
+        if (reason == nullptr) {
+            bench.RunAllModes();
+            return true;
+        }
+    }
+    std::printf("present.%s.skipped=%s\n", backend.c_str(), reason);
+    std::fflush(stdout);
+    return std::strcmp(reason, "unknown-backend") != 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string only_backend;
+    uint32_t frames = kDefaultFrames;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            only_backend = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::fprintf(stderr, "usage: %s [--backend <name>] [--frames <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (frames == 0) {
+        std::fprintf(stderr, "mali_wrapper_present_bench: --frames must be at least 1\n");
+        return 2;
+    }
+    if (!only_backend.empty()) {
+        return run_backend(only_backend, frames) ? 0 : 1;
+    }
+
+    bool ok = true;
+    std::fflush(stdout);
+    for (const char* backend : kBackends) {
+        const pid_t child = fork();
+        if (child < 0) {
+            std::fprintf(stderr, "mali_wrapper_present_bench: fork failed: %s\n", std::strerror(errno));
+            return 1;
+        }
+        if (child == 0) {
+            _exit(run_backend(backend, frames) ? 0 : 1);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok ? 0 : 1;
+}
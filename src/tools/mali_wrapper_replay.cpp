@@ -0,0 +1,333 @@
+// mali-wrapper-replay: plays a MALI_WRAPPER_RECORD_MEMORY recording back
+// against the low-address engine, without the application or a GPU, and
+// prints per-call timings as key=value lines.
+//
+//   mali-wrapper-replay <file.mwrec>
+//
+// Every allocation is backed by high anonymous memory, created on its first
+// map, and treated as HOST_VISIBLE | HOST_COHERENT since the recording only
+// keeps the memory type index. The recording has no application writes, so
+// each flushed range is written through the mapping just before its flush;
+// submits then write back whatever the engine still considers dirty. The
+// engine options come from MALI_WRAPPER_LOW_ADDRESS_MAP, which defaults to 1.
+
+#include "../core/harness.hpp"
+#include "../core/memory_recorder.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <sys/mman.h>
+
+namespace harness = mali_wrapper::harness;
+using mali_wrapper::MemoryRecord;
+using mali_wrapper::MemoryRecordingHeader;
+using mali_wrapper::RecordedCall;
+
+namespace {
+
+constexpr size_t kCallCount = static_cast<size_t>(RecordedCall::COUNT);
+constexpr VkMemoryPropertyFlags kReplayMemoryFlags =
+    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+const char* call_name(RecordedCall call) {
+    switch (call) {
+    case RecordedCall::ALLOCATE_MEMORY:
+        return "allocate";
+    case RecordedCall::FREE_MEMORY:
+        return "free";
+    case RecordedCall::MAP_MEMORY:
+        return "map";
+    case RecordedCall::UNMAP_MEMORY:
+        return "unmap";
+    case RecordedCall::FLUSH_RANGE:
+        return "flush";
+    case RecordedCall::INVALIDATE_RANGE:
+        return "invalidate";
+    case RecordedCall::QUEUE_SUBMIT:
+        return "submit";
+    default:
+        return "unknown";
+    }
+}
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <typename T>
+T fake_handle(uint64_t value) {
+    T handle{};
+    std::memcpy(&handle, &value, std::min(sizeof(handle), sizeof(value)));
+    return handle;
+}
+
+struct ReplayAllocation {
+    uint64_t size = 0;
+    // Backing memory, created on the first map.
+    uint8_t* real = nullptr;
+    // What the engine returned for the live mapping, and the range it covers.
+    uint8_t* view = nullptr;
+    uint64_t map_offset = 0;
+    uint64_t map_size = 0;
+};
+
+struct CallStats {
+    uint64_t count = 0;
+    uint64_t elapsed_ns = 0;
+    uint64_t bytes = 0;
+};
+
+class Replayer {
+public:
+    explicit Replayer(VkDevice device) : device_(device) {}
+
+    void Play(const MemoryRecord& record);
+    void Finish();
+    void Report(uint64_t recorded_ns) const;
+
+private:
+    ReplayAllocation* Find(uint64_t object);
+    // Bytes a map or range covers, resolving VK_WHOLE_SIZE.
+    uint64_t RangeSize(const ReplayAllocation& allocation, uint64_t offset, uint64_t size) const;
+
+    VkDevice device_;
+    std::unordered_map<uint64_t, ReplayAllocation> allocations_;
+    CallStats stats_[kCallCount];
+    uint64_t skipped_ = 0;
+    // Maps the engine left on the real pointer.
+    uint64_t passthrough_maps_ = 0;
+};
+
+ReplayAllocation* Replayer::Find(uint64_t object) {
+    auto it = allocations_.find(object);
+    return it != allocations_.end() ? &it->second : nullptr;
+}
+
+uint64_t Replayer::RangeSize(const ReplayAllocation& allocation, uint64_t offset, uint64_t size) const {
+    if (offset >= allocation.size) {
+        return 0;
+    }
+    return size == VK_WHOLE_SIZE ? allocation.size - offset : std::min(size, allocation.size - offset);
+}
+
+void Replayer::Play(const MemoryRecord& record) {
+    const size_t call_index = static_cast<size_t>(record.call);
+    if (call_index >= kCallCount) {
+        skipped_++;
+        return;
+    }
+
+    const VkDeviceMemory memory = fake_handle<VkDeviceMemory>(record.object);
+    ReplayAllocation* allocation = record.call == RecordedCall::QUEUE_SUBMIT ? nullptr : Find(record.object);
+    if (record.call != RecordedCall::ALLOCATE_MEMORY && record.call != RecordedCall::QUEUE_SUBMIT &&
+        allocation == nullptr) {
+        // Allocated before the recording started.
+        skipped_++;
+        return;
+    }
+
+    CallStats& stats = stats_[call_index];
+    uint64_t start = 0;
+    switch (record.call) {
+    case RecordedCall::ALLOCATE_MEMORY: {
+        ReplayAllocation& created = allocations_[record.object];
+        created = ReplayAllocation{};
+        created.size = record.size;
+        start = now_ns();
+        harness::TrackAllocation(device_, memory, record.size, kReplayMemoryFlags);
+        break;
+    }
+    case RecordedCall::FREE_MEMORY: {
+        start = now_ns();
+        harness::FreeMemory(device_, memory);
+        stats.elapsed_ns += now_ns() - start;
+        stats.count++;
+        if (allocation->real != nullptr) {
+            munmap(allocation->real, allocation->size);
+        }
+        allocations_.erase(record.object);
+        return;
+    }
+    case RecordedCall::MAP_MEMORY: {
+        const uint64_t bytes = RangeSize(*allocation, record.offset, record.size);
+        if (bytes == 0 || allocation->view != nullptr) {
+            skipped_++;
+            return;
+        }
+        if (allocation->real == nullptr) {
+            void* real = mmap(nullptr, allocation->size, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (real == MAP_FAILED) {
+                std::fprintf(stderr, "mali-wrapper-replay: cannot back %" PRIu64 " bytes: %s\n", allocation->size,
+                             std::strerror(errno));
+                skipped_++;
+                return;
+            }
+            allocation->real = static_cast<uint8_t*>(real);
+        }
+        start = now_ns();
+        void* view = harness::MapMemory(device_, memory, record.offset, record.size,
+                                        allocation->real + record.offset);
+        stats.elapsed_ns += now_ns() - start;
+        stats.count++;
+        stats.bytes += bytes;
+        allocation->view = static_cast<uint8_t*>(view);
+        allocation->map_offset = record.offset;
+        allocation->map_size = bytes;
+        if (view == allocation->real + record.offset) {
+            passthrough_maps_++;
+        }
+        return;
+    }
+    case RecordedCall::UNMAP_MEMORY:
+        if (allocation->view == nullptr) {
+            skipped_++;
+            return;
+        }
+        start = now_ns();
+        harness::UnmapMemory(device_, memory);
+        allocation->view = nullptr;
+        break;
+    case RecordedCall::FLUSH_RANGE:
+    case RecordedCall::INVALIDATE_RANGE: {
+        const uint64_t map_end = allocation->map_offset + allocation->map_size;
+        if (allocation->view == nullptr || record.offset < allocation->map_offset || record.offset >= map_end) {
+            skipped_++;
+            return;
+        }
+        const uint64_t bytes = std::min(RangeSize(*allocation, record.offset, record.size), map_end - record.offset);
+        if (record.call == RecordedCall::FLUSH_RANGE) {
+            std::memset(allocation->view + (record.offset - allocation->map_offset),
+                        static_cast<int>(stats.count & 0xff), static_cast<size_t>(bytes));
+        }
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = memory;
+        range.offset = record.offset;
+        range.size = record.size;
+        start = now_ns();
+        if (record.call == RecordedCall::FLUSH_RANGE) {
+            harness::FlushRanges(device_, 1, &range);
+        } else {
+            harness::InvalidateRanges(device_, 1, &range);
+        }
+        stats.bytes += bytes;
+        break;
+    }
+    case RecordedCall::QUEUE_SUBMIT:
+        start = now_ns();
+        harness::SyncForSubmit(device_);
+        break;
+    default:
+        skipped_++;
+        return;
+    }
+
+    stats.elapsed_ns += now_ns() - start;
+    stats.count++;
+}
+
+void Replayer::Finish() {
+    for (auto& entry : allocations_) {
+        ReplayAllocation& allocation = entry.second;
+        const VkDeviceMemory memory = fake_handle<VkDeviceMemory>(entry.first);
+        if (allocation.view != nullptr) {
+            harness::UnmapMemory(device_, memory);
+        }
+        harness::FreeMemory(device_, memory);
+        if (allocation.real != nullptr) {
+            munmap(allocation.real, allocation.size);
+        }
+    }
+    allocations_.clear();
+}
+
+void Replayer::Report(uint64_t recorded_ns) const {
+    uint64_t total_ns = 0;
+    for (size_t i = 0; i < kCallCount; i++) {
+        const CallStats& stats = stats_[i];
+        const char* name = call_name(static_cast<RecordedCall>(i));
+        total_ns += stats.elapsed_ns;
+        std::printf("replay.%s.count=%" PRIu64 "\n", name, stats.count);
+        std::printf("replay.%s.total_ns=%" PRIu64 "\n", name, stats.elapsed_ns);
+        std::printf("replay.%s.ns_per_op=%.1f\n", name,
+                    stats.count > 0 ? static_cast<double>(stats.elapsed_ns) / static_cast<double>(stats.count) : 0.0);
+        if (stats.bytes > 0) {
+            std::printf("replay.%s.bytes=%" PRIu64 "\n", name, stats.bytes);
+            std::printf("replay.%s.gb_per_s=%.3f\n", name,
+                        stats.elapsed_ns > 0 ? static_cast<double>(stats.bytes) / static_cast<double>(stats.elapsed_ns)
+                                             : 0.0);
+        }
+    }
+    std::printf("replay.engine_ns=%" PRIu64 "\n", total_ns);
+    std::printf("replay.recorded_ns=%" PRIu64 "\n", recorded_ns);
+    std::printf("replay.passthrough_maps=%" PRIu64 "\n", passthrough_maps_);
+    std::printf("replay.skipped_records=%" PRIu64 "\n", skipped_);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 2 || std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0) {
+        std::fprintf(stderr, "usage: %s <file.mwrec>\n", argv[0]);
+        return 2;
+    }
+
+    FILE* file = std::fopen(argv[1], "rb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "mali-wrapper-replay: cannot open %s: %s\n", argv[1], std::strerror(errno));
+        return 1;
+    }
+
+    MemoryRecordingHeader header{};
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, mali_wrapper::kMemoryRecordingMagic, sizeof(header.magic)) != 0) {
+        std::fprintf(stderr, "mali-wrapper-replay: %s is not a memory recording\n", argv[1]);
+        std::fclose(file);
+        return 1;
+    }
+    if (header.version != mali_wrapper::kMemoryRecordingVersion || header.record_size != sizeof(MemoryRecord)) {
+        std::fprintf(stderr, "mali-wrapper-replay: unsupported recording version %u, record size %u\n",
+                     header.version, header.record_size);
+        std::fclose(file);
+        return 1;
+    }
+
+    // The engine reads its options once, on first use.
+    setenv("MALI_WRAPPER_LOW_ADDRESS_MAP", "1", 0);
+    const VkDevice device = fake_handle<VkDevice>(0x10000);
+    harness::RegisterDevice(device);
+    harness::SetAliasEnabled(device, false);
+
+    Replayer replayer(device);
+    std::vector<MemoryRecord> batch(4096);
+    uint64_t records = 0;
+    uint64_t recorded_ns = 0;
+    size_t read = 0;
+    while ((read = std::fread(batch.data(), sizeof(MemoryRecord), batch.size(), file)) > 0) {
+        for (size_t i = 0; i < read; i++) {
+            replayer.Play(batch[i]);
+            recorded_ns = batch[i].time_ns;
+        }
+        records += read;
+    }
+    std::fclose(file);
+    replayer.Finish();
+    harness::UnregisterDevice(device);
+
+    std::printf("replay.file=%s\n", argv[1]);
+    std::printf("replay.pid=%u\n", header.pid);
+    std::printf("replay.records=%" PRIu64 "\n", records);
+    const char* options = getenv("MALI_WRAPPER_LOW_ADDRESS_MAP");
+    std::printf("replay.low_address_map=%s\n", options != nullptr ? options : "");
+    replayer.Report(recorded_ns);
+    return 0;
+}
@@ -0,0 +1,242 @@
+// mali_wrapper_shm_bench: times the X11 SHM presenter's pixel copies on
+// synthetic frames and prints ms/frame and GB/s as key=value lines.
+//
+//   mali_wrapper_shm_bench                every copy thread count
+//   mali_wrapper_shm_bench --threads <n>  only WSI_SHM_COPY_THREADS=<n>
+//
+// Each thread count runs in a forked child, because the presenter's copy pool
+// reads WSI_SHM_COPY_THREADS once per process. Frames are swept over common
+// resolutions and source strides and read from malloc memory and from
+// buffers of the "system" (cached) and "system-uncached" dma-buf heaps, which
+// back swapchain images; the destination is ordinary memory like an SHM
+// segment. GB/s counts the bytes written.
+
+#include "../core/harness.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <linux/dma-heap.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace harness = mali_wrapper::harness;
+using mali_wrapper::harness::ShmCopyPath;
+
+namespace {
+
+constexpr uint32_t kFrames = 32;
+constexpr uint32_t kWarmupFrames = 2;
+
+struct Resolution {
+    uint32_t width;
+    uint32_t height;
+};
+
+constexpr Resolution kResolutions[] = {{1280, 720}, {1920, 1080}, {2560, 1440}, {3840, 2160}};
+
+struct PathInfo {
+    ShmCopyPath path;
+    const char* name;
+};
+
+constexpr PathInfo kPaths[] = {
+    {ShmCopyPath::MEMCPY_BANDS, "memcpy"},
+    {ShmCopyPath::THREADED, "threaded"},
+    {ShmCopyPath::SIMD, "simd"},
+    {ShmCopyPath::SCALAR, "scalar"},
+    {ShmCopyPath::LUT, "lut"},
+};
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// A frame-sized source buffer; fd is the dma-buf, or -1 for malloc memory.
+struct SourceBuffer {
+    void* ptr = nullptr;
+    size_t size = 0;
+    int fd = -1;
+};
+
+bool allocate_heap_buffer(const char* heap, size_t size, SourceBuffer* out) {
+    const std::string path = std::string("/dev/dma_heap/") + heap;
+    const int heap_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (heap_fd < 0) {
+        return false;
+    }
+
+    struct dma_heap_allocation_data request{};
+    request.len = size;
+    request.fd_flags = O_RDWR | O_CLOEXEC;
+    const int result = ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &request);
+    close(heap_fd);
+    if (result != 0) {
+        return false;
+    }
+
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, static_cast<int>(request.fd), 0);
+    if (ptr == MAP_FAILED) {
+        close(static_cast<int>(request.fd));
+        return false;
+    }
+    out->ptr = ptr;
+    out->size = size;
+    out->fd = static_cast<int>(request.fd);
+    return true;
+}
+
+bool allocate_source(const char* source, size_t size, SourceBuffer* out) {
+    *out = SourceBuffer{};
+    if (std::strcmp(source, "malloc") == 0) {
+        out->ptr = std::malloc(size);
+        out->size = size;
+        return out->ptr != nullptr;
+    }
+    return allocate_heap_buffer(std::strcmp(source, "cached") == 0 ? "system" : "system-uncached", size, out);
+}
+
+void free_source(const SourceBuffer& buffer) {
+    if (buffer.fd < 0) {
+        std::free(buffer.ptr);
+        return;
+    }
+    munmap(buffer.ptr, buffer.size);
+    close(buffer.fd);
+}
+
+// Packed rows, rows padded to 64 pixels as Mali lays out linear images, and
+// rows with a 16-pixel tail that keeps them off any alignment.
+std::vector<uint32_t> source_strides(uint32_t width) {
+    std::vector<uint32_t> strides = {width};
+    const uint32_t aligned = (width + 63) & ~63u;
+    if (aligned != width) {
+        strides.push_back(aligned);
+    }
+    strides.push_back(width + 16);
+    return strides;
+}
+
+// single_thread_paths adds SIMD and SCALAR, which ignore the pool and so
+// are measured only once.
+void run_sweep(bool single_thread_paths) {
+    const uint32_t threads = harness::ShmCopyThreadCount();
+    for (const char* source : {"malloc", "cached", "uncached"}) {
+        SourceBuffer probe{};
+        if (!allocate_source(source, 4096, &probe)) {
+            std::printf("shm_copy.%s.skipped=no-buffer\n", source);
+            continue;
+        }
+        free_source(probe);
+
+        for (const Resolution resolution : kResolutions) {
+            for (const uint32_t stride : source_strides(resolution.width)) {
+                const size_t source_size = static_cast<size_t>(stride) * resolution.height * sizeof(uint32_t);
+                SourceBuffer buffer{};
+                if (!allocate_source(source, source_size, &buffer)) {
+                    continue;
+                }
+                std::memset(buffer.ptr, 0x3c, source_size);
+                const size_t dst_pixels = static_cast<size_t>(resolution.width) * resolution.height;
+                std::vector<uint32_t> dst(dst_pixels);
+
+                for (const PathInfo& info : kPaths) {
+                    const bool pooled = info.path != ShmCopyPath::SIMD && info.path != ShmCopyPath::SCALAR;
+                    if (!pooled && !single_thread_paths) {
+                        continue;
+                    }
+                    // The LUT path shrinks the frame to three quarters of its
+                    // width, as for a smaller window.
+                    const uint32_t dst_width =
+                        info.path == ShmCopyPath::LUT ? resolution.width * 3 / 4 : resolution.width;
+                    const auto* src = static_cast<const uint32_t*>(buffer.ptr);
+                    bool applies = true;
+                    uint64_t elapsed = 0;
+                    for (uint32_t frame = 0; frame < kWarmupFrames + kFrames && applies; frame++) {
+                        const uint64_t start = now_ns();
+                        applies = harness::ShmCopyFrame(info.path, src, resolution.width, stride, dst.data(), dst_width,
+                                                        resolution.height);
+                        if (frame >= kWarmupFrames) {
+                            elapsed += now_ns() - start;
+                        }
+                    }
+                    if (!applies) {
+                        continue;
+                    }
+
+                    const uint64_t bytes = static_cast<uint64_t>(kFrames) * dst_width * resolution.height *
+                                           sizeof(uint32_t);
+                    const std::string key = std::string("shm_copy.") + info.name + "." + source + "." +
+                                            std::to_string(resolution.width) + "x" +
+                                            std::to_string(resolution.height) + ".stride_" + std::to_string(stride) +
+                                            ".threads_" + std::to_string(pooled ? threads : 1);
+                    std::printf("%s.ms_per_frame=%.3f\n", key.c_str(),
+                                static_cast<double>(elapsed) / static_cast<double>(kFrames) / 1e6);
+                    // Bytes per nanosecond are GB/s.
+                    std::printf("%s.gb_per_s=%.3f\n", key.c_str(),
+                                elapsed > 0 ? static_cast<double>(bytes) / static_cast<double>(elapsed) : 0.0);
+                }
+
+                free_source(buffer);
+            }
+        }
+    }
+    std::fflush(stdout);
+}
+
+// Helper thread counts worth comparing: none, one, three (the default cap)
+// and every core but the presenting one.
+std::vector<uint32_t> worker_counts() {
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<uint32_t> counts;
+    for (const uint32_t count : {0u, 1u, 3u, cores - 1}) {
+        if (count < cores && std::find(counts.begin(), counts.end(), count) == counts.end()) {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && std::strcmp(argv[1], "--threads") == 0) {
+        setenv("WSI_SHM_COPY_THREADS", argv[2], 1);
+        run_sweep(true);
+        return 0;
+    }
+    if (argc != 1) {
+        std::fprintf(stderr, "usage: %s [--threads <n>]\n", argv[0]);
+        return 2;
+    }
+
+    bool ok = true;
+    std::fflush(stdout);
+    for (const uint32_t workers : worker_counts()) {
+        const pid_t child = fork();
+        if (child < 0) {
+            std::fprintf(stderr, "mali_wrapper_shm_bench: fork failed: %s\n", std::strerror(errno));
+            return 1;
+        }
+        if (child == 0) {
+            setenv("WSI_SHM_COPY_THREADS", std::to_string(workers).c_str(), 1);
+            run_sweep(workers == 0);
+            _exit(0);
+        }
+
+        int status = 0;
+        waitpid(child, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,17 +1,63 @@
 #include "logging.hpp"
 #include <iostream>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <cctype>
+#include <cerrno>
+#include <system_error>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace mali_wrapper {
 
 namespace {
 
+// Async ring geometry: 4096 records of 512 bytes, allocated only when
+// MALI_WRAPPER_LOG_ASYNC is set. Longer messages are truncated.
+constexpr size_t kAsyncRingSlots = 4096;
+constexpr size_t kAsyncPayloadSize = 480;
+constexpr auto kAsyncWriterInterval = std::chrono::milliseconds(5);
+
+uint64_t realtime_now_ns()
+{
+    struct timespec ts{};
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+int32_t current_thread_id()
+{
+    thread_local const int32_t tid = static_cast<int32_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void write_fd_all(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
 static uint32_t category_mask(LogCategory category)
 {
     return static_cast<uint32_t>(category);
@@ -57,8 +103,283 @@ static bool append_category_token(const std::string& token, uint32_t* mask)
 
 } // namespace
 
+// Bounded MPMC queue with a sequence number per slot. Producers never block or
+// allocate: a full ring counts the record as dropped. The writer thread is the
+// usual consumer; FlushFromSignal() may consume concurrently.
+struct Logger::AsyncRing {
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        uint64_t time_ns = 0;
+        uint32_t category = 0;
+        int32_t tid = 0;
+        uint8_t level = 0;
+        uint16_t length = 0;
+        char payload[kAsyncPayloadSize];
+    };
+
+    std::unique_ptr<Slot[]> slots{new Slot[kAsyncRingSlots]};
+    alignas(64) std::atomic<uint64_t> enqueue_pos{0};
+    alignas(64) std::atomic<uint64_t> dequeue_pos{0};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t dropped_total = 0;
+
+    int console_fd = STDOUT_FILENO;
+    int file_fd = -1;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+    // The writer starts on the first queued record, not in Logger(): a thread
+    // started there would run before Instance() has returned.
+    std::once_flag writer_once;
+    // Set when the writer could not start or has been stopped; Log() then
+    // writes the ring out itself.
+    std::atomic<bool> inline_writes{false};
+
+    AsyncRing()
+    {
+        for (size_t i = 0; i < kAsyncRingSlots; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool Pop(Slot* record)
+    {
+        uint64_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[pos & (kAsyncRingSlots - 1)];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    record->time_ns = slot.time_ns;
+                    record->category = slot.category;
+                    record->tid = slot.tid;
+                    record->level = slot.level;
+                    record->length = slot.length;
+                    std::memcpy(record->payload, slot.payload, slot.length);
+                    slot.sequence.store(pos + kAsyncRingSlots, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
 Logger::Logger() {
     InitFromEnv();
+    UpdateEnabledMask();
+}
+
+Logger::~Logger() {
+    StopAsync();
+    if (async_ && async_->file_fd >= 0) {
+        close(async_->file_fd);
+    }
+}
+
+void Logger::StartAsync() {
+    async_ = std::make_unique<AsyncRing>();
+
+    // The writer and the crash-time flush write to raw fds; the file stream
+    // opened by SetOutputFile() is swapped for one here.
+    const char* log_file = std::getenv("MALI_WRAPPER_LOG_FILE");
+    if (log_file != nullptr && log_file[0] != '\0') {
+        file_stream_.reset();
+        async_->file_fd = open(log_file, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+}
+
+void Logger::StartAsyncWriter() {
+    try {
+        async_->writer = std::thread(&Logger::AsyncWriterMain, this);
+    } catch (const std::system_error&) {
+        // Other threads may already be queueing, so the ring stays.
+        async_->inline_writes.store(true, std::memory_order_release);
+    }
+}
+
+void Logger::StopAsync() {
+    if (!async_) {
+        return;
+    }
+    // A writer that has not started yet no longer will; one that is starting
+    // is waited for.
+    std::call_once(async_->writer_once, [] {});
+    if (async_->writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(async_->mutex);
+            async_->stopping = true;
+        }
+        async_->wake.notify_all();
+        async_->writer.join();
+    }
+
+    // Threads still running at exit may log after the writer is gone.
+    async_->inline_writes.store(true, std::memory_order_release);
+    WriteAsyncInline();
+}
+
+bool Logger::PushAsync(LogLevel level, LogCategory category, const std::string& message) {
+    AsyncRing& ring = *async_;
+    uint64_t pos = ring.enqueue_pos.load(std::memory_order_relaxed);
+    AsyncRing::Slot* slot = nullptr;
+    for (;;) {
+        slot = &ring.slots[pos & (kAsyncRingSlots - 1)];
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+        if (diff == 0) {
+            if (ring.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = ring.enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->time_ns = realtime_now_ns();
+    slot->category = category_mask(category);
+    slot->tid = current_thread_id();
+    slot->level = static_cast<uint8_t>(level);
+    slot->length = static_cast<uint16_t>(std::min(message.size(), kAsyncPayloadSize));
+    std::memcpy(slot->payload, message.data(), slot->length);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t Logger::DrainAsync(std::string* console_lines, std::string* file_lines) {
+    AsyncRing& ring = *async_;
+    AsyncRing::Slot record;
+    size_t count = 0;
+    char prefix[64];
+    while (ring.Pop(&record)) {
+        const time_t seconds = static_cast<time_t>(record.time_ns / 1000000000ULL);
+        struct tm local{};
+        localtime_r(&seconds, &local);
+        const size_t prefix_length = strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &local);
+        snprintf(prefix + prefix_length, sizeof(prefix) - prefix_length, ".%03u",
+                 static_cast<unsigned>((record.time_ns / 1000000ULL) % 1000ULL));
+
+        const LogLevel level = static_cast<LogLevel>(record.level);
+        const LogCategory category = static_cast<LogCategory>(record.category);
+        const std::string tid = "[" + std::to_string(record.tid) + "] ";
+        const std::string payload(record.payload, record.length);
+
+        if (console_enabled_) {
+            *console_lines += prefix;
+            if (colors_enabled_) {
+                *console_lines += " [" + GetColorCode(level) + LevelToString(level) + GetResetCode() + "][" +
+                                  GetCategoryColor(category) + CategoryToString(category) + GetResetCode() + "]";
+            } else {
+                *console_lines += std::string(" [") + LevelToString(level) + "][" + CategoryToString(category) + "]";
+            }
+            *console_lines += tid + payload + "\n";
+        }
+        if (ring.file_fd >= 0) {
+            *file_lines += std::string(prefix) + " [" + LevelToString(level) + "][" + CategoryToString(category) +
+                           "]" + tid + payload + "\n";
+        }
+        count++;
+    }
+
+    const uint64_t dropped = ring.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+        ring.dropped_total += dropped;
+        const std::string line = "[WARN][WRAPPER] async log ring full, dropped " + std::to_string(dropped) +
+                                 " message(s), " + std::to_string(ring.dropped_total) + " in total\n";
+        if (console_enabled_) {
+            *console_lines += line;
+        }
+        if (ring.file_fd >= 0) {
+            *file_lines += line;
+        }
+    }
+    return count;
+}
+
+size_t Logger::WriteAsyncBatch(std::string* console_lines, std::string* file_lines) {
+    AsyncRing& ring = *async_;
+    console_lines->clear();
+    file_lines->clear();
+    const size_t count = DrainAsync(console_lines, file_lines);
+    write_fd_all(ring.console_fd, console_lines->data(), console_lines->size());
+    if (ring.file_fd >= 0) {
+        write_fd_all(ring.file_fd, file_lines->data(), file_lines->size());
+    }
+    return count;
+}
+
+void Logger::WriteAsyncInline() {
+    std::lock_guard<std::mutex> lock(async_->mutex);
+    std::string console_lines;
+    std::string file_lines;
+    WriteAsyncBatch(&console_lines, &file_lines);
+}
+
+void Logger::AsyncWriterMain() {
+    // Leave asynchronous signals to the application threads.
+    sigset_t blocked;
+    sigfillset(&blocked);
+    sigdelset(&blocked, SIGSEGV);
+    sigdelset(&blocked, SIGBUS);
+    sigdelset(&blocked, SIGFPE);
+    sigdelset(&blocked, SIGILL);
+    pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+
+    AsyncRing& ring = *async_;
+    std::string console_lines;
+    std::string file_lines;
+    for (;;) {
+        if (WriteAsyncBatch(&console_lines, &file_lines) > 0) {
+            continue;
+        }
+
+        // Producers do not signal; records are picked up in batches every few ms.
+        std::unique_lock<std::mutex> lock(ring.mutex);
+        if (ring.stopping) {
+            break;
+        }
+        ring.wake.wait_for(lock, kAsyncWriterInterval);
+    }
+
+    // Records queued between the last drain and seeing stopping.
+    while (WriteAsyncBatch(&console_lines, &file_lines) > 0) {
+    }
+}
+
+void Logger::FlushFromSignal() {
+    if (!async_) {
+        return;
+    }
+
+    AsyncRing& ring = *async_;
+    AsyncRing::Slot record;
+    char line[kAsyncPayloadSize + 128];
+    while (ring.Pop(&record)) {
+        const int length = snprintf(line, sizeof(line), "%llu.%03u [%s][%u][%d] %.*s\n",
+                                    static_cast<unsigned long long>(record.time_ns / 1000000000ULL),
+                                    static_cast<unsigned>((record.time_ns / 1000000ULL) % 1000ULL),
+                                    LevelToString(static_cast<LogLevel>(record.level)), record.category, record.tid,
+                                    static_cast<int>(record.length), record.payload);
+        if (length <= 0) {
+            continue;
+        }
+        const size_t size = std::min(static_cast<size_t>(length), sizeof(line) - 1);
+        if (console_enabled_) {
+            write_fd_all(ring.console_fd, line, size);
+        }
+        if (ring.file_fd >= 0) {
+            write_fd_all(ring.file_fd, line, size);
+        }
+    }
 }
 
 Logger& Logger::Instance() {
@@ -68,10 +389,22 @@ Logger& Logger::Instance() {
 
 void Logger::SetLevel(LogLevel level) {
     level_ = level;
+    UpdateEnabledMask();
 }
 
 void Logger::SetCategory(LogCategory category) {
     category_ = category;
+    UpdateEnabledMask();
+}
+
+void Logger::UpdateEnabledMask() {
+    uint32_t mask = 0;
+    for (uint32_t level = 0; level <= static_cast<uint32_t>(LogLevel::DEBUG); level++) {
+        if (static_cast<LogLevel>(level) <= level_) {
+            mask |= (category_mask(category_) & 0xfu) << (level * 4);
+        }
+    }
+    log_enabled_mask.store(mask, std::memory_order_relaxed);
 }
 
 void Logger::EnableColors(bool enable) {
@@ -93,6 +426,15 @@ void Logger::Log(LogLevel level, LogCategory category, const std::string& messag
         return;
     }
 
+    if (async_) {
+        std::call_once(async_->writer_once, &Logger::StartAsyncWriter, this);
+        PushAsync(level, category, message);
+        if (async_->inline_writes.load(std::memory_order_acquire)) {
+            WriteAsyncInline();
+        }
+        return;
+    }
+
     auto now = std::chrono::system_clock::now();
     auto time_t = std::chrono::system_clock::to_time_t(now);
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -261,6 +603,11 @@ void Logger::InitFromEnv() {
     if (log_file) {
         SetOutputFile(log_file);
     }
+
+    const char* async = std::getenv("MALI_WRAPPER_LOG_ASYNC");
+    if (async && async[0] != '\0' && std::strcmp(async, "0") != 0) {
+        StartAsync();
+    }
 }
 
 bool Logger::ShouldLog(LogLevel level, LogCategory category) const {
@@ -3,6 +3,7 @@
 #include <string>
 #include <fstream>
 #include <memory>
+#include <atomic>
 #include <cstdarg>
 #include <cstdint>
 
@@ -24,10 +25,27 @@ enum class LogCategory : uint32_t {
     ALL = (1u << 0) | (1u << 1) | (1u << 2)
 };
 
+// Bit (level * 4 + category bit) is set when that level and category are
+// logged. Starts out with every bit set so the first check builds the Logger,
+// which reads the environment and stores the real mask.
+constexpr uint32_t kLogEnabledMaskUnset = 0xffffffffu;
+inline std::atomic<uint32_t> log_enabled_mask{kLogEnabledMaskUnset};
+
 class Logger {
 public:
     static Logger& Instance();
 
+    // What the logging macros check before evaluating their message, so a
+    // disabled message costs one load and one branch.
+    static bool IsEnabled(LogLevel level, LogCategory category)
+    {
+        const uint32_t mask = log_enabled_mask.load(std::memory_order_relaxed);
+        if (__builtin_expect(mask == kLogEnabledMaskUnset, 0)) {
+            return Instance().ShouldLog(level, category);
+        }
+        return ((mask >> (static_cast<uint32_t>(level) * 4)) & static_cast<uint32_t>(category)) != 0;
+    }
+
     void SetLevel(LogLevel level);
     void SetCategory(LogCategory category);
     void SetOutputFile(const std::string& path);
@@ -53,14 +71,21 @@ public:
 
     void WsiLogF(LogLevel level, const char* format, ...);
     void LowAddressLogF(LogLevel level, const char* format, ...);
-    
+
+    // With MALI_WRAPPER_LOG_ASYNC, writes out the queued records from a fatal
+    // signal handler with write(2) only. Does nothing in synchronous mode.
+    void FlushFromSignal();
+
 private:
+    struct AsyncRing;
+
     Logger();
-    ~Logger() = default;
+    ~Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
     void InitFromEnv();
+    void UpdateEnabledMask();
     bool ShouldLog(LogLevel level, LogCategory category) const;
     LogCategory ParseCategory(const char* category_str);
     std::string GetColorCode(LogLevel level) const;
@@ -72,6 +97,17 @@ private:
     std::unique_ptr<std::ofstream> file_stream_;
     bool console_enabled_ = true;
     bool colors_enabled_ = true;
+    // Set with MALI_WRAPPER_LOG_ASYNC; Log() then only queues the record.
+    std::unique_ptr<AsyncRing> async_;
+
+    void StartAsync();
+    void StartAsyncWriter();
+    void StopAsync();
+    bool PushAsync(LogLevel level, LogCategory category, const std::string& message);
+    void AsyncWriterMain();
+    size_t DrainAsync(std::string* console_lines, std::string* file_lines);
+    size_t WriteAsyncBatch(std::string* console_lines, std::string* file_lines);
+    void WriteAsyncInline();
 
     const char* LevelToString(LogLevel level);
     std::string CategoryToString(LogCategory category) const;
@@ -80,20 +116,33 @@ private:
 
 } // namespace mali_wrapper
 
-#define LOG_ERROR(msg) mali_wrapper::Logger::Instance().Error(msg)
-#define LOG_WARN(msg) mali_wrapper::Logger::Instance().Warn(msg)
-#define LOG_INFO(msg) mali_wrapper::Logger::Instance().Info(msg)
-#define LOG_DEBUG(msg) mali_wrapper::Logger::Instance().Debug(msg)
-
-#define WSI_LOG_ERROR(format, ...) mali_wrapper::Logger::Instance().WsiLogF(mali_wrapper::LogLevel::ERROR, format, ##__VA_ARGS__)
-#define WSI_LOG_WARNING(format, ...) mali_wrapper::Logger::Instance().WsiLogF(mali_wrapper::LogLevel::WARN, format, ##__VA_ARGS__)
-#define WSI_LOG_INFO(format, ...) mali_wrapper::Logger::Instance().WsiLogF(mali_wrapper::LogLevel::INFO, format, ##__VA_ARGS__)
-#define WSI_LOG_DEBUG(format, ...) mali_wrapper::Logger::Instance().WsiLogF(mali_wrapper::LogLevel::DEBUG, format, ##__VA_ARGS__)
-
-#define LOW_ADDRESS_LOG_ERROR(msg) mali_wrapper::Logger::Instance().LowAddressError(msg)
-#define LOW_ADDRESS_LOG_WARN(msg) mali_wrapper::Logger::Instance().LowAddressWarn(msg)
-#define LOW_ADDRESS_LOG_INFO(msg) mali_wrapper::Logger::Instance().LowAddressInfo(msg)
-#define LOW_ADDRESS_LOG_DEBUG(msg) mali_wrapper::Logger::Instance().LowAddressDebug(msg)
+// The message, or the format arguments, are only evaluated when the level
+// and category are enabled.
+#define MALI_WRAPPER_LOG_IF(level, category, call) \
+    do { \
+        if (mali_wrapper::Logger::IsEnabled(mali_wrapper::LogLevel::level, mali_wrapper::LogCategory::category)) { \
+            mali_wrapper::Logger::Instance().call; \
+        } \
+    } while (0)
+
+#define LOG_ERROR(msg) MALI_WRAPPER_LOG_IF(ERROR, WRAPPER, Error(msg))
+#define LOG_WARN(msg) MALI_WRAPPER_LOG_IF(WARN, WRAPPER, Warn(msg))
+#define LOG_INFO(msg) MALI_WRAPPER_LOG_IF(INFO, WRAPPER, Info(msg))
+#define LOG_DEBUG(msg) MALI_WRAPPER_LOG_IF(DEBUG, WRAPPER, Debug(msg))
+
+#define WSI_LOG_ERROR(format, ...) \
+    MALI_WRAPPER_LOG_IF(ERROR, WSI_LAYER, WsiLogF(mali_wrapper::LogLevel::ERROR, format, ##__VA_ARGS__))
+#define WSI_LOG_WARNING(format, ...) \
+    MALI_WRAPPER_LOG_IF(WARN, WSI_LAYER, WsiLogF(mali_wrapper::LogLevel::WARN, format, ##__VA_ARGS__))
+#define WSI_LOG_INFO(format, ...) \
+    MALI_WRAPPER_LOG_IF(INFO, WSI_LAYER, WsiLogF(mali_wrapper::LogLevel::INFO, format, ##__VA_ARGS__))
+#define WSI_LOG_DEBUG(format, ...) \
+    MALI_WRAPPER_LOG_IF(DEBUG, WSI_LAYER, WsiLogF(mali_wrapper::LogLevel::DEBUG, format, ##__VA_ARGS__))
+
+#define LOW_ADDRESS_LOG_ERROR(msg) MALI_WRAPPER_LOG_IF(ERROR, LOW_ADDRESS_MAP, LowAddressError(msg))
+#define LOW_ADDRESS_LOG_WARN(msg) MALI_WRAPPER_LOG_IF(WARN, LOW_ADDRESS_MAP, LowAddressWarn(msg))
+#define LOW_ADDRESS_LOG_INFO(msg) MALI_WRAPPER_LOG_IF(INFO, LOW_ADDRESS_MAP, LowAddressInfo(msg))
+#define LOW_ADDRESS_LOG_DEBUG(msg) MALI_WRAPPER_LOG_IF(DEBUG, LOW_ADDRESS_MAP, LowAddressDebug(msg))
 
 #define WSI_LOG(level, format, ...) \
     do { \
@@ -0,0 +1,82 @@
+#include "startup_profile.hpp"
+#include "logging.hpp"
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <time.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+const char* const kStartupPhaseNames[] = {
+    "dlopen",
+    "symbols",
+    "mali_vkCreateInstance",
+    "wsi_instance",
+    "extension_enumeration",
+};
+
+static_assert(sizeof(kStartupPhaseNames) / sizeof(kStartupPhaseNames[0]) ==
+                  static_cast<size_t>(StartupPhase::COUNT),
+              "every startup phase needs a name");
+
+struct PhaseTotals {
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint32_t> calls{0};
+};
+
+PhaseTotals phase_totals[static_cast<size_t>(StartupPhase::COUNT)];
+std::atomic<bool> summary_logged{false};
+// Set when the profile is first used, which is the first InitializeWrapper().
+uint64_t profile_start_ns = 0;
+
+} // namespace
+
+StartupProfile& StartupProfile::Instance() {
+    static StartupProfile instance;
+    return instance;
+}
+
+StartupProfile::StartupProfile() {
+    profile_start_ns = NowNs();
+}
+
+uint64_t StartupProfile::NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void StartupProfile::Record(StartupPhase phase, uint64_t duration_ns) {
+    auto& totals = phase_totals[static_cast<size_t>(phase)];
+    totals.total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    totals.calls.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StartupProfile::LogSummary() {
+    if (summary_logged.exchange(true)) {
+        return;
+    }
+
+    // Phases overlap (WSI association resolves symbols too), so they do not
+    // add up to the total, which is wall time from wrapper init to now.
+    std::string summary = "Startup profile:";
+    char buffer[96];
+    for (size_t i = 0; i < static_cast<size_t>(StartupPhase::COUNT); ++i) {
+        const uint64_t total_ns = phase_totals[i].total_ns.load(std::memory_order_relaxed);
+        const uint32_t calls = phase_totals[i].calls.load(std::memory_order_relaxed);
+        snprintf(buffer, sizeof(buffer), " %s=%.2fms", kStartupPhaseNames[i], total_ns / 1e6);
+        summary += buffer;
+        if (calls > 1) {
+            snprintf(buffer, sizeof(buffer), "(x%" PRIu32 ")", calls);
+            summary += buffer;
+        }
+    }
+    snprintf(buffer, sizeof(buffer), " first_instance=%.2fms", (NowNs() - profile_start_ns) / 1e6);
+    summary += buffer;
+    LOG_INFO(summary);
+}
+
+} // namespace mali_wrapper
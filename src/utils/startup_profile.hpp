@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mali_wrapper {
+
+// Phases of getting from the first vk_icdGetInstanceProcAddr to a usable
+// instance. Names used in the summary live in startup_profile.cpp.
+enum class StartupPhase : uint8_t {
+    DLOPEN = 0,
+    SYMBOL_RESOLUTION,
+    MALI_CREATE_INSTANCE,
+    WSI_INSTANCE_ASSOCIATION,
+    EXTENSION_ENUMERATION,
+    COUNT
+};
+
+// Accumulates the time spent in each startup phase and logs one summary at
+// INFO once the first instance exists. Recording costs two clock reads, so it
+// is always on.
+class StartupProfile {
+public:
+    static StartupProfile& Instance();
+
+    static uint64_t NowNs();
+    void Record(StartupPhase phase, uint64_t duration_ns);
+
+    // Logs the summary the first time it is called; later calls do nothing.
+    void LogSummary();
+
+private:
+    StartupProfile();
+    ~StartupProfile() = default;
+    StartupProfile(const StartupProfile&) = delete;
+    StartupProfile& operator=(const StartupProfile&) = delete;
+};
+
+// Records the scope's lifetime against a startup phase.
+class StartupPhaseScope {
+public:
+    explicit StartupPhaseScope(StartupPhase phase)
+        : phase_(phase), start_ns_(StartupProfile::NowNs())
+    {
+    }
+
+    ~StartupPhaseScope()
+    {
+        StartupProfile::Instance().Record(phase_, StartupProfile::NowNs() - start_ns_);
+    }
+
+    StartupPhaseScope(const StartupPhaseScope&) = delete;
+    StartupPhaseScope& operator=(const StartupPhaseScope&) = delete;
+
+private:
+    StartupPhase phase_;
+    uint64_t start_ns_;
+};
+
+} // namespace mali_wrapper
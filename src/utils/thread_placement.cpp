@@ -0,0 +1,238 @@
+#include "thread_placement.hpp"
+#include "logging.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+enum class AffinityMode {
+    AUTO,
+    BIG,
+    OFF,
+};
+
+struct PresentPriority {
+    bool fifo = false;
+    int fifo_priority = 1;
+    bool nice = false;
+    int nice_value = 0;
+};
+
+struct ThreadPlacement {
+    AffinityMode mode = AffinityMode::AUTO;
+    PresentPriority present;
+    // Big cores among those the process may run on. Empty when every CPU has
+    // the same capacity or capacities are not exposed.
+    cpu_set_t big_cores;
+    std::vector<int> big_core_list;
+    int usable_cpus = 0;
+};
+
+std::atomic<bool> priority_warning_logged{false};
+
+AffinityMode read_affinity_mode() {
+    const char* value = std::getenv("MALI_WRAPPER_THREAD_AFFINITY");
+    if (value == nullptr || value[0] == '\0' || std::strcmp(value, "auto") == 0) {
+        return AffinityMode::AUTO;
+    }
+    if (std::strcmp(value, "big") == 0) {
+        return AffinityMode::BIG;
+    }
+    if (std::strcmp(value, "off") == 0 || std::strcmp(value, "0") == 0) {
+        return AffinityMode::OFF;
+    }
+    LOG_WARN("Unknown MALI_WRAPPER_THREAD_AFFINITY value '" + std::string(value) + "', using auto");
+    return AffinityMode::AUTO;
+}
+
+PresentPriority read_present_priority() {
+    PresentPriority priority;
+    const char* value = std::getenv("MALI_WRAPPER_PRESENT_THREAD_PRIORITY");
+    if (value == nullptr || value[0] == '\0') {
+        return priority;
+    }
+
+    if (std::strncmp(value, "fifo", 4) == 0) {
+        priority.fifo = true;
+        if (value[4] == ':') {
+            const long parsed = std::strtol(value + 5, nullptr, 10);
+            priority.fifo_priority = static_cast<int>(std::max(1L, std::min(99L, parsed)));
+        }
+        return priority;
+    }
+
+    char* end = nullptr;
+    const long parsed = std::strtol(value, &end, 10);
+    if (end == value) {
+        LOG_WARN("Unknown MALI_WRAPPER_PRESENT_THREAD_PRIORITY value '" + std::string(value) + "'");
+        return priority;
+    }
+    priority.nice = true;
+    priority.nice_value = static_cast<int>(std::max(-20L, std::min(19L, parsed)));
+    return priority;
+}
+
+// Reads /sys/devices/system/cpu/cpuN/cpu_capacity, or -1 when it is missing.
+long read_cpu_capacity(int cpu) {
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+    FILE* file = std::fopen(path, "r");
+    if (file == nullptr) {
+        return -1;
+    }
+    long capacity = -1;
+    if (std::fscanf(file, "%ld", &capacity) != 1) {
+        capacity = -1;
+    }
+    std::fclose(file);
+    return capacity;
+}
+
+void detect_big_cores(ThreadPlacement& placement) {
+    CPU_ZERO(&placement.big_cores);
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return;
+    }
+
+    const long configured = sysconf(_SC_NPROCESSORS_CONF);
+    const int cpu_count = static_cast<int>(std::min<long>(configured > 0 ? configured : 0, CPU_SETSIZE));
+
+    std::vector<long> capacities(cpu_count, -1);
+    long max_capacity = -1;
+    long min_capacity = -1;
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        ++placement.usable_cpus;
+        capacities[cpu] = read_cpu_capacity(cpu);
+        if (capacities[cpu] < 0) {
+            continue;
+        }
+        max_capacity = std::max(max_capacity, capacities[cpu]);
+        min_capacity = min_capacity < 0 ? capacities[cpu] : std::min(min_capacity, capacities[cpu]);
+    }
+
+    // Homogeneous, or the kernel does not expose capacities: nothing to prefer.
+    if (max_capacity <= 0 || min_capacity == max_capacity) {
+        return;
+    }
+
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        if (capacities[cpu] == max_capacity) {
+            CPU_SET(cpu, &placement.big_cores);
+            placement.big_core_list.push_back(cpu);
+        }
+    }
+}
+
+std::string describe_cores(const std::vector<int>& cores) {
+    std::string result;
+    for (size_t i = 0; i < cores.size(); ++i) {
+        if (i != 0) {
+            result += ",";
+        }
+        result += std::to_string(cores[i]);
+    }
+    return result;
+}
+
+const char* describe_mode(AffinityMode mode) {
+    switch (mode) {
+    case AffinityMode::BIG:
+        return "workers and present threads on big cores";
+    case AffinityMode::OFF:
+        return "affinity off";
+    case AffinityMode::AUTO:
+    default:
+        return "workers on big cores";
+    }
+}
+
+const ThreadPlacement& get_thread_placement() {
+    static const ThreadPlacement placement = []() {
+        ThreadPlacement result;
+        result.mode = read_affinity_mode();
+        result.present = read_present_priority();
+        detect_big_cores(result);
+
+        std::string message = "Thread placement: ";
+        if (result.big_core_list.empty()) {
+            message += "no big.LITTLE split across " + std::to_string(result.usable_cpus) + " CPU(s)";
+        } else {
+            message += std::string(describe_mode(result.mode)) + ", big cores " +
+                       describe_cores(result.big_core_list) + " of " + std::to_string(result.usable_cpus);
+        }
+        if (result.present.fifo) {
+            message += ", present threads SCHED_FIFO " + std::to_string(result.present.fifo_priority);
+        } else if (result.present.nice) {
+            message += ", present threads nice " + std::to_string(result.present.nice_value);
+        }
+        LOG_INFO(message);
+        return result;
+    }();
+    return placement;
+}
+
+void warn_priority_failure(const char* what, const char* name, int error) {
+    if (priority_warning_logged.exchange(true)) {
+        return;
+    }
+    LOG_WARN(std::string("Could not set ") + what + " for " + name + " thread: " + std::strerror(error) +
+             " (needs CAP_SYS_NICE or a matching RLIMIT_RTPRIO/RLIMIT_NICE)");
+}
+
+void apply_present_priority(const PresentPriority& priority, const char* name) {
+    if (priority.fifo) {
+        sched_param param{};
+        param.sched_priority = priority.fifo_priority;
+        const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0) {
+            warn_priority_failure("SCHED_FIFO", name, error);
+        }
+    } else if (priority.nice) {
+        // Linux applies a thread ID passed to setpriority() to that thread only.
+        const id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, tid, priority.nice_value) != 0) {
+            warn_priority_failure("nice value", name, errno);
+        }
+    }
+}
+
+} // namespace
+
+void ApplyThreadPlacement(ThreadRole role, const char* name) {
+    const ThreadPlacement& placement = get_thread_placement();
+
+    const bool pin = !placement.big_core_list.empty() &&
+                     (placement.mode == AffinityMode::BIG ||
+                      (placement.mode == AffinityMode::AUTO && role == ThreadRole::WORKER));
+    if (pin) {
+        const int error = pthread_setaffinity_np(pthread_self(), sizeof(placement.big_cores), &placement.big_cores);
+        if (error != 0) {
+            LOG_DEBUG(std::string("Could not pin ") + name + " thread to big cores: " + std::strerror(error));
+        }
+    }
+
+    if (role == ThreadRole::PRESENT) {
+        apply_present_priority(placement.present, name);
+    }
+}
+
+} // namespace mali_wrapper
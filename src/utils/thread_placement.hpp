@@ -0,0 +1,27 @@
+#pragma once
+
+namespace mali_wrapper {
+
+// What a wrapper-owned thread spends its time on, which decides where it runs.
+enum class ThreadRole {
+    // Copy and compile workers: bandwidth and ALU bound, so they belong on the
+    // big cores of a big.LITTLE SoC (the A76 cluster on RK3588).
+    WORKER,
+    // Page flip and present event threads: mostly asleep, but latency bound.
+    PRESENT,
+};
+
+// Applies the placement policy to the calling thread. Called once at the top
+// of every wrapper-owned thread; name only appears in the log.
+//
+// MALI_WRAPPER_THREAD_AFFINITY selects the cores:
+//   auto (default)  pin WORKER threads to the big cores when the CPUs report
+//                   different cpu_capacity values, leave PRESENT threads alone
+//   big             pin both roles to the big cores
+//   off             never change affinity
+// MALI_WRAPPER_PRESENT_THREAD_PRIORITY boosts PRESENT threads: "fifo" or
+// "fifo:<1-99>" for SCHED_FIFO, or a nice value such as "-5". Unset keeps the
+// inherited priority.
+void ApplyThreadPlacement(ThreadRole role, const char* name);
+
+} // namespace mali_wrapper
@@ -0,0 +1,203 @@
+#include "trace.hpp"
+#include "logging.hpp"
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace mali_wrapper {
+
+namespace {
+
+constexpr size_t kTraceRingSize = 16384; // events per thread, power of two
+constexpr size_t kMaxTraceRings = 256;
+
+struct TraceRecord {
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint64_t arg0;
+    uint64_t arg1;
+    TraceEvent event;
+};
+
+// Written only by its owning thread; head is published with release so the
+// dumper sees complete records up to it.
+struct TraceRing {
+    uint32_t tid = 0;
+    std::atomic<uint64_t> head{0};
+    TraceRecord records[kTraceRingSize];
+};
+
+// A null argument name leaves that argument out of the dump.
+struct TraceEventInfo {
+    const char* name;
+    const char* arg0;
+    const char* arg1;
+};
+
+const TraceEventInfo kTraceEventInfo[] = {
+    { "vkMapMemory", "size", "offset" },
+    { "alias_create", "size", "ok" },
+    { "shadow_create", "size", "method" },
+    { "copy", "bytes", "kind" },
+    { "submit_sync", "regions", "copied" },
+    { "queue_present", "image", nullptr },
+    { "page_flip", "image", nullptr },
+    { "shm_present", "bytes", nullptr },
+    { "shm_put", "rects", nullptr },
+    { "bridge_feedback_wait", "frame", "ok" },
+    { "present_fence_wait", "image", nullptr },
+};
+static_assert(sizeof(kTraceEventInfo) / sizeof(kTraceEventInfo[0]) == static_cast<size_t>(TraceEvent::COUNT),
+              "every trace event needs a name");
+
+std::mutex trace_rings_mutex;
+std::vector<std::unique_ptr<TraceRing>> trace_rings;
+std::atomic<bool> trace_dump_requested{false};
+std::string trace_output_path;
+thread_local TraceRing* thread_trace_ring = nullptr;
+
+bool read_trace_env() {
+    const char* value = std::getenv("MALI_WRAPPER_TRACE");
+    if (value == nullptr || value[0] == '\0' || std::strcmp(value, "0") == 0) {
+        return false;
+    }
+
+    if (std::strcmp(value, "1") == 0) {
+        char path[64];
+        std::snprintf(path, sizeof(path), "/tmp/mali-wrapper-trace-%d.json", static_cast<int>(getpid()));
+        trace_output_path = path;
+    } else {
+        trace_output_path = value;
+    }
+    return true;
+}
+
+void trace_dump_signal_handler(int) {
+    // Only flag the request; the next recorded event performs the dump.
+    trace_dump_requested.store(true, std::memory_order_relaxed);
+}
+
+TraceRing* acquire_thread_ring() {
+    if (thread_trace_ring != nullptr) {
+        return thread_trace_ring;
+    }
+
+    std::lock_guard<std::mutex> lock(trace_rings_mutex);
+    if (trace_rings.size() >= kMaxTraceRings) {
+        return nullptr;
+    }
+
+    auto ring = std::make_unique<TraceRing>();
+    ring->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    thread_trace_ring = ring.get();
+    trace_rings.push_back(std::move(ring));
+    return thread_trace_ring;
+}
+
+} // namespace
+
+namespace trace_detail {
+bool enabled = read_trace_env();
+}
+
+Tracer& Tracer::Instance() {
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer() {
+    if (!trace_detail::enabled) {
+        return;
+    }
+
+    // Leave SIGUSR2 alone if the application already uses it.
+    struct sigaction current{};
+    if (sigaction(SIGUSR2, nullptr, &current) == 0 && current.sa_handler == SIG_DFL) {
+        struct sigaction sa{};
+        sa.sa_handler = trace_dump_signal_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGUSR2, &sa, nullptr);
+    }
+}
+
+uint64_t Tracer::NowNs() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    // Never 0, which TraceScope uses for "not recording".
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec) + 1;
+}
+
+void Tracer::Record(TraceEvent event, uint64_t start_ns, uint64_t duration_ns, uint64_t arg0, uint64_t arg1) {
+    TraceRing* ring = acquire_thread_ring();
+    if (ring != nullptr) {
+        const uint64_t head = ring->head.load(std::memory_order_relaxed);
+        ring->records[head & (kTraceRingSize - 1)] = TraceRecord{ start_ns, duration_ns, arg0, arg1, event };
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    if (trace_dump_requested.load(std::memory_order_relaxed) &&
+        trace_dump_requested.exchange(false, std::memory_order_relaxed)) {
+        Dump("signal");
+    }
+}
+
+void Tracer::Dump(const char* reason) {
+    if (!trace_detail::enabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(trace_rings_mutex);
+    FILE* out = std::fopen(trace_output_path.c_str(), "w");
+    if (out == nullptr) {
+        LOG_WARN("Failed to write trace to " + trace_output_path);
+        return;
+    }
+
+    const int pid = static_cast<int>(getpid());
+    size_t written = 0;
+    std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const auto& ring : trace_rings) {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t count = head < kTraceRingSize ? head : kTraceRingSize;
+        for (uint64_t i = head - count; i < head; ++i) {
+            const TraceRecord& record = ring->records[i & (kTraceRingSize - 1)];
+            const size_t index = static_cast<size_t>(record.event);
+            if (index >= static_cast<size_t>(TraceEvent::COUNT)) {
+                continue;
+            }
+
+            const TraceEventInfo& info = kTraceEventInfo[index];
+            std::fprintf(out,
+                         "%s{\"name\":\"%s\",\"cat\":\"mali_wrapper\",\"ph\":\"X\",\"pid\":%d,\"tid\":%" PRIu32
+                         ",\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64
+                         ",\"args\":{\"%s\":%" PRIu64,
+                         written == 0 ? "" : ",\n", info.name, pid, ring->tid,
+                         record.start_ns / 1000, record.start_ns % 1000,
+                         record.duration_ns / 1000, record.duration_ns % 1000,
+                         info.arg0, record.arg0);
+            if (info.arg1 != nullptr) {
+                std::fprintf(out, ",\"%s\":%" PRIu64, info.arg1, record.arg1);
+            }
+            std::fprintf(out, "}}");
+            written++;
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+
+    LOG_INFO("Wrote " + std::to_string(written) + " trace events to " + trace_output_path + " (" +
+             std::string(reason != nullptr ? reason : "dump") + ")");
+}
+
+} // namespace mali_wrapper
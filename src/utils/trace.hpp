@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+
+namespace mali_wrapper {
+
+// Binary hot-path events. Names used in the dump live in trace.cpp.
+enum class TraceEvent : uint16_t {
+    MAP_MEMORY = 0,
+    ALIAS_CREATE,
+    SHADOW_CREATE,
+    COPY,
+    SUBMIT_SYNC,
+    QUEUE_PRESENT,
+    PAGE_FLIP,
+    SHM_PRESENT,
+    SHM_PUT,
+    BRIDGE_FEEDBACK_WAIT,
+    PRESENT_FENCE_WAIT,
+    COUNT
+};
+
+// MALI_WRAPPER_TRACE=1 (or =<path>) records events into per-thread lock-free
+// rings and writes them as Chrome trace JSON, loadable in Perfetto, when the
+// wrapper unloads or after SIGUSR2. Default output is
+// /tmp/mali-wrapper-trace-<pid>.json.
+namespace trace_detail {
+extern bool enabled;
+}
+
+inline bool IsTraceEnabled()
+{
+    return trace_detail::enabled;
+}
+
+class Tracer {
+public:
+    static Tracer& Instance();
+
+    static uint64_t NowNs();
+    void Record(TraceEvent event, uint64_t start_ns, uint64_t duration_ns, uint64_t arg0, uint64_t arg1);
+
+    // Writes every ring to the output file. Safe to call while other threads
+    // keep recording; their newest events may be missing from the dump.
+    void Dump(const char* reason);
+
+private:
+    Tracer();
+    ~Tracer() = default;
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+};
+
+// Records one complete event covering the scope's lifetime. Costs a single
+// predictable branch when tracing is off.
+class TraceScope {
+public:
+    TraceScope(TraceEvent event, uint64_t arg0 = 0, uint64_t arg1 = 0)
+    {
+        if (IsTraceEnabled()) {
+            event_ = event;
+            arg0_ = arg0;
+            arg1_ = arg1;
+            start_ns_ = Tracer::NowNs();
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (start_ns_ != 0) {
+            Tracer::Instance().Record(event_, start_ns_, Tracer::NowNs() - start_ns_, arg0_, arg1_);
+        }
+    }
+
+    // For arguments only known once the traced work finished.
+    void SetArgs(uint64_t arg0, uint64_t arg1)
+    {
+        arg0_ = arg0;
+        arg1_ = arg1;
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    TraceEvent event_ = TraceEvent::COUNT;
+    uint64_t arg0_ = 0;
+    uint64_t arg1_ = 0;
+    uint64_t start_ns_ = 0;
+};
+
+} // namespace mali_wrapper
+
+#define MALI_TRACE_CONCAT_INNER(a, b) a##b
+#define MALI_TRACE_CONCAT(a, b) MALI_TRACE_CONCAT_INNER(a, b)
+#define MALI_TRACE_SCOPE(event, ...) \
+    mali_wrapper::TraceScope MALI_TRACE_CONCAT(mali_trace_scope_, __LINE__)(mali_wrapper::TraceEvent::event, ##__VA_ARGS__)
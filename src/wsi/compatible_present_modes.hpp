@@ -135,7 +135,8 @@ public:
          std::find_if(present_mode_comp.compatible_present_modes.begin(),
                       present_mode_comp.compatible_present_modes.begin() + present_mode_comp.present_mode_count,
                       [present_mode_b](VkPresentModeKHR p) { return p == present_mode_b; });
-      return present_mode_it != present_mode_comp.compatible_present_modes.end();
+      return present_mode_it !=
+             present_mode_comp.compatible_present_modes.begin() + present_mode_comp.present_mode_count;
    }
 
 private:
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file commit_scheduler.cpp
+ *
+ * @brief Shares the CRTC of a display between the swapchains presenting to its planes.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+
+#include <xf86drm.h>
+
+#include "commit_scheduler.hpp"
+#include "swapchain.hpp"
+#include "utils/logging.hpp"
+#include "../layer_utils/macros.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+namespace
+{
+/* How long a flip may take before the display is considered lost. */
+constexpr int page_flip_timeout_ms = 1000;
+
+VWL_CAPI_CALL(void)
+page_flip_handler(int fd, unsigned int sequence, unsigned int tv_sec, unsigned int tv_usec,
+                  void *user_data) VWL_API_POST
+{
+   UNUSED(fd);
+   UNUSED(sequence);
+   UNUSED(tv_sec);
+   UNUSED(tv_usec);
+   reinterpret_cast<commit_scheduler *>(user_data)->on_page_flip();
+}
+} // namespace
+
+commit_scheduler::commit_scheduler(drm_display &display)
+   : m_display(display)
+   , m_planes(util::allocator::get_generic())
+   , m_use_atomic(false)
+   , m_connector_crtc_id(0)
+   , m_crtc_mode_id(0)
+   , m_crtc_active(0)
+   , m_crtc_out_fence_ptr(0)
+   , m_mode(nullptr)
+   , m_mode_blob_id(0)
+   , m_mode_set(false)
+   , m_flip_in_flight(false)
+   , m_flip_done(false)
+   , m_polling(false)
+   , m_flip_sequence(0)
+{
+}
+
+commit_scheduler::~commit_scheduler()
+{
+   if (m_mode_blob_id != 0)
+   {
+      drmModeDestroyPropertyBlob(m_display.get_drm_fd(), m_mode_blob_id);
+   }
+}
+
+commit_scheduler &commit_scheduler::get(drm_display &display)
+{
+   /* There is only the one display of drm_display::get_display. */
+   static commit_scheduler scheduler{ display };
+   assert(&scheduler.m_display == &display);
+   return scheduler;
+}
+
+bool commit_scheduler::init_atomic_properties()
+{
+   if (!m_display.supports_atomic_modeset())
+   {
+      return false;
+   }
+
+   const uint32_t crtc_id = static_cast<uint32_t>(m_display.get_crtc_id());
+   m_connector_crtc_id = m_display.get_property_id(m_display.get_connector_id(), DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID");
+   m_crtc_mode_id = m_display.get_property_id(crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID");
+   m_crtc_active = m_display.get_property_id(crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE");
+   m_crtc_out_fence_ptr = m_display.get_property_id(crtc_id, DRM_MODE_OBJECT_CRTC, "OUT_FENCE_PTR");
+   if (m_connector_crtc_id == 0 || m_crtc_mode_id == 0 || m_crtc_active == 0 || !find_plane_properties(0))
+   {
+      WSI_LOG_WARNING("The display lacks atomic modeset properties, using the legacy modeset API.");
+      return false;
+   }
+   return true;
+}
+
+bool commit_scheduler::find_plane_properties(uint32_t plane_index)
+{
+   const drm_plane_info &info = m_display.get_plane(plane_index);
+   const uint32_t plane_id = info.plane_id;
+
+   auto &ids = m_planes[plane_index].ids;
+   ids.fb_id = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID");
+   ids.crtc_id = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID");
+   ids.src_x = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X");
+   ids.src_y = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y");
+   ids.src_w = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W");
+   ids.src_h = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H");
+   ids.crtc_x = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X");
+   ids.crtc_y = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y");
+   ids.crtc_w = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W");
+   ids.crtc_h = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H");
+   ids.in_fence_fd = m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "IN_FENCE_FD");
+   ids.zpos = info.zpos_mutable ? m_display.get_property_id(plane_id, DRM_MODE_OBJECT_PLANE, "zpos") : 0;
+   m_planes[plane_index].has_ids = true;
+
+   const uint32_t required[] = { ids.fb_id,  ids.crtc_id, ids.src_x,  ids.src_y,  ids.src_w,
+                                 ids.src_h,  ids.crtc_x,  ids.crtc_y, ids.crtc_w, ids.crtc_h };
+   return std::find(std::begin(required), std::end(required), 0u) == std::end(required);
+}
+
+VkResult commit_scheduler::attach(swapchain &owner, uint32_t plane_index, uint32_t stack_index,
+                                  const drm_display_mode &mode)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (m_planes.empty())
+   {
+      if (!m_planes.try_resize(m_display.get_num_planes()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      m_use_atomic = init_atomic_properties();
+   }
+
+   assert(plane_index < m_planes.size());
+   auto &plane = m_planes[plane_index];
+   if (plane_index != 0 && (!m_use_atomic || (!plane.has_ids && !find_plane_properties(plane_index))))
+   {
+      WSI_LOG_ERROR("Overlay planes need atomic modeset properties the display lacks.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   if (m_mode != &mode)
+   {
+      for (uint32_t i = 0; i < m_planes.size(); i++)
+      {
+         if (i != plane_index && m_planes[i].owner != nullptr)
+         {
+            WSI_LOG_ERROR("The swapchains of a display must all present on the same mode.");
+            return VK_ERROR_INITIALIZATION_FAILED;
+         }
+      }
+
+      if (m_use_atomic)
+      {
+         const drmModeModeInfo drm_mode = mode.get_drm_mode();
+         uint32_t blob_id = 0;
+         if (drmModeCreatePropertyBlob(m_display.get_drm_fd(), &drm_mode, sizeof(drm_mode), &blob_id) != 0)
+         {
+            WSI_LOG_ERROR("Failed to create the mode blob.");
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+         if (m_mode_blob_id != 0)
+         {
+            drmModeDestroyPropertyBlob(m_display.get_drm_fd(), m_mode_blob_id);
+         }
+         m_mode_blob_id = blob_id;
+      }
+      m_mode = &mode;
+      m_mode_set = false;
+   }
+
+   /* The stack index is clamped to the zpos range, which for most drivers spans all planes of the CRTC. */
+   const drm_plane_info &info = m_display.get_plane(plane_index);
+   plane.owner = &owner;
+   plane.zpos = std::min(std::max<uint64_t>(stack_index, info.zpos_min), info.zpos_max);
+   plane.zpos_dirty = m_use_atomic && plane.ids.zpos != 0;
+   return VK_SUCCESS;
+}
+
+void commit_scheduler::detach(swapchain &owner)
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+
+   /* Wait for the flips of this swapchain and of the one replacing it, so removing its framebuffers does not turn
+    * its planes off. */
+   auto involved_in_flight = [this, &owner]() {
+      return std::any_of(m_planes.begin(), m_planes.end(), [&owner](const plane_state &plane) {
+         return plane.has_committed && (plane.displayed.owner == &owner || plane.committed.owner == &owner);
+      });
+   };
+   while (m_flip_in_flight && involved_in_flight())
+   {
+      if (wait_for_flip(lock, page_flip_timeout_ms) != VK_SUCCESS)
+      {
+         break;
+      }
+   }
+
+   for (auto &plane : m_planes)
+   {
+      if (plane.owner == &owner)
+      {
+         plane.owner = nullptr;
+      }
+      if (plane.committed.owner == &owner)
+      {
+         plane.committed.owner = nullptr;
+      }
+      if (plane.displayed.owner == &owner)
+      {
+         plane.displayed.owner = nullptr;
+      }
+   }
+}
+
+VkResult commit_scheduler::wait_for_release(swapchain &owner, int timeout_ms)
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   auto releases_owner = [this, &owner]() {
+      return std::any_of(m_planes.begin(), m_planes.end(), [&owner](const plane_state &plane) {
+         return plane.has_committed && plane.displayed.owner == &owner;
+      });
+   };
+
+   VkResult result = VK_SUCCESS;
+   while (result == VK_SUCCESS && m_flip_in_flight && releases_owner())
+   {
+      result = wait_for_flip(lock, timeout_ms);
+   }
+   return result;
+}
+
+bool commit_scheduler::waits_for_in_fence(uint32_t plane_index)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_use_atomic && m_planes[plane_index].ids.in_fence_fd != 0;
+}
+
+void commit_scheduler::on_page_flip()
+{
+   m_flip_done = true;
+}
+
+int commit_scheduler::commit_atomic(util::fd_owner &out_fence)
+{
+   drm_atomic_req_owner req{ drmModeAtomicAlloc() };
+   if (req == nullptr)
+   {
+      return -ENOMEM;
+   }
+
+   const uint32_t crtc_id = static_cast<uint32_t>(m_display.get_crtc_id());
+
+   /* With an out fence nothing reads the DRM events, so none are requested. */
+   uint32_t flags = m_crtc_out_fence_ptr != 0 ? 0 : DRM_MODE_PAGE_FLIP_EVENT;
+   if (!m_mode_set)
+   {
+      drmModeAtomicAddProperty(req.get(), m_display.get_connector_id(), m_connector_crtc_id, crtc_id);
+      drmModeAtomicAddProperty(req.get(), crtc_id, m_crtc_mode_id, m_mode_blob_id);
+      drmModeAtomicAddProperty(req.get(), crtc_id, m_crtc_active, 1);
+      flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+   }
+   else
+   {
+      flags |= DRM_MODE_ATOMIC_NONBLOCK;
+   }
+
+   for (uint32_t i = 0; i < m_planes.size(); i++)
+   {
+      const plane_state &plane = m_planes[i];
+      if (!plane.has_queued)
+      {
+         continue;
+      }
+
+      /* Source coordinates are 16.16 fixed point. */
+      const uint32_t plane_id = m_display.get_plane(i).plane_id;
+      const auto &ids = plane.ids;
+      const VkExtent2D extent = plane.queued.extent;
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.fb_id, plane.queued.fb_id);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.crtc_id, crtc_id);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.src_x, 0);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.src_y, 0);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.src_w, static_cast<uint64_t>(extent.width) << 16);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.src_h, static_cast<uint64_t>(extent.height) << 16);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.crtc_x, 0);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.crtc_y, 0);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.crtc_w, extent.width);
+      drmModeAtomicAddProperty(req.get(), plane_id, ids.crtc_h, extent.height);
+      /* The fd only needs to stay open until the commit has taken its own reference. */
+      if (ids.in_fence_fd != 0 && plane.queued.in_fence.is_valid())
+      {
+         drmModeAtomicAddProperty(req.get(), plane_id, ids.in_fence_fd,
+                                  static_cast<uint64_t>(plane.queued.in_fence.get()));
+      }
+      if (plane.zpos_dirty)
+      {
+         drmModeAtomicAddProperty(req.get(), plane_id, ids.zpos, plane.zpos);
+      }
+   }
+
+   /* The kernel writes an fd that signals once this commit is on screen, and so the images it replaced are not read. */
+   int32_t out_fence_fd = -1;
+   if (m_crtc_out_fence_ptr != 0)
+   {
+      drmModeAtomicAddProperty(req.get(), crtc_id, m_crtc_out_fence_ptr,
+                               static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&out_fence_fd)));
+   }
+
+   int res = drmModeAtomicCommit(m_display.get_drm_fd(), req.get(), flags, this);
+   if (res == 0)
+   {
+      out_fence = util::fd_owner(out_fence_fd);
+   }
+   return res;
+}
+
+int commit_scheduler::commit_legacy(plane_state &plane)
+{
+   const int drm_fd = m_display.get_drm_fd();
+   const uint32_t crtc_id = static_cast<uint32_t>(m_display.get_crtc_id());
+   if (!m_mode_set)
+   {
+      uint32_t connector_id = m_display.get_connector_id();
+      drmModeModeInfo mode = m_mode->get_drm_mode();
+      return drmModeSetCrtc(drm_fd, crtc_id, plane.queued.fb_id, 0, 0, &connector_id, 1, &mode);
+   }
+
+   return drmModePageFlip(drm_fd, crtc_id, plane.queued.fb_id, DRM_MODE_PAGE_FLIP_EVENT, this);
+}
+
+void commit_scheduler::commit_queued()
+{
+   assert(!m_flip_in_flight);
+   if (std::none_of(m_planes.begin(), m_planes.end(), [](const plane_state &plane) { return plane.has_queued; }))
+   {
+      return;
+   }
+
+   const bool modeset = !m_mode_set;
+   util::fd_owner out_fence;
+   m_flip_done = false;
+   int res = m_use_atomic ? commit_atomic(out_fence) : commit_legacy(m_planes[0]);
+   if (res != 0)
+   {
+      WSI_LOG_ERROR("Failed to present to the display: %s", strerror(-res));
+   }
+
+   for (auto &plane : m_planes)
+   {
+      if (!plane.has_queued)
+      {
+         continue;
+      }
+
+      plane.has_queued = false;
+      plane.queued.in_fence = util::fd_owner{};
+      *plane.queued_result = res != 0 ? VK_ERROR_SURFACE_LOST_KHR : VK_SUCCESS;
+      if (res != 0)
+      {
+         continue;
+      }
+      plane.has_committed = true;
+      plane.committed = { plane.queued_owner, plane.queued.image_index };
+      plane.zpos_dirty = false;
+   }
+
+   if (res != 0)
+   {
+      return;
+   }
+
+   m_mode_set = true;
+   m_flip_in_flight = true;
+   m_out_fence = std::move(out_fence);
+   if (!m_use_atomic && modeset)
+   {
+      /* The legacy modeset is synchronous and sends no event. */
+      complete_flip();
+   }
+}
+
+void commit_scheduler::complete_flip()
+{
+   for (auto &plane : m_planes)
+   {
+      if (!plane.has_committed)
+      {
+         continue;
+      }
+
+      /* The image that was scanned out until this flip can be reused now. */
+      if (plane.displayed.owner != nullptr)
+      {
+         plane.displayed.owner->release_image(plane.displayed.image_index);
+      }
+      plane.displayed = plane.committed;
+      plane.has_committed = false;
+   }
+
+   m_flip_in_flight = false;
+   m_out_fence = util::fd_owner{};
+   m_flip_sequence++;
+}
+
+VkResult commit_scheduler::wait_for_flip(std::unique_lock<std::mutex> &lock, int timeout_ms)
+{
+   assert(m_flip_in_flight);
+   if (m_polling)
+   {
+      /* The thread polling completes the flip and commits what was queued meanwhile. */
+      const uint64_t flip_sequence = m_flip_sequence;
+      const bool woken = m_flip_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, flip_sequence]() {
+         return m_flip_sequence != flip_sequence || !m_polling;
+      });
+      return woken ? VK_SUCCESS : VK_TIMEOUT;
+   }
+
+   /* Only the thread that completes the flip replaces or closes the fd. */
+   m_polling = true;
+   struct pollfd pfd = { m_out_fence.is_valid() ? m_out_fence.get() : m_display.get_drm_fd(), POLLIN, 0 };
+   lock.unlock();
+   int res;
+   do
+   {
+      res = poll(&pfd, 1, timeout_ms);
+   } while (res < 0 && errno == EINTR);
+   lock.lock();
+   m_polling = false;
+
+   VkResult result = VK_SUCCESS;
+   if (res == 0)
+   {
+      result = VK_TIMEOUT;
+   }
+   else if (res < 0 || (pfd.revents & (POLLERR | POLLNVAL)) != 0)
+   {
+      WSI_LOG_ERROR("Failed to wait for a page flip.");
+      result = VK_ERROR_SURFACE_LOST_KHR;
+   }
+   else if (m_out_fence.is_valid())
+   {
+      m_flip_done = true;
+   }
+   else
+   {
+      drmEventContext event_context = {};
+      event_context.version = 2;
+      event_context.page_flip_handler = page_flip_handler;
+      if (drmHandleEvent(pfd.fd, &event_context) != 0)
+      {
+         WSI_LOG_ERROR("Failed to handle display device events.");
+         result = VK_ERROR_SURFACE_LOST_KHR;
+      }
+   }
+
+   if (result == VK_SUCCESS && m_flip_done)
+   {
+      complete_flip();
+      commit_queued();
+   }
+   m_flip_cond.notify_all();
+   return result;
+}
+
+VkResult commit_scheduler::present(swapchain &owner, uint32_t plane_index, plane_frame frame)
+{
+   std::unique_lock<std::mutex> lock(m_mutex);
+   auto &plane = m_planes[plane_index];
+   const uint32_t image_index = frame.image_index;
+
+   /* Each swapchain presents from one thread, only the swapchain it took the plane over from can still have a frame
+    * queued. The flip in flight commits that one. */
+   VkResult result = VK_SUCCESS;
+   while (result == VK_SUCCESS && plane.owner == &owner && plane.has_queued)
+   {
+      result = wait_for_flip(lock, page_flip_timeout_ms);
+   }
+   if (plane.owner != &owner)
+   {
+      owner.release_image(image_index);
+      return VK_ERROR_OUT_OF_DATE_KHR;
+   }
+
+   VkResult frame_result = VK_NOT_READY;
+   if (result == VK_SUCCESS)
+   {
+      plane.queued = std::move(frame);
+      plane.queued_owner = &owner;
+      plane.queued_result = &frame_result;
+      plane.has_queued = true;
+   }
+
+   while (result == VK_SUCCESS && frame_result == VK_NOT_READY)
+   {
+      if (m_flip_in_flight)
+      {
+         result = wait_for_flip(lock, page_flip_timeout_ms);
+      }
+      else
+      {
+         commit_queued();
+      }
+   }
+
+   if (result == VK_TIMEOUT)
+   {
+      WSI_LOG_ERROR("Timed out waiting for a page flip.");
+      result = VK_ERROR_SURFACE_LOST_KHR;
+   }
+
+   /* Nothing may complete the local result once this returns. */
+   if (frame_result == VK_NOT_READY)
+   {
+      if (plane.has_queued && plane.queued_result == &frame_result)
+      {
+         plane.has_queued = false;
+         plane.queued.in_fence = util::fd_owner{};
+      }
+      frame_result = VK_ERROR_SURFACE_LOST_KHR;
+   }
+
+   /* A frame that never made it into a commit will not reach the screen. */
+   if (frame_result != VK_SUCCESS)
+   {
+      owner.release_image(image_index);
+   }
+   return result != VK_SUCCESS ? result : frame_result;
+}
+
+} /* namespace display */
+} /* namespace wsi */
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file commit_scheduler.hpp
+ *
+ * @brief Shares the CRTC of a display between the swapchains presenting to its planes.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+#include <xf86drmMode.h>
+
+#include "drm_display.hpp"
+#include "../layer_utils/custom_allocator.hpp"
+#include "../layer_utils/file_descriptor.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+class swapchain;
+
+/**
+ * @brief A swapchain image to scan out on a plane.
+ */
+struct plane_frame
+{
+   /** Index of the image in its swapchain. */
+   uint32_t image_index;
+   /** KMS framebuffer of the image. */
+   uint32_t fb_id;
+   /** Size of the image, which the plane scans out unscaled at the top left of the mode. */
+   VkExtent2D extent;
+   /** sync_file the plane waits for before scanning the image out, invalid if the image is ready. */
+   util::fd_owner in_fence;
+};
+
+/**
+ * @brief Commits the images of every swapchain on the display's planes to its CRTC.
+ *
+ * Each plane has at most one swapchain. A swapchain queues its images for its plane, and whichever swapchain finds
+ * no flip in flight commits the images queued for all planes in one atomic commit, so the display controller
+ * composes them without a GPU pass. Images are given back to their swapchain once a later image replaced them on
+ * screen, which the CRTC's OUT_FENCE_PTR fence tells when the driver has it, and the page flip event otherwise.
+ * Nothing waits for a flip in the background: the next present to any plane does, or an acquire that needs the
+ * image the flip gives back.
+ *
+ * Without atomic KMS only the primary plane can be used, which is set with drmModeSetCrtc and flipped with
+ * drmModePageFlip.
+ */
+class commit_scheduler
+{
+public:
+   /**
+    * @brief Returns the scheduler of @p display, which, like the display, outlives the instance.
+    */
+   static commit_scheduler &get(drm_display &display);
+
+   ~commit_scheduler();
+
+   /**
+    * @brief Make @p owner the swapchain presenting to the plane at @p plane_index.
+    *
+    * A swapchain presenting to the plane before, such as the one @p owner replaces, gets no more images onto it.
+    * All swapchains of the display must present on the same mode, which the first commit after a change sets.
+    *
+    * @param stack_index Position of the plane in the stack, which planes with a mutable zpos are moved to.
+    *
+    * @return VK_SUCCESS, VK_ERROR_INITIALIZATION_FAILED if the plane can not be used or another swapchain uses
+    *         another mode, or VK_ERROR_OUT_OF_HOST_MEMORY.
+    */
+   VkResult attach(swapchain &owner, uint32_t plane_index, uint32_t stack_index, const drm_display_mode &mode);
+
+   /**
+    * @brief Stop giving images back to @p owner, before its framebuffers are removed.
+    *
+    * Must not be called with the image status mutex of @p owner held. Waits for a flip in flight that involves an
+    * image of @p owner, as removing a framebuffer that is scanned out turns its plane off.
+    */
+   void detach(swapchain &owner);
+
+   /**
+    * @brief Commit @p frame to the plane of @p owner.
+    *
+    * Waits for the flip in flight first, during which the other swapchains can queue their images for the same
+    * commit, and returns once the commit including @p frame is made. The image it replaces on the plane is given
+    * back to its swapchain when it reaches the screen.
+    *
+    * @return VK_SUCCESS, VK_ERROR_OUT_OF_DATE_KHR if another swapchain took the plane over, or
+    *         VK_ERROR_SURFACE_LOST_KHR if the commit or the flip failed. The image is given back to @p owner if it
+    *         did not reach a commit.
+    */
+   VkResult present(swapchain &owner, uint32_t plane_index, plane_frame frame);
+
+   /**
+    * @brief Wait up to @p timeout_ms for the flip in flight if it gives an image back to @p owner.
+    *
+    * @return VK_SUCCESS if no such flip is in flight any more, VK_TIMEOUT, or VK_ERROR_SURFACE_LOST_KHR if the flip
+    *         failed.
+    */
+   VkResult wait_for_release(swapchain &owner, int timeout_ms);
+
+   /**
+    * @brief Whether the plane waits for the in fence of its frames, so rendering need not be waited for on the CPU.
+    */
+   bool waits_for_in_fence(uint32_t plane_index);
+
+   /**
+    * @brief Called from the DRM event handler when the flip in flight completed.
+    */
+   void on_page_flip();
+
+private:
+   explicit commit_scheduler(drm_display &display);
+
+   /** Ids of the KMS properties a commit sets on a plane. */
+   struct plane_property_ids
+   {
+      uint32_t fb_id;
+      uint32_t crtc_id;
+      uint32_t src_x;
+      uint32_t src_y;
+      uint32_t src_w;
+      uint32_t src_h;
+      uint32_t crtc_x;
+      uint32_t crtc_y;
+      uint32_t crtc_w;
+      uint32_t crtc_h;
+      /** 0 if the plane cannot wait for fences itself. */
+      uint32_t in_fence_fd;
+      /** 0 if the plane's zpos cannot be set. */
+      uint32_t zpos;
+   };
+
+   /** An image on a plane, given back to its swapchain once it is replaced. */
+   struct plane_image
+   {
+      /** nullptr if there is no image or its swapchain was detached. */
+      swapchain *owner;
+      uint32_t image_index;
+   };
+
+   struct plane_state
+   {
+      /** Swapchain presenting to the plane, nullptr if none. */
+      swapchain *owner;
+      /** Whether @ref ids have been looked up. */
+      bool has_ids;
+      plane_property_ids ids;
+      /** zpos the next commit moves the plane to, when @ref zpos_dirty. */
+      uint64_t zpos;
+      bool zpos_dirty;
+
+      /**
+       * Frame waiting for the next commit, and the swapchain that queued it. The presenting thread waits for the
+       * result, which stays VK_NOT_READY until the frame is committed.
+       */
+      bool has_queued;
+      plane_frame queued;
+      swapchain *queued_owner;
+      VkResult *queued_result;
+
+      /** Image of the commit in flight, if the commit included the plane. */
+      bool has_committed;
+      plane_image committed;
+      /** Image scanned out. */
+      plane_image displayed;
+   };
+
+   /**
+    * @brief Look up the CRTC and connector properties and those of the primary plane.
+    *
+    * @return false if atomic KMS is unavailable or a property is missing, in which case only the primary plane is
+    *         used, with the legacy modeset API.
+    */
+   bool init_atomic_properties();
+
+   /**
+    * @brief Look up the properties of the plane at @p plane_index.
+    *
+    * @return false if a property a commit needs is missing.
+    */
+   bool find_plane_properties(uint32_t plane_index);
+
+   /**
+    * @brief Commit the queued frames of all planes, failing their results if the commit fails.
+    */
+   void commit_queued();
+
+   int commit_atomic(util::fd_owner &out_fence);
+   int commit_legacy(plane_state &plane);
+
+   /**
+    * @brief Wait up to @p timeout_ms for the flip in flight, give back the images it replaced and commit the frames
+    *        queued meanwhile.
+    *
+    * Only one thread waits on the DRM fd or the out fence, the others wait for it with @p lock released.
+    *
+    * @return VK_SUCCESS if the flip completed or the wait should be retried, VK_TIMEOUT, or
+    *         VK_ERROR_SURFACE_LOST_KHR if the fd could not be waited for.
+    */
+   VkResult wait_for_flip(std::unique_lock<std::mutex> &lock, int timeout_ms);
+
+   /**
+    * @brief Move the images of the flip in flight on screen, and give back the images they replaced.
+    */
+   void complete_flip();
+
+   drm_display &m_display;
+
+   /** Protects all members below. */
+   std::mutex m_mutex;
+   /** Signalled when a wait for the flip in flight ends. */
+   std::condition_variable m_flip_cond;
+
+   /** State of each of the display's planes, empty until the first swapchain attaches. */
+   util::vector<plane_state> m_planes;
+
+   /** Whether commits are atomic, otherwise the legacy modeset and page flip API is used with the primary plane. */
+   bool m_use_atomic;
+   uint32_t m_connector_crtc_id;
+   uint32_t m_crtc_mode_id;
+   uint32_t m_crtc_active;
+   /** 0 if the CRTC cannot signal fences for its commits. */
+   uint32_t m_crtc_out_fence_ptr;
+
+   /** Mode the swapchains present on, nullptr until the first one attaches. */
+   const drm_display_mode *m_mode;
+   /** Property blob of @ref m_mode, 0 without atomic commits. */
+   uint32_t m_mode_blob_id;
+   /** Whether @ref m_mode has been set, by the first commit after it changed. */
+   bool m_mode_set;
+
+   /** Whether a commit has not reached the screen yet. */
+   bool m_flip_in_flight;
+   /** Set by @ref on_page_flip once the flip in flight completed. */
+   bool m_flip_done;
+   /** Out fence of the commit in flight, invalid when its page flip event is waited for instead. */
+   util::fd_owner m_out_fence;
+   /** Whether a thread waits on the fds for the flip in flight. */
+   bool m_polling;
+   /** Number of flips completed, so threads waiting on @ref m_flip_cond can tell a flip completed. */
+   uint64_t m_flip_sequence;
+};
+
+} /* namespace display */
+} /* namespace wsi */
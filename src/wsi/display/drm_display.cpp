@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2024 Arm Limited.
+ * Copyright (c) 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -39,24 +39,25 @@
 namespace wsi
 {
 
-namespace x11
+namespace display
 {
 
 const std::string default_dri_device_name{ "/dev/dri/card0" };
 
 drm_display::drm_display(util::fd_owner drm_fd, int crtc_id, drm_connector_owner drm_connector,
-                         util::unique_ptr<util::vector<drm_format_pair>> supported_formats,
+                         util::unique_ptr<util::vector<drm_plane_info>> planes,
                          util::unique_ptr<drm_display_mode> display_modes, size_t num_display_modes, uint32_t max_width,
-                         uint32_t max_height, bool supports_fb_modifiers)
+                         uint32_t max_height, bool supports_fb_modifiers, bool supports_atomic_modeset)
    : m_drm_fd(std::move(drm_fd))
    , m_crtc_id(crtc_id)
    , m_drm_connector(std::move(drm_connector))
-   , m_supported_formats(std::move(supported_formats))
+   , m_planes(std::move(planes))
    , m_display_modes(std::move(display_modes))
    , m_num_display_modes(num_display_modes)
    , m_max_width(max_width)
    , m_max_height(max_height)
    , m_supports_fb_modifiers(supports_fb_modifiers)
+   , m_supports_atomic_modeset(supports_atomic_modeset)
 {
 }
 
@@ -109,50 +110,51 @@ static int find_compatible_crtc(int fd, drm_resources_owner &resources, drm_conn
    return -ENODEV;
 }
 
-static bool find_primary_plane(const util::fd_owner &drm_fd, const drm_plane_resources_owner &plane_res,
-                               drm_plane_owner &primary_plane, uint32_t &primary_plane_index)
+/**
+ * @brief Read the type and zpos of a plane into @p type and @p info.
+ *
+ * @return false if the plane's properties could not be read.
+ */
+static bool get_plane_properties(int fd, uint32_t plane_id, uint64_t &type, drm_plane_info &info)
 {
-   for (uint32_t i = 0; i < plane_res->count_planes; i++)
+   drm_object_properties_owner props{ drmModeObjectGetProperties(fd, plane_id, DRM_MODE_OBJECT_PLANE) };
+   if (props == nullptr)
+   {
+      return false;
+   }
+
+   for (uint32_t i = 0; i < props->count_props; i++)
    {
-      drm_plane_owner temp_plane{ drmModeGetPlane(drm_fd.get(), plane_res->planes[i]) };
-      if (temp_plane != nullptr)
+      drm_property_owner prop{ drmModeGetProperty(fd, props->props[i]) };
+      if (prop == nullptr)
       {
-         drm_object_properties_owner props{ drmModeObjectGetProperties(drm_fd.get(), plane_res->planes[i],
-                                                                       DRM_MODE_OBJECT_PLANE) };
-         if (props == nullptr)
-         {
-            continue;
-         }
+         continue;
+      }
 
-         for (uint32_t j = 0; j < props->count_props; j++)
+      if (!strcmp(prop->name, "type"))
+      {
+         type = props->prop_values[i];
+      }
+      else if (!strcmp(prop->name, "zpos"))
+      {
+         info.zpos = props->prop_values[i];
+         /* An immutable zpos only reports where the hardware stacks the plane. */
+         info.zpos_mutable = (prop->flags & DRM_MODE_PROP_IMMUTABLE) == 0 && prop->count_values >= 2;
+         if (info.zpos_mutable)
          {
-            drm_property_owner prop{ drmModeGetProperty(drm_fd.get(), props->props[j]) };
-            if (prop == nullptr)
-            {
-               continue;
-            }
-
-            if (!strcmp(prop->name, "type"))
-            {
-               if (props->prop_values[j] == DRM_PLANE_TYPE_PRIMARY)
-               {
-                  primary_plane = std::move(temp_plane);
-                  primary_plane_index = i;
-                  return true;
-               }
-            }
+            info.zpos_min = prop->values[0];
+            info.zpos_max = prop->values[1];
          }
       }
    }
-   return false;
+   return true;
 }
 
-static bool fill_supported_formats(const drm_plane_owner &primary_plane,
-                                   util::vector<drm_format_pair> &supported_formats)
+static bool fill_supported_formats(const drm_plane_owner &plane, util::vector<drm_format_pair> &supported_formats)
 {
-   for (uint32_t i = 0; i < primary_plane->count_formats; i++)
+   for (uint32_t i = 0; i < plane->count_formats; i++)
    {
-      if (!supported_formats.try_push_back(drm_format_pair{ primary_plane->formats[i], DRM_FORMAT_MOD_LINEAR }))
+      if (!supported_formats.try_push_back(drm_format_pair{ plane->formats[i], DRM_FORMAT_MOD_LINEAR }))
       {
          WSI_LOG_ERROR("Out of host memory.");
          return false;
@@ -162,12 +164,11 @@ static bool fill_supported_formats(const drm_plane_owner &primary_plane,
    return true;
 }
 
-static bool fill_supported_formats_with_modifiers(uint32_t primary_plane_index, const util::fd_owner &drm_fd,
-                                                  const drm_plane_resources_owner &plane_res,
+static bool fill_supported_formats_with_modifiers(uint32_t plane_id, const util::fd_owner &drm_fd,
                                                   util::vector<drm_format_pair> &supported_formats)
 {
-   drm_object_properties_owner object_properties{ drmModeObjectGetProperties(
-      drm_fd.get(), plane_res->planes[primary_plane_index], DRM_MODE_OBJECT_PLANE) };
+   drm_object_properties_owner object_properties{ drmModeObjectGetProperties(drm_fd.get(), plane_id,
+                                                                             DRM_MODE_OBJECT_PLANE) };
    if (object_properties == nullptr)
    {
       return false;
@@ -203,6 +204,76 @@ static bool fill_supported_formats_with_modifiers(uint32_t primary_plane_index,
    return true;
 }
 
+/**
+ * @brief Collect the planes that can be attached to the CRTC at @p crtc_index, the primary plane first and then the
+ *        overlays by zpos.
+ *
+ * Overlays are only collected with @p with_overlays, as only atomic commits can put several planes on a CRTC.
+ * Cursor planes are left out, they are too small for swapchain images.
+ *
+ * @return false if the CRTC has no primary plane or on allocation failure.
+ */
+static bool find_crtc_planes(const util::allocator &allocator, const util::fd_owner &drm_fd,
+                             const drm_plane_resources_owner &plane_res, uint32_t crtc_index, bool with_overlays,
+                             bool supports_fb_modifiers, util::vector<drm_plane_info> &planes)
+{
+   bool found_primary = false;
+   for (uint32_t i = 0; i < plane_res->count_planes; i++)
+   {
+      drm_plane_owner plane{ drmModeGetPlane(drm_fd.get(), plane_res->planes[i]) };
+      /* Every CRTC has its own primary plane, only the one that can be attached to ours will do. */
+      if (plane == nullptr || (plane->possible_crtcs & (1u << crtc_index)) == 0)
+      {
+         continue;
+      }
+
+      uint64_t type = DRM_PLANE_TYPE_CURSOR;
+      drm_plane_info info{};
+      info.plane_id = plane->plane_id;
+      if (!get_plane_properties(drm_fd.get(), plane->plane_id, type, info))
+      {
+         continue;
+      }
+
+      info.primary = (type == DRM_PLANE_TYPE_PRIMARY);
+      if ((info.primary && found_primary) || (!info.primary && (type != DRM_PLANE_TYPE_OVERLAY || !with_overlays)))
+      {
+         continue;
+      }
+
+      info.formats = allocator.make_unique<util::vector<drm_format_pair>>(allocator);
+      if (info.formats == nullptr)
+      {
+         return false;
+      }
+      if (!supports_fb_modifiers || !fill_supported_formats_with_modifiers(plane->plane_id, drm_fd, *info.formats))
+      {
+         /* Fall back to the linear formats */
+         info.formats->clear();
+         if (!fill_supported_formats(plane, *info.formats))
+         {
+            return false;
+         }
+      }
+
+      if (!planes.try_push_back(std::move(info)))
+      {
+         return false;
+      }
+      found_primary = found_primary || planes.back().primary;
+   }
+
+   auto primary = std::find_if(planes.begin(), planes.end(), [](const drm_plane_info &plane) { return plane.primary; });
+   if (primary == planes.end())
+   {
+      return false;
+   }
+   std::iter_swap(planes.begin(), primary);
+   std::stable_sort(planes.begin() + 1, planes.end(),
+                    [](const drm_plane_info &a, const drm_plane_info &b) { return a.zpos < b.zpos; });
+   return true;
+}
+
 std::optional<drm_display> drm_display::make_display(const util::allocator &allocator, const char *drm_device)
 {
    util::fd_owner drm_fd{ open(drm_device, O_RDWR | O_CLOEXEC, 0) };
@@ -251,7 +322,7 @@ std::optional<drm_display> drm_display::make_display(const util::allocator &allo
       /* Need the full drmModeModeInfo cached to supply to drmModeSetCrtc. */
       drm_display_mode mode{};
       mode.set_drm_mode(connector->modes[j]);
-      mode.set_preferred(connector->modes[j].type == DRM_MODE_TYPE_PREFERRED);
+      mode.set_preferred((connector->modes[j].type & DRM_MODE_TYPE_PREFERRED) != 0);
 
       uint32_t resolution = static_cast<uint32_t>(mode.get_width()) * static_cast<uint32_t>(mode.get_height());
       if (resolution >= max_width * max_height)
@@ -286,17 +357,16 @@ std::optional<drm_display> drm_display::make_display(const util::allocator &allo
       return std::nullopt;
    }
 
-   uint32_t primary_plane_index = std::numeric_limits<uint32_t>::max();
-   drm_plane_owner primary_plane{ nullptr };
-
-   if (!find_primary_plane(drm_fd, plane_res, primary_plane, primary_plane_index))
+   /* Planes name the CRTCs they can be attached to by their index in the resources. */
+   uint32_t crtc_index = 0;
+   while (crtc_index < static_cast<uint32_t>(resources->count_crtcs) &&
+          resources->crtcs[crtc_index] != static_cast<uint32_t>(crtc_id))
    {
-      WSI_LOG_ERROR("Failed to find primary plane for display.");
-      return std::nullopt;
+      crtc_index++;
    }
 
-   assert(primary_plane != nullptr);
-   assert(primary_plane_index != std::numeric_limits<uint32_t>::max());
+   /* Lets the display swapchain modeset and flip with atomic commits, only a kernel without atomic KMS fails it. */
+   const bool supports_atomic_modeset = drmSetClientCap(drm_fd.get(), DRM_CLIENT_CAP_ATOMIC, 1) == 0;
 
    bool supports_fb_modifiers = false;
 
@@ -308,33 +378,27 @@ std::optional<drm_display> drm_display::make_display(const util::allocator &allo
    }
 #endif
 
-   auto supported_formats = allocator.make_unique<util::vector<drm_format_pair>>(allocator);
-
-   if (supports_fb_modifiers)
-   {
-      if (!fill_supported_formats_with_modifiers(primary_plane_index, drm_fd, plane_res, *supported_formats))
-      {
-         /* Fall back to the linear formats */
-         if (!fill_supported_formats(primary_plane, *supported_formats))
-         {
-            return std::nullopt;
-         }
-      }
-   }
-   else
+   auto planes = allocator.make_unique<util::vector<drm_plane_info>>(allocator);
+   if (planes == nullptr ||
+       !find_crtc_planes(allocator, drm_fd, plane_res, crtc_index, supports_atomic_modeset, supports_fb_modifiers,
+                         *planes))
    {
-      if (!fill_supported_formats(primary_plane, *supported_formats))
-      {
-         return std::nullopt;
-      }
+      WSI_LOG_ERROR("Failed to find primary plane for display.");
+      return std::nullopt;
    }
 
    std::copy(display_modes.begin(), display_modes.end(), display_modes_mem.get());
 
-   drm_display display{
-      std::move(drm_fd),    crtc_id,   std::move(connector), std::move(supported_formats), std::move(display_modes_mem),
-      display_modes.size(), max_width, max_height,           supports_fb_modifiers
-   };
+   drm_display display{ std::move(drm_fd),
+                        crtc_id,
+                        std::move(connector),
+                        std::move(planes),
+                        std::move(display_modes_mem),
+                        display_modes.size(),
+                        max_width,
+                        max_height,
+                        supports_fb_modifiers,
+                        supports_atomic_modeset };
 
    return std::make_optional(std::move(display));
 }
@@ -356,19 +420,20 @@ std::optional<drm_display> &drm_display::get_display()
    return display;
 }
 
-const util::vector<drm_format_pair> *drm_display::get_supported_formats() const
+const util::vector<drm_format_pair> *drm_display::get_supported_formats(uint32_t plane_index) const
 {
-   return m_supported_formats.get();
+   return get_plane(plane_index).formats.get();
 }
 
-bool drm_display::is_format_supported(const drm_format_pair &format) const
+bool drm_display::is_format_supported(const drm_format_pair &format, uint32_t plane_index) const
 {
+   const auto &supported_formats = *get_supported_formats(plane_index);
    auto supported_format =
-      std::find_if(m_supported_formats->begin(), m_supported_formats->end(), [format](const auto &supported_format) {
+      std::find_if(supported_formats.begin(), supported_formats.end(), [format](const auto &supported_format) {
          return format.fourcc == supported_format.fourcc && format.modifier == supported_format.modifier;
       });
 
-   return supported_format != m_supported_formats->end();
+   return supported_format != supported_formats.end();
 }
 
 bool drm_display::supports_fb_modifiers() const
@@ -394,8 +459,29 @@ uint16_t drm_display_mode::get_height() const
 
 uint32_t drm_display_mode::get_refresh_rate() const
 {
-   /* DRM provides refresh rate in Hz and vulkan expects mHz */
-   return m_drm_mode_info.vrefresh * 1000;
+   /* Vulkan expects mHz. DRM rounds vrefresh to Hz, the timings give the exact rate, e.g. 59940 for NTSC modes. */
+   uint64_t pixels_per_frame =
+      static_cast<uint64_t>(m_drm_mode_info.htotal) * static_cast<uint64_t>(m_drm_mode_info.vtotal);
+   if (pixels_per_frame == 0)
+   {
+      return m_drm_mode_info.vrefresh * 1000;
+   }
+
+   /* Counted the way the kernel's drm_mode_vrefresh() does: an interlaced frame is two fields. */
+   uint64_t clock_khz = m_drm_mode_info.clock;
+   if (m_drm_mode_info.flags & DRM_MODE_FLAG_INTERLACE)
+   {
+      clock_khz *= 2;
+   }
+   if (m_drm_mode_info.flags & DRM_MODE_FLAG_DBLSCAN)
+   {
+      pixels_per_frame *= 2;
+   }
+   if (m_drm_mode_info.vscan > 1)
+   {
+      pixels_per_frame *= m_drm_mode_info.vscan;
+   }
+   return static_cast<uint32_t>((clock_khz * 1000000 + pixels_per_frame / 2) / pixels_per_frame);
 }
 
 drmModeModeInfo drm_display_mode::get_drm_mode() const
@@ -448,6 +534,47 @@ int drm_display::get_crtc_id() const
    return m_crtc_id;
 }
 
+uint32_t drm_display::get_plane_id() const
+{
+   return get_plane(0).plane_id;
+}
+
+uint32_t drm_display::get_num_planes() const
+{
+   return static_cast<uint32_t>(m_planes->size());
+}
+
+const drm_plane_info &drm_display::get_plane(uint32_t plane_index) const
+{
+   assert(plane_index < m_planes->size());
+   return (*m_planes)[plane_index];
+}
+
+bool drm_display::supports_atomic_modeset() const
+{
+   return m_supports_atomic_modeset;
+}
+
+uint32_t drm_display::get_property_id(uint32_t object_id, uint32_t object_type, const char *name) const
+{
+   drm_object_properties_owner props{ drmModeObjectGetProperties(m_drm_fd.get(), object_id, object_type) };
+   if (props == nullptr)
+   {
+      return 0;
+   }
+
+   for (uint32_t i = 0; i < props->count_props; i++)
+   {
+      drm_property_owner prop{ drmModeGetProperty(m_drm_fd.get(), props->props[i]) };
+      if (prop != nullptr && strcmp(prop->name, name) == 0)
+      {
+         return prop->prop_id;
+      }
+   }
+
+   return 0;
+}
+
 drmModeConnector *drm_display::get_connector() const
 {
    return m_drm_connector.get();
@@ -462,6 +589,6 @@ uint32_t drm_display::get_max_height() const
    return m_max_height;
 }
 
-} /* namespace x11 */
+} /* namespace display */
 
 } /* namespace wsi */
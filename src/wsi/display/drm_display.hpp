@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2024 Arm Limited.
+ * Copyright (c) 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -27,6 +27,8 @@
 #include <vulkan/vulkan.h>
 #include <xf86drmMode.h>
 #include <xf86drm.h>
+#include <algorithm>
+#include <array>
 #include <optional>
 
 #include "../layer_utils/custom_allocator.hpp"
@@ -36,7 +38,7 @@
 namespace wsi
 {
 
-namespace x11
+namespace display
 {
 
 /* Owner types for DRM API objects */
@@ -62,6 +64,7 @@ using drm_plane_resources_owner = drm_owner<_drmModePlaneRes, drmModeFreePlaneRe
 using drm_object_properties_owner = drm_owner<_drmModeObjectProperties, drmModeFreeObjectProperties>;
 using drm_property_owner = drm_owner<_drmModeProperty, drmModeFreeProperty>;
 using drm_property_blob_owner = drm_owner<_drmModePropertyBlob, drmModeFreePropertyBlob>;
+using drm_atomic_req_owner = drm_owner<_drmModeAtomicReq, drmModeAtomicFree>;
 
 /**
  * @brief Owner class for an array of DRM GEM buffer handles.
@@ -73,6 +76,7 @@ public:
    drm_gem_handle_array(int fd)
       : m_fd(fd)
    {
+      m_handle.fill(UINT32_MAX);
    }
 
    uint32_t &operator[](size_t size)
@@ -92,18 +96,37 @@ public:
          if (handle != UINT32_MAX && m_fd != -1)
          {
             drmCloseBufferHandle(m_fd, handle);
+            /* Planes sharing a buffer share its handle, which must only be closed once. */
+            std::replace(m_handle.begin(), m_handle.end(), handle, UINT32_MAX);
          }
       }
    }
 
 private:
    int m_fd{ -1 };
-   std::array<uint32_t, array_size> m_handle{ UINT32_MAX };
+   std::array<uint32_t, array_size> m_handle;
 };
 
 /* Forward declaration */
 class drm_display;
 
+/**
+ * @brief A plane the display's CRTC can scan out on, with the formats it accepts.
+ */
+struct drm_plane_info
+{
+   uint32_t plane_id;
+   /** Whether this is the CRTC's primary plane rather than an overlay. */
+   bool primary;
+   /** Stacking position of the plane, higher is on top. 0 for every plane if the driver has no zpos property. */
+   uint64_t zpos;
+   /** Whether zpos can be set within [zpos_min, zpos_max], so the plane can be restacked. */
+   bool zpos_mutable;
+   uint64_t zpos_min;
+   uint64_t zpos_max;
+   util::unique_ptr<util::vector<drm_format_pair>> formats;
+};
+
 /**
  * @brief The display mode object.
  * The drm_display_mode class stores information
@@ -254,9 +277,11 @@ public:
    /**
     * @brief Get the supported formats for the display.
     *
+    * @param plane_index The plane to get the formats of, see @ref get_plane.
+    *
     * @return Pointer to vector of supported formats.
     */
-   const util::vector<drm_format_pair> *get_supported_formats() const;
+   const util::vector<drm_format_pair> *get_supported_formats(uint32_t plane_index = 0) const;
 
    /**
     * @brief Query the display for support for adding framebuffers with format modifiers.
@@ -268,10 +293,11 @@ public:
    /**
     * @brief Query the display for support of a specific format and modifier combination.
     *
-    * @param format The format to query support for.
+    * @param format      The format to query support for.
+    * @param plane_index The plane that scans the format out, see @ref get_plane.
     * @return true if the format is supported by the display, otherwise false.
     */
-   bool is_format_supported(const drm_format_pair &format) const;
+   bool is_format_supported(const drm_format_pair &format, uint32_t plane_index = 0) const;
 
    /**
     * @brief Returns a CRTC compatible with this display's connector.
@@ -280,6 +306,45 @@ public:
     */
    int get_crtc_id() const;
 
+   /**
+    * @brief Returns the primary plane that can be attached to the CRTC of @ref get_crtc_id.
+    *
+    * @return The plane id.
+    */
+   uint32_t get_plane_id() const;
+
+   /**
+    * @brief Get the number of planes the CRTC can scan out on, the primary plane and with atomic KMS its overlays.
+    */
+   uint32_t get_num_planes() const;
+
+   /**
+    * @brief Get a plane of the CRTC.
+    *
+    * Plane 0 is the primary plane, the overlays follow from the bottom of the stack to its top.
+    *
+    * @param plane_index Index of the plane, less than @ref get_num_planes.
+    */
+   const drm_plane_info &get_plane(uint32_t plane_index) const;
+
+   /**
+    * @brief Query whether the display can be driven with atomic commits.
+    *
+    * @return true if the DRM device accepted DRM_CLIENT_CAP_ATOMIC, otherwise false.
+    */
+   bool supports_atomic_modeset() const;
+
+   /**
+    * @brief Look up a property of a KMS object by name.
+    *
+    * @param object_id   The connector, CRTC or plane id.
+    * @param object_type The DRM_MODE_OBJECT_* type of @p object_id.
+    * @param name        The property name, for example "FB_ID".
+    *
+    * @return The property id, or 0 if the object has no such property.
+    */
+   uint32_t get_property_id(uint32_t object_id, uint32_t object_type, const char *name) const;
+
    /**
     * @brief Get the max width of the display in pixels.
     */
@@ -297,9 +362,9 @@ private:
     * @param allocator The allocator that the display will use.
     */
    drm_display(util::fd_owner drm_fd, int crtc_id, drm_connector_owner drm_connector,
-               util::unique_ptr<util::vector<drm_format_pair>> supported_formats,
-               util::unique_ptr<drm_display_mode> display_modes, size_t num_display_modes, uint32_t max_width,
-               uint32_t max_height, bool supports_fb_modifiers);
+               util::unique_ptr<util::vector<drm_plane_info>> planes, util::unique_ptr<drm_display_mode> display_modes,
+               size_t num_display_modes, uint32_t max_width, uint32_t max_height, bool supports_fb_modifiers,
+               bool supports_atomic_modeset);
 
    /**
     * @brief File descriptor for the display device.
@@ -317,9 +382,9 @@ private:
    drm_connector_owner m_drm_connector;
 
    /**
-    * @brief Vector of supported formats for use with the display.
+    * @brief Planes compatible with @ref m_crtc_id, the primary plane first.
     */
-   util::unique_ptr<util::vector<drm_format_pair>> m_supported_formats;
+   util::unique_ptr<util::vector<drm_plane_info>> m_planes;
 
    /**
     * @brief Pointer to available display modes for the connected display.
@@ -345,8 +410,13 @@ private:
     * @brief Flag to indicate if the display supports framebuffers with format modifiers.
     */
    bool m_supports_fb_modifiers;
+
+   /**
+    * @brief Flag to indicate if the display accepts atomic commits.
+    */
+   bool m_supports_atomic_modeset;
 };
 
-} /* namespace x11 */
+} /* namespace display */
 
 } /* namespace wsi */
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of a VK_KHR_display WSI Surface
+ */
+
+#include "surface.hpp"
+#include "swapchain.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+surface::surface(drm_display &display, drm_display_mode &display_mode, uint32_t plane_index, uint32_t stack_index,
+                 VkExtent2D image_extent)
+   : m_display(display)
+   , m_display_mode(display_mode)
+   , m_plane_index(plane_index)
+   , m_stack_index(stack_index)
+   , m_image_extent(image_extent)
+   , m_properties(this)
+{
+}
+
+wsi::surface_properties &surface::get_properties()
+{
+   return m_properties;
+}
+
+util::unique_ptr<swapchain_base> surface::allocate_swapchain(wsi::device_private_data &dev_data,
+                                                             const VkAllocationCallbacks *allocator)
+{
+   util::allocator alloc{ dev_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, allocator };
+   return util::unique_ptr<swapchain_base>(alloc.make_unique<swapchain>(dev_data, allocator, *this));
+}
+
+} /* namespace display */
+} /* namespace wsi */
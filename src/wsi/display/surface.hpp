@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Definitions for a VK_KHR_display WSI Surface
+ */
+
+#pragma once
+
+#include "wsi/surface.hpp"
+#include "drm_display.hpp"
+#include "surface_properties.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+class surface : public wsi::surface
+{
+public:
+   /**
+    * @brief Construct a surface that scans out on @p display_mode.
+    *
+    * @param display      The display the surface is presented on.
+    * @param display_mode The mode the display is set to on the first present. Must be one of @p display's modes.
+    * @param plane_index  The plane of @p display that scans the images out.
+    * @param stack_index  The position the plane is moved to in the stack, if it can be.
+    * @param image_extent The size of the swapchain images. The plane scans them out unscaled from the top left of
+    *                     the mode, which the primary plane covers.
+    */
+   surface(drm_display &display, drm_display_mode &display_mode, uint32_t plane_index, uint32_t stack_index,
+           VkExtent2D image_extent);
+
+   wsi::surface_properties &get_properties() override;
+   util::unique_ptr<swapchain_base> allocate_swapchain(wsi::device_private_data &dev_data,
+                                                       const VkAllocationCallbacks *allocator) override;
+
+   /** Returns the display of the surface. */
+   drm_display &get_display()
+   {
+      return m_display;
+   }
+
+   /** Returns the display mode of the surface. */
+   const drm_display_mode &get_display_mode() const
+   {
+      return m_display_mode;
+   }
+
+   /** Returns the index of the plane of the surface, see @ref drm_display::get_plane. */
+   uint32_t get_plane_index() const
+   {
+      return m_plane_index;
+   }
+
+   /** Returns the stack index the surface was created with. */
+   uint32_t get_plane_stack_index() const
+   {
+      return m_stack_index;
+   }
+
+   /** Returns the extent of the swapchain images. */
+   VkExtent2D get_image_extent() const
+   {
+      return m_image_extent;
+   }
+
+private:
+   drm_display &m_display;
+   drm_display_mode &m_display_mode;
+   uint32_t m_plane_index;
+   uint32_t m_stack_index;
+   VkExtent2D m_image_extent;
+   /** Surface properties specific to this surface. */
+   surface_properties m_properties;
+};
+
+} /* namespace display */
+} /* namespace wsi */
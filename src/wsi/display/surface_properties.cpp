@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of the VK_KHR_display surface properties and display enumeration entrypoints.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+#include <vulkan/vk_icd.h>
+#include <vulkan/vulkan.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include <wsi/wsi_private_data.hpp>
+
+#include "surface_properties.hpp"
+#include "surface.hpp"
+#include "drm_display.hpp"
+#include "../layer_utils/drm/drm_utils.hpp"
+#include "../layer_utils/helpers.hpp"
+#include "../layer_utils/macros.hpp"
+#include "utils/logging.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+void surface_properties::populate_present_mode_compatibilities()
+{
+   std::array<present_mode_compatibility, 1> compatible_present_modes_list = {
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
+   };
+   m_compatible_present_modes = compatible_present_modes<1>(compatible_present_modes_list);
+}
+
+surface_properties::surface_properties(surface *wsi_surface)
+   : specific_surface(wsi_surface)
+   , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR })
+{
+   populate_present_mode_compatibilities();
+}
+
+surface_properties &surface_properties::get_instance()
+{
+   static surface_properties instance{ nullptr };
+   return instance;
+}
+
+VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_device,
+                                                      VkSurfaceCapabilitiesKHR *surface_capabilities)
+{
+   assert(specific_surface != nullptr);
+   get_surface_capabilities_common(physical_device, surface_capabilities);
+
+   /* One image stays on screen until the flip to the next one completes. */
+   surface_capabilities->minImageCount = 2;
+
+   /* The plane scans out images of the surface's extent only, without scaling. */
+   const VkExtent2D extent = specific_surface->get_image_extent();
+   surface_capabilities->currentExtent = extent;
+   surface_capabilities->minImageExtent = extent;
+   surface_capabilities->maxImageExtent = extent;
+
+   /* Planes are blended by the alpha mode of the surface, not by the swapchain. */
+   surface_capabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+   return VK_SUCCESS;
+}
+
+VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_device,
+                                                      const VkPhysicalDeviceSurfaceInfo2KHR *pSurfaceInfo,
+                                                      VkSurfaceCapabilities2KHR *pSurfaceCapabilities)
+{
+   TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_supported_modes));
+
+   get_surface_capabilities(physical_device, &pSurfaceCapabilities->surfaceCapabilities);
+
+   m_compatible_present_modes.get_surface_present_mode_compatibility_common(pSurfaceInfo, pSurfaceCapabilities);
+
+   auto surface_scaling_capabilities = util::find_extension<VkSurfacePresentScalingCapabilitiesEXT>(
+      VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT, pSurfaceCapabilities);
+   if (surface_scaling_capabilities != nullptr)
+   {
+      get_surface_present_scaling_and_gravity(surface_scaling_capabilities);
+      surface_scaling_capabilities->minScaledImageExtent = pSurfaceCapabilities->surfaceCapabilities.minImageExtent;
+      surface_scaling_capabilities->maxScaledImageExtent = pSurfaceCapabilities->surfaceCapabilities.maxImageExtent;
+   }
+
+   return VK_SUCCESS;
+}
+
+/**
+ * @brief Add @p format to @p formats if the device can import a dmabuf of @p drm_format as an image of it.
+ */
+static VkResult add_surface_format(VkPhysicalDevice phys_dev, util::vector<surface_format_properties> &formats,
+                                   VkFormat format, const drm_format_pair &drm_format)
+{
+   for (const auto &props : formats)
+   {
+      if (props.m_surface_format.format == format)
+      {
+         return VK_SUCCESS;
+      }
+   }
+
+   VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+   external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+   VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
+   drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
+   drm_mod_info.pNext = &external_info;
+   drm_mod_info.drmFormatModifier = drm_format.modifier;
+   drm_mod_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+   VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+   image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+   image_info.pNext = &drm_mod_info;
+   image_info.format = format;
+   image_info.type = VK_IMAGE_TYPE_2D;
+   image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+   image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+   surface_format_properties format_props{ format };
+   VkResult res = format_props.check_device_support(phys_dev, image_info);
+   if (res == VK_ERROR_FORMAT_NOT_SUPPORTED)
+   {
+      return VK_SUCCESS;
+   }
+   TRY(res);
+
+   if (wsi::instance_private_data::get(phys_dev).has_image_compression_support(phys_dev))
+   {
+      TRY(format_props.add_device_compression_support(phys_dev, image_info));
+   }
+
+   if (!formats.try_push_back(format_props))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   return VK_SUCCESS;
+}
+
+VkResult surface_properties::get_surface_formats(VkPhysicalDevice physical_device, uint32_t *surface_format_count,
+                                                 VkSurfaceFormatKHR *surface_formats,
+                                                 VkSurfaceFormat2KHR *extended_surface_formats)
+{
+   assert(specific_surface != nullptr);
+   util::vector<surface_format_properties> formats{ util::allocator(
+      wsi::instance_private_data::get(physical_device).get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
+
+   for (const auto &drm_format : *specific_surface->get_display().get_supported_formats(specific_surface->get_plane_index()))
+   {
+      const VkFormat vk_format = util::drm::drm_to_vk_format(drm_format.fourcc);
+      if (vk_format != VK_FORMAT_UNDEFINED)
+      {
+         TRY_LOG_CALL(add_surface_format(physical_device, formats, vk_format, drm_format));
+      }
+      const VkFormat srgb_vk_format = util::drm::drm_to_vk_srgb_format(drm_format.fourcc);
+      if (srgb_vk_format != VK_FORMAT_UNDEFINED)
+      {
+         TRY_LOG_CALL(add_surface_format(physical_device, formats, srgb_vk_format, drm_format));
+      }
+   }
+
+   return surface_properties_formats_helper(formats.begin(), formats.end(), surface_format_count, surface_formats,
+                                            extended_surface_formats);
+}
+
+VkResult surface_properties::get_surface_present_modes(VkPhysicalDevice physical_device, VkSurfaceKHR surface,
+                                                       uint32_t *present_mode_count, VkPresentModeKHR *present_modes)
+{
+   UNUSED(physical_device);
+   UNUSED(surface);
+   return get_surface_present_modes_common(present_mode_count, present_modes, m_supported_modes);
+}
+
+VkResult surface_properties::get_required_device_extensions(util::extension_list &extension_list)
+{
+   const std::array required_device_extensions{
+      VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+      VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+      VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+      VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+      VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+      VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_FENCE_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME,
+   };
+   return extension_list.add(required_device_extensions.data(), required_device_extensions.size());
+}
+
+VkResult surface_properties::get_required_instance_extensions(util::extension_list &extension_list)
+{
+   const std::array required_instance_extensions{
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
+   };
+   return extension_list.add(required_instance_extensions.data(), required_instance_extensions.size());
+}
+
+/* All displays are the one @ref drm_display::get_display drives. Its planes are those of drm_display::get_plane, and
+ * their stack index is the plane index. */
+
+static VkDisplayKHR get_display_handle(drm_display &display)
+{
+   return reinterpret_cast<VkDisplayKHR>(&display);
+}
+
+static drm_display *get_drm_display(VkDisplayKHR display)
+{
+   auto &drm = drm_display::get_display();
+   if (!drm.has_value() || get_display_handle(drm.value()) != display)
+   {
+      return nullptr;
+   }
+   return &drm.value();
+}
+
+static drm_display_mode *get_drm_display_mode(drm_display &display, VkDisplayModeKHR mode)
+{
+   for (auto *it = display.get_display_modes_begin(); it != display.get_display_modes_end(); ++it)
+   {
+      if (reinterpret_cast<VkDisplayModeKHR>(it) == mode)
+      {
+         return it;
+      }
+   }
+   return nullptr;
+}
+
+static const char *get_connector_type_name(uint32_t connector_type)
+{
+   switch (connector_type)
+   {
+   case DRM_MODE_CONNECTOR_VGA:
+      return "VGA";
+   case DRM_MODE_CONNECTOR_DVII:
+   case DRM_MODE_CONNECTOR_DVID:
+   case DRM_MODE_CONNECTOR_DVIA:
+      return "DVI";
+   case DRM_MODE_CONNECTOR_LVDS:
+      return "LVDS";
+   case DRM_MODE_CONNECTOR_DisplayPort:
+      return "DP";
+   case DRM_MODE_CONNECTOR_HDMIA:
+   case DRM_MODE_CONNECTOR_HDMIB:
+      return "HDMI";
+   case DRM_MODE_CONNECTOR_eDP:
+      return "eDP";
+   case DRM_MODE_CONNECTOR_DSI:
+      return "DSI";
+   case DRM_MODE_CONNECTOR_DPI:
+      return "DPI";
+   default:
+      return "monitor";
+   }
+}
+
+VWL_VKAPI_CALL(VkResult)
+GetPhysicalDeviceDisplayPropertiesKHR(VkPhysicalDevice physicalDevice, uint32_t *pPropertyCount,
+                                      VkDisplayPropertiesKHR *pProperties) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   auto &display = drm_display::get_display();
+   if (!display.has_value())
+   {
+      *pPropertyCount = 0;
+      return VK_SUCCESS;
+   }
+
+   if (pProperties == nullptr)
+   {
+      *pPropertyCount = 1;
+      return VK_SUCCESS;
+   }
+   if (*pPropertyCount < 1)
+   {
+      return VK_INCOMPLETE;
+   }
+
+   bool reorder_possible = false;
+   for (uint32_t i = 0; i < display->get_num_planes(); i++)
+   {
+      reorder_possible = reorder_possible || display->get_plane(i).zpos_mutable;
+   }
+
+   const drmModeConnector *connector = display->get_connector();
+   pProperties[0] = {};
+   pProperties[0].display = get_display_handle(display.value());
+   pProperties[0].displayName = get_connector_type_name(connector->connector_type);
+   pProperties[0].physicalDimensions = { connector->mmWidth, connector->mmHeight };
+   pProperties[0].physicalResolution = { display->get_max_width(), display->get_max_height() };
+   pProperties[0].supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+   pProperties[0].planeReorderPossible = reorder_possible ? VK_TRUE : VK_FALSE;
+   pProperties[0].persistentContent = VK_FALSE;
+   *pPropertyCount = 1;
+   return VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(VkResult)
+GetPhysicalDeviceDisplayPlanePropertiesKHR(VkPhysicalDevice physicalDevice, uint32_t *pPropertyCount,
+                                           VkDisplayPlanePropertiesKHR *pProperties) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   auto &display = drm_display::get_display();
+   if (!display.has_value())
+   {
+      *pPropertyCount = 0;
+      return VK_SUCCESS;
+   }
+
+   const uint32_t num_planes = display->get_num_planes();
+   if (pProperties == nullptr)
+   {
+      *pPropertyCount = num_planes;
+      return VK_SUCCESS;
+   }
+
+   const uint32_t count = std::min(*pPropertyCount, num_planes);
+   for (uint32_t i = 0; i < count; i++)
+   {
+      pProperties[i].currentDisplay = get_display_handle(display.value());
+      pProperties[i].currentStackIndex = i;
+   }
+   *pPropertyCount = count;
+   return count < num_planes ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(VkResult)
+GetDisplayPlaneSupportedDisplaysKHR(VkPhysicalDevice physicalDevice, uint32_t planeIndex, uint32_t *pDisplayCount,
+                                    VkDisplayKHR *pDisplays) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   auto &display = drm_display::get_display();
+   if (!display.has_value() || planeIndex >= display->get_num_planes())
+   {
+      *pDisplayCount = 0;
+      return VK_SUCCESS;
+   }
+
+   if (pDisplays == nullptr)
+   {
+      *pDisplayCount = 1;
+      return VK_SUCCESS;
+   }
+   if (*pDisplayCount < 1)
+   {
+      return VK_INCOMPLETE;
+   }
+
+   pDisplays[0] = get_display_handle(display.value());
+   *pDisplayCount = 1;
+   return VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(VkResult)
+GetDisplayModePropertiesKHR(VkPhysicalDevice physicalDevice, VkDisplayKHR display, uint32_t *pPropertyCount,
+                            VkDisplayModePropertiesKHR *pProperties) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   drm_display *drm = get_drm_display(display);
+   if (drm == nullptr)
+   {
+      *pPropertyCount = 0;
+      return VK_SUCCESS;
+   }
+
+   const uint32_t num_modes = static_cast<uint32_t>(drm->get_num_display_modes());
+   if (pProperties == nullptr)
+   {
+      *pPropertyCount = num_modes;
+      return VK_SUCCESS;
+   }
+
+   const uint32_t count = std::min(*pPropertyCount, num_modes);
+   drm_display_mode *modes = drm->get_display_modes_begin();
+   for (uint32_t i = 0; i < count; i++)
+   {
+      pProperties[i].displayMode = reinterpret_cast<VkDisplayModeKHR>(&modes[i]);
+      pProperties[i].parameters.visibleRegion = { modes[i].get_width(), modes[i].get_height() };
+      pProperties[i].parameters.refreshRate = modes[i].get_refresh_rate();
+   }
+   *pPropertyCount = count;
+   return count < num_modes ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(VkResult)
+CreateDisplayModeKHR(VkPhysicalDevice physicalDevice, VkDisplayKHR display,
+                     const VkDisplayModeCreateInfoKHR *pCreateInfo, const VkAllocationCallbacks *pAllocator,
+                     VkDisplayModeKHR *pMode) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   UNUSED(pAllocator);
+   drm_display *drm = get_drm_display(display);
+   if (drm == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* Custom timings are not supported, but asking for one of the connector's modes gives that mode. */
+   const VkDisplayModeParametersKHR &params = pCreateInfo->parameters;
+   for (auto *mode = drm->get_display_modes_begin(); mode != drm->get_display_modes_end(); ++mode)
+   {
+      if (mode->get_width() == params.visibleRegion.width && mode->get_height() == params.visibleRegion.height &&
+          mode->get_refresh_rate() == params.refreshRate)
+      {
+         *pMode = reinterpret_cast<VkDisplayModeKHR>(mode);
+         return VK_SUCCESS;
+      }
+   }
+
+   WSI_LOG_ERROR("Display mode %ux%u@%umHz is not one of the connector's modes.", params.visibleRegion.width,
+                 params.visibleRegion.height, params.refreshRate);
+   return VK_ERROR_INITIALIZATION_FAILED;
+}
+
+VWL_VKAPI_CALL(VkResult)
+GetDisplayPlaneCapabilitiesKHR(VkPhysicalDevice physicalDevice, VkDisplayModeKHR mode, uint32_t planeIndex,
+                               VkDisplayPlaneCapabilitiesKHR *pCapabilities) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   auto &display = drm_display::get_display();
+   drm_display_mode *drm_mode = display.has_value() ? get_drm_display_mode(display.value(), mode) : nullptr;
+   if (drm_mode == nullptr || planeIndex >= display->get_num_planes())
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* The primary plane covers the whole mode, overlays are placed at its top left. Neither is scaled. */
+   const VkExtent2D extent = { drm_mode->get_width(), drm_mode->get_height() };
+   *pCapabilities = {};
+   pCapabilities->maxSrcExtent = extent;
+   pCapabilities->maxDstExtent = extent;
+   if (display->get_plane(planeIndex).primary)
+   {
+      pCapabilities->supportedAlpha = VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR;
+      pCapabilities->minSrcExtent = extent;
+      pCapabilities->minDstExtent = extent;
+   }
+   else
+   {
+      /* KMS blends overlays with premultiplied alpha by default. */
+      pCapabilities->supportedAlpha =
+         VK_DISPLAY_PLANE_ALPHA_OPAQUE_BIT_KHR | VK_DISPLAY_PLANE_ALPHA_PER_PIXEL_PREMULTIPLIED_BIT_KHR;
+      pCapabilities->minSrcExtent = { 1, 1 };
+      pCapabilities->minDstExtent = { 1, 1 };
+   }
+   return VK_SUCCESS;
+}
+
+VWL_VKAPI_CALL(VkResult)
+CreateDisplayPlaneSurfaceKHR(VkInstance instance, const VkDisplaySurfaceCreateInfoKHR *pCreateInfo,
+                             const VkAllocationCallbacks *pAllocator, VkSurfaceKHR *pSurface) VWL_API_POST
+{
+   auto &instance_data = wsi::instance_private_data::get(instance);
+   auto &display = drm_display::get_display();
+   drm_display_mode *drm_mode =
+      display.has_value() ? get_drm_display_mode(display.value(), pCreateInfo->displayMode) : nullptr;
+   if (drm_mode == nullptr || pCreateInfo->planeIndex >= display->get_num_planes())
+   {
+      WSI_LOG_ERROR("Display surfaces need one of the display's planes and modes.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   const drm_plane_info &plane = display->get_plane(pCreateInfo->planeIndex);
+   if (pCreateInfo->planeStackIndex >= display->get_num_planes() ||
+       (!plane.zpos_mutable && pCreateInfo->planeStackIndex != pCreateInfo->planeIndex))
+   {
+      WSI_LOG_ERROR("Plane %u can not be moved to stack index %u.", pCreateInfo->planeIndex,
+                    pCreateInfo->planeStackIndex);
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   const VkExtent2D &extent = pCreateInfo->imageExtent;
+   const bool fits_plane = plane.primary ?
+                              (extent.width == drm_mode->get_width() && extent.height == drm_mode->get_height()) :
+                              (extent.width <= drm_mode->get_width() && extent.height <= drm_mode->get_height());
+   if (pCreateInfo->transform != VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR || !fits_plane)
+   {
+      WSI_LOG_ERROR("Display surfaces can not be transformed or scaled.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   util::allocator allocator{ instance_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, pAllocator };
+   auto wsi_surface = util::unique_ptr<wsi::surface>(allocator.make_unique<surface>(
+      display.value(), *drm_mode, pCreateInfo->planeIndex, pCreateInfo->planeStackIndex, extent));
+   if (wsi_surface == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   *pSurface = reinterpret_cast<VkSurfaceKHR>(wsi_surface.get());
+
+   VkResult res = instance_data.add_surface(*pSurface, wsi_surface);
+   if (res != VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to add display surface to instance data, result: %d\n", res);
+   }
+   return res;
+}
+
+VWL_VKAPI_CALL(VkResult)
+ReleaseDisplayEXT(VkPhysicalDevice physicalDevice, VkDisplayKHR display) VWL_API_POST
+{
+   UNUSED(physicalDevice);
+   drm_display *drm = get_drm_display(display);
+   if (drm == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* Lets a display server take the display over; the next modeset needs DRM master again. */
+   drmDropMaster(drm->get_drm_fd());
+   return VK_SUCCESS;
+}
+
+PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
+{
+   if (strcmp(name, "vkCreateDisplayModeKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(CreateDisplayModeKHR);
+   }
+   if (strcmp(name, "vkCreateDisplayPlaneSurfaceKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(CreateDisplayPlaneSurfaceKHR);
+   }
+   if (strcmp(name, "vkGetDisplayModePropertiesKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayModePropertiesKHR);
+   }
+   if (strcmp(name, "vkGetDisplayPlaneCapabilitiesKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayPlaneCapabilitiesKHR);
+   }
+   if (strcmp(name, "vkGetDisplayPlaneSupportedDisplaysKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(GetDisplayPlaneSupportedDisplaysKHR);
+   }
+   if (strcmp(name, "vkGetPhysicalDeviceDisplayPlanePropertiesKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceDisplayPlanePropertiesKHR);
+   }
+   if (strcmp(name, "vkGetPhysicalDeviceDisplayPropertiesKHR") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(GetPhysicalDeviceDisplayPropertiesKHR);
+   }
+   if (strcmp(name, "vkReleaseDisplayEXT") == 0)
+   {
+      return reinterpret_cast<PFN_vkVoidFunction>(ReleaseDisplayEXT);
+   }
+   return nullptr;
+}
+
+bool surface_properties::is_surface_extension_enabled(const wsi::instance_private_data &instance_data)
+{
+   return instance_data.is_instance_extension_enabled(VK_KHR_DISPLAY_EXTENSION_NAME);
+}
+
+void surface_properties::get_surface_present_scaling_and_gravity(
+   VkSurfacePresentScalingCapabilitiesEXT *scaling_capabilities)
+{
+   scaling_capabilities->supportedPresentScaling = 0;
+   scaling_capabilities->supportedPresentGravityX = 0;
+   scaling_capabilities->supportedPresentGravityY = 0;
+}
+
+bool surface_properties::is_compatible_present_modes(VkPresentModeKHR present_mode_a, VkPresentModeKHR present_mode_b)
+{
+   return m_compatible_present_modes.is_compatible_present_modes(present_mode_a, present_mode_b);
+}
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+void surface_properties::get_present_timing_surface_caps(
+   VkPresentTimingSurfaceCapabilitiesEXT *present_timing_surface_caps)
+{
+   present_timing_surface_caps->presentTimingSupported = VK_FALSE;
+   present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_FALSE;
+   present_timing_surface_caps->presentAtRelativeTimeSupported = VK_FALSE;
+   present_timing_surface_caps->presentStageQueries = 0;
+   present_timing_surface_caps->presentStageTargets = 0;
+}
+#endif
+
+} /* namespace display */
+} /* namespace wsi */
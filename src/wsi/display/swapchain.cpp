@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file swapchain.cpp
+ *
+ * @brief Contains the implementation for a swapchain that presents to a KMS plane.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <drm_fourcc.h>
+
+#include "swapchain.hpp"
+#include "../layer_utils/drm/drm_utils.hpp"
+#include "../layer_utils/format_modifiers.hpp"
+#include "../layer_utils/helpers.hpp"
+#include "utils/logging.hpp"
+#include "../layer_utils/macros.hpp"
+
+#include <wsi/extensions/image_compression_control.hpp>
+#include <wsi/extensions/present_id.hpp>
+#include <wsi/extensions/swapchain_maintenance.hpp>
+
+namespace wsi
+{
+namespace display
+{
+
+swapchain::swapchain(wsi::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator,
+                     surface &wsi_surface)
+   : swapchain_base(dev_data, pAllocator)
+   , m_wsi_surface(&wsi_surface)
+   , m_display(wsi_surface.get_display())
+   , m_wsi_allocator(nullptr)
+   , m_image_creation_parameters({}, m_allocator, {}, {})
+   , m_scheduler(commit_scheduler::get(m_display))
+   , m_waits_for_in_fence(false)
+{
+   m_image_create_info.format = VK_FORMAT_UNDEFINED;
+}
+
+swapchain::~swapchain()
+{
+   teardown();
+   m_scheduler.detach(*this);
+
+   if (m_wsi_allocator != nullptr)
+   {
+      wsialloc_delete(m_wsi_allocator);
+   }
+   m_wsi_allocator = nullptr;
+}
+
+void swapchain::release_image(uint32_t image_index)
+{
+   unpresent_image(image_index);
+}
+
+VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
+{
+   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info);
+   if (compression_control)
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_image_compression_control>(*compression_control)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.is_present_id_enabled())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_present_id>()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.is_swapchain_maintenance1_enabled())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_swapchain_maintenance1>(m_allocator)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.should_layer_handle_frame_boundary_events())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>(m_device_data)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
+                                  bool &use_presentation_thread)
+{
+   UNUSED(device);
+   UNUSED(swapchain_create_info);
+
+   if (m_display.get_drm_fd() < 0)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   TRY_LOG(m_scheduler.attach(*this, m_wsi_surface->get_plane_index(), m_wsi_surface->get_plane_stack_index(),
+                              m_wsi_surface->get_display_mode()),
+           "Failed to assign the display plane to the swapchain");
+   m_waits_for_in_fence = m_scheduler.waits_for_in_fence(m_wsi_surface->get_plane_index());
+
+   WSIALLOC_ASSERT_VERSION();
+   if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_ERROR("Failed to create wsi allocator.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* Presents wait for their page flip, which must not block vkQueuePresentKHR. */
+   use_presentation_thread = true;
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info,
+                                                   util::vector<wsialloc_format> &importable_formats,
+                                                   util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props)
+{
+   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
+           "Failed to get format properties");
+
+   for (const auto &prop : drm_format_props)
+   {
+      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
+      if (!m_display.is_format_supported(drm_format, m_wsi_surface->get_plane_index()))
+      {
+         continue;
+      }
+
+      VkExternalImageFormatPropertiesKHR external_props = {};
+      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
+
+      VkImageFormatProperties2KHR format_props = {};
+      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
+      format_props.pNext = &external_props;
+
+      VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+      external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+      external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+      VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
+      drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
+      drm_mod_info.pNext = &external_info;
+      drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
+      drm_mod_info.sharingMode = info.sharingMode;
+      drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
+      drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
+
+      VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+      image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+      image_info.pNext = &drm_mod_info;
+      image_info.format = info.format;
+      image_info.type = info.imageType;
+      image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+      image_info.usage = info.usage;
+      image_info.flags = info.flags;
+
+      VkImageCompressionControlEXT compression_control = {};
+      if (m_device_data.is_swapchain_compression_control_enabled())
+      {
+         auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+         if (ext)
+         {
+            compression_control = ext->get_compression_control_properties();
+            compression_control.pNext = image_info.pNext;
+            image_info.pNext = &compression_control;
+         }
+      }
+
+      VkResult result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
+         m_device_data.physical_device, &image_info, &format_props);
+      if (result != VK_SUCCESS)
+      {
+         continue;
+      }
+      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
+          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
+          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
+      {
+         continue;
+      }
+      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
+          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
+      {
+         continue;
+      }
+      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+      {
+         continue;
+      }
+
+      if (external_props.externalMemoryProperties.externalMemoryFeatures &
+          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      {
+         uint64_t flags =
+            (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
+         wsialloc_format import_format{ drm_format.fourcc, drm_format.modifier, flags };
+         if (!importable_formats.try_push_back(import_format))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+   }
+
+   util::apply_afbc_policy(importable_formats, is_compression_allowed());
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, display_image_data &image_data,
+                                      util::vector<wsialloc_format> &importable_formats,
+                                      wsialloc_format *allocated_format, bool avoid_allocation)
+{
+   bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
+   uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
+   if (avoid_allocation)
+   {
+      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
+   }
+
+   if (m_device_data.is_swapchain_compression_control_enabled())
+   {
+      auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+      if (ext)
+      {
+         if (ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)
+         {
+            allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
+         }
+      }
+   }
+
+   wsialloc_allocate_info alloc_info = { importable_formats.data(), static_cast<unsigned>(importable_formats.size()),
+                                         image_create_info.extent.width, image_create_info.extent.height,
+                                         allocation_flags };
+
+   wsialloc_allocate_result alloc_result = { {}, { 0 }, { 0 }, { -1 }, false };
+   /* Clear buffer_fds and average_row_strides for error purposes */
+   for (int i = 0; i < WSIALLOC_MAX_PLANES; ++i)
+   {
+      alloc_result.buffer_fds[i] = -1;
+      alloc_result.average_row_strides[i] = -1;
+   }
+   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   if (res != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
+      if (res == WSIALLOC_ERROR_NOT_SUPPORTED)
+      {
+         return VK_ERROR_FORMAT_NOT_SUPPORTED;
+      }
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   *allocated_format = alloc_result.format;
+   auto &external_memory = image_data.external_mem;
+   external_memory.set_strides(alloc_result.average_row_strides);
+   external_memory.set_buffer_fds(alloc_result.buffer_fds);
+   external_memory.set_offsets(alloc_result.offsets);
+
+   uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
+
+   if (!avoid_allocation)
+   {
+      uint32_t num_memory_planes = 0;
+
+      for (uint32_t i = 0; i < num_planes; ++i)
+      {
+         auto it = std::find(std::begin(alloc_result.buffer_fds) + i + 1, std::end(alloc_result.buffer_fds),
+                             alloc_result.buffer_fds[i]);
+         if (it == std::end(alloc_result.buffer_fds))
+         {
+            num_memory_planes++;
+         }
+      }
+
+      assert(alloc_result.is_disjoint == (num_memory_planes > 1));
+      external_memory.set_num_memories(num_memory_planes);
+      external_memory.set_release_to_wsialloc(!is_protected_memory);
+   }
+
+   external_memory.set_format_info(alloc_result.is_disjoint, num_planes);
+   external_memory.set_memory_handle_type(VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT);
+   return VK_SUCCESS;
+}
+
+static VkResult fill_image_create_info(VkImageCreateInfo &image_create_info,
+                                       util::vector<VkSubresourceLayout> &image_plane_layouts,
+                                       VkImageDrmFormatModifierExplicitCreateInfoEXT &drm_mod_info,
+                                       VkExternalMemoryImageCreateInfoKHR &external_info,
+                                       display_image_data &image_data, uint64_t modifier)
+{
+   TRY_LOG_CALL(image_data.external_mem.fill_image_plane_layouts(image_plane_layouts));
+
+   if (image_data.external_mem.is_disjoint())
+   {
+      image_create_info.flags |= VK_IMAGE_CREATE_DISJOINT_BIT;
+   }
+
+   image_data.external_mem.fill_drm_mod_info(image_create_info.pNext, drm_mod_info, image_plane_layouts, modifier);
+   image_data.external_mem.fill_external_info(external_info, &drm_mod_info);
+   image_create_info.pNext = &external_info;
+   image_create_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_image(display_image_data &image_data)
+{
+   util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(m_allocated_format))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::add_framebuffer(const VkImageCreateInfo &image_create_info, display_image_data &image_data)
+{
+   const int drm_fd = m_display.get_drm_fd();
+   const uint32_t num_planes = image_data.external_mem.get_num_planes();
+   const uint64_t modifier = m_image_creation_parameters.m_allocated_format.modifier;
+
+   /* The handles are only needed to add the framebuffer, which holds its own reference to the buffers. */
+   drm_gem_handle_array<MAX_PLANES> handles(drm_fd);
+   uint32_t pitches[4] = { 0 };
+   uint32_t offsets[4] = { 0 };
+   uint64_t modifiers[4] = { 0 };
+   for (uint32_t plane = 0; plane < num_planes; plane++)
+   {
+      if (drmPrimeFDToHandle(drm_fd, image_data.external_mem.get_buffer_fds()[plane], &handles[plane]) != 0)
+      {
+         WSI_LOG_ERROR("Failed to import the image's dmabuf into the display device: %s", strerror(errno));
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+      pitches[plane] = static_cast<uint32_t>(image_data.external_mem.get_strides()[plane]);
+      offsets[plane] = image_data.external_mem.get_offsets()[plane];
+      modifiers[plane] = modifier;
+   }
+
+   const uint32_t fourcc = m_image_creation_parameters.m_allocated_format.fourcc;
+   int res;
+   if (m_display.supports_fb_modifiers())
+   {
+      res = drmModeAddFB2WithModifiers(drm_fd, image_create_info.extent.width, image_create_info.extent.height, fourcc,
+                                       handles.data(), pitches, offsets, modifiers, &image_data.fb_id,
+                                       DRM_MODE_FB_MODIFIERS);
+   }
+   else
+   {
+      res = drmModeAddFB2(drm_fd, image_create_info.extent.width, image_create_info.extent.height, fourcc,
+                          handles.data(), pitches, offsets, &image_data.fb_id, 0);
+   }
+   if (res != 0)
+   {
+      WSI_LOG_ERROR("Failed to add a framebuffer for the image: %s", strerror(-res));
+      image_data.fb_id = 0;
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   image.status = swapchain_image::FREE;
+
+   assert(image.data != nullptr);
+   auto image_data = static_cast<display_image_data *>(image.data);
+   TRY_LOG(allocate_image(*image_data), "Failed to allocate image");
+   image_status_lock.unlock();
+
+   TRY_LOG(add_framebuffer(image_create_info, *image_data), "Failed to add framebuffer");
+
+   TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
+           "Failed to import memory and bind swapchain image");
+
+   /* Initialize presentation fence. */
+   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   /* Create image_data */
+   auto image_data = m_allocator.create<display_image_data>(1, m_device, m_allocator);
+   if (image_data == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image.data = image_data;
+
+   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      util::vector<wsialloc_format> importable_formats(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+      TRY_LOG_CALL(get_surface_compatible_formats(image_create_info, importable_formats, drm_format_props));
+
+      if (importable_formats.empty())
+      {
+         WSI_LOG_ERROR("No format of the swapchain can be both imported and scanned out.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+
+      wsialloc_format allocated_format = { 0, 0, 0 };
+      TRY_LOG_CALL(allocate_wsialloc(image_create_info, *image_data, importable_formats, &allocated_format, true));
+
+      for (auto &prop : drm_format_props)
+      {
+         if (prop.drmFormatModifier == allocated_format.modifier)
+         {
+            image_data->external_mem.set_num_memories(prop.drmFormatModifierPlaneCount);
+         }
+      }
+
+      TRY_LOG_CALL(fill_image_create_info(
+         image_create_info, m_image_creation_parameters.m_image_layout, m_image_creation_parameters.m_drm_mod_info,
+         m_image_creation_parameters.m_external_info, *image_data, allocated_format.modifier));
+
+      m_image_create_info = image_create_info;
+      m_image_creation_parameters.m_allocated_format = allocated_format;
+   }
+
+   return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+}
+
+void swapchain::present_image(const pending_present_request &pending_present)
+{
+   auto image_data = reinterpret_cast<display_image_data *>(m_swapchain_images[pending_present.image_index].data);
+
+   plane_frame frame{};
+   frame.image_index = pending_present.image_index;
+   frame.fb_id = image_data->fb_id;
+   frame.extent = m_wsi_surface->get_image_extent();
+   if (m_waits_for_in_fence)
+   {
+      auto present_sync_fd = image_data->present_fence.export_sync_fd();
+      if (!present_sync_fd.has_value())
+      {
+         WSI_LOG_ERROR("Failed to export present fence.");
+         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+         unpresent_image(pending_present.image_index);
+         return;
+      }
+      frame.in_fence = std::move(present_sync_fd.value());
+   }
+
+   /* The scheduler gives the image back once another one replaced it on the plane, or if it never got there. */
+   VkResult result = m_scheduler.present(*this, m_wsi_surface->get_plane_index(), std::move(frame));
+   if (result != VK_SUCCESS)
+   {
+      set_error_state(result);
+      return;
+   }
+
+   if (m_device_data.is_present_id_enabled())
+   {
+      auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
+      ext->set_present_id(pending_present.present_id);
+   }
+}
+
+void swapchain::destroy_image(swapchain_image &image)
+{
+   /* The scheduler takes the image status mutex when it gives images back. */
+   m_scheduler.detach(*this);
+
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+
+   if (image.status != swapchain_image::INVALID)
+   {
+      if (image.image != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
+         image.image = VK_NULL_HANDLE;
+      }
+
+      image.status = swapchain_image::INVALID;
+   }
+
+   if (image.data != nullptr)
+   {
+      auto image_data = reinterpret_cast<display_image_data *>(image.data);
+      /* Removing the framebuffer that is scanned out also turns the plane off. */
+      if (image_data->fb_id != 0)
+      {
+         drmModeRmFB(m_display.get_drm_fd(), image_data->fb_id);
+      }
+      m_allocator.destroy(1, image_data);
+      image.data = nullptr;
+   }
+}
+
+VkResult swapchain::get_free_buffer(uint64_t *timeout)
+{
+   int timeout_ms;
+   if (*timeout >= INT_MAX * 1000llu * 1000llu)
+   {
+      timeout_ms = INT_MAX;
+   }
+   else
+   {
+      timeout_ms = static_cast<int>(*timeout / 1000llu / 1000llu);
+   }
+
+   /* Flips are only waited for by presents, an acquire that ran out of images needs the one a flip gives back. */
+   VkResult result = m_scheduler.wait_for_release(*this, timeout_ms);
+   if (result == VK_TIMEOUT)
+   {
+      return *timeout == 0 ? VK_NOT_READY : VK_TIMEOUT;
+   }
+   if (result != VK_SUCCESS)
+   {
+      set_error_state(result);
+   }
+   return result;
+}
+
+VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue queue,
+                                              const queue_submit_semaphores &semaphores, const void *submission_pnext)
+{
+   auto image_data = reinterpret_cast<display_image_data *>(image.data);
+   return image_data->present_fence.set_payload(queue, semaphores, submission_pnext);
+}
+
+VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
+{
+   /* An atomic commit with IN_FENCE_FD makes the display wait for rendering itself. */
+   if (m_waits_for_in_fence)
+   {
+      return VK_SUCCESS;
+   }
+
+   auto image_data = reinterpret_cast<display_image_data *>(image.data);
+   return image_data->present_fence.wait_payload(timeout);
+}
+
+VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
+                                         const VkBindImageMemorySwapchainInfoKHR *bind_sc_info)
+{
+   UNUSED(device);
+   const wsi::swapchain_image &swapchain_image = m_swapchain_images[bind_sc_info->imageIndex];
+   auto image_data = reinterpret_cast<display_image_data *>(swapchain_image.data);
+   return image_data->external_mem.bind_swapchain_image_memory(bind_image_mem_info->image);
+}
+
+} /* namespace display */
+} /* namespace wsi */
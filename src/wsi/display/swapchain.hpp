@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file swapchain.hpp
+ *
+ * @brief Contains the class definition for a swapchain that presents to a KMS plane.
+ */
+
+#pragma once
+
+#include <vulkan/vk_icd.h>
+#include <vulkan/vulkan.h>
+
+#include <wsi/swapchain_base.hpp>
+#include <wsi/external_memory.hpp>
+
+#include "commit_scheduler.hpp"
+#include "drm_display.hpp"
+#include "surface.hpp"
+#include "../layer_utils/wsialloc/wsialloc.h"
+#include "../layer_utils/custom_allocator.hpp"
+
+namespace wsi
+{
+namespace display
+{
+
+struct display_image_data
+{
+   display_image_data(const VkDevice &device, const util::allocator &allocator)
+      : external_mem(device, allocator)
+      , fb_id(0)
+   {
+   }
+
+   external_memory external_mem;
+   /** KMS framebuffer wrapping the image's dmabuf, 0 until it is added. */
+   uint32_t fb_id;
+   sync_fd_fence_sync present_fence;
+};
+
+struct image_creation_parameters
+{
+   wsialloc_format m_allocated_format;
+   util::vector<VkSubresourceLayout> m_image_layout;
+   VkExternalMemoryImageCreateInfoKHR m_external_info;
+   VkImageDrmFormatModifierExplicitCreateInfoEXT m_drm_mod_info;
+
+   image_creation_parameters(wsialloc_format allocated_format, util::allocator allocator,
+                             VkExternalMemoryImageCreateInfoKHR external_info,
+                             VkImageDrmFormatModifierExplicitCreateInfoEXT drm_mod_info)
+      : m_allocated_format(allocated_format)
+      , m_image_layout(allocator)
+      , m_external_info(external_info)
+      , m_drm_mod_info(drm_mod_info)
+   {
+   }
+};
+
+/**
+ * @brief Swapchain that scans its images out on the surface's plane of the display's CRTC.
+ *
+ * Presents run on the page flip thread, and go through the display's @ref commit_scheduler, which commits them
+ * together with those of the swapchains on the other planes. Each present waits until its image is committed, so
+ * images are given back by the flips that later presents or acquires wait for.
+ */
+class swapchain : public wsi::swapchain_base
+{
+public:
+   explicit swapchain(wsi::device_private_data &dev_data, const VkAllocationCallbacks *allocator,
+                      surface &wsi_surface);
+
+   ~swapchain();
+
+   /**
+    * @brief Called by the @ref commit_scheduler once the image at @p image_index is off screen.
+    */
+   void release_image(uint32_t image_index);
+
+protected:
+   /**
+    * @brief Initialize platform specifics.
+    */
+   VkResult init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
+                          bool &use_presentation_thread) override;
+
+   /**
+    * @brief Allocates and binds a new swapchain image.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return Returns VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Creates a new swapchain image.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return If image creation is successful returns VK_SUCCESS, otherwise
+    * will return VK_ERROR_OUT_OF_DEVICE_MEMORY or VK_ERROR_INITIALIZATION_FAILED
+    * depending on the error that occurred.
+    */
+   VkResult create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Method to present and image
+    *
+    * It sends the next image for presentation to the presentation engine.
+    *
+    * @param pending_present Information on the pending present request.
+    */
+   void present_image(const pending_present_request &pending_present) override;
+
+   uint32_t get_metrics_backend() const override
+   {
+      return mali_wrapper::metrics_backend::display;
+   }
+
+   /**
+    * @brief Method to release a swapchain image
+    *
+    * @param image Handle to the image about to be released.
+    */
+   void destroy_image(swapchain_image &image) override;
+
+   /**
+    * @brief Wait for the flip in flight when it gives back one of the swapchain's images.
+    *
+    * @param[in,out] timeout Time to wait in nanoseconds.
+    */
+   VkResult get_free_buffer(uint64_t *timeout) override;
+
+   /**
+    * @brief Sets the present payload for a swapchain image.
+    *
+    * @param[in] image       The swapchain image for which to set a present payload.
+    * @param     queue       A Vulkan queue that can be used for any Vulkan commands needed.
+    * @param[in] sem_payload Array of Vulkan semaphores that constitute the payload.
+    * @param[in] submission_pnext Chain of pointers to attach to the payload submission.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   VkResult image_set_present_payload(swapchain_image &image, VkQueue queue, const queue_submit_semaphores &semaphores,
+                                      const void *submission_pnext) override;
+
+   VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
+
+   /**
+    * @brief Bind image to a swapchain
+    *
+    * @param device              is the logical device that owns the images and memory.
+    * @param bind_image_mem_info details the image we want to bind.
+    * @param bind_sc_info        describes the swapchain memory to bind to.
+    *
+    * @return VK_SUCCESS on success, otherwise on failure VK_ERROR_OUT_OF_HOST_MEMORY or VK_ERROR_OUT_OF_DEVICE_MEMORY
+    * can be returned.
+    */
+   VkResult bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
+                                 const VkBindImageMemorySwapchainInfoKHR *bind_sc_info) override;
+
+private:
+   /**
+    * @brief Wrap the image's dmabuf in a KMS framebuffer.
+    */
+   VkResult add_framebuffer(const VkImageCreateInfo &image_create_info, display_image_data &image_data);
+
+   VkResult allocate_image(display_image_data &image_data);
+   VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, display_image_data &image_data,
+                              util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
+                              bool avoid_allocation);
+
+   /**
+    * @brief Finds what formats are compatible with the requested swapchain image, the Vulkan device and the plane.
+    *
+    * @param      info               The Swapchain image creation info.
+    * @param[out] importable_formats A list of formats that can be imported to the Vulkan Device.
+    * @param[out] drm_format_props   The DRM format modifier properties of the image format.
+    *
+    * @return VK_SUCCESS or VK_ERROR_OUT_OF_HOST_MEMORY
+    */
+   VkResult get_surface_compatible_formats(const VkImageCreateInfo &info,
+                                           util::vector<wsialloc_format> &importable_formats,
+                                           util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props);
+
+   /**
+    * @brief Adds required extensions to the extension list of the swapchain
+    *
+    * @param device Vulkan device
+    * @param swapchain_create_info Swapchain create info
+    * @return VK_SUCCESS on success, other result codes on failure
+    */
+   VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
+
+   /** Raw pointer to the WSI Surface that this swapchain was created from. The Vulkan specification ensures that the
+    * surface is valid until swapchain is destroyed. */
+   surface *m_wsi_surface;
+
+   /** The display of the surface, which outlives the instance. */
+   drm_display &m_display;
+
+   /**
+    * @brief Handle to the WSI allocator.
+    */
+   wsialloc_allocator *m_wsi_allocator;
+
+   /**
+    * @brief Image creation parameters used for all swapchain images.
+    */
+   struct image_creation_parameters m_image_creation_parameters;
+
+   /** Commits the images of the display's swapchains. */
+   commit_scheduler &m_scheduler;
+   /** Whether the plane waits for rendering to finish, so presents need not wait for it. */
+   bool m_waits_for_in_fence;
+};
+
+} /* namespace display */
+} /* namespace wsi */
@@ -54,6 +54,8 @@ VkResult wsi_ext_present_timing::present_timing_queue_set_size(size_t queue_size
       return VK_NOT_READY;
    }
 
+   std::lock_guard<std::mutex> lock(m_queue_mutex);
+
    util::vector<swapchain_presentation_entry> presentation_timing(
       util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE));
    if (!presentation_timing.try_reserve(queue_size))
@@ -78,6 +80,7 @@ size_t wsi_ext_present_timing::present_timing_get_num_outstanding_results()
 {
    size_t num_outstanding = 0;
 
+   std::lock_guard<std::mutex> lock(m_queue_mutex);
    for (const auto &iter : m_queue.m_timings)
    {
       if (iter.is_outstanding)
@@ -90,6 +93,7 @@ size_t wsi_ext_present_timing::present_timing_get_num_outstanding_results()
 
 VkResult wsi_ext_present_timing::add_presentation_entry(const wsi::swapchain_presentation_entry &presentation_entry)
 {
+   std::lock_guard<std::mutex> lock(m_queue_mutex);
    if (!m_queue.m_timings.try_push_back(presentation_entry))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
@@ -97,6 +101,22 @@ VkResult wsi_ext_present_timing::add_presentation_entry(const wsi::swapchain_pre
    return VK_SUCCESS;
 }
 
+void wsi_ext_present_timing::complete_presentation_entry(uint64_t present_id, VkPresentStageFlagsEXT stages,
+                                                         uint64_t stage_time)
+{
+   std::lock_guard<std::mutex> lock(m_queue_mutex);
+   for (auto &entry : m_queue.m_timings)
+   {
+      if (entry.present_id == present_id && !entry.is_complete)
+      {
+         entry.is_complete = true;
+         entry.reported_stages = stages;
+         entry.stage_time = stage_time;
+         return;
+      }
+   }
+}
+
 swapchain_time_domains &wsi_ext_present_timing::get_swapchain_time_domains()
 {
    return m_time_domains;
@@ -36,6 +36,7 @@
 #include "../layer_utils/macros.hpp"
 
 #include <iterator>
+#include <mutex>
 #include <type_traits>
 
 #include "wsi_extension.hpp"
@@ -60,6 +61,18 @@ struct swapchain_presentation_entry
     * The present id.
     */
    uint64_t present_id{ 0 };
+   /**
+    * Whether the presentation engine reported the final result of this present.
+    */
+   bool is_complete{ false };
+   /**
+    * Present stages with a time in @ref stage_time, 0 if the present was discarded or has no timing.
+    */
+   VkPresentStageFlagsEXT reported_stages{ 0 };
+   /**
+    * Time the reported stages were reached, in the time domain the backend registered for them.
+    */
+   uint64_t stage_time{ 0 };
 };
 
 /**
@@ -238,6 +251,18 @@ public:
     */
    VkResult add_presentation_entry(const wsi::swapchain_presentation_entry &sc_presentation_entry);
 
+   /**
+    * @brief Record the result of a present in its presentation entry.
+    *
+    * Completes the oldest entry with @p present_id that is not complete yet. Presents are reported in the order
+    * they were queued, so this also pairs up entries of presents without a present id.
+    *
+    * @param present_id     The present id of the present.
+    * @param stages         Present stages reached at @p stage_time, 0 if the present was discarded.
+    * @param stage_time     Time the stages were reached.
+    */
+   void complete_presentation_entry(uint64_t present_id, VkPresentStageFlagsEXT stages, uint64_t stage_time);
+
    /**
     * @brief Get the swapchain time domains
     */
@@ -261,6 +286,11 @@ protected:
    const util::allocator m_allocator;
 
 private:
+   /**
+    * @brief Protects @ref m_queue, which backends complete from their presentation event handlers.
+    */
+   std::mutex m_queue_mutex;
+
    /**
     * @brief The presentation timing queue.
     */
@@ -60,6 +60,8 @@ VkResult wsi_ext_swapchain_maintenance1::handle_switching_presentation_mode(VkPr
 VkResult wsi_ext_swapchain_maintenance1::handle_swapchain_present_modes_create_info(
    VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info, VkSurfaceKHR surface)
 {
+   m_present_mode = swapchain_create_info->presentMode;
+
    const auto *swapchain_present_modes_create_info = util::find_extension<VkSwapchainPresentModesCreateInfoEXT>(
       VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODES_CREATE_INFO_EXT, swapchain_create_info->pNext);
    if (swapchain_present_modes_create_info != nullptr)
@@ -84,6 +86,14 @@ VkResult wsi_ext_swapchain_maintenance1::handle_swapchain_present_modes_create_i
          m_present_modes[i] = swapchain_present_modes_create_info->pPresentModes[i];
       }
    }
+   else
+   {
+      /* Without the list, VkSwapchainPresentModeInfoEXT may only name the mode the swapchain was created with. */
+      if (!m_present_modes.try_push_back(m_present_mode))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
    return VK_SUCCESS;
 }
 
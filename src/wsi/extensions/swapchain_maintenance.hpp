@@ -96,6 +96,14 @@ public:
    VkResult handle_scaling_create_info(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
                                        const VkSurfaceKHR surface);
 
+   /**
+    * @brief Presentation modes the swapchain may switch between, the create info's mode when none were listed.
+    */
+   const util::vector<VkPresentModeKHR> &get_present_modes() const
+   {
+      return m_present_modes;
+   }
+
 private:
    /**
     * @brief Possible presentation modes this swapchain is allowed to present with VkSwapchainPresentModesCreateInfoEXT
@@ -105,7 +113,7 @@ private:
    /**
     * @brief Present mode currently being used for this swapchain
     */
-   VkPresentModeKHR m_present_mode;
+   VkPresentModeKHR m_present_mode{ VK_PRESENT_MODE_FIFO_KHR };
 };
 
 } /* namespace wsi */
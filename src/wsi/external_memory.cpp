@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022-2024 Arm Limited.
+ * Copyright (c) 2022-2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -35,6 +35,7 @@
 #include "layer_utils/helpers.hpp"
 #include "layer_utils/drm/drm_utils.hpp"
 #include "layer_utils/macros.hpp"
+#include "layer_utils/wsialloc/wsialloc.h"
 
 namespace wsi
 {
@@ -332,6 +333,11 @@ VkResult external_memory::allocate_host_visible_and_bind(const VkImage &image, c
    
    TRY_LOG(device_data.disp.AllocateMemory(m_device, &alloc_info, m_allocator.get_original_callbacks(), &m_host_memory),
            "Failed to allocate host-visible memory");
+
+   VkPhysicalDeviceMemoryProperties2 memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+   device_data.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(device_data.physical_device, &memory_props);
+   m_host_memory_props = memory_props.memoryProperties.memoryTypes[memory_type_index].propertyFlags;
    
    TRY_LOG(device_data.disp.BindImageMemory(m_device, image, m_host_memory, 0),
            "Failed to bind host-visible memory to image");
@@ -389,6 +395,11 @@ const VkSubresourceLayout& external_memory::get_host_layout() const
    return m_host_layout;
 }
 
+VkMemoryPropertyFlags external_memory::get_host_memory_properties() const
+{
+   return m_host_memory_props;
+}
+
 VkResult external_memory::allocate_and_bind_image(const VkImage &image, const VkImageCreateInfo &image_info)
 {
    switch (m_memory_type)
@@ -419,6 +430,7 @@ void external_memory::cleanup_host_visible_memory()
       auto &device_data = wsi::device_private_data::get(m_device);
       device_data.disp.FreeMemory(m_device, m_host_memory, m_allocator.get_original_callbacks());
       m_host_memory = VK_NULL_HANDLE;
+      m_host_memory_props = 0;
    }
 }
 
@@ -452,7 +464,14 @@ void external_memory::cleanup_external_memory()
 
       if (!seen_earlier)
       {
-         close(fd);
+         if (m_release_to_wsialloc)
+         {
+            wsialloc_release(fd);
+         }
+         else
+         {
+            close(fd);
+         }
       }
 
       m_buffer_fds[plane] = -1;
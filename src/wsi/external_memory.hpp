@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022-2024 Arm Limited.
+ * Copyright (c) 2022-2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -94,6 +94,18 @@ public:
       std::copy(buffer_fds, buffer_fds + MAX_PLANES, m_buffer_fds.begin());
    }
 
+   /**
+    * @brief Give the fds back with wsialloc_release() rather than closing them, so wsialloc can reuse the buffers.
+    *
+    * Only for fds of a wsialloc_alloc() without WSIALLOC_ALLOCATE_PROTECTED. Swapchains clear it again before
+    * destroying an image whose buffer the window system has not released, so that a later allocation cannot render
+    * into a buffer that is still scanned out or sampled.
+    */
+   void set_release_to_wsialloc(bool release)
+   {
+      m_release_to_wsialloc = release;
+   }
+
    /**
     * @brief Set the per plane stride values.
     */
@@ -257,6 +269,13 @@ public:
     */
    const VkSubresourceLayout& get_host_layout() const;
 
+   /**
+    * @brief Get the property flags of the memory type backing the host-visible allocation.
+    *
+    * @return Memory property flags, 0 if no host-visible memory has been allocated
+    */
+   VkMemoryPropertyFlags get_host_memory_properties() const;
+
    /**
     * @brief Fills out a list of VkSubresourceLayout for each plane using the stored planes layout data.
     *
@@ -307,12 +326,14 @@ private:
    uint32_t m_num_planes{ 0 };
    uint32_t m_num_memories{ 0 };
    VkExternalMemoryHandleTypeFlagBits m_handle_type{ VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT };
+   bool m_release_to_wsialloc{ false };
 
    wsi_memory_type m_memory_type = wsi_memory_type::EXTERNAL_DMA_BUF;
    
    VkDeviceMemory m_host_memory = VK_NULL_HANDLE;
    void* m_host_mapped_ptr = nullptr;
    VkSubresourceLayout m_host_layout = {};
+   VkMemoryPropertyFlags m_host_memory_props = 0;
    VkMemoryPropertyFlags m_required_props = 0;
    VkMemoryPropertyFlags m_optimal_props = 0;
 
@@ -0,0 +1,793 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Implementation of the asynchronous frame dump.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_dump.hpp"
+#include "layer_utils/macros.hpp"
+#include "utils/logging.hpp"
+
+namespace wsi
+{
+
+namespace
+{
+
+struct frame_dump_config
+{
+   bool enabled = false;
+   std::string path;
+   uint64_t interval = 1;
+   uint64_t ring_bytes = 256ull << 20;
+   uint32_t threads = 2;
+   bool rle = false;
+};
+
+uint64_t read_env_number(const char *name, uint64_t default_value, uint64_t min_value, uint64_t max_value)
+{
+   const char *value = std::getenv(name);
+   if (value == nullptr || value[0] == '\0')
+   {
+      return default_value;
+   }
+
+   char *end = nullptr;
+   errno = 0;
+   const unsigned long long parsed = std::strtoull(value, &end, 10);
+   if (errno != 0 || end == value || *end != '\0' || parsed < min_value || parsed > max_value)
+   {
+      WSI_LOG_WARNING("Ignoring invalid %s='%s'.", name, value);
+      return default_value;
+   }
+   return parsed;
+}
+
+frame_dump_config read_config()
+{
+   frame_dump_config config;
+   const char *value = std::getenv("MALI_WRAPPER_FRAME_DUMP");
+   if (value == nullptr || value[0] == '\0' || std::strcmp(value, "0") == 0)
+   {
+      return config;
+   }
+
+   config.enabled = true;
+   if (std::strcmp(value, "1") == 0)
+   {
+      char path[64];
+      std::snprintf(path, sizeof(path), "/tmp/mali-wrapper-frames-%d.bin", static_cast<int>(getpid()));
+      config.path = path;
+   }
+   else
+   {
+      config.path = value;
+   }
+
+   config.interval = read_env_number("MALI_WRAPPER_FRAME_DUMP_INTERVAL", 1, 1, UINT32_MAX);
+   config.ring_bytes = read_env_number("MALI_WRAPPER_FRAME_DUMP_RING_MB", 256, 1, 1u << 20) << 20;
+   config.threads = static_cast<uint32_t>(read_env_number("MALI_WRAPPER_FRAME_DUMP_THREADS", 2, 1, 8));
+
+   const char *format = std::getenv("MALI_WRAPPER_FRAME_DUMP_FORMAT");
+   if (format != nullptr && std::strcmp(format, "rle") == 0)
+   {
+      config.rle = true;
+   }
+   else if (format != nullptr && format[0] != '\0' && std::strcmp(format, "raw") != 0)
+   {
+      WSI_LOG_WARNING("Ignoring invalid MALI_WRAPPER_FRAME_DUMP_FORMAT='%s'.", format);
+   }
+   return config;
+}
+
+const frame_dump_config &get_config()
+{
+   static const frame_dump_config config = read_config();
+   return config;
+}
+
+uint64_t monotonic_now_ns()
+{
+   timespec ts = {};
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/* Bytes per texel of the swapchain formats that can be dumped, 0 for the others. */
+uint32_t get_texel_size(VkFormat format)
+{
+   switch (format)
+   {
+   case VK_FORMAT_R5G6B5_UNORM_PACK16:
+   case VK_FORMAT_B5G6R5_UNORM_PACK16:
+      return 2;
+   case VK_FORMAT_R8G8B8A8_UNORM:
+   case VK_FORMAT_R8G8B8A8_SRGB:
+   case VK_FORMAT_B8G8R8A8_UNORM:
+   case VK_FORMAT_B8G8R8A8_SRGB:
+   case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+   case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+   case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+   case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+   case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+      return 4;
+   case VK_FORMAT_R16G16B16A16_UNORM:
+   case VK_FORMAT_R16G16B16A16_SFLOAT:
+      return 8;
+   default:
+      return 0;
+   }
+}
+
+/**
+ * Encodes @p count words as FRAME_DUMP_ENCODING_RLE into @p out, which must have room for count + 1 words.
+ *
+ * @return The number of words written, or 0 if the encoding would not be smaller than the input.
+ */
+size_t encode_rle(const uint32_t *in, size_t count, uint32_t *out)
+{
+   constexpr size_t max_packet = 0x7fffffff;
+   size_t written = 0;
+   size_t i = 0;
+   while (i < count)
+   {
+      size_t run = 1;
+      while (i + run < count && run < max_packet && in[i + run] == in[i])
+      {
+         run++;
+      }
+      if (run >= 3)
+      {
+         if (written + 2 >= count)
+         {
+            return 0;
+         }
+         out[written++] = 0x80000000u | static_cast<uint32_t>(run);
+         out[written++] = in[i];
+         i += run;
+         continue;
+      }
+
+      /* Literals up to the next run of three. */
+      size_t literal = 0;
+      while (i + literal < count && literal < max_packet)
+      {
+         if (i + literal + 2 < count && in[i + literal] == in[i + literal + 1] &&
+             in[i + literal] == in[i + literal + 2])
+         {
+            break;
+         }
+         literal++;
+      }
+      if (written + 1 + literal >= count)
+      {
+         return 0;
+      }
+      out[written++] = static_cast<uint32_t>(literal);
+      std::memcpy(out + written, in + i, literal * sizeof(uint32_t));
+      written += literal;
+      i += literal;
+   }
+   return written;
+}
+
+} // namespace
+
+/**
+ * @brief The ring file and the writer threads, shared by all swapchains of the process.
+ */
+class frame_dump_writer
+{
+public:
+   /**
+    * @brief Returns the writer, or nullptr if the ring file could not be created.
+    */
+   static frame_dump_writer *get()
+   {
+      static frame_dump_writer writer;
+      return writer.m_data != nullptr ? &writer : nullptr;
+   }
+
+   /**
+    * @brief Queue the frame in @p slot_index of @p dumper for a writer thread.
+    */
+   void enqueue(frame_dumper &dumper, uint32_t slot_index)
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_jobs_mutex);
+         m_jobs.push_back(job{ &dumper, slot_index });
+      }
+      m_jobs_cond.notify_one();
+   }
+
+   /**
+    * @brief Encode the frame as configured and append it to the ring.
+    *
+    * @param record       Header of the frame, every field but magic, sizes, sequence and encoding filled.
+    * @param pixels       Tightly packed rows of the frame.
+    * @param pixels_size  Size of the frame in bytes.
+    */
+   void write_frame(frame_dump_record record, const void *pixels, size_t pixels_size)
+   {
+      const void *payload = pixels;
+      size_t payload_size = pixels_size;
+      record.encoding = FRAME_DUMP_ENCODING_RAW;
+      if (get_config().rle && pixels_size % sizeof(uint32_t) == 0)
+      {
+         thread_local std::vector<uint32_t> encoded;
+         const size_t words = pixels_size / sizeof(uint32_t);
+         encoded.resize(words + 1);
+         const size_t encoded_words = encode_rle(static_cast<const uint32_t *>(pixels), words, encoded.data());
+         if (encoded_words != 0)
+         {
+            payload = encoded.data();
+            payload_size = encoded_words * sizeof(uint32_t);
+            record.encoding = FRAME_DUMP_ENCODING_RLE;
+         }
+      }
+
+      const uint64_t record_size = (sizeof(frame_dump_record) + payload_size + 7) & ~uint64_t{ 7 };
+      /* Every writer may be filling a record at once; none may be overwritten before it is done. */
+      if (record_size > UINT32_MAX || record_size * (get_config().threads + 1) > m_capacity)
+      {
+         std::lock_guard<std::mutex> lock(m_ring_mutex);
+         if (!m_too_large_logged)
+         {
+            WSI_LOG_WARNING("Frame dump ring of %llu MiB is too small for %llu byte frames, set "
+                            "MALI_WRAPPER_FRAME_DUMP_RING_MB higher.",
+                            static_cast<unsigned long long>(m_capacity >> 20),
+                            static_cast<unsigned long long>(record_size));
+            m_too_large_logged = true;
+         }
+         return;
+      }
+
+      uint64_t offset;
+      uint64_t sequence;
+      frame_dump_record *dst;
+      {
+         std::lock_guard<std::mutex> lock(m_ring_mutex);
+         if (m_head + record_size > m_capacity)
+         {
+            /* Records are 8 byte aligned, so whatever is left holds a wrap marker. */
+            if (m_head < m_capacity)
+            {
+               auto *wrap = reinterpret_cast<frame_dump_record *>(m_data + m_head);
+               __atomic_store_n(&wrap->magic, FRAME_DUMP_WRAP_MAGIC, __ATOMIC_RELEASE);
+            }
+            m_head = 0;
+         }
+         offset = m_head;
+         m_head += record_size;
+         sequence = ++m_sequence;
+
+         dst = reinterpret_cast<frame_dump_record *>(m_data + offset);
+         __atomic_store_n(&dst->sequence, 0, __ATOMIC_RELEASE);
+         dst->record_size = static_cast<uint32_t>(record_size);
+         __atomic_store_n(&dst->magic, FRAME_DUMP_RECORD_MAGIC, __ATOMIC_RELEASE);
+         __atomic_store_n(&m_header->head, m_head, __ATOMIC_RELEASE);
+      }
+
+      dst->swapchain_id = record.swapchain_id;
+      dst->frame_number = record.frame_number;
+      dst->timestamp_ns = record.timestamp_ns;
+      dst->width = record.width;
+      dst->height = record.height;
+      dst->format = record.format;
+      dst->row_pitch = record.row_pitch;
+      dst->encoding = record.encoding;
+      dst->payload_size = static_cast<uint32_t>(payload_size);
+      std::memcpy(dst + 1, payload, payload_size);
+      __atomic_store_n(&dst->sequence, sequence, __ATOMIC_RELEASE);
+      __atomic_fetch_add(&m_header->frames_written, 1, __ATOMIC_RELEASE);
+   }
+
+private:
+   struct job
+   {
+      frame_dumper *dumper;
+      uint32_t slot_index;
+   };
+
+   frame_dump_writer()
+   {
+      const frame_dump_config &config = get_config();
+      const int fd = open(config.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (fd < 0)
+      {
+         WSI_LOG_ERROR("Cannot create the frame dump file %s: %s", config.path.c_str(), strerror(errno));
+         return;
+      }
+
+      /* Reserve the blocks up front: running out of space behind a shared mapping raises SIGBUS. */
+      const size_t map_size = sizeof(frame_dump_file_header) + config.ring_bytes;
+      const int res = posix_fallocate(fd, 0, static_cast<off_t>(map_size));
+      if (res != 0)
+      {
+         WSI_LOG_ERROR("Cannot size the frame dump file %s: %s", config.path.c_str(), strerror(res));
+         close(fd);
+         return;
+      }
+
+      void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (map == MAP_FAILED)
+      {
+         WSI_LOG_ERROR("Cannot map the frame dump file %s: %s", config.path.c_str(), strerror(errno));
+         return;
+      }
+
+      m_map = map;
+      m_map_size = map_size;
+      m_header = static_cast<frame_dump_file_header *>(map);
+      std::memcpy(m_header->magic, "MWFDUMP1", sizeof(m_header->magic));
+      m_header->version = 1;
+      m_header->header_size = sizeof(frame_dump_file_header);
+      m_header->capacity = config.ring_bytes;
+      m_capacity = config.ring_bytes;
+
+      for (uint32_t i = 0; i < config.threads; i++)
+      {
+         m_threads.emplace_back(&frame_dump_writer::worker_main, this);
+      }
+      m_data = static_cast<uint8_t *>(map) + sizeof(frame_dump_file_header);
+
+      WSI_LOG_INFO("Dumping every %llu. presented frame to %s (%llu MiB ring, %s, %u writer thread%s).",
+                   static_cast<unsigned long long>(config.interval), config.path.c_str(),
+                   static_cast<unsigned long long>(config.ring_bytes >> 20), config.rle ? "rle" : "raw",
+                   config.threads, config.threads == 1 ? "" : "s");
+   }
+
+   ~frame_dump_writer()
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_jobs_mutex);
+         m_stop = true;
+      }
+      m_jobs_cond.notify_all();
+      for (auto &thread : m_threads)
+      {
+         thread.join();
+      }
+
+      if (m_map != nullptr)
+      {
+         msync(m_map, m_map_size, MS_ASYNC);
+         munmap(m_map, m_map_size);
+      }
+   }
+
+   void worker_main()
+   {
+      std::unique_lock<std::mutex> lock(m_jobs_mutex);
+      while (true)
+      {
+         m_jobs_cond.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+         if (m_jobs.empty())
+         {
+            return;
+         }
+         const job next = m_jobs.front();
+         m_jobs.pop_front();
+         lock.unlock();
+
+         next.dumper->write_slot(next.slot_index, *this);
+
+         lock.lock();
+      }
+   }
+
+   void *m_map = nullptr;
+   size_t m_map_size = 0;
+   frame_dump_file_header *m_header = nullptr;
+   /** Start of the data area, nullptr if the file could not be created. */
+   uint8_t *m_data = nullptr;
+   uint64_t m_capacity = 0;
+
+   /** Guards the write position, the sequence and the ring's header. */
+   std::mutex m_ring_mutex;
+   uint64_t m_head = 0;
+   uint64_t m_sequence = 0;
+   bool m_too_large_logged = false;
+
+   std::mutex m_jobs_mutex;
+   std::condition_variable m_jobs_cond;
+   std::deque<job> m_jobs;
+   bool m_stop = false;
+   std::vector<std::thread> m_threads;
+};
+
+frame_dumper::frame_dumper(device_private_data &device, const VkAllocationCallbacks *allocation_callbacks)
+   : m_device(device)
+   , m_allocation_callbacks(allocation_callbacks)
+   , m_swapchain_id(0)
+   , m_format(VK_FORMAT_UNDEFINED)
+   , m_extent({ 0, 0 })
+   , m_row_pitch(0)
+   , m_command_pool(VK_NULL_HANDLE)
+   , m_slots()
+   , m_present_count(0)
+   , m_skipped_frames(0)
+   , m_capture_slot(NO_SLOT)
+{
+   if (frame_overlay::is_enabled())
+   {
+      m_overlay = std::make_unique<frame_overlay>("DUMP");
+   }
+}
+
+frame_dumper::~frame_dumper()
+{
+   {
+      std::unique_lock<std::mutex> lock(m_slots_mutex);
+      m_slots_cond.wait(lock, [this] {
+         return std::none_of(m_slots.begin(), m_slots.end(), [](const staging_slot &slot) { return slot.busy; });
+      });
+   }
+
+   for (auto &slot : m_slots)
+   {
+      if (slot.fence != VK_NULL_HANDLE)
+      {
+         m_device.disp.DestroyFence(m_device.device, slot.fence, m_allocation_callbacks);
+      }
+      if (slot.buffer != VK_NULL_HANDLE)
+      {
+         m_device.disp.DestroyBuffer(m_device.device, slot.buffer, m_allocation_callbacks);
+      }
+      if (slot.memory != VK_NULL_HANDLE)
+      {
+         /* Freeing the memory implicitly unmaps it. */
+         m_device.disp.FreeMemory(m_device.device, slot.memory, m_allocation_callbacks);
+      }
+   }
+   if (m_command_pool != VK_NULL_HANDLE)
+   {
+      /* Also frees the command buffers. */
+      m_device.disp.DestroyCommandPool(m_device.device, m_command_pool, m_allocation_callbacks);
+   }
+
+   if (m_skipped_frames != 0)
+   {
+      WSI_LOG_INFO("Frame dump skipped %llu frames of swapchain 0x%llx while the writers were busy.",
+                   static_cast<unsigned long long>(m_skipped_frames), static_cast<unsigned long long>(m_swapchain_id));
+   }
+}
+
+bool frame_dumper::is_enabled()
+{
+   return get_config().enabled;
+}
+
+VkResult frame_dumper::init(uint64_t swapchain_id, VkFormat format, VkExtent2D extent)
+{
+   m_swapchain_id = swapchain_id;
+   m_format = format;
+   m_extent = extent;
+
+   const uint32_t texel_size = get_texel_size(format);
+   if (texel_size == 0)
+   {
+      WSI_LOG_WARNING("Frames of format %d are not dumped.", static_cast<int>(format));
+      return VK_ERROR_FORMAT_NOT_SUPPORTED;
+   }
+   m_row_pitch = extent.width * texel_size;
+
+   /* The copy rides on the present payload, which runs on whichever queue the application presents on. The pool
+    * can only match it when there is a single family. */
+   uint32_t queue_family_count = 0;
+   m_device.instance_data.disp.GetPhysicalDeviceQueueFamilyProperties2KHR(m_device.physical_device,
+                                                                         &queue_family_count, nullptr);
+   if (queue_family_count != 1)
+   {
+      WSI_LOG_WARNING("Frames are not dumped: the present queue family is not known.");
+      return VK_ERROR_FEATURE_NOT_PRESENT;
+   }
+
+   if (frame_dump_writer::get() == nullptr)
+   {
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   VkPhysicalDeviceMemoryProperties2KHR memory_props = {};
+   memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+   m_device.instance_data.disp.GetPhysicalDeviceMemoryProperties2KHR(m_device.physical_device, &memory_props);
+
+   VkCommandPoolCreateInfo pool_info = {};
+   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+   pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+   pool_info.queueFamilyIndex = 0;
+   TRY_LOG(m_device.disp.CreateCommandPool(m_device.device, &pool_info, m_allocation_callbacks, &m_command_pool),
+           "Failed to create frame dump command pool");
+
+   for (auto &slot : m_slots)
+   {
+      VkBufferCreateInfo buffer_info = {};
+      buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_info.size = static_cast<VkDeviceSize>(m_row_pitch) * extent.height;
+      buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      TRY_LOG(m_device.disp.CreateBuffer(m_device.device, &buffer_info, m_allocation_callbacks, &slot.buffer),
+              "Failed to create frame dump buffer");
+
+      VkMemoryRequirements mem_requirements;
+      m_device.disp.GetBufferMemoryRequirements(m_device.device, slot.buffer, &mem_requirements);
+
+      /* The writers read every byte on the CPU; cached memory makes that several times faster. */
+      const VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      const auto &types = memory_props.memoryProperties;
+      uint32_t memory_type_index = types.memoryTypeCount;
+      for (uint32_t i = 0; i < types.memoryTypeCount; i++)
+      {
+         const VkMemoryPropertyFlags flags = types.memoryTypes[i].propertyFlags;
+         if ((mem_requirements.memoryTypeBits & (1u << i)) == 0 || (flags & required) != required)
+         {
+            continue;
+         }
+         if (memory_type_index == types.memoryTypeCount || (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0)
+         {
+            memory_type_index = i;
+         }
+         if ((flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0)
+         {
+            break;
+         }
+      }
+      if (memory_type_index == types.memoryTypeCount)
+      {
+         WSI_LOG_WARNING("Frames are not dumped: no host visible and coherent memory type.");
+         return VK_ERROR_FEATURE_NOT_PRESENT;
+      }
+
+      VkMemoryAllocateInfo alloc_info = {};
+      alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      alloc_info.allocationSize = mem_requirements.size;
+      alloc_info.memoryTypeIndex = memory_type_index;
+      TRY_LOG(m_device.disp.AllocateMemory(m_device.device, &alloc_info, m_allocation_callbacks, &slot.memory),
+              "Failed to allocate frame dump memory");
+      TRY_LOG(m_device.disp.BindBufferMemory(m_device.device, slot.buffer, slot.memory, 0),
+              "Failed to bind frame dump memory");
+      void *pixels = nullptr;
+      TRY_LOG(m_device.disp.MapMemory(m_device.device, slot.memory, 0, VK_WHOLE_SIZE, 0, &pixels),
+              "Failed to map frame dump memory");
+      slot.pixels = pixels;
+
+      VkCommandBufferAllocateInfo cmd_info = {};
+      cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      cmd_info.commandPool = m_command_pool;
+      cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      cmd_info.commandBufferCount = 1;
+      TRY_LOG(m_device.disp.AllocateCommandBuffers(m_device.device, &cmd_info, &slot.command_buffer),
+              "Failed to allocate frame dump command buffer");
+
+      VkFenceCreateInfo fence_info = {};
+      fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+      TRY_LOG(m_device.disp.CreateFence(m_device.device, &fence_info, m_allocation_callbacks, &slot.fence),
+              "Failed to create frame dump fence");
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult frame_dumper::record_copy(VkImage image, staging_slot &slot)
+{
+   TRY(m_device.disp.ResetFences(m_device.device, 1, &slot.fence));
+   TRY(m_device.disp.ResetCommandBuffer(slot.command_buffer, 0));
+
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+   TRY(m_device.disp.BeginCommandBuffer(slot.command_buffer, &begin_info));
+
+   VkImageMemoryBarrier to_transfer = {};
+   to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   to_transfer.srcAccessMask = 0;
+   to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_transfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.image = image;
+   to_transfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+   m_device.disp.CmdPipelineBarrier(slot.command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+   VkBufferImageCopy region = {};
+   region.bufferOffset = 0;
+   region.bufferRowLength = m_extent.width;
+   region.bufferImageHeight = m_extent.height;
+   region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   region.imageExtent = { m_extent.width, m_extent.height, 1 };
+   m_device.disp.CmdCopyImageToBuffer(slot.command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1,
+                                      &region);
+
+   VkImageMemoryBarrier to_present = to_transfer;
+   to_present.srcAccessMask = 0;
+   to_present.dstAccessMask = 0;
+   to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+   VkBufferMemoryBarrier to_host = {};
+   to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+   to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+   to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.buffer = slot.buffer;
+   to_host.offset = 0;
+   to_host.size = VK_WHOLE_SIZE;
+   m_device.disp.CmdPipelineBarrier(slot.command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                    VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                                    &to_host, 1, &to_present);
+
+   return m_device.disp.EndCommandBuffer(slot.command_buffer);
+}
+
+VkCommandBuffer frame_dumper::begin_capture(VkImage image)
+{
+   assert(m_capture_slot == NO_SLOT);
+   const uint64_t frame_number = ++m_present_count;
+   if (m_overlay)
+   {
+      m_overlay->record_present(monotonic_now_ns());
+   }
+   if ((frame_number - 1) % get_config().interval != 0)
+   {
+      return VK_NULL_HANDLE;
+   }
+
+   uint32_t slot_index = NO_SLOT;
+   {
+      std::lock_guard<std::mutex> lock(m_slots_mutex);
+      for (uint32_t i = 0; i < SLOT_COUNT; i++)
+      {
+         if (!m_slots[i].busy)
+         {
+            m_slots[i].busy = true;
+            slot_index = i;
+            break;
+         }
+      }
+   }
+   if (slot_index == NO_SLOT)
+   {
+      m_skipped_frames++;
+      return VK_NULL_HANDLE;
+   }
+
+   staging_slot &slot = m_slots[slot_index];
+   if (record_copy(image, slot) != VK_SUCCESS)
+   {
+      WSI_LOG_WARNING("Failed to record the frame dump copy, skipping the frame.");
+      release_slot(slot_index);
+      return VK_NULL_HANDLE;
+   }
+
+   slot.frame_number = frame_number;
+   slot.timestamp_ns = monotonic_now_ns();
+   m_capture_slot = slot_index;
+   return slot.command_buffer;
+}
+
+void frame_dumper::end_capture(VkQueue queue, VkResult payload_result)
+{
+   const uint32_t slot_index = m_capture_slot;
+   if (slot_index == NO_SLOT)
+   {
+      return;
+   }
+   m_capture_slot = NO_SLOT;
+
+   /* A submission without batches signals its fence once all work submitted to the queue before it is done. */
+   VkResult result = payload_result;
+   if (result == VK_SUCCESS)
+   {
+      result = m_device.disp.QueueSubmit(queue, 0, nullptr, m_slots[slot_index].fence);
+   }
+   if (result != VK_SUCCESS)
+   {
+      release_slot(slot_index);
+      return;
+   }
+
+   frame_dump_writer::get()->enqueue(*this, slot_index);
+}
+
+void frame_dumper::write_slot(uint32_t slot_index, frame_dump_writer &writer)
+{
+   staging_slot &slot = m_slots[slot_index];
+   const VkResult result = m_device.disp.WaitForFences(m_device.device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+   if (result == VK_SUCCESS)
+   {
+      frame_dump_record record = {};
+      record.swapchain_id = m_swapchain_id;
+      record.frame_number = slot.frame_number;
+      record.timestamp_ns = slot.timestamp_ns;
+      record.width = m_extent.width;
+      record.height = m_extent.height;
+      record.format = static_cast<uint32_t>(m_format);
+      record.row_pitch = m_row_pitch;
+      if (m_overlay && frame_overlay::is_visible())
+      {
+         stamp_overlay(slot);
+      }
+      writer.write_frame(record, slot.pixels, static_cast<size_t>(m_row_pitch) * m_extent.height);
+   }
+   else
+   {
+      WSI_LOG_WARNING("Frame dump copy failed: %d", static_cast<int>(result));
+   }
+   release_slot(slot_index);
+}
+
+void frame_dumper::stamp_overlay(staging_slot &slot)
+{
+   bool bgra;
+   switch (m_format)
+   {
+   case VK_FORMAT_B8G8R8A8_UNORM:
+   case VK_FORMAT_B8G8R8A8_SRGB:
+      bgra = true;
+      break;
+   case VK_FORMAT_R8G8B8A8_UNORM:
+   case VK_FORMAT_R8G8B8A8_SRGB:
+      bgra = false;
+      break;
+   default:
+      return;
+   }
+
+   /* The copy is done and the slot is ours until it is released, so the staging memory can be drawn on. */
+   m_overlay->draw(const_cast<void *>(slot.pixels), m_row_pitch, m_extent.width, m_extent.height, bgra);
+}
+
+void frame_dumper::release_slot(uint32_t slot_index)
+{
+   {
+      std::lock_guard<std::mutex> lock(m_slots_mutex);
+      m_slots[slot_index].busy = false;
+   }
+   m_slots_cond.notify_all();
+}
+
+} /* namespace wsi */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Asynchronous dump of presented frames into a memory-mapped ring file.
+ */
+
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <vulkan/vulkan.h>
+
+#include "wsi/frame_overlay.hpp"
+#include "wsi/wsi_private_data.hpp"
+
+namespace wsi
+{
+
+class frame_dump_writer;
+
+/**
+ * @brief Layout of the MALI_WRAPPER_FRAME_DUMP ring file.
+ *
+ * The file is a @ref frame_dump_file_header followed by a data area of @c capacity bytes. Frames are appended to the
+ * data area as records, each a @ref frame_dump_record followed by its payload and padded to 8 bytes. A record that
+ * does not fit before the end of the data area starts again at its beginning, after a wrap marker when there is room
+ * for one, and overwrites the oldest frames. A record's sequence is 0 while it is written and set last, so readers
+ * skip records that are incomplete.
+ */
+struct frame_dump_file_header
+{
+   /** "MWFDUMP1" */
+   char magic[8];
+   uint32_t version;
+   uint32_t header_size;
+   uint64_t capacity;
+   /** Offset into the data area where the next record goes. */
+   uint64_t head;
+   /** Number of frames written, the sequence of the newest record. */
+   uint64_t frames_written;
+};
+
+struct frame_dump_record
+{
+   /** FRAME_DUMP_RECORD_MAGIC, or FRAME_DUMP_WRAP_MAGIC when the next record is at the start of the data area. */
+   uint32_t magic;
+   /** Size of the record including this header and padding. */
+   uint32_t record_size;
+   uint64_t sequence;
+   /** Swapchain the frame was presented on, as on the metrics page. */
+   uint64_t swapchain_id;
+   /** Present the frame is, counting every present of the swapchain from 1. */
+   uint64_t frame_number;
+   /** CLOCK_MONOTONIC time of the present. */
+   uint64_t timestamp_ns;
+   uint32_t width;
+   uint32_t height;
+   /** VkFormat of the pixels, which are tightly packed rows of row_pitch bytes. */
+   uint32_t format;
+   uint32_t row_pitch;
+   /** FRAME_DUMP_ENCODING_RAW or FRAME_DUMP_ENCODING_RLE. */
+   uint32_t encoding;
+   uint32_t payload_size;
+};
+
+constexpr uint32_t FRAME_DUMP_RECORD_MAGIC = 0x5246574d; /* "MWFR" */
+constexpr uint32_t FRAME_DUMP_WRAP_MAGIC = 0x5757464d;   /* "MFWW" */
+constexpr uint32_t FRAME_DUMP_ENCODING_RAW = 0;
+/**
+ * Run-length encoded 32-bit words. Each packet starts with a control word: with bit 31 set, the next word repeats
+ * (control & 0x7fffffff) times; otherwise that many literal words follow.
+ */
+constexpr uint32_t FRAME_DUMP_ENCODING_RLE = 1;
+
+/**
+ * @brief Dumps every Nth presented frame of a swapchain with MALI_WRAPPER_FRAME_DUMP.
+ *
+ * A dumped frame is copied into one of a few host cached staging buffers by a command buffer that rides on its
+ * present payload. A process-wide pool of writer threads waits for the copy and appends the frame to the ring file, so
+ * neither the present nor the page flip thread waits for the GPU, the encoding or the file. When every staging buffer
+ * is still being written, the frame is skipped.
+ */
+class frame_dumper
+{
+public:
+   frame_dumper(device_private_data &device, const VkAllocationCallbacks *allocation_callbacks);
+
+   /**
+    * @brief Waits until the writers are done with the staging buffers, then frees them.
+    */
+   ~frame_dumper();
+
+   frame_dumper(const frame_dumper &) = delete;
+   frame_dumper &operator=(const frame_dumper &) = delete;
+
+   /**
+    * @brief Whether MALI_WRAPPER_FRAME_DUMP is set, so swapchains need VK_IMAGE_USAGE_TRANSFER_SRC_BIT on their
+    * images.
+    */
+   static bool is_enabled();
+
+   /**
+    * @brief Create the staging buffers for the swapchain's images.
+    *
+    * @param swapchain_id Id of the swapchain in the records.
+    * @param format       Format of the swapchain images.
+    * @param extent       Extent of the swapchain images.
+    *
+    * @return VK_SUCCESS, or an error if frames of the swapchain cannot be dumped.
+    */
+   VkResult init(uint64_t swapchain_id, VkFormat format, VkExtent2D extent);
+
+   /**
+    * @brief Count a present and record the copy of its image when it is dumped.
+    *
+    * @param image The presented image, in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR.
+    *
+    * @return The command buffer to submit with the present payload, or VK_NULL_HANDLE if the frame is not dumped.
+    *         Must be followed by @ref end_capture.
+    */
+   VkCommandBuffer begin_capture(VkImage image);
+
+   /**
+    * @brief Hand the frame of the last @ref begin_capture to the writers.
+    *
+    * @param queue          The queue the present payload was submitted to.
+    * @param payload_result Result of submitting the payload with the copy.
+    */
+   void end_capture(VkQueue queue, VkResult payload_result);
+
+private:
+   friend class frame_dump_writer;
+
+   static constexpr uint32_t SLOT_COUNT = 3;
+   static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+   struct staging_slot
+   {
+      VkBuffer buffer = VK_NULL_HANDLE;
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      const void *pixels = nullptr;
+      VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+      /** Signals when the copy is done, submitted right after the payload. */
+      VkFence fence = VK_NULL_HANDLE;
+      /** From begin_capture until a writer released the slot. */
+      bool busy = false;
+      uint64_t frame_number = 0;
+      uint64_t timestamp_ns = 0;
+   };
+
+   VkResult record_copy(VkImage image, staging_slot &slot);
+
+   /**
+    * @brief Called by a writer thread: wait for the copy into the slot and write its frame.
+    */
+   void write_slot(uint32_t slot_index, frame_dump_writer &writer);
+   void release_slot(uint32_t slot_index);
+   /** Draw the overlay into a finished copy of a B8G8R8A8 or R8G8B8A8 frame. */
+   void stamp_overlay(staging_slot &slot);
+
+   device_private_data &m_device;
+   const VkAllocationCallbacks *m_allocation_callbacks;
+   uint64_t m_swapchain_id;
+   VkFormat m_format;
+   VkExtent2D m_extent;
+   uint32_t m_row_pitch;
+   VkCommandPool m_command_pool;
+   std::array<staging_slot, SLOT_COUNT> m_slots;
+   uint64_t m_present_count;
+   uint64_t m_skipped_frames;
+   /** Slot of the begin_capture waiting for its end_capture. */
+   uint32_t m_capture_slot;
+   /** MALI_WRAPPER_OVERLAY, stamped into 32-bit frames by the writer threads. */
+   std::unique_ptr<frame_overlay> m_overlay;
+
+   /** Guards the busy flags, which writer threads clear. */
+   std::mutex m_slots_mutex;
+   std::condition_variable m_slots_cond;
+};
+
+} /* namespace wsi */
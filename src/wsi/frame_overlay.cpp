@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Implementation of the frame-time overlay.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ENABLE_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "frame_overlay.hpp"
+#include "core/copy_engine.hpp"
+#include "utils/logging.hpp"
+
+namespace wsi
+{
+
+namespace
+{
+
+constexpr uint32_t GLYPH_WIDTH = 5;
+constexpr uint32_t GLYPH_HEIGHT = 7;
+/** Every overlay pixel is a SCALE x SCALE block, so the text stays readable on 1080p and larger frames. */
+constexpr uint32_t SCALE = 2;
+constexpr uint32_t MARGIN = 8;
+constexpr uint32_t PADDING = 4;
+constexpr uint32_t LINE_HEIGHT = (GLYPH_HEIGHT + 2) * SCALE;
+constexpr uint32_t TEXT_LINES = 3;
+constexpr uint32_t BAR_WIDTH = 2;
+constexpr uint32_t GRAPH_HEIGHT = 40;
+/** Frame intervals at or above this fill the graph. */
+constexpr uint32_t GRAPH_MAX_US = 50000;
+constexpr uint32_t GRAPH_TARGET_US = 16667;
+constexpr uint64_t COUNTER_WINDOW_NS = 500000000ull;
+
+/* 5x7 glyphs, one byte per row with the leftmost pixel in bit 4. */
+struct glyph
+{
+   char character;
+   uint8_t rows[GLYPH_HEIGHT];
+};
+
+constexpr glyph GLYPHS[] = {
+   { '0', { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e } }, { '1', { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e } },
+   { '2', { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f } }, { '3', { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e } },
+   { '4', { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 } }, { '5', { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e } },
+   { '6', { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e } }, { '7', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+   { '8', { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e } }, { '9', { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c } },
+   { 'A', { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 } }, { 'B', { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e } },
+   { 'C', { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e } }, { 'D', { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c } },
+   { 'E', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f } }, { 'F', { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 } },
+   { 'G', { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f } }, { 'H', { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 } },
+   { 'I', { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e } }, { 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c } },
+   { 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } }, { 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f } },
+   { 'M', { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 } }, { 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+   { 'O', { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } }, { 'P', { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 } },
+   { 'Q', { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d } }, { 'R', { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 } },
+   { 'S', { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e } }, { 'T', { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+   { 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e } }, { 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 } },
+   { 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a } }, { 'X', { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 } },
+   { 'Y', { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 } }, { 'Z', { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f } },
+   { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c } }, { '/', { 0x01, 0x01, 0x02, 0x04, 0x08, 0x10, 0x10 } },
+   { '-', { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 } }, { ':', { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 } },
+};
+
+const uint8_t *find_glyph(char character)
+{
+   if (character >= 'a' && character <= 'z')
+   {
+      character = static_cast<char>(character - 'a' + 'A');
+   }
+   for (const auto &entry : GLYPHS)
+   {
+      if (entry.character == character)
+      {
+         return entry.rows;
+      }
+   }
+   return nullptr;
+}
+
+std::atomic<int> g_overlay_visible{ 0 };
+
+void overlay_toggle_signal_handler(int)
+{
+   g_overlay_visible.fetch_xor(1, std::memory_order_relaxed);
+}
+
+bool read_overlay_env()
+{
+   const char *value = std::getenv("MALI_WRAPPER_OVERLAY");
+   if (value == nullptr || value[0] == '\0' || std::strcmp(value, "0") == 0)
+   {
+      return false;
+   }
+   g_overlay_visible.store(std::strcmp(value, "hidden") == 0 ? 0 : 1, std::memory_order_relaxed);
+
+   int toggle_signal = SIGUSR1;
+   const char *signal_value = std::getenv("MALI_WRAPPER_OVERLAY_SIGNAL");
+   if (signal_value != nullptr && signal_value[0] != '\0')
+   {
+      char *end = nullptr;
+      const long parsed = std::strtol(signal_value, &end, 10);
+      toggle_signal = (end != signal_value && *end == '\0' && parsed >= 0 && parsed < NSIG) ? static_cast<int>(parsed) :
+                                                                                                SIGUSR1;
+   }
+
+   /* Leave the signal alone if the application (or Wine) already uses it. */
+   struct sigaction current = {};
+   if (toggle_signal != 0 && sigaction(toggle_signal, nullptr, &current) == 0 && current.sa_handler == SIG_DFL)
+   {
+      struct sigaction sa = {};
+      sa.sa_handler = overlay_toggle_signal_handler;
+      sigemptyset(&sa.sa_mask);
+      sa.sa_flags = SA_RESTART;
+      sigaction(toggle_signal, &sa, nullptr);
+      WSI_LOG_INFO("Frame overlay enabled; signal %d toggles it.", toggle_signal);
+   }
+   else
+   {
+      WSI_LOG_INFO("Frame overlay enabled; signal %d is in use, so it cannot be toggled.", toggle_signal);
+   }
+   return true;
+}
+
+uint32_t pack_color(uint32_t red, uint32_t green, uint32_t blue, bool bgra)
+{
+   return bgra ? (0xff000000u | (red << 16) | (green << 8) | blue) : (0xff000000u | (blue << 16) | (green << 8) | red);
+}
+
+/** The frame a draw() call writes to, with rectangles clipped to it. */
+struct canvas
+{
+   uint8_t *pixels;
+   size_t stride;
+   uint32_t width;
+   uint32_t height;
+
+   uint32_t *row(uint32_t y) const
+   {
+      return reinterpret_cast<uint32_t *>(pixels + y * stride);
+   }
+
+   bool clip(uint32_t &x, uint32_t &y, uint32_t &w, uint32_t &h) const
+   {
+      if (x >= width || y >= height)
+      {
+         return false;
+      }
+      w = std::min(w, width - x);
+      h = std::min(h, height - y);
+      return w != 0 && h != 0;
+   }
+
+   void fill(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color) const
+   {
+      if (!clip(x, y, w, h))
+      {
+         return;
+      }
+      for (uint32_t line = y; line < y + h; line++)
+      {
+         std::fill_n(row(line) + x, w, color);
+      }
+   }
+
+   /** Halve every channel, so the text and graph read on any background. */
+   void darken(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const
+   {
+      if (!clip(x, y, w, h))
+      {
+         return;
+      }
+      for (uint32_t line = y; line < y + h; line++)
+      {
+         uint32_t *pixel = row(line) + x;
+         uint32_t count = w;
+#ifdef ENABLE_ARM_NEON
+         const uint8x16_t alpha = vreinterpretq_u8_u32(vdupq_n_u32(0xff000000u));
+         for (; count >= 4; count -= 4, pixel += 4)
+         {
+            const uint8x16_t value = vreinterpretq_u8_u32(vld1q_u32(pixel));
+            vst1q_u32(pixel, vreinterpretq_u32_u8(vorrq_u8(vshrq_n_u8(value, 1), alpha)));
+         }
+#endif
+         for (; count > 0; count--, pixel++)
+         {
+            *pixel = ((*pixel >> 1) & 0x7f7f7f7fu) | 0xff000000u;
+         }
+      }
+   }
+
+   void text(uint32_t x, uint32_t y, const char *string, uint32_t color) const
+   {
+      for (; *string != '\0'; string++, x += (GLYPH_WIDTH + 1) * SCALE)
+      {
+         const uint8_t *rows = find_glyph(*string);
+         if (rows == nullptr)
+         {
+            continue;
+         }
+         for (uint32_t glyph_y = 0; glyph_y < GLYPH_HEIGHT; glyph_y++)
+         {
+            for (uint32_t glyph_x = 0; glyph_x < GLYPH_WIDTH; glyph_x++)
+            {
+               if (rows[glyph_y] & (0x10u >> glyph_x))
+               {
+                  fill(x + glyph_x * SCALE, y + glyph_y * SCALE, SCALE, SCALE, color);
+               }
+            }
+         }
+      }
+   }
+};
+
+uint64_t get_copied_bytes()
+{
+   return mali_wrapper::CopyEngine::Instance().GetCopiedBytes();
+}
+
+} // namespace
+
+bool frame_overlay::is_enabled()
+{
+   static const bool enabled = read_overlay_env();
+   return enabled;
+}
+
+bool frame_overlay::is_visible()
+{
+   return is_enabled() && g_overlay_visible.load(std::memory_order_relaxed) != 0;
+}
+
+frame_overlay::frame_overlay(const char *path_name)
+   : m_path_name(path_name)
+   , m_history{}
+   , m_history_head(0)
+   , m_last_present_ns(0)
+   , m_window_start_ns(0)
+   , m_window_start_copied_bytes(0)
+   , m_window_presents(0)
+   , m_window_interval_us(0)
+   , m_present_rate(0.0)
+   , m_frame_ms(0.0)
+   , m_copy_mb_per_s(0.0)
+{
+}
+
+void frame_overlay::set_path(const char *path_name)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   m_path_name = path_name;
+}
+
+void frame_overlay::record_present(uint64_t now_ns)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (m_last_present_ns != 0 && now_ns > m_last_present_ns)
+   {
+      const uint64_t interval_us = (now_ns - m_last_present_ns) / 1000;
+      m_history[m_history_head] = static_cast<uint32_t>(std::min<uint64_t>(interval_us, UINT32_MAX));
+      m_history_head = (m_history_head + 1) % HISTORY_SIZE;
+      m_window_interval_us += interval_us;
+      m_window_presents++;
+   }
+   m_last_present_ns = now_ns;
+   update_counters_locked(now_ns);
+}
+
+void frame_overlay::update_counters_locked(uint64_t now_ns)
+{
+   if (m_window_start_ns == 0)
+   {
+      m_window_start_ns = now_ns;
+      m_window_start_copied_bytes = get_copied_bytes();
+      return;
+   }
+
+   const uint64_t elapsed_ns = now_ns - m_window_start_ns;
+   if (elapsed_ns < COUNTER_WINDOW_NS)
+   {
+      return;
+   }
+
+   const uint64_t copied_bytes = get_copied_bytes();
+   const double elapsed_s = static_cast<double>(elapsed_ns) / 1e9;
+   m_present_rate = m_window_presents / elapsed_s;
+   m_frame_ms = m_window_presents != 0 ? static_cast<double>(m_window_interval_us) / m_window_presents / 1000.0 : 0.0;
+   m_copy_mb_per_s = static_cast<double>(copied_bytes - m_window_start_copied_bytes) / (1024.0 * 1024.0) / elapsed_s;
+
+   m_window_start_ns = now_ns;
+   m_window_start_copied_bytes = copied_bytes;
+   m_window_presents = 0;
+   m_window_interval_us = 0;
+}
+
+void frame_overlay::draw(void *pixels, size_t stride, uint32_t width, uint32_t height, bool bgra)
+{
+   if (pixels == nullptr || !is_visible())
+   {
+      return;
+   }
+
+   char lines[TEXT_LINES][40];
+   std::array<uint32_t, HISTORY_SIZE> history;
+   uint32_t history_head;
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::snprintf(lines[0], sizeof(lines[0]), "%5.1f FPS %5.1f MS", m_present_rate, m_frame_ms);
+      std::snprintf(lines[1], sizeof(lines[1]), "COPY %.0f MB/S", m_copy_mb_per_s);
+      std::snprintf(lines[2], sizeof(lines[2]), "%s", m_path_name != nullptr ? m_path_name : "");
+      history = m_history;
+      history_head = m_history_head;
+   }
+
+   const canvas target{ static_cast<uint8_t *>(pixels), stride, width, height };
+   const uint32_t panel_width = HISTORY_SIZE * BAR_WIDTH + 2 * PADDING;
+   const uint32_t panel_height = TEXT_LINES * LINE_HEIGHT + GRAPH_HEIGHT + 3 * PADDING;
+   target.darken(MARGIN, MARGIN, panel_width, panel_height);
+
+   const uint32_t white = pack_color(0xff, 0xff, 0xff, bgra);
+   for (uint32_t line = 0; line < TEXT_LINES; line++)
+   {
+      target.text(MARGIN + PADDING, MARGIN + PADDING + line * LINE_HEIGHT, lines[line], white);
+   }
+
+   const uint32_t graph_x = MARGIN + PADDING;
+   const uint32_t graph_bottom = MARGIN + 2 * PADDING + TEXT_LINES * LINE_HEIGHT + GRAPH_HEIGHT;
+   const uint32_t green = pack_color(0x40, 0xe0, 0x40, bgra);
+   const uint32_t yellow = pack_color(0xf0, 0xd0, 0x20, bgra);
+   const uint32_t red = pack_color(0xf0, 0x40, 0x30, bgra);
+   for (uint32_t i = 0; i < HISTORY_SIZE; i++)
+   {
+      const uint32_t interval_us = history[(history_head + i) % HISTORY_SIZE];
+      const uint32_t bar_height =
+         static_cast<uint32_t>(static_cast<uint64_t>(std::min(interval_us, GRAPH_MAX_US)) * GRAPH_HEIGHT / GRAPH_MAX_US);
+      const uint32_t color = interval_us <= GRAPH_TARGET_US * 105 / 100 ? green :
+                             interval_us <= GRAPH_TARGET_US * 2 + 1000 ? yellow :
+                                                                         red;
+      target.fill(graph_x + i * BAR_WIDTH, graph_bottom - bar_height, BAR_WIDTH, bar_height, color);
+   }
+
+   /* 60 Hz reference line. */
+   const uint32_t target_y = graph_bottom - GRAPH_TARGET_US * GRAPH_HEIGHT / GRAPH_MAX_US;
+   target.fill(graph_x, target_y, HISTORY_SIZE * BAR_WIDTH, 1, pack_color(0x90, 0x90, 0x90, bgra));
+}
+
+} /* namespace wsi */
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Frame-time overlay stamped into frames the CPU already copies.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace wsi
+{
+
+/**
+ * @brief Small frame-time graph and counters drawn over the top-left corner of a frame.
+ *
+ * Enabled with MALI_WRAPPER_OVERLAY=1, or =hidden to start hidden. MALI_WRAPPER_OVERLAY_SIGNAL (default SIGUSR1, only
+ * when the application left it alone) toggles it at runtime. The overlay is only drawn on paths where the CPU writes
+ * the presented pixels anyway: the X11 SHM presenter and MALI_WRAPPER_FRAME_DUMP frames, which is how headless
+ * swapchains are looked at.
+ */
+class frame_overlay
+{
+public:
+   /**
+    * @brief Whether MALI_WRAPPER_OVERLAY is set. Installs the toggle signal handler on first call.
+    */
+   static bool is_enabled();
+
+   /**
+    * @brief Whether the overlay is currently shown; flipped by the toggle signal.
+    */
+   static bool is_visible();
+
+   /**
+    * @param path_name Present path shown on the overlay; must outlive it.
+    */
+   explicit frame_overlay(const char *path_name);
+
+   frame_overlay(const frame_overlay &) = delete;
+   frame_overlay &operator=(const frame_overlay &) = delete;
+
+   void set_path(const char *path_name);
+
+   /**
+    * @brief Count a present at @p now_ns, CLOCK_MONOTONIC. Called for every present, visible or not.
+    */
+   void record_present(uint64_t now_ns);
+
+   /**
+    * @brief Draw onto 32-bit pixels.
+    *
+    * @param pixels First row of the frame.
+    * @param stride Row pitch in bytes.
+    * @param width  Width of the frame; the overlay is clipped to it.
+    * @param height Height of the frame.
+    * @param bgra   Whether red is the third byte of a pixel (B8G8R8A8/XRGB8888) rather than the first (R8G8B8A8).
+    */
+   void draw(void *pixels, size_t stride, uint32_t width, uint32_t height, bool bgra);
+
+private:
+   static constexpr uint32_t HISTORY_SIZE = 120;
+
+   void update_counters_locked(uint64_t now_ns);
+
+   std::mutex m_mutex;
+   const char *m_path_name;
+   /** Frame intervals in microseconds, oldest first starting at m_history_head. */
+   std::array<uint32_t, HISTORY_SIZE> m_history;
+   uint32_t m_history_head;
+   uint64_t m_last_present_ns;
+
+   /** Counters are refreshed every half second so the text stays readable. */
+   uint64_t m_window_start_ns;
+   uint64_t m_window_start_copied_bytes;
+   uint32_t m_window_presents;
+   uint64_t m_window_interval_us;
+   double m_present_rate;
+   double m_frame_ms;
+   double m_copy_mb_per_s;
+};
+
+} /* namespace wsi */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Implementation of the per-frame timing breakdown.
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "frame_timing.hpp"
+#include "utils/logging.hpp"
+
+namespace wsi
+{
+
+namespace
+{
+
+struct frame_timing_config
+{
+   bool log = false;
+   uint64_t log_interval_ns = 5ull * 1000000000ull;
+};
+
+frame_timing_config read_config()
+{
+   frame_timing_config config;
+   const char *value = std::getenv("MALI_WRAPPER_FRAME_TIMING");
+   config.log = value != nullptr && value[0] != '\0' && std::strcmp(value, "0") != 0;
+
+   const char *interval = std::getenv("MALI_WRAPPER_FRAME_TIMING_INTERVAL");
+   if (interval != nullptr && interval[0] != '\0')
+   {
+      char *end = nullptr;
+      errno = 0;
+      const unsigned long long seconds = std::strtoull(interval, &end, 10);
+      if (errno != 0 || end == interval || *end != '\0' || seconds > 3600)
+      {
+         WSI_LOG_WARNING("Ignoring invalid MALI_WRAPPER_FRAME_TIMING_INTERVAL='%s'.", interval);
+      }
+      else
+      {
+         /* 0 only logs at swapchain destruction. */
+         config.log_interval_ns = seconds * 1000000000ull;
+      }
+   }
+   return config;
+}
+
+const frame_timing_config &get_config()
+{
+   static const frame_timing_config config = read_config();
+   return config;
+}
+
+uint64_t monotonic_now_ns()
+{
+   timespec ts = {};
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+} // namespace
+
+bool frame_timing::is_enabled()
+{
+   return get_config().log || mali_wrapper::MetricsPage::Instance().IsEnabled();
+}
+
+frame_timing::frame_timing(uint64_t swapchain_id)
+   : m_swapchain_id(swapchain_id)
+{
+}
+
+frame_timing::~frame_timing()
+{
+   if (get_config().log && m_lifetime.frames != 0)
+   {
+      log_timing("lifetime", m_lifetime, m_first_frame_id, m_lifetime_max_frame_ids);
+   }
+}
+
+void frame_timing::record(uint32_t stage, uint64_t duration_ns, uint64_t frame_id)
+{
+   if (stage >= frame_stage::count)
+   {
+      return;
+   }
+
+   std::lock_guard<std::mutex> lock(m_mutex);
+   if (duration_ns > m_window.stages[stage].max_ns || m_window.stages[stage].samples == 0)
+   {
+      m_window_max_frame_ids[stage] = frame_id;
+   }
+   if (duration_ns > m_lifetime.stages[stage].max_ns || m_lifetime.stages[stage].samples == 0)
+   {
+      m_lifetime_max_frame_ids[stage] = frame_id;
+   }
+   mali_wrapper::MetricsStageTimingAdd(m_window.stages[stage], duration_ns);
+   mali_wrapper::MetricsStageTimingAdd(m_lifetime.stages[stage], duration_ns);
+}
+
+void frame_timing::end_frame(uint64_t frame_id)
+{
+   const uint64_t now_ns = monotonic_now_ns();
+   std::unique_lock<std::mutex> lock(m_mutex);
+   if (m_lifetime.frames == 0)
+   {
+      m_first_frame_id = frame_id;
+   }
+   if (m_window.frames == 0)
+   {
+      m_window_first_frame_id = frame_id;
+      if (m_window_start_ns == 0)
+      {
+         m_window_start_ns = now_ns;
+      }
+   }
+   m_lifetime.frames++;
+   m_lifetime.last_frame_id = frame_id;
+   m_window.frames++;
+   m_window.last_frame_id = frame_id;
+
+   auto &metrics = mali_wrapper::MetricsPage::Instance();
+   if (metrics.IsEnabled())
+   {
+      metrics.RecordFrameTiming(m_swapchain_id, m_lifetime);
+   }
+
+   const frame_timing_config &config = get_config();
+   if (config.log && config.log_interval_ns != 0 && now_ns - m_window_start_ns >= config.log_interval_ns)
+   {
+      log_timing("window", m_window, m_window_first_frame_id, m_window_max_frame_ids);
+      m_window = {};
+      m_window_start_ns = now_ns;
+   }
+}
+
+void frame_timing::log_timing(const char *label, const mali_wrapper::MetricsFrameTiming &timing,
+                              uint64_t first_frame_id, const uint64_t *max_frame_ids)
+{
+   WSI_LOG_INFO("Frame timing swapchain=0x%llx %s: frames=%llu ids %llu-%llu",
+                static_cast<unsigned long long>(m_swapchain_id), label, static_cast<unsigned long long>(timing.frames),
+                static_cast<unsigned long long>(first_frame_id), static_cast<unsigned long long>(timing.last_frame_id));
+   for (uint32_t stage = 0; stage < frame_stage::count; ++stage)
+   {
+      const mali_wrapper::MetricsStageTiming &stage_timing = timing.stages[stage];
+      if (stage_timing.samples == 0)
+      {
+         continue;
+      }
+      WSI_LOG_INFO("  %-18s n=%llu mean=%.1fus p50=%.1fus p99=%.1fus max=%.1fus (frame %llu)",
+                   mali_wrapper::GetMetricsStageName(stage), static_cast<unsigned long long>(stage_timing.samples),
+                   static_cast<double>(stage_timing.total_ns) / static_cast<double>(stage_timing.samples) / 1e3,
+                   mali_wrapper::MetricsStagePercentileUs(stage_timing, 0.50),
+                   mali_wrapper::MetricsStagePercentileUs(stage_timing, 0.99),
+                   static_cast<double>(stage_timing.max_ns) / 1e3,
+                   static_cast<unsigned long long>(max_frame_ids[stage]));
+   }
+}
+
+} /* namespace wsi */
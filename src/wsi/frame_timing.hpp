@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file
+ *
+ * @brief Per-frame timing breakdown of the present pipeline of a swapchain.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "core/metrics_page.hpp"
+
+namespace wsi
+{
+
+/** Stages of a frame, see MALI_WRAPPER_METRICS_FRAME_STAGES. */
+namespace frame_stage = mali_wrapper::metrics_stage;
+
+/**
+ * @brief Rolling histograms of where the time of each frame of a swapchain goes.
+ *
+ * Enabled by MALI_WRAPPER_FRAME_TIMING, which logs the frames of every MALI_WRAPPER_FRAME_TIMING_INTERVAL seconds
+ * and the whole lifetime when the swapchain is destroyed, or by MALI_WRAPPER_METRICS_PAGE, which gets the lifetime
+ * histograms on every frame. Stages are recorded from any thread.
+ */
+class frame_timing
+{
+public:
+   /**
+    * @brief Whether swapchains should collect frame timings.
+    */
+   static bool is_enabled();
+
+   /**
+    * @param swapchain_id Key of the swapchain in the metrics page and the log.
+    */
+   explicit frame_timing(uint64_t swapchain_id);
+
+   /** Logs the lifetime summary when logging is enabled. */
+   ~frame_timing();
+
+   frame_timing(const frame_timing &) = delete;
+   frame_timing &operator=(const frame_timing &) = delete;
+
+   /**
+    * @brief Account @p duration_ns to @p stage of the frame @p frame_id.
+    *
+    * @p frame_id labels the slowest frame of each stage in the log.
+    */
+   void record(uint32_t stage, uint64_t duration_ns, uint64_t frame_id);
+
+   /**
+    * @brief Called once the presenter is done with the frame @p frame_id.
+    *
+    * Publishes the lifetime histograms and logs the current window when it is due.
+    */
+   void end_frame(uint64_t frame_id);
+
+private:
+   /** Log @p timing, whose slowest frames per stage are @p max_frame_ids. */
+   void log_timing(const char *label, const mali_wrapper::MetricsFrameTiming &timing, uint64_t first_frame_id,
+                   const uint64_t *max_frame_ids);
+
+   uint64_t m_swapchain_id;
+
+   /** Protects the members below. */
+   std::mutex m_mutex;
+   mali_wrapper::MetricsFrameTiming m_lifetime{};
+   uint64_t m_lifetime_max_frame_ids[frame_stage::count]{};
+   uint64_t m_first_frame_id{ 0 };
+
+   /** Frames since the window was last logged. */
+   mali_wrapper::MetricsFrameTiming m_window{};
+   uint64_t m_window_max_frame_ids[frame_stage::count]{};
+   uint64_t m_window_first_frame_id{ 0 };
+   uint64_t m_window_start_ns{ 0 };
+};
+
+} /* namespace wsi */
@@ -0,0 +1,585 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file dmabuf_sink_swapchain.cpp
+ *
+ * @brief Contains the implementation for a headless swapchain that exports its frames as dma-bufs.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <drm_fourcc.h>
+
+#include "dmabuf_sink_swapchain.hpp"
+#include "surface_properties.hpp"
+#include "../layer_utils/drm/drm_utils.hpp"
+#include "../layer_utils/file_descriptor.hpp"
+#include "../layer_utils/format_modifiers.hpp"
+#include "../layer_utils/helpers.hpp"
+#include "../layer_utils/macros.hpp"
+#include "utils/logging.hpp"
+
+#include <wsi/extensions/image_compression_control.hpp>
+#include <wsi/extensions/present_id.hpp>
+#include <wsi/extensions/swapchain_maintenance.hpp>
+
+namespace wsi
+{
+namespace headless
+{
+
+namespace
+{
+/* Streams of the process's swapchains, so a consumer can tell them apart on one socket. */
+std::atomic<uint32_t> g_next_stream_id{ 1 };
+
+bool is_linear_only()
+{
+   static const bool linear_only = []() {
+      const char *value = std::getenv("WSI_HEADLESS_DMABUF_SINK_LINEAR");
+      return value != nullptr && strcmp(value, "1") == 0;
+   }();
+   return linear_only;
+}
+} // namespace
+
+dmabuf_sink_swapchain::dmabuf_sink_swapchain(wsi::device_private_data &dev_data,
+                                             const VkAllocationCallbacks *pAllocator)
+   : wsi::swapchain_base(dev_data, pAllocator)
+   , m_wsi_allocator(nullptr)
+   , m_allocated_format({ 0, 0, 0 })
+   , m_image_layout(m_allocator)
+   , m_external_info({})
+   , m_drm_mod_info({})
+   , m_stream_id(g_next_stream_id.fetch_add(1))
+   , m_send_failure_logged(false)
+{
+   m_image_create_info.format = VK_FORMAT_UNDEFINED;
+}
+
+dmabuf_sink_swapchain::~dmabuf_sink_swapchain()
+{
+   if (m_sink)
+   {
+      m_sink->stop_stream(m_stream_id);
+      /* Joins the feedback reader, which may be waiting for m_pending_mutex to release images. */
+      m_sink.reset();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_pending_mutex);
+      while (auto sent = m_sent_images.pop_front())
+      {
+         unpresent_image(sent->image_index);
+      }
+   }
+
+   /* Call the base's teardown */
+   teardown();
+
+   if (m_wsi_allocator != nullptr)
+   {
+      wsialloc_delete(m_wsi_allocator);
+   }
+   m_wsi_allocator = nullptr;
+}
+
+VkResult dmabuf_sink_swapchain::add_required_extensions(VkDevice device,
+                                                        const VkSwapchainCreateInfoKHR *swapchain_create_info)
+{
+   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info);
+   if (compression_control)
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_image_compression_control>(*compression_control)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.is_present_id_enabled())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_present_id>()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.is_swapchain_maintenance1_enabled())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_swapchain_maintenance1>(m_allocator)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   if (m_device_data.should_layer_handle_frame_boundary_events())
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_frame_boundary>(m_device_data)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   return VK_SUCCESS;
+}
+
+VkResult dmabuf_sink_swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
+                                              bool &use_presentation_thread)
+{
+   UNUSED(device);
+
+   const char *socket_path = surface_properties::get_dmabuf_sink();
+   assert(socket_path != nullptr);
+   m_sink = std::make_unique<x11::xwayland_dmabuf_bridge_client>(std::string(socket_path));
+   m_sink->set_feedback_callback([this](uint32_t frame_id, bool displayed, uint64_t frame_time_ns) {
+      UNUSED(frame_time_ns);
+      std::lock_guard<std::mutex> lock(m_pending_mutex);
+      release_sent_images(frame_id, displayed);
+   });
+
+   WSIALLOC_ASSERT_VERSION();
+   if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_ERROR("Failed to create wsi allocator.");
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   /* Sending a frame may wait for the consumer, which must not block vkQueuePresentKHR. */
+   use_presentation_thread = swapchain_create_info->presentMode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR;
+
+   WSI_LOG_INFO("Headless swapchain exports its frames to the dma-buf sink at %s as stream %u", socket_path,
+                m_stream_id);
+   return VK_SUCCESS;
+}
+
+VkResult dmabuf_sink_swapchain::get_surface_compatible_formats(
+   const VkImageCreateInfo &info, util::vector<wsialloc_format> &importable_formats,
+   util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props)
+{
+   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
+           "Failed to get format properties");
+
+   const uint32_t fourcc = util::drm::vk_to_drm_format(info.format);
+   if (fourcc == 0)
+   {
+      return VK_SUCCESS;
+   }
+
+   for (const auto &prop : drm_format_props)
+   {
+      if (is_linear_only() && prop.drmFormatModifier != DRM_FORMAT_MOD_LINEAR)
+      {
+         continue;
+      }
+
+      const VkImageCompressionControlEXT *compression_control = nullptr;
+      VkImageCompressionControlEXT compression_properties = {};
+      if (m_device_data.is_swapchain_compression_control_enabled())
+      {
+         auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+         if (ext)
+         {
+            compression_properties = ext->get_compression_control_properties();
+            compression_control = &compression_properties;
+         }
+      }
+
+      const util::drm_modifier_image_support support = util::get_drm_modifier_image_support(
+         m_device_data.physical_device, info, prop.drmFormatModifier, compression_control);
+      if (!support.supported)
+      {
+         continue;
+      }
+      if (support.image_format_properties.maxExtent.width < info.extent.width ||
+          support.image_format_properties.maxExtent.height < info.extent.height ||
+          support.image_format_properties.maxExtent.depth < info.extent.depth)
+      {
+         continue;
+      }
+      if (support.image_format_properties.maxMipLevels < info.mipLevels ||
+          support.image_format_properties.maxArrayLayers < info.arrayLayers)
+      {
+         continue;
+      }
+      if ((support.image_format_properties.sampleCounts & info.samples) != info.samples)
+      {
+         continue;
+      }
+
+      if (support.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      {
+         uint64_t flags =
+            (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
+         wsialloc_format import_format{ fourcc, prop.drmFormatModifier, flags };
+         if (!importable_formats.try_push_back(import_format))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+   }
+
+   util::save_drm_modifier_image_support(m_device_data.physical_device);
+   util::apply_afbc_policy(importable_formats, is_compression_allowed());
+
+   return VK_SUCCESS;
+}
+
+VkResult dmabuf_sink_swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, sink_image_data &image_data,
+                                                  util::vector<wsialloc_format> &importable_formats,
+                                                  wsialloc_format *allocated_format, bool avoid_allocation)
+{
+   bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
+   uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
+   if (avoid_allocation)
+   {
+      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
+   }
+
+   if (m_device_data.is_swapchain_compression_control_enabled())
+   {
+      auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+      if (ext)
+      {
+         if (ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)
+         {
+            allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
+         }
+      }
+   }
+
+   wsialloc_allocate_info alloc_info = { importable_formats.data(), static_cast<unsigned>(importable_formats.size()),
+                                         image_create_info.extent.width, image_create_info.extent.height,
+                                         allocation_flags };
+
+   wsialloc_allocate_result alloc_result = { {}, { 0 }, { 0 }, { -1 }, false };
+   /* Clear buffer_fds and average_row_strides for error purposes */
+   for (int i = 0; i < WSIALLOC_MAX_PLANES; ++i)
+   {
+      alloc_result.buffer_fds[i] = -1;
+      alloc_result.average_row_strides[i] = -1;
+   }
+   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   if (res != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
+      if (res == WSIALLOC_ERROR_NOT_SUPPORTED)
+      {
+         return VK_ERROR_FORMAT_NOT_SUPPORTED;
+      }
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   *allocated_format = alloc_result.format;
+   auto &external_memory = image_data.external_mem;
+   external_memory.set_strides(alloc_result.average_row_strides);
+   external_memory.set_buffer_fds(alloc_result.buffer_fds);
+   external_memory.set_offsets(alloc_result.offsets);
+
+   uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
+
+   if (!avoid_allocation)
+   {
+      uint32_t num_memory_planes = 0;
+
+      for (uint32_t i = 0; i < num_planes; ++i)
+      {
+         auto it = std::find(std::begin(alloc_result.buffer_fds) + i + 1, std::end(alloc_result.buffer_fds),
+                             alloc_result.buffer_fds[i]);
+         if (it == std::end(alloc_result.buffer_fds))
+         {
+            num_memory_planes++;
+         }
+      }
+
+      assert(alloc_result.is_disjoint == (num_memory_planes > 1));
+      external_memory.set_num_memories(num_memory_planes);
+      external_memory.set_release_to_wsialloc(!is_protected_memory);
+   }
+
+   external_memory.set_format_info(alloc_result.is_disjoint, num_planes);
+   external_memory.set_memory_handle_type(VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT);
+   return VK_SUCCESS;
+}
+
+static VkResult fill_image_create_info(VkImageCreateInfo &image_create_info,
+                                       util::vector<VkSubresourceLayout> &image_plane_layouts,
+                                       VkImageDrmFormatModifierExplicitCreateInfoEXT &drm_mod_info,
+                                       VkExternalMemoryImageCreateInfoKHR &external_info, sink_image_data &image_data,
+                                       uint64_t modifier)
+{
+   TRY_LOG_CALL(image_data.external_mem.fill_image_plane_layouts(image_plane_layouts));
+
+   if (image_data.external_mem.is_disjoint())
+   {
+      image_create_info.flags |= VK_IMAGE_CREATE_DISJOINT_BIT;
+   }
+
+   image_data.external_mem.fill_drm_mod_info(image_create_info.pNext, drm_mod_info, image_plane_layouts, modifier);
+   image_data.external_mem.fill_external_info(external_info, &drm_mod_info);
+   image_create_info.pNext = &external_info;
+   image_create_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+   return VK_SUCCESS;
+}
+
+VkResult dmabuf_sink_swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info,
+                                                                  swapchain_image &image)
+{
+   UNUSED(image_create_info);
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   image.status = swapchain_image::FREE;
+
+   assert(image.data != nullptr);
+   auto image_data = static_cast<sink_image_data *>(image.data);
+
+   util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   if (!importable_formats.try_push_back(m_allocated_format))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   TRY_LOG(allocate_wsialloc(m_image_create_info, *image_data, importable_formats, &m_allocated_format, false),
+           "Failed to allocate image");
+   image_status_lock.unlock();
+
+   TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
+           "Failed to import memory and bind swapchain image");
+
+   /* Initialize presentation fence. */
+   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+
+   return VK_SUCCESS;
+}
+
+VkResult dmabuf_sink_swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   /* Create image_data */
+   auto image_data = m_allocator.create<sink_image_data>(1, m_device, m_allocator);
+   if (image_data == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image.data = image_data;
+
+   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      util::vector<wsialloc_format> importable_formats(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+      TRY_LOG_CALL(get_surface_compatible_formats(image_create_info, importable_formats, drm_format_props));
+
+      if (importable_formats.empty())
+      {
+         WSI_LOG_ERROR("No modifier of the swapchain format can be exported as a dma-buf.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+
+      wsialloc_format allocated_format = { 0, 0, 0 };
+      TRY_LOG_CALL(allocate_wsialloc(image_create_info, *image_data, importable_formats, &allocated_format, true));
+
+      for (auto &prop : drm_format_props)
+      {
+         if (prop.drmFormatModifier == allocated_format.modifier)
+         {
+            image_data->external_mem.set_num_memories(prop.drmFormatModifierPlaneCount);
+         }
+      }
+
+      TRY_LOG_CALL(fill_image_create_info(image_create_info, m_image_layout, m_drm_mod_info, m_external_info,
+                                          *image_data, allocated_format.modifier));
+
+      m_image_create_info = image_create_info;
+      m_allocated_format = allocated_format;
+   }
+
+   return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+}
+
+void dmabuf_sink_swapchain::release_sent_images(uint32_t frame_id, bool displayed)
+{
+   /* Frames sent before the acknowledged one have been replaced by the consumer. */
+   while (m_sent_images.size() != 0)
+   {
+      const sent_image sent = *m_sent_images.front();
+      const int32_t age = static_cast<int32_t>(frame_id - sent.frame_id);
+      if (age < 0 || (age == 0 && displayed))
+      {
+         break;
+      }
+      m_sent_images.pop_front();
+      unpresent_image(sent.image_index);
+   }
+}
+
+void dmabuf_sink_swapchain::present_image(const pending_present_request &pending_present)
+{
+   auto image_data = reinterpret_cast<sink_image_data *>(m_swapchain_images[pending_present.image_index].data);
+   auto &external_mem = image_data->external_mem;
+
+   /* image_wait_present() skipped the render fence; the consumer waits for it instead. */
+   util::fd_owner acquire_fence;
+   if (m_sink->is_acquire_fence_supported())
+   {
+      auto present_sync_fd = image_data->present_fence.export_sync_fd();
+      if (present_sync_fd.has_value())
+      {
+         acquire_fence = std::move(present_sync_fd.value());
+      }
+      else
+      {
+         WSI_LOG_WARNING("Failed to export the present fence, waiting for it instead.");
+      }
+   }
+   /* Returns at once when the fence was exported or already waited for. */
+   image_data->present_fence.wait_payload(UINT64_MAX);
+
+   const auto &offsets = external_mem.get_offsets();
+   const auto &strides = external_mem.get_strides();
+   const auto &fds = external_mem.get_buffer_fds();
+   uint32_t frame_id = 0;
+   const bool sent = m_sink->present_frame(
+      m_stream_id, m_image_create_info.extent.width, m_image_create_info.extent.height, m_allocated_format.fourcc,
+      m_allocated_format.modifier, external_mem.get_num_planes(), offsets.data(), strides.data(), fds.data(),
+      &frame_id, &image_data->buffer_id, acquire_fence.is_valid() ? acquire_fence.get() : -1);
+
+   if (m_device_data.is_present_id_enabled())
+   {
+      auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
+      ext->set_present_id(pending_present.present_id);
+   }
+
+   if (!sent)
+   {
+      /* Without a consumer frames are dropped, so the application keeps running until one connects to a new
+       * swapchain. */
+      if (!m_send_failure_logged)
+      {
+         WSI_LOG_WARNING("Dropping frames of stream %u, the dma-buf sink did not take them.", m_stream_id);
+         m_send_failure_logged = true;
+      }
+      unpresent_image(pending_present.image_index);
+      return;
+   }
+   m_send_failure_logged = false;
+
+   if (m_present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
+       m_present_mode == VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      /* The application keeps rendering into a shared image anyway. */
+      unpresent_image(pending_present.image_index);
+      return;
+   }
+
+   /* The feedback reader takes the image status mutex under this one. Presents without the page flip thread hold
+    * it already, but those are shared demand refresh presents, which returned above. */
+   std::lock_guard<std::mutex> lock(m_pending_mutex);
+   /* Holds every image, so there is always room for the one just sent. */
+   const bool queued = m_sent_images.push_back(sent_image{ pending_present.image_index, frame_id });
+   assert(queued);
+   UNUSED(queued);
+
+   /* With feedback, images go as soon as a later frame is acknowledged; the lag stays as an upper bound so a silent
+    * consumer cannot starve acquire. */
+   const size_t release_lag_frames = (m_swapchain_images.size() > 1) ? (m_swapchain_images.size() - 1) : 1u;
+   while (m_sent_images.size() > release_lag_frames)
+   {
+      unpresent_image(m_sent_images.pop_front()->image_index);
+   }
+}
+
+void dmabuf_sink_swapchain::destroy_image(wsi::swapchain_image &image)
+{
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+
+   /* The sink may still read a buffer it has not given back; unregistering it does not wait for that. */
+   if (image.data != nullptr &&
+       (image.status == swapchain_image::PENDING || image.status == swapchain_image::PRESENTED))
+   {
+      reinterpret_cast<sink_image_data *>(image.data)->external_mem.set_release_to_wsialloc(false);
+   }
+
+   if (image.status != swapchain_image::INVALID)
+   {
+      if (image.image != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.DestroyImage(m_device, image.image, get_allocation_callbacks());
+         image.image = VK_NULL_HANDLE;
+      }
+
+      image.status = swapchain_image::INVALID;
+   }
+
+   if (image.data != nullptr)
+   {
+      auto image_data = reinterpret_cast<sink_image_data *>(image.data);
+      if (m_sink && image_data->buffer_id != 0)
+      {
+         m_sink->unregister_buffer(image_data->buffer_id);
+      }
+      m_allocator.destroy(1, image_data);
+      image.data = nullptr;
+   }
+}
+
+VkResult dmabuf_sink_swapchain::image_set_present_payload(swapchain_image &image, VkQueue queue,
+                                                          const queue_submit_semaphores &semaphores,
+                                                          const void *submission_pnext)
+{
+   auto image_data = reinterpret_cast<sink_image_data *>(image.data);
+   return image_data->present_fence.set_payload(queue, semaphores, submission_pnext);
+}
+
+VkResult dmabuf_sink_swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
+{
+   /* The consumer waits for the acquire fence itself. */
+   if (m_sink && m_sink->is_acquire_fence_supported())
+   {
+      return VK_SUCCESS;
+   }
+
+   auto image_data = reinterpret_cast<sink_image_data *>(image.data);
+   return image_data->present_fence.wait_payload(timeout);
+}
+
+VkResult dmabuf_sink_swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
+                                                     const VkBindImageMemorySwapchainInfoKHR *bind_sc_info)
+{
+   UNUSED(device);
+   const wsi::swapchain_image &swapchain_image = m_swapchain_images[bind_sc_info->imageIndex];
+   auto image_data = reinterpret_cast<sink_image_data *>(swapchain_image.data);
+   return image_data->external_mem.bind_swapchain_image_memory(bind_image_mem_info->image);
+}
+
+} /* namespace headless */
+} /* namespace wsi */
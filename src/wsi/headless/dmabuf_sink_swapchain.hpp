@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file dmabuf_sink_swapchain.hpp
+ *
+ * @brief Contains the class definition for a headless swapchain that exports its frames as dma-bufs.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include <vulkan/vk_icd.h>
+#include <vulkan/vulkan.h>
+
+#include <wsi/swapchain_base.hpp>
+#include <wsi/external_memory.hpp>
+#include <wsi/surface_properties.hpp>
+
+#include "../layer_utils/custom_allocator.hpp"
+#include "../layer_utils/ring_buffer.hpp"
+#include "../layer_utils/wsialloc/wsialloc.h"
+#include "../x11/xwayland_dmabuf_bridge.hpp"
+
+namespace wsi
+{
+namespace headless
+{
+
+struct sink_image_data
+{
+   sink_image_data(const VkDevice &device, const util::allocator &allocator)
+      : external_mem(device, allocator)
+      , buffer_id(0)
+   {
+   }
+
+   external_memory external_mem;
+   sync_fd_fence_sync present_fence;
+   /** Registration of the dmabuf with the consumer, 0 until the first frame sends it. */
+   uint32_t buffer_id;
+};
+
+/**
+ * @brief Headless swapchain that hands every presented image to a consumer process, such as a hardware video
+ * encoder, without copying it.
+ *
+ * Selected with WSI_HEADLESS_DMABUF_SINK=<socket path>. Images are wsialloc dma-bufs. Each present sends the
+ * dmabuf fds, layout and a sync_file of the rendering fence over the unix socket, in the packets of the Xwayland
+ * dmabuf bridge protocol, so any bridge server can consume them. An image is given back once the consumer
+ * acknowledged a later frame, or after the other images were presented when it sends no feedback.
+ */
+class dmabuf_sink_swapchain : public wsi::swapchain_base
+{
+public:
+   explicit dmabuf_sink_swapchain(wsi::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator);
+
+   ~dmabuf_sink_swapchain();
+
+protected:
+   /**
+    * @brief Platform specific init
+    */
+   VkResult init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
+                          bool &use_presentation_thread) override;
+
+   /**
+    * @brief Allocates and binds a new swapchain image.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return Returns VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Creates a new swapchain image.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return If image creation is successful returns VK_SUCCESS, otherwise
+    * will return VK_ERROR_OUT_OF_DEVICE_MEMORY or VK_ERROR_INITIALIZATION_FAILED
+    * depending on the error that occurred.
+    */
+   VkResult create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Send the image to the consumer.
+    *
+    * @param pending_present Information on the pending present request.
+    */
+   void present_image(const pending_present_request &pending_present) override;
+
+   uint32_t get_metrics_backend() const override
+   {
+      return mali_wrapper::metrics_backend::headless;
+   }
+
+   /**
+    * @brief Method to release a swapchain image
+    *
+    * @param image Handle to the image about to be released.
+    */
+   void destroy_image(wsi::swapchain_image &image) override;
+
+   /**
+    * @brief Sets the present payload for a swapchain image.
+    *
+    * @param[in] image       The swapchain image for which to set a present payload.
+    * @param     queue       A Vulkan queue that can be used for any Vulkan commands needed.
+    * @param[in] sem_payload Array of Vulkan semaphores that constitute the payload.
+    * @param[in] submission_pnext Chain of pointers to attach to the payload submission.
+    *
+    * @return VK_SUCCESS on success or an error code otherwise.
+    */
+   VkResult image_set_present_payload(swapchain_image &image, VkQueue queue, const queue_submit_semaphores &semaphores,
+                                      const void *submission_pnext) override;
+
+   VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
+
+   /**
+    * @brief Bind image to a swapchain
+    *
+    * @param device              is the logical device that owns the images and memory.
+    * @param bind_image_mem_info details the image we want to bind.
+    * @param bind_sc_info        describes the swapchain memory to bind to.
+    *
+    * @return VK_SUCCESS on success, otherwise on failure VK_ERROR_OUT_OF_HOST_MEMORY or VK_ERROR_OUT_OF_DEVICE_MEMORY
+    * can be returned.
+    */
+   VkResult bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
+                                 const VkBindImageMemorySwapchainInfoKHR *bind_sc_info) override;
+
+private:
+   VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, sink_image_data &image_data,
+                              util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
+                              bool avoid_allocation);
+
+   /**
+    * @brief Finds what formats are compatible with the requested swapchain image and can be exported as dma-bufs.
+    *
+    * @param      info               The Swapchain image creation info.
+    * @param[out] importable_formats A list of formats that can be imported to the Vulkan Device.
+    * @param[out] drm_format_props   The DRM format modifier properties of the image format.
+    *
+    * @return VK_SUCCESS or VK_ERROR_OUT_OF_HOST_MEMORY
+    */
+   VkResult get_surface_compatible_formats(const VkImageCreateInfo &info,
+                                           util::vector<wsialloc_format> &importable_formats,
+                                           util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props);
+
+   /**
+    * @brief Give back the images of the frames the consumer is done with. Called with m_pending_mutex held.
+    *
+    * @param frame_id  The frame the consumer acknowledged.
+    * @param displayed Whether the consumer took the frame; if not, its image is done with too.
+    */
+   void release_sent_images(uint32_t frame_id, bool displayed);
+
+   /**
+    * @brief Adds required extensions to the extension list of the swapchain
+    *
+    * @param device Vulkan device
+    * @param swapchain_create_info Swapchain create info
+    * @return VK_SUCCESS on success, other result codes on failure
+    */
+   VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
+
+   /** Handle to the WSI allocator. */
+   wsialloc_allocator *m_wsi_allocator;
+
+   /** Format and layout all images are allocated with, chosen with the first image. */
+   wsialloc_format m_allocated_format;
+   util::vector<VkSubresourceLayout> m_image_layout;
+   VkExternalMemoryImageCreateInfoKHR m_external_info;
+   VkImageDrmFormatModifierExplicitCreateInfoEXT m_drm_mod_info;
+
+   /** Connection to the consumer. */
+   std::unique_ptr<x11::xwayland_dmabuf_bridge_client> m_sink;
+   /** Stream of this swapchain's frames, in the window field of the packets. */
+   uint32_t m_stream_id;
+
+   /**
+    * @brief An image sent to the consumer, kept from the application until the consumer is done with it.
+    */
+   struct sent_image
+   {
+      uint32_t image_index;
+      uint32_t frame_id;
+   };
+   /** Guards m_sent_images, which the present thread and the sink's feedback reader update. */
+   std::mutex m_pending_mutex;
+   util::ring_buffer<sent_image, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT> m_sent_images;
+   /** Whether a failed send was logged, so a consumer that went away does not flood the log. */
+   bool m_send_failure_logged;
+};
+
+} /* namespace headless */
+} /* namespace wsi */
@@ -28,6 +28,7 @@
 
 #include "surface.hpp"
 #include "swapchain.hpp"
+#include "dmabuf_sink_swapchain.hpp"
 #include "surface_properties.hpp"
 
 namespace wsi
@@ -44,6 +45,10 @@ util::unique_ptr<swapchain_base> surface::allocate_swapchain(wsi::device_private
                                                              const VkAllocationCallbacks *allocator)
 {
    util::allocator alloc{ dev_data.get_allocator(), VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, allocator };
+   if (surface_properties::get_dmabuf_sink() != nullptr)
+   {
+      return util::unique_ptr<swapchain_base>(alloc.make_unique<dmabuf_sink_swapchain>(dev_data, allocator));
+   }
    return util::unique_ptr<swapchain_base>(alloc.make_unique<swapchain>(dev_data, allocator));
 }
 
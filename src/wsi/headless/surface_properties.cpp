@@ -75,10 +75,33 @@ surface_properties &surface_properties::get_instance()
    return instance;
 }
 
+bool surface_properties::is_unthrottled()
+{
+   static const bool unthrottled = []() {
+      const char *value = std::getenv("WSI_HEADLESS_UNTHROTTLED");
+      return value != nullptr && strcmp(value, "1") == 0 && get_dmabuf_sink() == nullptr;
+   }();
+   return unthrottled;
+}
+
+const char *surface_properties::get_dmabuf_sink()
+{
+   static const char *const socket_path = []() -> const char * {
+      const char *value = std::getenv("WSI_HEADLESS_DMABUF_SINK");
+      return (value != nullptr && value[0] != '\0') ? value : nullptr;
+   }();
+   return socket_path;
+}
+
 VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_device,
                                                       VkSurfaceCapabilitiesKHR *surface_capabilities)
 {
    get_surface_capabilities_common(physical_device, surface_capabilities);
+   if (is_unthrottled())
+   {
+      /* No page flip thread queue bounds the images in flight. */
+      surface_capabilities->maxImageCount = 0;
+   }
    return VK_SUCCESS;
 }
 
@@ -87,7 +110,7 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
                                                       VkSurfaceCapabilities2KHR *surface_capabilities)
 {
    TRY(check_surface_present_mode_query_is_supported(surface_info, m_supported_modes));
-   get_surface_capabilities_common(physical_device, &surface_capabilities->surfaceCapabilities);
+   TRY(get_surface_capabilities(physical_device, &surface_capabilities->surfaceCapabilities));
    m_compatible_present_modes.get_surface_present_mode_compatibility_common(surface_info, surface_capabilities);
 
    auto surface_scaling_capabilities = util::find_extension<VkSurfacePresentScalingCapabilitiesEXT>(
@@ -184,12 +207,37 @@ PFN_vkVoidFunction surface_properties::get_proc_addr(const char *name)
    return nullptr;
 }
 
+VkResult surface_properties::get_required_device_extensions(util::extension_list &extension_list)
+{
+   if (get_dmabuf_sink() == nullptr)
+   {
+      return VK_SUCCESS;
+   }
+
+   /* The sink's images are exportable dma-bufs with an explicit DRM format modifier. */
+   const std::array required_device_extensions{
+      VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+      VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+      VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+      VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+      VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+      VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_FENCE_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME,
+   };
+   return extension_list.add(required_device_extensions.data(), required_device_extensions.size());
+}
+
 VkResult surface_properties::get_required_instance_extensions(util::extension_list &extension_list)
 {
    const std::array required_instance_extensions{
       VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
       VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME,
       VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,
+      VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
    };
    return extension_list.add(required_instance_extensions.data(), required_instance_extensions.size());
 }
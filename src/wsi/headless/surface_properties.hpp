@@ -54,12 +54,29 @@ public:
 
    PFN_vkVoidFunction get_proc_addr(const char *name) override;
 
+   VkResult get_required_device_extensions(util::extension_list &extension_list) override;
+
    VkResult get_required_instance_extensions(util::extension_list &extension_list) override;
 
    bool is_surface_extension_enabled(const wsi::instance_private_data &instance_data) override;
 
    static surface_properties &get_instance();
 
+   /**
+    * @brief Whether WSI_HEADLESS_UNTHROTTLED=1 is set.
+    *
+    * FIFO swapchains then present without a page flip thread and hand each image back for acquire as soon as its
+    * present fence signals, and the image count is not limited. Ignored when a dma-buf sink is set.
+    */
+   static bool is_unthrottled();
+
+   /**
+    * @brief Returns the socket path of WSI_HEADLESS_DMABUF_SINK, or nullptr if it is not set.
+    *
+    * Swapchains then export their frames to the consumer listening on it, see @ref dmabuf_sink_swapchain.
+    */
+   static const char *get_dmabuf_sink();
+
    bool is_compatible_present_modes(VkPresentModeKHR present_mode_a, VkPresentModeKHR present_mode_b) override;
 
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
@@ -28,10 +28,14 @@
  * @brief Contains the implementation for a headless swapchain.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 
 #include "swapchain.hpp"
+#include "surface_properties.hpp"
 
 #include "../layer_utils/custom_allocator.hpp"
 #include "../layer_utils/timed_semaphore.hpp"
@@ -40,6 +44,8 @@
 #include <wsi/extensions/swapchain_maintenance.hpp>
 #include <wsi/extensions/image_compression_control.hpp>
 #include "../layer_utils/macros.hpp"
+#include "core/metrics_page.hpp"
+#include "utils/logging.hpp"
 
 #include "present_timing_handler.hpp"
 
@@ -48,15 +54,34 @@ namespace wsi
 namespace headless
 {
 
+namespace
+{
+uint64_t monotonic_now_ns()
+{
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+         .count());
+}
+} // namespace
+
 struct image_data
 {
    /* Device memory backing the image. */
    VkDeviceMemory memory{};
    fence_sync present_fence;
+   /* Sequence of the unthrottled present the image is pending for, 0 if it is not. */
+   uint64_t present_sequence{};
 };
 
 swapchain::swapchain(wsi::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator)
    : wsi::swapchain_base(dev_data, pAllocator)
+   , m_unthrottled(false)
+   , m_present_sequence(0)
+   , m_first_present_ns(0)
+   , m_last_present_ns(0)
+   , m_fence_wait_total_ns(0)
+   , m_fence_wait_max_ns(0)
+   , m_fence_wait_samples(0)
 {
 }
 
@@ -64,6 +89,11 @@ swapchain::~swapchain()
 {
    /* Call the base's teardown */
    teardown();
+
+   if (m_unthrottled)
+   {
+      log_unthrottled_stats();
+   }
 }
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
@@ -119,7 +149,10 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
                                   bool &use_presentation_thread)
 {
    UNUSED(device);
-   if (swapchain_create_info->presentMode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR)
+   m_unthrottled = surface_properties::is_unthrottled() &&
+                   (swapchain_create_info->presentMode == VK_PRESENT_MODE_FIFO_KHR ||
+                    swapchain_create_info->presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+   if (swapchain_create_info->presentMode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR || m_unthrottled)
    {
       use_presentation_thread = false;
    }
@@ -128,6 +161,19 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       use_presentation_thread = true;
    }
 
+   /* Shared images are never in PRESENT_SRC, which the dump copy expects. */
+   if (frame_dumper::is_enabled() && swapchain_create_info->presentMode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR &&
+       swapchain_create_info->presentMode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR)
+   {
+      const auto swapchain_id = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this));
+      m_frame_dumper = std::make_unique<frame_dumper>(m_device_data, get_allocation_callbacks());
+      if (m_frame_dumper->init(swapchain_id, swapchain_create_info->imageFormat, swapchain_create_info->imageExtent) !=
+          VK_SUCCESS)
+      {
+         m_frame_dumper.reset();
+      }
+   }
+
    return VK_SUCCESS;
 }
 
@@ -199,6 +245,10 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
 VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
 {
    m_image_create_info = image_create_info;
+   if (m_frame_dumper)
+   {
+      m_image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+   }
    VkImageCompressionControlEXT image_compression_control = {};
 
    if (m_device_data.is_swapchain_compression_control_enabled())
@@ -225,9 +275,116 @@ void swapchain::present_image(const pending_present_request &pending_present)
       auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
       ext->set_present_id(pending_present.present_id);
    }
+
+   if (m_unthrottled)
+   {
+      /* Presents run with the image status mutex held. The image stays pending until get_free_buffer finds its
+       * present fence signaled. */
+      auto *data = reinterpret_cast<image_data *>(m_swapchain_images[pending_present.image_index].data);
+      data->present_sequence = ++m_present_sequence;
+      m_last_present_ns = monotonic_now_ns();
+      if (m_first_present_ns == 0)
+      {
+         m_first_present_ns = m_last_present_ns;
+      }
+      return;
+   }
    unpresent_image(pending_present.image_index);
 }
 
+void swapchain::retire_image(uint32_t image_index)
+{
+   reinterpret_cast<image_data *>(m_swapchain_images[image_index].data)->present_sequence = 0;
+   unpresent_image(image_index);
+}
+
+VkResult swapchain::get_free_buffer(uint64_t *timeout)
+{
+   if (!m_unthrottled)
+   {
+      return VK_SUCCESS;
+   }
+
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   bool retired = false;
+   uint32_t oldest_index = UINT32_MAX;
+   uint64_t oldest_sequence = UINT64_MAX;
+   for (uint32_t i = 0; i < m_swapchain_images.size(); i++)
+   {
+      auto *data = reinterpret_cast<image_data *>(m_swapchain_images[i].data);
+      if (m_swapchain_images[i].status != swapchain_image::PENDING || data == nullptr || data->present_sequence == 0)
+      {
+         continue;
+      }
+
+      if (data->present_fence.wait_payload(0) == VK_SUCCESS)
+      {
+         retire_image(i);
+         retired = true;
+      }
+      else if (data->present_sequence < oldest_sequence)
+      {
+         oldest_index = i;
+         oldest_sequence = data->present_sequence;
+      }
+   }
+
+   if (retired || oldest_index == UINT32_MAX || *timeout == 0)
+   {
+      return VK_SUCCESS;
+   }
+
+   /* Presents do not touch pending images and acquires are externally synchronized, so nothing else uses the fence
+    * while it is waited for without the lock. */
+   auto *data = reinterpret_cast<image_data *>(m_swapchain_images[oldest_index].data);
+   image_status_lock.unlock();
+   const uint64_t wait_start_ns = monotonic_now_ns();
+   VkResult result = data->present_fence.wait_payload(*timeout);
+   const uint64_t wait_ns = monotonic_now_ns() - wait_start_ns;
+   image_status_lock.lock();
+
+   if (result == VK_TIMEOUT)
+   {
+      return VK_TIMEOUT;
+   }
+   if (result != VK_SUCCESS)
+   {
+      WSI_LOG_ERROR("Failed to wait for the present fence of image %u: %d", oldest_index, result);
+      set_error_state(result);
+      return result;
+   }
+
+   m_fence_wait_total_ns += wait_ns;
+   m_fence_wait_max_ns = std::max(m_fence_wait_max_ns, wait_ns);
+   m_fence_wait_samples++;
+   auto &metrics = mali_wrapper::MetricsPage::Instance();
+   if (metrics.IsEnabled())
+   {
+      metrics.RecordPresentWait(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)), wait_ns);
+   }
+
+   retire_image(oldest_index);
+   return VK_SUCCESS;
+}
+
+void swapchain::log_unthrottled_stats()
+{
+   if (m_present_sequence < 2)
+   {
+      return;
+   }
+
+   const double elapsed_s = static_cast<double>(m_last_present_ns - m_first_present_ns) / 1e9;
+   const double rate_hz = elapsed_s > 0.0 ? static_cast<double>(m_present_sequence - 1) / elapsed_s : 0.0;
+   const double wait_mean_us =
+      m_fence_wait_samples > 0 ? static_cast<double>(m_fence_wait_total_ns) / m_fence_wait_samples / 1e3 : 0.0;
+   WSI_LOG_INFO("Headless unthrottled swapchain stats: presents=%llu present_rate_hz=%.1f fence_waits=%llu "
+                "fence_wait_us mean=%.1f max=%.1f",
+                static_cast<unsigned long long>(m_present_sequence), rate_hz,
+                static_cast<unsigned long long>(m_fence_wait_samples), wait_mean_us,
+                static_cast<double>(m_fence_wait_max_ns) / 1e3);
+}
+
 void swapchain::destroy_image(wsi::swapchain_image &image)
 {
    std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
@@ -261,7 +418,15 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
                                               const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
    auto data = reinterpret_cast<image_data *>(image.data);
-   return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   const VkCommandBuffer dump_copy = m_frame_dumper ? m_frame_dumper->begin_capture(image.image) : VK_NULL_HANDLE;
+   if (dump_copy == VK_NULL_HANDLE)
+   {
+      return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+   }
+
+   VkResult result = data->present_fence.set_payload(queue, semaphores, submission_pnext, &dump_copy, 1);
+   m_frame_dumper->end_capture(queue, result);
+   return result;
 }
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
@@ -33,6 +33,9 @@
 #include <vulkan/vk_icd.h>
 #include <vulkan/vulkan.h>
 
+#include <memory>
+
+#include <wsi/frame_dump.hpp>
 #include <wsi/swapchain_base.hpp>
 
 namespace wsi
@@ -44,6 +47,10 @@ namespace headless
  *
  * This class is mostly empty, because all the swapchain stuff is handled by the swapchain class,
  * which we inherit. This class only provides a way to create an image and page-flip ops.
+ *
+ * With WSI_HEADLESS_UNTHROTTLED=1, FIFO swapchains present on the calling thread and leave the image pending. An
+ * acquire that finds no free image hands back every pending image whose present fence signaled, in any order, and
+ * only blocks on the oldest one if none did.
  */
 class swapchain : public wsi::swapchain_base
 {
@@ -90,6 +97,11 @@ protected:
     */
    void present_image(const pending_present_request &pending_present) override;
 
+   uint32_t get_metrics_backend() const override
+   {
+      return mali_wrapper::metrics_backend::headless;
+   }
+
    /**
     * @brief Method to release a swapchain image
     *
@@ -112,6 +124,13 @@ protected:
 
    VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   /**
+    * @brief Hand back the unthrottled images whose present fence signaled.
+    *
+    * @param[in,out] timeout Time to wait in nanoseconds for the oldest image when none signaled.
+    */
+   VkResult get_free_buffer(uint64_t *timeout) override;
+
    /**
     * @brief Bind image to a swapchain
     *
@@ -134,6 +153,31 @@ private:
     * @return VK_SUCCESS on success, other result codes on failure
     */
    VkResult add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info) override;
+
+   /**
+    * @brief Hand the pending image at @p image_index back for acquire, once its present fence signaled.
+    */
+   void retire_image(uint32_t image_index);
+
+   /**
+    * @brief Log the present rate and the time acquire waited for present fences.
+    */
+   void log_unthrottled_stats();
+
+   /** Whether presents skip the page flip thread and images are retired on their present fence. */
+   bool m_unthrottled;
+   /** Counts unthrottled presents, so the oldest pending image can be found. */
+   uint64_t m_present_sequence;
+   /** CLOCK_MONOTONIC time of the first and the last unthrottled present. */
+   uint64_t m_first_present_ns;
+   uint64_t m_last_present_ns;
+   /** Time acquire blocked on present fences. */
+   uint64_t m_fence_wait_total_ns;
+   uint64_t m_fence_wait_max_ns;
+   uint64_t m_fence_wait_samples;
+
+   /** Dumps presented frames with MALI_WRAPPER_FRAME_DUMP, nullptr otherwise. */
+   std::unique_ptr<frame_dumper> m_frame_dumper;
 };
 
 } /* namespace headless */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2020-2021, 2024 Arm Limited.
+ * Copyright (c) 2020-2021, 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -29,6 +29,60 @@
 namespace util
 {
 
+namespace
+{
+struct scope_counters
+{
+   std::atomic<uint64_t> allocations{ 0 };
+   std::atomic<uint64_t> frees{ 0 };
+   std::atomic<uint64_t> bytes{ 0 };
+   std::atomic<uint64_t> live_bytes{ 0 };
+};
+
+scope_counters g_scope_counters[ALLOCATION_SCOPE_COUNT];
+
+scope_counters &get_scope_counters(VkSystemAllocationScope scope)
+{
+   const auto index = static_cast<uint32_t>(scope);
+   return g_scope_counters[index < ALLOCATION_SCOPE_COUNT ? index : VK_SYSTEM_ALLOCATION_SCOPE_COMMAND];
+}
+} /* namespace */
+
+void enable_allocation_accounting()
+{
+   detail::g_allocation_accounting.store(true, std::memory_order_relaxed);
+}
+
+void get_allocation_stats(allocation_stats *stats)
+{
+   for (uint32_t i = 0; i < ALLOCATION_SCOPE_COUNT; ++i)
+   {
+      const auto &counters = g_scope_counters[i];
+      stats[i].allocations = counters.allocations.load(std::memory_order_relaxed);
+      stats[i].frees = counters.frees.load(std::memory_order_relaxed);
+      stats[i].bytes = counters.bytes.load(std::memory_order_relaxed);
+      stats[i].live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+   }
+}
+
+namespace detail
+{
+void account_allocation(VkSystemAllocationScope scope, size_t size)
+{
+   auto &counters = get_scope_counters(scope);
+   counters.allocations.fetch_add(1, std::memory_order_relaxed);
+   counters.bytes.fetch_add(size, std::memory_order_relaxed);
+   counters.live_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void account_free(VkSystemAllocationScope scope, size_t size)
+{
+   auto &counters = get_scope_counters(scope);
+   counters.frees.fetch_add(1, std::memory_order_relaxed);
+   counters.live_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+} /* namespace detail */
+
 VWL_VKAPI_CALL(void *) default_allocation(void *, size_t size, size_t, VkSystemAllocationScope) VWL_API_POST
 {
    return malloc(size);
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2020-2022, 2024 Arm Limited.
+ * Copyright (c) 2020-2022, 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -22,6 +22,7 @@
  * SOFTWARE.
  */
 
+#include <atomic>
 #include <cstdint>
 #include <new>
 #include <vector>
@@ -42,6 +43,97 @@ namespace util
 template <typename T>
 class deleter;
 
+/**
+ * @brief Number of allocations the calling thread made through custom_allocator.
+ */
+inline thread_local uint64_t t_allocation_count = 0;
+
+/**
+ * @brief Counts the allocations the calling thread makes through custom_allocator while it is alive.
+ */
+class allocation_counter : private noncopyable
+{
+public:
+   allocation_counter()
+      : m_start_count(t_allocation_count)
+   {
+   }
+
+   /**
+    * @brief Allocations made since the counter was created.
+    */
+   uint64_t get() const
+   {
+      return t_allocation_count - m_start_count;
+   }
+
+private:
+   uint64_t m_start_count;
+};
+
+/**
+ * @brief Asserts that the calling thread makes no allocation through custom_allocator while the scope is alive.
+ *
+ * Marks code that must not allocate once a swapchain is set up, such as presenting an image. Does nothing when
+ * NDEBUG is defined.
+ */
+class allocation_free_scope : private noncopyable
+{
+public:
+#ifndef NDEBUG
+   ~allocation_free_scope()
+   {
+      assert(m_counter.get() == 0 && "Allocation in an allocation free scope");
+   }
+
+private:
+   allocation_counter m_counter;
+#endif
+};
+
+/**
+ * @brief Number of VkSystemAllocationScope values, which the allocation statistics are split by.
+ */
+constexpr uint32_t ALLOCATION_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+/**
+ * @brief Host memory allocated through custom_allocator in one VkSystemAllocationScope.
+ *
+ * Swapchains and surfaces allocate in VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, device and instance private data in the
+ * DEVICE and INSTANCE scopes, and temporaries of a single call in COMMAND.
+ */
+struct allocation_stats
+{
+   uint64_t allocations;
+   uint64_t frees;
+   /** Sum of all allocation sizes. */
+   uint64_t bytes;
+   /** Bytes allocated and not freed yet. A reallocation adds its new size without subtracting the old one. */
+   uint64_t live_bytes;
+};
+
+/**
+ * @brief Start recording allocation_stats. Off by default, as it adds atomic updates to every allocation.
+ *
+ * Call before the first allocation, so that live_bytes does not see frees of blocks it never counted.
+ */
+void enable_allocation_accounting();
+
+/**
+ * @brief Copy the statistics recorded since enable_allocation_accounting(), indexed by VkSystemAllocationScope.
+ *
+ * @param[out] stats Array of ALLOCATION_SCOPE_COUNT entries.
+ */
+void get_allocation_stats(allocation_stats *stats);
+
+namespace detail
+{
+inline std::atomic<bool> g_allocation_accounting{ false };
+
+void account_allocation(VkSystemAllocationScope scope, size_t size);
+void account_free(VkSystemAllocationScope scope, size_t size);
+} /* namespace detail */
+
 /**
  * @brief Wrapper for unique_ptr.
  *
@@ -154,6 +246,7 @@ public:
       void *ret = cb.pfnAllocation(cb.pUserData, size, alignof(T), m_alloc.m_scope);
       if (ret == nullptr)
          throw std::bad_alloc();
+      count_allocation(size);
       return reinterpret_cast<pointer>(ret);
    }
 
@@ -169,15 +262,29 @@ public:
       void *ret = cb.pfnReallocation(cb.pUserData, ptr, size, alignof(T), m_alloc.m_scope);
       if (ret == nullptr)
          throw std::bad_alloc();
+      count_allocation(size);
       return reinterpret_cast<pointer>(ret);
    }
 
-   void deallocate(void *ptr, size_t) const noexcept
+   void deallocate(void *ptr, size_t n) const noexcept
    {
+      if (ptr != nullptr && detail::g_allocation_accounting.load(std::memory_order_relaxed))
+      {
+         detail::account_free(m_alloc.m_scope, n * sizeof(T));
+      }
       m_alloc.m_callbacks.pfnFree(m_alloc.m_callbacks.pUserData, ptr);
    }
 
 private:
+   void count_allocation(size_t size) const
+   {
+      t_allocation_count++;
+      if (detail::g_allocation_accounting.load(std::memory_order_relaxed))
+      {
+         detail::account_allocation(m_alloc.m_scope, size);
+      }
+   }
+
    const allocator m_alloc;
 };
 
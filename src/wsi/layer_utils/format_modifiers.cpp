@@ -24,10 +24,253 @@
 
 #include "format_modifiers.hpp"
 #include "wsi/wsi_private_data.hpp"
+#include "utils/logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace util
 {
 
+namespace
+{
+std::atomic<bool> g_afbc_disabled{ false };
+
+constexpr uint32_t FORMAT_CACHE_FILE_MAGIC = 0x3146574d; /* "MWF1" */
+constexpr uint32_t FORMAT_CACHE_FILE_VERSION = 1;
+/* Swapchains only ever ask about a handful of formats and usages; this just bounds a misbehaving application. */
+constexpr size_t MAX_FORMAT_CACHE_ENTRIES = 4096;
+constexpr uint32_t MAX_FORMAT_CACHE_KEY_SIZE = 1024;
+
+struct format_cache_file_header
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t properties_size;
+   uint32_t entry_count;
+};
+
+struct device_format_cache
+{
+   /* Empty when MALI_WRAPPER_FORMAT_CACHE_DIR is unset. */
+   std::string file_path;
+   bool dirty = false;
+   std::unordered_map<std::string, drm_modifier_image_support> entries;
+};
+
+/* Keyed by handle. The driver may hand out the same handle to a later instance, but only for the same GPU. */
+std::mutex g_format_cache_mutex;
+std::unordered_map<VkPhysicalDevice, std::unique_ptr<device_format_cache>> g_format_caches;
+
+template <typename T>
+void append_key(std::string &key, const T &value)
+{
+   key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string make_support_key(const VkImageCreateInfo &info, uint64_t modifier,
+                             const VkImageCompressionControlEXT *compression_control)
+{
+   std::string key;
+   append_key(key, info.format);
+   append_key(key, info.imageType);
+   append_key(key, info.usage);
+   append_key(key, info.flags);
+   append_key(key, modifier);
+   append_key(key, info.sharingMode);
+   if (info.sharingMode == VK_SHARING_MODE_CONCURRENT && info.pQueueFamilyIndices != nullptr)
+   {
+      append_key(key, info.queueFamilyIndexCount);
+      key.append(reinterpret_cast<const char *>(info.pQueueFamilyIndices),
+                 sizeof(uint32_t) * info.queueFamilyIndexCount);
+   }
+   if (compression_control != nullptr)
+   {
+      append_key(key, compression_control->flags);
+      append_key(key, compression_control->compressionControlPlaneCount);
+      if (compression_control->pFixedRateFlags != nullptr)
+      {
+         key.append(reinterpret_cast<const char *>(compression_control->pFixedRateFlags),
+                    sizeof(VkImageCompressionFixedRateFlagsEXT) * compression_control->compressionControlPlaneCount);
+      }
+   }
+   return key;
+}
+
+std::string get_format_cache_path(const VkPhysicalDeviceProperties &properties)
+{
+   const char *dir = std::getenv("MALI_WRAPPER_FORMAT_CACHE_DIR");
+   if (dir == nullptr || dir[0] == '\0')
+   {
+      return {};
+   }
+
+   char name[128];
+   int length = std::snprintf(name, sizeof(name), "/formats-%08x-%08x-%08x-", properties.vendorID,
+                              properties.deviceID, properties.driverVersion);
+   for (uint32_t i = 0; i < VK_UUID_SIZE && length > 0 && static_cast<size_t>(length) + 2 < sizeof(name); i++)
+   {
+      length += std::snprintf(name + length, sizeof(name) - length, "%02x", properties.pipelineCacheUUID[i]);
+   }
+   return std::string(dir) + name + ".bin";
+}
+
+bool make_directories(const std::string &path)
+{
+   for (size_t pos = 1; pos <= path.size(); pos++)
+   {
+      if (pos != path.size() && path[pos] != '/')
+      {
+         continue;
+      }
+      const std::string prefix = path.substr(0, pos);
+      if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+template <typename T>
+bool read_value(FILE *file, T &value)
+{
+   return std::fread(&value, sizeof(value), 1, file) == 1;
+}
+
+void load_format_cache(device_format_cache &cache)
+{
+   FILE *file = std::fopen(cache.file_path.c_str(), "rbe");
+   if (file == nullptr)
+   {
+      return;
+   }
+
+   format_cache_file_header header = {};
+   bool valid = read_value(file, header) && header.magic == FORMAT_CACHE_FILE_MAGIC &&
+                header.version == FORMAT_CACHE_FILE_VERSION &&
+                header.properties_size == sizeof(VkImageFormatProperties) &&
+                header.entry_count <= MAX_FORMAT_CACHE_ENTRIES;
+   for (uint32_t i = 0; valid && i < header.entry_count; i++)
+   {
+      uint32_t key_size = 0;
+      uint32_t supported = 0;
+      drm_modifier_image_support support = {};
+      valid = read_value(file, key_size) && key_size <= MAX_FORMAT_CACHE_KEY_SIZE;
+      std::string key(valid ? key_size : 0, '\0');
+      valid = valid && std::fread(&key[0], 1, key_size, file) == key_size && read_value(file, supported) &&
+              read_value(file, support.image_format_properties) && read_value(file, support.external_memory_features);
+      if (valid)
+      {
+         support.supported = supported != 0;
+         cache.entries.emplace(std::move(key), support);
+      }
+   }
+   std::fclose(file);
+
+   if (!valid)
+   {
+      /* A truncated or stale file is rebuilt from driver queries. */
+      cache.entries.clear();
+      cache.dirty = true;
+      return;
+   }
+   WSI_LOG_DEBUG("Loaded %zu format/modifier results from %s", cache.entries.size(), cache.file_path.c_str());
+}
+
+template <typename T>
+void append_value(std::vector<uint8_t> &data, const T &value)
+{
+   const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+   data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+/* Writes a temporary file and renames it over the cache, so concurrent processes only see whole files. */
+bool write_format_cache(const device_format_cache &cache)
+{
+   const size_t slash = cache.file_path.rfind('/');
+   if (slash != std::string::npos && slash > 0 && !make_directories(cache.file_path.substr(0, slash)))
+   {
+      return false;
+   }
+
+   std::vector<uint8_t> data;
+   format_cache_file_header header = { FORMAT_CACHE_FILE_MAGIC, FORMAT_CACHE_FILE_VERSION,
+                                       static_cast<uint32_t>(sizeof(VkImageFormatProperties)),
+                                       static_cast<uint32_t>(cache.entries.size()) };
+   append_value(data, header);
+   for (const auto &entry : cache.entries)
+   {
+      append_value(data, static_cast<uint32_t>(entry.first.size()));
+      data.insert(data.end(), entry.first.begin(), entry.first.end());
+      append_value(data, static_cast<uint32_t>(entry.second.supported ? 1 : 0));
+      append_value(data, entry.second.image_format_properties);
+      append_value(data, entry.second.external_memory_features);
+   }
+
+   std::string temp_path = cache.file_path + ".XXXXXX";
+   const int fd = mkostemp(&temp_path[0], O_CLOEXEC);
+   if (fd < 0)
+   {
+      return false;
+   }
+   size_t offset = 0;
+   while (offset < data.size())
+   {
+      const ssize_t written = write(fd, data.data() + offset, data.size() - offset);
+      if (written < 0 && errno == EINTR)
+      {
+         continue;
+      }
+      if (written <= 0)
+      {
+         break;
+      }
+      offset += static_cast<size_t>(written);
+   }
+   bool ok = offset == data.size() && fchmod(fd, 0644) == 0;
+   ok = close(fd) == 0 && ok;
+   ok = ok && rename(temp_path.c_str(), cache.file_path.c_str()) == 0;
+   if (!ok)
+   {
+      unlink(temp_path.c_str());
+   }
+   return ok;
+}
+
+device_format_cache &get_device_format_cache(VkPhysicalDevice physical_device)
+{
+   auto &cache = g_format_caches[physical_device];
+   if (!cache)
+   {
+      cache.reset(new device_format_cache());
+      VkPhysicalDeviceProperties properties = {};
+      mali_wrapper::instance_private_data::get(physical_device)
+         .disp.GetPhysicalDeviceProperties(physical_device, &properties);
+      cache->file_path = get_format_cache_path(properties);
+      if (!cache->file_path.empty())
+      {
+         load_format_cache(*cache);
+      }
+   }
+   return *cache;
+}
+} // namespace
+
 VkResult get_drm_format_properties(VkPhysicalDevice physical_device, VkFormat format,
                                    util::vector<VkDrmFormatModifierPropertiesEXT> &format_props_list)
 {
@@ -51,4 +294,125 @@ VkResult get_drm_format_properties(VkPhysicalDevice physical_device, VkFormat fo
    instance_data.disp.GetPhysicalDeviceFormatProperties2KHR(physical_device, format, &format_props);
    return VK_SUCCESS;
 }
+
+drm_modifier_image_support get_drm_modifier_image_support(VkPhysicalDevice physical_device,
+                                                          const VkImageCreateInfo &info, uint64_t modifier,
+                                                          const VkImageCompressionControlEXT *compression_control)
+{
+   std::string key = make_support_key(info, modifier, compression_control);
+
+   std::lock_guard<std::mutex> lock(g_format_cache_mutex);
+   device_format_cache &cache = get_device_format_cache(physical_device);
+   auto it = cache.entries.find(key);
+   if (it != cache.entries.end())
+   {
+      return it->second;
+   }
+
+   VkExternalImageFormatPropertiesKHR external_props = {};
+   external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
+
+   VkImageFormatProperties2KHR format_props = {};
+   format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
+   format_props.pNext = &external_props;
+
+   VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
+   external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
+   external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
+
+   VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
+   drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
+   drm_mod_info.pNext = &external_info;
+   drm_mod_info.drmFormatModifier = modifier;
+   drm_mod_info.sharingMode = info.sharingMode;
+   drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
+   drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
+
+   VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
+   image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
+   image_info.pNext = &drm_mod_info;
+   image_info.format = info.format;
+   image_info.type = info.imageType;
+   image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
+   image_info.usage = info.usage;
+   image_info.flags = info.flags;
+
+   VkImageCompressionControlEXT compression = {};
+   if (compression_control != nullptr)
+   {
+      compression = *compression_control;
+      compression.pNext = image_info.pNext;
+      image_info.pNext = &compression;
+   }
+
+   drm_modifier_image_support support = {};
+   auto &instance_data = mali_wrapper::instance_private_data::get(physical_device);
+   if (instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(physical_device, &image_info, &format_props) ==
+       VK_SUCCESS)
+   {
+      support.supported = true;
+      support.image_format_properties = format_props.imageFormatProperties;
+      support.external_memory_features = external_props.externalMemoryProperties.externalMemoryFeatures;
+   }
+
+   if (cache.entries.size() < MAX_FORMAT_CACHE_ENTRIES)
+   {
+      cache.entries.emplace(std::move(key), support);
+      cache.dirty = !cache.file_path.empty();
+   }
+   return support;
+}
+
+void save_drm_modifier_image_support(VkPhysicalDevice physical_device)
+{
+   std::lock_guard<std::mutex> lock(g_format_cache_mutex);
+   auto it = g_format_caches.find(physical_device);
+   if (it == g_format_caches.end() || !it->second->dirty)
+   {
+      return;
+   }
+
+   device_format_cache &cache = *it->second;
+   cache.dirty = false;
+   if (!write_format_cache(cache))
+   {
+      WSI_LOG_WARNING("Failed to write format cache %s: %s", cache.file_path.c_str(), std::strerror(errno));
+   }
+}
+
+bool is_afbc_modifier(uint64_t modifier)
+{
+   return (modifier >> 56) == DRM_FORMAT_MOD_VENDOR_ARM &&
+          ((modifier >> 52) & DRM_FORMAT_MOD_ARM_TYPE_MASK) == DRM_FORMAT_MOD_ARM_TYPE_AFBC;
+}
+
+bool is_afbc_enabled()
+{
+   static const bool env_enabled = []() {
+      const char *env = std::getenv("WSI_AFBC");
+      return env == nullptr || !(env[0] == '0' && env[1] == '\0');
+   }();
+   return env_enabled && !g_afbc_disabled.load(std::memory_order_acquire);
+}
+
+void disable_afbc(const char *reason)
+{
+   if (!g_afbc_disabled.exchange(true, std::memory_order_acq_rel))
+   {
+      WSI_LOG_WARNING("AFBC swapchain images disabled: %s. Later swapchains use uncompressed layouts.", reason);
+   }
+}
+
+void apply_afbc_policy(util::vector<wsialloc_format> &formats, bool allow_afbc)
+{
+   const auto is_afbc = [](const wsialloc_format &format) { return is_afbc_modifier(format.modifier); };
+   if (allow_afbc && is_afbc_enabled())
+   {
+      std::stable_partition(formats.begin(), formats.end(), is_afbc);
+   }
+   else
+   {
+      formats.erase(std::remove_if(formats.begin(), formats.end(), is_afbc), formats.end());
+   }
+}
 } /* namespace util */
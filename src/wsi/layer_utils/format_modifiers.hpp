@@ -26,6 +26,7 @@
 
 #include <vulkan/vulkan.h>
 #include "custom_allocator.hpp"
+#include "wsialloc/wsialloc.h"
 
 namespace util
 {
@@ -44,4 +45,67 @@ namespace util
 VkResult get_drm_format_properties(VkPhysicalDevice physical_device, VkFormat format,
                                    util::vector<VkDrmFormatModifierPropertiesEXT> &format_props_list);
 
+/**
+ * @brief What the driver reports for an image created with a DRM format modifier and dma-buf external memory.
+ */
+struct drm_modifier_image_support
+{
+   /** Whether vkGetPhysicalDeviceImageFormatProperties2 returned VK_SUCCESS. The other members are zero otherwise. */
+   bool supported;
+   VkImageFormatProperties image_format_properties;
+   VkExternalMemoryFeatureFlags external_memory_features;
+};
+
+/**
+ * @brief Query, or look up, whether @p info can be created with @p modifier and exported to or imported from a dma-buf.
+ *
+ * Results are cached for the process by physical device and by every image create parameter except the extent, mip
+ * levels, array layers and samples, so swapchain recreation while a window is resized does not repeat the driver
+ * queries. The caller checks those against @p support. When MALI_WRAPPER_FORMAT_CACHE_DIR is set, results are also
+ * loaded from and saved to a file there keyed by the device and driver version.
+ *
+ * @param physical_device     The physical device
+ * @param info                The swapchain image create info; its tiling and pNext are ignored.
+ * @param modifier            The DRM format modifier.
+ * @param compression_control Compression control chained into the query, or nullptr.
+ *
+ * @return The driver's answer.
+ */
+drm_modifier_image_support get_drm_modifier_image_support(VkPhysicalDevice physical_device,
+                                                          const VkImageCreateInfo &info, uint64_t modifier,
+                                                          const VkImageCompressionControlEXT *compression_control);
+
+/**
+ * @brief Write results added by get_drm_modifier_image_support() to the on-disk cache, if it is enabled.
+ *
+ * Called once a swapchain has gone through its candidate modifiers, so each creation writes the file at most once.
+ */
+void save_drm_modifier_image_support(VkPhysicalDevice physical_device);
+
+/**
+ * @brief Whether @p modifier is an Arm Frame Buffer Compression (AFBC) layout.
+ */
+bool is_afbc_modifier(uint64_t modifier);
+
+/**
+ * @brief Whether swapchains may allocate AFBC images.
+ *
+ * True unless WSI_AFBC=0 is set or disable_afbc() was called.
+ */
+bool is_afbc_enabled();
+
+/**
+ * @brief Stop allocating AFBC swapchain images for the rest of the process, after one was rejected.
+ */
+void disable_afbc(const char *reason);
+
+/**
+ * @brief Order swapchain allocation candidates for AFBC.
+ *
+ * wsialloc allocates the first candidate it can. When @p allow_afbc is set and AFBC is enabled, AFBC candidates move
+ * ahead of the others, so a compressed layout is picked whenever one is available. Otherwise they are removed. The
+ * relative order within each group is kept.
+ */
+void apply_afbc_policy(util::vector<wsialloc_format> &formats, bool allow_afbc);
+
 } /* namespace util */
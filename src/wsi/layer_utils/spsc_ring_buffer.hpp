@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace util
+{
+
+/**
+ * @brief Fixed size FIFO that one producer and one consumer thread can use at the same time without a lock.
+ *
+ * The producer only writes the tail index and the consumer only writes the head index, each published with release
+ * ordering after the slot it covers has been written or read.
+ */
+template <typename T, std::size_t N>
+class spsc_ring_buffer
+{
+public:
+   /**
+    * @brief Return maximum capacity of the ring buffer.
+    */
+   constexpr std::size_t capacity() const
+   {
+      return N;
+   }
+
+   /**
+    * @brief Places item into next slot of the ring buffer. Only call from the producer thread.
+    * @return Boolean to indicate success or failure.
+    */
+   bool push_back(const T &item)
+   {
+      const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_head.load(std::memory_order_acquire) == N)
+      {
+         return false;
+      }
+
+      m_data[tail % N] = item;
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+   }
+
+   /**
+    * @brief Pop the front of the ring buffer. Only call from the consumer thread.
+    *
+    * @return Item wrapped in an optional, empty if the ring buffer is.
+    */
+   std::optional<T> pop_front()
+   {
+      const std::size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire))
+      {
+         return std::nullopt;
+      }
+
+      std::optional<T> value{ std::move(m_data[head % N]) };
+      m_head.store(head + 1, std::memory_order_release);
+      return value;
+   }
+
+private:
+   std::array<T, N> m_data{};
+
+   /* Free running counts of popped and pushed items, their difference is the size. */
+   std::atomic<std::size_t> m_head{ 0 };
+   std::atomic<std::size_t> m_tail{ 0 };
+};
+
+} /* namespace util */
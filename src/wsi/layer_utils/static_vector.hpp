@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file static_vector.hpp
+ *
+ * @brief A vector with a fixed capacity stored inline, for containers on a hot path that must not allocate.
+ */
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+namespace util
+{
+
+/**
+ * @brief Vector of at most @p N elements, kept inside the object.
+ *
+ * Unused slots hold default constructed elements, so T must be default constructible and cheap to move. Like
+ * util::vector, adding elements reports failure through the return value, here when the vector is full.
+ */
+template <typename T, std::size_t N>
+class static_vector
+{
+public:
+   using value_type = T;
+   using iterator = T *;
+   using const_iterator = const T *;
+
+   static constexpr std::size_t capacity()
+   {
+      return N;
+   }
+
+   std::size_t size() const
+   {
+      return m_size;
+   }
+
+   bool empty() const
+   {
+      return m_size == 0;
+   }
+
+   bool full() const
+   {
+      return m_size == N;
+   }
+
+   /**
+    * @brief Appends @p item.
+    * @return false when the vector is already full.
+    */
+   template <typename U>
+   bool try_push_back(U &&item)
+   {
+      if (full())
+      {
+         return false;
+      }
+
+      m_data[m_size++] = std::forward<U>(item);
+      return true;
+   }
+
+   void pop_back()
+   {
+      assert(!empty());
+      m_data[--m_size] = T{};
+   }
+
+   /**
+    * @brief Removes the elements in [@p first, @p last), keeping the order of the ones after them.
+    * @return Iterator to the element that followed the removed ones.
+    */
+   iterator erase(const_iterator first, const_iterator last)
+   {
+      iterator dst = begin() + (first - begin());
+      iterator src = begin() + (last - begin());
+      iterator ret = dst;
+      for (; src != end(); ++src, ++dst)
+      {
+         *dst = std::move(*src);
+      }
+      while (end() != dst)
+      {
+         pop_back();
+      }
+      return ret;
+   }
+
+   void clear()
+   {
+      while (!empty())
+      {
+         pop_back();
+      }
+   }
+
+   T &operator[](std::size_t index)
+   {
+      assert(index < m_size);
+      return m_data[index];
+   }
+
+   const T &operator[](std::size_t index) const
+   {
+      assert(index < m_size);
+      return m_data[index];
+   }
+
+   iterator begin()
+   {
+      return m_data.data();
+   }
+
+   iterator end()
+   {
+      return m_data.data() + m_size;
+   }
+
+   const_iterator begin() const
+   {
+      return m_data.data();
+   }
+
+   const_iterator end() const
+   {
+      return m_data.data() + m_size;
+   }
+
+private:
+   std::array<T, N> m_data{};
+
+   /* Number of elements in use, from the start of m_data. */
+   std::size_t m_size{};
+};
+
+} /* namespace util */
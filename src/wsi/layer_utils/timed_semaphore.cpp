@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017, 2019, 2021-2022 Arm Limited.
+ * Copyright (c) 2017, 2019, 2021-2022, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -24,158 +24,159 @@
 
 #include <cassert>
 #include <cerrno>
+#include <climits>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "timed_semaphore.hpp"
 
 namespace util
 {
 
-VkResult timed_semaphore::init(unsigned count)
+namespace
 {
-   int res;
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futex word has to be a plain 32 bit integer");
 
-   m_count = count;
+/* Spin bounds for a wait: long enough to cover a post on another core, short next to a frame. */
+constexpr uint32_t MIN_SPIN = 16;
+constexpr uint32_t MAX_SPIN = 2048;
 
-   pthread_condattr_t attr;
-   res = pthread_condattr_init(&attr);
-   /* the only failure that can occur is ENOMEM */
-   assert(res == 0 || res == ENOMEM);
-   if (res != 0)
-   {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
+uint64_t monotonic_now_ns()
+{
+   struct timespec now = {};
+   int res = clock_gettime(CLOCK_MONOTONIC, &now);
+   assert(res == 0); /* only fails with programming error (EINVAL, EFAULT, EPERM) */
+   (void)res;
+   return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+}
 
-   res = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
-   /* only programming error can cause _setclock to fail */
-   assert(res == 0);
+void cpu_relax()
+{
+#if defined(__aarch64__) || defined(__arm__)
+   __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#endif
+}
 
-   res = pthread_cond_init(&m_cond, &attr);
-   /* the only failure that can occur that is not programming error is ENOMEM */
-   assert(res == 0 || res == ENOMEM);
-   if (res != 0)
+/* Sleeps while *word is expected, until deadline_ns on CLOCK_MONOTONIC. Returns the futex errno, 0 on wake up. */
+int futex_wait_until(std::atomic<uint32_t> &word, uint32_t expected, uint64_t deadline_ns)
+{
+   struct timespec deadline = {};
+   struct timespec *deadline_ptr = nullptr;
+   if (deadline_ns != UINT64_MAX)
    {
-      res = pthread_condattr_destroy(&attr);
-      assert(res == 0);
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      deadline.tv_sec = static_cast<time_t>(deadline_ns / 1000000000ull);
+      deadline.tv_nsec = static_cast<long>(deadline_ns % 1000000000ull);
+      deadline_ptr = &deadline;
    }
 
-   res = pthread_condattr_destroy(&attr);
-   /* only programming error can cause _destroy to fail */
-   assert(res == 0);
+   /* FUTEX_WAIT_BITSET takes an absolute timeout, on CLOCK_MONOTONIC unless FUTEX_CLOCK_REALTIME is set. */
+   long res = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, expected,
+                      deadline_ptr, nullptr, FUTEX_BITSET_MATCH_ANY);
+   return res == 0 ? 0 : errno;
+}
 
-   res = pthread_mutex_init(&m_mutex, nullptr);
-   /* only programming errors can result in failure */
-   assert(res == 0);
+void futex_wake_one(std::atomic<uint32_t> &word)
+{
+   syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, nullptr, nullptr, 0);
+}
+} // namespace
 
+VkResult timed_semaphore::init(unsigned count)
+{
+   m_count.store(count, std::memory_order_relaxed);
+   m_waiters.store(0, std::memory_order_relaxed);
+   m_spin_limit.store(MIN_SPIN, std::memory_order_relaxed);
    initialized = true;
 
    return VK_SUCCESS;
 }
 
-timed_semaphore::~timed_semaphore()
+bool timed_semaphore::try_take()
 {
-   int res;
-   (void)res; /* unused when NDEBUG */
-
-   if (initialized)
+   uint32_t count = m_count.load(std::memory_order_relaxed);
+   while (count != 0)
    {
-      res = pthread_cond_destroy(&m_cond);
-      assert(res == 0); /* only programming error (EBUSY, EINVAL) */
-
-      res = pthread_mutex_destroy(&m_mutex);
-      assert(res == 0); /* only programming error (EBUSY, EINVAL) */
+      if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+      {
+         return true;
+      }
    }
+   return false;
 }
 
 VkResult timed_semaphore::wait(uint64_t timeout)
 {
-   VkResult retval = VK_SUCCESS;
-   int res;
-
    assert(initialized);
 
-   res = pthread_mutex_lock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
+   if (try_take())
+   {
+      return VK_SUCCESS;
+   }
+   if (timeout == 0)
+   {
+      return VK_NOT_READY;
+   }
+
+   uint64_t deadline_ns = UINT64_MAX;
+   if (timeout != UINT64_MAX)
+   {
+      const uint64_t now_ns = monotonic_now_ns();
+      deadline_ns = timeout < UINT64_MAX - now_ns ? now_ns + timeout : UINT64_MAX;
+   }
+   return wait_until(deadline_ns);
+}
 
-   switch (timeout)
+VkResult timed_semaphore::wait_until(uint64_t deadline_ns)
+{
+   assert(initialized);
+
+   /* Spin first: a post is often just about to come, and then the wait costs no syscall. The spin grows while it pays
+    * off and shrinks while it does not. */
+   const uint32_t spin_limit = m_spin_limit.load(std::memory_order_relaxed);
+   for (uint32_t i = 0; i < spin_limit; ++i)
    {
-   case 0:
-      if (m_count == 0)
-      {
-         retval = VK_NOT_READY;
-      }
-      break;
-   case UINT64_MAX:
-      while (m_count == 0)
+      if (try_take())
       {
-         res = pthread_cond_wait(&m_cond, &m_mutex);
-         assert(res == 0); /* only fails with programming error (EINVAL) */
+         m_spin_limit.store(spin_limit < MAX_SPIN ? spin_limit * 2 : MAX_SPIN, std::memory_order_relaxed);
+         return VK_SUCCESS;
       }
-      break;
-   default:
-      if (m_count == 0)
-      {
-         struct timespec diff = { /* narrowing casts */
-                                  static_cast<time_t>(timeout / (1000 * 1000 * 1000)),
-                                  static_cast<long>(timeout % (1000 * 1000 * 1000))
-         };
-
-         struct timespec now = {};
-         res = clock_gettime(CLOCK_MONOTONIC, &now);
-         assert(res == 0); /* only fails with programming error (EINVAL, EFAULT, EPERM) */
-
-         /* add diff to now, handling overflow */
-         struct timespec end = { now.tv_sec + diff.tv_sec, now.tv_nsec + diff.tv_nsec };
-
-         if (end.tv_nsec >= 1000 * 1000 * 1000)
-         {
-            end.tv_nsec -= 1000 * 1000 * 1000;
-            end.tv_sec++;
-         }
-
-         while (m_count == 0)
-         {
-            res = pthread_cond_timedwait(&m_cond, &m_mutex, &end);
-            /* only fails with programming error, other than timeout */
-            assert(res == 0 || res == ETIMEDOUT);
-            if (res == ETIMEDOUT)
-            {
-               retval = VK_TIMEOUT;
-               break;
-            }
-         }
-      }
-      break;
+      cpu_relax();
    }
+   m_spin_limit.store(spin_limit > MIN_SPIN ? spin_limit / 2 : MIN_SPIN, std::memory_order_relaxed);
 
-   if (retval == VK_SUCCESS)
+   /* Announce the waiter before the last check, so a post either leaves a count for it or sees it and wakes it. */
+   m_waiters.fetch_add(1, std::memory_order_seq_cst);
+   VkResult retval = VK_SUCCESS;
+   while (!try_take())
    {
-      assert(m_count > 0);
-      m_count--;
+      const int res = futex_wait_until(m_count, 0, deadline_ns);
+      /* EAGAIN means the count changed before sleeping, EINTR a signal. Only programming errors fail otherwise. */
+      assert(res == 0 || res == EAGAIN || res == EINTR || res == ETIMEDOUT);
+      if (res == ETIMEDOUT)
+      {
+         retval = try_take() ? VK_SUCCESS : VK_TIMEOUT;
+         break;
+      }
    }
-   res = pthread_mutex_unlock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EPERM) */
+   m_waiters.fetch_sub(1, std::memory_order_relaxed);
 
    return retval;
 }
 
 void timed_semaphore::post()
 {
-   int res;
-   (void)res; /* unused when NDEBUG */
-
    assert(initialized);
 
-   res = pthread_mutex_lock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
-
-   m_count++;
-
-   res = pthread_cond_signal(&m_cond);
-   assert(res == 0); /* only fails with programming error (EINVAL) */
-
-   res = pthread_mutex_unlock(&m_mutex);
-   assert(res == 0); /* only fails with programming error (EPERM) */
+   m_count.fetch_add(1, std::memory_order_seq_cst);
+   if (m_waiters.load(std::memory_order_seq_cst) != 0)
+   {
+      futex_wake_one(m_count);
+   }
 }
 
 } /* namespace util */
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017, 2019, 2024 Arm Limited.
+ * Copyright (c) 2017, 2019, 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -32,16 +32,16 @@
  * as the system time may change, resulting in an incorrect timeout period
  * (potentially by a significant amount).
  *
- * We therefore have to re-engineer semaphores using condition variables.
+ * We therefore implement the semaphore on a futex, which waits for absolute
+ * CLOCK_MONOTONIC deadlines.
  *
- * This code does not use the C++ standard library to avoid exceptions.
+ * Only std::atomic is used from the C++ standard library, so nothing here throws.
  */
 
 #pragma once
 
-extern "C" {
-#include <pthread.h>
-}
+#include <atomic>
+#include <cstdint>
 
 #include <vulkan/vulkan.h>
 #include "helpers.hpp"
@@ -52,19 +52,14 @@ namespace util
 /**
  * brief semaphore with a safe relative timed wait
  *
- * sem_timedwait takes an absolute time, based on CLOCK_REALTIME. Simply
- * taking the current time and adding on a relative timeout is not correct,
- * as the system time may change, resulting in an incorrect timeout period
- * (potentially by a significant amount).
- *
- * We therefore have to re-engineer semaphores using condition variables.
- *
- * This code does not use the C++ standard library to avoid exceptions.
+ * The count lives in a futex word. Waits and posts that do not block are a
+ * single atomic operation. A wait with no count spins briefly before sleeping
+ * in the kernel, and a post only makes the wake up syscall when a thread
+ * sleeps.
  */
 class timed_semaphore : private noncopyable
 {
 public:
-   ~timed_semaphore();
    timed_semaphore()
       : initialized(false){};
 
@@ -72,7 +67,6 @@ public:
     * @brief initializes the semaphore
     *
     * @param count initial value of the semaphore
-    * @retval VK_ERROR_OUT_OF_HOST_MEMORY out of memory condition from pthread calls
     * @retval VK_SUCCESS on success
     */
    VkResult init(unsigned count);
@@ -87,6 +81,15 @@ public:
     */
    VkResult wait(uint64_t timeout);
 
+   /**
+    * @brief decrement semaphore, waiting until a CLOCK_MONOTONIC deadline if the value is 0
+    *
+    * @param deadline_ns absolute CLOCK_MONOTONIC time (ns) to give up at. UINT64_MAX waits indefinately.
+    * @retval VK_TIMEOUT the deadline passed with the count still 0
+    * @retval VK_SUCCESS on success
+    */
+   VkResult wait_until(uint64_t deadline_ns);
+
    /**
     * @brief increment semaphore, potentially unblocking a waiting thread
     */
@@ -94,18 +97,28 @@ public:
 
 private:
    /**
-    * @brief true if the semaphore has been initialized
+    * @brief Decrement the count if it is not 0.
     *
-    * Determines if the destructor should cleanup the mutex and cond.
+    * @return true if the count was decremented.
+    */
+   bool try_take();
+
+   /**
+    * @brief true if the semaphore has been initialized
     */
    bool initialized;
    /**
-    * @brief semaphore value
+    * @brief semaphore value, also the futex word that waiters sleep on
     */
-   unsigned m_count;
-
-   pthread_mutex_t m_mutex;
-   pthread_cond_t m_cond;
+   std::atomic<uint32_t> m_count{ 0 };
+   /**
+    * @brief number of threads that are about to sleep or sleep on m_count
+    */
+   std::atomic<uint32_t> m_waiters{ 0 };
+   /**
+    * @brief spin iterations before sleeping, adapted to whether recent spins got the semaphore
+    */
+   std::atomic<uint32_t> m_spin_limit{ 0 };
 };
 
 } /* namespace util */
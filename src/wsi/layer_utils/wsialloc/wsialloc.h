@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2024 Arm Limited.
+ * Copyright (c) 2017-2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -64,8 +64,9 @@ extern "C" {
  * 2 - Added WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION
  * 3 - Grouped the return values of wsialloc_alloc to wsialloc_allocate_result and added another value for returning
  *     whether or not the allocation will be disjoint.
+ * 4 - Added wsialloc_release to return buffers to the implementation for reuse.
  */
-#define WSIALLOC_INTERFACE_VERSION 3
+#define WSIALLOC_INTERFACE_VERSION 4
 
 #define WSIALLOC_CONCAT(x, y) x##y
 #define WSIALLOC_SYMBOL_VERSION(symbol, version) WSIALLOC_CONCAT(symbol, version)
@@ -229,7 +230,8 @@ typedef struct wsialloc_allocate_result
  * are pointers to storage large enough to hold per-plane information.
  * @pre @p info::width >=1 && @p info::height >= 1
  * @pre @p allocator is a currently valid WSI Allocator from wsialloc_new()
- * @post The allocated buffer will be zeroed.
+ * @post The allocated buffer will be zeroed, unless it is a buffer given back with wsialloc_release() that the
+ *       implementation hands out again. The contents of such a buffer are undefined.
  *
  * @param      allocator  The WSI Allocator to allocate from.
  * @param[in]  info       The requested allocation information.
@@ -246,6 +248,22 @@ typedef struct wsialloc_allocate_result
 wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allocate_info *info,
                               wsialloc_allocate_result *result);
 
+/**
+ * @brief Free a buffer from wsialloc_alloc(), letting the implementation keep it for a later allocation.
+ *
+ * This is an alternative to close() on the buffer's file descriptor. Implementations may keep released buffers in a
+ * process-wide pool and return them from a later wsialloc_alloc() on any allocator, skipping the kernel allocation
+ * and the zeroing of its pages. Buffers that are not reused are closed after a while.
+ *
+ * @pre @p fd is a unique element of wsialloc_allocate_result::buffer_fds, from an allocation without
+ *      WSIALLOC_ALLOCATE_PROTECTED. It is released once, and not used by the caller afterwards.
+ * @pre Nothing outside the process still reads or writes the buffer: the window system has released it, e.g. with
+ *      wl_buffer.release or PresentIdleNotify. Destroying the wl_buffer or pixmap alone does not mean that.
+ *
+ * @param fd The buffer's file descriptor. Negative values are ignored.
+ */
+void wsialloc_release(int fd);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
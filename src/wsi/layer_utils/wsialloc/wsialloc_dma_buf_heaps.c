@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2024 Arm Limited.
+ * Copyright (c) 2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -29,8 +29,12 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -43,7 +47,7 @@
  *
  * This should only be increased when this implementation is updated to match newer versions of wsialloc.h.
  */
-#define WSIALLOC_IMPLEMENTATION_VERSION 3
+#define WSIALLOC_IMPLEMENTATION_VERSION 4
 
 /* Ensure we are implementing the wsialloc version matching the wsialloc.h header we are using. */
 #if WSIALLOC_IMPLEMENTATION_VERSION != WSIALLOC_INTERFACE_VERSION
@@ -69,6 +73,143 @@ struct wsialloc_allocator
    int protected_fd;
 };
 
+/* Most buffers released to the pool at once. */
+#define WSIALLOC_POOL_MAX_BUFFERS 16
+/* Released buffers not reused within this time are closed. */
+#define WSIALLOC_POOL_MAX_AGE_NS (5ull * 1000 * 1000 * 1000)
+/* Default for WSI_DMABUF_POOL_MB, the most memory the pool keeps. */
+#define WSIALLOC_POOL_DEFAULT_MB 128
+/* A pooled buffer may serve an allocation up to a quarter smaller than itself. */
+#define WSIALLOC_POOL_MAX_SLACK_DIVISOR 4
+
+typedef struct pooled_buffer
+{
+   int fd;
+   uint64_t size;
+   /* CLOCK_MONOTONIC time of its release. */
+   uint64_t release_ns;
+} pooled_buffer;
+
+/* Buffers given back with wsialloc_release(), from the memory heap only. Process-wide, as swapchains create and
+ * delete their allocator with themselves, and recreating one is the case the pool is for. */
+static struct
+{
+   pthread_mutex_t lock;
+   pooled_buffer buffers[WSIALLOC_POOL_MAX_BUFFERS];
+   uint32_t count;
+   uint64_t bytes;
+} pool = { PTHREAD_MUTEX_INITIALIZER, { { 0 } }, 0, 0 };
+
+static uint64_t monotonic_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t pool_max_bytes(void)
+{
+   static uint64_t max_bytes = UINT64_MAX;
+   if (max_bytes == UINT64_MAX)
+   {
+      uint64_t max_mb = WSIALLOC_POOL_DEFAULT_MB;
+      const char *value = getenv("WSI_DMABUF_POOL_MB");
+      if (value != NULL && value[0] != '\0')
+      {
+         char *end = NULL;
+         const unsigned long long parsed = strtoull(value, &end, 10);
+         if (end != value && *end == '\0')
+         {
+            max_mb = parsed;
+         }
+      }
+      max_bytes = max_mb << 20;
+   }
+   return max_bytes;
+}
+
+/* Call with pool.lock held. Keeps the order of the remaining buffers, oldest release first. */
+static void pool_remove_locked(uint32_t index)
+{
+   assert(index < pool.count);
+   pool.bytes -= pool.buffers[index].size;
+   pool.count--;
+   memmove(&pool.buffers[index], &pool.buffers[index + 1], (pool.count - index) * sizeof(pool.buffers[0]));
+}
+
+/* Call with pool.lock held. Closes the buffers released before @p oldest_ns, then the oldest ones while more than
+ * @p max_bytes are pooled. */
+static void pool_trim_locked(uint64_t oldest_ns, uint64_t max_bytes)
+{
+   while (pool.count > 0 && (pool.buffers[0].release_ns < oldest_ns || pool.bytes > max_bytes))
+   {
+      close(pool.buffers[0].fd);
+      pool_remove_locked(0);
+   }
+}
+
+static uint64_t pool_oldest_ns(uint64_t now_ns)
+{
+   return now_ns > WSIALLOC_POOL_MAX_AGE_NS ? now_ns - WSIALLOC_POOL_MAX_AGE_NS : 0;
+}
+
+/* Takes the smallest pooled buffer that holds @p size bytes without wasting much, or returns -1. */
+static int pool_take(uint64_t size)
+{
+   int fd = -1;
+   pthread_mutex_lock(&pool.lock);
+   pool_trim_locked(pool_oldest_ns(monotonic_ns()), pool_max_bytes());
+
+   const uint64_t max_size = size + size / WSIALLOC_POOL_MAX_SLACK_DIVISOR;
+   uint32_t best = pool.count;
+   for (uint32_t i = 0; i < pool.count; i++)
+   {
+      const uint64_t candidate = pool.buffers[i].size;
+      if (candidate >= size && candidate <= max_size && (best == pool.count || candidate < pool.buffers[best].size))
+      {
+         best = i;
+      }
+   }
+   if (best != pool.count)
+   {
+      fd = pool.buffers[best].fd;
+      pool_remove_locked(best);
+   }
+   pthread_mutex_unlock(&pool.lock);
+   return fd;
+}
+
+void wsialloc_release(int fd)
+{
+   if (fd < 0)
+   {
+      return;
+   }
+
+   const off_t size = lseek(fd, 0, SEEK_END);
+   const uint64_t max_bytes = pool_max_bytes();
+   if (size <= 0 || (uint64_t)size > max_bytes)
+   {
+      close(fd);
+      return;
+   }
+
+   const uint64_t now_ns = monotonic_ns();
+   pthread_mutex_lock(&pool.lock);
+   if (pool.count == WSIALLOC_POOL_MAX_BUFFERS)
+   {
+      close(pool.buffers[0].fd);
+      pool_remove_locked(0);
+   }
+   pool.buffers[pool.count].fd = fd;
+   pool.buffers[pool.count].size = (uint64_t)size;
+   pool.buffers[pool.count].release_ns = now_ns;
+   pool.count++;
+   pool.bytes += (uint64_t)size;
+   pool_trim_locked(pool_oldest_ns(now_ns), max_bytes);
+   pthread_mutex_unlock(&pool.lock);
+}
+
 static int allocate(int fd, uint64_t size)
 {
    assert(size > 0);
@@ -107,9 +248,56 @@ static int dma_allocate(const wsialloc_allocator *allocator, const wsialloc_allo
       return -1;
    }
 
+   /* Protected buffers never enter the pool, see wsialloc_release(). */
+   if (!(info->flags & WSIALLOC_ALLOCATE_PROTECTED))
+   {
+      const int pooled_fd = pool_take(size);
+      if (pooled_fd >= 0)
+      {
+         return pooled_fd;
+      }
+   }
+
    return allocate(alloc_fd, size);
 }
 
+/* Heap that every kernel with DMA-BUF heaps has, used when the configured one is missing. */
+#define WSIALLOC_FALLBACK_HEAP_NAME "system"
+
+static int open_heap(const char *name)
+{
+   if (name[0] == '\0' || strchr(name, '/') != NULL)
+   {
+      return -1;
+   }
+
+   char path[64];
+   const int length = snprintf(path, sizeof(path), "/dev/dma_heap/%s", name);
+   if (length < 0 || (size_t)length >= sizeof(path))
+   {
+      return -1;
+   }
+   return open(path, O_RDWR | O_CLOEXEC);
+}
+
+/* WSI_DMABUF_HEAP overrides the heap chosen at build time. If that heap is missing, for example system-uncached on
+ * a kernel without it, the buffers come from the cached system heap instead. */
+static int open_memory_heap(void)
+{
+   const char *name = getenv("WSI_DMABUF_HEAP");
+   if (name == NULL || name[0] == '\0')
+   {
+      name = STR(WSIALLOC_MEMORY_HEAP_NAME);
+   }
+
+   int fd = open_heap(name);
+   if (fd < 0 && strcmp(name, WSIALLOC_FALLBACK_HEAP_NAME) != 0)
+   {
+      fd = open_heap(WSIALLOC_FALLBACK_HEAP_NAME);
+   }
+   return fd;
+}
+
 wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
 {
    assert(allocator != NULL);
@@ -120,7 +308,7 @@ wsialloc_error wsialloc_new(wsialloc_allocator **allocator)
       return WSIALLOC_ERROR_NO_RESOURCE;
    }
 
-   dma_buf_heaps->memory_fd = open("/dev/dma_heap/" STR(WSIALLOC_MEMORY_HEAP_NAME), O_RDWR);
+   dma_buf_heaps->memory_fd = open_memory_heap();
    dma_buf_heaps->protected_fd = -1;
 
    if (dma_buf_heaps->memory_fd < 0)
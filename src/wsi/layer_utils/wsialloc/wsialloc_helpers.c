@@ -32,6 +32,14 @@
 /** Maximum image size allowed for each dimension */
 #define MAX_IMAGE_SIZE 128000
 
+/** AFBC layout constants, matching the kernel's drm_gem_afbc_min_size() */
+#define AFBC_HEADER_SIZE (16u)
+#define AFBC_SUPERBLOCK_PIXELS (256u)
+#define AFBC_SUPERBLOCK_ALIGNMENT (128u)
+#define AFBC_HEADER_ALIGNMENT (64u)
+#define AFBC_TILED_HEADER_LAYOUT_ALIGNMENT (8u)
+#define AFBC_TILED_BODY_START_ALIGNMENT (4096u)
+
 typedef struct wsialloc_format_descriptor
 {
    wsialloc_format format;
@@ -43,6 +51,73 @@ static uint64_t round_size_up_to_align(uint64_t size)
    return (size + WSIALLOCP_MIN_ALIGN_SZ - 1) & ~(WSIALLOCP_MIN_ALIGN_SZ - 1);
 }
 
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+   return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool is_afbc_modifier(uint64_t modifier)
+{
+   return (modifier >> 56) == DRM_FORMAT_MOD_VENDOR_ARM &&
+          ((modifier >> 52) & DRM_FORMAT_MOD_ARM_TYPE_MASK) == DRM_FORMAT_MOD_ARM_TYPE_AFBC;
+}
+
+/**
+ * AFBC buffers hold a 16 byte header per superblock followed by the superblock payloads, sized here for the
+ * uncompressed worst case. The stride is the one KMS expects for AFBC framebuffers: the aligned width in bytes.
+ */
+static wsialloc_error calculate_afbc_properties(const wsialloc_format_descriptor *descriptor,
+                                                const wsialloc_allocate_info *info, int *strides, uint32_t *offsets,
+                                                uint64_t *total_size)
+{
+   const uint64_t modifier = descriptor->format.modifier;
+   const uint32_t bits_per_pixel = descriptor->format_spec.bpp[0];
+
+   uint32_t block_width = 0;
+   uint32_t block_height = 0;
+   switch (modifier & AFBC_FORMAT_MOD_BLOCK_SIZE_MASK)
+   {
+   case AFBC_FORMAT_MOD_BLOCK_SIZE_16x16:
+      block_width = 16;
+      block_height = 16;
+      break;
+   case AFBC_FORMAT_MOD_BLOCK_SIZE_32x8:
+      block_width = 32;
+      block_height = 8;
+      break;
+   case AFBC_FORMAT_MOD_BLOCK_SIZE_64x4:
+      block_width = 64;
+      block_height = 4;
+      break;
+   default:
+      /* 32x8_64x4 splits luma and chroma into different block sizes, which only multi-plane layouts use. */
+      return WSIALLOC_ERROR_NOT_SUPPORTED;
+   }
+
+   /* Userspace memory mode headers are not laid out by the buffer's owner. */
+   if ((modifier & AFBC_FORMAT_MOD_USM) || bits_per_pixel == 0 || bits_per_pixel % 8 != 0)
+   {
+      return WSIALLOC_ERROR_NOT_SUPPORTED;
+   }
+
+   const bool tiled_headers = (modifier & AFBC_FORMAT_MOD_TILED) != 0;
+   const uint32_t width_alignment = block_width * (tiled_headers ? AFBC_TILED_HEADER_LAYOUT_ALIGNMENT : 1);
+   const uint32_t height_alignment = block_height * (tiled_headers ? AFBC_TILED_HEADER_LAYOUT_ALIGNMENT : 1);
+   const uint64_t aligned_width = align_up(info->width, width_alignment);
+   const uint64_t aligned_height = align_up(info->height, height_alignment);
+   const uint64_t num_superblocks = aligned_width * aligned_height / AFBC_SUPERBLOCK_PIXELS;
+
+   const uint64_t body_offset = align_up(num_superblocks * AFBC_HEADER_SIZE,
+                                         tiled_headers ? AFBC_TILED_BODY_START_ALIGNMENT : AFBC_HEADER_ALIGNMENT);
+   const uint64_t superblock_size =
+      align_up(AFBC_SUPERBLOCK_PIXELS * bits_per_pixel / 8, AFBC_SUPERBLOCK_ALIGNMENT);
+
+   strides[0] = (int)(aligned_width * bits_per_pixel / 8);
+   offsets[0] = 0;
+   *total_size = body_offset + num_superblocks * superblock_size;
+   return WSIALLOC_ERROR_NONE;
+}
+
 static wsialloc_error calculate_format_properties(const wsialloc_format_descriptor *descriptor,
                                                   const wsialloc_allocate_info *info, int *strides, uint32_t *offsets,
                                                   uint64_t *total_size)
@@ -58,13 +133,17 @@ static wsialloc_error calculate_format_properties(const wsialloc_format_descript
    const uint64_t modifier = descriptor->format.modifier;
    const uint32_t num_planes = descriptor->format_spec.nr_planes;
 
-   /* We currently don't support any kind of custom modifiers */
-   if (modifier != DRM_FORMAT_MOD_LINEAR)
+   /* No multi-plane format support */
+   if (num_planes > 1)
    {
       return WSIALLOC_ERROR_NOT_SUPPORTED;
    }
-   /* No multi-plane format support */
-   if (num_planes > 1)
+   if (is_afbc_modifier(modifier))
+   {
+      return calculate_afbc_properties(descriptor, info, strides, offsets, total_size);
+   }
+   /* Other than AFBC, only linear layouts are supported */
+   if (modifier != DRM_FORMAT_MOD_LINEAR)
    {
       return WSIALLOC_ERROR_NOT_SUPPORTED;
    }
@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2017-2024 Arm Limited.
+ * Copyright (c) 2017-2024, 2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -44,7 +44,7 @@
  *
  * This should only be increased when this implementation is updated to match newer versions of wsialloc.h.
  */
-#define WSIALLOC_IMPLEMENTATION_VERSION 3
+#define WSIALLOC_IMPLEMENTATION_VERSION 4
 
 /* Ensure we are implementing the wsialloc version matching the wsialloc.h header we are using. */
 #if WSIALLOC_IMPLEMENTATION_VERSION != WSIALLOC_INTERFACE_VERSION
@@ -192,3 +192,12 @@ wsialloc_error wsialloc_alloc(wsialloc_allocator *allocator, const wsialloc_allo
 
    return wsiallocp_alloc(allocator, ion_allocate, info, result);
 }
+
+void wsialloc_release(int fd)
+{
+   /* ION buffers are not pooled. */
+   if (fd >= 0)
+   {
+      close(fd);
+   }
+}
@@ -32,6 +32,7 @@
 #include <cstdlib>
 #include <new>
 #include <atomic>
+#include <optional>
 
 #include "wsi/wsi_private_data.hpp"
 #include "swapchain_api.hpp"
@@ -216,8 +217,17 @@ wsi_layer_vkAcquireNextImageKHR(VkDevice device, VkSwapchainKHR swapc, uint64_t
    return res;
 }
 
+/**
+ * @brief Submits the wait of a multi-swapchain present once for all its swapchains.
+ *
+ * When every swapchain can take a shared Sync FD, the submission only signals the first swapchain's present
+ * semaphore, which is then exported to @p shared_wait_fd. Each swapchain imports a duplicate of it instead of
+ * waiting on its own present semaphore, so the cost of a further swapchain is a dup and an import rather than a
+ * payload submission. Otherwise, the submission signals the present semaphore of every swapchain.
+ */
 static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &present_info,
-                                    wsi::device_private_data &device_data, bool &frame_boundary_event_handled)
+                                    wsi::device_private_data &device_data, bool &frame_boundary_event_handled,
+                                    std::optional<util::fd_owner> &shared_wait_fd)
 {
    util::vector<VkSemaphore> swapchain_semaphores{ util::allocator(device_data.get_allocator(),
                                                                    VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) };
@@ -226,15 +236,17 @@ static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &prese
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
+   bool share_wait = true;
    for (uint32_t i = 0; i < present_info.swapchainCount; ++i)
    {
       auto swapchain = reinterpret_cast<wsi::swapchain_base *>(present_info.pSwapchains[i]);
       swapchain_semaphores[i] = swapchain->get_image_present_semaphore(present_info.pImageIndices[i]);
+      share_wait = share_wait && swapchain->supports_shared_wait_sync_fd();
    }
 
    wsi::queue_submit_semaphores semaphores = { present_info.pWaitSemaphores, present_info.waitSemaphoreCount,
                                                swapchain_semaphores.data(),
-                                               static_cast<uint32_t>(swapchain_semaphores.size()) };
+                                               share_wait ? 1u : static_cast<uint32_t>(swapchain_semaphores.size()) };
 
    void *submission_pnext = nullptr;
    auto frame_boundary = wsi::create_frame_boundary(present_info);
@@ -247,6 +259,31 @@ static VkResult submit_wait_request(VkQueue queue, const VkPresentInfoKHR &prese
    frame_boundary_event_handled = submission_pnext != nullptr;
 
    TRY(wsi::sync_queue_submit(device_data, queue, VK_NULL_HANDLE, semaphores, submission_pnext));
+   if (!share_wait)
+   {
+      return VK_SUCCESS;
+   }
+
+   VkSemaphoreGetFdInfoKHR semaphore_fd_info = {};
+   semaphore_fd_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+   semaphore_fd_info.semaphore = swapchain_semaphores[0];
+   semaphore_fd_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   int sync_fd = -1;
+   VkResult result = device_data.disp.GetSemaphoreFdKHR(device_data.device, &semaphore_fd_info, &sync_fd);
+   if (result == VK_SUCCESS)
+   {
+      /* -1 means the wait already completed, which every import accepts as signaled. */
+      shared_wait_fd.emplace(sync_fd);
+      return VK_SUCCESS;
+   }
+
+   /* The first present semaphore still holds the wait, pass it on to the others. */
+   WSI_LOG_WARNING("Failed to export the shared present wait (result=%d), signalling each swapchain instead.",
+                   result);
+   const wsi::queue_submit_semaphores fallback_semaphores = { swapchain_semaphores.data(), 1,
+                                                              swapchain_semaphores.data(),
+                                                              static_cast<uint32_t>(swapchain_semaphores.size()) };
+   TRY(wsi::sync_queue_submit(device_data, queue, VK_NULL_HANDLE, fallback_semaphores));
    return VK_SUCCESS;
 }
 
@@ -273,9 +310,11 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
    const VkPresentInfoKHR *present_info = pPresentInfo;
    bool use_image_present_semaphore = false;
    bool frame_boundary_event_handled = true;
+   std::optional<util::fd_owner> shared_wait_fd;
    if (pPresentInfo->swapchainCount > 1)
    {
-      TRY_LOG_CALL(submit_wait_request(queue, *pPresentInfo, device_data, frame_boundary_event_handled));
+      TRY_LOG_CALL(
+         submit_wait_request(queue, *pPresentInfo, device_data, frame_boundary_event_handled, shared_wait_fd));
       use_image_present_semaphore = true;
    }
 
@@ -286,6 +325,8 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
       VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT, present_info->pNext);
    const auto swapchain_present_mode_info = util::find_extension<VkSwapchainPresentModeInfoEXT>(
       VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_MODE_INFO_EXT, present_info->pNext);
+   const auto present_regions =
+      util::find_extension<VkPresentRegionsKHR>(VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR, present_info->pNext);
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
    const auto present_timings_info =
       util::find_extension<VkPresentTimingsInfoEXT>(VK_STRUCTURE_TYPE_PRESENT_TIMINGS_INFO_EXT, present_info->pNext);
@@ -317,7 +358,23 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
       present_params.pending_present.image_index = pPresentInfo->pImageIndices[i];
       present_params.pending_present.present_id = present_id;
 
+      if (present_regions != nullptr && present_regions->pRegions != nullptr &&
+          present_regions->swapchainCount == pPresentInfo->swapchainCount)
+      {
+         const VkPresentRegionKHR &region = present_regions->pRegions[i];
+         auto &damage = present_params.pending_present.damage;
+         if (region.pRectangles != nullptr && region.rectangleCount <= wsi::present_damage::MAX_RECTS)
+         {
+            for (uint32_t r = 0; r < region.rectangleCount; ++r)
+            {
+               damage.rects[r] = { region.pRectangles[r].offset, region.pRectangles[r].extent };
+            }
+            damage.rect_count = region.rectangleCount;
+         }
+      }
+
       present_params.use_image_present_semaphore = use_image_present_semaphore;
+      present_params.wait_sync_fd = shared_wait_fd.has_value() ? &shared_wait_fd.value() : nullptr;
       present_params.handle_present_frame_boundary_event = frame_boundary_event_handled;
 
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
@@ -325,6 +382,12 @@ wsi_layer_vkQueuePresentKHR(VkQueue queue, const VkPresentInfoKHR *pPresentInfo)
       {
          present_params.m_present_timing_info = present_timings_info->pTimingInfos[i];
          present_params.m_present_timing_info.pNext = nullptr;
+         if (present_params.m_present_timing_info.targetPresentStage != 0 &&
+             !present_params.m_present_timing_info.presentAtRelativeTime)
+         {
+            present_params.pending_present.target_present_time =
+               present_params.m_present_timing_info.time.targetPresentTime;
+         }
       }
 #endif
       VkResult res = sc->queue_present(queue, present_info, present_params);
@@ -31,39 +31,118 @@
  * that is not specific to how images are created or presented.
  */
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <system_error>
+#include <thread>
+#include <vector>
 
+#include <poll.h>
 #include <unistd.h>
 #include <vulkan/vulkan.h>
 
 #include "utils/logging.hpp"
+#include "utils/thread_placement.hpp"
+#include "utils/trace.hpp"
+#include "core/metrics_page.hpp"
 #include "layer_utils/helpers.hpp"
 
 #include "swapchain_base.hpp"
 #include "wsi_factory.hpp"
 
+#include "extensions/image_compression_control.hpp"
 #include "extensions/present_timing.hpp"
 #include "extensions/swapchain_maintenance.hpp"
 
 namespace wsi
 {
 
+namespace
+{
+/**
+ * @brief Read WSI_MAX_QUEUED_PRESENTS, the cap on presents waiting for the page flip thread. 0 or unset means none.
+ */
+uint32_t read_max_queued_presents()
+{
+   const char *value = std::getenv("WSI_MAX_QUEUED_PRESENTS");
+   if (value == nullptr || value[0] == '\0')
+   {
+      return 0;
+   }
+
+   errno = 0;
+   char *end = nullptr;
+   unsigned long parsed = std::strtoul(value, &end, 10);
+   if (errno != 0 || end == value || *end != '\0')
+   {
+      WSI_LOG_WARNING("Invalid WSI_MAX_QUEUED_PRESENTS='%s', not limiting queued presents.", value);
+      return 0;
+   }
+   return static_cast<uint32_t>(std::min<unsigned long>(parsed, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT));
+}
+
+/**
+ * @brief Whether WSI_PARALLEL_IMAGE_ALLOCATION leaves parallel swapchain image allocation on. Only "0" turns it off.
+ */
+bool parallel_image_allocation_enabled()
+{
+   static const bool enabled = []() {
+      const char *value = std::getenv("WSI_PARALLEL_IMAGE_ALLOCATION");
+      return !(value != nullptr && value[0] == '0' && value[1] == '\0');
+   }();
+   return enabled;
+}
+
+uint64_t monotonic_now_ns()
+{
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+         .count());
+}
+
+/**
+ * @brief Records the allocations the calling thread makes while presenting in the metrics page, when it is enabled.
+ */
+class present_allocation_recorder
+{
+public:
+   explicit present_allocation_recorder(const swapchain_base *swapchain)
+      : m_swapchain(swapchain)
+   {
+   }
+
+   ~present_allocation_recorder()
+   {
+      auto &metrics = mali_wrapper::MetricsPage::Instance();
+      if (metrics.IsEnabled())
+      {
+         metrics.RecordPresentAllocations(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(m_swapchain)),
+                                          m_counter.get());
+      }
+   }
+
+private:
+   const swapchain_base *m_swapchain;
+   util::allocation_counter m_counter;
+};
+} // namespace
+
 void swapchain_base::page_flip_thread()
 {
    auto &sc_images = m_swapchain_images;
    VkResult vk_res = VK_SUCCESS;
-   uint64_t timeout = UINT64_MAX;
-   constexpr uint64_t SEMAPHORE_TIMEOUT = 250000000; /* 250 ms. */
+   auto &metrics = mali_wrapper::MetricsPage::Instance();
+   mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::PRESENT, "page flip");
 
    /* No mutex is needed for the accesses to m_page_flip_thread_run variable as after the variable is
-    * initialized it is only ever changed to false. The while loop will make the thread read the
-    * value repeatedly, and the combination of semaphores and thread joins will force any changes to
-    * the variable to be visible to this thread.
+    * initialized it is only ever changed to false. teardown() posts m_page_flip_semaphore after changing it, so the
+    * thread can block on new requests without a timeout and still see the change.
     */
    while (m_page_flip_thread_run)
    {
@@ -72,60 +151,90 @@ void swapchain_base::page_flip_thread()
       {
          /* In continuous mode the application will only make one presentation request,
           * therefore the page flip semaphore will only be signalled once. */
-         if (!m_first_present)
+         if (m_first_present)
          {
-            vk_res = VK_SUCCESS;
+            vk_res = m_page_flip_semaphore.wait(UINT64_MAX);
+            assert(vk_res == VK_SUCCESS);
+            if (!m_page_flip_thread_run)
+            {
+               break;
+            }
          }
-         else if ((vk_res = m_page_flip_semaphore.wait(SEMAPHORE_TIMEOUT)) == VK_TIMEOUT)
-         {
-            /* Image is not ready yet. */
-            continue;
-         }
-         assert(vk_res == VK_SUCCESS);
 
          /* For continuous mode there will be only one image in the swapchain.
           * This image will always be used, and there is no pending state in this case. */
          submit_info.image_index = 0;
+         submit_info.present_mode = m_present_mode;
       }
       else
       {
          /* Waiting for the page_flip_semaphore which will be signalled once there is an
-          * image to display.*/
-         if ((vk_res = m_page_flip_semaphore.wait(SEMAPHORE_TIMEOUT)) == VK_TIMEOUT)
+          * image to display, or the thread has to end. */
+         vk_res = m_page_flip_semaphore.wait(UINT64_MAX);
+         assert(vk_res == VK_SUCCESS);
+         if (!m_page_flip_thread_run)
          {
-            /* Image is not ready yet. */
-            continue;
+            break;
          }
 
          /* We want to present the oldest queued for present image from our present queue,
           * which we can find at the sc->pending_buffer_pool.head index. */
-         std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
-
          auto pending_submission = m_pending_buffer_pool.pop_front();
          assert(pending_submission.has_value());
          submit_info = *pending_submission;
       }
 
-      /* We may need to wait for the payload of the present sync of the oldest pending image to be finished. */
-      while ((vk_res = image_wait_present(sc_images[submit_info.image_index], timeout)) == VK_TIMEOUT)
+      MALI_TRACE_SCOPE(PAGE_FLIP, submit_info.image_index);
+      present_allocation_recorder allocations(this);
+      const uint64_t picked_up_ns = submit_info.queued_ns != 0 ? monotonic_now_ns() : 0;
+
+      /* We may need to wait for the payload of the present sync of the oldest pending image to be finished. Presents
+       * stay in queue order, so a later image whose payload finished first still waits for this one. */
       {
-         WSI_LOG_WARNING("Timeout waiting for image's present fences, retrying..");
+         MALI_TRACE_SCOPE(PRESENT_FENCE_WAIT, submit_info.image_index);
+         vk_res = image_wait_present(sc_images[submit_info.image_index], UINT64_MAX);
       }
+      const uint64_t signaled_ns = submit_info.queued_ns != 0 ? monotonic_now_ns() : 0;
       if (vk_res != VK_SUCCESS)
       {
          WSI_LOG_ERROR("Page flip: image_wait_present failed for image %u with result %d",
                        submit_info.image_index, vk_res);
          set_error_state(vk_res);
          m_free_image_semaphore.post();
+         present_dequeued();
          continue;
       }
 
       call_present(submit_info);
+      present_dequeued();
+
+      if (submit_info.queued_ns != 0)
+      {
+         const uint64_t presented_ns = monotonic_now_ns();
+         metrics.RecordPresentLatency(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)),
+                                      signaled_ns - submit_info.queued_ns, presented_ns - signaled_ns);
+         if (m_frame_timing)
+         {
+            m_frame_timing->record(frame_stage::present_pickup, picked_up_ns - submit_info.queued_ns,
+                                   submit_info.frame_id);
+            m_frame_timing->record(frame_stage::present_fence_wait, signaled_ns - picked_up_ns, submit_info.frame_id);
+            m_frame_timing->record(frame_stage::present_work, presented_ns - signaled_ns, submit_info.frame_id);
+            m_frame_timing->end_frame(submit_info.frame_id);
+         }
+      }
    }
 }
 
 void swapchain_base::call_present(const pending_present_request &pending_present)
 {
+   if (pending_present.queued_ns != 0 && pending_present.present_mode != m_metrics_present_mode)
+   {
+      m_metrics_present_mode = pending_present.present_mode;
+      mali_wrapper::MetricsPage::Instance().RecordPresentMode(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)),
+                                                              get_metrics_backend(),
+                                                              static_cast<uint32_t>(pending_present.present_mode));
+   }
+
    /* First present of the swapchain. If it has an ancestor, wait until all the
     * pending buffers from the ancestor have been presented. */
    if (m_first_present)
@@ -149,6 +258,15 @@ void swapchain_base::call_present(const pending_present_request &pending_present
    }
 }
 
+void swapchain_base::record_display_latency(uint64_t queued_ns, uint64_t display_ns)
+{
+   if (queued_ns != 0 && display_ns > queued_ns)
+   {
+      mali_wrapper::MetricsPage::Instance().RecordDisplayLatency(
+         static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)), display_ns - queued_ns);
+   }
+}
+
 bool swapchain_base::has_descendant_started_presenting()
 {
    if (m_descendant == VK_NULL_HANDLE)
@@ -218,6 +336,7 @@ swapchain_base::swapchain_base(wsi::device_private_data &dev_data, const VkAlloc
    , m_surface(VK_NULL_HANDLE)
    , m_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
    , m_present_modes(m_allocator)
+   , m_last_present_mode(VK_PRESENT_MODE_IMMEDIATE_KHR)
    , m_descendant(VK_NULL_HANDLE)
    , m_ancestor(VK_NULL_HANDLE)
    , m_device(VK_NULL_HANDLE)
@@ -249,6 +368,15 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
    {
       TRY_LOG_CALL(ext->handle_swapchain_present_modes_create_info(device, swapchain_create_info, m_surface));
       TRY_LOG_CALL(ext->handle_scaling_create_info(device, swapchain_create_info, m_surface));
+      const auto &present_modes = ext->get_present_modes();
+      if (!m_present_modes.try_push_back_many(present_modes.data(), present_modes.data() + present_modes.size()))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+   else if (!m_present_modes.try_push_back(m_present_mode))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
    /* Init image to invalid values. */
@@ -257,12 +385,29 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
+   /* Before init_platform, so the backend can hand it to its presenters. Timing is best effort. */
+   if (frame_timing::is_enabled())
+   {
+      m_frame_timing = m_allocator.make_unique<frame_timing>(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)));
+   }
+
    /* We have allocated images, we can call the platform init function if something needs to be done. */
    bool use_presentation_thread = true;
    TRY_LOG_CALL(init_platform(device, swapchain_create_info, use_presentation_thread));
+   m_last_present_mode = m_present_mode;
 
    if (use_presentation_thread)
    {
+      /* Shared presentable images are presented once and never taken off the queue. */
+      if (m_present_mode != VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR &&
+          m_present_mode != VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR)
+      {
+         m_max_queued_presents = read_max_queued_presents();
+         if (m_max_queued_presents != 0)
+         {
+            WSI_LOG_INFO("Limiting the swapchain to %u queued presents.", m_max_queued_presents);
+         }
+      }
       TRY_LOG_CALL(init_page_flip_thread());
    }
 
@@ -291,26 +436,51 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
       return result;
    }
 
+   /* Set ancestor before the images are created, so the backend can take over compatible ones it is done with. */
+   m_ancestor = swapchain_create_info->oldSwapchain;
+
    const bool image_deferred_allocation =
       swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT;
-   for (auto &img : m_swapchain_images)
+   m_sync_fd_present_semaphores = fence_sync::supports_semaphore_payloads(m_device_data);
+   m_sync_fd_shared_waits = m_sync_fd_present_semaphores && fence_sync::supports_shared_sync_fd_waits(m_device_data);
+   if (!image_deferred_allocation && m_swapchain_images.size() > 1 && parallel_image_allocation_enabled() &&
+       can_allocate_images_in_parallel())
    {
-      TRY(create_swapchain_image(image_create_info, img));
-
-      if (image_deferred_allocation)
-      {
-         img.status = swapchain_image::UNALLOCATED;
-      }
-      else
+      /* The first image settles the format, and may still change it, so it is made on its own. */
+      TRY(create_swapchain_image(image_create_info, m_swapchain_images[0]));
+      TRY_LOG_CALL(allocate_and_bind_swapchain_image(image_create_info, m_swapchain_images[0]));
+      TRY_LOG_CALL(allocate_remaining_images_in_parallel(image_create_info));
+   }
+   else
+   {
+      for (auto &img : m_swapchain_images)
       {
-         TRY_LOG_CALL(allocate_and_bind_swapchain_image(image_create_info, img));
+         TRY(create_swapchain_image(image_create_info, img));
+
+         if (image_deferred_allocation)
+         {
+            img.status = swapchain_image::UNALLOCATED;
+         }
+         else
+         {
+            TRY_LOG_CALL(allocate_and_bind_swapchain_image(image_create_info, img));
+         }
       }
+   }
 
+   for (auto &img : m_swapchain_images)
+   {
       VkSemaphoreCreateInfo semaphore_info = {};
       semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
+      VkExportSemaphoreCreateInfo export_semaphore_info = {};
+      export_semaphore_info.sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO;
+      export_semaphore_info.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+      semaphore_info.pNext = m_sync_fd_present_semaphores ? &export_semaphore_info : nullptr;
       TRY_LOG_CALL(m_device_data.disp.CreateSemaphore(m_device, &semaphore_info, get_allocation_callbacks(),
                                                       &img.present_semaphore));
+
+      semaphore_info.pNext = nullptr;
       TRY_LOG_CALL(m_device_data.disp.CreateSemaphore(m_device, &semaphore_info, get_allocation_callbacks(),
                                                       &img.present_fence_wait));
    }
@@ -336,11 +506,8 @@ VkResult swapchain_base::init(VkDevice device, const VkSwapchainCreateInfoKHR *s
     * NB: This must be done last in initialization, when the rest of
     * the swapchain is valid.
     */
-   if (swapchain_create_info->oldSwapchain != VK_NULL_HANDLE)
+   if (m_ancestor != VK_NULL_HANDLE)
    {
-      /* Set ancestor. */
-      m_ancestor = swapchain_create_info->oldSwapchain;
-
       auto *ancestor = reinterpret_cast<swapchain_base *>(m_ancestor);
       ancestor->deprecate(reinterpret_cast<VkSwapchainKHR>(this));
    }
@@ -379,8 +546,9 @@ void swapchain_base::teardown()
    /* We are safe to destroy everything. */
    if (m_thread_sem_defined)
    {
-      /* Tell flip thread to end. */
+      /* Tell flip thread to end, waking it up if it waits for a present request. */
       m_page_flip_thread_run = false;
+      m_page_flip_semaphore.post();
 
       if (m_page_flip_thread.joinable())
       {
@@ -423,15 +591,25 @@ void swapchain_base::teardown()
 VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaphore, VkFence fence,
                                             uint32_t *image_index)
 {
+   const uint64_t wait_start_ns = m_frame_timing ? monotonic_now_ns() : 0;
    std::unique_lock<std::mutex> acquire_lock(m_image_acquire_lock);
 
-   VkResult wait_result = wait_for_free_buffer(timeout);
+   VkResult wait_result = wait_for_queued_presents(timeout);
+   if (wait_result != VK_SUCCESS)
+   {
+      return wait_result;
+   }
+
+   wait_result = wait_for_free_buffer(timeout);
    if (wait_result != VK_SUCCESS)
    {
       WSI_LOG_ERROR("AcquireNextImage: wait_for_free_buffer failed with result %d (timeout=%llu)", wait_result,
                     static_cast<unsigned long long>(timeout));
       return wait_result;
    }
+   /* The previous frame may not have been presented yet, so this labels the acquire with the next present. */
+   record_frame_stage(frame_stage::acquire_wait, m_frame_timing ? monotonic_now_ns() - wait_start_ns : 0,
+                      m_present_count.load(std::memory_order_relaxed) + 1);
    if (error_has_occured())
    {
       const VkResult error_state = get_error_state();
@@ -444,12 +622,20 @@ VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaph
    const size_t image_count = m_swapchain_images.size();
    const size_t start_index = image_count > 0 ? (m_next_image_index_hint % image_count) : 0;
 
+   /* Lazily, an image is only allocated when none of the allocated ones is free. */
+   const bool lazy = lazy_image_allocation_enabled();
    size_t selected_index = image_count;
+   size_t unallocated_index = image_count;
    for (size_t attempt = 0; attempt < image_count; ++attempt)
    {
       const size_t i = (start_index + attempt) % image_count;
       if (m_swapchain_images[i].status == swapchain_image::UNALLOCATED)
       {
+         if (lazy)
+         {
+            unallocated_index = std::min(unallocated_index, i);
+            continue;
+         }
          auto res = allocate_and_bind_swapchain_image(m_image_create_info, m_swapchain_images[i]);
          if (res != VK_SUCCESS)
          {
@@ -467,6 +653,20 @@ VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaph
       }
    }
 
+   if (selected_index == image_count && unallocated_index != image_count)
+   {
+      auto res = allocate_and_bind_swapchain_image(m_image_create_info, m_swapchain_images[unallocated_index]);
+      if (res != VK_SUCCESS)
+      {
+         WSI_LOG_ERROR("Failed to allocate swapchain image.");
+         return res != VK_ERROR_INITIALIZATION_FAILED ? res : VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      WSI_LOG_DEBUG("Lazily allocated swapchain image %zu.", unallocated_index);
+      m_swapchain_images[unallocated_index].status = swapchain_image::ACQUIRED;
+      *image_index = static_cast<uint32_t>(unallocated_index);
+      selected_index = unallocated_index;
+   }
+
    assert(selected_index < image_count);
    if (image_count > 0)
    {
@@ -475,22 +675,33 @@ VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaph
 
    image_status_lock.unlock();
 
-   /* Try to signal fences/semaphores with a sync FD for optimal performance. */
+   util::fd_owner release_fd = image_acquire_sync_fd(m_swapchain_images[selected_index]);
+
+   /* Try to signal fences/semaphores with a sync FD for optimal performance. A successful import owns the fd, -1
+    * being an already signalled one. */
    if (m_device_data.supports_sync_fd_signal_import())
    {
       if (fence != VK_NULL_HANDLE)
       {
-         int already_signalled_sentinel_fd = -1;
+         int fence_fd = release_fd.is_valid() ? dup(release_fd.get()) : -1;
+         if (release_fd.is_valid() && fence_fd < 0)
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
          auto info = VkImportFenceFdInfoKHR{};
          {
             info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
             info.fence = fence;
             info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
-            info.fd = already_signalled_sentinel_fd;
+            info.fd = fence_fd;
             info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
          }
 
          auto result = m_device_data.disp.ImportFenceFdKHR(m_device, &info);
+         if (result != VK_SUCCESS && fence_fd >= 0)
+         {
+            close(fence_fd);
+         }
          switch (result)
          {
          case VK_SUCCESS:
@@ -506,17 +717,25 @@ VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaph
 
       if (semaphore != VK_NULL_HANDLE)
       {
-         int already_signalled_sentinel_fd = -1;
+         int semaphore_fd = release_fd.is_valid() ? dup(release_fd.get()) : -1;
+         if (release_fd.is_valid() && semaphore_fd < 0)
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
          auto info = VkImportSemaphoreFdInfoKHR{};
          {
             info.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
             info.semaphore = semaphore;
             info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
             info.flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT;
-            info.fd = already_signalled_sentinel_fd;
+            info.fd = semaphore_fd;
          }
 
          auto result = m_device_data.disp.ImportSemaphoreFdKHR(m_device, &info);
+         if (result != VK_SUCCESS && semaphore_fd >= 0)
+         {
+            close(semaphore_fd);
+         }
          switch (result)
          {
          case VK_SUCCESS:
@@ -531,7 +750,21 @@ VkResult swapchain_base::acquire_next_image(uint64_t timeout, VkSemaphore semaph
       }
    }
 
-   /* Fallback for when importing fence/semaphore sync FDs is unsupported by the ICD. */
+   /* Fallback for when importing fence/semaphore sync FDs is unsupported by the ICD. The empty submission cannot
+    * wait on a sync file, so the release is waited for here. */
+   if (release_fd.is_valid() && (fence != VK_NULL_HANDLE || semaphore != VK_NULL_HANDLE))
+   {
+      struct pollfd release_poll = { release_fd.get(), POLLIN, 0 };
+      int poll_result;
+      while ((poll_result = poll(&release_poll, 1, -1)) < 0 && errno == EINTR)
+      {
+      }
+      if (poll_result < 0)
+      {
+         WSI_LOG_ERROR("AcquireNextImage: failed to wait for the image release fence.");
+         return VK_ERROR_SURFACE_LOST_KHR;
+      }
+   }
    queue_submit_semaphores semaphores = {
       nullptr,
       0,
@@ -595,33 +828,53 @@ VkResult swapchain_base::get_swapchain_status()
 
 VkResult swapchain_base::notify_presentation_engine(const pending_present_request &pending_present)
 {
-   const std::lock_guard<std::recursive_mutex> lock(m_image_status_mutex);
-
-   /* If the descendant has started presenting, we should release the image
-    * however we do not want to block inside the main thread so we mark it
-    * as free and let the page flip thread take care of it. */
-   const bool descendant_started_presenting = has_descendant_started_presenting();
-   if (descendant_started_presenting)
+   pending_present_request queued_present = pending_present;
+   if (m_frame_timing || mali_wrapper::MetricsPage::Instance().IsEnabled())
    {
-      m_swapchain_images[pending_present.image_index].status = swapchain_image::FREE;
-      m_free_image_semaphore.post();
-      return VK_ERROR_OUT_OF_DATE_KHR;
+      queued_present.queued_ns = monotonic_now_ns();
    }
 
-   m_swapchain_images[pending_present.image_index].status = swapchain_image::PENDING;
-   m_started_presenting = true;
-
-   if (m_page_flip_thread_run)
    {
-      bool buffer_pool_res = m_pending_buffer_pool.push_back(pending_present);
-      (void)buffer_pool_res;
-      assert(buffer_pool_res);
-      m_page_flip_semaphore.post();
+      const std::lock_guard<std::recursive_mutex> lock(m_image_status_mutex);
+
+      /* If the descendant has started presenting, we should release the image
+       * however we do not want to block inside the main thread so we mark it
+       * as free and let the page flip thread take care of it. */
+      const bool descendant_started_presenting = has_descendant_started_presenting();
+      if (descendant_started_presenting)
+      {
+         m_swapchain_images[pending_present.image_index].status = swapchain_image::FREE;
+         m_free_image_semaphore.post();
+         return VK_ERROR_OUT_OF_DATE_KHR;
+      }
+
+      m_swapchain_images[pending_present.image_index].status = swapchain_image::PENDING;
+      m_started_presenting = true;
+
+      if (!m_page_flip_thread_run)
+      {
+         const uint64_t present_start_ns = m_frame_timing ? monotonic_now_ns() : 0;
+         call_present(queued_present);
+         if (m_frame_timing)
+         {
+            m_frame_timing->record(frame_stage::present_work, monotonic_now_ns() - present_start_ns,
+                                   pending_present.frame_id);
+            m_frame_timing->end_frame(pending_present.frame_id);
+         }
+         return VK_SUCCESS;
+      }
    }
-   else
+
+   /* The page flip thread pops the request without taking m_image_status_mutex. */
+   if (m_max_queued_presents != 0)
    {
-      call_present(pending_present);
+      const std::lock_guard<std::mutex> queued_lock(m_queued_presents_mutex);
+      m_queued_presents++;
    }
+   bool buffer_pool_res = m_pending_buffer_pool.push_back(queued_present);
+   (void)buffer_pool_res;
+   assert(buffer_pool_res);
+   m_page_flip_semaphore.post();
 
    return VK_SUCCESS;
 }
@@ -629,6 +882,9 @@ VkResult swapchain_base::notify_presentation_engine(const pending_present_reques
 VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *present_info,
                                        const swapchain_presentation_parameters &submit_info)
 {
+   MALI_TRACE_SCOPE(QUEUE_PRESENT, submit_info.pending_present.image_index);
+   present_allocation_recorder allocations(this);
+
 #if VULKAN_WSI_LAYER_EXPERIMENTAL
    auto *ext = get_swapchain_extension<wsi::wsi_ext_present_timing>();
    if (ext)
@@ -646,6 +902,8 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
       if (ext)
       {
          TRY_LOG_CALL(ext->handle_switching_presentation_mode(submit_info.present_mode));
+         /* No reallocation: the backend adapts its pacing to the mode each request carries. */
+         m_last_present_mode = submit_info.present_mode;
       }
    }
 
@@ -657,13 +915,9 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
       sem_count = present_info->waitSemaphoreCount;
    }
 
-   if (!m_page_flip_thread_run)
-   {
-      /* If the page flip thread is not running, we need to wait for any present payload here, before setting a new present payload. */
-      constexpr uint64_t WAIT_PRESENT_TIMEOUT = 1000000000; /* 1 second */
-      TRY_LOG_CALL(
-         image_wait_present(m_swapchain_images[submit_info.pending_present.image_index], WAIT_PRESENT_TIMEOUT));
-   }
+   pending_present_request pending_present = submit_info.pending_present;
+   pending_present.frame_id = m_present_count.fetch_add(1, std::memory_order_relaxed) + 1;
+   pending_present.present_mode = m_last_present_mode;
 
    void *submission_pnext = nullptr;
    std::optional<VkFrameBoundaryEXT> frame_boundary;
@@ -677,9 +931,21 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
       if (frame_boundary)
       {
          submission_pnext = &frame_boundary.value();
+         pending_present.frame_id = frame_boundary->frameID;
       }
    }
 
+   if (!m_page_flip_thread_run)
+   {
+      /* If the page flip thread is not running, we need to wait for any present payload here, before setting a new present payload. */
+      constexpr uint64_t WAIT_PRESENT_TIMEOUT = 1000000000; /* 1 second */
+      const uint64_t wait_start_ns = m_frame_timing ? monotonic_now_ns() : 0;
+      TRY_LOG_CALL(
+         image_wait_present(m_swapchain_images[submit_info.pending_present.image_index], WAIT_PRESENT_TIMEOUT));
+      record_frame_stage(frame_stage::present_fence_wait, m_frame_timing ? monotonic_now_ns() - wait_start_ns : 0,
+                         pending_present.frame_id);
+   }
+
    queue_submit_semaphores semaphores = {
       wait_semaphores,
       sem_count,
@@ -687,6 +953,8 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
          &m_swapchain_images[submit_info.pending_present.image_index].present_fence_wait :
          nullptr,
       (submit_info.present_fence != VK_NULL_HANDLE) ? 1u : 0,
+      submit_info.use_image_present_semaphore && m_sync_fd_present_semaphores,
+      submit_info.use_image_present_semaphore ? submit_info.wait_sync_fd : nullptr,
    };
    TRY_LOG_CALL(image_set_present_payload(m_swapchain_images[submit_info.pending_present.image_index], queue,
                                           semaphores, submission_pnext));
@@ -702,11 +970,106 @@ VkResult swapchain_base::queue_present(VkQueue queue, const VkPresentInfoKHR *pr
       TRY(sync_queue_submit(m_device_data, queue, submit_info.present_fence, wait_semaphores));
    }
 
-   TRY(notify_presentation_engine(submit_info.pending_present));
+   TRY(notify_presentation_engine(pending_present));
+
+   return m_suboptimal.load(std::memory_order_relaxed) ? VK_SUBOPTIMAL_KHR : VK_SUCCESS;
+}
+
+bool swapchain_base::is_compression_allowed()
+{
+   if (!m_device_data.is_swapchain_compression_control_enabled())
+   {
+      return true;
+   }
+
+   auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+   return ext == nullptr || ext->get_bitmask_for_image_compression_flags() != VK_IMAGE_COMPRESSION_DISABLED_EXT;
+}
+
+VkResult swapchain_base::allocate_remaining_images_in_parallel(const VkImageCreateInfo &image_create_info)
+{
+   const size_t image_count = m_swapchain_images.size() - 1;
+   util::vector<VkResult> results(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   if (!results.try_resize(image_count, VK_SUCCESS))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   std::atomic<size_t> next_image{ 0 };
+   auto allocate_images = [&]() {
+      for (size_t i = next_image.fetch_add(1, std::memory_order_relaxed); i < image_count;
+           i = next_image.fetch_add(1, std::memory_order_relaxed))
+      {
+         swapchain_image &image = m_swapchain_images[i + 1];
+         results[i] = create_swapchain_image(image_create_info, image);
+         if (results[i] == VK_SUCCESS)
+         {
+            results[i] = allocate_swapchain_image_memory(image_create_info, image);
+         }
+      }
+   };
 
+   /* The calling thread takes an image too. Images a worker could not be started for are left to it. */
+   std::vector<std::thread> workers;
+   for (size_t i = 1; i < image_count; ++i)
+   {
+      try
+      {
+         workers.emplace_back([&allocate_images]() {
+            mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::WORKER, "swapchain image allocation");
+            allocate_images();
+         });
+      }
+      catch (const std::system_error &)
+      {
+         break;
+      }
+   }
+   allocate_images();
+   for (auto &worker : workers)
+   {
+      worker.join();
+   }
+
+   for (VkResult result : results)
+   {
+      TRY_LOG(result, "Failed to allocate a swapchain image in parallel");
+   }
+
+   /* Window system objects are made on this thread, in image order, once every image has its memory. */
+   for (size_t i = 1; i < m_swapchain_images.size(); ++i)
+   {
+      TRY_LOG_CALL(create_swapchain_image_presentable(image_create_info, m_swapchain_images[i]));
+   }
    return VK_SUCCESS;
 }
 
+bool swapchain_base::lazy_image_allocation_enabled()
+{
+   static const bool enabled = []() {
+      const char *value = std::getenv("WSI_LAZY_SWAPCHAIN_IMAGES");
+      const bool lazy = value != nullptr && value[0] == '1' && value[1] == '\0';
+      if (lazy)
+      {
+         WSI_LOG_INFO("Allocating swapchain image resources lazily.");
+      }
+      return lazy;
+   }();
+   return enabled;
+}
+
+bool swapchain_base::is_only_created_image(const swapchain_image &image) const
+{
+   for (const auto &other : m_swapchain_images)
+   {
+      if (&other != &image && other.data != nullptr)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
 void swapchain_base::deprecate(VkSwapchainKHR descendant)
 {
    for (auto &img : m_swapchain_images)
@@ -750,6 +1113,56 @@ void swapchain_base::wait_for_pending_buffers()
    }
 }
 
+VkResult swapchain_base::wait_for_queued_presents(uint64_t &timeout)
+{
+   if (m_max_queued_presents == 0)
+   {
+      return VK_SUCCESS;
+   }
+
+   std::unique_lock<std::mutex> lock(m_queued_presents_mutex);
+   /* Errors are reported by acquire right after, so they end the wait. */
+   auto below_limit = [this]() { return m_queued_presents < m_max_queued_presents || error_has_occured(); };
+   if (below_limit())
+   {
+      return VK_SUCCESS;
+   }
+   if (timeout == 0)
+   {
+      return VK_NOT_READY;
+   }
+   if (timeout >= static_cast<uint64_t>(INT64_MAX))
+   {
+      m_queued_presents_cv.wait(lock, below_limit);
+      return VK_SUCCESS;
+   }
+
+   const auto start = std::chrono::steady_clock::now();
+   if (!m_queued_presents_cv.wait_for(lock, std::chrono::nanoseconds(timeout), below_limit))
+   {
+      return VK_TIMEOUT;
+   }
+   const uint64_t elapsed =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+   timeout = elapsed < timeout ? timeout - elapsed : 0;
+   return VK_SUCCESS;
+}
+
+void swapchain_base::present_dequeued()
+{
+   if (m_max_queued_presents == 0)
+   {
+      return;
+   }
+
+   {
+      const std::lock_guard<std::mutex> lock(m_queued_presents_mutex);
+      assert(m_queued_presents > 0);
+      m_queued_presents--;
+   }
+   m_queued_presents_cv.notify_all();
+}
+
 void swapchain_base::clear_ancestor()
 {
    m_ancestor = VK_NULL_HANDLE;
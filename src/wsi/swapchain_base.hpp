@@ -35,14 +35,19 @@
 #include <vulkan/vulkan.h>
 #include <thread>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 #include "layer_utils/custom_allocator.hpp"
 #include "layer_utils/helpers.hpp"
-#include "layer_utils/ring_buffer.hpp"
+#include "layer_utils/spsc_ring_buffer.hpp"
 #include "layer_utils/timed_semaphore.hpp"
 #include "utils/logging.hpp"
 #include <wsi/wsi_private_data.hpp>
 
+#include "frame_timing.hpp"
 #include "surface_properties.hpp"
 #include "synchronization.hpp"
 
@@ -75,6 +80,20 @@ struct swapchain_image
    VkSemaphore present_fence_wait{ VK_NULL_HANDLE };
 };
 
+/**
+ * @brief Regions of an image changed since the previous present, from VkPresentRegionsKHR.
+ *
+ * Kept inline so that pending presents can be queued without allocating. rect_count of 0 means the whole
+ * image changed, which is also what is recorded when the application gives more rectangles than fit.
+ */
+struct present_damage
+{
+   static constexpr uint32_t MAX_RECTS = 16;
+
+   uint32_t rect_count{ 0 };
+   VkRect2D rects[MAX_RECTS];
+};
+
 struct pending_present_request
 {
    /* The index of the pending image to use for present. */
@@ -85,6 +104,30 @@ struct pending_present_request
     * If 0, no present ID has been assigned to this request.
     */
    uint64_t present_id;
+
+   /* Damage hint for this present. */
+   present_damage damage{};
+
+   /**
+    * Absolute time the application asked for the image to be presented at, in the time domain of the present
+    * stage it targets. If 0, the image is presented as soon as possible.
+    */
+   uint64_t target_present_time{ 0 };
+
+   /*
+    * CLOCK_MONOTONIC time the request was queued for the page flip thread, 0 unless the metrics page or frame
+    * timing is enabled.
+    */
+   uint64_t queued_ns{ 0 };
+
+   /* Label of the frame in the frame timing: its VkFrameBoundaryEXT frameID, or the present count without one. */
+   uint64_t frame_id{ 0 };
+
+   /*
+    * Presentation mode of this present: the one VkSwapchainPresentModeInfoEXT switched to, or the last one the
+    * swapchain presented with. Backends read this rather than m_present_mode, which is the create info's mode.
+    */
+   VkPresentModeKHR present_mode{ VK_PRESENT_MODE_FIFO_KHR };
 };
 
 struct swapchain_presentation_parameters
@@ -106,6 +149,12 @@ struct swapchain_presentation_parameters
     */
    VkBool32 use_image_present_semaphore{ true };
 
+   /**
+    * Sync FD the present's wait semaphores were exported to once for all its swapchains, or nullptr. Stands in
+    * for the image's present_semaphore, which nothing signalled, and is only set with use_image_present_semaphore.
+    */
+   const util::fd_owner *wait_sync_fd{ nullptr };
+
    /* Contains details about the pending present request */
    pending_present_request pending_present{};
 
@@ -251,6 +300,17 @@ public:
       return m_swapchain_images[image_index].present_semaphore;
    }
 
+   /**
+    * @brief Whether the swapchain can take the wait of a multi-swapchain present as a shared Sync FD.
+    *
+    * When every swapchain of a present can, the wait semaphores are submitted and exported once, and
+    * swapchain_presentation_parameters::wait_sync_fd hands the Sync FD to each of them.
+    */
+   bool supports_shared_wait_sync_fd() const
+   {
+      return m_sync_fd_shared_waits;
+   }
+
    /**
     * @brief Get the swapchain status.
     *
@@ -352,12 +412,14 @@ protected:
 
    /**
     * @brief In order to present the images in a FIFO order we implement
-    * a ring buffer to hold the images queued for presentation. Since the
-    * two pointers (head and tail) are used by different
-    * threads and we do not allow the application to acquire more images
-    * than we have we eliminate race conditions.
+    * a ring buffer to hold the images queued for presentation. Presents
+    * to a swapchain are externally synchronized, so queue_present is its
+    * only producer and the page flip thread its only consumer, and neither
+    * needs m_image_status_mutex for it. We do not allow the application to
+    * acquire more images than we have, so it never fills up.
     */
-   util::ring_buffer<pending_present_request, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT> m_pending_buffer_pool;
+   util::spsc_ring_buffer<pending_present_request, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT>
+      m_pending_buffer_pool;
 
    /**
     * @brief User provided memory allocation callbacks.
@@ -375,15 +437,34 @@ protected:
    VkSurfaceKHR m_surface;
 
    /**
-    * @brief Present mode currently being used for this swapchain
+    * @brief Present mode the swapchain was created with, or the one the backend fell back to in init_platform.
+    *
+    * Presents carry their own mode in pending_present_request::present_mode.
     */
    VkPresentModeKHR m_present_mode;
 
    /**
     * @brief Possible presentation modes this swapchain is allowed to present with VkSwapchainPresentModesCreateInfoEXT
+    *
+    * Filled before init_platform, so backends can set up for every mode they may be switched to. Holds only the
+    * create info's mode when the application listed none.
     */
    util::vector<VkPresentModeKHR> m_present_modes;
 
+   /**
+    * @brief Mode the next present uses unless VkSwapchainPresentModeInfoEXT switches it. Only queue_present
+    * accesses it.
+    */
+   VkPresentModeKHR m_last_present_mode;
+
+   /**
+    * @brief Whether presents may switch to @p present_mode.
+    */
+   bool is_present_mode_allowed(VkPresentModeKHR present_mode) const
+   {
+      return std::find(m_present_modes.begin(), m_present_modes.end(), present_mode) != m_present_modes.end();
+   }
+
    /**
     * @brief Descendant of this swapchain.
     * Used to check whether or not a descendant of this swapchain has started
@@ -396,7 +477,8 @@ protected:
     * @brief Ancestor of this swapchain.
     * Used to check whether the ancestor swapchain has completed all of its
     * pending page flips (this is required before this swapchain presents for the
-    * first time.
+    * first time. It is set before the images are created, and the ancestor is
+    * only deprecated once they all have been.
     */
    VkSwapchainKHR m_ancestor;
 
@@ -501,6 +583,51 @@ protected:
     */
    virtual VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) = 0;
 
+   /**
+    * @brief Whether init may create all but the first image concurrently, with create_swapchain_image and
+    * allocate_swapchain_image_memory called on several threads at once.
+    *
+    * Only asked once init_platform has chosen the presentation path.
+    */
+   virtual bool can_allocate_images_in_parallel() const
+   {
+      return false;
+   }
+
+   /**
+    * @brief The part of allocate_and_bind_swapchain_image that is safe to run for several images at once: allocating,
+    * importing and binding the memory. No window system objects are made here.
+    *
+    * Only used for images created after the first, whose format is settled, so there is no retry with another
+    * format.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return Returns VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   virtual VkResult allocate_swapchain_image_memory(VkImageCreateInfo image_create_info, swapchain_image &image)
+   {
+      return allocate_and_bind_swapchain_image(image_create_info, image);
+   }
+
+   /**
+    * @brief Creates the window system objects of an image set up by allocate_swapchain_image_memory. Called on one
+    * thread, for one image after the other.
+    *
+    * @param image_create_info Data to be used to create the image.
+    * @param image             Handle to the image.
+    *
+    * @return Returns VK_SUCCESS on success, otherwise an appropriate error code.
+    */
+   virtual VkResult create_swapchain_image_presentable(const VkImageCreateInfo &image_create_info,
+                                                      swapchain_image &image)
+   {
+      UNUSED(image_create_info);
+      UNUSED(image);
+      return VK_SUCCESS;
+   }
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -522,6 +649,22 @@ protected:
     */
    virtual void present_image(const pending_present_request &pending_present) = 0;
 
+   /**
+    * @brief Present path the metrics page reports the swapchain under, one of mali_wrapper::metrics_backend.
+    */
+   virtual uint32_t get_metrics_backend() const
+   {
+      return mali_wrapper::metrics_backend::unknown;
+   }
+
+   /**
+    * @brief Report to the metrics page that a frame queued at @p queued_ns reached the display at @p display_ns.
+    *
+    * Both times are CLOCK_MONOTONIC. Presents with no queued_ns, queued while the metrics page and frame timing were
+    * off, are ignored. Safe to call from any thread.
+    */
+   void record_display_latency(uint64_t queued_ns, uint64_t display_ns);
+
    /**
     * @brief Transition a presented image to free.
     *
@@ -559,6 +702,22 @@ protected:
       return VK_SUCCESS;
    }
 
+   /**
+    * @brief Get the fence the application's use of an acquired image has to wait for.
+    *
+    * For windowing systems that hand images back before they are done reading them, and signal a fence once they
+    * are. The acquire semaphore and fence then only signal after it.
+    *
+    * @param image The image being acquired.
+    *
+    * @return A sync file that signals when the image may be written, or an invalid fd if it already may be.
+    */
+   virtual util::fd_owner image_acquire_sync_fd(swapchain_image &image)
+   {
+      UNUSED(image);
+      return {};
+   }
+
    /**
     * @brief Sets the present payload for a swapchain image.
     *
@@ -613,7 +772,83 @@ protected:
       m_error_state = state;
    }
 
+   /**
+    * @brief Wake an acquire that waits for a free image.
+    *
+    * For backend event threads that free images: after they set the error state and stop, nothing else would
+    * wake a waiter, which then reports the error.
+    */
+   void wake_acquire_waiter()
+   {
+      m_free_image_semaphore.post();
+   }
+
+   /**
+    * @brief Make later presents return VK_SUBOPTIMAL_KHR.
+    *
+    * For swapchains that still work but that the surface would be better served by recreating, e.g. when the
+    * compositor could scan out buffers of another format.
+    */
+   void set_suboptimal()
+   {
+      m_suboptimal.store(true, std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Whether the application allows compressed swapchain images.
+    *
+    * False only when it passed VK_IMAGE_COMPRESSION_DISABLED_EXT through VK_EXT_image_compression_control.
+    */
+   bool is_compression_allowed();
+
+   /**
+    * @brief Returns the frame timing of the swapchain, or nullptr unless frame_timing::is_enabled().
+    *
+    * Valid for the lifetime of the swapchain, so backends may hand it to helpers that record stages on their own
+    * threads.
+    */
+   frame_timing *get_frame_timing()
+   {
+      return m_frame_timing.get();
+   }
+
+   /**
+    * @brief Account @p duration_ns to @p stage of the frame @p frame_id, when frame timing is enabled.
+    */
+   void record_frame_stage(uint32_t stage, uint64_t duration_ns, uint64_t frame_id)
+   {
+      if (m_frame_timing)
+      {
+         m_frame_timing->record(stage, duration_ns, frame_id);
+      }
+   }
+
+   /**
+    * @brief Whether @p image is the only swapchain image created so far.
+    *
+    * Until a second image exists, the format chosen for the first one can still be changed.
+    */
+   bool is_only_created_image(const swapchain_image &image) const;
+
+   /**
+    * @brief Whether WSI_LAZY_SWAPCHAIN_IMAGES=1 asks for swapchain image resources to be made on first use.
+    *
+    * Images of swapchains created with VK_SWAPCHAIN_CREATE_DEFERRED_MEMORY_ALLOCATION_BIT_EXT are then allocated
+    * only when no allocated image is free to acquire. Other images are bound at creation, as the application may
+    * use them before it acquires them, so only backend resources the application never sees can wait.
+    */
+   static bool lazy_image_allocation_enabled();
+
 private:
+   /**
+    * @brief Creates and allocates every image but the first on a few threads, then makes their window system
+    * objects on the calling thread.
+    *
+    * Brings swapchain creation close to the cost of one image, as the dma-buf allocations and imports of the
+    * images no longer wait for each other.
+    */
+   VkResult allocate_remaining_images_in_parallel(const VkImageCreateInfo &image_create_info);
+
    std::mutex m_image_acquire_lock;
    /**
     * @brief Round-robin hint for acquire image selection.
@@ -631,11 +866,65 @@ private:
     */
    VkResult m_error_state;
 
+   /** Set by set_suboptimal() from the presentation thread, read by queue_present(). */
+   std::atomic<bool> m_suboptimal{ false };
+
    /**
     * @brief Wait for a buffer to become free.
     */
    VkResult wait_for_free_buffer(uint64_t timeout);
 
+   /**
+    * @brief Most presents queued for the page flip thread and not yet presented, 0 for no limit.
+    *
+    * Set from WSI_MAX_QUEUED_PRESENTS. Acquire blocks while the limit is reached, so with 1 the application only
+    * starts a frame once the previous one has been handed to the presentation engine.
+    */
+   uint32_t m_max_queued_presents{ 0 };
+
+   /** Presents queued for the page flip thread, only counted with @ref m_max_queued_presents. */
+   uint32_t m_queued_presents{ 0 };
+   std::mutex m_queued_presents_mutex;
+   std::condition_variable m_queued_presents_cv;
+
+   /**
+    * @brief Wait until fewer than @ref m_max_queued_presents presents are queued.
+    *
+    * @param[in,out] timeout Time to wait in nanoseconds, reduced by the time waited.
+    *
+    * @return VK_SUCCESS, or VK_NOT_READY / VK_TIMEOUT if the limit is still reached.
+    */
+   VkResult wait_for_queued_presents(uint64_t &timeout);
+
+   /**
+    * @brief Account for a present the page flip thread has taken off the queue and finished with.
+    */
+   void present_dequeued();
+
+   /**
+    * @brief Whether the image present semaphores are exportable to Sync FDs.
+    *
+    * Set when fence_sync::supports_semaphore_payloads holds. Presents that wait on them then set the image present
+    * payload without a queue submission.
+    */
+   bool m_sync_fd_present_semaphores{ false };
+
+   /**
+    * @brief Whether a Sync FD can also be imported back into the image present semaphores.
+    *
+    * Set when fence_sync::supports_shared_sync_fd_waits holds as well, see @ref supports_shared_wait_sync_fd.
+    */
+   bool m_sync_fd_shared_waits{ false };
+
+   /** Per-frame timing breakdown, nullptr unless frame_timing::is_enabled(). */
+   util::unique_ptr<frame_timing> m_frame_timing;
+
+   /** Present mode last reported to the metrics page. Only call_present accesses it. */
+   VkPresentModeKHR m_metrics_present_mode{ VK_PRESENT_MODE_MAX_ENUM_KHR };
+
+   /** Presents queued so far, which label the frames that have no VkFrameBoundaryEXT frameID. */
+   std::atomic<uint64_t> m_present_count{ 0 };
+
    /**
     * @brief A semaphore to be signalled once a free image becomes available.
     *
@@ -33,6 +33,9 @@
 #include "layer_utils/helpers.hpp"
 
 #include <algorithm>
+#include <cassert>
+
+#include <unistd.h>
 
 namespace wsi
 {
@@ -57,6 +60,82 @@ std::optional<fence_sync> fence_sync::create(wsi::device_private_data &device)
    return fence_sync(device, fence);
 }
 
+bool fence_sync::supports_semaphore_payloads(const wsi::device_private_data &device)
+{
+   auto &instance = device.instance_data;
+   if (!device.supports_import_fence_fd || !device.disp.get_fn<PFN_vkGetSemaphoreFdKHR>("vkGetSemaphoreFdKHR") ||
+       !instance.disp.get_fn<PFN_vkGetPhysicalDeviceExternalSemaphorePropertiesKHR>(
+          "vkGetPhysicalDeviceExternalSemaphorePropertiesKHR"))
+   {
+      return false;
+   }
+
+   VkPhysicalDeviceExternalSemaphoreInfo external_semaphore_info = {};
+   external_semaphore_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+   external_semaphore_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   VkExternalSemaphoreProperties semaphore_properties = {};
+   semaphore_properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+   instance.disp.GetPhysicalDeviceExternalSemaphorePropertiesKHR(device.physical_device, &external_semaphore_info,
+                                                                 &semaphore_properties);
+
+   VkPhysicalDeviceExternalFenceInfo external_fence_info = {};
+   external_fence_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_FENCE_INFO;
+   external_fence_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+   VkExternalFenceProperties fence_properties = {};
+   fence_properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_FENCE_PROPERTIES;
+   instance.disp.GetPhysicalDeviceExternalFencePropertiesKHR(device.physical_device, &external_fence_info,
+                                                             &fence_properties);
+
+   return (semaphore_properties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT) &&
+          (fence_properties.externalFenceFeatures & VK_EXTERNAL_FENCE_FEATURE_IMPORTABLE_BIT);
+}
+
+bool fence_sync::supports_shared_sync_fd_waits(const wsi::device_private_data &device)
+{
+   if (!device.supports_import_semaphore_fd || !supports_semaphore_payloads(device))
+   {
+      return false;
+   }
+
+   VkPhysicalDeviceExternalSemaphoreInfo external_semaphore_info = {};
+   external_semaphore_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO;
+   external_semaphore_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   VkExternalSemaphoreProperties semaphore_properties = {};
+   semaphore_properties.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES;
+   device.instance_data.disp.GetPhysicalDeviceExternalSemaphorePropertiesKHR(
+      device.physical_device, &external_semaphore_info, &semaphore_properties);
+
+   return semaphore_properties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_IMPORTABLE_BIT;
+}
+
+/* Temporarily imports a duplicate of sync_fd into the semaphore, which the next wait on it consumes. */
+static VkResult import_semaphore_sync_fd(const wsi::device_private_data &device, VkSemaphore semaphore,
+                                         const util::fd_owner &sync_fd)
+{
+   int fd = -1;
+   if (sync_fd.is_valid())
+   {
+      fd = dup(sync_fd.get());
+      if (fd < 0)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   VkImportSemaphoreFdInfoKHR import_info = {};
+   import_info.sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR;
+   import_info.semaphore = semaphore;
+   import_info.flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT;
+   import_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   import_info.fd = fd;
+   VkResult result = device.disp.ImportSemaphoreFdKHR(device.device, &import_info);
+   if (result != VK_SUCCESS && fd >= 0)
+   {
+      close(fd);
+   }
+   return result;
+}
+
 fence_sync::fence_sync(fence_sync &&rhs)
 {
    *this = std::move(rhs);
@@ -94,7 +173,8 @@ VkResult fence_sync::wait_payload(uint64_t timeout)
    return res;
 }
 
-VkResult fence_sync::set_payload(VkQueue queue, const queue_submit_semaphores &semaphores, const void *submission_pnext)
+VkResult fence_sync::set_payload(VkQueue queue, const queue_submit_semaphores &semaphores, const void *submission_pnext,
+                                 const VkCommandBuffer *command_buffers, uint32_t command_buffer_count)
 {
    VkResult result = dev->disp.ResetFences(dev->device, 1, &fence);
    if (result != VK_SUCCESS)
@@ -103,7 +183,37 @@ VkResult fence_sync::set_payload(VkQueue queue, const queue_submit_semaphores &s
    }
    has_payload = false;
 
-   result = sync_queue_submit(*dev, queue, fence, semaphores, submission_pnext);
+   const bool submission_needed =
+      semaphores.signal_semaphores_count != 0 || submission_pnext != nullptr || command_buffer_count != 0;
+   if (semaphores.wait_sync_fd != nullptr)
+   {
+      if (!submission_needed)
+      {
+         result = import_sync_fd(*semaphores.wait_sync_fd);
+         if (result == VK_SUCCESS)
+         {
+            has_payload = true;
+            payload_finished = false;
+         }
+         return result;
+      }
+
+      /* The submission waits on the lone wait semaphore, which nothing signalled; it takes the Sync FD instead. */
+      assert(semaphores.wait_semaphores_count == 1);
+      TRY(import_semaphore_sync_fd(*dev, semaphores.wait_semaphores[0], *semaphores.wait_sync_fd));
+   }
+   else if (semaphores.sync_fd_wait_semaphores && semaphores.wait_semaphores_count == 1 && !submission_needed)
+   {
+      result = import_semaphore_payload(semaphores.wait_semaphores[0]);
+      if (result == VK_SUCCESS)
+      {
+         has_payload = true;
+         payload_finished = false;
+      }
+      return result;
+   }
+
+   result = sync_queue_submit(*dev, queue, fence, semaphores, submission_pnext, command_buffers, command_buffer_count);
    if (result == VK_SUCCESS)
    {
       has_payload = true;
@@ -120,6 +230,58 @@ bool fence_sync::swap_payload(bool new_payload)
    return old_payload;
 }
 
+VkResult fence_sync::import_sync_fd(const util::fd_owner &sync_fd)
+{
+   int fd = -1;
+   if (sync_fd.is_valid())
+   {
+      fd = dup(sync_fd.get());
+      if (fd < 0)
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   VkImportFenceFdInfoKHR import_info = {};
+   import_info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
+   import_info.fence = fence;
+   import_info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
+   import_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+   import_info.fd = fd;
+   VkResult result = dev->disp.ImportFenceFdKHR(dev->device, &import_info);
+   if (result != VK_SUCCESS && fd >= 0)
+   {
+      close(fd);
+   }
+   return result;
+}
+
+VkResult fence_sync::import_semaphore_payload(VkSemaphore semaphore)
+{
+   VkSemaphoreGetFdInfoKHR semaphore_fd_info = {};
+   semaphore_fd_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR;
+   semaphore_fd_info.semaphore = semaphore;
+   semaphore_fd_info.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT;
+   int sync_fd = -1;
+   TRY(dev->disp.GetSemaphoreFdKHR(dev->device, &semaphore_fd_info, &sync_fd));
+
+   /* A Sync FD of -1 means the payload already completed, which the import accepts as signaled. On success the
+    * fence owns the file descriptor.
+    */
+   VkImportFenceFdInfoKHR import_info = {};
+   import_info.sType = VK_STRUCTURE_TYPE_IMPORT_FENCE_FD_INFO_KHR;
+   import_info.fence = fence;
+   import_info.flags = VK_FENCE_IMPORT_TEMPORARY_BIT;
+   import_info.handleType = VK_EXTERNAL_FENCE_HANDLE_TYPE_SYNC_FD_BIT;
+   import_info.fd = sync_fd;
+   VkResult result = dev->disp.ImportFenceFdKHR(dev->device, &import_info);
+   if (result != VK_SUCCESS && sync_fd >= 0)
+   {
+      close(sync_fd);
+   }
+   return result;
+}
+
 sync_fd_fence_sync::sync_fd_fence_sync(wsi::device_private_data &device, VkFence vk_fence)
    : fence_sync{ device, vk_fence }
 {
@@ -170,13 +332,16 @@ std::optional<util::fd_owner> sync_fd_fence_sync::export_sync_fd()
 }
 
 VkResult sync_queue_submit(const wsi::device_private_data &device, VkQueue queue, VkFence fence,
-                           const queue_submit_semaphores &semaphores, const void *submission_pnext)
+                           const queue_submit_semaphores &semaphores, const void *submission_pnext,
+                           const VkCommandBuffer *command_buffers, uint32_t command_buffer_count)
 {
    /* When the semaphore that comes in is signalled, we know that all work is done. So, we do not
     * want to block any future Vulkan queue work on it. So, we pass in BOTTOM_OF_PIPE bit as the
-    * wait flag.
+    * wait flag. Command buffers riding on the payload do need the wait, so it covers them instead.
     */
-   VkPipelineStageFlags pipeline_stage_flag = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+   const VkPipelineStageFlags wait_stage =
+      command_buffer_count > 0 ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+   VkPipelineStageFlags pipeline_stage_flag = wait_stage;
    VkPipelineStageFlags *pipeline_stage_flag_data = &pipeline_stage_flag;
 
    util::vector<VkPipelineStageFlags> pipeline_stage_flags_vector{ util::allocator(
@@ -188,8 +353,7 @@ VkResult sync_queue_submit(const wsi::device_private_data &device, VkQueue queue
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
-      std::fill(pipeline_stage_flags_vector.begin(), pipeline_stage_flags_vector.end(),
-                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+      std::fill(pipeline_stage_flags_vector.begin(), pipeline_stage_flags_vector.end(), wait_stage);
       pipeline_stage_flag_data = pipeline_stage_flags_vector.data();
    }
 
@@ -198,8 +362,8 @@ VkResult sync_queue_submit(const wsi::device_private_data &device, VkQueue queue
                                 semaphores.wait_semaphores_count,
                                 semaphores.wait_semaphores,
                                 pipeline_stage_flag_data,
-                                0,
-                                nullptr,
+                                command_buffer_count,
+                                command_buffers,
                                 semaphores.signal_semaphores_count,
                                 semaphores.signal_semaphores };
 
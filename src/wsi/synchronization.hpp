@@ -46,6 +46,18 @@ struct queue_submit_semaphores
    uint32_t wait_semaphores_count;
    const VkSemaphore *signal_semaphores;
    uint32_t signal_semaphores_count;
+   /**
+    * The wait semaphores were created exportable to Sync FDs, see fence_sync::supports_semaphore_payloads. A single
+    * one then becomes a fence payload without a queue submission.
+    */
+   bool sync_fd_wait_semaphores{ false };
+   /**
+    * Sync FD the wait of a multi-swapchain present was exported to once, shared by all its swapchains, or nullptr.
+    * It replaces the wait semaphores: the fence imports a duplicate of it, and a payload that still needs a
+    * submission first imports a duplicate into the lone wait semaphore. An invalid fd stands for a wait that had
+    * already completed.
+    */
+   const util::fd_owner *wait_sync_fd{ nullptr };
 };
 
 /**
@@ -63,6 +75,27 @@ public:
     */
    static std::optional<fence_sync> create(wsi::device_private_data &device);
 
+   /**
+    * Checks if a device can move a semaphore payload into a fence through a Sync FD, which lets
+    * @ref set_payload skip its queue submission.
+    *
+    * @param device The device private data to check support for.
+    *
+    * @return true if semaphores can be exported to and fences imported from Sync FDs, false otherwise.
+    */
+   static bool supports_semaphore_payloads(const wsi::device_private_data &device);
+
+   /**
+    * Checks if a device can also import Sync FDs into semaphores, on top of @ref supports_semaphore_payloads, which
+    * lets the swapchains of one present share the Sync FD of a single wait through
+    * queue_submit_semaphores::wait_sync_fd.
+    *
+    * @param device The device private data to check support for.
+    *
+    * @return true if Sync FDs can be imported into semaphores and fences, false otherwise.
+    */
+   static bool supports_shared_sync_fd_waits(const wsi::device_private_data &device);
+
    fence_sync() = default;
    fence_sync(const fence_sync &) = delete;
    fence_sync &operator=(const fence_sync &) = delete;
@@ -87,16 +120,22 @@ public:
    /**
     * Sets the payload for the fence that would need to complete before operations that wait on it.
     *
+    * A lone wait semaphore flagged with queue_submit_semaphores::sync_fd_wait_semaphores is exported as a Sync FD and
+    * imported into the fence instead of submitting, when nothing else has to ride on the submission.
+    *
     * @note This method is not threadsafe.
     *
     * @param     queue  The Vulkan queue that may be used to submit synchronization commands.
     * @param     semaphores The wait and signal semaphores.
     * @param     submission_pnext   Chain of pointers to attach to the payload submission.
+    * @param     command_buffers    Optional command buffers to run as part of the payload.
+    * @param     command_buffer_count Number of entries in command_buffers.
     *
     * @return VK_SUCCESS on success or other error code on failing to set the payload.
     */
    VkResult set_payload(VkQueue queue, const queue_submit_semaphores &semaphores,
-                        const void *submission_pnext = nullptr);
+                        const void *submission_pnext = nullptr, const VkCommandBuffer *command_buffers = nullptr,
+                        uint32_t command_buffer_count = 0);
 
 protected:
    /**
@@ -121,6 +160,24 @@ protected:
     */
    bool swap_payload(bool new_payload);
 
+   /**
+    * Moves the payload of a semaphore into the fence through a Sync FD. The semaphore is unsignaled as if waited on.
+    *
+    * @param semaphore A semaphore created exportable to Sync FDs, with a pending or completed signal operation.
+    *
+    * @return VK_SUCCESS on success or other error code on failing to transfer the payload.
+    */
+   VkResult import_semaphore_payload(VkSemaphore semaphore);
+
+   /**
+    * Imports a duplicate of a Sync FD into the fence. The caller keeps @p sync_fd.
+    *
+    * @param sync_fd The Sync FD to wait for, or an invalid fd for a payload that already completed.
+    *
+    * @return VK_SUCCESS on success or other error code on failing to import the payload.
+    */
+   VkResult import_sync_fd(const util::fd_owner &sync_fd);
+
    wsi::device_private_data &get_device()
    {
       return *dev;
@@ -188,9 +245,12 @@ private:
  *                   of a fence to be signalled.
  * @param semaphores The wait and signal semaphores.
  * @param submission_pnext Chain of pointers to attach to the payload submission.
+ * @param command_buffers  Optional command buffers to execute once the wait semaphores are signalled.
+ * @param command_buffer_count Number of entries in command_buffers.
  *
  * @return VK_SUCCESS on success, an appropiate error code otherwise.
  */
 VkResult sync_queue_submit(const wsi::device_private_data &device, VkQueue queue, VkFence fence,
-                           const queue_submit_semaphores &semaphores, const void *submission_pnext = nullptr);
+                           const queue_submit_semaphores &semaphores, const void *submission_pnext = nullptr,
+                           const VkCommandBuffer *command_buffers = nullptr, uint32_t command_buffer_count = 0);
 } /* namespace wsi */
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of zwp_linux_dmabuf_feedback_v1 tracking.
+ */
+
+#include "dmabuf_feedback.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "utils/logging.hpp"
+#include "../layer_utils/macros.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+namespace
+{
+VWL_CAPI_CALL(void)
+feedback_done_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback) VWL_API_POST
+{
+   UNUSED(feedback);
+   reinterpret_cast<dmabuf_feedback *>(data)->on_done();
+}
+
+VWL_CAPI_CALL(void)
+feedback_format_table_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback, int32_t fd,
+                           uint32_t size) VWL_API_POST
+{
+   UNUSED(feedback);
+   reinterpret_cast<dmabuf_feedback *>(data)->on_format_table(fd, size);
+}
+
+/* Buffers are allocated by wsialloc, not on a device of our choosing, so the devices are not needed. */
+VWL_CAPI_CALL(void)
+feedback_main_device_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback, wl_array *device) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(device);
+}
+
+VWL_CAPI_CALL(void)
+feedback_tranche_done_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback) VWL_API_POST
+{
+   UNUSED(feedback);
+   reinterpret_cast<dmabuf_feedback *>(data)->on_tranche_done();
+}
+
+VWL_CAPI_CALL(void)
+feedback_tranche_target_device_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback,
+                                    wl_array *device) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(device);
+}
+
+VWL_CAPI_CALL(void)
+feedback_tranche_formats_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback, wl_array *indices) VWL_API_POST
+{
+   UNUSED(feedback);
+   reinterpret_cast<dmabuf_feedback *>(data)->on_tranche_formats(indices);
+}
+
+VWL_CAPI_CALL(void)
+feedback_tranche_flags_impl(void *data, zwp_linux_dmabuf_feedback_v1 *feedback, uint32_t flags) VWL_API_POST
+{
+   UNUSED(feedback);
+   reinterpret_cast<dmabuf_feedback *>(data)->on_tranche_flags(flags);
+}
+
+const zwp_linux_dmabuf_feedback_v1_listener feedback_listener = {
+   .done = feedback_done_impl,
+   .format_table = feedback_format_table_impl,
+   .main_device = feedback_main_device_impl,
+   .tranche_done = feedback_tranche_done_impl,
+   .tranche_target_device = feedback_tranche_target_device_impl,
+   .tranche_formats = feedback_tranche_formats_impl,
+   .tranche_flags = feedback_tranche_flags_impl,
+};
+} // namespace
+
+dmabuf_feedback::dmabuf_feedback(const util::allocator &allocator)
+   : m_feedback(nullptr)
+   , m_pending_formats(allocator)
+   , m_pending_scanout_formats(allocator)
+   , m_tranche_formats(allocator)
+   , m_formats(allocator)
+   , m_scanout_formats(allocator)
+{
+}
+
+dmabuf_feedback::~dmabuf_feedback()
+{
+   unmap_format_table();
+}
+
+bool dmabuf_feedback::init(zwp_linux_dmabuf_v1 *dmabuf_interface, wl_surface *surface)
+{
+   m_feedback.reset(zwp_linux_dmabuf_v1_get_surface_feedback(dmabuf_interface, surface));
+   if (m_feedback.get() == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to create zwp_linux_dmabuf_feedback_v1 object.");
+      return false;
+   }
+
+   if (zwp_linux_dmabuf_feedback_v1_add_listener(m_feedback.get(), &feedback_listener, this) < 0)
+   {
+      WSI_LOG_ERROR("Failed to add zwp_linux_dmabuf_feedback_v1 listener.");
+      return false;
+   }
+   return true;
+}
+
+bool dmabuf_feedback::get_formats(util::vector<drm_format_pair> &formats)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   formats.clear();
+   return formats.try_push_back_many(m_formats.data(), m_formats.data() + m_formats.size());
+}
+
+bool dmabuf_feedback::is_scanout_format(const drm_format_pair &format)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   for (const auto &scanout_format : m_scanout_formats)
+   {
+      if (scanout_format.fourcc == format.fourcc && scanout_format.modifier == format.modifier)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+bool dmabuf_feedback::has_scanout_fourcc(uint32_t fourcc)
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   for (const auto &scanout_format : m_scanout_formats)
+   {
+      if (scanout_format.fourcc == fourcc)
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+uint32_t dmabuf_feedback::get_generation()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+   return m_generation;
+}
+
+bool dmabuf_feedback::add_unique(util::vector<drm_format_pair> &formats, const drm_format_pair &format)
+{
+   for (const auto &existing : formats)
+   {
+      if (existing.fourcc == format.fourcc && existing.modifier == format.modifier)
+      {
+         return true;
+      }
+   }
+   return formats.try_push_back(format);
+}
+
+void dmabuf_feedback::unmap_format_table()
+{
+   if (m_format_table != nullptr)
+   {
+      munmap(const_cast<format_table_entry *>(m_format_table), m_format_table_size);
+      m_format_table = nullptr;
+      m_format_table_size = 0;
+   }
+}
+
+void dmabuf_feedback::on_format_table(int32_t fd, uint32_t size)
+{
+   unmap_format_table();
+
+   void *table = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (table == MAP_FAILED)
+   {
+      WSI_LOG_ERROR("Failed to map the dmabuf feedback format table.");
+      return;
+   }
+
+   m_format_table = static_cast<const format_table_entry *>(table);
+   m_format_table_size = size;
+}
+
+void dmabuf_feedback::on_tranche_formats(const wl_array *indices)
+{
+   const size_t table_entries = m_format_table_size / sizeof(format_table_entry);
+   const uint16_t *index = static_cast<const uint16_t *>(indices->data);
+   const size_t index_count = indices->size / sizeof(uint16_t);
+
+   for (size_t i = 0; i < index_count; ++i)
+   {
+      if (index[i] >= table_entries)
+      {
+         continue;
+      }
+
+      const format_table_entry &entry = m_format_table[index[i]];
+      if (!m_tranche_formats.try_push_back(drm_format_pair{ entry.fourcc, entry.modifier }))
+      {
+         m_pending_out_of_memory = true;
+      }
+   }
+}
+
+void dmabuf_feedback::on_tranche_flags(uint32_t flags)
+{
+   m_tranche_scanout = (flags & ZWP_LINUX_DMABUF_FEEDBACK_V1_TRANCHE_FLAGS_SCANOUT) != 0;
+}
+
+void dmabuf_feedback::on_tranche_done()
+{
+   /* Tranches arrive in decreasing preference, so earlier ones stay ahead in the combined list. */
+   for (const auto &format : m_tranche_formats)
+   {
+      if (!add_unique(m_pending_formats, format) ||
+          (m_tranche_scanout && !add_unique(m_pending_scanout_formats, format)))
+      {
+         m_pending_out_of_memory = true;
+      }
+   }
+   m_tranche_formats.clear();
+   m_tranche_scanout = false;
+}
+
+void dmabuf_feedback::on_done()
+{
+   if (m_pending_out_of_memory)
+   {
+      WSI_LOG_ERROR("Host got out of memory while receiving dmabuf feedback, keeping the previous one.");
+   }
+   else
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_formats.swap(m_pending_formats);
+      m_scanout_formats.swap(m_pending_scanout_formats);
+      m_generation++;
+      WSI_LOG_DEBUG("dmabuf feedback %u: %zu formats, %zu for scanout", m_generation, m_formats.size(),
+                    m_scanout_formats.size());
+   }
+
+   /* The next feedback resends every tranche. */
+   m_pending_formats.clear();
+   m_pending_scanout_formats.clear();
+   m_tranche_formats.clear();
+   m_tranche_scanout = false;
+   m_pending_out_of_memory = false;
+}
+
+} // namespace wayland
+} // namespace wsi
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Tracking of zwp_linux_dmabuf_feedback_v1 for a Wayland surface.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "wsi/surface.hpp"
+#include "wl_object_owner.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+/**
+ * @brief Formats and modifiers the compositor prefers for one surface, from zwp_linux_dmabuf_v1 version 4.
+ *
+ * Keeps the tranches of the latest complete feedback: every format in preference order and the ones the
+ * compositor can scan out directly. Events are processed on the queue of the zwp_linux_dmabuf_v1 object the
+ * feedback was created from; the queries below may be called from any thread.
+ */
+class dmabuf_feedback
+{
+public:
+   explicit dmabuf_feedback(const util::allocator &allocator);
+   ~dmabuf_feedback();
+
+   dmabuf_feedback(const dmabuf_feedback &) = delete;
+   dmabuf_feedback &operator=(const dmabuf_feedback &) = delete;
+
+   /**
+    * @brief Request the feedback for @p surface.
+    *
+    * @return false if the feedback object could not be created.
+    */
+   bool init(zwp_linux_dmabuf_v1 *dmabuf_interface, wl_surface *surface);
+
+   /**
+    * @brief Copy the formats of the latest feedback, most preferred first, without duplicates.
+    *
+    * @return false if the host ran out of memory.
+    */
+   bool get_formats(util::vector<drm_format_pair> &formats);
+
+   /**
+    * @brief Whether @p format is in a scanout tranche of the latest feedback.
+    */
+   bool is_scanout_format(const drm_format_pair &format);
+
+   /**
+    * @brief Whether any scanout tranche of the latest feedback holds @p fourcc.
+    */
+   bool has_scanout_fourcc(uint32_t fourcc);
+
+   /**
+    * @brief Number of complete feedbacks received so far; changes whenever the compositor sends new feedback.
+    */
+   uint32_t get_generation();
+
+   /* Event handlers for the zwp_linux_dmabuf_feedback_v1 listener. */
+   void on_format_table(int32_t fd, uint32_t size);
+   void on_tranche_formats(const wl_array *indices);
+   void on_tranche_flags(uint32_t flags);
+   void on_tranche_done();
+   void on_done();
+
+private:
+   /** Entry of the format table shared by the compositor. */
+   struct format_table_entry
+   {
+      uint32_t fourcc;
+      uint32_t padding;
+      uint64_t modifier;
+   };
+
+   bool add_unique(util::vector<drm_format_pair> &formats, const drm_format_pair &format);
+   void unmap_format_table();
+
+   wayland_owner<zwp_linux_dmabuf_feedback_v1> m_feedback;
+   const format_table_entry *m_format_table{ nullptr };
+   size_t m_format_table_size{ 0 };
+
+   /** Feedback being received, until its done event. */
+   util::vector<drm_format_pair> m_pending_formats;
+   util::vector<drm_format_pair> m_pending_scanout_formats;
+   util::vector<drm_format_pair> m_tranche_formats;
+   bool m_tranche_scanout{ false };
+   bool m_pending_out_of_memory{ false };
+
+   /** Protects the latest complete feedback below. */
+   std::mutex m_mutex;
+   util::vector<drm_format_pair> m_formats;
+   util::vector<drm_format_pair> m_scanout_formats;
+   uint32_t m_generation{ 0 };
+};
+
+} // namespace wayland
+} // namespace wsi
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Implementation of DRM timeline syncobjs.
+ */
+
+#include "drm_syncobj.hpp"
+
+#include <fcntl.h>
+#include <xf86drm.h>
+
+#include <cstdint>
+#include <utility>
+
+#include "utils/logging.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+util::fd_owner open_syncobj_timeline_device()
+{
+   drmDevicePtr devices[64];
+   const int device_count = drmGetDevices2(0, devices, sizeof(devices) / sizeof(devices[0]));
+   if (device_count <= 0)
+   {
+      return {};
+   }
+
+   util::fd_owner result;
+   for (int node_type : { DRM_NODE_RENDER, DRM_NODE_PRIMARY })
+   {
+      for (int i = 0; i < device_count && !result.is_valid(); ++i)
+      {
+         if ((devices[i]->available_nodes & (1 << node_type)) == 0)
+         {
+            continue;
+         }
+
+         util::fd_owner drm_fd{ open(devices[i]->nodes[node_type], O_RDWR | O_CLOEXEC) };
+         uint64_t timeline_support = 0;
+         if (drm_fd.is_valid() && drmGetCap(drm_fd.get(), DRM_CAP_SYNCOBJ_TIMELINE, &timeline_support) == 0 &&
+             timeline_support != 0)
+         {
+            WSI_LOG_INFO("Using %s for timeline syncobjs.", devices[i]->nodes[node_type]);
+            result = std::move(drm_fd);
+         }
+      }
+   }
+
+   drmFreeDevices(devices, device_count);
+   return result;
+}
+
+drm_syncobj_timeline::drm_syncobj_timeline(int drm_fd, uint32_t handle, uint32_t binary_handle)
+   : m_drm_fd(drm_fd)
+   , m_handle(handle)
+   , m_binary_handle(binary_handle)
+{
+}
+
+drm_syncobj_timeline::drm_syncobj_timeline(drm_syncobj_timeline &&rhs)
+{
+   *this = std::move(rhs);
+}
+
+drm_syncobj_timeline &drm_syncobj_timeline::operator=(drm_syncobj_timeline &&rhs)
+{
+   std::swap(m_drm_fd, rhs.m_drm_fd);
+   std::swap(m_handle, rhs.m_handle);
+   std::swap(m_binary_handle, rhs.m_binary_handle);
+   return *this;
+}
+
+drm_syncobj_timeline::~drm_syncobj_timeline()
+{
+   if (m_handle != 0)
+   {
+      drmSyncobjDestroy(m_drm_fd, m_handle);
+   }
+   if (m_binary_handle != 0)
+   {
+      drmSyncobjDestroy(m_drm_fd, m_binary_handle);
+   }
+}
+
+std::optional<drm_syncobj_timeline> drm_syncobj_timeline::create(int drm_fd)
+{
+   uint32_t handle = 0;
+   if (drmSyncobjCreate(drm_fd, 0, &handle) != 0)
+   {
+      return std::nullopt;
+   }
+
+   uint32_t binary_handle = 0;
+   if (drmSyncobjCreate(drm_fd, 0, &binary_handle) != 0)
+   {
+      drmSyncobjDestroy(drm_fd, handle);
+      return std::nullopt;
+   }
+
+   return drm_syncobj_timeline(drm_fd, handle, binary_handle);
+}
+
+util::fd_owner drm_syncobj_timeline::export_fd() const
+{
+   int fd = -1;
+   if (drmSyncobjHandleToFD(m_drm_fd, m_handle, &fd) != 0)
+   {
+      return {};
+   }
+   return util::fd_owner{ fd };
+}
+
+bool drm_syncobj_timeline::attach_sync_file(uint64_t point, int sync_fd)
+{
+   if (sync_fd < 0)
+   {
+      return drmSyncobjTimelineSignal(m_drm_fd, &m_handle, &point, 1) == 0;
+   }
+
+   /* Sync files can only be imported into binary syncobjs, point 0 of which is then moved to the timeline. */
+   return drmSyncobjImportSyncFile(m_drm_fd, m_binary_handle, sync_fd) == 0 &&
+          drmSyncobjTransfer(m_drm_fd, m_handle, point, m_binary_handle, 0, 0) == 0;
+}
+
+util::fd_owner drm_syncobj_timeline::export_sync_file(uint64_t point)
+{
+   /* The compositor may only attach the fence of a release point after it sent wl_buffer::release. */
+   if (drmSyncobjTransfer(m_drm_fd, m_binary_handle, 0, m_handle, point, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT) != 0)
+   {
+      return {};
+   }
+
+   int sync_fd = -1;
+   if (drmSyncobjExportSyncFile(m_drm_fd, m_binary_handle, &sync_fd) != 0)
+   {
+      return {};
+   }
+   return util::fd_owner{ sync_fd };
+}
+
+bool drm_syncobj_timeline::wait(uint64_t point)
+{
+   return drmSyncobjTimelineWait(m_drm_fd, &m_handle, &point, 1, INT64_MAX, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT,
+                                 nullptr) == 0;
+}
+
+bool drm_syncobj_timeline::has_signalled(uint64_t point)
+{
+   /* A timeout already in the past only polls; a point without a fence yet fails with -EINVAL. */
+   return drmSyncobjTimelineWait(m_drm_fd, &m_handle, &point, 1, 0, 0, nullptr) == 0;
+}
+
+} // namespace wayland
+} // namespace wsi
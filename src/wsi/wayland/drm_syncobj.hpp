@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief DRM timeline syncobjs for wp_linux_drm_syncobj_v1 explicit synchronization.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "../layer_utils/file_descriptor.hpp"
+#include "../layer_utils/helpers.hpp"
+
+namespace wsi
+{
+namespace wayland
+{
+
+/**
+ * @brief Open a DRM node whose driver supports timeline syncobjs.
+ *
+ * Syncobjs only carry dma-fences, so any device can create the ones shared with the compositor. Render nodes are
+ * tried first as they need no DRM master.
+ *
+ * @return The opened node, or an invalid fd if no node supports them.
+ */
+util::fd_owner open_syncobj_timeline_device();
+
+/**
+ * @brief A timeline syncobj on a DRM device, with helpers to move sync files in and out of its points.
+ *
+ * The device fd must outlive the object.
+ */
+class drm_syncobj_timeline : private util::noncopyable
+{
+public:
+   drm_syncobj_timeline() = default;
+   drm_syncobj_timeline(drm_syncobj_timeline &&rhs);
+   drm_syncobj_timeline &operator=(drm_syncobj_timeline &&rhs);
+   ~drm_syncobj_timeline();
+
+   /**
+    * @brief Create a timeline on @p drm_fd, as opened by open_syncobj_timeline_device().
+    *
+    * @return The timeline or an empty optional on failure.
+    */
+   static std::optional<drm_syncobj_timeline> create(int drm_fd);
+
+   /**
+    * @brief Export the timeline, for wp_linux_drm_syncobj_manager_v1::import_timeline.
+    *
+    * @return The exported fd, invalid on failure.
+    */
+   util::fd_owner export_fd() const;
+
+   /**
+    * @brief Make @p point signal together with a sync file.
+    *
+    * @param point   The point to set, which must be later than all points set before.
+    * @param sync_fd The sync file, or -1 to signal the point right away. It is not closed.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool attach_sync_file(uint64_t point, int sync_fd);
+
+   /**
+    * @brief Export the fence of @p point as a sync file, waiting for the point to be given one first.
+    *
+    * @return The sync file, invalid on failure.
+    */
+   util::fd_owner export_sync_file(uint64_t point);
+
+   /**
+    * @brief Block until @p point has signalled.
+    *
+    * @return true on success, false otherwise.
+    */
+   bool wait(uint64_t point);
+
+   /**
+    * @brief Check without blocking whether @p point has signalled.
+    *
+    * @return true if it has, false if not, or if it cannot be told.
+    */
+   bool has_signalled(uint64_t point);
+
+private:
+   drm_syncobj_timeline(int drm_fd, uint32_t handle, uint32_t binary_handle);
+
+   int m_drm_fd{ -1 };
+   uint32_t m_handle{ 0 };
+   /** Binary syncobj that sync files pass through on their way in and out of the timeline. */
+   uint32_t m_binary_handle{ 0 };
+};
+
+} // namespace wayland
+} // namespace wsi
@@ -30,28 +30,91 @@
 
 #include "present_timing_handler.hpp"
 
-wsi_ext_present_timing_wayland::wsi_ext_present_timing_wayland(const util::allocator &allocator)
+#include <wayland-client.h>
+#include <presentation-time-client-protocol.h>
+
+wsi_ext_present_timing_wayland::wsi_ext_present_timing_wayland(const util::allocator &allocator,
+                                                               VkPresentStageFlagsEXT presented_stages)
    : wsi_ext_present_timing(allocator)
+   , m_presented_stages(presented_stages)
+   , m_refresh_duration(0)
+   , m_timing_properties_counter(0)
 {
 }
 
 util::unique_ptr<wsi_ext_present_timing_wayland> wsi_ext_present_timing_wayland::create(
-   const util::allocator &allocator)
+   const util::allocator &allocator, clockid_t presentation_clock)
 {
-   std::array<util::unique_ptr<wsi::vulkan_time_domain>, 1> time_domains_array = {
-      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT,
-                                                     VK_TIME_DOMAIN_DEVICE_KHR)
-   };
+   /* Compositors normally use CLOCK_MONOTONIC; any other clock has no Vulkan time domain to report in. */
+   VkTimeDomainKHR presentation_domain = VK_TIME_DOMAIN_MAX_ENUM_KHR;
+   if (presentation_clock == CLOCK_MONOTONIC)
+   {
+      presentation_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR;
+   }
+   else if (presentation_clock == CLOCK_MONOTONIC_RAW)
+   {
+      presentation_domain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_KHR;
+   }
+
+   const VkPresentStageFlagsEXT presented_stages =
+      presentation_domain != VK_TIME_DOMAIN_MAX_ENUM_KHR ?
+         (VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT) :
+         0;
+
+   auto present_timing = allocator.make_unique<wsi_ext_present_timing_wayland>(allocator, presented_stages);
+   if (present_timing == nullptr)
+   {
+      return nullptr;
+   }
 
-   return wsi_ext_present_timing::create<wsi_ext_present_timing_wayland>(allocator, time_domains_array);
+   if (!present_timing->get_swapchain_time_domains().add_time_domain(allocator.make_unique<wsi::vulkan_time_domain>(
+          VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT, VK_TIME_DOMAIN_DEVICE_KHR)))
+   {
+      WSI_LOG_ERROR("Failed to add a time domain.");
+      return nullptr;
+   }
+
+   if (presented_stages != 0 &&
+       !present_timing->get_swapchain_time_domains().add_time_domain(
+          allocator.make_unique<wsi::vulkan_time_domain>(presented_stages, presentation_domain)))
+   {
+      WSI_LOG_ERROR("Failed to add a time domain.");
+      return nullptr;
+   }
+
+   return present_timing;
 }
 
 VkResult wsi_ext_present_timing_wayland::get_swapchain_timing_properties(
    uint64_t &timing_properties_counter, VkSwapchainTimingPropertiesEXT &timing_properties)
 {
-   timing_properties_counter = 0;
-   timing_properties.refreshDuration = 0;
+   timing_properties_counter = m_timing_properties_counter.load();
+   timing_properties.refreshDuration = m_refresh_duration.load();
    timing_properties.variableRefreshDelay = 0;
 
    return VK_SUCCESS;
+}
+
+void wsi_ext_present_timing_wayland::report_presented(uint64_t present_id, uint64_t time_ns, uint32_t refresh_ns,
+                                                      uint32_t flags)
+{
+   if (m_refresh_duration.exchange(refresh_ns) != refresh_ns)
+   {
+      m_timing_properties_counter++;
+   }
+
+   /* The timestamp is when the frame started scanning out. Only with zero copy was our own buffer latched by the
+    * display at that time; a composited frame was latched by the compositor at some unknown time before. Without
+    * hardware completion the time is the compositor's estimate, which is still the best value available. */
+   VkPresentStageFlagsEXT stages = m_presented_stages;
+   if ((flags & WP_PRESENTATION_FEEDBACK_KIND_ZERO_COPY) == 0)
+   {
+      stages &= ~VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT;
+   }
+   complete_presentation_entry(present_id, stages, time_ns);
+}
+
+void wsi_ext_present_timing_wayland::report_discarded(uint64_t present_id)
+{
+   complete_presentation_entry(present_id, 0, 0);
 }
\ No newline at end of file
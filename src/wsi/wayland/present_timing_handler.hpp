@@ -33,6 +33,9 @@
 
 #include <wsi/extensions/present_timing.hpp>
 
+#include <atomic>
+#include <time.h>
+
 /**
  * @brief Present timing extension class
  *
@@ -41,13 +44,53 @@
 class wsi_ext_present_timing_wayland : public wsi::wsi_ext_present_timing
 {
 public:
-   static util::unique_ptr<wsi_ext_present_timing_wayland> create(const util::allocator &allocator);
+   /**
+    * @brief Create the extension.
+    *
+    * @param allocator          Allocator for the extension.
+    * @param presentation_clock Clock of the wp_presentation timestamps. The presented stages are only reported when
+    *                           it maps to a Vulkan time domain.
+    */
+   static util::unique_ptr<wsi_ext_present_timing_wayland> create(const util::allocator &allocator,
+                                                                  clockid_t presentation_clock);
 
    VkResult get_swapchain_timing_properties(uint64_t &timing_properties_counter,
                                             VkSwapchainTimingPropertiesEXT &timing_properties) override;
 
+   /**
+    * @brief Record a wp_presentation_feedback::presented event for a present.
+    *
+    * @param present_id The present id of the present.
+    * @param time_ns    Presentation timestamp in the presentation clock.
+    * @param refresh_ns Refresh interval of the output, 0 if unknown.
+    * @param flags      wp_presentation_feedback_kind flags of the event.
+    */
+   void report_presented(uint64_t present_id, uint64_t time_ns, uint32_t refresh_ns, uint32_t flags);
+
+   /**
+    * @brief Record a wp_presentation_feedback::discarded event for a present.
+    *
+    * @param present_id The present id of the present.
+    */
+   void report_discarded(uint64_t present_id);
+
 private:
-   wsi_ext_present_timing_wayland(const util::allocator &allocator);
+   wsi_ext_present_timing_wayland(const util::allocator &allocator, VkPresentStageFlagsEXT presented_stages);
+
+   /**
+    * @brief Stages that have a time domain for the presented timestamps, 0 if the clock has none.
+    */
+   VkPresentStageFlagsEXT m_presented_stages;
+
+   /**
+    * @brief Refresh interval of the last presented event.
+    */
+   std::atomic<uint64_t> m_refresh_duration;
+
+   /**
+    * @brief Incremented every time @ref m_refresh_duration changes.
+    */
+   std::atomic<uint64_t> m_timing_properties_counter;
 
    /* Allow util::allocator to access the private constructor */
    friend util::allocator;
@@ -26,7 +26,12 @@
  * @brief Implementation of a Wayland WSI Surface
  */
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
 #include "surface.hpp"
+#include "drm_syncobj.hpp"
 #include "swapchain.hpp"
 #include "surface_properties.hpp"
 #include "wl_object_owner.hpp"
@@ -72,6 +77,14 @@ zwp_linux_dmabuf_v1_modifier_impl(void *data, struct zwp_linux_dmabuf_v1 *dma_bu
       drm_supported_formats->is_out_of_memory = !drm_supported_formats->formats->try_push_back(format);
    }
 }
+
+/* Handler for clock_id event of the wp_presentation interface. */
+VWL_CAPI_CALL(void)
+presentation_clock_id_impl(void *data, wp_presentation *presentation, uint32_t clk_id) VWL_API_POST
+{
+   UNUSED(presentation);
+   *reinterpret_cast<clockid_t *>(data) = static_cast<clockid_t>(clk_id);
+}
 } // namespace
 
 /*
@@ -122,6 +135,46 @@ static VkResult get_supported_formats_and_modifiers(wl_display *display, wl_even
    return VK_SUCCESS;
 }
 
+/*
+ * @brief Read the wp_viewport destination size from WSI_WAYLAND_VIEWPORT.
+ *
+ * The value is <width>x<height> in surface coordinates, such as the window size an application renders below.
+ *
+ * @param[out] width  Destination width.
+ * @param[out] height Destination height.
+ *
+ * @return true when the variable holds a valid size.
+ */
+static bool read_viewport_destination(int32_t *width, int32_t *height)
+{
+   const char *value = std::getenv("WSI_WAYLAND_VIEWPORT");
+   if (value == nullptr || value[0] == '\0')
+   {
+      return false;
+   }
+
+   char *end = nullptr;
+   const long parsed_width = std::strtol(value, &end, 10);
+   if (end == value || (*end != 'x' && *end != 'X'))
+   {
+      WSI_LOG_WARNING("Ignoring WSI_WAYLAND_VIEWPORT=%s, expected <width>x<height>.", value);
+      return false;
+   }
+
+   const char *height_start = end + 1;
+   const long parsed_height = std::strtol(height_start, &end, 10);
+   if (end == height_start || *end != '\0' || parsed_width <= 0 || parsed_height <= 0 || parsed_width > INT32_MAX ||
+       parsed_height > INT32_MAX)
+   {
+      WSI_LOG_WARNING("Ignoring WSI_WAYLAND_VIEWPORT=%s, expected <width>x<height>.", value);
+      return false;
+   }
+
+   *width = static_cast<int32_t>(parsed_width);
+   *height = static_cast<int32_t>(parsed_height);
+   return true;
+}
+
 struct surface::init_parameters
 {
    const util::allocator &allocator;
@@ -136,6 +189,12 @@ surface::surface(const init_parameters &params)
    , wayland_surface(params.surf)
    , supported_formats(params.allocator)
    , properties(this, params.allocator)
+   , surface_feedback(params.allocator)
+   , has_dmabuf_feedback(false)
+   , presentation_clock(CLOCK_MONOTONIC)
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   , tearing_hint_async(false)
+#endif
    , last_frame_callback(nullptr)
    , present_pending(false)
 {
@@ -149,8 +208,11 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
 
    if (!strcmp(interface, zwp_linux_dmabuf_v1_interface.name) && version >= ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION)
    {
-      zwp_linux_dmabuf_v1 *dmabuf_interface_obj = reinterpret_cast<zwp_linux_dmabuf_v1 *>(wl_registry_bind(
-         wl_registry, name, &zwp_linux_dmabuf_v1_interface, ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION));
+      /* Version 4 adds per-surface feedback, including which formats can be scanned out. */
+      const uint32_t bind_version =
+         std::min<uint32_t>(version, ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION);
+      zwp_linux_dmabuf_v1 *dmabuf_interface_obj = reinterpret_cast<zwp_linux_dmabuf_v1 *>(
+         wl_registry_bind(wl_registry, name, &zwp_linux_dmabuf_v1_interface, bind_version));
 
       if (dmabuf_interface_obj == nullptr)
       {
@@ -186,7 +248,88 @@ surface_registry_handler(void *data, struct wl_registry *wl_registry, uint32_t n
       }
 
       wsi_surface->presentation_time_interface.reset(wp_presentation_obj);
+
+      /* The clock_id event is dispatched by the roundtrip that follows the registry one in init(). */
+      static const wp_presentation_listener presentation_listener = {
+         .clock_id = presentation_clock_id_impl,
+      };
+      if (wp_presentation_add_listener(wp_presentation_obj, &presentation_listener, &wsi_surface->presentation_clock) <
+          0)
+      {
+         WSI_LOG_ERROR("Failed to add wp_presentation listener.");
+      }
+   }
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   else if (!strcmp(interface, wp_fifo_manager_v1_interface.name))
+   {
+      wp_fifo_manager_v1 *fifo_manager_obj =
+         reinterpret_cast<wp_fifo_manager_v1 *>(wl_registry_bind(wl_registry, name, &wp_fifo_manager_v1_interface, 1));
+
+      if (fifo_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_fifo_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->fifo_manager_interface.reset(fifo_manager_obj);
+   }
+   else if (!strcmp(interface, wp_commit_timing_manager_v1_interface.name))
+   {
+      wp_commit_timing_manager_v1 *commit_timing_manager_obj = reinterpret_cast<wp_commit_timing_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_commit_timing_manager_v1_interface, 1));
+
+      if (commit_timing_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_commit_timing_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->commit_timing_manager_interface.reset(commit_timing_manager_obj);
+   }
+#endif
+   else if (!strcmp(interface, wp_viewporter_interface.name))
+   {
+      wp_viewporter *viewporter_obj =
+         reinterpret_cast<wp_viewporter *>(wl_registry_bind(wl_registry, name, &wp_viewporter_interface, 1));
+
+      if (viewporter_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_viewporter interface.");
+         return;
+      }
+
+      wsi_surface->viewporter_interface.reset(viewporter_obj);
    }
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   else if (!strcmp(interface, wp_tearing_control_manager_v1_interface.name))
+   {
+      wp_tearing_control_manager_v1 *tearing_control_manager_obj = reinterpret_cast<wp_tearing_control_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_tearing_control_manager_v1_interface, 1));
+
+      if (tearing_control_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_tearing_control_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->tearing_control_manager_interface.reset(tearing_control_manager_obj);
+   }
+#endif
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   else if (!strcmp(interface, wp_linux_drm_syncobj_manager_v1_interface.name))
+   {
+      wp_linux_drm_syncobj_manager_v1 *syncobj_manager_obj = reinterpret_cast<wp_linux_drm_syncobj_manager_v1 *>(
+         wl_registry_bind(wl_registry, name, &wp_linux_drm_syncobj_manager_v1_interface, 1));
+
+      if (syncobj_manager_obj == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to get wp_linux_drm_syncobj_manager_v1 interface.");
+         return;
+      }
+
+      wsi_surface->syncobj_manager_interface.reset(syncobj_manager_obj);
+   }
+#endif
 }
 
 bool surface::init()
@@ -239,7 +382,31 @@ bool surface::init()
       //return false;
    }
 
-   if (explicit_sync_interface.get() != nullptr)
+   bool use_surface_sync = explicit_sync_interface.get() != nullptr;
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (syncobj_manager_interface.get() != nullptr)
+   {
+      syncobj_device = open_syncobj_timeline_device();
+      if (!syncobj_device.is_valid())
+      {
+         WSI_LOG_WARNING("No DRM device supports timeline syncobjs, not using wp_linux_drm_syncobj_v1.");
+      }
+      else
+      {
+         syncobj_surface.reset(
+            wp_linux_drm_syncobj_manager_v1_get_surface(syncobj_manager_interface.get(), wayland_surface));
+         if (syncobj_surface.get() == nullptr)
+         {
+            WSI_LOG_ERROR("Failed to create wp_linux_drm_syncobj_surface_v1 for the surface.");
+            return false;
+         }
+      }
+   }
+
+   /* The timeline points carry the acquire fence as well, the older protocol is not used alongside them. */
+   use_surface_sync = use_surface_sync && syncobj_surface.get() == nullptr;
+#endif
+   if (use_surface_sync)
    {
       auto surface_sync_obj =
          zwp_linux_explicit_synchronization_v1_get_synchronization(explicit_sync_interface.get(), wayland_surface);
@@ -252,11 +419,103 @@ bool surface::init()
       surface_sync_interface.reset(surface_sync_obj);
    }
 
-   VkResult vk_res = get_supported_formats_and_modifiers(wayland_display, surface_queue.get(), dmabuf_interface.get(),
-                                                         supported_formats);
-   if (vk_res != VK_SUCCESS)
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   if (fifo_manager_interface.get() != nullptr)
    {
-      return false;
+      fifo.reset(wp_fifo_manager_v1_get_fifo(fifo_manager_interface.get(), wayland_surface));
+      if (fifo.get() == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to create wp_fifo_v1 for the surface.");
+         return false;
+      }
+   }
+
+   if (commit_timing_manager_interface.get() != nullptr)
+   {
+      commit_timer.reset(wp_commit_timing_manager_v1_get_timer(commit_timing_manager_interface.get(), wayland_surface));
+      if (commit_timer.get() == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to create wp_commit_timer_v1 for the surface.");
+         return false;
+      }
+   }
+#endif
+
+   int32_t viewport_width = 0;
+   int32_t viewport_height = 0;
+   if (read_viewport_destination(&viewport_width, &viewport_height))
+   {
+      if (viewporter_interface.get() == nullptr)
+      {
+         WSI_LOG_WARNING("WSI_WAYLAND_VIEWPORT is set but the compositor has no wp_viewporter, buffers are shown at "
+                         "their own size.");
+      }
+      else
+      {
+         viewport.reset(wp_viewporter_get_viewport(viewporter_interface.get(), wayland_surface));
+         if (viewport.get() == nullptr)
+         {
+            WSI_LOG_ERROR("Failed to create wp_viewport for the surface.");
+            return false;
+         }
+
+         /* Double-buffered, applied with the first buffer the swapchain commits. */
+         wp_viewport_set_destination(viewport.get(), viewport_width, viewport_height);
+         WSI_LOG_INFO("Wayland surface scales every buffer to %dx%d through wp_viewport.", viewport_width,
+                      viewport_height);
+      }
+   }
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   if (tearing_control_manager_interface.get() != nullptr)
+   {
+      tearing_control.reset(
+         wp_tearing_control_manager_v1_get_tearing_control(tearing_control_manager_interface.get(), wayland_surface));
+      if (tearing_control.get() == nullptr)
+      {
+         WSI_LOG_ERROR("Failed to create wp_tearing_control_v1 for the surface.");
+         return false;
+      }
+   }
+#endif
+
+   /* From version 4 on the format and modifier events are no longer sent; the feedback carries the formats. */
+   const uint32_t dmabuf_version = zwp_linux_dmabuf_v1_get_version(dmabuf_interface.get());
+   if (dmabuf_version >= ZWP_LINUX_DMABUF_V1_GET_SURFACE_FEEDBACK_SINCE_VERSION)
+   {
+      if (!surface_feedback.init(dmabuf_interface.get(), wayland_surface))
+      {
+         return false;
+      }
+
+      res = wl_display_roundtrip_queue(wayland_display, surface_queue.get());
+      if (res < 0)
+      {
+         WSI_LOG_ERROR("Roundtrip failed.");
+         return false;
+      }
+
+      if (surface_feedback.get_generation() == 0)
+      {
+         WSI_LOG_ERROR("Compositor sent no dmabuf feedback for the surface.");
+         return false;
+      }
+
+      if (!surface_feedback.get_formats(supported_formats))
+      {
+         WSI_LOG_ERROR("Host got out of memory.");
+         return false;
+      }
+      has_dmabuf_feedback = true;
+   }
+   else
+   {
+      VkResult vk_res = get_supported_formats_and_modifiers(wayland_display, surface_queue.get(),
+                                                            dmabuf_interface.get(), supported_formats);
+      if (vk_res != VK_SUCCESS)
+      {
+         return false;
+      }
    }
 
    return true;
@@ -361,5 +620,39 @@ bool surface::wait_next_frame_event()
    return true;
 }
 
+bool surface::supports_tearing() const
+{
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   return tearing_control.get() != nullptr;
+#else
+   return false;
+#endif
+}
+
+void surface::set_tearing_hint(bool async)
+{
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   if (tearing_control.get() == nullptr || tearing_hint_async == async)
+   {
+      return;
+   }
+
+   wp_tearing_control_v1_set_presentation_hint(tearing_control.get(),
+                                               async ? WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC :
+                                                       WP_TEARING_CONTROL_V1_PRESENTATION_HINT_VSYNC);
+   tearing_hint_async = async;
+#else
+   UNUSED(async);
+#endif
+}
+
+void surface::dispatch_pending_events()
+{
+   if (wl_display_dispatch_queue_pending(wayland_display, surface_queue.get()) < 0)
+   {
+      WSI_LOG_ERROR("Failed to dispatch pending surface events.");
+   }
+}
+
 } // namespace wayland
 } // namespace wsi
@@ -32,10 +32,13 @@
 #define __STDC_VERSION__ 0
 #endif
 #include <wayland-client.h>
+#include <time.h>
 
 #include "wsi/surface.hpp"
+#include "dmabuf_feedback.hpp"
 #include "surface_properties.hpp"
 #include "wl_object_owner.hpp"
+#include "../layer_utils/file_descriptor.hpp"
 #include "../layer_utils/macros.hpp"
 
 namespace wsi
@@ -111,9 +114,108 @@ public:
       return surface_sync_interface.get();
    }
 
+   /**
+    * @brief Returns a pointer to the Wayland wp_presentation interface, or nullptr if the compositor lacks it.
+    *
+    * Objects created from it get their events on the surface queue. The raw pointer is valid for the lifetime of
+    * the surface.
+    */
+   wp_presentation *get_presentation_interface()
+   {
+      return presentation_time_interface.get();
+   }
+
+   /**
+    * @brief Returns the clock of the wp_presentation timestamps.
+    */
+   clockid_t get_presentation_clock() const
+   {
+      return presentation_clock;
+   }
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /**
+    * @brief Returns the wp_linux_drm_syncobj_manager_v1 interface, valid whenever get_syncobj_surface() is.
+    */
+   wp_linux_drm_syncobj_manager_v1 *get_syncobj_manager()
+   {
+      return syncobj_manager_interface.get();
+   }
+
+   /**
+    * @brief Returns the wp_linux_drm_syncobj_surface_v1 of the surface, or nullptr if the surface does not use
+    *        timeline syncobjs.
+    *
+    * When set, every commit of a buffer needs an acquire and a release point, and @ref get_surface_sync_interface
+    * is nullptr. The raw pointer is valid for the lifetime of the surface.
+    */
+   wp_linux_drm_syncobj_surface_v1 *get_syncobj_surface()
+   {
+      return syncobj_surface.get();
+   }
+
+   /**
+    * @brief Returns the DRM device fd the timeline syncobjs are created on, valid whenever get_syncobj_surface() is.
+    */
+   int get_syncobj_device() const
+   {
+      return syncobj_device.get();
+   }
+#endif
+
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   /**
+    * @brief Returns the wp_fifo_v1 of the surface, or nullptr if the compositor lacks wp_fifo_manager_v1.
+    *
+    * A wl_surface can only have one, so it is shared by all swapchains of the surface. The raw pointer is valid for
+    * the lifetime of the surface.
+    */
+   wp_fifo_v1 *get_fifo()
+   {
+      return fifo.get();
+   }
+
+   /**
+    * @brief Returns the wp_commit_timer_v1 of the surface, or nullptr if the compositor lacks
+    *        wp_commit_timing_manager_v1.
+    *
+    * Shared by all swapchains of the surface like @ref get_fifo. The raw pointer is valid for the lifetime of the
+    * surface.
+    */
+   wp_commit_timer_v1 *get_commit_timer()
+   {
+      return commit_timer.get();
+   }
+#endif
+
+   /**
+    * @brief Whether the compositor lets this surface tear, which VK_PRESENT_MODE_IMMEDIATE_KHR needs.
+    */
+   bool supports_tearing() const;
+
+   /**
+    * @brief Ask the compositor to flip the next commits asynchronously, or back in sync with vblank.
+    *
+    * The hint is only sent when it changes, and takes effect with the next wl_surface::commit. Does nothing when
+    * supports_tearing() is false.
+    */
+   void set_tearing_hint(bool async);
+
+   /**
+    * @brief Returns the dmabuf feedback of the surface, or nullptr if the compositor lacks zwp_linux_dmabuf_v1
+    *        version 4.
+    *
+    * The raw pointer is valid for the lifetime of the surface.
+    */
+   dmabuf_feedback *get_dmabuf_feedback()
+   {
+      return has_dmabuf_feedback ? &surface_feedback : nullptr;
+   }
+
    /**
     * @brief Returns a reference to a list of DRM formats supported by the Wayland surface.
     *
+    * With dmabuf feedback these are the formats of its first feedback, most preferred first.
     * The reference is valid throughout the lifetime of this surface.
     */
    const util::vector<drm_format_pair> &get_formats() const
@@ -138,6 +240,11 @@ public:
     */
    bool wait_next_frame_event();
 
+   /**
+    * @brief Dispatch the surface events that are already queued, such as new dmabuf feedback, without blocking.
+    */
+   void dispatch_pending_events();
+
 private:
    /**
     * @brief Initialize the WSI surface by creating Wayland queues and linking to Wayland protocols.
@@ -169,13 +276,56 @@ private:
    /** Container for the zwp_linux_dmabuf_v1 interface binding */
    wayland_owner<zwp_linux_dmabuf_v1> dmabuf_interface;
 
+   /** Feedback of the surface, only used when has_dmabuf_feedback is true. */
+   dmabuf_feedback surface_feedback;
+   bool has_dmabuf_feedback;
+
    /** Container for the zwp_linux_explicit_synchronization_v1 interface binding */
    wayland_owner<zwp_linux_explicit_synchronization_v1> explicit_sync_interface;
    /** Container for the surface specific zwp_linux_surface_synchronization_v1 interface. */
    wayland_owner<zwp_linux_surface_synchronization_v1> surface_sync_interface;
 
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /** Container for the wp_linux_drm_syncobj_manager_v1 interface binding */
+   wayland_owner<wp_linux_drm_syncobj_manager_v1> syncobj_manager_interface;
+   /** Container for the surface specific wp_linux_drm_syncobj_surface_v1 object. */
+   wayland_owner<wp_linux_drm_syncobj_surface_v1> syncobj_surface;
+   /** DRM node the swapchains create their timelines on. */
+   util::fd_owner syncobj_device;
+#endif
+
    /** Container for the wp_presentation interface binding */
    wayland_owner<wp_presentation> presentation_time_interface;
+   /** Clock announced by wp_presentation::clock_id, sent when the interface is bound. */
+   clockid_t presentation_clock;
+
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   /** Container for the wp_fifo_manager_v1 interface binding */
+   wayland_owner<wp_fifo_manager_v1> fifo_manager_interface;
+   /** Container for the surface specific wp_fifo_v1 object. */
+   wayland_owner<wp_fifo_v1> fifo;
+   /** Container for the wp_commit_timing_manager_v1 interface binding */
+   wayland_owner<wp_commit_timing_manager_v1> commit_timing_manager_interface;
+   /** Container for the surface specific wp_commit_timer_v1 object. */
+   wayland_owner<wp_commit_timer_v1> commit_timer;
+#endif
+
+   /** Container for the wp_viewporter interface binding */
+   wayland_owner<wp_viewporter> viewporter_interface;
+   /**
+    * Container for the surface specific wp_viewport object, only created when WSI_WAYLAND_VIEWPORT asks for a
+    * destination size. A surface can only have one viewport, and the application's toolkit may own it otherwise.
+    */
+   wayland_owner<wp_viewport> viewport;
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+   /** Container for the wp_tearing_control_manager_v1 interface binding */
+   wayland_owner<wp_tearing_control_manager_v1> tearing_control_manager_interface;
+   /** Container for the surface specific wp_tearing_control_v1 object. */
+   wayland_owner<wp_tearing_control_v1> tearing_control;
+   /** Whether the async hint was sent last, the protocol starts out in vsync. */
+   bool tearing_hint_async;
+#endif
 
    /**
     * Container for a callback object for the latest frame done event.
@@ -53,17 +53,41 @@ namespace wayland
 
 void surface_properties::populate_present_mode_compatibilities()
 {
+   /* Every commit carries its own FIFO and tearing state, so any supported mode can follow any other. */
    std::array<present_mode_compatibility, 2> compatible_present_modes_list = {
-      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
-      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 1, { VK_PRESENT_MODE_MAILBOX_KHR } }
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 2, { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 2, { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR } }
    };
    m_compatible_present_modes = compatible_present_modes<2>(compatible_present_modes_list);
+
+   std::array<present_mode_compatibility, 3> tearing_compatible_present_modes_list = {
+      present_mode_compatibility{
+         VK_PRESENT_MODE_FIFO_KHR,
+         3,
+         { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{
+         VK_PRESENT_MODE_MAILBOX_KHR,
+         3,
+         { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR } },
+      present_mode_compatibility{
+         VK_PRESENT_MODE_IMMEDIATE_KHR,
+         3,
+         { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR } }
+   };
+   m_tearing_compatible_present_modes = compatible_present_modes<3>(tearing_compatible_present_modes_list);
+}
+
+bool surface_properties::supports_immediate() const
+{
+   /* Without wp_tearing_control_v1 the compositor always syncs to vblank, so IMMEDIATE would only be MAILBOX. */
+   return specific_surface != nullptr && specific_surface->supports_tearing();
 }
 
 surface_properties::surface_properties(surface *wsi_surface, const util::allocator &allocator)
    : specific_surface(wsi_surface)
    , supported_formats(allocator)
    , m_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR })
+   , m_tearing_supported_modes({ VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR })
 {
    populate_present_mode_compatibilities();
 }
@@ -97,12 +121,27 @@ VkResult surface_properties::get_surface_capabilities(VkPhysicalDevice physical_
                                                       const VkPhysicalDeviceSurfaceInfo2KHR *pSurfaceInfo,
                                                       VkSurfaceCapabilities2KHR *pSurfaceCapabilities)
 {
-   TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_supported_modes));
+   if (supports_immediate())
+   {
+      TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_tearing_supported_modes));
+   }
+   else
+   {
+      TRY(check_surface_present_mode_query_is_supported(pSurfaceInfo, m_supported_modes));
+   }
 
    /* Image count limits */
    get_surface_capabilities(physical_device, &pSurfaceCapabilities->surfaceCapabilities);
 
-   m_compatible_present_modes.get_surface_present_mode_compatibility_common(pSurfaceInfo, pSurfaceCapabilities);
+   if (supports_immediate())
+   {
+      m_tearing_compatible_present_modes.get_surface_present_mode_compatibility_common(pSurfaceInfo,
+                                                                                       pSurfaceCapabilities);
+   }
+   else
+   {
+      m_compatible_present_modes.get_surface_present_mode_compatibility_common(pSurfaceInfo, pSurfaceCapabilities);
+   }
 
    auto surface_scaling_capabilities = util::find_extension<VkSurfacePresentScalingCapabilitiesEXT>(
       VK_STRUCTURE_TYPE_SURFACE_PRESENT_SCALING_CAPABILITIES_EXT, pSurfaceCapabilities);
@@ -243,6 +282,10 @@ VkResult surface_properties::get_surface_present_modes(VkPhysicalDevice physical
    UNUSED(physical_device);
    UNUSED(surface);
 
+   if (supports_immediate())
+   {
+      return get_surface_present_modes_common(pPresentModeCount, pPresentModes, m_tearing_supported_modes);
+   }
    return get_surface_present_modes_common(pPresentModeCount, pPresentModes, m_supported_modes);
 }
 
@@ -414,6 +457,10 @@ void surface_properties::get_surface_present_scaling_and_gravity(
 
 bool surface_properties::is_compatible_present_modes(VkPresentModeKHR present_mode_a, VkPresentModeKHR present_mode_b)
 {
+   if (supports_immediate())
+   {
+      return m_tearing_compatible_present_modes.is_compatible_present_modes(present_mode_a, present_mode_b);
+   }
    return m_compatible_present_modes.is_compatible_present_modes(present_mode_a, present_mode_b);
 }
 
@@ -426,6 +473,23 @@ void surface_properties::get_present_timing_surface_caps(
    present_timing_surface_caps->presentAtRelativeTimeSupported = VK_FALSE;
    present_timing_surface_caps->presentStageQueries = VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT;
    present_timing_surface_caps->presentStageTargets = 0;
+   /* wp_presentation timestamps can only be reported in the clocks that have a Vulkan time domain. */
+   if (specific_surface != nullptr && specific_surface->get_presentation_interface() != nullptr &&
+       (specific_surface->get_presentation_clock() == CLOCK_MONOTONIC ||
+        specific_surface->get_presentation_clock() == CLOCK_MONOTONIC_RAW))
+   {
+      present_timing_surface_caps->presentStageQueries |=
+         VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+      /* wp_commit_timer_v1 takes its timestamps in the same clock. */
+      if (specific_surface->get_commit_timer() != nullptr)
+      {
+         present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_TRUE;
+         present_timing_surface_caps->presentStageTargets = VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+      }
+#endif
+   }
 }
 #endif
 
@@ -90,9 +90,18 @@ private:
    /* List of supported presentation modes */
    std::array<VkPresentModeKHR, 2> m_supported_modes;
 
+   /* List of supported presentation modes when the compositor lets the surface tear */
+   std::array<VkPresentModeKHR, 3> m_tearing_supported_modes;
+
    /* Stores compatible presentation modes */
    compatible_present_modes<2> m_compatible_present_modes;
 
+   /* Stores compatible presentation modes when the compositor lets the surface tear */
+   compatible_present_modes<3> m_tearing_compatible_present_modes;
+
+   /* Whether @ref specific_surface supports VK_PRESENT_MODE_IMMEDIATE_KHR. */
+   bool supports_immediate() const;
+
    void populate_present_mode_compatibilities() override;
 
    void get_surface_present_scaling_and_gravity(VkSurfacePresentScalingCapabilitiesEXT *scaling_capabilities) override;
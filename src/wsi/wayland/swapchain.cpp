@@ -34,12 +34,18 @@
 #include <cstdio>
 #include <climits>
 #include <functional>
+#include <algorithm>
+#include <chrono>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <system_error>
 
 #include "swapchain.hpp"
 #include "../layer_utils/drm/drm_utils.hpp"
 #include "../layer_utils/format_modifiers.hpp"
 #include "../layer_utils/helpers.hpp"
 #include "utils/logging.hpp"
+#include "utils/thread_placement.hpp"
 #include "../layer_utils/macros.hpp"
 #include "wl_helpers.hpp"
 
@@ -54,6 +60,42 @@ namespace wsi
 namespace wayland
 {
 
+namespace
+{
+VWL_CAPI_CALL(void)
+presentation_feedback_sync_output_impl(void *data, struct wp_presentation_feedback *feedback,
+                                       wl_output *output) VWL_API_POST
+{
+   UNUSED(data);
+   UNUSED(feedback);
+   UNUSED(output);
+}
+
+VWL_CAPI_CALL(void)
+presentation_feedback_presented_impl(void *data, struct wp_presentation_feedback *feedback, uint32_t tv_sec_hi,
+                                     uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi,
+                                     uint32_t seq_lo, uint32_t flags) VWL_API_POST
+{
+   UNUSED(seq_hi);
+   UNUSED(seq_lo);
+   const uint64_t tv_sec = (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+   reinterpret_cast<swapchain *>(data)->on_presentation_feedback(feedback, true, tv_sec * 1000000000ull + tv_nsec,
+                                                                 refresh, flags);
+}
+
+VWL_CAPI_CALL(void)
+presentation_feedback_discarded_impl(void *data, struct wp_presentation_feedback *feedback) VWL_API_POST
+{
+   reinterpret_cast<swapchain *>(data)->on_presentation_feedback(feedback, false, 0, 0, 0);
+}
+
+const wp_presentation_feedback_listener presentation_feedback_listener = {
+   .sync_output = presentation_feedback_sync_output_impl,
+   .presented = presentation_feedback_presented_impl,
+   .discarded = presentation_feedback_discarded_impl,
+};
+} // namespace
+
 swapchain::swapchain(wsi::device_private_data &dev_data, const VkAllocationCallbacks *pAllocator,
                      surface &wsi_surface)
    : swapchain_base(dev_data, pAllocator)
@@ -63,12 +105,20 @@ swapchain::swapchain(wsi::device_private_data &dev_data, const VkAllocationCallb
    , m_buffer_queue(nullptr)
    , m_wsi_allocator(nullptr)
    , m_image_creation_parameters({}, m_allocator, {}, {})
+   , m_feedback_generation(0)
+   , m_feedback_scanout(false)
+   , m_feedback_scanout_fourcc(false)
+   , m_buffer_event_thread_run(false)
+   , m_buffer_event_wake_fd(-1)
+   , m_presentation_feedbacks(m_allocator)
 {
    m_image_create_info.format = VK_FORMAT_UNDEFINED;
 }
 
 swapchain::~swapchain()
 {
+   /* Must not dispatch releases while teardown destroys the images; teardown's own waits dispatch the queue. */
+   stop_buffer_event_thread();
    teardown();
 
    if (m_wsi_allocator != nullptr)
@@ -80,6 +130,14 @@ swapchain::~swapchain()
    {
       wl_event_queue_destroy(m_buffer_queue);
    }
+
+   /* Events of feedback that is still outstanding are discarded once the proxies are destroyed. */
+   std::lock_guard<std::mutex> lock(m_presentation_feedback_mutex);
+   for (auto &pending : m_presentation_feedbacks)
+   {
+      wp_presentation_feedback_destroy(pending.feedback);
+   }
+   m_presentation_feedbacks.clear();
 }
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
@@ -121,7 +179,8 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
    bool swapchain_support_enabled = swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_PRESENT_TIMING_BIT_EXT;
    if (swapchain_support_enabled)
    {
-      if (!add_swapchain_extension(wsi_ext_present_timing_wayland::create(m_allocator)))
+      if (!add_swapchain_extension(
+             wsi_ext_present_timing_wayland::create(m_allocator, m_wsi_surface->get_presentation_clock())))
       {
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       }
@@ -150,6 +209,26 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   /* Without the thread, images are only freed when acquire dispatches the queue, with millisecond timeouts. */
+   m_buffer_event_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (m_buffer_event_wake_fd < 0)
+   {
+      WSI_LOG_WARNING("Failed to create the buffer event thread wake fd, releases are dispatched on acquire.");
+   }
+   else
+   {
+      m_buffer_event_thread_run = true;
+      try
+      {
+         m_buffer_event_thread = std::thread(&swapchain::buffer_event_thread, this);
+      }
+      catch (const std::system_error &)
+      {
+         WSI_LOG_WARNING("Failed to start the buffer event thread, releases are dispatched on acquire.");
+         m_buffer_event_thread_run = false;
+      }
+   }
+
    WSIALLOC_ASSERT_VERSION();
    if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
    {
@@ -160,10 +239,13 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
    /*
     * When VK_PRESENT_MODE_MAILBOX_KHR has been chosen by the application we don't
     * initialize the page flip thread so the present_image function can be called
-    * during vkQueuePresent.
+    * during vkQueuePresent. The same goes for VK_PRESENT_MODE_IMMEDIATE_KHR, and for
+    * FIFO when the compositor queues the commits itself with wp_fifo_v1, as
+    * present_image then never blocks. A swapchain that may switch to FIFO with
+    * VkSwapchainPresentModeInfoEXT keeps the thread for the modes it starts in.
     */
-   use_presentation_thread =
-      WAYLAND_FIFO_PRESENTATION_THREAD_ENABLED && (m_present_mode != VK_PRESENT_MODE_MAILBOX_KHR);
+   use_presentation_thread = WAYLAND_FIFO_PRESENTATION_THREAD_ENABLED &&
+                             is_present_mode_allowed(VK_PRESENT_MODE_FIFO_KHR) && !uses_compositor_fifo();
 
    return VK_SUCCESS;
 }
@@ -176,6 +258,8 @@ VWL_CAPI_CALL(void) buffer_release(void *data, struct wl_buffer *wayl_buffer) VW
 
 void swapchain::release_buffer(struct wl_buffer *wayl_buffer)
 {
+   /* Held so the buffer event thread does not race destroy_image(). */
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
    uint32_t i;
    for (i = 0; i < m_swapchain_images.size(); i++)
    {
@@ -187,8 +271,11 @@ void swapchain::release_buffer(struct wl_buffer *wayl_buffer)
       }
    }
 
-   /* check we found a buffer to unpresent */
-   assert(i < m_swapchain_images.size());
+   /* The image may have been destroyed while the buffer event thread was dispatching its release. */
+   if (i == m_swapchain_images.size())
+   {
+      WSI_LOG_DEBUG("Release for a destroyed buffer ignored.");
+   }
 }
 
 static struct wl_buffer_listener buffer_listener = { buffer_release };
@@ -201,12 +288,22 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
    TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
            "Failed to get format properties");
 
+   /* With dmabuf feedback, use its latest formats: they may have changed since the surface was created. */
+   dmabuf_feedback *feedback = m_wsi_surface->get_dmabuf_feedback();
+   util::vector<drm_format_pair> feedback_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+   if (feedback != nullptr && !feedback->get_formats(feedback_formats))
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   const util::vector<drm_format_pair> &surface_formats =
+      feedback != nullptr ? feedback_formats : m_wsi_surface->get_formats();
+
    for (const auto &prop : drm_format_props)
    {
       bool is_supported = false;
       drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
 
-      for (const auto &format : m_wsi_surface->get_formats())
+      for (const auto &format : surface_formats)
       {
          if (format.fourcc == drm_format.fourcc && format.modifier == drm_format.modifier)
          {
@@ -219,74 +316,41 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          continue;
       }
 
-      VkExternalImageFormatPropertiesKHR external_props = {};
-      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
-
-      VkImageFormatProperties2KHR format_props = {};
-      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
-      format_props.pNext = &external_props;
-
-      VkResult result = VK_SUCCESS;
+      const VkImageCompressionControlEXT *compression_control = nullptr;
+      VkImageCompressionControlEXT compression_properties = {};
+      if (m_device_data.is_swapchain_compression_control_enabled())
       {
-         VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
-         external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
-         external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-
-         VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
-         drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
-         drm_mod_info.pNext = &external_info;
-         drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
-         drm_mod_info.sharingMode = info.sharingMode;
-         drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
-         drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
-
-         VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
-         image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
-         image_info.pNext = &drm_mod_info;
-         image_info.format = info.format;
-         image_info.type = info.imageType;
-         image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
-         image_info.usage = info.usage;
-         image_info.flags = info.flags;
-
-         VkImageCompressionControlEXT compression_control = {};
-
-         if (m_device_data.is_swapchain_compression_control_enabled())
+         auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+         if (ext)
          {
-            auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
-            if (ext)
-            {
-               compression_control = ext->get_compression_control_properties();
-               compression_control.pNext = image_info.pNext;
-               image_info.pNext = &compression_control;
-            }
+            compression_properties = ext->get_compression_control_properties();
+            compression_control = &compression_properties;
          }
-
-         result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
-            m_device_data.physical_device, &image_info, &format_props);
       }
-      if (result != VK_SUCCESS)
+
+      const util::drm_modifier_image_support support = util::get_drm_modifier_image_support(
+         m_device_data.physical_device, info, prop.drmFormatModifier, compression_control);
+      if (!support.supported)
       {
          continue;
       }
-      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
-          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
-          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
+      if (support.image_format_properties.maxExtent.width < info.extent.width ||
+          support.image_format_properties.maxExtent.height < info.extent.height ||
+          support.image_format_properties.maxExtent.depth < info.extent.depth)
       {
          continue;
       }
-      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
-          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
+      if (support.image_format_properties.maxMipLevels < info.mipLevels ||
+          support.image_format_properties.maxArrayLayers < info.arrayLayers)
       {
          continue;
       }
-      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+      if ((support.image_format_properties.sampleCounts & info.samples) != info.samples)
       {
          continue;
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      if (support.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
       {
          if (!exportable_modifers.try_push_back(drm_format.modifier))
          {
@@ -294,8 +358,7 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
          }
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      if (support.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
       {
          uint64_t flags =
             (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
@@ -307,9 +370,70 @@ VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info
       }
    }
 
+   util::save_drm_modifier_image_support(m_device_data.physical_device);
+   util::apply_afbc_policy(importable_formats, is_compression_allowed());
+   if (feedback != nullptr)
+   {
+      rank_formats_by_feedback(*feedback, feedback_formats, importable_formats);
+   }
+
    return VK_SUCCESS;
 }
 
+void swapchain::rank_formats_by_feedback(dmabuf_feedback &feedback, const util::vector<drm_format_pair> &preferred,
+                                         util::vector<wsialloc_format> &importable_formats)
+{
+   /* Scanout formats rank before all others, then AFBC before uncompressed layouts. Within each group the
+    * compositor's order is kept. */
+   auto rank = [&](const wsialloc_format &format) {
+      const drm_format_pair pair{ format.fourcc, format.modifier };
+      size_t index = 0;
+      while (index < preferred.size() &&
+             (preferred[index].fourcc != pair.fourcc || preferred[index].modifier != pair.modifier))
+      {
+         index++;
+      }
+      const size_t group = (feedback.is_scanout_format(pair) ? 0 : 2) + (util::is_afbc_modifier(pair.modifier) ? 0 : 1);
+      return group * preferred.size() + index;
+   };
+
+   std::stable_sort(importable_formats.begin(), importable_formats.end(),
+                    [&](const wsialloc_format &a, const wsialloc_format &b) { return rank(a) < rank(b); });
+}
+
+void swapchain::check_dmabuf_feedback()
+{
+   dmabuf_feedback *feedback = m_wsi_surface->get_dmabuf_feedback();
+   if (feedback == nullptr)
+   {
+      return;
+   }
+
+   const uint32_t generation = feedback->get_generation();
+   if (generation == m_feedback_generation)
+   {
+      return;
+   }
+   m_feedback_generation = generation;
+
+   const wsialloc_format &allocated = m_image_creation_parameters.m_allocated_format;
+   const bool scanout = feedback->is_scanout_format({ allocated.fourcc, allocated.modifier });
+   const bool scanout_fourcc = feedback->has_scanout_fourcc(allocated.fourcc);
+
+   /* Recreating helps when the buffers lost or gained direct scanout, or when a scanout tranche for the format
+    * appeared that the buffers are not in. A scanout tranche the allocation could not use before does not count. */
+   const bool renegotiate =
+      scanout != m_feedback_scanout || (!scanout && scanout_fourcc && !m_feedback_scanout_fourcc);
+   m_feedback_scanout = scanout;
+   m_feedback_scanout_fourcc = scanout_fourcc;
+   if (renegotiate)
+   {
+      WSI_LOG_INFO("dmabuf feedback changed, buffers %s direct scanout; swapchain is suboptimal.",
+                   scanout ? "now allow" : "no longer match");
+      set_suboptimal();
+   }
+}
+
 VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, wayland_image_data *image_data,
                                       util::vector<wsialloc_format> &importable_formats,
                                       wsialloc_format *allocated_format, bool avoid_allocation)
@@ -382,6 +506,7 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, wayl
 
       assert(alloc_result.is_disjoint == (num_memory_planes > 1));
       external_memory.set_num_memories(num_memory_planes);
+      external_memory.set_release_to_wsialloc(!is_protected_memory);
    }
 
    external_memory.set_format_info(alloc_result.is_disjoint, num_planes);
@@ -412,16 +537,104 @@ static VkResult fill_image_create_info(VkImageCreateInfo &image_create_info,
 VkResult swapchain::allocate_image(wayland_image_data *image_data)
 {
    util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
-   if (!importable_formats.try_push_back(m_allocated_format))
+   /* The only candidate is the format already chosen, so it is not written back: images may allocate concurrently. */
+   wsialloc_format allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(allocated_format))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
-   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &allocated_format, false));
 
    return VK_SUCCESS;
 }
 
+bool swapchain::adopt_ancestor_image(swapchain_image &image)
+{
+   if (m_ancestor == VK_NULL_HANDLE)
+   {
+      return false;
+   }
+
+   /* Swapchains of a surface all come from the same backend. */
+   auto *ancestor = static_cast<swapchain *>(reinterpret_cast<swapchain_base *>(m_ancestor));
+   if (ancestor->m_descendant != VK_NULL_HANDLE || !can_adopt_images_of(*ancestor))
+   {
+      return false;
+   }
+
+   wayland_image_data *adopted = ancestor->take_free_image_data();
+   if (adopted == nullptr)
+   {
+      return false;
+   }
+
+   if (adopted->external_mem.bind_swapchain_image_memory(image.image) != VK_SUCCESS)
+   {
+      WSI_LOG_WARNING("Failed to bind an image of the old swapchain, allocating a new one.");
+      destroy_image_data(adopted);
+      return false;
+   }
+
+   /* Releases of the buffer now come to this swapchain. It is free, so none are queued for the ancestor. */
+   wl_proxy_set_queue(reinterpret_cast<wl_proxy *>(adopted->buffer), m_buffer_queue);
+   wl_proxy_set_user_data(reinterpret_cast<wl_proxy *>(adopted->buffer), this);
+
+   m_allocator.destroy(1, static_cast<wayland_image_data *>(image.data));
+   image.data = adopted;
+   WSI_LOG_DEBUG("Reusing a buffer of the old swapchain.");
+   return true;
+}
+
+bool swapchain::can_adopt_images_of(swapchain &ancestor)
+{
+   const VkImageCreateInfo &info = m_image_create_info;
+   const VkImageCreateInfo &ancestor_info = ancestor.m_image_create_info;
+   const wsialloc_format &format = m_image_creation_parameters.m_allocated_format;
+   const wsialloc_format &ancestor_format = ancestor.m_image_creation_parameters.m_allocated_format;
+   /* The data is freed with this swapchain's allocator. */
+   if (ancestor.m_wsi_surface != m_wsi_surface || ancestor.get_allocation_callbacks() != get_allocation_callbacks() ||
+       ancestor_info.format != info.format || ancestor_info.flags != info.flags ||
+       ancestor_info.usage != info.usage || ancestor_info.arrayLayers != info.arrayLayers ||
+       ancestor_info.sharingMode != info.sharingMode || ancestor_info.extent.width != info.extent.width ||
+       ancestor_info.extent.height != info.extent.height || ancestor_format.fourcc != format.fourcc ||
+       ancestor_format.modifier != format.modifier || ancestor_format.flags != format.flags)
+   {
+      return false;
+   }
+
+   const auto &layout = m_image_creation_parameters.m_image_layout;
+   const auto &ancestor_layout = ancestor.m_image_creation_parameters.m_image_layout;
+   if (layout.size() != ancestor_layout.size())
+   {
+      return false;
+   }
+   for (size_t plane = 0; plane < layout.size(); ++plane)
+   {
+      if (layout[plane].offset != ancestor_layout[plane].offset ||
+          layout[plane].rowPitch != ancestor_layout[plane].rowPitch)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+wayland_image_data *swapchain::take_free_image_data()
+{
+   std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   for (auto &img : m_swapchain_images)
+   {
+      if (img.status == swapchain_image::FREE && img.data != nullptr)
+      {
+         auto image_data = static_cast<wayland_image_data *>(img.data);
+         img.data = nullptr;
+         destroy_image(img);
+         return image_data;
+      }
+   }
+   return nullptr;
+}
+
 VkResult swapchain::create_wl_buffer(const VkImageCreateInfo &image_create_info, swapchain_image &image,
                                      wayland_image_data *image_data)
 {
@@ -461,23 +674,82 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    image.status = swapchain_image::FREE;
 
    assert(image.data != nullptr);
+   if (adopt_ancestor_image(image))
+   {
+      return VK_SUCCESS;
+   }
+
    auto image_data = static_cast<wayland_image_data *>(image.data);
    TRY_LOG(allocate_image(image_data), "Failed to allocate image");
    image_status_lock.unlock();
 
    TRY_LOG(create_wl_buffer(image_create_info, image, image_data), "Failed to create wl_buffer");
 
+   VkResult result = image_data->external_mem.import_memory_and_bind_swapchain_image(image.image);
+   if (result != VK_SUCCESS && util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier) &&
+       is_only_created_image(image))
+   {
+      /* image_create_info is still the swapchain's own request here, so the format can be chosen again. */
+      util::disable_afbc("the driver could not import an AFBC swapchain image");
+      destroy_image(image);
+      m_image_create_info.format = VK_FORMAT_UNDEFINED;
+      TRY_LOG_CALL(create_swapchain_image(image_create_info, image));
+      return allocate_and_bind_swapchain_image(image_create_info, image);
+   }
+   TRY_LOG(result, "Failed to import memory and bind swapchain image");
+
+   /* Initialize presentation fence. */
+   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+
+   TRY_LOG(create_syncobj_timeline(*image_data), "Failed to create the image timeline");
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_swapchain_image_memory(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   UNUSED(image_create_info);
+   {
+      std::lock_guard<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+      image.status = swapchain_image::FREE;
+
+      assert(image.data != nullptr);
+      if (adopt_ancestor_image(image))
+      {
+         return VK_SUCCESS;
+      }
+   }
+
+   auto image_data = static_cast<wayland_image_data *>(image.data);
+   TRY_LOG(allocate_image(image_data), "Failed to allocate image");
    TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
            "Failed to import memory and bind swapchain image");
 
-   /* Initialize presentation fence. */
    auto present_fence = sync_fd_fence_sync::create(m_device_data);
    if (!present_fence.has_value())
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
    image_data->present_fence = std::move(present_fence.value());
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::create_swapchain_image_presentable(const VkImageCreateInfo &image_create_info,
+                                                       swapchain_image &image)
+{
+   auto image_data = static_cast<wayland_image_data *>(image.data);
+   if (image_data->buffer != nullptr)
+   {
+      return VK_SUCCESS;
+   }
 
+   TRY_LOG(create_wl_buffer(image_create_info, image, image_data), "Failed to create wl_buffer");
+   TRY_LOG(create_syncobj_timeline(*image_data), "Failed to create the image timeline");
    return VK_SUCCESS;
 }
 
@@ -491,7 +763,9 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
    }
    image.data = image_data;
 
-   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   const VkImageCreateInfo requested_create_info = image_create_info;
+   const bool select_format = m_image_create_info.format == VK_FORMAT_UNDEFINED;
+   if (select_format)
    {
       util::vector<wsialloc_format> importable_formats(
          util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
@@ -528,9 +802,28 @@ VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info,
 
       m_image_create_info = image_create_info;
       m_image_creation_parameters.m_allocated_format = allocated_format;
+
+      dmabuf_feedback *feedback = m_wsi_surface->get_dmabuf_feedback();
+      if (feedback != nullptr)
+      {
+         m_feedback_generation = feedback->get_generation();
+         m_feedback_scanout = feedback->is_scanout_format({ allocated_format.fourcc, allocated_format.modifier });
+         m_feedback_scanout_fourcc = feedback->has_scanout_fourcc(allocated_format.fourcc);
+      }
    }
 
-   return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+   VkResult result =
+      m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+   if (result != VK_SUCCESS && select_format &&
+       util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier))
+   {
+      util::disable_afbc("the driver could not create an AFBC swapchain image");
+      m_allocator.destroy(1, image_data);
+      image.data = nullptr;
+      m_image_create_info.format = VK_FORMAT_UNDEFINED;
+      return create_swapchain_image(requested_create_info, image);
+   }
+   return result;
 }
 
 void swapchain::present_image(const pending_present_request &pending_present)
@@ -540,10 +833,27 @@ void swapchain::present_image(const pending_present_request &pending_present)
       reinterpret_cast<wayland_image_data *>(m_swapchain_images[pending_present.image_index].data);
 
    /* if a frame is already pending, wait for a hint to present again */
+   const auto frame_wait_start = std::chrono::steady_clock::now();
    if (!m_wsi_surface->wait_next_frame_event())
    {
       set_error_state(VK_ERROR_SURFACE_LOST_KHR);
    }
+   record_frame_stage(frame_stage::pacing_sleep,
+                      static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                               std::chrono::steady_clock::now() - frame_wait_start)
+                                               .count()),
+                      pending_present.frame_id);
+
+   /* Handles presentation feedback of earlier commits and new dmabuf feedback. */
+   m_wsi_surface->dispatch_pending_events();
+   check_dmabuf_feedback();
+
+   if (uses_drm_syncobj() && !set_syncobj_points(*image_data))
+   {
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      complete_present(pending_present.present_id, false, 0, 0, 0);
+      return;
+   }
 
    wl_surface_attach(m_surface, image_data->buffer, 0, 0);
 
@@ -562,16 +872,37 @@ void swapchain::present_image(const pending_present_request &pending_present)
       }
    }
 
-   /* TODO: work out damage */
-   wl_surface_damage(m_surface, 0, 0, INT32_MAX, INT32_MAX);
+   /* Rectangles from VkPresentRegionsKHR are in image coordinates, which is what damage_buffer takes. Older
+    * compositors only offer surface-local damage, where the whole surface is the only safe choice. */
+   const present_damage &damage = pending_present.damage;
+   if (damage.rect_count > 0 && wl_surface_get_version(m_surface) >= WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION)
+   {
+      for (uint32_t i = 0; i < damage.rect_count; ++i)
+      {
+         const VkRect2D &rect = damage.rects[i];
+         wl_surface_damage_buffer(m_surface, rect.offset.x, rect.offset.y, static_cast<int32_t>(rect.extent.width),
+                                  static_cast<int32_t>(rect.extent.height));
+      }
+   }
+   else
+   {
+      wl_surface_damage(m_surface, 0, 0, INT32_MAX, INT32_MAX);
+   }
 
-   if (m_present_mode == VK_PRESENT_MODE_FIFO_KHR)
+   /* The mode is per commit: a switch away from FIFO waits for the last FIFO frame callback once. */
+   if (pending_present.present_mode == VK_PRESENT_MODE_FIFO_KHR && !uses_compositor_fifo())
    {
       if (!m_wsi_surface->set_frame_callback())
       {
          set_error_state(VK_ERROR_SURFACE_LOST_KHR);
       }
    }
+   set_commit_constraints(pending_present);
+   m_wsi_surface->set_tearing_hint(pending_present.present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR);
+
+   /* With wp_presentation the present completes when the compositor reports it presented or discarded, otherwise
+    * it is considered done once committed. */
+   const bool has_feedback = request_presentation_feedback(pending_present.present_id, pending_present.queued_ns);
 
    wl_surface_commit(m_surface);
    res = wl_display_flush(m_display);
@@ -582,17 +913,223 @@ void swapchain::present_image(const pending_present_request &pending_present)
       set_error_state(VK_ERROR_SURFACE_LOST_KHR);
    }
 
+   if (!has_feedback)
+   {
+      complete_present(pending_present.present_id, false, 0, 0, 0);
+   }
+}
+
+bool swapchain::uses_drm_syncobj()
+{
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   return m_wsi_surface->get_syncobj_surface() != nullptr;
+#else
+   return false;
+#endif
+}
+
+VkResult swapchain::create_syncobj_timeline(wayland_image_data &image_data)
+{
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   if (!uses_drm_syncobj())
+   {
+      return VK_SUCCESS;
+   }
+
+   auto timeline = drm_syncobj_timeline::create(m_wsi_surface->get_syncobj_device());
+   if (!timeline.has_value())
+   {
+      WSI_LOG_ERROR("Failed to create a timeline syncobj.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   util::fd_owner timeline_fd = timeline->export_fd();
+   if (!timeline_fd.is_valid())
+   {
+      WSI_LOG_ERROR("Failed to export the timeline syncobj.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   /* The compositor duplicates the fd, and the timeline object has no events so its queue does not matter. */
+   image_data.wl_timeline.reset(
+      wp_linux_drm_syncobj_manager_v1_import_timeline(m_wsi_surface->get_syncobj_manager(), timeline_fd.get()));
+   if (image_data.wl_timeline.get() == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to import the timeline syncobj into the compositor.");
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data.timeline = std::move(timeline.value());
+#else
+   UNUSED(image_data);
+#endif
+   return VK_SUCCESS;
+}
+
+bool swapchain::set_syncobj_points(wayland_image_data &image_data)
+{
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   auto present_sync_fd = image_data.present_fence.export_sync_fd();
+   if (!present_sync_fd.has_value())
+   {
+      WSI_LOG_ERROR("Failed to export present fence.");
+      return false;
+   }
+
+   /* Each present takes the two points after the last release point: the compositor waits for the first before
+    * reading the buffer, and signals the second once it no longer does. */
+   const uint64_t acquire_point = image_data.release_point + 1;
+   if (!image_data.timeline.attach_sync_file(acquire_point, present_sync_fd->get()))
+   {
+      WSI_LOG_ERROR("Failed to set the acquire point of the present fence.");
+      return false;
+   }
+   image_data.release_point = acquire_point + 1;
+
+   wp_linux_drm_syncobj_surface_v1 *syncobj_surface = m_wsi_surface->get_syncobj_surface();
+   wp_linux_drm_syncobj_surface_v1_set_acquire_point(syncobj_surface, image_data.wl_timeline.get(),
+                                                     static_cast<uint32_t>(acquire_point >> 32),
+                                                     static_cast<uint32_t>(acquire_point));
+   wp_linux_drm_syncobj_surface_v1_set_release_point(syncobj_surface, image_data.wl_timeline.get(),
+                                                     static_cast<uint32_t>(image_data.release_point >> 32),
+                                                     static_cast<uint32_t>(image_data.release_point));
+   return true;
+#else
+   UNUSED(image_data);
+   return false;
+#endif
+}
+
+bool swapchain::uses_compositor_fifo()
+{
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   return m_wsi_surface->get_fifo() != nullptr;
+#else
+   return false;
+#endif
+}
+
+void swapchain::set_commit_constraints(const pending_present_request &pending_present)
+{
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+   wp_fifo_v1 *fifo = m_wsi_surface->get_fifo();
+   if (pending_present.present_mode == VK_PRESENT_MODE_FIFO_KHR && fifo != nullptr)
+   {
+      /* The compositor applies this commit once the previous FIFO commit has been presented, and holds the next
+       * one until this one has been. */
+      wp_fifo_v1_wait_barrier(fifo);
+      wp_fifo_v1_set_barrier(fifo);
+   }
+
+   wp_commit_timer_v1 *commit_timer = m_wsi_surface->get_commit_timer();
+   if (commit_timer != nullptr && pending_present.target_present_time != 0)
+   {
+      const uint64_t tv_sec = pending_present.target_present_time / 1000000000ull;
+      const uint64_t tv_nsec = pending_present.target_present_time % 1000000000ull;
+      wp_commit_timer_v1_set_timestamp(commit_timer, static_cast<uint32_t>(tv_sec >> 32),
+                                       static_cast<uint32_t>(tv_sec), static_cast<uint32_t>(tv_nsec));
+   }
+#else
+   UNUSED(pending_present);
+#endif
+}
+
+bool swapchain::request_presentation_feedback(uint64_t present_id, uint64_t queued_ns)
+{
+   wp_presentation *presentation = m_wsi_surface->get_presentation_interface();
+   if (presentation == nullptr)
+   {
+      return false;
+   }
+
+   /* The feedback inherits the surface queue from the wp_presentation proxy. */
+   struct wp_presentation_feedback *feedback = wp_presentation_feedback(presentation, m_surface);
+   if (feedback == nullptr)
+   {
+      WSI_LOG_ERROR("Failed to request presentation feedback.");
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(m_presentation_feedback_mutex);
+   if (wp_presentation_feedback_add_listener(feedback, &presentation_feedback_listener, this) < 0 ||
+       !m_presentation_feedbacks.try_push_back(pending_presentation_feedback{ feedback, present_id, queued_ns }))
+   {
+      WSI_LOG_ERROR("Failed to track presentation feedback.");
+      wp_presentation_feedback_destroy(feedback);
+      return false;
+   }
+   return true;
+}
+
+void swapchain::on_presentation_feedback(struct wp_presentation_feedback *feedback, bool presented, uint64_t time_ns,
+                                         uint32_t refresh_ns, uint32_t flags)
+{
+   uint64_t present_id = 0;
+   uint64_t queued_ns = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_presentation_feedback_mutex);
+      auto it = std::find_if(m_presentation_feedbacks.begin(), m_presentation_feedbacks.end(),
+                             [feedback](const pending_presentation_feedback &pending) {
+                                return pending.feedback == feedback;
+                             });
+      if (it == m_presentation_feedbacks.end())
+      {
+         return;
+      }
+      present_id = it->present_id;
+      queued_ns = it->queued_ns;
+      m_presentation_feedbacks.erase(it);
+      wp_presentation_feedback_destroy(feedback);
+   }
+
+   if (presented && m_wsi_surface->get_presentation_clock() == CLOCK_MONOTONIC)
+   {
+      record_display_latency(queued_ns, time_ns);
+   }
+
+   complete_present(present_id, presented, time_ns, refresh_ns, flags);
+}
+
+void swapchain::complete_present(uint64_t present_id, bool presented, uint64_t time_ns, uint32_t refresh_ns,
+                                 uint32_t flags)
+{
    if (m_device_data.is_present_id_enabled())
    {
       auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
-      ext->set_present_id(pending_present.present_id);
+      ext->set_present_id(present_id);
    }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *timing = get_swapchain_extension<wsi_ext_present_timing_wayland>();
+   if (timing != nullptr)
+   {
+      if (presented)
+      {
+         timing->report_presented(present_id, time_ns, refresh_ns, flags);
+      }
+      else
+      {
+         timing->report_discarded(present_id);
+      }
+   }
+#else
+   UNUSED(presented);
+   UNUSED(time_ns);
+   UNUSED(refresh_ns);
+   UNUSED(flags);
+#endif
 }
 
 void swapchain::destroy_image(swapchain_image &image)
 {
    std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
 
+   /* wl_buffer_destroy() does not stop the compositor showing the buffer; the last present of a retired swapchain
+    * in particular stays on screen until the next swapchain's first attach. */
+   if (image.data != nullptr && !compositor_released(image))
+   {
+      reinterpret_cast<wayland_image_data *>(image.data)->external_mem.set_release_to_wsialloc(false);
+   }
+
    if (image.status != swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
@@ -604,20 +1141,40 @@ void swapchain::destroy_image(swapchain_image &image)
       image.status = swapchain_image::INVALID;
    }
 
-   image_status_lock.unlock();
-
    if (image.data != nullptr)
    {
-      auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
-      if (image_data->buffer != nullptr)
-      {
-         wl_buffer_destroy(image_data->buffer);
-      }
-      m_allocator.destroy(1, image_data);
+      destroy_image_data(reinterpret_cast<wayland_image_data *>(image.data));
       image.data = nullptr;
    }
 }
 
+bool swapchain::compositor_released(const swapchain_image &image)
+{
+   if (image.status == swapchain_image::PENDING || image.status == swapchain_image::PRESENTED)
+   {
+      return false;
+   }
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
+   if (uses_drm_syncobj() && image_data->release_point != 0 &&
+       !image_data->timeline.has_signalled(image_data->release_point))
+   {
+      return false;
+   }
+#endif
+   return true;
+}
+
+void swapchain::destroy_image_data(wayland_image_data *image_data)
+{
+   if (image_data->buffer != nullptr)
+   {
+      wl_buffer_destroy(image_data->buffer);
+   }
+   m_allocator.destroy(1, image_data);
+}
+
 bool swapchain::free_image_found()
 {
    for (auto &img : m_swapchain_images)
@@ -630,8 +1187,95 @@ bool swapchain::free_image_found()
    return false;
 }
 
+void swapchain::buffer_event_thread()
+{
+   mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::PRESENT, "Wayland buffer event");
+   struct pollfd fds[2] = {};
+   fds[0].fd = wl_display_get_fd(m_display);
+   fds[0].events = POLLIN;
+   fds[1].fd = m_buffer_event_wake_fd;
+   fds[1].events = POLLIN;
+
+   bool failed = false;
+   while (m_buffer_event_thread_run && !failed)
+   {
+      while (wl_display_prepare_read_queue(m_display, m_buffer_queue) != 0)
+      {
+         if (wl_display_dispatch_queue_pending(m_display, m_buffer_queue) < 0)
+         {
+            failed = true;
+            break;
+         }
+      }
+      if (failed)
+      {
+         break;
+      }
+
+      if (poll(fds, 2, -1) < 0)
+      {
+         wl_display_cancel_read(m_display);
+         failed = errno != EINTR;
+         continue;
+      }
+
+      if (fds[1].revents != 0)
+      {
+         wl_display_cancel_read(m_display);
+         break;
+      }
+
+      if ((fds[0].revents & POLLIN) == 0)
+      {
+         /* The display fd was closed or hung up. */
+         wl_display_cancel_read(m_display);
+         failed = true;
+         break;
+      }
+
+      /* A failed read cancels it for us. */
+      failed = wl_display_read_events(m_display) < 0 ||
+               wl_display_dispatch_queue_pending(m_display, m_buffer_queue) < 0;
+   }
+
+   if (failed)
+   {
+      WSI_LOG_ERROR("Error while dispatching Wayland buffer release events.");
+      set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+      m_buffer_event_thread_run = false;
+      wake_acquire_waiter();
+   }
+}
+
+void swapchain::stop_buffer_event_thread()
+{
+   if (m_buffer_event_thread.joinable())
+   {
+      m_buffer_event_thread_run = false;
+      const uint64_t wake = 1;
+      if (write(m_buffer_event_wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+      {
+         WSI_LOG_WARNING("Failed to wake the buffer event thread.");
+      }
+      m_buffer_event_thread.join();
+   }
+
+   if (m_buffer_event_wake_fd >= 0)
+   {
+      close(m_buffer_event_wake_fd);
+      m_buffer_event_wake_fd = -1;
+   }
+}
+
 VkResult swapchain::get_free_buffer(uint64_t *timeout)
 {
+   /* The buffer event thread frees images as releases arrive, so acquire only waits on the free image semaphore,
+    * with the full nanosecond timeout. */
+   if (m_buffer_event_thread_run)
+   {
+      return VK_SUCCESS;
+   }
+
    int ms_timeout, res;
 
    if (*timeout >= INT_MAX * 1000llu * 1000llu)
@@ -683,7 +1327,7 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
-   if (m_wsi_surface->get_surface_sync_interface() == nullptr)
+   if (m_wsi_surface->get_surface_sync_interface() == nullptr && !uses_drm_syncobj())
    {
       auto data = reinterpret_cast<wayland_image_data *>(image.data);
       return data->present_fence.wait_payload(timeout);
@@ -694,6 +1338,33 @@ VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
    return VK_SUCCESS;
 }
 
+util::fd_owner swapchain::image_acquire_sync_fd(swapchain_image &image)
+{
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   auto image_data = reinterpret_cast<wayland_image_data *>(image.data);
+   if (!uses_drm_syncobj() || image_data->release_point == 0)
+   {
+      return {};
+   }
+
+   /* wl_buffer::release only means the compositor will not latch the buffer again, its GPU work reading it may
+    * still be running until the release point signals. */
+   util::fd_owner release_fd = image_data->timeline.export_sync_file(image_data->release_point);
+   if (!release_fd.is_valid())
+   {
+      WSI_LOG_WARNING("Failed to export the release point of image, waiting for it instead.");
+      if (!image_data->timeline.wait(image_data->release_point))
+      {
+         WSI_LOG_ERROR("Failed to wait for the release point of image.");
+      }
+   }
+   return release_fd;
+#else
+   UNUSED(image);
+   return {};
+#endif
+}
+
 VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemoryInfo *bind_image_mem_info,
                                          const VkBindImageMemorySwapchainInfoKHR *bind_sc_info)
 {
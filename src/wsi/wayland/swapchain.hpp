@@ -40,9 +40,14 @@ extern "C" {
 #include "../layer_utils/wsialloc/wsialloc.h"
 #include "../layer_utils/custom_allocator.hpp"
 #include "wl_object_owner.hpp"
+#include "drm_syncobj.hpp"
 
 #include <wsi/external_memory.hpp>
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+
 namespace wsi
 {
 namespace wayland
@@ -59,6 +64,13 @@ struct wayland_image_data
    external_memory external_mem;
    wl_buffer *buffer;
    sync_fd_fence_sync present_fence;
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+   /** Acquire and release points of the image's presents, when the surface uses wp_linux_drm_syncobj_v1. */
+   drm_syncobj_timeline timeline;
+   wayland_owner<wp_linux_drm_syncobj_timeline_v1> wl_timeline;
+   /** Release point of the image's last present, 0 before its first. */
+   uint64_t release_point{ 0 };
+#endif
 };
 
 struct image_creation_parameters
@@ -90,6 +102,20 @@ public:
    /* TODO: make the buffer destructor a friend? so this can be protected */
    void release_buffer(struct wl_buffer *wl_buffer);
 
+   /**
+    * @brief Handle the result of a present, called from the wp_presentation_feedback listener.
+    *
+    * Completes the present id and the present timing entry of the present that requested @p feedback.
+    *
+    * @param feedback   The feedback object, destroyed by this call.
+    * @param presented  true for a presented event, false for a discarded one.
+    * @param time_ns    Presentation timestamp in the clock of the surface's wp_presentation.
+    * @param refresh_ns Refresh interval of the output, 0 if unknown.
+    * @param flags      wp_presentation_feedback_kind flags of a presented event.
+    */
+   void on_presentation_feedback(struct wp_presentation_feedback *feedback, bool presented, uint64_t time_ns,
+                                 uint32_t refresh_ns, uint32_t flags);
+
 protected:
    /**
     * @brief Initialize platform specifics.
@@ -107,6 +133,20 @@ protected:
     */
    VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
+   bool can_allocate_images_in_parallel() const override
+   {
+      return true;
+   }
+
+   VkResult allocate_swapchain_image_memory(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Creates the wl_buffer and the syncobj timeline of the image, unless it was taken over from the old
+    * swapchain with both.
+    */
+   VkResult create_swapchain_image_presentable(const VkImageCreateInfo &image_create_info,
+                                              swapchain_image &image) override;
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -128,6 +168,11 @@ protected:
     */
    void present_image(const pending_present_request &pending_present) override;
 
+   uint32_t get_metrics_backend() const override
+   {
+      return mali_wrapper::metrics_backend::wayland;
+   }
+
    /**
     * @brief Method to release a swapchain image
     *
@@ -168,6 +213,11 @@ protected:
 
    VkResult image_wait_present(swapchain_image &image, uint64_t timeout) override;
 
+   /**
+    * @brief With timeline syncobjs, returns the release point of the image's last present as a sync file.
+    */
+   util::fd_owner image_acquire_sync_fd(swapchain_image &image) override;
+
    /**
     * @brief Bind image to a swapchain
     *
@@ -185,6 +235,40 @@ private:
    VkResult create_wl_buffer(const VkImageCreateInfo &image_create_info, swapchain_image &image,
                              wayland_image_data *image_data);
    VkResult allocate_image(wayland_image_data *image_data);
+
+   /**
+    * @brief Give @p image the dmabuf and wl_buffer of a free image of the ancestor swapchain, if it has a compatible
+    *        one, instead of allocating new ones.
+    *
+    * Only done while this swapchain is being created, before the ancestor is deprecated and frees them.
+    *
+    * @return true if @p image is now bound to the adopted memory.
+    */
+   bool adopt_ancestor_image(swapchain_image &image);
+
+   /**
+    * @brief Whether images of @p ancestor have the allocation, layout and usage this swapchain would create.
+    */
+   bool can_adopt_images_of(swapchain &ancestor);
+
+   /**
+    * @brief Detach the data of a FREE image and destroy the rest of the image, for a descendant to adopt.
+    *
+    * @return The detached data or nullptr if no image is FREE.
+    */
+   wayland_image_data *take_free_image_data();
+
+   /**
+    * @brief Destroy the wl_buffer and allocations held by @p image_data and free it.
+    */
+   void destroy_image_data(wayland_image_data *image_data);
+
+   /**
+    * @brief Whether the compositor is done with the buffer of @p image, so wsialloc may hand it out again.
+    *
+    * False while the image waits for wl_buffer.release, and with explicit sync until its release point signals.
+    */
+   bool compositor_released(const swapchain_image &image);
    VkResult allocate_wsialloc(VkImageCreateInfo &image_create_info, wayland_image_data *image_data,
                               util::vector<wsialloc_format> &importable_formats, wsialloc_format *allocated_format,
                               bool avoid_allocation);
@@ -217,6 +301,98 @@ private:
     */
    struct image_creation_parameters m_image_creation_parameters;
 
+   /** Generation of the surface's dmabuf feedback last checked against the allocated format. */
+   uint32_t m_feedback_generation;
+   /** Whether the allocated format is in a scanout tranche of that feedback. */
+   bool m_feedback_scanout;
+   /** Whether that feedback had a scanout tranche for the allocated fourcc. */
+   bool m_feedback_scanout_fourcc;
+
+   /**
+    * @brief Dispatch @ref m_buffer_queue until stopped, so images are freed as soon as the compositor releases them.
+    */
+   void buffer_event_thread();
+
+   /**
+    * @brief Stop @ref m_buffer_event_thread; get_free_buffer() dispatches the queue itself afterwards.
+    */
+   void stop_buffer_event_thread();
+
+   /** Whether @ref m_buffer_event_thread is dispatching the buffer queue. */
+   std::atomic<bool> m_buffer_event_thread_run;
+   std::thread m_buffer_event_thread;
+   /** eventfd that wakes @ref m_buffer_event_thread to stop it. */
+   int m_buffer_event_wake_fd;
+
+   /** A wp_presentation_feedback requested for a commit that has not been presented or discarded yet. */
+   struct pending_presentation_feedback
+   {
+      struct wp_presentation_feedback *feedback;
+      uint64_t present_id;
+      /** pending_present_request::queued_ns of the commit, for the metrics page's display latency. */
+      uint64_t queued_ns;
+   };
+
+   /** Outstanding presentation feedback, oldest commit first. */
+   util::vector<pending_presentation_feedback> m_presentation_feedbacks;
+   /** Protects @ref m_presentation_feedbacks against listeners dispatched while the swapchain is torn down. */
+   std::mutex m_presentation_feedback_mutex;
+
+   /**
+    * @brief Whether FIFO presents are queued by the compositor with wp_fifo_v1 rather than paced on frame callbacks.
+    */
+   bool uses_compositor_fifo();
+
+   /**
+    * @brief Add the wp_fifo_v1 barriers and wp_commit_timer_v1 target time of a present to the next commit.
+    */
+   void set_commit_constraints(const pending_present_request &pending_present);
+
+   /**
+    * @brief Whether presents are synchronized with wp_linux_drm_syncobj_v1 timeline points.
+    */
+   bool uses_drm_syncobj();
+
+   /**
+    * @brief Create the timeline of an image and import it into the compositor, if @ref uses_drm_syncobj.
+    */
+   VkResult create_syncobj_timeline(wayland_image_data &image_data);
+
+   /**
+    * @brief Set the acquire point of the image's present fence and a new release point for the next commit.
+    *
+    * @return false on failure. The compositor rejects a buffer without points, so it cannot be committed then.
+    */
+   bool set_syncobj_points(wayland_image_data &image_data);
+
+   /**
+    * @brief Request a wp_presentation_feedback for the next commit of the surface.
+    *
+    * @return false if the compositor lacks wp_presentation or the request failed.
+    */
+   bool request_presentation_feedback(uint64_t present_id, uint64_t queued_ns);
+
+   /**
+    * @brief Complete the present id and present timing entry of a present.
+    */
+   void complete_present(uint64_t present_id, bool presented, uint64_t time_ns, uint32_t refresh_ns, uint32_t flags);
+
+   /**
+    * @brief Put the formats the surface's dmabuf feedback can scan out first, then follow its preference order.
+    *
+    * wsialloc allocates the first format of the list it can, so this makes it pick a direct scanout candidate.
+    *
+    * @param preferred Formats of the feedback, as returned by dmabuf_feedback::get_formats().
+    */
+   void rank_formats_by_feedback(dmabuf_feedback &feedback, const util::vector<drm_format_pair> &preferred,
+                                 util::vector<wsialloc_format> &importable_formats);
+
+   /**
+    * @brief Dispatch new dmabuf feedback and mark the swapchain suboptimal if it changes whether the allocated
+    *        format can be scanned out.
+    */
+   void check_dmabuf_feedback();
+
    /**
     * @brief Finds what formats are compatible with the requested swapchain image Vulkan Device and Wayland surface.
     *
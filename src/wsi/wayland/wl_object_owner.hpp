@@ -31,6 +31,17 @@
 #include <linux-dmabuf-unstable-v1-client-protocol.h>
 #include <linux-explicit-synchronization-unstable-v1-protocol.h>
 #include <presentation-time-client-protocol.h>
+#include <viewporter-client-protocol.h>
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+#include <fifo-v1-client-protocol.h>
+#include <commit-timing-v1-client-protocol.h>
+#endif
+#if WAYLAND_TEARING_CONTROL_ENABLED
+#include <tearing-control-v1-client-protocol.h>
+#endif
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+#include <linux-drm-syncobj-v1-client-protocol.h>
+#endif
 #include <memory.h>
 #include <functional>
 
@@ -49,6 +60,11 @@ static inline void wayland_object_destroy(zwp_linux_dmabuf_v1 *obj)
    zwp_linux_dmabuf_v1_destroy(obj);
 }
 
+static inline void wayland_object_destroy(zwp_linux_dmabuf_feedback_v1 *obj)
+{
+   zwp_linux_dmabuf_feedback_v1_destroy(obj);
+}
+
 static inline void wayland_object_destroy(zwp_linux_explicit_synchronization_v1 *obj)
 {
    zwp_linux_explicit_synchronization_v1_destroy(obj);
@@ -69,6 +85,67 @@ static inline void wayland_object_destroy(wl_callback *obj)
    wl_callback_destroy(obj);
 }
 
+static inline void wayland_object_destroy(wp_viewporter *obj)
+{
+   wp_viewporter_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_viewport *obj)
+{
+   wp_viewport_destroy(obj);
+}
+
+#if WAYLAND_FIFO_PROTOCOLS_ENABLED
+static inline void wayland_object_destroy(wp_fifo_manager_v1 *obj)
+{
+   wp_fifo_manager_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_fifo_v1 *obj)
+{
+   wp_fifo_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_commit_timing_manager_v1 *obj)
+{
+   wp_commit_timing_manager_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_commit_timer_v1 *obj)
+{
+   wp_commit_timer_v1_destroy(obj);
+}
+#endif
+
+#if WAYLAND_TEARING_CONTROL_ENABLED
+static inline void wayland_object_destroy(wp_tearing_control_manager_v1 *obj)
+{
+   wp_tearing_control_manager_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_tearing_control_v1 *obj)
+{
+   wp_tearing_control_v1_destroy(obj);
+}
+#endif
+
+#if WAYLAND_DRM_SYNCOBJ_ENABLED
+static inline void wayland_object_destroy(wp_linux_drm_syncobj_manager_v1 *obj)
+{
+   wp_linux_drm_syncobj_manager_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_linux_drm_syncobj_surface_v1 *obj)
+{
+   wp_linux_drm_syncobj_surface_v1_destroy(obj);
+}
+
+static inline void wayland_object_destroy(wp_linux_drm_syncobj_timeline_v1 *obj)
+{
+   wp_linux_drm_syncobj_timeline_v1_destroy(obj);
+}
+#endif
+
 static inline void wayland_object_destroy(wl_event_queue *obj)
 {
    wl_event_queue_destroy(obj);
@@ -184,6 +184,10 @@ VkResult add_device_extensions_required_by_layer(VkPhysicalDevice phys_dev,
          VK_KHR_EXTERNAL_FENCE_FD_EXTENSION_NAME,
          VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
          VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+#if BUILD_WSI_X11
+         /* Lets the X11 SHM presenter import its segments. */
+         VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME,
+#endif
 #if ENABLE_INSTRUMENTATION
          VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME,
 #endif
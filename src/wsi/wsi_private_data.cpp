@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2018-2025 Arm Limited.
+ * Copyright (c) 2018-2026 Arm Limited.
  *
  * SPDX-License-Identifier: MIT
  *
@@ -31,6 +31,7 @@
 #include "utils/logging.hpp"
 #include "layer_utils/helpers.hpp"
 #include "layer_utils/macros.hpp"
+#include <atomic>
 #include <cstdio>
 #include <stdexcept>
 #include <shared_mutex>
@@ -58,6 +59,38 @@ static util::unordered_map<void *, void *> g_instance_key_mapping{ util::allocat
 static util::unordered_map<void *, void *> g_device_key_mapping{ util::allocator::get_generic() };
 static util::unordered_map<void *, void *> g_queue_key_mapping{ util::allocator::get_generic() };
 
+/* Bumped under the exclusive g_data_lock whenever the maps above change. */
+static std::atomic<uint64_t> g_data_generation{ 1 };
+
+static void data_changed_locked()
+{
+   g_data_generation.fetch_add(1, std::memory_order_release);
+}
+
+/* One-entry per-thread cache of the last get() lookup, which lets WSI entry points on a hot path, such as
+ * vkQueuePresentKHR and vkAcquireNextImageKHR, skip g_data_lock. An entry is only valid for the generation it was
+ * filled at, which is read under g_data_lock together with the maps.
+ */
+template <typename data_type>
+struct lookup_cache
+{
+   void *handle;
+   data_type *data;
+   uint64_t generation;
+};
+static thread_local lookup_cache<instance_private_data> t_instance_lookup{};
+static thread_local lookup_cache<device_private_data> t_device_lookup{};
+
+template <typename data_type>
+static data_type *cached_lookup(const lookup_cache<data_type> &cache, void *handle)
+{
+   if (cache.handle == handle && cache.generation == g_data_generation.load(std::memory_order_acquire))
+   {
+      return cache.data;
+   }
+   return nullptr;
+}
+
 VkResult instance_dispatch_table::populate(VkInstance instance, PFN_vkGetInstanceProcAddr get_proc)
 {
    static constexpr entrypoint entrypoints_init[] = {
@@ -68,6 +101,7 @@ VkResult instance_dispatch_table::populate(VkInstance instance, PFN_vkGetInstanc
    };
 
    static constexpr auto num_entrypoints = std::distance(std::begin(entrypoints_init), std::end(entrypoints_init));
+   static_assert(num_entrypoints == ENTRYPOINT_COUNT, "entrypoints_init must follow INSTANCE_ENTRYPOINTS_LIST");
 
    for (size_t i = 0; i < num_entrypoints; i++)
    {
@@ -77,6 +111,7 @@ VkResult instance_dispatch_table::populate(VkInstance instance, PFN_vkGetInstanc
       {
          return VK_ERROR_INITIALIZATION_FAILED;
       }
+      m_fns[i] = ret;
       struct entrypoint e = *entrypoint;
       e.fn = ret;
       e.user_visible = false;
@@ -136,6 +171,7 @@ VkResult device_dispatch_table::populate(VkDevice dev, PFN_vkGetDeviceProcAddr g
 #undef DISPATCH_TABLE_ENTRY
    };
    static constexpr auto num_entrypoints = std::distance(std::begin(entrypoints_init), std::end(entrypoints_init));
+   static_assert(num_entrypoints == ENTRYPOINT_COUNT, "entrypoints_init must follow DEVICE_ENTRYPOINTS_LIST");
 
    for (size_t i = 0; i < num_entrypoints; i++)
    {
@@ -145,6 +181,7 @@ VkResult device_dispatch_table::populate(VkDevice dev, PFN_vkGetDeviceProcAddr g
       {
          return VK_ERROR_INITIALIZATION_FAILED;
       }
+      m_fns[i] = ret;
       struct entrypoint e = entrypoint;
       e.fn = ret;
       e.user_visible = false;
@@ -239,6 +276,7 @@ void register_queue_key_mapping(VkDevice device, VkQueue queue)
    if (insert.has_value())
    {
       insert->first->second = device_key;
+      data_changed_locked();
    }
    else
    {
@@ -253,6 +291,7 @@ VkResult instance_private_data::associate(VkInstance instance, instance_dispatch
 {
    const auto key = get_key(instance);
    std::unique_lock<std::shared_mutex> lock(g_data_lock);
+   data_changed_locked();
 
    // CRITICAL FIX: Check if same Mali instance already exists (Box64+Wine-Wow64+DXVK)
    // Compare dispatch table pointers to detect same Mali instance with different keys
@@ -322,6 +361,7 @@ void instance_private_data::disassociate(VkInstance instance)
    instance_private_data *instance_data = nullptr;
    {
       std::unique_lock<std::shared_mutex> lock(g_data_lock);
+      data_changed_locked();
       void *lookup_key = get_key(instance);
       auto key_it = g_instance_key_mapping.find(static_cast<void *>(instance));
       if (key_it != g_instance_key_mapping.end())
@@ -347,9 +387,15 @@ void instance_private_data::disassociate(VkInstance instance)
 template <typename dispatchable_type>
 static instance_private_data &get_instance_private_data(dispatchable_type dispatchable_object)
 {
+   void *handle = static_cast<void *>(dispatchable_object);
+   if (auto *cached = cached_lookup(t_instance_lookup, handle))
+   {
+      return *cached;
+   }
+
    std::shared_lock<std::shared_mutex> lock(g_data_lock);
    void *lookup_key = get_key(dispatchable_object);
-   auto map_it = g_instance_key_mapping.find(static_cast<void *>(dispatchable_object));
+   auto map_it = g_instance_key_mapping.find(handle);
    if (map_it != g_instance_key_mapping.end())
    {
       lookup_key = map_it->second;
@@ -361,6 +407,7 @@ static instance_private_data &get_instance_private_data(dispatchable_type dispat
       throw std::out_of_range("Instance not found in WSI tracking map");
    }
 
+   t_instance_lookup = { handle, it->second, g_data_generation.load(std::memory_order_relaxed) };
    return *it->second;
 }
 
@@ -592,6 +639,7 @@ VkResult device_private_data::associate(VkDevice dev, instance_private_data &ins
    const auto dispatch_key = get_key(dev);
    void *store_key = dispatch_key;
    std::unique_lock<std::shared_mutex> lock(g_data_lock);
+   data_changed_locked();
 
    auto key_mapping_it = g_device_key_mapping.find(static_cast<void *>(dev));
    if (key_mapping_it != g_device_key_mapping.end())
@@ -651,6 +699,7 @@ void device_private_data::disassociate(VkDevice dev)
    void *stored_device_key = nullptr;
    {
       std::unique_lock<std::shared_mutex> lock(g_data_lock);
+      data_changed_locked();
 
       void *lookup_key = get_key(dev);
       auto key_it = g_device_key_mapping.find(static_cast<void *>(dev));
@@ -694,38 +743,55 @@ void device_private_data::disassociate(VkDevice dev)
    destroy(device_data);
 }
 
+/* Key of a device or queue in g_device_data. Call with g_data_lock held. */
 template <typename dispatchable_type>
-static device_private_data &get_device_private_data(dispatchable_type dispatchable_object)
+static void *get_device_key_locked(dispatchable_type dispatchable_object)
 {
-   std::unique_lock<std::shared_mutex> lock(g_data_lock);
-
-   void* device_handle = static_cast<void*>(dispatchable_object);
-   void* original_key = nullptr;
+   void *device_handle = static_cast<void *>(dispatchable_object);
 
    // First try queue mapping (for queues associated after loader data calls)
    auto queue_mapping_it = g_queue_key_mapping.find(device_handle);
    if (queue_mapping_it != g_queue_key_mapping.end())
    {
-      original_key = queue_mapping_it->second;
+      return queue_mapping_it->second;
    }
-   else
+
+   // Then try to get the stored key from our device mapping (corruption fix)
+   auto key_mapping_it = g_device_key_mapping.find(device_handle);
+   if (key_mapping_it != g_device_key_mapping.end())
    {
-      // Then try to get the stored key from our device mapping (corruption fix)
-      auto key_mapping_it = g_device_key_mapping.find(device_handle);
-      if (key_mapping_it != g_device_key_mapping.end())
-      {
-         original_key = key_mapping_it->second;
-      }
-      else
+      return key_mapping_it->second;
+   }
+
+   // Fallback to dereferencing (may be corrupted)
+   return get_key(dispatchable_object);
+}
+
+template <typename dispatchable_type>
+static device_private_data &get_device_private_data(dispatchable_type dispatchable_object)
+{
+   void *device_handle = static_cast<void *>(dispatchable_object);
+   if (auto *cached = cached_lookup(t_device_lookup, device_handle))
+   {
+      return *cached;
+   }
+
+   {
+      std::shared_lock<std::shared_mutex> lock(g_data_lock);
+      auto it = g_device_data.find(get_device_key_locked(dispatchable_object));
+      if (it != g_device_data.end())
       {
-         // Fallback to dereferencing (may be corrupted)
-         original_key = get_key(dispatchable_object);
+         t_device_lookup = { device_handle, it->second, g_data_generation.load(std::memory_order_relaxed) };
+         return *it->second;
       }
    }
 
-   auto it = g_device_data.find(original_key);
+   /* Not tracked under its key: recovering the mapping below changes the maps. */
+   std::unique_lock<std::shared_mutex> lock(g_data_lock);
+   auto it = g_device_data.find(get_device_key_locked(dispatchable_object));
    if (it == g_device_data.end())
    {
+      data_changed_locked();
       if constexpr (std::is_same_v<dispatchable_type, VkDevice>)
       {
          for (auto &entry : g_device_data)
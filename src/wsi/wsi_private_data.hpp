@@ -131,19 +131,19 @@ protected:
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param fn Entrypoint to call, may be nullptr.
+    * @param fn_name Name of the function to call, for the warning when it is missing.
     * @param args Arguments to the function to call.
     * @return function return value or std::nullopt if function is not present in entrypoints
     */
    template <
       typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
       std::enable_if_t<!std::is_void<ReturnType>::value && !std::is_same<ReturnType, VkResult>::value, bool> = true>
-   std::optional<ReturnType> call_fn(const char *fn_name, Args &&...args) const
+   std::optional<ReturnType> call_fn(PFN_vkVoidFunction fn, const char *fn_name, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
-      if (fn.has_value())
+      if (fn != nullptr)
       {
-         return (*fn)(std::forward<Args>(args)...);
+         return reinterpret_cast<FunctionType>(fn)(std::forward<Args>(args)...);
       }
 
       WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
@@ -158,17 +158,17 @@ protected:
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param fn Entrypoint to call, may be nullptr.
+    * @param fn_name Name of the function to call, for the warning when it is missing.
     * @param args Arguments to the function to call.
     */
    template <typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
              std::enable_if_t<std::is_void<ReturnType>::value, bool> = true>
-   void call_fn(const char *fn_name, Args &&...args) const
+   void call_fn(PFN_vkVoidFunction fn, const char *fn_name, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
-      if (fn.has_value())
+      if (fn != nullptr)
       {
-         return (*fn)(std::forward<Args>(args)...);
+         return reinterpret_cast<FunctionType>(fn)(std::forward<Args>(args)...);
       }
 
       WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
@@ -181,18 +181,18 @@ protected:
     * @tparam FunctionType The signature of the function to call.
     * @tparam Args Argument types of the function to call.
     *
-    * @param fn_name Name of the function to call.
+    * @param fn Entrypoint to call, may be nullptr.
+    * @param fn_name Name of the function to call, for the warning when it is missing.
     * @param args Arguments to the function to call.
     * @return function return value or VK_ERROR_EXTENSION_NOT_PRESENT if function is not present in entrypoints
     */
    template <typename FunctionType, class... Args, typename ReturnType = std::invoke_result_t<FunctionType, Args...>,
              std::enable_if_t<std::is_same<ReturnType, VkResult>::value, bool> = true>
-   VkResult call_fn(const char *fn_name, Args &&...args) const
+   VkResult call_fn(PFN_vkVoidFunction fn, const char *fn_name, Args &&...args) const
    {
-      auto fn = get_fn<FunctionType>(fn_name);
-      if (fn.has_value())
+      if (fn != nullptr)
       {
-         return (*fn)(std::forward<Args>(args)...);
+         return reinterpret_cast<FunctionType>(fn)(std::forward<Args>(args)...);
       }
 
       WSI_LOG_WARNING("Call to %s failed, dispatch table does not contain the function.", fn_name);
@@ -268,6 +268,10 @@ static constexpr uint32_t API_VERSION_MAX = UINT32_MAX;
    /* 1.1 (without KHR suffix) */                                                                                    \
    EP(GetPhysicalDeviceExternalFencePropertiesKHR, VK_KHR_EXTERNAL_FENCE_CAPABILITIES_EXTENSION_NAME,                \
       VK_API_VERSION_1_1, false)                                                                                     \
+   /* VK_KHR_external_semaphore_capabilities or */                                                                   \
+   /* 1.1 (without KHR suffix) */                                                                                    \
+   EP(GetPhysicalDeviceExternalSemaphorePropertiesKHR, VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,        \
+      VK_API_VERSION_1_1, false)                                                                                     \
    EP(GetPhysicalDeviceExternalBufferPropertiesKHR, VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,              \
       VK_API_VERSION_1_1, false)
 
@@ -315,17 +319,29 @@ public:
     *    disp.GetInstanceProcAddr(instance, fn_name);
     * The result type will be matching the function signature, so there is no need for casting.
     */
-#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)             \
-   template <class... Args>                                                  \
-   auto name(Args &&...args) const                                           \
-   {                                                                         \
-      return call_fn<PFN_vk##name>("vk" #name, std::forward<Args>(args)...); \
+#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)                                       \
+   template <class... Args>                                                                            \
+   auto name(Args &&...args) const                                                                     \
+   {                                                                                                   \
+      return call_fn<PFN_vk##name>(m_fns[ENTRYPOINT_##name], "vk" #name, std::forward<Args>(args)...); \
    };
 
    INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_SHORTCUT)
 #undef DISPATCH_TABLE_SHORTCUT
 
 private:
+   /** Index of each entrypoint in m_fns, in the order of INSTANCE_ENTRYPOINTS_LIST. */
+   enum entrypoint_index : size_t
+   {
+#define DISPATCH_TABLE_INDEX(name, unused1, unused2, unused3) ENTRYPOINT_##name,
+      INSTANCE_ENTRYPOINTS_LIST(DISPATCH_TABLE_INDEX)
+#undef DISPATCH_TABLE_INDEX
+      ENTRYPOINT_COUNT
+   };
+
+   /** Entrypoints filled in by populate(), so the shortcuts above call through a plain load. */
+   PFN_vkVoidFunction m_fns[ENTRYPOINT_COUNT]{};
+
    /**
     * @brief Construct instance dispatch table object
     *
@@ -387,6 +403,13 @@ private:
    EP(MapMemory, "", VK_API_VERSION_1_0, true)                                                                     \
    EP(UnmapMemory, "", VK_API_VERSION_1_0, true)                                                                   \
    EP(GetImageSubresourceLayout, "", VK_API_VERSION_1_0, true)                                                     \
+   EP(CreateBuffer, "", VK_API_VERSION_1_0, true)                                                                  \
+   EP(DestroyBuffer, "", VK_API_VERSION_1_0, true)                                                                 \
+   EP(GetBufferMemoryRequirements, "", VK_API_VERSION_1_0, true)                                                   \
+   EP(BindBufferMemory, "", VK_API_VERSION_1_0, true)                                                              \
+   EP(CmdCopyImageToBuffer, "", VK_API_VERSION_1_0, true)                                                          \
+   EP(CmdBlitImage, "", VK_API_VERSION_1_0, true)                                                                  \
+   EP(CmdPipelineBarrier, "", VK_API_VERSION_1_0, true)                                                            \
    EP(CreateFence, "", VK_API_VERSION_1_0, true)                                                                   \
    EP(DestroyFence, "", VK_API_VERSION_1_0, true)                                                                  \
    EP(CreateSemaphore, "", VK_API_VERSION_1_0, true)                                                               \
@@ -432,6 +455,8 @@ private:
    EP(GetImageSparseMemoryRequirements2KHR, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, VK_API_VERSION_1_1,   \
       false)                                                                                                       \
    EP(ReleaseSwapchainImagesEXT, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME, VK_API_VERSION_1_1, false)         \
+   /* VK_EXT_external_memory_host */                                                                               \
+   EP(GetMemoryHostPointerPropertiesEXT, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, API_VERSION_MAX, false)       \
    /* Custom entrypoints */                                                                                        \
    DEVICE_ENTRYPOINTS_LIST_EXPANSION(EP)
 
@@ -479,17 +504,29 @@ public:
     *    disp.GetDeviceProcAddr(instance, fn_name);
     * The result type will be matching the function signature, so there is no need for casting.
     */
-#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)             \
-   template <class... Args>                                                  \
-   auto name(Args &&...args) const                                           \
-   {                                                                         \
-      return call_fn<PFN_vk##name>("vk" #name, std::forward<Args>(args)...); \
+#define DISPATCH_TABLE_SHORTCUT(name, unused1, unused2, unused3)                                       \
+   template <class... Args>                                                                            \
+   auto name(Args &&...args) const                                                                     \
+   {                                                                                                   \
+      return call_fn<PFN_vk##name>(m_fns[ENTRYPOINT_##name], "vk" #name, std::forward<Args>(args)...); \
    };
 
    DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_SHORTCUT)
 #undef DISPATCH_TABLE_SHORTCUT
 
 private:
+   /** Index of each entrypoint in m_fns, in the order of DEVICE_ENTRYPOINTS_LIST. */
+   enum entrypoint_index : size_t
+   {
+#define DISPATCH_TABLE_INDEX(name, unused1, unused2, unused3) ENTRYPOINT_##name,
+      DEVICE_ENTRYPOINTS_LIST(DISPATCH_TABLE_INDEX)
+#undef DISPATCH_TABLE_INDEX
+      ENTRYPOINT_COUNT
+   };
+
+   /** Entrypoints filled in by populate(), so the shortcuts above call through a plain load. */
+   PFN_vkVoidFunction m_fns[ENTRYPOINT_COUNT]{};
+
    /**
     * @brief Construct instance dispatch table object
     *
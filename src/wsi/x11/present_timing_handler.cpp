@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file present_timing_handler.cpp
+ *
+ * @brief Contains the functionality to implement features for present timing extension.
+ */
+
+#include "present_timing_handler.hpp"
+
+#include <array>
+
+wsi_ext_present_timing_x11::wsi_ext_present_timing_x11(const util::allocator &allocator)
+   : wsi_ext_present_timing(allocator)
+   , m_last_ust_ns(0)
+   , m_last_msc(0)
+   , m_refresh_duration(0)
+   , m_timing_properties_counter(0)
+{
+}
+
+util::unique_ptr<wsi_ext_present_timing_x11> wsi_ext_present_timing_x11::create(const util::allocator &allocator)
+{
+   std::array<util::unique_ptr<wsi::vulkan_time_domain>, 2> time_domains_array = {
+      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT,
+                                                     VK_TIME_DOMAIN_DEVICE_KHR),
+      allocator.make_unique<wsi::vulkan_time_domain>(VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
+                                                        VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT,
+                                                     VK_TIME_DOMAIN_CLOCK_MONOTONIC_KHR),
+   };
+
+   return wsi_ext_present_timing::create<wsi_ext_present_timing_x11>(allocator, time_domains_array);
+}
+
+VkResult wsi_ext_present_timing_x11::get_swapchain_timing_properties(
+   uint64_t &timing_properties_counter, VkSwapchainTimingPropertiesEXT &timing_properties)
+{
+   timing_properties_counter = m_timing_properties_counter.load();
+   timing_properties.refreshDuration = m_refresh_duration.load();
+   timing_properties.variableRefreshDelay = 0;
+
+   return VK_SUCCESS;
+}
+
+void wsi_ext_present_timing_x11::report_presented(uint64_t present_id, VkPresentStageFlagsEXT stages,
+                                                  uint64_t time_ns)
+{
+   complete_presentation_entry(present_id, stages, time_ns);
+}
+
+void wsi_ext_present_timing_x11::report_vblank(uint64_t ust_ns, uint64_t msc)
+{
+   std::lock_guard<std::mutex> lock(m_vblank_mutex);
+   if (m_last_ust_ns != 0 && msc > m_last_msc && ust_ns > m_last_ust_ns)
+   {
+      /* UST jitters by a few microseconds; only a change of more than 1% is a new refresh rate. */
+      const uint64_t interval_ns = (ust_ns - m_last_ust_ns) / (msc - m_last_msc);
+      const uint64_t current_ns = m_refresh_duration.load();
+      const uint64_t delta_ns = interval_ns > current_ns ? interval_ns - current_ns : current_ns - interval_ns;
+      if (delta_ns * 100 > current_ns)
+      {
+         m_refresh_duration.store(interval_ns);
+         m_timing_properties_counter++;
+      }
+   }
+   if (msc >= m_last_msc)
+   {
+      m_last_ust_ns = ust_ns;
+      m_last_msc = msc;
+   }
+}
+
+uint64_t wsi_ext_present_timing_x11::get_target_msc(uint64_t target_ns)
+{
+   std::lock_guard<std::mutex> lock(m_vblank_mutex);
+   if (m_last_ust_ns == 0)
+   {
+      return 0;
+   }
+
+   const uint64_t refresh_ns = m_refresh_duration.load();
+   if (target_ns <= m_last_ust_ns || refresh_ns == 0)
+   {
+      return m_last_msc;
+   }
+   return m_last_msc + (target_ns - m_last_ust_ns + refresh_ns / 2) / refresh_ns;
+}
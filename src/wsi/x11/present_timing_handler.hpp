@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file present_timing_handler.hpp
+ *
+ * @brief Contains the functionality to implement features for present timing extension.
+ */
+#pragma once
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+
+#include <wsi/extensions/present_timing.hpp>
+
+#include <atomic>
+#include <mutex>
+
+/**
+ * @brief Present timing extension class
+ *
+ * This class implements present timing features declarations that are specific to the X11 backend. Presentation
+ * times come from Present CompleteNotify events, whose UST is CLOCK_MONOTONIC in microseconds, or from the XSync
+ * fence of a SHM put when the window has no Present events.
+ */
+class wsi_ext_present_timing_x11 : public wsi::wsi_ext_present_timing
+{
+public:
+   static util::unique_ptr<wsi_ext_present_timing_x11> create(const util::allocator &allocator);
+
+   VkResult get_swapchain_timing_properties(uint64_t &timing_properties_counter,
+                                            VkSwapchainTimingPropertiesEXT &timing_properties) override;
+
+   /**
+    * @brief Record the result of a present.
+    *
+    * @param present_id The present id of the present.
+    * @param stages     Stages reached at @p time_ns, 0 if the present was skipped or has no timing.
+    * @param time_ns    CLOCK_MONOTONIC time the stages were reached.
+    */
+   void report_presented(uint64_t present_id, VkPresentStageFlagsEXT stages, uint64_t time_ns);
+
+   /**
+    * @brief Record a vblank the server reported, which the refresh duration and target MSCs are derived from.
+    *
+    * @param ust_ns CLOCK_MONOTONIC time of the vblank.
+    * @param msc    Its media stream counter.
+    */
+   void report_vblank(uint64_t ust_ns, uint64_t msc);
+
+   /**
+    * @brief Returns the MSC whose vblank is closest to @p target_ns, or 0 if no vblank was reported yet.
+    *
+    * Targets closer than half a refresh interval to the last reported vblank, or before it, get that MSC, which
+    * a present then treats as due at once.
+    */
+   uint64_t get_target_msc(uint64_t target_ns);
+
+private:
+   wsi_ext_present_timing_x11(const util::allocator &allocator);
+
+   /**
+    * @brief Protects the last reported vblank.
+    */
+   std::mutex m_vblank_mutex;
+   uint64_t m_last_ust_ns;
+   uint64_t m_last_msc;
+
+   /**
+    * @brief Refresh interval estimated from the reported vblanks, 0 until two were seen.
+    */
+   std::atomic<uint64_t> m_refresh_duration;
+
+   /**
+    * @brief Incremented every time @ref m_refresh_duration changes.
+    */
+   std::atomic<uint64_t> m_timing_properties_counter;
+
+   /* Allow util::allocator to access the private constructor */
+   friend util::allocator;
+};
+
+#endif
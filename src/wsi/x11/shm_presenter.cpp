@@ -32,21 +32,34 @@
 #include "surface.hpp"
 #include "swapchain.hpp"
 #include "utils/logging.hpp"
+#include "utils/thread_placement.hpp"
+#include "utils/trace.hpp"
+#include "core/metrics_page.hpp"
+#if MALI_WRAPPER_HARNESS
+#include "core/harness.hpp"
+#endif
 
 #include <sys/shm.h>
 #include <sys/ipc.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <system_error>
 #include <thread>
 #include <vector>
 #include <chrono>
 #include <cmath>
+#include <ctime>
 #ifdef ENABLE_ARM_NEON
 #include <arm_neon.h>
 #endif
-#include <X11/Xlib.h>
-#include <X11/extensions/Xrandr.h>
 #include <xcb/sync.h>
 
 namespace wsi
@@ -57,22 +70,235 @@ namespace x11
 static constexpr uint32_t SIMD_VECTOR_SIZE = 4;
 static constexpr uint32_t LOOP_UNROLL_BOUNDARY = 3;
 static constexpr int SHM_PERMISSIONS = 0666;
+static constexpr uint32_t MAX_SHM_COPY_WORKERS = 3;
+static constexpr uint32_t DEFAULT_SHM_COPY_MIN_ROWS = 256;
+static constexpr uint32_t DAMAGE_TILE_SIZE = 64;
+/* Puts allowed to wait behind the one the put thread is running. More would let FIFO run ahead of the display. */
+static constexpr size_t MAX_QUEUED_PUTS = 1;
+
+static uint64_t monotonic_ns()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+static uint32_t read_shm_copy_env(const char *name, uint32_t fallback)
+{
+   const char *value = std::getenv(name);
+   if (value == nullptr || value[0] == '\0')
+   {
+      return fallback;
+   }
+
+   errno = 0;
+   char *end = nullptr;
+   unsigned long parsed = std::strtoul(value, &end, 10);
+   if (errno != 0 || end == value || *end != '\0')
+   {
+      WSI_LOG_WARNING("SHM presenter: invalid %s='%s', using %u.", name, value, fallback);
+      return fallback;
+   }
+   return static_cast<uint32_t>(std::min<unsigned long>(parsed, UINT32_MAX));
+}
+
+/* Leave asynchronous signals to the application threads. */
+static void block_async_signals()
+{
+   sigset_t blocked;
+   sigfillset(&blocked);
+   sigdelset(&blocked, SIGSEGV);
+   sigdelset(&blocked, SIGBUS);
+   sigdelset(&blocked, SIGFPE);
+   sigdelset(&blocked, SIGILL);
+   pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+}
+
+/**
+ * @brief Persistent helper threads that split SHM pixel copies by rows.
+ *
+ * Shared by every presenter in the process. Workers are started on the first
+ * frame worth splitting and stay parked until the process exits; one frame is
+ * copied at a time and the presenting thread always copies a band itself.
+ *
+ * WSI_SHM_COPY_THREADS sets the helper count (default: up to 3, 0 disables the
+ * pool) and WSI_SHM_COPY_MIN_ROWS the smallest band a thread is given.
+ */
+class shm_copy_pool
+{
+public:
+   using band_fn = std::function<void(uint32_t first_row, uint32_t row_count)>;
+
+   static shm_copy_pool &instance()
+   {
+      static shm_copy_pool pool;
+      return pool;
+   }
+
+   /* Calls fn over [0, rows) in bands and returns once every band is done. */
+   void run(uint32_t rows, const band_fn &fn)
+   {
+      const uint32_t bands = std::min<uint32_t>(m_worker_count + 1, rows / m_min_rows);
+      if (bands < 2 || !ensure_workers())
+      {
+         fn(0, rows);
+         return;
+      }
+
+      std::lock_guard<std::mutex> frame_lock(m_frame_mutex);
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_fn = &fn;
+         m_rows = rows;
+         m_bands = std::min<uint32_t>(bands, static_cast<uint32_t>(m_workers.size()) + 1);
+         m_next_band = 1;
+         m_pending = m_bands - 1;
+      }
+      m_work_available.notify_all();
+
+      run_band(fn, 0, rows, m_bands);
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_work_done.wait(lock, [this]() { return m_pending == 0; });
+      m_fn = nullptr;
+   }
+
+   /* Threads a frame is split across once the workers run, the presenting thread included. */
+   uint32_t thread_count()
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      return static_cast<uint32_t>(m_workers_started ? m_workers.size() : m_worker_count) + 1;
+   }
+
+private:
+   shm_copy_pool()
+   {
+      const unsigned int hardware_threads = std::thread::hardware_concurrency();
+      const uint32_t default_workers =
+         hardware_threads > 1 ? std::min<uint32_t>(MAX_SHM_COPY_WORKERS, hardware_threads - 1) : 0;
+      m_worker_count = std::min<uint32_t>(read_shm_copy_env("WSI_SHM_COPY_THREADS", default_workers),
+                                          hardware_threads > 0 ? hardware_threads : 1);
+      m_min_rows = std::max<uint32_t>(1, read_shm_copy_env("WSI_SHM_COPY_MIN_ROWS", DEFAULT_SHM_COPY_MIN_ROWS));
+   }
+
+   ~shm_copy_pool()
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_stopping = true;
+      }
+      m_work_available.notify_all();
+      for (auto &worker : m_workers)
+      {
+         if (worker.joinable())
+         {
+            worker.join();
+         }
+      }
+   }
+
+   shm_copy_pool(const shm_copy_pool &) = delete;
+   shm_copy_pool &operator=(const shm_copy_pool &) = delete;
+
+   static void run_band(const band_fn &fn, uint32_t band, uint32_t rows, uint32_t bands)
+   {
+      const uint32_t first_row = static_cast<uint32_t>((static_cast<uint64_t>(rows) * band) / bands);
+      const uint32_t end_row = static_cast<uint32_t>((static_cast<uint64_t>(rows) * (band + 1)) / bands);
+      fn(first_row, end_row - first_row);
+   }
+
+   bool ensure_workers()
+   {
+      if (m_worker_count == 0)
+      {
+         return false;
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_workers_started)
+      {
+         m_workers_started = true;
+         for (uint32_t i = 0; i < m_worker_count; i++)
+         {
+            try
+            {
+               m_workers.emplace_back(&shm_copy_pool::worker_main, this);
+            }
+            catch (const std::system_error &e)
+            {
+               WSI_LOG_WARNING("SHM presenter: failed to start copy worker: %s", e.what());
+               break;
+            }
+         }
+         WSI_LOG_INFO("SHM presenter: %zu copy worker(s), minimum %u rows per band", m_workers.size(), m_min_rows);
+      }
+      return !m_workers.empty();
+   }
+
+   void worker_main()
+   {
+      block_async_signals();
+      mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::WORKER, "SHM copy worker");
+
+      std::unique_lock<std::mutex> lock(m_mutex);
+      for (;;)
+      {
+         m_work_available.wait(lock, [this]() { return m_stopping || m_next_band < m_bands; });
+         if (m_stopping)
+         {
+            return;
+         }
+
+         const uint32_t band = m_next_band++;
+         const band_fn *fn = m_fn;
+         const uint32_t rows = m_rows;
+         const uint32_t bands = m_bands;
+
+         lock.unlock();
+         run_band(*fn, band, rows, bands);
+         lock.lock();
+
+         if (--m_pending == 0)
+         {
+            m_work_done.notify_all();
+         }
+      }
+   }
+
+   uint32_t m_worker_count = 0;
+   uint32_t m_min_rows = DEFAULT_SHM_COPY_MIN_ROWS;
+
+   std::mutex m_frame_mutex;
+   std::mutex m_mutex;
+   std::condition_variable m_work_available;
+   std::condition_variable m_work_done;
+   std::vector<std::thread> m_workers;
+   bool m_workers_started = false;
+   bool m_stopping = false;
+
+   /* Current frame; m_next_band == m_bands once every band is claimed. */
+   const band_fn *m_fn = nullptr;
+   uint32_t m_rows = 0;
+   uint32_t m_bands = 0;
+   uint32_t m_next_band = 0;
+   uint32_t m_pending = 0;
+};
 static constexpr uint32_t GC_COLOR_MASK = XCB_GC_BACKGROUND | XCB_GC_FOREGROUND;
 
 shm_presenter::shm_presenter()
-   : m_sync_pending(false)
-   , m_frame_interval(std::chrono::microseconds(16667))
+   : m_frame_interval(std::chrono::microseconds(16667))
    , m_refresh_rate_hz(60.0)
 {
 }
 
 shm_presenter::~shm_presenter()
 {
-   if (m_sync_pending)
+   stop_put_thread();
+   cleanup_pacing();
+   if (m_copy_stats_enabled)
    {
-      ensure_sync_completion();
+      log_copy_stats();
    }
-   cleanup_fence_sync();
 }
 
 bool shm_presenter::is_aligned(const void *ptr, size_t alignment)
@@ -88,142 +314,485 @@ bool shm_presenter::are_pointers_neon_aligned(const void *src, void *dst)
 }
 #endif
 
-double shm_presenter::get_window_refresh_rate()
+void shm_presenter::detect_refresh_rate()
+{
+   double detected_refresh_rate = m_wsi_surface != nullptr ? m_wsi_surface->get_refresh_rate() : 60.0;
+   if (detected_refresh_rate == m_refresh_rate_hz)
+   {
+      return;
+   }
+
+   m_refresh_rate_hz = detected_refresh_rate;
+   auto interval_us = static_cast<long>(1000000.0 / detected_refresh_rate);
+   m_frame_interval = std::chrono::microseconds(interval_us);
+}
+
+void shm_presenter::init_pacing(VkPresentModeKHR present_mode)
 {
-   double detected_refresh_rate = 60.0;
-   bool found_refresh_rate = false;
+   const char *env = std::getenv("WSI_SHM_PACING");
+   /* MAILBOX frames come from the swapchain's mailbox thread, which pacing holds back rather than the application. */
+   const bool paced_mode = present_mode == VK_PRESENT_MODE_FIFO_KHR ||
+                           present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR ||
+                           present_mode == VK_PRESENT_MODE_MAILBOX_KHR;
 
-   Display *display = XOpenDisplay(nullptr);
-   if (!display)
+   if (env != nullptr && env[0] != '\0')
    {
-      WSI_LOG_WARNING("Failed to open X11 display, using 60Hz default");
-      return detected_refresh_rate;
+      if (std::strcmp(env, "off") == 0 || std::strcmp(env, "0") == 0)
+      {
+         m_pacing = shm_pacing::unpaced;
+      }
+      else if (std::strcmp(env, "timer") == 0)
+      {
+         m_pacing = shm_pacing::timer;
+      }
+      else if (std::strcmp(env, "vblank") == 0)
+      {
+         m_pacing = shm_pacing::vblank;
+      }
+      else
+      {
+         WSI_LOG_WARNING("SHM presenter: invalid WSI_SHM_PACING='%s', using the default.", env);
+         m_pacing = paced_mode ? shm_pacing::vblank : shm_pacing::unpaced;
+      }
+   }
+   else
+   {
+      /* IMMEDIATE must not block the application on the display. */
+      m_pacing = paced_mode ? shm_pacing::vblank : shm_pacing::unpaced;
    }
 
-   Window root = DefaultRootWindow(display);
+   if (m_pacing != shm_pacing::vblank)
+   {
+      return;
+   }
 
-   int event_base, error_base;
-   if (XRRQueryExtension(display, &event_base, &error_base))
+   const xcb_query_extension_reply_t *present_ext = xcb_get_extension_data(m_connection, &xcb_present_id);
+   if (present_ext != nullptr && present_ext->present)
    {
-      XRRScreenResources *resources = XRRGetScreenResources(display, root);
-      if (resources)
+      m_present_event_id = xcb_generate_id(m_connection);
+      m_present_special_event =
+         xcb_register_for_special_xge(m_connection, &xcb_present_id, m_present_event_id, nullptr);
+   }
+
+   if (m_present_special_event == nullptr)
+   {
+      WSI_LOG_INFO("SHM presenter: Present is unavailable, pacing with the refresh timer.");
+      m_pacing = shm_pacing::timer;
+      return;
+   }
+
+   xcb_present_select_input(m_connection, m_present_event_id, m_window, XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+   WSI_LOG_INFO("SHM presenter: pacing frames to Present vblank notifications.");
+}
+
+void shm_presenter::cleanup_pacing()
+{
+   if (m_present_special_event == nullptr)
+   {
+      return;
+   }
+
+   xcb_present_select_input(m_connection, m_present_event_id, m_window, XCB_PRESENT_EVENT_MASK_NO_EVENT);
+   xcb_unregister_for_special_event(m_connection, m_present_special_event);
+   m_present_special_event = nullptr;
+}
+
+void shm_presenter::pace_with_timer()
+{
+   /* Cached by the surface, so following the window to another monitor costs no round trip. */
+   detect_refresh_rate();
+
+   auto current_time = std::chrono::steady_clock::now();
+   auto time_since_last = std::chrono::duration_cast<std::chrono::microseconds>(current_time - m_last_frame_time);
+
+   if (m_last_frame_time.time_since_epoch().count() > 0 && time_since_last < m_frame_interval)
+   {
+      auto sleep_time = m_frame_interval - time_since_last;
+
+      if (sleep_time > std::chrono::microseconds(500))
       {
-         int active_crtc_count = 0;
-         for (int i = 0; i < resources->ncrtc; i++)
+         auto conservative_sleep = sleep_time - std::chrono::microseconds(200);
+         std::this_thread::sleep_for(conservative_sleep);
+      }
+
+      auto target_time = m_last_frame_time + m_frame_interval;
+      while (std::chrono::steady_clock::now() < target_time)
+      {
+         std::this_thread::sleep_for(std::chrono::microseconds(10));
+      }
+      current_time = std::chrono::steady_clock::now();
+   }
+   m_last_frame_time = current_time;
+}
+
+bool shm_presenter::pace_with_vblank(uint32_t serial, uint64_t target_msc)
+{
+   /* Ask for the vblank after the previous frame's. If the application fell behind, that MSC has already
+    * passed and the notify completes at once, so a late frame is never held back a further interval. The
+    * first frame only learns the current MSC. */
+   if (target_msc == 0)
+   {
+      target_msc = m_last_msc != 0 ? m_last_msc + 1 : 0;
+   }
+   xcb_present_notify_msc(m_connection, m_window, serial, target_msc, 0, 0);
+   if (xcb_flush(m_connection) <= 0)
+   {
+      return false;
+   }
+
+   for (;;)
+   {
+      xcb_generic_event_t *event = xcb_wait_for_special_event(m_connection, m_present_special_event);
+      if (event == nullptr)
+      {
+         return false;
+      }
+
+      auto present_event = reinterpret_cast<const xcb_present_generic_event_t *>(event);
+      bool done = false;
+      if (present_event->evtype == XCB_PRESENT_EVENT_COMPLETE_NOTIFY)
+      {
+         auto complete = reinterpret_cast<const xcb_present_complete_notify_event_t *>(event);
+         if (complete->kind == XCB_PRESENT_COMPLETE_KIND_NOTIFY_MSC && complete->serial == serial)
          {
-            XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
-            if (crtc_info && crtc_info->mode != None && crtc_info->noutput > 0)
-            {
-               active_crtc_count++;
-            }
-            if (crtc_info)
-               XRRFreeCrtcInfo(crtc_info);
+            m_last_msc = complete->msc;
+            m_last_ust_ns = complete->ust * 1000;
+            done = true;
          }
+      }
+      free(event);
+
+      if (done)
+      {
+         return true;
+      }
+   }
+}
 
-         bool single_screen = (active_crtc_count == 1);
+void shm_presenter::wait_for_target_time(const put_job &job)
+{
+   if (job.target_ns == 0)
+   {
+      return;
+   }
 
-         int window_x = 0, window_y = 0;
+   const uint64_t interval_ns =
+      static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(m_frame_interval).count());
+   if (m_pacing == shm_pacing::vblank)
+   {
+      /* A put shows at the vblank after it lands, so put right after the one before the target's. */
+      if (m_last_ust_ns != 0 && job.target_ns > m_last_ust_ns + interval_ns + interval_ns / 2)
+      {
+         const uint64_t target_msc = m_last_msc + (job.target_ns - m_last_ust_ns + interval_ns / 2) / interval_ns;
+         /* A lost notification makes the pacing after the put fall back to the timer. */
+         pace_with_vblank(job.serial, target_msc - 1);
+      }
+      return;
+   }
 
-         if (!single_screen)
-         {
-            xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(m_connection)).data;
-            xcb_window_t root_window = screen->root;
+   if (job.target_ns > interval_ns)
+   {
+      const uint64_t wake_ns = job.target_ns - interval_ns;
+      const timespec wake = { static_cast<time_t>(wake_ns / 1000000000ull),
+                              static_cast<long>(wake_ns % 1000000000ull) };
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, nullptr) == EINTR)
+      {
+      }
+   }
+}
 
-            xcb_translate_coordinates_cookie_t translate_cookie =
-               xcb_translate_coordinates(m_connection, m_window, root_window, 0, 0);
-            xcb_translate_coordinates_reply_t *translate_reply =
-               xcb_translate_coordinates_reply(m_connection, translate_cookie, nullptr);
+bool shm_presenter::select_damage(const present_damage &damage, const char *src_base, size_t src_stride,
+                                  uint32_t width, uint32_t height)
+{
+   m_damage_rects.clear();
+   const bool window_current = m_window_complete && width == m_damage_width && height == m_damage_height;
 
-            if (translate_reply)
-            {
-               window_x = translate_reply->dst_x;
-               window_y = translate_reply->dst_y;
-               free(translate_reply);
-            }
+   if (damage.rect_count > 0)
+   {
+      /* The hashes no longer describe what the window shows. */
+      m_tile_hashes.clear();
+      if (!window_current)
+      {
+         return false;
+      }
+
+      for (uint32_t i = 0; i < damage.rect_count; ++i)
+      {
+         const VkRect2D &rect = damage.rects[i];
+         const int64_t x0 = std::max<int64_t>(rect.offset.x, 0);
+         const int64_t y0 = std::max<int64_t>(rect.offset.y, 0);
+         const int64_t x1 = std::min<int64_t>(static_cast<int64_t>(rect.offset.x) + rect.extent.width, width);
+         const int64_t y1 = std::min<int64_t>(static_cast<int64_t>(rect.offset.y) + rect.extent.height, height);
+         if (x1 > x0 && y1 > y0)
+         {
+            m_damage_rects.push_back({ static_cast<int16_t>(x0), static_cast<int16_t>(y0),
+                                       static_cast<uint16_t>(x1 - x0), static_cast<uint16_t>(y1 - y0) });
          }
+      }
+      return true;
+   }
 
-         for (int i = 0; i < resources->ncrtc; i++)
+   if (!m_damage_tiles || src_base == nullptr)
+   {
+      m_tile_hashes.clear();
+      return false;
+   }
+
+   return detect_tile_damage(src_base, src_stride, width, height, !window_current);
+}
+
+/* Four independent FNV-1a lanes over 32-bit pixels, so the inner loop vectorises. */
+static uint64_t hash_tile(const char *src_base, size_t src_stride, uint32_t x, uint32_t y, uint32_t width,
+                          uint32_t height)
+{
+   constexpr uint32_t FNV_PRIME = 16777619u;
+   uint32_t lanes[4] = { 2166136261u, 0x9e3779b9u, 0x85ebca6bu, 0xc2b2ae35u };
+
+   for (uint32_t row = 0; row < height; ++row)
+   {
+      const uint32_t *pixels = reinterpret_cast<const uint32_t *>(src_base + (y + row) * src_stride) + x;
+      uint32_t i = 0;
+      for (; i + 4 <= width; i += 4)
+      {
+         for (uint32_t lane = 0; lane < 4; ++lane)
          {
-            XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(display, resources, resources->crtcs[i]);
-            if (crtc_info && crtc_info->mode != None && crtc_info->noutput > 0)
-            {
-               bool window_on_crtc = false;
+            lanes[lane] = (lanes[lane] ^ pixels[i + lane]) * FNV_PRIME;
+         }
+      }
+      for (; i < width; ++i)
+      {
+         lanes[0] = (lanes[0] ^ pixels[i]) * FNV_PRIME;
+      }
+   }
 
-               if (single_screen)
-               {
-                  window_on_crtc = true;
-               }
-               else
-               {
-                  window_on_crtc = (window_x >= crtc_info->x && window_x < crtc_info->x + (int)crtc_info->width &&
-                                    window_y >= crtc_info->y && window_y < crtc_info->y + (int)crtc_info->height);
-               }
+   const uint64_t low = static_cast<uint64_t>(lanes[0]) | (static_cast<uint64_t>(lanes[1]) << 32);
+   const uint64_t high = static_cast<uint64_t>(lanes[2]) | (static_cast<uint64_t>(lanes[3]) << 32);
+   return low ^ (high * 0x9e3779b97f4a7c15ull);
+}
 
-               for (int j = 0; j < resources->nmode; j++)
-               {
-                  XRRModeInfo *mode = &resources->modes[j];
-                  if (mode->id == crtc_info->mode)
-                  {
-                     double refresh = (double)mode->dotClock / ((double)mode->hTotal * (double)mode->vTotal);
-
-                     if (window_on_crtc)
-                     {
-                        detected_refresh_rate = refresh;
-                        found_refresh_rate = true;
-                        break;
-                     }
-                     else if (!found_refresh_rate)
-                     {
-                        detected_refresh_rate = refresh;
-                        found_refresh_rate = true;
-                     }
-                     break;
-                  }
-               }
+bool shm_presenter::detect_tile_damage(const char *src_base, size_t src_stride, uint32_t width, uint32_t height,
+                                       bool reset)
+{
+   const uint32_t cols = (width + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+   const uint32_t rows = (height + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE;
+   const bool have_previous = !reset && m_tile_hashes.size() == static_cast<size_t>(cols) * rows;
+   if (!have_previous)
+   {
+      m_tile_hashes.assign(static_cast<size_t>(cols) * rows, 0);
+   }
+
+   size_t changed_tiles = 0;
+   for (uint32_t ty = 0; ty < rows; ++ty)
+   {
+      const uint32_t y = ty * DAMAGE_TILE_SIZE;
+      const uint32_t tile_height = std::min(DAMAGE_TILE_SIZE, height - y);
+      const size_t row_begin = m_damage_rects.size();
 
-               if (crtc_info)
-                  XRRFreeCrtcInfo(crtc_info);
-               if (found_refresh_rate && window_on_crtc)
-                  break;
+      uint32_t run_begin = 0;
+      bool in_run = false;
+      for (uint32_t tx = 0; tx <= cols; ++tx)
+      {
+         bool changed = false;
+         if (tx < cols)
+         {
+            const uint32_t x = tx * DAMAGE_TILE_SIZE;
+            const uint64_t hash =
+               hash_tile(src_base, src_stride, x, y, std::min(DAMAGE_TILE_SIZE, width - x), tile_height);
+            uint64_t &stored = m_tile_hashes[static_cast<size_t>(ty) * cols + tx];
+            changed = !have_previous || hash != stored;
+            stored = hash;
+         }
+
+         if (changed)
+         {
+            changed_tiles++;
+            if (!in_run)
+            {
+               run_begin = tx;
+               in_run = true;
             }
+            continue;
+         }
+         if (!in_run)
+         {
+            continue;
          }
 
-         XRRFreeScreenResources(resources);
+         /* Close the run, growing a rectangle of the row above when it spans the same columns. */
+         in_run = false;
+         const int16_t rect_x = static_cast<int16_t>(run_begin * DAMAGE_TILE_SIZE);
+         const uint16_t rect_width = static_cast<uint16_t>(std::min(tx * DAMAGE_TILE_SIZE, width) - rect_x);
+         bool merged = false;
+         for (size_t i = 0; i < row_begin; ++i)
+         {
+            auto &rect = m_damage_rects[i];
+            if (rect.x == rect_x && rect.width == rect_width && rect.y + rect.height == static_cast<int32_t>(y))
+            {
+               rect.height = static_cast<uint16_t>(rect.height + tile_height);
+               merged = true;
+               break;
+            }
+         }
+         if (!merged)
+         {
+            m_damage_rects.push_back(
+               { rect_x, static_cast<int16_t>(y), rect_width, static_cast<uint16_t>(tile_height) });
+         }
       }
-      else
+   }
+
+   /* With no previous hashes, or nearly everything changed, one full update is cheaper. */
+   return have_previous && changed_tiles * 4 < static_cast<size_t>(cols) * rows * 3;
+}
+
+void shm_presenter::copy_damage_rects(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride)
+{
+   for (const auto &rect : m_damage_rects)
+   {
+      const size_t row_bytes = static_cast<size_t>(rect.width) * sizeof(uint32_t);
+      const size_t x_offset = static_cast<size_t>(rect.x) * sizeof(uint32_t);
+      for (uint32_t row = rect.y; row < static_cast<uint32_t>(rect.y + rect.height); ++row)
       {
-         WSI_LOG_WARNING("Failed to get XRandR screen resources");
+         std::memcpy(dst_base + row * dst_stride + x_offset, src_base + row * src_stride + x_offset, row_bytes);
       }
    }
-   else
+}
+
+uint64_t shm_presenter::damage_bytes(size_t bytes_per_pixel) const
+{
+   uint64_t pixels = 0;
+   for (const auto &rect : m_damage_rects)
    {
-      WSI_LOG_WARNING("XRandR extension not available");
+      pixels += static_cast<uint64_t>(rect.width) * rect.height;
    }
+   return pixels * bytes_per_pixel;
+}
 
-   XCloseDisplay(display);
+/* Row kernels from B8G8R8A8 (0xAARRGGBB in memory order B, G, R, A) to the pixmap formats of lower depth
+ * visuals. Channels are truncated to 565, and widened to 10 bits by replicating their top bits. */
+using pixel_convert_fn = void (*)(const uint32_t *src, uint8_t *dst, uint32_t count);
 
-   if (!found_refresh_rate)
+static inline uint32_t expand_8_to_10(uint32_t channel)
+{
+   return (channel << 2) | (channel >> 6);
+}
+
+static void convert_row_rgb565(const uint32_t *src, uint8_t *dst, uint32_t count)
+{
+   uint16_t *dst_pixels = reinterpret_cast<uint16_t *>(dst);
+   uint32_t x = 0;
+#ifdef ENABLE_ARM_NEON
+   for (; x + 8 <= count; x += 8)
+   {
+      const uint8x8x4_t px = vld4_u8(reinterpret_cast<const uint8_t *>(src + x));
+      uint16x8_t out = vshll_n_u8(px.val[2], 8);
+      out = vsriq_n_u16(out, vshll_n_u8(px.val[1], 8), 5);
+      out = vsriq_n_u16(out, vshll_n_u8(px.val[0], 8), 11);
+      vst1q_u16(dst_pixels + x, out);
+   }
+#endif
+   for (; x < count; x++)
    {
-      WSI_LOG_WARNING("Could not detect refresh rate, using 60Hz default");
+      const uint32_t p = src[x];
+      dst_pixels[x] = static_cast<uint16_t>(((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f));
    }
+}
 
-   // Reasonable bounds for display refresh rates
-   if (detected_refresh_rate < 30.0 || detected_refresh_rate > 240.0)
+static void convert_row_rgb888(const uint32_t *src, uint8_t *dst, uint32_t count)
+{
+   uint32_t x = 0;
+#ifdef ENABLE_ARM_NEON
+   for (; x + 8 <= count; x += 8)
    {
-      WSI_LOG_WARNING("Detected refresh rate %.2f Hz seems invalid, using 60Hz", detected_refresh_rate);
-      detected_refresh_rate = 60.0;
+      const uint8x8x4_t px = vld4_u8(reinterpret_cast<const uint8_t *>(src + x));
+      const uint8x8x3_t out = { { px.val[0], px.val[1], px.val[2] } };
+      vst3_u8(dst + x * 3, out);
    }
+#endif
+   for (; x < count; x++)
+   {
+      const uint32_t p = src[x];
+      dst[x * 3 + 0] = static_cast<uint8_t>(p);
+      dst[x * 3 + 1] = static_cast<uint8_t>(p >> 8);
+      dst[x * 3 + 2] = static_cast<uint8_t>(p >> 16);
+   }
+}
 
-   return detected_refresh_rate;
+static void convert_row_x2r10g10b10(const uint32_t *src, uint8_t *dst, uint32_t count)
+{
+   uint32_t *dst_pixels = reinterpret_cast<uint32_t *>(dst);
+   uint32_t x = 0;
+#ifdef ENABLE_ARM_NEON
+   for (; x + 8 <= count; x += 8)
+   {
+      const uint8x8x4_t px = vld4_u8(reinterpret_cast<const uint8_t *>(src + x));
+      const uint16x8_t r = vorrq_u16(vshll_n_u8(px.val[2], 2), vmovl_u8(vshr_n_u8(px.val[2], 6)));
+      const uint16x8_t g = vorrq_u16(vshll_n_u8(px.val[1], 2), vmovl_u8(vshr_n_u8(px.val[1], 6)));
+      const uint16x8_t b = vorrq_u16(vshll_n_u8(px.val[0], 2), vmovl_u8(vshr_n_u8(px.val[0], 6)));
+
+      uint32x4_t low = vshlq_n_u32(vmovl_u16(vget_low_u16(r)), 20);
+      low = vorrq_u32(low, vshlq_n_u32(vmovl_u16(vget_low_u16(g)), 10));
+      low = vorrq_u32(low, vmovl_u16(vget_low_u16(b)));
+      uint32x4_t high = vshlq_n_u32(vmovl_u16(vget_high_u16(r)), 20);
+      high = vorrq_u32(high, vshlq_n_u32(vmovl_u16(vget_high_u16(g)), 10));
+      high = vorrq_u32(high, vmovl_u16(vget_high_u16(b)));
+
+      vst1q_u32(dst_pixels + x, low);
+      vst1q_u32(dst_pixels + x + 4, high);
+   }
+#endif
+   for (; x < count; x++)
+   {
+      const uint32_t p = src[x];
+      dst_pixels[x] = (expand_8_to_10((p >> 16) & 0xff) << 20) | (expand_8_to_10((p >> 8) & 0xff) << 10) |
+                      expand_8_to_10(p & 0xff);
+   }
 }
 
-void shm_presenter::detect_refresh_rate()
+void shm_presenter::convert_pixels(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride,
+                                   uint32_t width, uint32_t height, bool damage_only)
 {
-   double detected_refresh_rate = get_window_refresh_rate();
+   pixel_convert_fn convert = nullptr;
+   size_t dst_bytes_per_pixel = 0;
+   switch (m_pixel_conversion)
+   {
+   case shm_pixel_conversion::rgb565:
+      convert = convert_row_rgb565;
+      dst_bytes_per_pixel = 2;
+      break;
+   case shm_pixel_conversion::rgb888:
+      convert = convert_row_rgb888;
+      dst_bytes_per_pixel = 3;
+      break;
+   case shm_pixel_conversion::x2r10g10b10:
+      convert = convert_row_x2r10g10b10;
+      dst_bytes_per_pixel = 4;
+      break;
+   default:
+      return;
+   }
 
-   m_refresh_rate_hz = detected_refresh_rate;
-   auto interval_us = static_cast<long>(1000000.0 / detected_refresh_rate);
-   m_frame_interval = std::chrono::microseconds(interval_us);
+   auto convert_rows = [&](uint32_t x, uint32_t first_row, uint32_t row_count, uint32_t pixels) {
+      for (uint32_t row = first_row; row < first_row + row_count; ++row)
+      {
+         const uint32_t *src = reinterpret_cast<const uint32_t *>(src_base + row * src_stride) + x;
+         uint8_t *dst = reinterpret_cast<uint8_t *>(dst_base + row * dst_stride) + x * dst_bytes_per_pixel;
+         convert(src, dst, pixels);
+      }
+   };
+
+   if (damage_only)
+   {
+      for (const auto &rect : m_damage_rects)
+      {
+         convert_rows(rect.x, rect.y, rect.height, rect.width);
+      }
+      return;
+   }
+
+   shm_copy_pool::instance().run(height, [&](uint32_t first_row, uint32_t row_count) {
+      convert_rows(0, first_row, row_count, width);
+   });
 }
 
 void shm_presenter::precompute_scaling_lut(uint32_t gpu_width, uint32_t display_width)
@@ -345,192 +914,242 @@ void shm_presenter::copy_pixels_scalar(const uint32_t *src_pixels, uint32_t *dst
 void shm_presenter::copy_pixels_threaded(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
                                          uint32_t dst_width, uint32_t height)
 {
-   copy_pixels_optimized_single_thread(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
+   /* Bands only read m_scaling_lut, which stays untouched until the copy returns. */
+   shm_copy_pool::instance().run(height, [&](uint32_t first_row, uint32_t row_count) {
+      copy_pixels_optimized_single_thread(src_pixels + static_cast<size_t>(first_row) * src_stride_pixels,
+                                          dst_pixels + static_cast<size_t>(first_row) * dst_width, src_stride_pixels,
+                                          dst_width, row_count);
+   });
 }
 
 void shm_presenter::copy_pixels_optimized_single_thread(const uint32_t *src_pixels, uint32_t *dst_pixels,
                                                         uint32_t src_stride_pixels, uint32_t dst_width, uint32_t height)
 {
 #ifdef ENABLE_ARM_NEON
-   copy_pixels_simd(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
-#else
-   copy_pixels_scalar(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
+   if (m_copy_kernel != shm_copy_kernel::scalar)
+   {
+      copy_pixels_simd(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
+      return;
+   }
 #endif
+   copy_pixels_scalar(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
 }
 
-void shm_presenter::copy_pixels_optimized(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
-                                          uint32_t dst_width, uint32_t height)
+shm_copy_path shm_presenter::copy_pixels_optimized(const uint32_t *src_pixels, uint32_t *dst_pixels,
+                                                   uint32_t src_stride_pixels, uint32_t dst_width, uint32_t height)
 {
-   if (src_stride_pixels == dst_width && m_scaling_lut.empty())
+   if (src_stride_pixels == dst_width && m_scaling_lut.empty() && m_copy_kernel == shm_copy_kernel::automatic)
    {
-      const size_t copy_size = dst_width * height * sizeof(uint32_t);
-      std::memcpy(dst_pixels, src_pixels, copy_size);
-      return;
+      shm_copy_pool::instance().run(height, [&](uint32_t first_row, uint32_t row_count) {
+         const size_t offset = static_cast<size_t>(first_row) * dst_width;
+         std::memcpy(dst_pixels + offset, src_pixels + offset,
+                     static_cast<size_t>(row_count) * dst_width * sizeof(uint32_t));
+      });
+      return shm_copy_path::memcpy_bands;
    }
 
    copy_pixels_threaded(src_pixels, dst_pixels, src_stride_pixels, dst_width, height);
+   return m_scaling_lut.empty() ? shm_copy_path::rows : shm_copy_path::lut;
 }
 
-void shm_presenter::start_async_sync()
+void shm_presenter::record_copy(shm_copy_path path, uint64_t bytes, uint64_t start_ns)
 {
-   if (m_sync_pending)
-   {
-      return;
-   }
-
-   m_pending_sync_cookie = xcb_get_geometry(m_connection, m_window);
-   m_sync_pending = true;
+   copy_stats &stats = m_copy_stats[static_cast<size_t>(path)];
+   stats.frames++;
+   stats.bytes += bytes;
+   stats.ns += monotonic_ns() - start_ns;
 }
 
-bool shm_presenter::check_pending_sync()
+void shm_presenter::log_copy_stats() const
 {
-   if (!m_sync_pending)
+   static const char *const path_names[] = { "memcpy", "rows", "lut", "scale", "convert", "damage", "fallback" };
+   static_assert(sizeof(path_names) / sizeof(path_names[0]) == static_cast<size_t>(shm_copy_path::count),
+                 "every copy path needs a name");
+   static const char *const kernel_names[] = { "auto", "simd", "scalar" };
+
+   const uint32_t threads = shm_copy_pool::instance().thread_count();
+   for (size_t i = 0; i < static_cast<size_t>(shm_copy_path::count); i++)
    {
-      return true;
+      const copy_stats &stats = m_copy_stats[i];
+      if (stats.frames == 0 || stats.ns == 0)
+      {
+         continue;
+      }
+      /* Bytes per nanosecond is GB/s; the source is read once for every byte written. */
+      WSI_LOG_INFO("SHM copy stats: %s (kernel %s, %u thread(s)): %llu frames, %.3f ms/frame, %.2f GB/s written",
+                   path_names[i], kernel_names[static_cast<size_t>(m_copy_kernel)], threads,
+                   static_cast<unsigned long long>(stats.frames),
+                   static_cast<double>(stats.ns) / static_cast<double>(stats.frames) / 1e6,
+                   static_cast<double>(stats.bytes) / static_cast<double>(stats.ns));
    }
+}
 
-   xcb_generic_error_t *error = nullptr;
-   xcb_get_geometry_reply_t *sync_reply = xcb_get_geometry_reply(m_connection, m_pending_sync_cookie, &error);
-
-   if (sync_reply)
+bool shm_presenter::init_fence_sync()
+{
+   const xcb_query_extension_reply_t *sync_ext = xcb_get_extension_data(m_connection, &xcb_sync_id);
+   if (!sync_ext || !sync_ext->present)
    {
-      free(sync_reply);
-      m_sync_pending = false;
-      return true;
+      WSI_LOG_WARNING("XSync extension not available, tracking SHM segments with round trips");
+      return false;
    }
-   else if (error)
+
+   xcb_sync_initialize_reply_t *reply = xcb_sync_initialize_reply(
+      m_connection, xcb_sync_initialize(m_connection, XCB_SYNC_MAJOR_VERSION, XCB_SYNC_MINOR_VERSION), nullptr);
+   if (reply == nullptr)
    {
-      free(error);
-      m_sync_pending = false;
+      WSI_LOG_WARNING("Failed to initialize XSync, tracking SHM segments with round trips");
       return false;
    }
-
-   return false;
+   free(reply);
+   return true;
 }
 
-void shm_presenter::ensure_sync_completion()
+VkResult shm_presenter::create_segment(shm_segment &segment, size_t size)
 {
-   if (!m_sync_pending)
+   segment.shm_id = shmget(IPC_PRIVATE, size, IPC_CREAT | SHM_PERMISSIONS);
+   if (segment.shm_id < 0)
    {
-      return;
+      WSI_LOG_ERROR("Failed to create shared memory segment of size %zu", size);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
-   xcb_generic_error_t *error = nullptr;
-   xcb_get_geometry_reply_t *sync_reply = xcb_get_geometry_reply(m_connection, m_pending_sync_cookie, &error);
-
-   if (sync_reply)
+   segment.addr = shmat(segment.shm_id, nullptr, 0);
+   if (segment.addr == (void *)-1)
    {
-      free(sync_reply);
-   }
-   else if (error)
-   {
-      free(error);
+      WSI_LOG_ERROR("Failed to attach shared memory segment");
+      shmctl(segment.shm_id, IPC_RMID, nullptr);
+      segment.shm_id = -1;
+      segment.addr = nullptr;
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
 
-   m_sync_pending = false;
-}
+   segment.size = size;
+   segment.seg = xcb_generate_id(m_connection);
+   xcb_shm_attach(m_connection, segment.seg, segment.shm_id, 0);
 
-bool shm_presenter::init_fence_sync()
-{
    if (m_fence_available)
    {
-      return true;
+      segment.fence = xcb_generate_id(m_connection);
+      xcb_sync_create_fence(m_connection, m_window, segment.fence, 0);
    }
+   return VK_SUCCESS;
+}
 
-   const xcb_query_extension_reply_t *sync_ext = xcb_get_extension_data(m_connection, &xcb_sync_id);
-   if (!sync_ext || !sync_ext->present)
+void shm_presenter::destroy_segment(shm_segment &segment)
+{
+   /* Collect the outstanding reply, and make sure the server no longer reads the segment. */
+   wait_for_segment(segment);
+
+   if (segment.fence != XCB_NONE)
    {
-      WSI_LOG_WARNING("XSync extension not available, falling back to geometry-based sync");
-      return false;
+      xcb_sync_destroy_fence(m_connection, segment.fence);
+      segment.fence = XCB_NONE;
    }
 
-   m_presentation_fence = xcb_generate_id(m_connection);
-   xcb_void_cookie_t fence_cookie = xcb_sync_create_fence_checked(m_connection, m_window, m_presentation_fence, 0);
-
-   xcb_generic_error_t *fence_error = xcb_request_check(m_connection, fence_cookie);
-   if (fence_error)
+   if (segment.seg != XCB_NONE)
    {
-      WSI_LOG_WARNING("Failed to create XSync fence: error %d, falling back to geometry-based sync",
-                      fence_error->error_code);
-      free(fence_error);
-      if (m_presentation_fence != XCB_NONE)
+      xcb_generic_error_t *error = xcb_request_check(m_connection, xcb_shm_detach_checked(m_connection, segment.seg));
+      if (error)
       {
-         m_presentation_fence = XCB_NONE;
+         WSI_LOG_ERROR("SHM detach failed: error_code=%d, sequence=%d", error->error_code, error->sequence);
+         free(error);
       }
-      return false;
+      segment.seg = XCB_NONE;
    }
 
-   int fence_flush_result = xcb_flush(m_connection);
-   if (fence_flush_result <= 0)
+   if (segment.addr != nullptr)
    {
-      WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", fence_flush_result);
+      if (shmdt(segment.addr) != 0)
+      {
+         WSI_LOG_ERROR("Failed to detach shared memory: errno=%d", errno);
+      }
+      segment.addr = nullptr;
    }
+   segment.shm_id = -1;
+   segment.size = 0;
+}
 
-   xcb_get_input_focus_cookie_t sync_cookie = xcb_get_input_focus(m_connection);
-   xcb_get_input_focus_reply_t *sync_reply = xcb_get_input_focus_reply(m_connection, sync_cookie, nullptr);
-
-   if (sync_reply)
+bool shm_presenter::ensure_segment_size(shm_segment &segment, size_t size, size_t fallback_size)
+{
+   if (segment.size >= size)
    {
-      free(sync_reply);
-      m_fence_available = true;
       return true;
    }
-   else
+
+   destroy_segment(segment);
+   const bool grown = create_segment(segment, size) == VK_SUCCESS;
+   if (!grown)
    {
-      WSI_LOG_WARNING("Failed to synchronize XSync fence setup, falling back to geometry-based sync");
-      if (m_presentation_fence != XCB_NONE)
+      WSI_LOG_WARNING("SHM presenter: cannot grow a segment to %zu bytes, presenting unscaled", size);
+      m_scale_mode = shm_scale_mode::off;
+      if (create_segment(segment, fallback_size) != VK_SUCCESS)
       {
-         xcb_sync_destroy_fence(m_connection, m_presentation_fence);
-         m_presentation_fence = XCB_NONE;
+         return false;
       }
-      return false;
    }
-}
 
-void shm_presenter::cleanup_fence_sync()
-{
-   if (m_presentation_fence != XCB_NONE)
-   {
-      xcb_sync_destroy_fence(m_connection, m_presentation_fence);
-      m_presentation_fence = XCB_NONE;
-   }
-   m_fence_available = false;
+   /* Let the server attach before the id goes away, as create_image_resources does. */
+   free(xcb_get_input_focus_reply(m_connection, xcb_get_input_focus(m_connection), nullptr));
+   shmctl(segment.shm_id, IPC_RMID, nullptr);
+   return grown;
 }
 
-void shm_presenter::wait_for_presentation_fence()
+void shm_presenter::update_window_size()
 {
-   if (!m_fence_available || m_presentation_fence == XCB_NONE)
+   /* The surface keeps the size current from ConfigureNotify events, so this makes no round trip. */
+   uint32_t window_width = 0;
+   uint32_t window_height = 0;
+   int depth = 0;
+   if (m_wsi_surface != nullptr && m_wsi_surface->get_size_and_depth(&window_width, &window_height, &depth))
    {
-      return;
+      m_window_width.store(window_width, std::memory_order_relaxed);
+      m_window_height.store(window_height, std::memory_order_relaxed);
    }
+}
 
-   xcb_sync_await_fence(m_connection, 1, &m_presentation_fence);
-   int flush_result = xcb_flush(m_connection);
-   if (flush_result <= 0)
+void shm_presenter::mark_segment_in_flight(shm_segment &segment)
+{
+   /* The server handles requests in order, so the reply to either query is only sent once the put before it
+    * has finished reading the segment. The reply is collected when the segment comes round again. */
+   if (segment.fence != XCB_NONE)
    {
-      WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", flush_result);
+      xcb_sync_trigger_fence(m_connection, segment.fence);
+      segment.fence_query = xcb_sync_query_fence(m_connection, segment.fence);
    }
-   xcb_sync_reset_fence(m_connection, m_presentation_fence);
-   int flush_result2 = xcb_flush(m_connection);
-   if (flush_result2 <= 0)
+   else
    {
-      WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", flush_result2);
+      segment.focus_query = xcb_get_input_focus(m_connection);
    }
+   segment.in_flight = true;
 }
 
-void shm_presenter::trigger_presentation_fence()
+uint64_t shm_presenter::wait_for_segment(shm_segment &segment)
 {
-   if (!m_fence_available || m_presentation_fence == XCB_NONE)
+   if (!segment.in_flight)
    {
-      return;
+      return 0;
    }
 
-   xcb_sync_trigger_fence(m_connection, m_presentation_fence);
-   int trigger_flush_result = xcb_flush(m_connection);
-   if (trigger_flush_result <= 0)
+   const auto start = std::chrono::steady_clock::now();
+   if (segment.fence != XCB_NONE)
+   {
+      xcb_sync_query_fence_reply_t *reply =
+         xcb_sync_query_fence_reply(m_connection, segment.fence_query, nullptr);
+      const bool triggered = reply != nullptr && reply->triggered;
+      free(reply);
+      if (triggered)
+      {
+         xcb_sync_reset_fence(m_connection, segment.fence);
+      }
+   }
+   else
    {
-      WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", trigger_flush_result);
+      free(xcb_get_input_focus_reply(m_connection, segment.focus_query, nullptr));
    }
+   segment.in_flight = false;
+
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
 }
 
 void shm_presenter::cache_x11_formats()
@@ -542,6 +1161,7 @@ void shm_presenter::cache_x11_formats()
    {
       xcb_format_t *format = format_iter.data;
       m_depth_to_bpp_cache[format->depth] = format->bits_per_pixel;
+      m_depth_to_scanline_pad_cache[format->depth] = format->scanline_pad;
    }
 }
 
@@ -556,13 +1176,48 @@ uint8_t shm_presenter::get_bits_per_pixel_for_depth(int depth)
    return (depth == 24) ? 32 : depth;
 }
 
-VkResult shm_presenter::init(xcb_connection_t *connection, xcb_window_t window, surface *wsi_surface)
+uint8_t shm_presenter::get_scanline_pad_for_depth(int depth)
+{
+   auto it = m_depth_to_scanline_pad_cache.find(depth);
+   if (it != m_depth_to_scanline_pad_cache.end())
+   {
+      return it->second;
+   }
+
+   return 32;
+}
+
+VkResult shm_presenter::init(xcb_connection_t *connection, xcb_window_t window, surface *wsi_surface,
+                             VkPresentModeKHR present_mode, uint64_t metrics_key, frame_timing *timing)
 {
    m_connection = connection;
    m_window = window;
    m_wsi_surface = wsi_surface;
+   m_metrics_key = metrics_key;
+   m_frame_timing = timing;
+   m_segment_count = std::min(std::max(read_shm_copy_env("WSI_SHM_SEGMENTS", 2), 1u), MAX_SHM_SEGMENTS);
 
    detect_refresh_rate();
+   init_pacing(present_mode);
+   m_damage_tiles = read_shm_copy_env("WSI_SHM_DAMAGE_TILES", 0) != 0;
+   m_copy_stats_enabled = read_shm_copy_env("WSI_SHM_COPY_STATS", 0) != 0;
+
+   const char *kernel_env = std::getenv("WSI_SHM_COPY_KERNEL");
+   if (kernel_env != nullptr && kernel_env[0] != '\0')
+   {
+      if (std::strcmp(kernel_env, "simd") == 0)
+      {
+         m_copy_kernel = shm_copy_kernel::simd;
+      }
+      else if (std::strcmp(kernel_env, "scalar") == 0)
+      {
+         m_copy_kernel = shm_copy_kernel::scalar;
+      }
+      else if (std::strcmp(kernel_env, "auto") != 0)
+      {
+         WSI_LOG_WARNING("SHM presenter: invalid WSI_SHM_COPY_KERNEL='%s', using auto.", kernel_env);
+      }
+   }
 
    cache_x11_formats();
 
@@ -573,62 +1228,128 @@ VkResult shm_presenter::init(xcb_connection_t *connection, xcb_window_t window,
       return result;
    }
 
-   init_fence_sync();
+   m_fence_available = init_fence_sync();
+
+   const char *scale_env = std::getenv("WSI_SHM_SCALE");
+   if (scale_env != nullptr && scale_env[0] != '\0')
+   {
+      if (std::strcmp(scale_env, "off") == 0 || std::strcmp(scale_env, "0") == 0)
+      {
+         m_scale_mode = shm_scale_mode::off;
+      }
+      else if (std::strcmp(scale_env, "bilinear") == 0)
+      {
+         m_scale_mode = shm_scale_mode::bilinear;
+      }
+      else if (std::strcmp(scale_env, "area") == 0)
+      {
+         m_scale_mode = shm_scale_mode::area;
+      }
+      else if (std::strcmp(scale_env, "auto") != 0)
+      {
+         WSI_LOG_WARNING("SHM presenter: invalid WSI_SHM_SCALE='%s', using auto.", scale_env);
+      }
+   }
+   if (m_scale_mode != shm_scale_mode::off)
+   {
+      uint32_t window_width = 0;
+      uint32_t window_height = 0;
+      int depth = 0;
+      if (wsi_surface->get_size_and_depth(&window_width, &window_height, &depth))
+      {
+         m_window_width.store(window_width, std::memory_order_relaxed);
+         m_window_height.store(window_height, std::memory_order_relaxed);
+      }
+   }
+
+   if (frame_overlay::is_enabled())
+   {
+      m_overlay = std::make_unique<frame_overlay>("SHM");
+   }
+
+   /* The MAILBOX thread already keeps copies and puts off the application's thread. Copying the next frame
+    * while this one is paced would only make it older by the time it is put. */
+   m_pipelined = present_mode != VK_PRESENT_MODE_MAILBOX_KHR && read_shm_copy_env("WSI_SHM_PIPELINE", 1) != 0;
+   if (m_pipelined)
+   {
+      start_put_thread();
+   }
 
    return VK_SUCCESS;
 }
 
-VkResult shm_presenter::create_image_resources(x11_image_data *image_data, uint32_t width, uint32_t height, int depth)
+VkResult shm_presenter::create_image_resources(x11_image_data *image_data, uint32_t width, uint32_t height, int depth,
+                                               bool defer_segments)
 {
    image_data->width = width;
    image_data->height = height;
    image_data->depth = depth;
 
-   uint8_t bits_per_pixel = (depth == 24) ? 32 : depth;
-   image_data->stride = width * (bits_per_pixel / 8);
-
-   size_t shm_size = image_data->stride * height;
-   image_data->shm_size = shm_size;
+   const uint8_t bits_per_pixel = get_bits_per_pixel_for_depth(depth);
+   const uint32_t scanline_pad = std::max<uint32_t>(get_scanline_pad_for_depth(depth), 8);
+   const uint64_t row_bits = static_cast<uint64_t>(width) * bits_per_pixel;
+   image_data->stride = static_cast<uint32_t>(((row_bits + scanline_pad - 1) / scanline_pad) * scanline_pad / 8);
 
-   image_data->shm_id = shmget(IPC_PRIVATE, shm_size, IPC_CREAT | SHM_PERMISSIONS);
-   if (image_data->shm_id < 0)
+   if (!m_pixel_conversion_selected)
    {
-      WSI_LOG_ERROR("Failed to create shared memory segment of size %zu", shm_size);
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
-   }
+      /* Every image of the swapchain targets the same window, so the conversion is picked once. */
+      m_pixel_conversion_selected = true;
+      if (bits_per_pixel == 32 && (depth <= 24 || depth == 32))
+      {
+         m_pixel_conversion = shm_pixel_conversion::none;
+      }
+      else if (bits_per_pixel == 32 && depth == 30)
+      {
+         m_pixel_conversion = shm_pixel_conversion::x2r10g10b10;
+      }
+      else if (bits_per_pixel == 24 && depth == 24)
+      {
+         m_pixel_conversion = shm_pixel_conversion::rgb888;
+      }
+      else if (bits_per_pixel == 16 && depth == 16)
+      {
+         m_pixel_conversion = shm_pixel_conversion::rgb565;
+      }
+      else
+      {
+         m_pixel_conversion = shm_pixel_conversion::unsupported;
+         WSI_LOG_WARNING("SHM presenter: no pixel conversion for depth %d at %u bits per pixel", depth,
+                         bits_per_pixel);
+      }
 
-   image_data->shm_addr = shmat(image_data->shm_id, nullptr, 0);
-   if (image_data->shm_addr == (void *)-1)
-   {
-      WSI_LOG_ERROR("Failed to attach shared memory segment");
-      shmctl(image_data->shm_id, IPC_RMID, nullptr);
-      image_data->shm_id = -1;
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      if (m_pixel_conversion != shm_pixel_conversion::none &&
+          m_pixel_conversion != shm_pixel_conversion::unsupported)
+      {
+         WSI_LOG_INFO("SHM presenter: converting pixels for depth %d, %u bits per pixel", depth, bits_per_pixel);
+      }
    }
 
-   image_data->shm_seg = xcb_generate_id(m_connection);
-   xcb_shm_attach(m_connection, image_data->shm_seg, image_data->shm_id, 0);
-
-   image_data->shm_id_alt = shmget(IPC_PRIVATE, shm_size, IPC_CREAT | SHM_PERMISSIONS);
-   if (image_data->shm_id_alt < 0)
+   image_data->shm_size = image_data->stride * height;
+   image_data->shm_segment_count = 0;
+   image_data->shm_active_segment = 0;
+   image_data->shm_segments_deferred = defer_segments;
+   if (defer_segments)
    {
-      WSI_LOG_ERROR("Failed to create alternate shared memory segment");
+      return VK_SUCCESS;
    }
-   else
+   return create_image_segments(image_data);
+}
+
+VkResult shm_presenter::create_image_segments(x11_image_data *image_data)
+{
+   for (uint32_t i = 0; i < m_segment_count; i++)
    {
-      image_data->shm_addr_alt = shmat(image_data->shm_id_alt, nullptr, 0);
-      if (image_data->shm_addr_alt == (void *)-1)
-      {
-         WSI_LOG_ERROR("Failed to attach alternate shared memory segment");
-         shmctl(image_data->shm_id_alt, IPC_RMID, nullptr);
-         image_data->shm_id_alt = -1;
-         image_data->shm_addr_alt = nullptr;
-      }
-      else
+      VkResult result = create_segment(image_data->shm_segments[i], image_data->shm_size);
+      if (result != VK_SUCCESS)
       {
-         image_data->shm_seg_alt = xcb_generate_id(m_connection);
-         xcb_shm_attach(m_connection, image_data->shm_seg_alt, image_data->shm_id_alt, 0);
+         if (i == 0)
+         {
+            return result;
+         }
+         WSI_LOG_WARNING("SHM presenter: using %u of %u segments per image", i, m_segment_count);
+         break;
       }
+      image_data->shm_segment_count++;
    }
 
    int create_resources_flush_result = xcb_flush(m_connection);
@@ -644,10 +1365,10 @@ VkResult shm_presenter::create_image_resources(x11_image_data *image_data, uint3
       free(sync_reply);
    }
 
-   shmctl(image_data->shm_id, IPC_RMID, nullptr);
-   if (image_data->shm_id_alt >= 0)
+   /* The segments stay alive while attached; removing the ids now means they cannot leak. */
+   for (uint32_t i = 0; i < image_data->shm_segment_count; i++)
    {
-      shmctl(image_data->shm_id_alt, IPC_RMID, nullptr);
+      shmctl(image_data->shm_segments[i].shm_id, IPC_RMID, nullptr);
    }
 
    return VK_SUCCESS;
@@ -656,45 +1377,128 @@ VkResult shm_presenter::create_image_resources(x11_image_data *image_data, uint3
 
 
 
-VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*serial*/)
+VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t serial, const present_damage &damage,
+                                      uint64_t frame_id, uint64_t present_id, uint64_t target_ns,
+                                      VkPresentModeKHR present_mode, uint64_t queued_ns)
 {
+   MALI_TRACE_SCOPE(SHM_PRESENT, image_data->shm_size);
+
+   if (image_data->shm_segments_deferred)
+   {
+      image_data->shm_segments_deferred = false;
+      const VkResult result = create_image_segments(image_data);
+      if (result != VK_SUCCESS)
+      {
+         WSI_LOG_ERROR("SHM presenter: failed to create the segments of an image on its first present.");
+         return result;
+      }
+   }
+   if (image_data->shm_segment_count == 0)
+   {
+      return VK_ERROR_UNKNOWN;
+   }
+
+   /* With imported segments the present payload already chose, and wrote, the segment to put. The next
+    * payload may write its successor as soon as the image is released, so those puts are never queued. Nor are
+    * MAILBOX frames after a switch from FIFO, which queueing would only make older. */
+   const bool gpu_wrote_segment = image_data->shm_gpu_writes_segments();
+   const bool queue_put = m_pipelined && !gpu_wrote_segment && present_mode != VK_PRESENT_MODE_MAILBOX_KHR;
+   if (!gpu_wrote_segment)
+   {
+      image_data->shm_active_segment = (image_data->shm_active_segment + 1) % image_data->shm_segment_count;
+   }
+   shm_segment &segment = image_data->shm_segments[image_data->shm_active_segment];
+
+   const auto wait_start = std::chrono::steady_clock::now();
+   if (queue_put)
+   {
+      std::unique_lock<std::mutex> lock(m_put_mutex);
+      m_put_cond.wait(lock,
+                      [this, &segment]() { return m_put_queue.size() < MAX_QUEUED_PUTS && !segment.put_queued; });
+   }
+   else
+   {
+      wait_for_put_thread_idle();
+   }
+   uint64_t wait_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_start).count());
 
-   if (m_fence_available && !m_first_frame)
+   /* Only the put from this segment, a full ring ago, has to be finished; later puts keep running. */
+   wait_ns += wait_for_segment(segment);
+   if (m_metrics_key != 0)
    {
-      wait_for_presentation_fence();
+      mali_wrapper::MetricsPage::Instance().RecordPresentWait(m_metrics_key, wait_ns);
    }
-   else if (!m_fence_available)
+
+   /* The present payload may already have shrunk the frame to the window on the GPU. */
+   const bool prescaled = image_data->readback_ptr != nullptr && image_data->readback_width != 0 &&
+                          (image_data->readback_width != image_data->width ||
+                           image_data->readback_height != image_data->height);
+   const uint32_t frame_width = prescaled ? image_data->readback_width : image_data->width;
+   const uint32_t frame_height = prescaled ? image_data->readback_height : image_data->height;
+
+   /* Stretch the frame over the window when its size no longer matches. */
+   uint32_t put_width = frame_width;
+   uint32_t put_height = frame_height;
+   bool scaled = false;
+   if (!gpu_wrote_segment && m_scale_mode != shm_scale_mode::off && m_pixel_conversion == shm_pixel_conversion::none)
    {
-      if (m_sync_pending)
+      update_window_size();
+      const uint32_t window_width = m_window_width.load(std::memory_order_relaxed);
+      const uint32_t window_height = m_window_height.load(std::memory_order_relaxed);
+      if (window_width != 0 && window_height != 0 && (window_width != frame_width || window_height != frame_height))
       {
-         ensure_sync_completion();
+         scaled = ensure_segment_size(segment, static_cast<size_t>(window_width) * window_height * 4,
+                                      image_data->shm_size);
+         if (scaled)
+         {
+            put_width = window_width;
+            put_height = window_height;
+         }
       }
    }
-   m_first_frame = false;
+   /* Damage comes in swapchain coordinates, which only match frames put at the image's own size. */
+   const bool reshaped = put_width != image_data->width || put_height != image_data->height;
 
-   int present_flush_result = xcb_flush(m_connection);
-   if (present_flush_result <= 0)
+   /* The overlay changes every frame, so a visible one needs full copies and puts. */
+   bool overlay_visible = false;
+   if (m_overlay)
    {
-      WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", present_flush_result);
+      m_overlay->record_present(monotonic_ns());
+      overlay_visible = frame_overlay::is_visible();
    }
 
-   image_data->use_alt_buffer = !image_data->use_alt_buffer;
-   xcb_shm_seg_t active_seg =
-      image_data->use_alt_buffer && image_data->shm_seg_alt != XCB_NONE ? image_data->shm_seg_alt : image_data->shm_seg;
-   void *active_addr = image_data->use_alt_buffer && image_data->shm_addr_alt != nullptr ? image_data->shm_addr_alt :
-                                                                                           image_data->shm_addr;
+   void *active_addr = segment.addr;
 
-   if (active_addr && image_data->shm_size > 0)
+   bool put_damage = false;
+   if (gpu_wrote_segment)
+   {
+      /* Nothing to copy. */
+      put_damage = select_damage(damage, nullptr, 0, image_data->width, image_data->height);
+   }
+   else if (active_addr && image_data->shm_size > 0)
    {
       if (image_data->external_mem.is_host_visible())
       {
          void *mapped_memory = nullptr;
-         if (image_data->external_mem.map_host_memory(&mapped_memory) == VK_SUCCESS && mapped_memory != nullptr)
+         size_t source_stride = 0;
+         size_t source_offset = 0;
+         if (image_data->readback_ptr != nullptr)
+         {
+            /* The present payload already copied the image into cached, tightly packed memory. */
+            mapped_memory = image_data->readback_ptr;
+            source_stride = static_cast<size_t>(frame_width) * 4;
+         }
+         else if (image_data->external_mem.map_host_memory(&mapped_memory) == VK_SUCCESS)
          {
             const auto &vulkan_layout = image_data->external_mem.get_host_layout();
-            size_t source_stride = vulkan_layout.rowPitch;
+            source_stride = vulkan_layout.rowPitch;
+            source_offset = vulkan_layout.offset;
+         }
+
+         if (mapped_memory != nullptr)
+         {
             size_t dest_stride = image_data->stride;
-            size_t source_offset = vulkan_layout.offset;
 
             size_t bytes_per_pixel = dest_stride / image_data->width;
             size_t gpu_pixels_per_row = image_data->width;
@@ -702,6 +1506,10 @@ VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*ser
 
             char *src_base = (char *)mapped_memory + source_offset;
 
+            const uint64_t copy_start_ns = m_copy_stats_enabled ? monotonic_ns() : 0;
+            shm_copy_path copy_path = shm_copy_path::fallback;
+            uint64_t copy_bytes = static_cast<uint64_t>(dest_stride) * image_data->height;
+
             if (gpu_pixels_per_row != display_pixels_per_row)
             {
                precompute_scaling_lut(gpu_pixels_per_row, display_pixels_per_row);
@@ -713,14 +1521,77 @@ VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*ser
 
             char *dst_base = (char *)active_addr;
 
-            if (bytes_per_pixel == 4)
+            if (scaled)
+            {
+               shm_scale_filter filter = shm_scale_filter::bilinear;
+               if (m_scale_mode == shm_scale_mode::area ||
+                   (m_scale_mode == shm_scale_mode::automatic && put_width < frame_width &&
+                    put_height < frame_height))
+               {
+                  filter = shm_scale_filter::area;
+               }
+               m_scaler.configure(frame_width, frame_height, put_width, put_height, filter);
+
+               const size_t scaled_stride = static_cast<size_t>(put_width) * 4;
+               shm_copy_pool::instance().run(put_height, [&](uint32_t first_row, uint32_t row_count) {
+                  m_scaler.scale_rows(src_base, source_stride, dst_base, scaled_stride, first_row, row_count);
+               });
+               copy_path = shm_copy_path::scale;
+               copy_bytes = static_cast<uint64_t>(scaled_stride) * put_height;
+               if (overlay_visible)
+               {
+                  m_overlay->set_path("SHM SCALED");
+                  m_overlay->draw(dst_base, scaled_stride, put_width, put_height, true);
+               }
+            }
+            else if (prescaled)
+            {
+               copy_path = copy_pixels_optimized(reinterpret_cast<const uint32_t *>(src_base),
+                                                 reinterpret_cast<uint32_t *>(dst_base), frame_width, frame_width,
+                                                 frame_height);
+               copy_bytes = static_cast<uint64_t>(frame_width) * frame_height * 4;
+               if (overlay_visible)
+               {
+                  m_overlay->set_path("SHM GPU READBACK");
+                  m_overlay->draw(dst_base, static_cast<size_t>(frame_width) * 4, frame_width, frame_height, true);
+               }
+            }
+            else if (m_pixel_conversion != shm_pixel_conversion::none &&
+                     m_pixel_conversion != shm_pixel_conversion::unsupported)
+            {
+               put_damage = select_damage(damage, src_base, source_stride, image_data->width, image_data->height);
+               convert_pixels(src_base, source_stride, dst_base, dest_stride, image_data->width, image_data->height,
+                              put_damage);
+               copy_path = shm_copy_path::convert;
+               if (put_damage)
+               {
+                  copy_bytes = damage_bytes(dest_stride / image_data->width);
+               }
+            }
+            else if (bytes_per_pixel == 4)
             {
                uint32_t *src_pixels = (uint32_t *)src_base;
                uint32_t *dst_pixels = (uint32_t *)dst_base;
                uint32_t src_stride_pixels = source_stride / bytes_per_pixel;
 
-               copy_pixels_optimized(src_pixels, dst_pixels, src_stride_pixels, display_pixels_per_row,
-                                     image_data->height);
+               put_damage = !overlay_visible && m_scaling_lut.empty() &&
+                            select_damage(damage, src_base, source_stride, image_data->width, image_data->height);
+               if (put_damage)
+               {
+                  copy_damage_rects(src_base, source_stride, dst_base, dest_stride);
+                  copy_path = shm_copy_path::damage;
+                  copy_bytes = damage_bytes(bytes_per_pixel);
+               }
+               else
+               {
+                  copy_path = copy_pixels_optimized(src_pixels, dst_pixels, src_stride_pixels,
+                                                    display_pixels_per_row, image_data->height);
+               }
+               if (overlay_visible)
+               {
+                  m_overlay->set_path("SHM");
+                  m_overlay->draw(dst_base, dest_stride, image_data->width, image_data->height, true);
+               }
             }
             else
             {
@@ -732,6 +1603,11 @@ VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*ser
                   std::memcpy(dst_row, src_row, copy_size);
                }
             }
+
+            if (m_copy_stats_enabled)
+            {
+               record_copy(copy_path, copy_bytes, copy_start_ns);
+            }
          }
          else
          {
@@ -749,38 +1625,112 @@ VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*ser
       return VK_ERROR_UNKNOWN;
    }
 
-   xcb_shm_put_image(m_connection, m_window, m_gc, image_data->width, image_data->height, 0, 0, image_data->width,
-                     image_data->height, 0, 0, image_data->depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, active_seg, 0);
+   put_job job{
+      image_data, &segment, serial, frame_id, present_id, target_ns, queued_ns, put_damage, put_width, put_height, {}
+   };
+   if (put_damage)
+   {
+      job.rects = m_damage_rects;
+   }
+   else if (reshaped)
+   {
+      m_window_complete = false;
+   }
+   else
+   {
+      m_window_complete = true;
+      m_damage_width = image_data->width;
+      m_damage_height = image_data->height;
+   }
 
-   auto current_time = std::chrono::steady_clock::now();
-   auto time_since_last = std::chrono::duration_cast<std::chrono::microseconds>(current_time - m_last_frame_time);
+   if (!queue_put)
+   {
+      put_segment(job);
+      return VK_SUCCESS;
+   }
 
-   if (m_last_frame_time.time_since_epoch().count() > 0 && time_since_last < m_frame_interval)
    {
-      auto sleep_time = m_frame_interval - time_since_last;
+      std::lock_guard<std::mutex> lock(m_put_mutex);
+      segment.put_queued = true;
+      m_put_queue.push_back(std::move(job));
+   }
+   m_put_cond.notify_all();
 
-      if (sleep_time > std::chrono::microseconds(500))
+   return VK_SUCCESS;
+}
+
+void shm_presenter::put_segment(const put_job &job)
+{
+   MALI_TRACE_SCOPE(SHM_PUT, job.partial ? job.rects.size() : 1);
+
+   const auto pacing_start = std::chrono::steady_clock::now();
+   wait_for_target_time(job);
+
+   const uint8_t depth = static_cast<uint8_t>(job.image_data->depth);
+   if (job.partial)
+   {
+      for (const auto &rect : job.rects)
       {
-         auto conservative_sleep = sleep_time - std::chrono::microseconds(200);
-         std::this_thread::sleep_for(conservative_sleep);
+         xcb_shm_put_image(m_connection, m_window, m_gc, job.width, job.height, rect.x, rect.y, rect.width,
+                           rect.height, rect.x, rect.y, depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, job.segment->seg, 0);
       }
+   }
+   else
+   {
+      xcb_shm_put_image(m_connection, m_window, m_gc, job.width, job.height, 0, 0, job.width, job.height, 0, 0,
+                        depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, job.segment->seg, 0);
+   }
 
-      auto target_time = m_last_frame_time + m_frame_interval;
-      while (std::chrono::steady_clock::now() < target_time)
+   mark_segment_in_flight(*job.segment);
+
+   const bool report = m_presented_callback && job.present_id != 0;
+   uint64_t fence_ns = 0;
+   if (report && m_pacing != shm_pacing::vblank)
+   {
+      /* The reply only comes once the server has copied the frame into the window. */
+      wait_for_segment(*job.segment);
+      fence_ns = monotonic_ns();
+   }
+
+   bool at_vblank = false;
+   if (m_pacing == shm_pacing::vblank)
+   {
+      at_vblank = pace_with_vblank(job.serial);
+      if (!at_vblank)
       {
-         std::this_thread::sleep_for(std::chrono::microseconds(10));
+         WSI_LOG_WARNING("SHM presenter: lost Present MSC events, pacing with the refresh timer.");
+         cleanup_pacing();
+         m_pacing = shm_pacing::timer;
       }
-      current_time = std::chrono::steady_clock::now();
    }
-   m_last_frame_time = current_time;
-
-   if (m_fence_available)
+   if (m_pacing == shm_pacing::timer)
    {
-      trigger_presentation_fence();
+      pace_with_timer();
    }
-   else
+   if (report)
+   {
+      if (at_vblank)
+      {
+         m_presented_callback(job.present_id, m_last_ust_ns, m_last_msc);
+      }
+      else
+      {
+         m_presented_callback(job.present_id, fence_ns, 0);
+      }
+   }
+   /* Without vblank pacing the display time is only known when the fence was waited for above. */
+   const uint64_t display_ns = at_vblank ? m_last_ust_ns : fence_ns;
+   if (m_metrics_key != 0 && job.queued_ns != 0 && display_ns > job.queued_ns)
    {
-      start_async_sync();
+      mali_wrapper::MetricsPage::Instance().RecordDisplayLatency(m_metrics_key, display_ns - job.queued_ns);
+   }
+   if (m_frame_timing != nullptr && (m_pacing != shm_pacing::unpaced || job.target_ns != 0))
+   {
+      m_frame_timing->record(frame_stage::pacing_sleep,
+                             static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                      std::chrono::steady_clock::now() - pacing_start)
+                                                      .count()),
+                             job.frame_id);
    }
 
    int final_flush_result = xcb_flush(m_connection);
@@ -788,63 +1738,101 @@ VkResult shm_presenter::present_image(x11_image_data *image_data, uint32_t /*ser
    {
       WSI_LOG_ERROR("SHM presenter xcb_flush failed: result=%d", final_flush_result);
    }
+}
 
-   return VK_SUCCESS;
+void shm_presenter::start_put_thread()
+{
+   try
+   {
+      m_put_thread = std::thread(&shm_presenter::put_thread_main, this);
+   }
+   catch (const std::system_error &e)
+   {
+      WSI_LOG_WARNING("SHM presenter: failed to start put thread, putting on the presenting thread: %s", e.what());
+      m_pipelined = false;
+   }
 }
-void shm_presenter::destroy_image_resources(x11_image_data *image_data)
+
+void shm_presenter::stop_put_thread()
 {
-   if (image_data->shm_seg != XCB_NONE)
+   if (!m_put_thread.joinable())
    {
-      xcb_generic_error_t *error = xcb_request_check(m_connection, 
-          xcb_shm_detach_checked(m_connection, image_data->shm_seg));
-      if (error)
-      {
-         WSI_LOG_ERROR("SHM detach failed: error_code=%d, sequence=%d", 
-                      error->error_code, error->sequence);
-         free(error);
-      }
-      
-      image_data->shm_seg = XCB_NONE;
+      return;
    }
 
-   if (image_data->shm_seg_alt != XCB_NONE)
    {
-      xcb_generic_error_t *error = xcb_request_check(m_connection, 
-          xcb_shm_detach_checked(m_connection, image_data->shm_seg_alt));
-      if (error)
-      {
-         WSI_LOG_ERROR("SHM alt detach failed: error_code=%d, sequence=%d", 
-                      error->error_code, error->sequence);
-         free(error);
-      }
-      
-      image_data->shm_seg_alt = XCB_NONE;
+      std::lock_guard<std::mutex> lock(m_put_mutex);
+      m_put_stopping = true;
    }
+   m_put_cond.notify_all();
+   m_put_thread.join();
+}
+
+void shm_presenter::put_thread_main()
+{
+   block_async_signals();
+   mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::WORKER, "SHM put");
 
-   if (image_data->shm_addr && image_data->shm_addr != (void *)-1)
+   std::unique_lock<std::mutex> lock(m_put_mutex);
+   for (;;)
    {
-      int detach_result = shmdt(image_data->shm_addr);
-      if (detach_result != 0)
+      m_put_cond.wait(lock, [this]() { return m_put_stopping || !m_put_queue.empty(); });
+      if (m_put_queue.empty())
       {
-         WSI_LOG_ERROR("Failed to detach shared memory: errno=%d", errno);
+         /* Stopping, and every copied frame has been put. */
+         return;
       }
-      image_data->shm_addr = nullptr;
+
+      put_job job = std::move(m_put_queue.front());
+      m_put_queue.pop_front();
+      m_put_busy = true;
+
+      lock.unlock();
+      put_segment(job);
+      lock.lock();
+
+      job.segment->put_queued = false;
+      m_put_busy = false;
+      m_put_cond.notify_all();
    }
+}
 
-   if (image_data->shm_addr_alt && image_data->shm_addr_alt != (void *)-1)
+void shm_presenter::wait_for_put_thread_idle()
+{
+   if (!m_put_thread.joinable())
    {
-      int detach_result = shmdt(image_data->shm_addr_alt);
-      if (detach_result != 0)
-      {
-         WSI_LOG_ERROR("Failed to detach alternate shared memory: errno=%d", errno);
-      }
-      image_data->shm_addr_alt = nullptr;
+      return;
    }
 
-   image_data->shm_id = -1;
-   image_data->shm_id_alt = -1;
+   std::unique_lock<std::mutex> lock(m_put_mutex);
+   m_put_cond.wait(lock, [this]() { return m_put_queue.empty() && !m_put_busy; });
+}
+
+void shm_presenter::destroy_image_resources(x11_image_data *image_data)
+{
+   /* Queued puts still read the segments. */
+   wait_for_put_thread_idle();
+
+   for (auto &segment : image_data->shm_segments)
+   {
+      destroy_segment(segment);
+   }
+
+   image_data->shm_segment_count = 0;
+   image_data->shm_active_segment = 0;
    image_data->shm_size = 0;
-   image_data->use_alt_buffer = false;
+}
+
+bool shm_presenter::get_scale_target(uint32_t *width, uint32_t *height) const
+{
+   if (m_scale_mode == shm_scale_mode::off || m_pixel_conversion != shm_pixel_conversion::none)
+   {
+      return false;
+   }
+
+   *width = m_window_width.load(std::memory_order_relaxed);
+   *height = m_window_height.load(std::memory_order_relaxed);
+   return *width != 0 && *height != 0;
 }
 
 bool shm_presenter::is_available(xcb_connection_t * /*connection*/, surface *wsi_surface)
@@ -871,5 +1859,89 @@ VkResult shm_presenter::create_graphics_context()
    return VK_SUCCESS;
 }
 
+#if MALI_WRAPPER_HARNESS
+struct shm_presenter_harness
+{
+   static bool copy_frame(shm_presenter &presenter, mali_wrapper::harness::ShmCopyPath path, const uint32_t *src,
+                          uint32_t src_width, uint32_t src_stride_pixels, uint32_t *dst, uint32_t dst_width,
+                          uint32_t height)
+   {
+      using mali_wrapper::harness::ShmCopyPath;
+
+      if (path == ShmCopyPath::LUT)
+      {
+         presenter.m_copy_kernel = shm_copy_kernel::automatic;
+         presenter.precompute_scaling_lut(src_width, dst_width);
+         presenter.copy_pixels_optimized(src, dst, src_stride_pixels, dst_width, height);
+         return true;
+      }
+      if (src_width != dst_width)
+      {
+         return false;
+      }
+
+      presenter.m_scaling_lut.clear();
+      presenter.m_last_gpu_width = 0;
+      presenter.m_last_display_width = 0;
+      switch (path)
+      {
+      case ShmCopyPath::MEMCPY_BANDS:
+         if (src_stride_pixels != dst_width)
+         {
+            return false;
+         }
+         presenter.m_copy_kernel = shm_copy_kernel::automatic;
+         presenter.copy_pixels_optimized(src, dst, src_stride_pixels, dst_width, height);
+         return true;
+      case ShmCopyPath::THREADED:
+         presenter.m_copy_kernel = shm_copy_kernel::automatic;
+         presenter.copy_pixels_threaded(src, dst, src_stride_pixels, dst_width, height);
+         return true;
+      case ShmCopyPath::SIMD:
+#ifdef ENABLE_ARM_NEON
+         presenter.copy_pixels_simd(src, dst, src_stride_pixels, dst_width, height);
+         return true;
+#else
+         return false;
+#endif
+      case ShmCopyPath::SCALAR:
+         presenter.copy_pixels_scalar(src, dst, src_stride_pixels, dst_width, height);
+         return true;
+      default:
+         return false;
+      }
+   }
+};
+#endif
+
 } /* namespace x11 */
 } /* namespace wsi */
+
+#if MALI_WRAPPER_HARNESS
+namespace mali_wrapper
+{
+namespace harness
+{
+
+bool ShmCopyFrame(ShmCopyPath path, const uint32_t *src, uint32_t src_width, uint32_t src_stride_pixels, uint32_t *dst,
+                  uint32_t dst_width, uint32_t height)
+{
+   if (src == nullptr || dst == nullptr || src_width == 0 || dst_width == 0 || height == 0)
+   {
+      return false;
+   }
+
+   /* Never initialised: only the copy state is used, so it needs no connection. */
+   static wsi::x11::shm_presenter presenter;
+   return wsi::x11::shm_presenter_harness::copy_frame(presenter, path, src, src_width, src_stride_pixels, dst,
+                                                      dst_width, height);
+}
+
+uint32_t ShmCopyThreadCount()
+{
+   return wsi::x11::shm_copy_pool::instance().thread_count();
+}
+
+} /* namespace harness */
+} /* namespace mali_wrapper */
+#endif
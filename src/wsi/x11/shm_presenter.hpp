@@ -38,17 +38,108 @@
 #include <vector>
 #include <cstdint>
 #include <unordered_map>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 #include <xcb/sync.h>
+#include <xcb/present.h>
+
+#include "shm_scaler.hpp"
+#include "wsi/frame_overlay.hpp"
+#include "wsi/frame_timing.hpp"
 
 namespace wsi
 {
+struct present_damage;
+
 namespace x11
 {
 
 class surface;
+struct shm_segment;
 struct x11_image_data;
 
+/**
+ * @brief How the SHM presenter paces frames to the display.
+ */
+enum class shm_pacing
+{
+   /** Present as fast as the application renders. */
+   unpaced,
+   /** Sleep to the refresh interval detected through RandR. */
+   timer,
+   /** Wait for the next vblank reported by Present MSC notifications. */
+   vblank,
+};
+
+/**
+ * @brief Whether, and with which filter, the SHM presenter scales frames to a window of a different size.
+ */
+enum class shm_scale_mode
+{
+   off,
+   /** Area when the window is smaller in both dimensions, bilinear otherwise. */
+   automatic,
+   bilinear,
+   area,
+};
+
+/**
+ * @brief How the SHM presenter writes the swapchain's B8G8R8A8 pixels into the window's pixmap format.
+ */
+enum class shm_pixel_conversion
+{
+   /** 32 bits per pixel with 8-bit channels: a plain copy. */
+   none,
+   /** Depth 16. */
+   rgb565,
+   /** Depth 24 in 24-bit pixels. */
+   rgb888,
+   /** Depth 30, 10-bit channels in 32-bit pixels. */
+   x2r10g10b10,
+   /** No kernel for the pixmap format; rows are copied as they are. */
+   unsupported,
+};
+
+/**
+ * @brief Row kernel the SHM presenter copies unscaled 32-bit frames with (WSI_SHM_COPY_KERNEL).
+ */
+enum class shm_copy_kernel
+{
+   /** memcpy bands when the strides match, NEON or scalar rows otherwise. */
+   automatic,
+   /** NEON rows even when the strides match; scalar rows on builds without NEON. */
+   simd,
+   /** Scalar rows, also on NEON builds. */
+   scalar,
+};
+
+/**
+ * @brief Copy paths WSI_SHM_COPY_STATS times separately.
+ */
+enum class shm_copy_path
+{
+   /** Matching strides, memcpy in bands. */
+   memcpy_bands,
+   /** Row kernel in bands, for padded source rows. */
+   rows,
+   /** Nearest-neighbour columns through the scaling LUT. */
+   lut,
+   /** Bilinear or area scaling to the window. */
+   scale,
+   /** Pixel format conversion. */
+   convert,
+   /** Damage rectangles only. */
+   damage,
+   /** Unknown bytes per pixel, row by row. */
+   fallback,
+   count,
+};
+
 class shm_presenter
 {
 public:
@@ -56,17 +147,90 @@ public:
 
    shm_presenter();
 
-   VkResult init(xcb_connection_t *connection, xcb_window_t window, surface *wsi_surface);
+   /**
+    * @param present_mode MAILBOX frames are expected from the swapchain's mailbox thread, so they are paced like
+    *                     FIFO and put without the put thread.
+    * @param metrics_key  Swapchain handle the per-frame segment wait is reported under on the metrics page.
+    * @param timing       Frame timing of the swapchain the pacing sleeps are recorded in, or nullptr.
+    */
+   VkResult init(xcb_connection_t *connection, xcb_window_t window, surface *wsi_surface,
+                 VkPresentModeKHR present_mode, uint64_t metrics_key, frame_timing *timing);
+
+   /**
+    * @param defer_segments Leave the segments to the image's first present_image(). Images that are never
+    *                       presented then never hold SHM memory.
+    */
+   VkResult create_image_resources(x11_image_data *image_data, uint32_t width, uint32_t height, int depth,
+                                   bool defer_segments = false);
 
-   VkResult create_image_resources(x11_image_data *image_data, uint32_t width, uint32_t height, int depth);
+   /**
+    * @brief Copy the image into its SHM segment and put it on the window.
+    *
+    * With the put thread running, this returns once the copy is done and the put is queued, so the caller
+    * can release the image while the put and the pacing wait happen on the put thread.
+    *
+    * @param image_data The image to present.
+    * @param serial     Present serial, used to match MSC notifications when pacing to vblank.
+    * @param damage     Regions changed since the previous present. Sub-rectangles are copied and put
+    *                   when the window already holds a complete frame.
+    * @param frame_id   Frame timing label of the frame.
+    * @param present_id Present id the presented callback reports the frame under.
+    * @param target_ns  CLOCK_MONOTONIC time the frame should reach the display, or 0 to show it as soon as the
+    *                   pacing allows.
+    * @param present_mode Mode of this present. MAILBOX frames are put without the put thread, also when the
+    *                     presenter was set up for FIFO.
+    * @param queued_ns    CLOCK_MONOTONIC time the present was queued, or 0. Puts paced to a vblank report the time
+    *                     from there to that vblank as the metrics page's display latency.
+    */
+   VkResult present_image(x11_image_data *image_data, uint32_t serial, const present_damage &damage,
+                          uint64_t frame_id, uint64_t present_id = 0, uint64_t target_ns = 0,
+                          VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR, uint64_t queued_ns = 0);
 
-   VkResult present_image(x11_image_data *image_data, uint32_t serial);
+   /**
+    * @brief Called on the thread doing the put once the presentation time of a frame is known.
+    *
+    * When @p msc is not 0, @p time_ns is the UST of that vblank, the one after the put, from a Present MSC
+    * notification. Otherwise it is the CLOCK_MONOTONIC time the XSync fence after the put signalled, which is
+    * when the server finished copying the frame into the window. @p time_ns is 0 when the MSC notification
+    * was lost.
+    */
+   using presented_callback = std::function<void(uint64_t present_id, uint64_t time_ns, uint64_t msc)>;
+
+   /**
+    * @brief Set the callback frames with a non-zero present id are reported to. Call before the first present.
+    */
+   void set_presented_callback(presented_callback callback)
+   {
+      m_presented_callback = std::move(callback);
+   }
 
    void destroy_image_resources(x11_image_data *image_data);
 
    bool is_available(xcb_connection_t *connection, surface *wsi_surface);
 
+   /**
+    * @brief Size frames are scaled to, for a present payload that can shrink them on the GPU.
+    *
+    * Safe to call from any thread; the size is the latest the presenter has seen.
+    *
+    * @return false when frames are not scaled, or the window size is not known yet.
+    */
+   bool get_scale_target(uint32_t *width, uint32_t *height) const;
+
+   /**
+    * @brief Whether the pixmap format differs from the swapchain's, so the segments need converted pixels.
+    */
+   bool converts_pixels() const
+   {
+      return m_pixel_conversion != shm_pixel_conversion::none;
+   }
+
 private:
+#if MALI_WRAPPER_HARNESS
+   /** Runs the copy paths for mali_wrapper::harness::ShmCopyFrame(). */
+   friend struct shm_presenter_harness;
+#endif
+
    xcb_connection_t *m_connection = nullptr;
    xcb_window_t m_window = 0;
    surface *m_wsi_surface = nullptr;
@@ -76,23 +240,102 @@ private:
    uint32_t m_last_gpu_width = 0;
    uint32_t m_last_display_width = 0;
 
-   xcb_get_geometry_cookie_t m_pending_sync_cookie;
-   bool m_sync_pending = false;
+   shm_copy_kernel m_copy_kernel = shm_copy_kernel::automatic;
+
+   /**
+    * @brief WSI_SHM_COPY_STATS totals of one copy path, logged when the presenter is destroyed.
+    */
+   struct copy_stats
+   {
+      uint64_t frames = 0;
+      uint64_t bytes = 0;
+      uint64_t ns = 0;
+   };
+   bool m_copy_stats_enabled = false;
+   copy_stats m_copy_stats[static_cast<size_t>(shm_copy_path::count)];
 
-   xcb_sync_fence_t m_presentation_fence = XCB_NONE;
+   /** XSync is initialised, so each segment gets a fence. */
    bool m_fence_available = false;
-   bool m_first_frame = true;
+   /** WSI_SHM_SEGMENTS: segments in each image's ring. */
+   uint32_t m_segment_count = 2;
+   uint64_t m_metrics_key = 0;
+   frame_timing *m_frame_timing = nullptr;
+   /** MALI_WRAPPER_OVERLAY, stamped into 32-bit segments after the copy. */
+   std::unique_ptr<frame_overlay> m_overlay;
 
    std::unordered_map<int, uint8_t> m_depth_to_bpp_cache;
+   std::unordered_map<int, uint8_t> m_depth_to_scanline_pad_cache;
+   /** Chosen from the window depth when the swapchain's first image is created. */
+   shm_pixel_conversion m_pixel_conversion = shm_pixel_conversion::none;
+   bool m_pixel_conversion_selected = false;
 
    std::chrono::steady_clock::time_point m_last_frame_time;
    std::chrono::microseconds m_frame_interval;
    double m_refresh_rate_hz;
 
+   shm_pacing m_pacing = shm_pacing::timer;
+   uint32_t m_present_event_id = 0;
+   xcb_special_event_t *m_present_special_event = nullptr;
+   uint64_t m_last_msc = 0;
+   /** CLOCK_MONOTONIC time of m_last_msc in nanoseconds, from its UST. */
+   uint64_t m_last_ust_ns = 0;
+
+   presented_callback m_presented_callback;
+
+   /** WSI_SHM_DAMAGE_TILES: find damage by hashing 64x64 tiles when the application gives no regions. */
+   bool m_damage_tiles = false;
+   /** The window shows a complete frame of the current size, so partial puts are enough. */
+   bool m_window_complete = false;
+   uint32_t m_damage_width = 0;
+   uint32_t m_damage_height = 0;
+   std::vector<uint64_t> m_tile_hashes;
+   std::vector<xcb_rectangle_t> m_damage_rects;
+
+   /** WSI_SHM_SCALE. Atomic because get_scale_target() reads it from the application's present thread. */
+   std::atomic<shm_scale_mode> m_scale_mode{ shm_scale_mode::automatic };
+   shm_scaler m_scaler;
+   /** Window size from the surface's cache, refreshed every frame. */
+   std::atomic<uint32_t> m_window_width{ 0 };
+   std::atomic<uint32_t> m_window_height{ 0 };
+
+   /**
+    * @brief A copied segment waiting to be put on the window.
+    */
+   struct put_job
+   {
+      const x11_image_data *image_data;
+      shm_segment *segment;
+      uint32_t serial;
+      /** Frame timing label of the frame. */
+      uint64_t frame_id;
+      uint64_t present_id;
+      /** CLOCK_MONOTONIC time the frame should reach the display, 0 if it has no target. */
+      uint64_t target_ns;
+      /** CLOCK_MONOTONIC time the present was queued, 0 if it was not recorded. */
+      uint64_t queued_ns;
+      /** Put only rects; otherwise the whole image. */
+      bool partial;
+      /** Size of the frame in the segment, which differs from the image's when it was scaled. */
+      uint32_t width;
+      uint32_t height;
+      std::vector<xcb_rectangle_t> rects;
+   };
+
+   /** WSI_SHM_PIPELINE: puts and pacing run on m_put_thread instead of the presenting thread. */
+   bool m_pipelined = false;
+   std::thread m_put_thread;
+   std::mutex m_put_mutex;
+   std::condition_variable m_put_cond;
+   std::deque<put_job> m_put_queue;
+   /** The put thread is working on a job it already took off m_put_queue. */
+   bool m_put_busy = false;
+   bool m_put_stopping = false;
+
    VkResult create_graphics_context();
 
    void precompute_scaling_lut(uint32_t gpu_width, uint32_t display_width);
-   void copy_pixels_optimized(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
+   /** @return The path the frame was copied with, for WSI_SHM_COPY_STATS. */
+   shm_copy_path copy_pixels_optimized(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
                               uint32_t dst_width, uint32_t height);
    void copy_pixels_threaded(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
                              uint32_t dst_width, uint32_t height);
@@ -105,24 +348,109 @@ private:
    void copy_pixels_scalar(const uint32_t *src_pixels, uint32_t *dst_pixels, uint32_t src_stride_pixels,
                            uint32_t dst_width, uint32_t height);
 
-   void start_async_sync();
-   bool check_pending_sync();
-   void ensure_sync_completion();
-
    bool init_fence_sync();
-   void cleanup_fence_sync();
-   void wait_for_presentation_fence();
-   void trigger_presentation_fence();
+
+   /** Bytes m_damage_rects cover in a segment of bytes_per_pixel. */
+   uint64_t damage_bytes(size_t bytes_per_pixel) const;
+   void record_copy(shm_copy_path path, uint64_t bytes, uint64_t start_ns);
+   void log_copy_stats() const;
+
+   VkResult create_segment(shm_segment &segment, size_t size);
+   /** Create and attach the image's ring of segments, of image_data->shm_size each. */
+   VkResult create_image_segments(x11_image_data *image_data);
+   void destroy_segment(shm_segment &segment);
+
+   /**
+    * @brief Reallocate the segment when it holds fewer than size bytes, for frames scaled to a larger window.
+    *
+    * @param fallback_size Size to recreate the segment at when the larger allocation fails.
+    *
+    * @return true if the segment now holds size bytes.
+    */
+   bool ensure_segment_size(shm_segment &segment, size_t size, size_t fallback_size);
+
+   void update_window_size();
+
+   /**
+    * @brief Queue the fence trigger and the round trip that tell when the server is done with the last put.
+    */
+   void mark_segment_in_flight(shm_segment &segment);
+
+   /**
+    * @brief Wait until the server has finished the last put from the segment.
+    *
+    * @return Time spent blocked, in nanoseconds.
+    */
+   uint64_t wait_for_segment(shm_segment &segment);
 
    void cache_x11_formats();
    uint8_t get_bits_per_pixel_for_depth(int depth);
+   uint8_t get_scanline_pad_for_depth(int depth);
 
    bool is_aligned(const void *ptr, size_t alignment);
 #ifdef ENABLE_ARM_NEON
    bool are_pointers_neon_aligned(const void *src, void *dst);
 #endif
    void detect_refresh_rate();
-   double get_window_refresh_rate();
+
+   /**
+    * @brief Pick the pacing mode from WSI_SHM_PACING and the present mode, and set up MSC events for vblank pacing.
+    */
+   void init_pacing(VkPresentModeKHR present_mode);
+   void cleanup_pacing();
+   void pace_with_timer();
+
+   /**
+    * @brief Wait for the vblank at @p target_msc, or for the one after the previous frame's when it is 0.
+    *
+    * MSCs that already passed complete at once. Updates m_last_msc and m_last_ust_ns.
+    *
+    * @return false when the MSC notification was lost.
+    */
+   bool pace_with_vblank(uint32_t serial, uint64_t target_msc = 0);
+
+   /**
+    * @brief Hold the put of a frame back so it reaches the display at @p target_ns rather than early.
+    */
+   void wait_for_target_time(const put_job &job);
+
+   void start_put_thread();
+   void stop_put_thread();
+   void put_thread_main();
+
+   /**
+    * @brief Hold the put back to the frame's target time, put the segment on the window, queue its in-flight
+    *        tracking and wait for the pacing interval.
+    */
+   void put_segment(const put_job &job);
+
+   /**
+    * @brief Block until the put thread has no queued or running job.
+    */
+   void wait_for_put_thread_idle();
+
+   /**
+    * @brief Fill m_damage_rects for this frame.
+    *
+    * @param damage     The application's regions; used in preference to tile hashing.
+    * @param src_base   First pixel of the source for tile hashing, or nullptr when the CPU cannot read it.
+    * @param src_stride Source row pitch in bytes.
+    *
+    * @return true to copy and put only m_damage_rects, false to update the whole frame.
+    */
+   bool select_damage(const present_damage &damage, const char *src_base, size_t src_stride, uint32_t width,
+                      uint32_t height);
+   bool detect_tile_damage(const char *src_base, size_t src_stride, uint32_t width, uint32_t height,
+                           bool reset);
+   void copy_damage_rects(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride);
+
+   /**
+    * @brief Write B8G8R8A8 rows into the segment in the m_pixel_conversion pixmap format.
+    *
+    * @param damage_only Convert only m_damage_rects instead of the whole image.
+    */
+   void convert_pixels(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride, uint32_t width,
+                       uint32_t height, bool damage_only);
 
 };
 
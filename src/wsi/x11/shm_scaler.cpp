@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file shm_scaler.cpp
+ *
+ * @brief 2D scaler for SHM frames presented into a window of a different size.
+ */
+
+#include "shm_scaler.hpp"
+
+#include <algorithm>
+#ifdef ENABLE_ARM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace wsi
+{
+namespace x11
+{
+
+/* Bilinear weights have 7 bits, so both weights of a pair fit a byte and a weighted channel sum fits 16 bits. */
+static constexpr uint32_t WEIGHT_BITS = 7;
+static constexpr uint32_t WEIGHT_ONE = 1u << WEIGHT_BITS;
+
+static void build_bilinear_axis(uint32_t src, uint32_t dst, std::vector<uint32_t> &index,
+                                std::vector<uint8_t> &weight)
+{
+   index.resize(dst);
+   weight.resize(dst);
+   const int64_t last = static_cast<int64_t>(src - 1) << 16;
+   for (uint32_t d = 0; d < dst; ++d)
+   {
+      /* Sample at the destination pixel centre, in 16.16 source coordinates. */
+      int64_t pos = ((2 * static_cast<int64_t>(d) + 1) * src * 65536) / (2 * static_cast<int64_t>(dst)) - 32768;
+      pos = std::min(std::max<int64_t>(pos, 0), last);
+      index[d] = static_cast<uint32_t>(pos >> 16);
+      weight[d] = static_cast<uint8_t>((pos & 0xffff) >> (16 - WEIGHT_BITS));
+   }
+}
+
+static void build_area_axis(uint32_t src, uint32_t dst, std::vector<uint32_t> &begin, std::vector<uint32_t> &end)
+{
+   begin.resize(dst);
+   end.resize(dst);
+   for (uint32_t d = 0; d < dst; ++d)
+   {
+      begin[d] = static_cast<uint32_t>((static_cast<uint64_t>(d) * src) / dst);
+      end[d] = std::max(begin[d] + 1, static_cast<uint32_t>((static_cast<uint64_t>(d + 1) * src) / dst));
+   }
+}
+
+/* Two channels per multiply: the 0x00ff00ff lanes leave room for the weighted sums. */
+static inline uint32_t lerp_pixel(uint32_t p0, uint32_t p1, uint32_t weight)
+{
+   const uint32_t inverse = WEIGHT_ONE - weight;
+   const uint32_t round = 0x00010001u << (WEIGHT_BITS - 1);
+   const uint32_t rb = (((p0 & 0x00ff00ffu) * inverse + (p1 & 0x00ff00ffu) * weight + round) >> WEIGHT_BITS) &
+                       0x00ff00ffu;
+   const uint32_t ag =
+      ((((p0 >> 8) & 0x00ff00ffu) * inverse + ((p1 >> 8) & 0x00ff00ffu) * weight + round) >> WEIGHT_BITS) &
+      0x00ff00ffu;
+   return rb | (ag << 8);
+}
+
+static void blend_rows(const uint32_t *row_a, const uint32_t *row_b, uint32_t weight, uint32_t *out, uint32_t count)
+{
+   uint32_t x = 0;
+#ifdef ENABLE_ARM_NEON
+   const uint8x8_t weight_a = vdup_n_u8(static_cast<uint8_t>(WEIGHT_ONE - weight));
+   const uint8x8_t weight_b = vdup_n_u8(static_cast<uint8_t>(weight));
+   for (; x + 4 <= count; x += 4)
+   {
+      const uint8x16_t a = vld1q_u8(reinterpret_cast<const uint8_t *>(row_a + x));
+      const uint8x16_t b = vld1q_u8(reinterpret_cast<const uint8_t *>(row_b + x));
+      uint16x8_t low = vmull_u8(vget_low_u8(a), weight_a);
+      low = vmlal_u8(low, vget_low_u8(b), weight_b);
+      uint16x8_t high = vmull_u8(vget_high_u8(a), weight_a);
+      high = vmlal_u8(high, vget_high_u8(b), weight_b);
+      vst1q_u8(reinterpret_cast<uint8_t *>(out + x),
+               vcombine_u8(vrshrn_n_u16(low, WEIGHT_BITS), vrshrn_n_u16(high, WEIGHT_BITS)));
+   }
+#endif
+   for (; x < count; ++x)
+   {
+      out[x] = lerp_pixel(row_a[x], row_b[x], weight);
+   }
+}
+
+/* Adds each channel of a source row to its column sum, four sums per pixel in memory order. */
+static void accumulate_row(const uint32_t *row, uint32_t *sums, uint32_t count)
+{
+   uint32_t x = 0;
+#ifdef ENABLE_ARM_NEON
+   for (; x + 4 <= count; x += 4)
+   {
+      const uint8x16_t px = vld1q_u8(reinterpret_cast<const uint8_t *>(row + x));
+      const uint16x8_t low = vmovl_u8(vget_low_u8(px));
+      const uint16x8_t high = vmovl_u8(vget_high_u8(px));
+      uint32_t *s = sums + x * 4;
+      vst1q_u32(s, vaddw_u16(vld1q_u32(s), vget_low_u16(low)));
+      vst1q_u32(s + 4, vaddw_u16(vld1q_u32(s + 4), vget_high_u16(low)));
+      vst1q_u32(s + 8, vaddw_u16(vld1q_u32(s + 8), vget_low_u16(high)));
+      vst1q_u32(s + 12, vaddw_u16(vld1q_u32(s + 12), vget_high_u16(high)));
+   }
+#endif
+   for (; x < count; ++x)
+   {
+      const uint32_t p = row[x];
+      for (uint32_t channel = 0; channel < 4; ++channel)
+      {
+         sums[x * 4 + channel] += (p >> (channel * 8)) & 0xff;
+      }
+   }
+}
+
+void shm_scaler::configure(uint32_t src_width, uint32_t src_height, uint32_t dst_width, uint32_t dst_height,
+                           shm_scale_filter filter)
+{
+   if (src_width == m_src_width && src_height == m_src_height && dst_width == m_dst_width &&
+       dst_height == m_dst_height && filter == m_filter)
+   {
+      return;
+   }
+
+   m_src_width = src_width;
+   m_src_height = src_height;
+   m_dst_width = dst_width;
+   m_dst_height = dst_height;
+   m_filter = filter;
+
+   if (filter == shm_scale_filter::bilinear)
+   {
+      build_bilinear_axis(src_width, dst_width, m_x_index, m_x_weight);
+      build_bilinear_axis(src_height, dst_height, m_y_index, m_y_weight);
+   }
+   else
+   {
+      build_area_axis(src_width, dst_width, m_x_begin, m_x_end);
+      build_area_axis(src_height, dst_height, m_y_begin, m_y_end);
+   }
+}
+
+void shm_scaler::scale_rows(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride,
+                            uint32_t first_row, uint32_t row_count) const
+{
+   if (m_filter == shm_scale_filter::bilinear)
+   {
+      scale_rows_bilinear(src_base, src_stride, dst_base, dst_stride, first_row, row_count);
+   }
+   else
+   {
+      scale_rows_area(src_base, src_stride, dst_base, dst_stride, first_row, row_count);
+   }
+}
+
+void shm_scaler::scale_rows_bilinear(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride,
+                                     uint32_t first_row, uint32_t row_count) const
+{
+   /* Blend the two source rows first, so the vertical pass runs over contiguous pixels. */
+   thread_local std::vector<uint32_t> blended;
+   blended.resize(m_src_width);
+
+   for (uint32_t y = first_row; y < first_row + row_count; ++y)
+   {
+      const uint32_t src_y = m_y_index[y];
+      const uint32_t *row = reinterpret_cast<const uint32_t *>(src_base + src_y * src_stride);
+      if (m_y_weight[y] != 0)
+      {
+         const uint32_t *next_row = reinterpret_cast<const uint32_t *>(src_base + (src_y + 1) * src_stride);
+         blend_rows(row, next_row, m_y_weight[y], blended.data(), m_src_width);
+         row = blended.data();
+      }
+
+      uint32_t *dst = reinterpret_cast<uint32_t *>(dst_base + y * dst_stride);
+      for (uint32_t x = 0; x < m_dst_width; ++x)
+      {
+         const uint32_t src_x = m_x_index[x];
+         const uint32_t next_x = std::min(src_x + 1, m_src_width - 1);
+         dst[x] = lerp_pixel(row[src_x], row[next_x], m_x_weight[x]);
+      }
+   }
+}
+
+void shm_scaler::scale_rows_area(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride,
+                                 uint32_t first_row, uint32_t row_count) const
+{
+   thread_local std::vector<uint32_t> sums;
+   sums.resize(static_cast<size_t>(m_src_width) * 4);
+
+   for (uint32_t y = first_row; y < first_row + row_count; ++y)
+   {
+      std::fill(sums.begin(), sums.end(), 0);
+      for (uint32_t src_y = m_y_begin[y]; src_y < m_y_end[y]; ++src_y)
+      {
+         accumulate_row(reinterpret_cast<const uint32_t *>(src_base + src_y * src_stride), sums.data(), m_src_width);
+      }
+
+      const uint64_t rows = m_y_end[y] - m_y_begin[y];
+      uint32_t *dst = reinterpret_cast<uint32_t *>(dst_base + y * dst_stride);
+      for (uint32_t x = 0; x < m_dst_width; ++x)
+      {
+         uint64_t channel_sums[4] = {};
+         for (uint32_t src_x = m_x_begin[x]; src_x < m_x_end[x]; ++src_x)
+         {
+            for (uint32_t channel = 0; channel < 4; ++channel)
+            {
+               channel_sums[channel] += sums[src_x * 4 + channel];
+            }
+         }
+
+         const uint64_t count = rows * (m_x_end[x] - m_x_begin[x]);
+         uint32_t pixel = 0;
+         for (uint32_t channel = 0; channel < 4; ++channel)
+         {
+            pixel |= static_cast<uint32_t>((channel_sums[channel] + count / 2) / count) << (channel * 8);
+         }
+         dst[x] = pixel;
+      }
+   }
+}
+
+} /* namespace x11 */
+} /* namespace wsi */
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026 Arm Limited.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file shm_scaler.hpp
+ *
+ * @brief 2D scaler for SHM frames presented into a window of a different size.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace wsi
+{
+namespace x11
+{
+
+enum class shm_scale_filter
+{
+   /** Interpolate between the four nearest source pixels. Used when enlarging. */
+   bilinear,
+   /** Average every source pixel covered by the destination pixel. Used when shrinking. */
+   area,
+};
+
+/**
+ * @brief Scales 32-bit 8888 frames, one band of destination rows at a time.
+ *
+ * configure() builds the coordinate tables; afterwards scale_rows() may run on several threads at once for
+ * disjoint bands.
+ */
+class shm_scaler
+{
+public:
+   /**
+    * @brief Prepare for a source and destination size. Does nothing when they did not change.
+    */
+   void configure(uint32_t src_width, uint32_t src_height, uint32_t dst_width, uint32_t dst_height,
+                  shm_scale_filter filter);
+
+   /**
+    * @brief Write destination rows [first_row, first_row + row_count).
+    */
+   void scale_rows(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride, uint32_t first_row,
+                   uint32_t row_count) const;
+
+   uint32_t get_dst_width() const
+   {
+      return m_dst_width;
+   }
+
+   uint32_t get_dst_height() const
+   {
+      return m_dst_height;
+   }
+
+private:
+   void scale_rows_bilinear(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride,
+                            uint32_t first_row, uint32_t row_count) const;
+   void scale_rows_area(const char *src_base, size_t src_stride, char *dst_base, size_t dst_stride, uint32_t first_row,
+                        uint32_t row_count) const;
+
+   uint32_t m_src_width = 0;
+   uint32_t m_src_height = 0;
+   uint32_t m_dst_width = 0;
+   uint32_t m_dst_height = 0;
+   shm_scale_filter m_filter = shm_scale_filter::bilinear;
+
+   /* Bilinear: first source pixel and 7-bit weight of the second, per destination column and row. */
+   std::vector<uint32_t> m_x_index;
+   std::vector<uint8_t> m_x_weight;
+   std::vector<uint32_t> m_y_index;
+   std::vector<uint8_t> m_y_weight;
+
+   /* Area: source span [begin, end) per destination column and row. */
+   std::vector<uint32_t> m_x_begin;
+   std::vector<uint32_t> m_x_end;
+   std::vector<uint32_t> m_y_begin;
+   std::vector<uint32_t> m_y_end;
+};
+
+} /* namespace x11 */
+} /* namespace wsi */
@@ -29,6 +29,8 @@
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 #include <xcb/shm.h>
+#include <xcb/randr.h>
+#include <cstdlib>
 #include "surface.hpp"
 #include "swapchain.hpp"
 #include "surface_properties.hpp"
@@ -55,6 +57,10 @@ surface::surface(const init_parameters &params)
 
 surface::~surface()
 {
+   if (m_event_connection != nullptr)
+   {
+      xcb_disconnect(m_event_connection);
+   }
 }
 
 bool surface::init()
@@ -64,21 +70,266 @@ bool surface::init()
 
    m_has_shm = shm_reply != nullptr;
    free(shm_reply);
+
+   if (!init_event_connection())
+   {
+      WSI_LOG_WARNING("X11 surface: no private X connection, window size and refresh rate are queried on demand.");
+   }
+   return true;
+}
+
+bool surface::init_event_connection()
+{
+   m_event_connection = xcb_connect(nullptr, nullptr);
+   if (xcb_connection_has_error(m_event_connection))
+   {
+      xcb_disconnect(m_event_connection);
+      m_event_connection = nullptr;
+      return false;
+   }
+
+   /* Subscribe before reading the geometry so no resize can fall between the two. */
+   const uint32_t event_mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+   xcb_change_window_attributes(m_event_connection, m_window, XCB_CW_EVENT_MASK, &event_mask);
+
+   /* Also checks that the default display is the application's: the window must exist on it. */
+   auto *geom = xcb_get_geometry_reply(m_event_connection, xcb_get_geometry(m_event_connection, m_window), nullptr);
+   if (geom == nullptr)
+   {
+      xcb_disconnect(m_event_connection);
+      m_event_connection = nullptr;
+      return false;
+   }
+   m_root = geom->root;
+   m_width = geom->width;
+   m_height = geom->height;
+   m_depth = geom->depth;
+   m_geometry_valid = true;
+   free(geom);
+
+   const xcb_query_extension_reply_t *randr = xcb_get_extension_data(m_event_connection, &xcb_randr_id);
+   if (randr != nullptr && randr->present)
+   {
+      /* GetScreenResourcesCurrent needs RandR 1.3. */
+      auto *version = xcb_randr_query_version_reply(m_event_connection,
+                                                    xcb_randr_query_version(m_event_connection, 1, 3), nullptr);
+      if (version != nullptr && (version->major_version > 1 || version->minor_version >= 3))
+      {
+         m_has_randr = true;
+         m_randr_event_base = randr->first_event;
+         xcb_randr_select_input(m_event_connection, m_root,
+                                XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE | XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE);
+      }
+      free(version);
+   }
+   if (!m_has_randr)
+   {
+      WSI_LOG_WARNING("X11 surface: RandR 1.3 not available, using a 60Hz refresh rate");
+   }
+
+   std::lock_guard<std::mutex> lock(m_cache_mutex);
+   process_events();
    return true;
 }
 
+void surface::process_events()
+{
+   while (xcb_generic_event_t *event = xcb_poll_for_event(m_event_connection))
+   {
+      const uint8_t type = event->response_type & ~0x80;
+      if (type == XCB_CONFIGURE_NOTIFY)
+      {
+         auto *configure = reinterpret_cast<xcb_configure_notify_event_t *>(event);
+         if (configure->window == m_window)
+         {
+            m_width = configure->width;
+            m_height = configure->height;
+            /* Window managers send synthetic events in root coordinates when they move the frame (ICCCM 4.1.5).
+             * Real ones are relative to the parent. */
+            if ((event->response_type & 0x80) != 0)
+            {
+               m_window_x = configure->x;
+               m_window_y = configure->y;
+               m_position_stale = false;
+            }
+            else
+            {
+               m_position_stale = true;
+            }
+         }
+      }
+      else if (type == XCB_REPARENT_NOTIFY)
+      {
+         m_position_stale = true;
+      }
+      else if (m_has_randr && (type == m_randr_event_base + XCB_RANDR_SCREEN_CHANGE_NOTIFY ||
+                               type == m_randr_event_base + XCB_RANDR_NOTIFY))
+      {
+         m_crtcs_stale = true;
+      }
+      free(event);
+   }
+
+   if (xcb_connection_has_error(m_event_connection))
+   {
+      /* Keep the last known values rather than failing every query. */
+      return;
+   }
+
+   const bool crtcs_changed = m_crtcs_stale;
+   if (m_crtcs_stale)
+   {
+      load_crtcs();
+   }
+
+   /* With a single CRTC the position cannot change which one shows the window. */
+   const bool moved = m_position_stale && m_crtcs.size() > 1;
+   if (moved)
+   {
+      update_window_position();
+   }
+
+   if (crtcs_changed || moved)
+   {
+      select_refresh_rate();
+   }
+}
+
+void surface::load_crtcs()
+{
+   m_crtcs_stale = false;
+   m_crtcs.clear();
+   if (!m_has_randr)
+   {
+      return;
+   }
+
+   auto *resources = xcb_randr_get_screen_resources_current_reply(
+      m_event_connection, xcb_randr_get_screen_resources_current(m_event_connection, m_root), nullptr);
+   if (resources == nullptr)
+   {
+      WSI_LOG_WARNING("X11 surface: failed to get RandR screen resources");
+      return;
+   }
+
+   const xcb_randr_crtc_t *crtcs = xcb_randr_get_screen_resources_current_crtcs(resources);
+   const int crtc_count = xcb_randr_get_screen_resources_current_crtcs_length(resources);
+   const xcb_randr_mode_info_t *modes = xcb_randr_get_screen_resources_current_modes(resources);
+   const int mode_count = xcb_randr_get_screen_resources_current_modes_length(resources);
+
+   /* Send every CRTC query before waiting for the first reply. */
+   std::vector<xcb_randr_get_crtc_info_cookie_t> cookies(crtc_count);
+   for (int i = 0; i < crtc_count; i++)
+   {
+      cookies[i] = xcb_randr_get_crtc_info(m_event_connection, crtcs[i], resources->config_timestamp);
+   }
+
+   for (int i = 0; i < crtc_count; i++)
+   {
+      auto *crtc_info = xcb_randr_get_crtc_info_reply(m_event_connection, cookies[i], nullptr);
+      if (crtc_info == nullptr)
+      {
+         continue;
+      }
+      if (crtc_info->mode != XCB_NONE && crtc_info->num_outputs > 0)
+      {
+         for (int j = 0; j < mode_count; j++)
+         {
+            if (modes[j].id == crtc_info->mode && modes[j].htotal != 0 && modes[j].vtotal != 0)
+            {
+               const double refresh = static_cast<double>(modes[j].dot_clock) /
+                                      (static_cast<double>(modes[j].htotal) * static_cast<double>(modes[j].vtotal));
+               m_crtcs.push_back({ crtc_info->x, crtc_info->y, crtc_info->width, crtc_info->height, refresh });
+               break;
+            }
+         }
+      }
+      free(crtc_info);
+   }
+   free(resources);
+
+   /* A new layout may have moved the window's CRTC. */
+   m_position_stale = true;
+}
+
+void surface::update_window_position()
+{
+   auto *reply = xcb_translate_coordinates_reply(
+      m_event_connection, xcb_translate_coordinates(m_event_connection, m_window, m_root, 0, 0), nullptr);
+   if (reply != nullptr)
+   {
+      m_window_x = reply->dst_x;
+      m_window_y = reply->dst_y;
+      m_position_stale = false;
+      free(reply);
+   }
+}
+
+void surface::select_refresh_rate()
+{
+   double refresh_rate = m_crtcs.empty() ? 60.0 : m_crtcs.front().refresh_rate;
+   for (const auto &crtc : m_crtcs)
+   {
+      if (m_window_x >= crtc.x && m_window_x < crtc.x + static_cast<int32_t>(crtc.width) && m_window_y >= crtc.y &&
+          m_window_y < crtc.y + static_cast<int32_t>(crtc.height))
+      {
+         refresh_rate = crtc.refresh_rate;
+         break;
+      }
+   }
+
+   /* Reasonable bounds for display refresh rates */
+   if (refresh_rate < 30.0 || refresh_rate > 240.0)
+   {
+      WSI_LOG_WARNING("Detected refresh rate %.2f Hz seems invalid, using 60Hz", refresh_rate);
+      refresh_rate = 60.0;
+   }
+
+   if (refresh_rate != m_refresh_rate)
+   {
+      WSI_LOG_INFO("X11 surface: window 0x%x is on a %.2f Hz display", m_window, refresh_rate);
+   }
+   m_refresh_rate = refresh_rate;
+}
+
 bool surface::get_size_and_depth(uint32_t *width, uint32_t *height, int *depth)
 {
-   auto cookie = xcb_get_geometry(m_connection, m_window);
-   if (auto *geom = xcb_get_geometry_reply(m_connection, cookie, nullptr))
+   if (m_event_connection == nullptr)
    {
-      *width = static_cast<uint32_t>(geom->width);
-      *height = static_cast<uint32_t>(geom->height);
-      *depth = static_cast<int>(geom->depth);
-      free(geom);
-      return true;
+      auto cookie = xcb_get_geometry(m_connection, m_window);
+      if (auto *geom = xcb_get_geometry_reply(m_connection, cookie, nullptr))
+      {
+         *width = static_cast<uint32_t>(geom->width);
+         *height = static_cast<uint32_t>(geom->height);
+         *depth = static_cast<int>(geom->depth);
+         free(geom);
+         return true;
+      }
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(m_cache_mutex);
+   process_events();
+   if (!m_geometry_valid)
+   {
+      return false;
+   }
+   *width = m_width;
+   *height = m_height;
+   *depth = m_depth;
+   return true;
+}
+
+double surface::get_refresh_rate()
+{
+   if (m_event_connection == nullptr)
+   {
+      return 60.0;
    }
-   return false;
+
+   std::lock_guard<std::mutex> lock(m_cache_mutex);
+   process_events();
+   return m_refresh_rate;
 }
 
 wsi::surface_properties &surface::get_properties()
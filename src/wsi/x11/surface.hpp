@@ -31,6 +31,8 @@
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 #include <xcb/shm.h>
+#include <mutex>
+#include <vector>
 #include "wsi/surface.hpp"
 #include "surface_properties.hpp"
 
@@ -61,8 +63,24 @@ public:
    static util::unique_ptr<surface> make_surface(const util::allocator &allocator, xcb_connection_t *conn,
                                                  xcb_window_t window);
 
+   /**
+    * @brief Get the window's current size and depth.
+    *
+    * Served from a cache kept current by ConfigureNotify events, so no round trip is made on the application's
+    * connection.
+    *
+    * @return true on success, false if the window geometry is unknown.
+    */
    bool get_size_and_depth(uint32_t *width, uint32_t *height, int *depth);
 
+   /**
+    * @brief Get the refresh rate of the CRTC showing the window, in Hz.
+    *
+    * Kept current by RandR screen change events, so it follows the window between monitors.
+    * Falls back to 60 Hz when it cannot be detected.
+    */
+   double get_refresh_rate();
+
    xcb_connection_t *get_connection()
    {
       return m_connection;
@@ -79,6 +97,35 @@ public:
    }
 
 private:
+   /**
+    * @brief Position, size and refresh rate of an active CRTC.
+    */
+   struct crtc_mode
+   {
+      int32_t x;
+      int32_t y;
+      uint32_t width;
+      uint32_t height;
+      double refresh_rate;
+   };
+
+   /**
+    * @brief Open the private connection that receives the window's and the screen's events.
+    *
+    * @return true if the cache can be used, false to query the server on demand instead.
+    */
+   bool init_event_connection();
+
+   /**
+    * @brief Apply the events received since the last call and reload what they invalidated.
+    *
+    * Must be called with m_cache_mutex held.
+    */
+   void process_events();
+   void load_crtcs();
+   void update_window_position();
+   void select_refresh_rate();
+
    xcb_connection_t *m_connection;
    xcb_window_t m_window;
    /** Surface properties specific to the X11 surface. */
@@ -86,6 +133,28 @@ private:
 
    /** X11 extension capabilities */
    bool m_has_shm = false;
+
+   /**
+    * Connection used only for event subscriptions and the queries they trigger. Event masks are per client, so
+    * selecting events here sends nothing to the application's own event queue.
+    */
+   xcb_connection_t *m_event_connection = nullptr;
+   xcb_window_t m_root = XCB_NONE;
+   bool m_has_randr = false;
+   uint8_t m_randr_event_base = 0;
+
+   std::mutex m_cache_mutex;
+   bool m_geometry_valid = false;
+   uint32_t m_width = 0;
+   uint32_t m_height = 0;
+   int m_depth = 0;
+   /** Window origin in root coordinates, used to find the CRTC showing it. */
+   int32_t m_window_x = 0;
+   int32_t m_window_y = 0;
+   bool m_position_stale = true;
+   bool m_crtcs_stale = true;
+   std::vector<crtc_mode> m_crtcs;
+   double m_refresh_rate = 60.0;
 };
 
 } /* namespace x11 */
@@ -49,9 +49,10 @@ namespace x11
 
 void surface_properties::populate_present_mode_compatibilities()
 {
+   /* The swapchain keeps the page flip thread and the SHM mailbox thread when it may switch between these. */
    std::array<present_mode_compatibility, 2> compatible_present_modes_list = {
-      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 1, { VK_PRESENT_MODE_FIFO_KHR } },
-      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 1, { VK_PRESENT_MODE_MAILBOX_KHR } }
+      present_mode_compatibility{ VK_PRESENT_MODE_FIFO_KHR, 2, { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR } },
+      present_mode_compatibility{ VK_PRESENT_MODE_MAILBOX_KHR, 2, { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR } }
    };
    m_compatible_present_modes = compatible_present_modes<2>(compatible_present_modes_list);
 }
@@ -360,13 +361,14 @@ void surface_properties::get_present_timing_surface_caps(
 {
    present_timing_surface_caps->presentTimingSupported = VK_TRUE;
    present_timing_surface_caps->presentAtAbsoluteTimeSupported = VK_TRUE;
-   present_timing_surface_caps->presentAtRelativeTimeSupported = VK_TRUE;
-   present_timing_surface_caps->presentStageQueries =
-      VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT | VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
-      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT;
-   present_timing_surface_caps->presentStageTargets = VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
-                                                      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT |
-                                                      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_VISIBLE_BIT_EXT;
+   /* Targets are turned into Present MSCs or SHM put times, which only absolute times map onto. */
+   present_timing_surface_caps->presentAtRelativeTimeSupported = VK_FALSE;
+   /* Times come from Present UST and XSync fences; nothing reports when the panel actually lights up. */
+   present_timing_surface_caps->presentStageQueries = VK_PRESENT_STAGE_QUEUE_OPERATIONS_END_BIT_EXT |
+                                                      VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
+                                                      VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+   present_timing_surface_caps->presentStageTargets =
+      VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
 }
 #endif
 
@@ -28,6 +28,8 @@
  * @brief Contains the implementation for a x11 swapchain.
  */
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cerrno>
 #include <chrono>
@@ -37,8 +39,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <mutex>
 #include <system_error>
 #include <thread>
+#include <unordered_set>
 
 #include <dlfcn.h>
 #include <drm_fourcc.h>
@@ -53,13 +57,18 @@
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
 
-#include "drm_display.hpp"
+#include "../display/drm_display.hpp"
 #include "swapchain.hpp"
 #include "utils/logging.hpp"
+#include "utils/thread_placement.hpp"
+#include "../layer_utils/format_modifiers.hpp"
 #include "../layer_utils/macros.hpp"
 #include "wsi/external_memory.hpp"
 #include "wsi/swapchain_base.hpp"
+#include "wsi/extensions/image_compression_control.hpp"
 #include "wsi/extensions/present_id.hpp"
+#include "core/metrics_page.hpp"
+#include "present_timing_handler.hpp"
 #include "shm_presenter.hpp"
 #include "xwayland_dmabuf_bridge.hpp"
 
@@ -68,17 +77,42 @@ namespace wsi
 namespace x11
 {
 
-#define X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS 128
-
 namespace
 {
-std::atomic<bool> g_disable_xwayland_bridge_runtime{ false };
+std::atomic<bool> g_disable_dri3_runtime{ false };
+
+/* Windows whose bridge stream failed at runtime. Other windows of the process keep using the bridge. */
+std::mutex g_xwayland_bridge_failed_windows_mutex;
+std::unordered_set<xcb_window_t> g_xwayland_bridge_failed_windows;
+
+bool is_xwayland_bridge_disabled_for_window(xcb_window_t window)
+{
+   std::lock_guard<std::mutex> lock(g_xwayland_bridge_failed_windows_mutex);
+   return g_xwayland_bridge_failed_windows.count(window) != 0;
+}
+
+/* Returns false if the window was already marked. */
+bool disable_xwayland_bridge_for_window(xcb_window_t window)
+{
+   std::lock_guard<std::mutex> lock(g_xwayland_bridge_failed_windows_mutex);
+   return g_xwayland_bridge_failed_windows.insert(window).second;
+}
 
 bool env_var_is_enabled(const char *value)
 {
    return value && value[0] != '\0' && !(value[0] == '0' && value[1] == '\0');
 }
 
+/* Copies riding on the present payload are recorded in a pool on family 0. The payload is submitted to
+ * whichever queue the application presents on, so the pool can only match it when there is one family. */
+bool has_single_queue_family(const wsi::device_private_data &device_data)
+{
+   uint32_t queue_family_count = 0;
+   device_data.instance_data.disp.GetPhysicalDeviceQueueFamilyProperties2KHR(device_data.physical_device,
+                                                                            &queue_family_count, nullptr);
+   return queue_family_count == 1;
+}
+
 bool allow_non_fifo_present_mode()
 {
    return env_var_is_enabled(std::getenv("WSI_ALLOW_NON_FIFO_PRESENT_MODE")) ||
@@ -158,6 +192,9 @@ swapchain::swapchain(wsi::device_private_data &dev_data, const VkAllocationCallb
 
 swapchain::~swapchain()
 {
+   /* Before teardown(), which waits for the frame left in the mailbox to be released. */
+   stop_shm_mailbox_thread();
+
    auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
 
    if (m_present_event_thread_run)
@@ -166,6 +203,13 @@ swapchain::~swapchain()
       m_thread_status_cond.notify_all();
       thread_status_lock.unlock();
 
+      if (m_present_special_event != nullptr)
+      {
+         /* The event thread may be blocked waiting for a Present event; an immediate MSC notify wakes it. */
+         xcb_present_notify_msc(m_connection, m_window, 0, 0, 0, 0);
+         xcb_flush(m_connection);
+      }
+
       if (m_present_event_thread.joinable())
       {
          m_present_event_thread.join();
@@ -176,22 +220,77 @@ swapchain::~swapchain()
 
    thread_status_lock.unlock();
 
+   if (m_xwayland_bridge)
+   {
+      m_xwayland_bridge->stop_stream(m_window);
+      /* Joins the feedback reader, which may be waiting for m_thread_status_lock to release images. */
+      m_xwayland_bridge.reset();
+   }
+
    if (m_use_xwayland_bridge)
    {
-      while (!m_bridge_pending_unpresent.empty())
+      while (auto pending = m_bridge_pending_unpresent.pop_front())
       {
-         unpresent_image(m_bridge_pending_unpresent.front());
-         m_bridge_pending_unpresent.pop_front();
+         unpresent_image(pending->image_index);
       }
    }
 
-   if (m_xwayland_bridge)
+   /* Call the base's teardown */
+   teardown();
+
+   if (m_readback_pool != VK_NULL_HANDLE)
    {
-      m_xwayland_bridge->stop_stream(m_window);
+      m_device_data.disp.DestroyCommandPool(m_device, m_readback_pool, get_allocation_callbacks());
+      m_readback_pool = VK_NULL_HANDLE;
    }
 
-   /* Call the base's teardown */
-   teardown();
+   if (m_present_special_event != nullptr)
+   {
+      xcb_present_select_input(m_connection, m_present_event_id, m_window, XCB_PRESENT_EVENT_MASK_NO_EVENT);
+      xcb_unregister_for_special_event(m_connection, m_present_special_event);
+      m_present_special_event = nullptr;
+   }
+
+   if (m_private_connection != nullptr)
+   {
+      /* The presenter still sends requests from its destructor, so it has to go before the connection. */
+      m_shm_presenter.reset();
+      xcb_disconnect(m_private_connection);
+      m_private_connection = nullptr;
+   }
+}
+
+bool swapchain::open_private_connection()
+{
+   if (!env_var_is_enabled(std::getenv("WSI_X11_PRIVATE_CONNECTION")))
+   {
+      return false;
+   }
+
+   xcb_connection_t *connection = xcb_connect(nullptr, nullptr);
+   if (xcb_connection_has_error(connection))
+   {
+      WSI_LOG_WARNING("WSI_X11_PRIVATE_CONNECTION: cannot connect to the display, using the application's connection.");
+      xcb_disconnect(connection);
+      return false;
+   }
+
+   /* The default display must be the one the application's window lives on. */
+   auto *geom = xcb_get_geometry_reply(connection, xcb_get_geometry(connection, m_window), nullptr);
+   if (geom == nullptr)
+   {
+      WSI_LOG_WARNING("WSI_X11_PRIVATE_CONNECTION: window 0x%x is not on the default display, using the "
+                      "application's connection.",
+                      m_window);
+      xcb_disconnect(connection);
+      return false;
+   }
+   free(geom);
+
+   m_private_connection = connection;
+   m_connection = connection;
+   WSI_LOG_INFO("X11 swapchain: presenting to window 0x%x on a private connection", m_window);
+   return true;
 }
 
 VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info,
@@ -207,6 +306,9 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   /* Everything below creates its server resources and selects its events on m_connection. */
+   open_private_connection();
+
    WSIALLOC_ASSERT_VERSION();
    if (wsialloc_new(&m_wsi_allocator) != WSIALLOC_ERROR_NONE)
    {
@@ -216,7 +318,7 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
 
    m_xwayland_bridge = xwayland_dmabuf_bridge_client::create_from_environment();
    const bool bridge_requested = (m_xwayland_bridge != nullptr) && m_xwayland_bridge->is_enabled();
-   const bool bridge_runtime_disabled = g_disable_xwayland_bridge_runtime.load(std::memory_order_acquire);
+   const bool bridge_runtime_disabled = bridge_requested && is_xwayland_bridge_disabled_for_window(m_window);
    m_use_xwayland_bridge = bridge_requested && !bridge_runtime_disabled;
 
    const bool allow_non_fifo_mode = allow_non_fifo_present_mode();
@@ -244,6 +346,28 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
 
       WSI_LOG_INFO("XWL_DMABUF_BRIDGE detected: using Xwayland dmabuf bridge presentation path");
       init_bridge_present_rate_limit();
+
+      m_xwayland_bridge->set_feedback_callback([this](uint32_t frame_id, bool displayed, uint64_t frame_time_ns) {
+         std::lock_guard<std::mutex> lock(m_thread_status_lock);
+         if (displayed && m_bridge_adaptive_pacing)
+         {
+            update_bridge_frame_timing(frame_time_ns);
+         }
+         /* Xwayland could not import even the first AFBC frame; a recreated swapchain will be uncompressed. */
+         if (!displayed && !m_bridge_frame_displayed &&
+             util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier))
+         {
+            util::disable_afbc("Xwayland rejected an AFBC frame");
+            set_suboptimal();
+         }
+         m_bridge_frame_displayed = m_bridge_frame_displayed || displayed;
+         release_bridge_images(frame_id, displayed);
+         m_thread_status_cond.notify_all();
+      });
+   }
+   else if (init_dri3_presentation())
+   {
+      m_use_dri3 = true;
    }
    else
    {
@@ -263,12 +387,61 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
             return VK_ERROR_INITIALIZATION_FAILED;
          }
 
-         VkResult init_result = m_shm_presenter->init(m_connection, m_window, m_wsi_surface);
+         /* Set up for FIFO when presents may switch to it; MAILBOX frames then skip the put thread. */
+         const VkPresentModeKHR shm_present_mode =
+            is_present_mode_allowed(VK_PRESENT_MODE_FIFO_KHR) ? VK_PRESENT_MODE_FIFO_KHR : m_present_mode;
+         VkResult init_result = m_shm_presenter->init(
+            m_connection, m_window, m_wsi_surface, shm_present_mode,
+            static_cast<uint64_t>(reinterpret_cast<uintptr_t>(static_cast<wsi::swapchain_base *>(this))),
+            get_frame_timing());
          if (init_result != VK_SUCCESS)
          {
             WSI_LOG_ERROR("Failed to initialize SHM presenter");
             return init_result;
          }
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+         auto *timing = get_swapchain_extension<wsi_ext_present_timing_x11>();
+         if (timing != nullptr)
+         {
+            m_shm_presenter->set_presented_callback([timing](uint64_t present_id, uint64_t time_ns, uint64_t msc) {
+               if (time_ns == 0)
+               {
+                  timing->report_presented(present_id, 0, 0);
+                  return;
+               }
+               if (msc != 0)
+               {
+                  /* The vblank after the put, when the window contents start to scan out. */
+                  timing->report_vblank(time_ns, msc);
+                  timing->report_presented(present_id,
+                                           VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT |
+                                              VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT,
+                                           time_ns);
+               }
+               else
+               {
+                  timing->report_presented(present_id, VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT, time_ns);
+               }
+            });
+         }
+#endif
+
+         m_shm_host_import = init_shm_host_import();
+         m_shm_gpu_readback = init_shm_gpu_readback();
+         const char *downscale_env = std::getenv("WSI_SHM_GPU_DOWNSCALE");
+         m_shm_gpu_downscale = m_shm_gpu_readback &&
+                               !(downscale_env != nullptr && downscale_env[0] == '0' && downscale_env[1] == '\0');
+
+         if (frame_dumper::is_enabled())
+         {
+            m_frame_dumper = std::make_unique<frame_dumper>(m_device_data, get_allocation_callbacks());
+            if (m_frame_dumper->init(
+                   static_cast<uint64_t>(reinterpret_cast<uintptr_t>(static_cast<wsi::swapchain_base *>(this))),
+                   swapchain_create_info->imageFormat, swapchain_create_info->imageExtent) != VK_SUCCESS)
+            {
+               m_frame_dumper.reset();
+            }
+         }
       }
       catch (const std::exception &e)
       {
@@ -290,12 +463,30 @@ VkResult swapchain::init_platform(VkDevice device, const VkSwapchainCreateInfoKH
       return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   /* A swapchain that may switch to MAILBOX starts the thread up front, so the switch reallocates nothing. */
+   if (m_shm_presenter && is_present_mode_allowed(VK_PRESENT_MODE_MAILBOX_KHR))
+   {
+      m_shm_mailbox_run = true;
+      try
+      {
+         m_shm_mailbox_thread = std::thread(&swapchain::shm_mailbox_thread, this);
+      }
+      catch (const std::system_error &)
+      {
+         m_shm_mailbox_run = false;
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+      WSI_LOG_INFO("SHM presenter: MAILBOX, copying only the newest frame each display interval.");
+   }
+
    /*
     * When VK_PRESENT_MODE_MAILBOX_KHR has been chosen by the application we don't
     * initialize the page flip thread so the present_image function can be called
-    * during vkQueuePresent.
+    * during vkQueuePresent. A swapchain that may switch to FIFO keeps the thread,
+    * which hands MAILBOX presents on without waiting.
     */
-   use_presentation_thread = (m_present_mode != VK_PRESENT_MODE_MAILBOX_KHR);
+   use_presentation_thread = (m_present_mode != VK_PRESENT_MODE_MAILBOX_KHR) ||
+                             is_present_mode_allowed(VK_PRESENT_MODE_FIFO_KHR);
 
    return VK_SUCCESS;
 }
@@ -307,6 +498,15 @@ void swapchain::init_bridge_present_rate_limit()
    bool has_env_override = false;
    uint32_t fps = 0;
 
+   m_bridge_adaptive_pacing = env_var_is_enabled(std::getenv("XWL_DMABUF_BRIDGE_ADAPTIVE_PACING"));
+   if (m_bridge_adaptive_pacing)
+   {
+      /* Seeds the estimate; feedback timestamps refine it. */
+      const double refresh_rate = m_wsi_surface->get_refresh_rate();
+      m_bridge_frame_interval_ns = refresh_rate > 0.0 ? static_cast<uint64_t>(1e9 / refresh_rate) : 0;
+      WSI_LOG_INFO("Xwayland bridge: adaptive pacing enabled, refresh estimate %.2f Hz", refresh_rate);
+   }
+
    const char *fps_env = std::getenv("XWL_DMABUF_BRIDGE_MAX_FPS");
    if (fps_env && fps_env[0] != '\0')
    {
@@ -362,9 +562,115 @@ void swapchain::init_bridge_present_rate_limit()
    }
 }
 
+void swapchain::release_bridge_images(uint32_t frame_id, bool displayed)
+{
+   /* Frames sent before the acknowledged one have been replaced on screen. */
+   while (m_bridge_pending_unpresent.size() != 0)
+   {
+      const bridge_pending_image pending = *m_bridge_pending_unpresent.front();
+      const int32_t age = static_cast<int32_t>(frame_id - pending.frame_id);
+      if (age < 0 || (age == 0 && displayed))
+      {
+         break;
+      }
+      m_bridge_pending_unpresent.pop_front();
+      unpresent_image(pending.image_index);
+   }
+}
+
+void swapchain::update_bridge_frame_timing(uint64_t frame_time_ns)
+{
+   constexpr uint64_t min_interval_ns = 1000000000ull / 240;
+   constexpr uint64_t max_interval_ns = 1000000000ull / 20;
+
+   if (m_bridge_last_frame_time_ns != 0 && frame_time_ns > m_bridge_last_frame_time_ns)
+   {
+      const uint64_t delta_ns = frame_time_ns - m_bridge_last_frame_time_ns;
+      if (m_bridge_frame_interval_ns == 0)
+      {
+         m_bridge_frame_interval_ns = delta_ns;
+      }
+      else
+      {
+         /* Frames the application did not render in time leave gaps of whole intervals. */
+         const uint64_t frames = std::max<uint64_t>(1, (delta_ns + m_bridge_frame_interval_ns / 2) /
+                                                           m_bridge_frame_interval_ns);
+         const int64_t error_ns = static_cast<int64_t>(delta_ns / frames) -
+                                  static_cast<int64_t>(m_bridge_frame_interval_ns);
+         m_bridge_frame_interval_ns = static_cast<uint64_t>(static_cast<int64_t>(m_bridge_frame_interval_ns) +
+                                                            error_ns / 8);
+      }
+      m_bridge_frame_interval_ns = std::min(std::max(m_bridge_frame_interval_ns, min_interval_ns), max_interval_ns);
+   }
+   m_bridge_last_frame_time_ns = frame_time_ns;
+}
+
+bool swapchain::wait_for_bridge_frame_deadline()
+{
+   uint64_t last_frame_ns = 0;
+   uint64_t interval_ns = 0;
+   {
+      std::lock_guard<std::mutex> lock(m_thread_status_lock);
+      last_frame_ns = m_bridge_last_frame_time_ns;
+      interval_ns = m_bridge_frame_interval_ns;
+   }
+   if (last_frame_ns == 0 || interval_ns == 0)
+   {
+      return false;
+   }
+
+   const uint64_t now_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+         .count());
+
+   /* The frame just sent reaches the first frame callback after now. */
+   uint64_t target_ns = last_frame_ns + interval_ns;
+   if (now_ns >= last_frame_ns)
+   {
+      target_ns = last_frame_ns + ((now_ns - last_frame_ns) / interval_ns + 1) * interval_ns;
+   }
+
+   /* Whole compositor frames per present, so XWL_DMABUF_BRIDGE_MAX_FPS still caps the rate. */
+   uint64_t frames_per_present = 1;
+   if (m_bridge_present_interval_ns > interval_ns)
+   {
+      frames_per_present = (m_bridge_present_interval_ns + interval_ns - interval_ns / 8) / interval_ns;
+   }
+
+   /* Two frames aimed at the same callback would replace one another. */
+   if (m_bridge_target_frame_time_ns != 0)
+   {
+      const uint64_t earliest_ns = m_bridge_target_frame_time_ns + frames_per_present * interval_ns - interval_ns / 2;
+      while (target_ns < earliest_ns)
+      {
+         target_ns += interval_ns;
+      }
+   }
+   m_bridge_target_frame_time_ns = target_ns;
+
+   /* Release the next frame a quarter frame before the callback after it, close enough to keep latency low and
+    * far enough to absorb wakeup jitter. */
+   const uint64_t release_ns = target_ns + frames_per_present * interval_ns - interval_ns / 4;
+   if (release_ns > now_ns)
+   {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(release_ns - now_ns));
+   }
+   return true;
+}
+
 void swapchain::throttle_bridge_present_if_needed()
 {
-   if (!m_use_xwayland_bridge || m_bridge_present_interval_ns == 0)
+   if (!m_use_xwayland_bridge)
+   {
+      return;
+   }
+
+   if (m_bridge_adaptive_pacing && wait_for_bridge_frame_deadline())
+   {
+      return;
+   }
+
+   if (m_bridge_present_interval_ns == 0)
    {
       return;
    }
@@ -387,174 +693,511 @@ void swapchain::throttle_bridge_present_if_needed()
    m_bridge_next_present_time = after_wait + interval;
 }
 
-VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info,
-                                                   util::vector<wsialloc_format> &importable_formats,
-                                                   util::vector<uint64_t> &exportable_modifers,
-                                                   util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props,
-                                                   bool require_drm_display_support)
+bool swapchain::init_dri3_presentation()
 {
-   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
-           "Failed to get format properties");
+   const char *env = std::getenv("WSI_X11_DRI3");
+   if ((env != nullptr && env[0] == '0' && env[1] == '\0') ||
+       g_disable_dri3_runtime.load(std::memory_order_acquire))
+   {
+      return false;
+   }
+   const bool forced = env_var_is_enabled(env);
+
+   /* Xwayland's DRI3 goes through its own import path; keep it on the bridge or SHM unless asked for. */
+   const char xwayland_name[] = "XWAYLAND";
+   xcb_query_extension_reply_t *xwayland = xcb_query_extension_reply(
+      m_connection, xcb_query_extension(m_connection, sizeof(xwayland_name) - 1, xwayland_name), nullptr);
+   const bool is_xwayland = xwayland != nullptr && xwayland->present;
+   free(xwayland);
+   if (is_xwayland && !forced)
+   {
+      return false;
+   }
 
-   std::optional<drm_display> *display = nullptr;
-   if (require_drm_display_support)
+   const xcb_query_extension_reply_t *dri3_ext = xcb_get_extension_data(m_connection, &xcb_dri3_id);
+   const xcb_query_extension_reply_t *present_ext = xcb_get_extension_data(m_connection, &xcb_present_id);
+   if (dri3_ext == nullptr || !dri3_ext->present || present_ext == nullptr || !present_ext->present)
    {
-      auto &display_ref = drm_display::get_display();
-      if (!display_ref.has_value())
-      {
-         WSI_LOG_ERROR("DRM display not available.");
-         return VK_ERROR_OUT_OF_HOST_MEMORY;
-      }
-      display = &display_ref;
+      WSI_LOG_INFO("DRI3 presentation unavailable: X server lacks DRI3 or Present.");
+      return false;
    }
 
-   for (const auto &prop : drm_format_props)
+   /* Multi-plane buffers with modifiers need DRI3 1.2. */
+   xcb_dri3_query_version_reply_t *dri3_version =
+      xcb_dri3_query_version_reply(m_connection, xcb_dri3_query_version(m_connection, 1, 2), nullptr);
+   const bool dri3_ok = dri3_version != nullptr &&
+                        (dri3_version->major_version > 1 ||
+                         (dri3_version->major_version == 1 && dri3_version->minor_version >= 2));
+   free(dri3_version);
+
+   xcb_present_query_version_reply_t *present_version =
+      xcb_present_query_version_reply(m_connection, xcb_present_query_version(m_connection, 1, 0), nullptr);
+   const bool present_ok = present_version != nullptr;
+   free(present_version);
+
+   if (!dri3_ok || !present_ok)
    {
-      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
+      WSI_LOG_INFO("DRI3 presentation unavailable: DRI3 1.2 and Present are required.");
+      return false;
+   }
 
-      if (require_drm_display_support && !display->value().is_format_supported(drm_format))
-      {
-         continue;
-      }
+   uint32_t width = 0;
+   uint32_t height = 0;
+   if (!m_wsi_surface->get_size_and_depth(&width, &height, &m_dri3_depth))
+   {
+      WSI_LOG_WARNING("Could not get surface depth for DRI3, using default: %d", m_dri3_depth);
+   }
+
+   m_present_event_id = xcb_generate_id(m_connection);
+   m_present_special_event =
+      xcb_register_for_special_xge(m_connection, &xcb_present_id, m_present_event_id, nullptr);
+   if (m_present_special_event == nullptr)
+   {
+      return false;
+   }
+   xcb_present_select_input(m_connection, m_present_event_id, m_window,
+                            XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY | XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY);
+   xcb_flush(m_connection);
+
+   WSI_LOG_INFO("Using DRI3/Present presentation path (depth=%d).", m_dri3_depth);
+   return true;
+}
+
+VkResult swapchain::create_dri3_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   auto image_data = static_cast<x11_image_data *>(image.data);
 
-      VkExternalImageFormatPropertiesKHR external_props = {};
-      external_props.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES_KHR;
-
-      VkImageFormatProperties2KHR format_props = {};
-      format_props.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2_KHR;
-      format_props.pNext = &external_props;
-
-      VkResult result = VK_SUCCESS;
-      {
-         VkPhysicalDeviceExternalImageFormatInfoKHR external_info = {};
-         external_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO_KHR;
-         external_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT;
-
-         VkPhysicalDeviceImageDrmFormatModifierInfoEXT drm_mod_info = {};
-         drm_mod_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT;
-         drm_mod_info.pNext = &external_info;
-         drm_mod_info.drmFormatModifier = prop.drmFormatModifier;
-         drm_mod_info.sharingMode = info.sharingMode;
-         drm_mod_info.queueFamilyIndexCount = info.queueFamilyIndexCount;
-         drm_mod_info.pQueueFamilyIndices = info.pQueueFamilyIndices;
-
-         VkPhysicalDeviceImageFormatInfo2KHR image_info = {};
-         image_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2_KHR;
-         image_info.pNext = &drm_mod_info;
-         image_info.format = info.format;
-         image_info.type = info.imageType;
-         image_info.tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT;
-         image_info.usage = info.usage;
-         image_info.flags = info.flags;
-
-#if WSI_IMAGE_COMPRESSION_CONTROL_SWAPCHAIN
-         VkImageCompressionControlEXT compression_control = {};
-         compression_control.sType = VK_STRUCTURE_TYPE_IMAGE_COMPRESSION_CONTROL_EXT;
-         compression_control.flags = m_image_compression_control_params.flags;
-         compression_control.compressionControlPlaneCount =
-            m_image_compression_control_params.compression_control_plane_count;
-         compression_control.pFixedRateFlags = m_image_compression_control_params.fixed_rate_flags.data();
-
-         if (m_device_data.is_swapchain_compression_control_enabled())
+   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      util::vector<uint64_t> exportable_modifiers(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+      TRY_LOG_CALL(get_surface_compatible_formats(image_create_info, importable_formats, exportable_modifiers,
+                                                  drm_format_props, false));
+
+      /* Keep the modifiers the X server can scan out or composite for this window. Linear is always
+       * understood, so it survives even when the server does not list it. */
+      xcb_dri3_get_supported_modifiers_reply_t *modifiers_reply = xcb_dri3_get_supported_modifiers_reply(
+         m_connection,
+         xcb_dri3_get_supported_modifiers(m_connection, m_window, static_cast<uint8_t>(m_dri3_depth), 32), nullptr);
+
+      util::vector<wsialloc_format> server_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      for (const auto &fmt : importable_formats)
+      {
+         bool supported = fmt.modifier == DRM_FORMAT_MOD_LINEAR;
+         if (modifiers_reply != nullptr)
          {
-            compression_control.pNext = image_info.pNext;
-            image_info.pNext = &compression_control;
+            const uint64_t *window_mods = xcb_dri3_get_supported_modifiers_window_modifiers(modifiers_reply);
+            const uint64_t *screen_mods = xcb_dri3_get_supported_modifiers_screen_modifiers(modifiers_reply);
+            supported = supported ||
+                        std::find(window_mods, window_mods + modifiers_reply->num_window_modifiers, fmt.modifier) !=
+                           window_mods + modifiers_reply->num_window_modifiers ||
+                        std::find(screen_mods, screen_mods + modifiers_reply->num_screen_modifiers, fmt.modifier) !=
+                           screen_mods + modifiers_reply->num_screen_modifiers;
+         }
+         if (supported && !server_formats.try_push_back(fmt))
+         {
+            free(modifiers_reply);
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
          }
-#endif
-         result = m_device_data.instance_data.disp.GetPhysicalDeviceImageFormatProperties2KHR(
-            m_device_data.physical_device, &image_info, &format_props);
-      }
-      if (result != VK_SUCCESS)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxExtent.width < info.extent.width ||
-          format_props.imageFormatProperties.maxExtent.height < info.extent.height ||
-          format_props.imageFormatProperties.maxExtent.depth < info.extent.depth)
-      {
-         continue;
-      }
-      if (format_props.imageFormatProperties.maxMipLevels < info.mipLevels ||
-          format_props.imageFormatProperties.maxArrayLayers < info.arrayLayers)
-      {
-         continue;
       }
-      if ((format_props.imageFormatProperties.sampleCounts & info.samples) != info.samples)
+      free(modifiers_reply);
+
+      if (server_formats.empty())
       {
-         continue;
+         WSI_LOG_ERROR("DRI3: no dma-buf modifier shared by the device and the X server.");
+         g_disable_dri3_runtime.store(true, std::memory_order_release);
+         return VK_ERROR_INITIALIZATION_FAILED;
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      wsialloc_format allocated_format = { 0, 0, 0 };
+      TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, server_formats, &allocated_format, true));
+      WSI_LOG_INFO("DRI3: selected dma-buf fourcc=0x%x modifier=0x%llx", allocated_format.fourcc,
+                   static_cast<unsigned long long>(allocated_format.modifier));
+
+      for (auto &prop : drm_format_props)
       {
-         if (!exportable_modifers.try_push_back(drm_format.modifier))
+         if (prop.drmFormatModifier == allocated_format.modifier)
          {
-            return VK_ERROR_OUT_OF_HOST_MEMORY;
+            image_data->external_mem.set_num_memories(prop.drmFormatModifierPlaneCount);
          }
       }
 
-      if (external_props.externalMemoryProperties.externalMemoryFeatures &
-          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      TRY_LOG_CALL(fill_image_create_info(
+         image_create_info, m_image_creation_parameters.m_image_layout, m_image_creation_parameters.m_drm_mod_info,
+         m_image_creation_parameters.m_external_info, *image_data, allocated_format.modifier));
+
+      m_image_create_info = image_create_info;
+      m_image_creation_parameters.m_allocated_format = allocated_format;
+   }
+
+   return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+}
+
+VkResult swapchain::create_dri3_pixmap(x11_image_data *image_data)
+{
+   auto &external_mem = image_data->external_mem;
+   const auto &fds = external_mem.get_buffer_fds();
+   const auto &strides = external_mem.get_strides();
+   const auto &offsets = external_mem.get_offsets();
+   const uint32_t num_planes = external_mem.get_num_planes();
+
+   /* xcb takes ownership of the descriptors it sends. */
+   int32_t plane_fds[MAX_PLANES] = { -1, -1, -1, -1 };
+   for (uint32_t plane = 0; plane < num_planes; ++plane)
+   {
+      plane_fds[plane] = fcntl(fds[plane], F_DUPFD_CLOEXEC, 0);
+      if (plane_fds[plane] < 0)
       {
-         uint64_t flags =
-            (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
-         wsialloc_format import_format{ drm_format.fourcc, drm_format.modifier, flags };
-         if (!importable_formats.try_push_back(import_format))
+         for (uint32_t i = 0; i < plane; ++i)
          {
-            return VK_ERROR_OUT_OF_HOST_MEMORY;
+            close(plane_fds[i]);
          }
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+   const xcb_pixmap_t pixmap = xcb_generate_id(m_connection);
+   xcb_void_cookie_t cookie = xcb_dri3_pixmap_from_buffers_checked(
+      m_connection, pixmap, m_window, static_cast<uint8_t>(num_planes), static_cast<uint16_t>(image_data->width),
+      static_cast<uint16_t>(image_data->height), strides[0], offsets[0], strides[1], offsets[1], strides[2],
+      offsets[2], strides[3], offsets[3], static_cast<uint8_t>(m_dri3_depth), 32,
+      m_image_creation_parameters.m_allocated_format.modifier, plane_fds);
+
+   xcb_generic_error_t *error = xcb_request_check(m_connection, cookie);
+   if (error != nullptr)
+   {
+      const bool afbc = util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier);
+      WSI_LOG_ERROR("DRI3: X server rejected the dma-buf (error=%u).%s", static_cast<unsigned>(error->error_code),
+                    afbc ? "" : " Later swapchains will use SHM.");
+      free(error);
+      /* A rejected AFBC buffer says nothing about uncompressed ones, so only AFBC is turned off. */
+      if (afbc)
+      {
+         util::disable_afbc("the X server rejected an AFBC pixmap");
+      }
+      else
+      {
+         g_disable_dri3_runtime.store(true, std::memory_order_release);
       }
+      return VK_ERROR_INITIALIZATION_FAILED;
    }
 
+   image_data->pixmap = pixmap;
    return VK_SUCCESS;
 }
 
-VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_image_data *image_data,
-                                      util::vector<wsialloc_format> &importable_formats,
-                                      wsialloc_format *allocated_format, bool avoid_allocation)
+VkResult swapchain::present_dri3_image(std::unique_lock<std::mutex> &thread_status_lock, x11_image_data *image_data,
+                                       uint32_t serial, uint64_t present_id, uint64_t target_ns,
+                                       VkPresentModeKHR present_mode, uint64_t queued_ns)
 {
-   bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
-   uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
-   if (avoid_allocation)
-   {
-      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
-   }
+   uint32_t options = XCB_PRESENT_OPTION_NONE;
+   uint64_t target_msc = 0;
 
-#if WSI_IMAGE_COMPRESSION_CONTROL_SWAPCHAIN
-   if (m_image_compression_control_params.flags & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT)
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *timing = get_swapchain_extension<wsi_ext_present_timing_x11>();
+   if (timing != nullptr && target_ns != 0)
    {
-      allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
+      target_msc = timing->get_target_msc(target_ns);
    }
+#else
+   UNUSED(target_ns);
 #endif
 
-   wsialloc_allocate_info alloc_info = { importable_formats.data(), static_cast<unsigned>(importable_formats.size()),
-                                         image_create_info.extent.width, image_create_info.extent.height,
-                                         allocation_flags };
-
-   wsialloc_allocate_result alloc_result = { {}, { 0 }, { 0 }, { -1 }, false };
-   /* Clear buffer_fds and average_row_strides for error purposes */
-   for (int i = 0; i < WSIALLOC_MAX_PLANES; ++i)
+   if (present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
    {
-      alloc_result.buffer_fds[i] = -1;
-      alloc_result.average_row_strides[i] = -1;
+      options |= XCB_PRESENT_OPTION_ASYNC;
    }
-   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
-   if (res != WSIALLOC_ERROR_NONE)
+   else if (present_mode == VK_PRESENT_MODE_FIFO_KHR || present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
    {
-      WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
-      if (res == WSIALLOC_ERROR_NOT_SUPPORTED)
+      /* One present in flight, each aimed at the vblank after the last one shown: real FIFO pacing
+       * without queueing several targets that are already in the past. */
+      for (;;)
       {
-         return VK_ERROR_FORMAT_NOT_SUPPORTED;
+         bool in_flight = false;
+         for (auto &image : m_swapchain_images)
+         {
+            auto data = reinterpret_cast<x11_image_data *>(image.data);
+            if (data != nullptr && !data->pending_completions.empty())
+            {
+               in_flight = true;
+               break;
+            }
+         }
+         if (!in_flight)
+         {
+            break;
+         }
+         if (!m_present_event_thread_run)
+         {
+            return VK_ERROR_SURFACE_LOST_KHR;
+         }
+         m_thread_status_cond.wait(thread_status_lock);
       }
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+      m_target_msc = std::max(m_last_complete_msc + 1, target_msc);
+      target_msc = m_target_msc;
    }
-   *allocated_format = alloc_result.format;
-   auto &external_memory = image_data->external_mem;
-   external_memory.set_strides(alloc_result.average_row_strides);
-   external_memory.set_buffer_fds(alloc_result.buffer_fds);
-   external_memory.set_offsets(alloc_result.offsets);
 
-   uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
+   xcb_present_pixmap(m_connection, m_window, image_data->pixmap, serial, XCB_NONE, XCB_NONE, 0, 0, XCB_NONE,
+                      XCB_NONE, XCB_NONE, options, target_msc, 0, 0, 0, nullptr);
+   if (xcb_flush(m_connection) <= 0)
+   {
+      return VK_ERROR_SURFACE_LOST_KHR;
+   }
+
+   /* present_image() waited for a free slot. */
+   const bool tracked =
+      image_data->pending_completions.try_push_back(pending_completion{ serial, present_id, std::nullopt, queued_ns });
+   assert(tracked);
+   (void)tracked;
+   image_data->dri3_busy = true;
+   return VK_SUCCESS;
+}
+
+void swapchain::handle_present_event(const xcb_present_generic_event_t *event)
+{
+   switch (event->evtype)
+   {
+   case XCB_PRESENT_EVENT_COMPLETE_NOTIFY:
+   {
+      auto complete = reinterpret_cast<const xcb_present_complete_notify_event_t *>(event);
+      if (complete->kind != XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+      {
+         break;
+      }
+
+      m_last_complete_msc = complete->msc;
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+      auto *timing = get_swapchain_extension<wsi_ext_present_timing_x11>();
+      if (timing != nullptr)
+      {
+         /* UST is CLOCK_MONOTONIC in microseconds. A flip is latched and scanned out from the vblank; a copy
+          * lands in the window at it. Skipped presents were never shown. */
+         const uint64_t ust_ns = complete->ust * 1000;
+         VkPresentStageFlagsEXT stages = 0;
+         if (complete->mode == XCB_PRESENT_COMPLETE_MODE_FLIP)
+         {
+            stages = VK_PRESENT_STAGE_IMAGE_LATCHED_BIT_EXT | VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+         }
+         else if (complete->mode == XCB_PRESENT_COMPLETE_MODE_COPY ||
+                  complete->mode == XCB_PRESENT_COMPLETE_MODE_SUBOPTIMAL_COPY)
+         {
+            stages = VK_PRESENT_STAGE_IMAGE_FIRST_PIXEL_OUT_BIT_EXT;
+         }
+         if (stages != 0)
+         {
+            timing->report_vblank(ust_ns, complete->msc);
+         }
+         for (auto &image : m_swapchain_images)
+         {
+            auto data = reinterpret_cast<x11_image_data *>(image.data);
+            if (data == nullptr)
+            {
+               continue;
+            }
+            for (const auto &pending : data->pending_completions)
+            {
+               if (pending.serial == complete->serial)
+               {
+                  timing->report_presented(pending.present_id, stages, stages != 0 ? ust_ns : 0);
+               }
+            }
+         }
+      }
+#endif
+      /* UST is CLOCK_MONOTONIC in microseconds; skipped presents never reached the display. */
+      const bool displayed = complete->mode != XCB_PRESENT_COMPLETE_MODE_SKIP;
+      for (auto &image : m_swapchain_images)
+      {
+         auto data = reinterpret_cast<x11_image_data *>(image.data);
+         if (data == nullptr)
+         {
+            continue;
+         }
+         auto &completions = data->pending_completions;
+         if (displayed)
+         {
+            for (const auto &pending : completions)
+            {
+               if (pending.serial == complete->serial)
+               {
+                  record_display_latency(pending.queued_ns, complete->ust * 1000);
+               }
+            }
+         }
+         completions.erase(std::remove_if(completions.begin(), completions.end(),
+                                          [complete](const pending_completion &pending) {
+                                             return pending.serial == complete->serial;
+                                          }),
+                           completions.end());
+      }
+      break;
+   }
+   case XCB_PRESENT_EVENT_IDLE_NOTIFY:
+   {
+      auto idle = reinterpret_cast<const xcb_present_idle_notify_event_t *>(event);
+      for (size_t i = 0; i < m_swapchain_images.size(); ++i)
+      {
+         auto data = reinterpret_cast<x11_image_data *>(m_swapchain_images[i].data);
+         if (data != nullptr && data->pixmap == idle->pixmap && data->dri3_busy)
+         {
+            data->dri3_busy = false;
+            /* Normally released by the next free_image_found(); release it here if the pool is full. */
+            if (!m_free_buffer_pool.push_back(idle->pixmap))
+            {
+               unpresent_image(static_cast<uint32_t>(i));
+            }
+         }
+      }
+      break;
+   }
+   default:
+      break;
+   }
+
+   m_thread_status_cond.notify_all();
+}
+
+VkResult swapchain::get_surface_compatible_formats(const VkImageCreateInfo &info,
+                                                   util::vector<wsialloc_format> &importable_formats,
+                                                   util::vector<uint64_t> &exportable_modifers,
+                                                   util::vector<VkDrmFormatModifierPropertiesEXT> &drm_format_props,
+                                                   bool require_drm_display_support)
+{
+   TRY_LOG(util::get_drm_format_properties(m_device_data.physical_device, info.format, drm_format_props),
+           "Failed to get format properties");
+
+   std::optional<display::drm_display> *display = nullptr;
+   if (require_drm_display_support)
+   {
+      auto &display_ref = display::drm_display::get_display();
+      if (!display_ref.has_value())
+      {
+         WSI_LOG_ERROR("DRM display not available.");
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+      display = &display_ref;
+   }
+
+   for (const auto &prop : drm_format_props)
+   {
+      drm_format_pair drm_format{ util::drm::vk_to_drm_format(info.format), prop.drmFormatModifier };
+
+      if (require_drm_display_support && !display->value().is_format_supported(drm_format))
+      {
+         continue;
+      }
+
+      const VkImageCompressionControlEXT *compression_control = nullptr;
+      VkImageCompressionControlEXT compression_properties = {};
+      if (m_device_data.is_swapchain_compression_control_enabled())
+      {
+         auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+         if (ext)
+         {
+            compression_properties = ext->get_compression_control_properties();
+            compression_control = &compression_properties;
+         }
+      }
+
+      const util::drm_modifier_image_support support = util::get_drm_modifier_image_support(
+         m_device_data.physical_device, info, prop.drmFormatModifier, compression_control);
+      if (!support.supported)
+      {
+         continue;
+      }
+      if (support.image_format_properties.maxExtent.width < info.extent.width ||
+          support.image_format_properties.maxExtent.height < info.extent.height ||
+          support.image_format_properties.maxExtent.depth < info.extent.depth)
+      {
+         continue;
+      }
+      if (support.image_format_properties.maxMipLevels < info.mipLevels ||
+          support.image_format_properties.maxArrayLayers < info.arrayLayers)
+      {
+         continue;
+      }
+      if ((support.image_format_properties.sampleCounts & info.samples) != info.samples)
+      {
+         continue;
+      }
+
+      if (support.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT_KHR)
+      {
+         if (!exportable_modifers.try_push_back(drm_format.modifier))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+
+      if (support.external_memory_features & VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT_KHR)
+      {
+         uint64_t flags =
+            (prop.drmFormatModifierTilingFeatures & VK_FORMAT_FEATURE_DISJOINT_BIT) ? 0 : WSIALLOC_FORMAT_NON_DISJOINT;
+         wsialloc_format import_format{ drm_format.fourcc, drm_format.modifier, flags };
+         if (!importable_formats.try_push_back(import_format))
+         {
+            return VK_ERROR_OUT_OF_HOST_MEMORY;
+         }
+      }
+   }
+
+   util::save_drm_modifier_image_support(m_device_data.physical_device);
+   util::apply_afbc_policy(importable_formats, is_compression_allowed());
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_image_data *image_data,
+                                      util::vector<wsialloc_format> &importable_formats,
+                                      wsialloc_format *allocated_format, bool avoid_allocation)
+{
+   bool is_protected_memory = (image_create_info.flags & VK_IMAGE_CREATE_PROTECTED_BIT) != 0;
+   uint64_t allocation_flags = is_protected_memory ? WSIALLOC_ALLOCATE_PROTECTED : 0;
+   if (avoid_allocation)
+   {
+      allocation_flags |= WSIALLOC_ALLOCATE_NO_MEMORY;
+   }
+
+   if (m_device_data.is_swapchain_compression_control_enabled())
+   {
+      auto *ext = get_swapchain_extension<wsi_ext_image_compression_control>();
+      if (ext && (ext->get_bitmask_for_image_compression_flags() & VK_IMAGE_COMPRESSION_FIXED_RATE_EXPLICIT_EXT))
+      {
+         allocation_flags |= WSIALLOC_ALLOCATE_HIGHEST_FIXED_RATE_COMPRESSION;
+      }
+   }
+
+   wsialloc_allocate_info alloc_info = { importable_formats.data(), static_cast<unsigned>(importable_formats.size()),
+                                         image_create_info.extent.width, image_create_info.extent.height,
+                                         allocation_flags };
+
+   wsialloc_allocate_result alloc_result = { {}, { 0 }, { 0 }, { -1 }, false };
+   /* Clear buffer_fds and average_row_strides for error purposes */
+   for (int i = 0; i < WSIALLOC_MAX_PLANES; ++i)
+   {
+      alloc_result.buffer_fds[i] = -1;
+      alloc_result.average_row_strides[i] = -1;
+   }
+   const auto res = wsialloc_alloc(m_wsi_allocator, &alloc_info, &alloc_result);
+   if (res != WSIALLOC_ERROR_NONE)
+   {
+      WSI_LOG_ERROR("Failed allocation of DMA Buffer. WSI error: %d", static_cast<int>(res));
+      if (res == WSIALLOC_ERROR_NOT_SUPPORTED)
+      {
+         return VK_ERROR_FORMAT_NOT_SUPPORTED;
+      }
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   *allocated_format = alloc_result.format;
+   auto &external_memory = image_data->external_mem;
+   external_memory.set_strides(alloc_result.average_row_strides);
+   external_memory.set_buffer_fds(alloc_result.buffer_fds);
+   external_memory.set_offsets(alloc_result.offsets);
+
+   uint32_t num_planes = util::drm::drm_fourcc_format_get_num_planes(alloc_result.format.fourcc);
 
    if (!avoid_allocation)
    {
@@ -572,6 +1215,7 @@ VkResult swapchain::allocate_wsialloc(VkImageCreateInfo &image_create_info, x11_
 
       assert(alloc_result.is_disjoint == (num_memory_planes > 1));
       external_memory.set_num_memories(num_memory_planes);
+      external_memory.set_release_to_wsialloc(!is_protected_memory);
    }
 
    external_memory.set_format_info(alloc_result.is_disjoint, num_planes);
@@ -583,12 +1227,13 @@ VkResult swapchain::allocate_image(VkImageCreateInfo &image_create_info, x11_ima
 {
    UNUSED(image_create_info);
    util::vector<wsialloc_format> importable_formats(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-   auto &m_allocated_format = m_image_creation_parameters.m_allocated_format;
-   if (!importable_formats.try_push_back(m_allocated_format))
+   /* The only candidate is the format already chosen, so it is not written back: images may allocate concurrently. */
+   wsialloc_format allocated_format = m_image_creation_parameters.m_allocated_format;
+   if (!importable_formats.try_push_back(allocated_format))
    {
       return VK_ERROR_OUT_OF_HOST_MEMORY;
    }
-   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &m_allocated_format, false));
+   TRY_LOG_CALL(allocate_wsialloc(m_image_create_info, image_data, importable_formats, &allocated_format, false));
 
    return VK_SUCCESS;
 }
@@ -601,16 +1246,23 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    assert(image.data != nullptr);
    auto image_data = static_cast<x11_image_data *>(image.data);
 
-   if (m_use_xwayland_bridge)
+   if (m_use_xwayland_bridge || m_use_dri3)
    {
       image_data->width = image_create_info.extent.width;
       image_data->height = image_create_info.extent.height;
       TRY_LOG(allocate_image(m_image_create_info, image_data), "Failed to allocate image");
-      validate_bridge_plane_sizes_once(*image_data);
+      if (m_use_xwayland_bridge)
+      {
+         validate_bridge_plane_sizes_once(*image_data);
+      }
       image_status_lock.unlock();
 
-      TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
-              "Failed to import memory and bind swapchain image");
+      VkResult result = image_data->external_mem.import_memory_and_bind_swapchain_image(image.image);
+      if (result != VK_SUCCESS && can_retry_without_afbc(image))
+      {
+         return retry_image_without_afbc(image_create_info, image, "the driver could not import an AFBC image");
+      }
+      TRY_LOG(result, "Failed to import memory and bind swapchain image");
 
       /* Initialize presentation fence. */
       auto present_fence = sync_fd_fence_sync::create(m_device_data);
@@ -620,6 +1272,16 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
       }
       image_data->present_fence = std::move(present_fence.value());
 
+      if (m_use_dri3)
+      {
+         result = create_dri3_pixmap(image_data);
+         if (result != VK_SUCCESS && can_retry_without_afbc(image))
+         {
+            return retry_image_without_afbc(image_create_info, image, "the X server rejected an AFBC pixmap");
+         }
+         TRY_LOG_CALL(result);
+      }
+
       return VK_SUCCESS;
    }
 
@@ -632,181 +1294,759 @@ VkResult swapchain::allocate_and_bind_swapchain_image(VkImageCreateInfo image_cr
    uint32_t dummy_w, dummy_h;
    if (!m_wsi_surface->get_size_and_depth(&dummy_w, &dummy_h, &depth))
    {
-      WSI_LOG_WARNING("Could not get surface depth, using default: %d", depth);
+      WSI_LOG_WARNING("Could not get surface depth, using default: %d", depth);
+   }
+
+   /* The first image checks that segments can be made at all. Imported segments are written by the present
+    * payloads recorded below, so they cannot wait. */
+   const bool defer_segments = lazy_image_allocation_enabled() && !m_shm_host_import && !is_only_created_image(image);
+   TRY_LOG(m_shm_presenter->create_image_resources(image_data, width, height, depth, defer_segments),
+           "Failed to create presentation image resources");
+
+   if (m_shm_host_import)
+   {
+      VkResult import_result = create_shm_import(image.image, image_data);
+      if (import_result == VK_SUCCESS)
+      {
+         /* The GPU now writes the segments themselves; the staging copy would be dead weight. */
+         destroy_shm_readback(image_data);
+      }
+      else
+      {
+         WSI_LOG_WARNING("SHM host import unavailable (result=%d), copying frames on the CPU.", import_result);
+         destroy_shm_import(image_data);
+         m_shm_host_import = false;
+      }
+   }
+
+   /* Initialize presentation fence. */
+   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::allocate_swapchain_image_memory(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   assert(m_use_xwayland_bridge || m_use_dri3);
+   {
+      std::lock_guard<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+      image.status = swapchain_image::FREE;
+   }
+
+   assert(image.data != nullptr);
+   auto image_data = static_cast<x11_image_data *>(image.data);
+   image_data->width = image_create_info.extent.width;
+   image_data->height = image_create_info.extent.height;
+   TRY_LOG(allocate_image(m_image_create_info, image_data), "Failed to allocate image");
+   if (m_use_xwayland_bridge)
+   {
+      validate_bridge_plane_sizes_once(*image_data);
+   }
+   TRY_LOG(image_data->external_mem.import_memory_and_bind_swapchain_image(image.image),
+           "Failed to import memory and bind swapchain image");
+
+   auto present_fence = sync_fd_fence_sync::create(m_device_data);
+   if (!present_fence.has_value())
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image_data->present_fence = std::move(present_fence.value());
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::create_swapchain_image_presentable(const VkImageCreateInfo &image_create_info,
+                                                       swapchain_image &image)
+{
+   UNUSED(image_create_info);
+   if (!m_use_dri3)
+   {
+      return VK_SUCCESS;
+   }
+   return create_dri3_pixmap(static_cast<x11_image_data *>(image.data));
+}
+
+bool swapchain::can_retry_without_afbc(const swapchain_image &image) const
+{
+   return util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier) &&
+          is_only_created_image(image);
+}
+
+VkResult swapchain::retry_image_without_afbc(const VkImageCreateInfo &image_create_info, swapchain_image &image,
+                                             const char *reason)
+{
+   util::disable_afbc(reason);
+   destroy_image(image);
+   m_image_create_info.format = VK_FORMAT_UNDEFINED;
+   TRY_LOG_CALL(create_swapchain_image(image_create_info, image));
+   return allocate_and_bind_swapchain_image(image_create_info, image);
+}
+
+VkResult swapchain::create_bridge_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   auto image_data = static_cast<x11_image_data *>(image.data);
+
+   if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+   {
+      util::vector<wsialloc_format> importable_formats(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      util::vector<uint64_t> exportable_modifiers(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+      util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
+         util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+
+      TRY_LOG_CALL(
+         get_surface_compatible_formats(image_create_info, importable_formats, exportable_modifiers, drm_format_props,
+                                        false));
+
+      if (importable_formats.empty())
+      {
+         WSI_LOG_ERROR("No importable dmabuf formats available for Xwayland bridge path.");
+         return VK_ERROR_INITIALIZATION_FAILED;
+      }
+
+      /* wsialloc allocates the first candidate it supports, so the preference is expressed as an order and
+       * the remaining candidates stay available as fallbacks. */
+      const char *prefer_linear_env = std::getenv("XWL_DMABUF_BRIDGE_PREFER_LINEAR");
+      const bool prefer_linear = prefer_linear_env && !(prefer_linear_env[0] == '0' && prefer_linear_env[1] == '\0');
+      const auto is_linear = [](const wsialloc_format &fmt) { return fmt.modifier == DRM_FORMAT_MOD_LINEAR; };
+      const auto preferred_end =
+         std::stable_partition(importable_formats.begin(), importable_formats.end(),
+                               [&](const wsialloc_format &fmt) { return is_linear(fmt) == prefer_linear; });
+      if (preferred_end == importable_formats.begin())
+      {
+         WSI_LOG_WARNING("Xwayland bridge: %s modifiers unavailable, using the remaining candidates.",
+                         prefer_linear ? "DRM_FORMAT_MOD_LINEAR" : "non-linear");
+      }
+
+      WSI_LOG_INFO("Xwayland bridge: importable dmabuf candidates=%zu", importable_formats.size());
+      constexpr size_t max_logged_candidates = 8;
+      for (size_t idx = 0; idx < importable_formats.size() && idx < max_logged_candidates; ++idx)
+      {
+         const auto &candidate = importable_formats[idx];
+         WSI_LOG_INFO("Xwayland bridge: candidate[%zu] fourcc=0x%x modifier=0x%llx", idx, candidate.fourcc,
+                      static_cast<unsigned long long>(candidate.modifier));
+      }
+      if (importable_formats.size() > max_logged_candidates)
+      {
+         WSI_LOG_INFO("Xwayland bridge: ... %zu more candidates not shown",
+                      importable_formats.size() - max_logged_candidates);
+      }
+
+      wsialloc_format allocated_format = { 0, 0, 0 };
+      TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, importable_formats, &allocated_format, true));
+
+      WSI_LOG_INFO("Xwayland bridge: selected dmabuf fourcc=0x%x modifier=0x%llx%s%s",
+                   allocated_format.fourcc, static_cast<unsigned long long>(allocated_format.modifier),
+                   util::is_afbc_modifier(allocated_format.modifier) ? " (AFBC)" : "",
+                   prefer_linear && is_linear(allocated_format) ? " (linear forced)" : "");
+      if (allocated_format.fourcc == DRM_FORMAT_ARGB8888)
+      {
+         WSI_LOG_INFO("Xwayland bridge: presentation fourcc remap enabled 0x%x -> 0x%x",
+                      DRM_FORMAT_ARGB8888, DRM_FORMAT_XRGB8888);
+      }
+      else if (allocated_format.fourcc == DRM_FORMAT_ABGR8888)
+      {
+         WSI_LOG_INFO("Xwayland bridge: presentation fourcc remap enabled 0x%x -> 0x%x",
+                      DRM_FORMAT_ABGR8888, DRM_FORMAT_XBGR8888);
+      }
+
+      for (auto &prop : drm_format_props)
+      {
+         if (prop.drmFormatModifier == allocated_format.modifier)
+         {
+            image_data->external_mem.set_num_memories(prop.drmFormatModifierPlaneCount);
+         }
+      }
+
+      TRY_LOG_CALL(fill_image_create_info(
+         image_create_info, m_image_creation_parameters.m_image_layout, m_image_creation_parameters.m_drm_mod_info,
+         m_image_creation_parameters.m_external_info, *image_data, allocated_format.modifier));
+
+      m_image_create_info = image_create_info;
+      m_image_creation_parameters.m_allocated_format = allocated_format;
+   }
+
+   return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+}
+
+VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+{
+   /* Create image_data */
+   auto image_data = m_allocator.create<x11_image_data>(1, m_device, m_allocator);
+   if (image_data == nullptr)
+   {
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+   image.data = image_data;
+   image_data->device = m_device;
+   image_data->device_data = &m_device_data;
+
+   if (m_use_dri3 || m_use_xwayland_bridge)
+   {
+      const bool select_format = m_image_create_info.format == VK_FORMAT_UNDEFINED;
+      VkResult result = m_use_dri3 ? create_dri3_swapchain_image(image_create_info, image) :
+                                     create_bridge_swapchain_image(image_create_info, image);
+      /* A format was chosen but the driver refused to create the image: try again without AFBC. */
+      if (result != VK_SUCCESS && select_format && m_image_create_info.format != VK_FORMAT_UNDEFINED &&
+          util::is_afbc_modifier(m_image_creation_parameters.m_allocated_format.modifier))
+      {
+         util::disable_afbc("the driver could not create an AFBC swapchain image");
+         destroy_image(image);
+         m_image_create_info.format = VK_FORMAT_UNDEFINED;
+         return create_swapchain_image(image_create_info, image);
+      }
+      return result;
+   }
+
+   if (m_shm_presenter)
+   {
+      VkMemoryPropertyFlags optimal = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+      VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+      TRY_LOG_CALL(image_data->external_mem.configure_for_host_visible(image_create_info, required, optimal));
+
+      image_create_info.tiling = VK_IMAGE_TILING_LINEAR;
+      if (m_shm_gpu_readback || m_shm_host_import || m_frame_dumper)
+      {
+         image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      }
+      TRY_LOG(m_device_data.disp.CreateImage(m_device, &image_create_info, get_allocation_callbacks(), &image.image),
+              "Failed to create image for SHM");
+
+      TRY_LOG_CALL(image_data->external_mem.allocate_and_bind_image(image.image, image_create_info));
+
+      /* Reading cached image memory directly is already as fast as reading a staging copy. */
+      const bool image_cached =
+         (image_data->external_mem.get_host_memory_properties() & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+      if (m_shm_gpu_readback && (!image_cached || m_shm_gpu_readback_forced))
+      {
+         VkResult readback_result = create_shm_readback(image.image, image_create_info, image_data);
+         if (readback_result != VK_SUCCESS)
+         {
+            WSI_LOG_WARNING("SHM GPU readback unavailable (result=%d), reading image memory directly.",
+                            readback_result);
+            destroy_shm_readback(image_data);
+            m_shm_gpu_readback = false;
+         }
+      }
+
+      return VK_SUCCESS;
+   }
+
+   return allocate_image(image_create_info, image_data);
+}
+
+bool swapchain::init_shm_gpu_readback()
+{
+   const char *env = std::getenv("WSI_SHM_GPU_READBACK");
+   if (env != nullptr && env[0] == '0' && env[1] == '\0')
+   {
+      return false;
+   }
+   m_shm_gpu_readback_forced = env_var_is_enabled(env);
+
+   if (!has_single_queue_family(m_device_data))
+   {
+      WSI_LOG_INFO("SHM GPU readback disabled: the present queue family is not known.");
+      return false;
+   }
+
+   const VkMemoryPropertyFlags staging_props =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+   const auto &memory_props = m_memory_props.memoryProperties;
+   for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+   {
+      if ((memory_props.memoryTypes[i].propertyFlags & staging_props) == staging_props)
+      {
+         return true;
+      }
+   }
+
+   WSI_LOG_INFO("SHM GPU readback disabled: no host cached and coherent memory type.");
+   return false;
+}
+
+bool swapchain::init_shm_host_import()
+{
+   const char *env = std::getenv("WSI_SHM_HOST_IMPORT");
+   if (env != nullptr && env[0] == '0' && env[1] == '\0')
+   {
+      return false;
+   }
+
+   if (!m_device_data.is_device_extension_enabled(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) ||
+       !has_single_queue_family(m_device_data))
+   {
+      return false;
+   }
+
+   VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_props = {};
+   host_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+   VkPhysicalDeviceProperties2KHR props = {};
+   props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+   props.pNext = &host_props;
+   m_device_data.instance_data.disp.GetPhysicalDeviceProperties2KHR(m_device_data.physical_device, &props);
+
+   /* shmat() hands out page aligned, page granular mappings; anything coarser cannot be imported as is. */
+   const VkDeviceSize page_size = static_cast<VkDeviceSize>(sysconf(_SC_PAGESIZE));
+   if (host_props.minImportedHostPointerAlignment == 0 || host_props.minImportedHostPointerAlignment > page_size)
+   {
+      WSI_LOG_INFO("SHM host import disabled: host pointer alignment %llu exceeds the page size.",
+                   static_cast<unsigned long long>(host_props.minImportedHostPointerAlignment));
+      return false;
+   }
+
+   m_host_pointer_alignment = host_props.minImportedHostPointerAlignment;
+   return true;
+}
+
+VkResult swapchain::ensure_readback_pool()
+{
+   if (m_readback_pool != VK_NULL_HANDLE)
+   {
+      return VK_SUCCESS;
+   }
+
+   VkCommandPoolCreateInfo pool_info = {};
+   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+   pool_info.queueFamilyIndex = 0;
+   TRY_LOG(m_device_data.disp.CreateCommandPool(m_device, &pool_info, get_allocation_callbacks(), &m_readback_pool),
+           "Failed to create SHM readback command pool");
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::record_shm_copy(VkImage image, VkBuffer buffer, uint32_t width, uint32_t height,
+                                    VkCommandBuffer *command_buffer)
+{
+   TRY_LOG_CALL(ensure_readback_pool());
+
+   VkCommandBufferAllocateInfo cmd_info = {};
+   cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+   cmd_info.commandPool = m_readback_pool;
+   cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+   cmd_info.commandBufferCount = 1;
+   TRY_LOG(m_device_data.disp.AllocateCommandBuffers(m_device, &cmd_info, command_buffer),
+           "Failed to allocate SHM readback command buffer");
+
+   /* Recorded once: the image is always in PRESENT_SRC when the present payload runs, and the presenter
+    * waits for the payload fence before reading the buffer. */
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   TRY_LOG(m_device_data.disp.BeginCommandBuffer(*command_buffer, &begin_info),
+           "Failed to begin SHM readback command buffer");
+
+   VkImageMemoryBarrier to_transfer = {};
+   to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   to_transfer.srcAccessMask = 0;
+   to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_transfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_transfer.image = image;
+   to_transfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+   m_device_data.disp.CmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+   VkBufferImageCopy region = {};
+   region.bufferOffset = 0;
+   region.bufferRowLength = width;
+   region.bufferImageHeight = height;
+   region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   region.imageExtent = { width, height, 1 };
+   m_device_data.disp.CmdCopyImageToBuffer(*command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1,
+                                           &region);
+
+   VkImageMemoryBarrier to_present = to_transfer;
+   to_present.srcAccessMask = 0;
+   to_present.dstAccessMask = 0;
+   to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+   VkBufferMemoryBarrier to_host = {};
+   to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+   to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+   to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.buffer = buffer;
+   to_host.offset = 0;
+   to_host.size = VK_WHOLE_SIZE;
+   m_device_data.disp.CmdPipelineBarrier(*command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                         nullptr, 1, &to_host, 1, &to_present);
+
+   TRY_LOG(m_device_data.disp.EndCommandBuffer(*command_buffer), "Failed to end SHM readback command buffer");
+
+   return VK_SUCCESS;
+}
+
+VkResult swapchain::create_shm_readback(VkImage image, const VkImageCreateInfo &image_create_info,
+                                        x11_image_data *image_data)
+{
+   const uint32_t width = image_create_info.extent.width;
+   const uint32_t height = image_create_info.extent.height;
+
+   if (m_shm_gpu_downscale && m_shm_image_format == VK_FORMAT_UNDEFINED)
+   {
+      m_shm_image_format = image_create_info.format;
+      m_shm_gpu_downscale = check_shm_downscale_support(image_create_info.format);
+   }
+
+   VkBufferCreateInfo buffer_info = {};
+   buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+   buffer_info.size = static_cast<VkDeviceSize>(width) * height * 4;
+   buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+   buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+   TRY_LOG(m_device_data.disp.CreateBuffer(m_device, &buffer_info, get_allocation_callbacks(),
+                                           &image_data->readback_buffer),
+           "Failed to create SHM readback buffer");
+
+   VkMemoryRequirements mem_requirements;
+   m_device_data.disp.GetBufferMemoryRequirements(m_device, image_data->readback_buffer, &mem_requirements);
+
+   const VkMemoryPropertyFlags staging_props =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+   const auto &memory_props = m_memory_props.memoryProperties;
+   uint32_t memory_type_index = memory_props.memoryTypeCount;
+   for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+   {
+      if ((mem_requirements.memoryTypeBits & (1u << i)) &&
+          (memory_props.memoryTypes[i].propertyFlags & staging_props) == staging_props)
+      {
+         memory_type_index = i;
+         break;
+      }
+   }
+   if (memory_type_index == memory_props.memoryTypeCount)
+   {
+      return VK_ERROR_FORMAT_NOT_SUPPORTED;
    }
 
-   TRY_LOG(m_shm_presenter->create_image_resources(image_data, width, height, depth),
-           "Failed to create presentation image resources");
+   VkMemoryAllocateInfo alloc_info = {};
+   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+   alloc_info.allocationSize = mem_requirements.size;
+   alloc_info.memoryTypeIndex = memory_type_index;
+   TRY_LOG(m_device_data.disp.AllocateMemory(m_device, &alloc_info, get_allocation_callbacks(),
+                                             &image_data->readback_memory),
+           "Failed to allocate SHM readback memory");
+   TRY_LOG(m_device_data.disp.BindBufferMemory(m_device, image_data->readback_buffer, image_data->readback_memory, 0),
+           "Failed to bind SHM readback memory");
+   TRY_LOG(m_device_data.disp.MapMemory(m_device, image_data->readback_memory, 0, VK_WHOLE_SIZE, 0,
+                                        &image_data->readback_ptr),
+           "Failed to map SHM readback memory");
+
+   return record_shm_copy(image, image_data->readback_buffer, width, height, &image_data->readback_cmd);
+}
 
-   /* Initialize presentation fence. */
-   auto present_fence = sync_fd_fence_sync::create(m_device_data);
-   if (!present_fence.has_value())
+void swapchain::destroy_shm_readback(x11_image_data *image_data)
+{
+   destroy_shm_downscale(image_data);
+   if (image_data->readback_cmd != VK_NULL_HANDLE)
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      m_device_data.disp.FreeCommandBuffers(m_device, m_readback_pool, 1, &image_data->readback_cmd);
+      image_data->readback_cmd = VK_NULL_HANDLE;
    }
-   image_data->present_fence = std::move(present_fence.value());
+   if (image_data->readback_buffer != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.DestroyBuffer(m_device, image_data->readback_buffer, get_allocation_callbacks());
+      image_data->readback_buffer = VK_NULL_HANDLE;
+   }
+   if (image_data->readback_memory != VK_NULL_HANDLE)
+   {
+      /* Freeing the memory implicitly unmaps it. */
+      m_device_data.disp.FreeMemory(m_device, image_data->readback_memory, get_allocation_callbacks());
+      image_data->readback_memory = VK_NULL_HANDLE;
+   }
+   image_data->readback_ptr = nullptr;
+}
 
-   return VK_SUCCESS;
+bool swapchain::check_shm_downscale_support(VkFormat format)
+{
+   VkFormatProperties2KHR format_props = {};
+   format_props.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2_KHR;
+   m_device_data.instance_data.disp.GetPhysicalDeviceFormatProperties2KHR(m_device_data.physical_device, format,
+                                                                          &format_props);
+
+   const VkFormatFeatureFlags src_features =
+      VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+   const VkFormatFeatureFlags dst_features = VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+   if ((format_props.formatProperties.linearTilingFeatures & src_features) != src_features ||
+       (format_props.formatProperties.optimalTilingFeatures & dst_features) != dst_features)
+   {
+      WSI_LOG_INFO("SHM GPU downscale disabled: format %d cannot be blitted with linear filtering.", format);
+      return false;
+   }
+   return true;
 }
 
-VkResult swapchain::create_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image)
+VkResult swapchain::prepare_shm_downscale(VkImage image, x11_image_data *image_data, uint32_t width,
+                                          uint32_t height)
 {
-   /* Create image_data */
-   auto image_data = m_allocator.create<x11_image_data>(1, m_device, m_allocator);
-   if (image_data == nullptr)
+   if (image_data->downscale_cmd != VK_NULL_HANDLE && image_data->downscale_width == width &&
+       image_data->downscale_height == height)
    {
-      return VK_ERROR_OUT_OF_HOST_MEMORY;
+      return VK_SUCCESS;
    }
-   image.data = image_data;
-   image_data->device = m_device;
-   image_data->device_data = &m_device_data;
 
-   if (m_use_xwayland_bridge)
+   /* The image was acquired again, so the payload that last used these resources has completed. */
+   destroy_shm_downscale(image_data);
+
+   VkImageCreateInfo image_info = {};
+   image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+   image_info.imageType = VK_IMAGE_TYPE_2D;
+   image_info.format = m_shm_image_format;
+   image_info.extent = { width, height, 1 };
+   image_info.mipLevels = 1;
+   image_info.arrayLayers = 1;
+   image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+   image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+   image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+   image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+   image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+   TRY_LOG(m_device_data.disp.CreateImage(m_device, &image_info, get_allocation_callbacks(),
+                                          &image_data->downscale_image),
+           "Failed to create SHM downscale image");
+
+   VkMemoryRequirements mem_requirements;
+   m_device_data.disp.GetImageMemoryRequirements(m_device, image_data->downscale_image, &mem_requirements);
+   const auto &memory_props = m_memory_props.memoryProperties;
+   uint32_t memory_type_index = memory_props.memoryTypeCount;
+   for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
    {
-      if (m_image_create_info.format == VK_FORMAT_UNDEFINED)
+      if ((mem_requirements.memoryTypeBits & (1u << i)) == 0)
       {
-         util::vector<wsialloc_format> importable_formats(
-            util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-         util::vector<uint64_t> exportable_modifiers(util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-
-         util::vector<VkDrmFormatModifierPropertiesEXT> drm_format_props(
-            util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-
-         TRY_LOG_CALL(
-            get_surface_compatible_formats(image_create_info, importable_formats, exportable_modifiers, drm_format_props,
-                                           false));
-
-         if (importable_formats.empty())
-         {
-            WSI_LOG_ERROR("No importable dmabuf formats available for Xwayland bridge path.");
-            return VK_ERROR_INITIALIZATION_FAILED;
-         }
-
-         WSI_LOG_INFO("Xwayland bridge: importable dmabuf candidates=%zu", importable_formats.size());
-         constexpr size_t max_logged_candidates = 8;
-         for (size_t idx = 0; idx < importable_formats.size() && idx < max_logged_candidates; ++idx)
-         {
-            const auto &candidate = importable_formats[idx];
-            WSI_LOG_INFO("Xwayland bridge: candidate[%zu] fourcc=0x%x modifier=0x%llx", idx, candidate.fourcc,
-                         static_cast<unsigned long long>(candidate.modifier));
-         }
-         if (importable_formats.size() > max_logged_candidates)
-         {
-            WSI_LOG_INFO("Xwayland bridge: ... %zu more candidates not shown",
-                         importable_formats.size() - max_logged_candidates);
-         }
-
-         wsialloc_format allocated_format = { 0, 0, 0 };
-         const char *prefer_linear_env = std::getenv("XWL_DMABUF_BRIDGE_PREFER_LINEAR");
-         const bool prefer_linear = prefer_linear_env && !(prefer_linear_env[0] == '0' && prefer_linear_env[1] == '\0');
-
-         bool forced_linear = false;
-         bool preferred_non_linear = false;
-         if (prefer_linear)
+         continue;
+      }
+      if (memory_type_index == memory_props.memoryTypeCount ||
+          (memory_props.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
+      {
+         memory_type_index = i;
+         if ((memory_props.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0)
          {
-            auto linear_it = std::find_if(importable_formats.begin(), importable_formats.end(),
-                                          [](const wsialloc_format &fmt) { return fmt.modifier == DRM_FORMAT_MOD_LINEAR; });
-            if (linear_it != importable_formats.end())
-            {
-               util::vector<wsialloc_format> linear_only(
-                  util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
-               if (!linear_only.try_push_back(*linear_it))
-               {
-                  return VK_ERROR_OUT_OF_HOST_MEMORY;
-               }
-               TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, linear_only, &allocated_format, true));
-               forced_linear = true;
-            }
-            else
-            {
-               WSI_LOG_WARNING("Xwayland bridge: DRM_FORMAT_MOD_LINEAR unavailable, falling back to allocator default.");
-               TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, importable_formats, &allocated_format, true));
-            }
+            break;
          }
-         else
-         {
-            util::vector<wsialloc_format> non_linear_formats(
-               util::allocator(m_allocator, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND));
+      }
+   }
+   if (memory_type_index == memory_props.memoryTypeCount)
+   {
+      return VK_ERROR_FORMAT_NOT_SUPPORTED;
+   }
 
-            for (const auto &fmt : importable_formats)
-            {
-               if (fmt.modifier == DRM_FORMAT_MOD_LINEAR)
-               {
-                  continue;
-               }
-               if (!non_linear_formats.try_push_back(fmt))
-               {
-                  return VK_ERROR_OUT_OF_HOST_MEMORY;
-               }
-            }
+   VkMemoryAllocateInfo alloc_info = {};
+   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+   alloc_info.allocationSize = mem_requirements.size;
+   alloc_info.memoryTypeIndex = memory_type_index;
+   TRY_LOG(m_device_data.disp.AllocateMemory(m_device, &alloc_info, get_allocation_callbacks(),
+                                             &image_data->downscale_memory),
+           "Failed to allocate SHM downscale memory");
+   TRY_LOG(m_device_data.disp.BindImageMemory(m_device, image_data->downscale_image, image_data->downscale_memory, 0),
+           "Failed to bind SHM downscale memory");
+
+   VkCommandBufferAllocateInfo cmd_info = {};
+   cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+   cmd_info.commandPool = m_readback_pool;
+   cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+   cmd_info.commandBufferCount = 1;
+   TRY_LOG(m_device_data.disp.AllocateCommandBuffers(m_device, &cmd_info, &image_data->downscale_cmd),
+           "Failed to allocate SHM downscale command buffer");
+
+   const VkCommandBuffer cmd = image_data->downscale_cmd;
+   VkCommandBufferBeginInfo begin_info = {};
+   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+   TRY_LOG(m_device_data.disp.BeginCommandBuffer(cmd, &begin_info), "Failed to begin SHM downscale command buffer");
+
+   VkImageMemoryBarrier to_blit[2] = {};
+   to_blit[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   to_blit[0].srcAccessMask = 0;
+   to_blit[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_blit[0].oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   to_blit[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_blit[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_blit[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_blit[0].image = image;
+   to_blit[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+   /* The previous frame's contents are overwritten whole, so they need not be kept. */
+   to_blit[1] = to_blit[0];
+   to_blit[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_blit[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+   to_blit[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   to_blit[1].image = image_data->downscale_image;
+   m_device_data.disp.CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                         nullptr, 0, nullptr, 2, to_blit);
+
+   VkImageBlit blit = {};
+   blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   blit.srcOffsets[1] = { static_cast<int32_t>(image_data->width), static_cast<int32_t>(image_data->height), 1 };
+   blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   blit.dstOffsets[1] = { static_cast<int32_t>(width), static_cast<int32_t>(height), 1 };
+   m_device_data.disp.CmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image_data->downscale_image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+   VkImageMemoryBarrier to_copy = to_blit[1];
+   to_copy.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_copy.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   to_copy.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   to_copy.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   m_device_data.disp.CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                         nullptr, 0, nullptr, 1, &to_copy);
+
+   VkBufferImageCopy region = {};
+   region.bufferOffset = 0;
+   region.bufferRowLength = width;
+   region.bufferImageHeight = height;
+   region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+   region.imageExtent = { width, height, 1 };
+   m_device_data.disp.CmdCopyImageToBuffer(cmd, image_data->downscale_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                           image_data->readback_buffer, 1, &region);
+
+   VkImageMemoryBarrier to_present = to_blit[0];
+   to_present.dstAccessMask = 0;
+   to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+   VkBufferMemoryBarrier to_host = {};
+   to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+   to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+   to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   to_host.buffer = image_data->readback_buffer;
+   to_host.offset = 0;
+   to_host.size = VK_WHOLE_SIZE;
+   m_device_data.disp.CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                         VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+                                         nullptr, 1, &to_host, 1, &to_present);
+
+   TRY_LOG(m_device_data.disp.EndCommandBuffer(cmd), "Failed to end SHM downscale command buffer");
+
+   image_data->downscale_width = width;
+   image_data->downscale_height = height;
+   return VK_SUCCESS;
+}
 
-            if (!non_linear_formats.empty())
-            {
-               TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, non_linear_formats, &allocated_format, true));
-               preferred_non_linear = true;
-            }
-            else
-            {
-               WSI_LOG_WARNING(
-                  "Xwayland bridge: non-linear modifiers unavailable, falling back to allocator default (may pick linear).");
-               TRY_LOG_CALL(allocate_wsialloc(image_create_info, image_data, importable_formats, &allocated_format, true));
-            }
-         }
+void swapchain::destroy_shm_downscale(x11_image_data *image_data)
+{
+   if (image_data->downscale_cmd != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.FreeCommandBuffers(m_device, m_readback_pool, 1, &image_data->downscale_cmd);
+      image_data->downscale_cmd = VK_NULL_HANDLE;
+   }
+   if (image_data->downscale_image != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.DestroyImage(m_device, image_data->downscale_image, get_allocation_callbacks());
+      image_data->downscale_image = VK_NULL_HANDLE;
+   }
+   if (image_data->downscale_memory != VK_NULL_HANDLE)
+   {
+      m_device_data.disp.FreeMemory(m_device, image_data->downscale_memory, get_allocation_callbacks());
+      image_data->downscale_memory = VK_NULL_HANDLE;
+   }
+   image_data->downscale_width = 0;
+   image_data->downscale_height = 0;
+}
 
-         WSI_LOG_INFO("Xwayland bridge: selected dmabuf fourcc=0x%x modifier=0x%llx%s%s",
-                      allocated_format.fourcc, static_cast<unsigned long long>(allocated_format.modifier),
-                      forced_linear ? " (linear forced)" : "",
-                      preferred_non_linear ? " (non-linear preferred)" : "");
-         if (allocated_format.fourcc == DRM_FORMAT_ARGB8888)
-         {
-            WSI_LOG_INFO("Xwayland bridge: presentation fourcc remap enabled 0x%x -> 0x%x",
-                         DRM_FORMAT_ARGB8888, DRM_FORMAT_XRGB8888);
-         }
-         else if (allocated_format.fourcc == DRM_FORMAT_ABGR8888)
-         {
-            WSI_LOG_INFO("Xwayland bridge: presentation fourcc remap enabled 0x%x -> 0x%x",
-                         DRM_FORMAT_ABGR8888, DRM_FORMAT_XBGR8888);
-         }
+VkResult swapchain::create_shm_import(VkImage image, x11_image_data *image_data)
+{
+   /* The GPU writes X11 rows directly, so they have to be tightly packed 32-bit pixels of the image's format. */
+   if (image_data->stride != image_data->width * 4 || m_shm_presenter->converts_pixels())
+   {
+      return VK_ERROR_FORMAT_NOT_SUPPORTED;
+   }
 
-         for (auto &prop : drm_format_props)
-         {
-            if (prop.drmFormatModifier == allocated_format.modifier)
-            {
-               image_data->external_mem.set_num_memories(prop.drmFormatModifierPlaneCount);
-            }
-         }
+   const VkDeviceSize import_size =
+      (static_cast<VkDeviceSize>(image_data->shm_size) + m_host_pointer_alignment - 1) & ~(m_host_pointer_alignment - 1);
 
-         TRY_LOG_CALL(fill_image_create_info(
-            image_create_info, m_image_creation_parameters.m_image_layout, m_image_creation_parameters.m_drm_mod_info,
-            m_image_creation_parameters.m_external_info, *image_data, allocated_format.modifier));
+   for (uint32_t i = 0; i < image_data->shm_segment_count; i++)
+   {
+      auto &segment = image_data->shm_segments[i];
+      if ((reinterpret_cast<uintptr_t>(segment.addr) & (m_host_pointer_alignment - 1)) != 0)
+      {
+         return VK_ERROR_FORMAT_NOT_SUPPORTED;
+      }
 
-         m_image_create_info = image_create_info;
-         m_image_creation_parameters.m_allocated_format = allocated_format;
+      VkMemoryHostPointerPropertiesEXT pointer_props = {};
+      pointer_props.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+      TRY_LOG(m_device_data.disp.GetMemoryHostPointerPropertiesEXT(
+                 m_device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, segment.addr, &pointer_props),
+              "Failed to query SHM segment host pointer properties");
+
+      VkExternalMemoryBufferCreateInfoKHR external_info = {};
+      external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO_KHR;
+      external_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+      VkBufferCreateInfo buffer_info = {};
+      buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      buffer_info.pNext = &external_info;
+      buffer_info.size = import_size;
+      buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+      buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      TRY_LOG(m_device_data.disp.CreateBuffer(m_device, &buffer_info, get_allocation_callbacks(),
+                                              &segment.import_buffer),
+              "Failed to create SHM import buffer");
+
+      VkMemoryRequirements mem_requirements;
+      m_device_data.disp.GetBufferMemoryRequirements(m_device, segment.import_buffer, &mem_requirements);
+      const uint32_t type_bits = mem_requirements.memoryTypeBits & pointer_props.memoryTypeBits;
+      if (type_bits == 0 || mem_requirements.size > import_size)
+      {
+         return VK_ERROR_FORMAT_NOT_SUPPORTED;
       }
 
-      return m_device_data.disp.CreateImage(m_device, &m_image_create_info, get_allocation_callbacks(), &image.image);
+      VkImportMemoryHostPointerInfoEXT import_info = {};
+      import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+      import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+      import_info.pHostPointer = segment.addr;
+
+      VkMemoryAllocateInfo alloc_info = {};
+      alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      alloc_info.pNext = &import_info;
+      alloc_info.allocationSize = import_size;
+      alloc_info.memoryTypeIndex = static_cast<uint32_t>(__builtin_ctz(type_bits));
+      TRY_LOG(m_device_data.disp.AllocateMemory(m_device, &alloc_info, get_allocation_callbacks(),
+                                                &segment.import_memory),
+              "Failed to import SHM segment");
+      TRY_LOG(m_device_data.disp.BindBufferMemory(m_device, segment.import_buffer, segment.import_memory, 0),
+              "Failed to bind SHM import memory");
+
+      TRY_LOG_CALL(record_shm_copy(image, segment.import_buffer, image_data->width, image_data->height,
+                                   &segment.import_cmd));
    }
 
-   if (m_shm_presenter)
-   {
-      VkMemoryPropertyFlags optimal = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                                      VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
-      VkMemoryPropertyFlags required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-      TRY_LOG_CALL(image_data->external_mem.configure_for_host_visible(image_create_info, required, optimal));
-
-      image_create_info.tiling = VK_IMAGE_TILING_LINEAR;
-      TRY_LOG(m_device_data.disp.CreateImage(m_device, &image_create_info, get_allocation_callbacks(), &image.image),
-              "Failed to create image for SHM");
+   return image_data->shm_gpu_writes_segments() ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
+}
 
-      return image_data->external_mem.allocate_and_bind_image(image.image, image_create_info);
+void swapchain::destroy_shm_import(x11_image_data *image_data)
+{
+   for (auto &segment : image_data->shm_segments)
+   {
+      if (segment.import_cmd != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.FreeCommandBuffers(m_device, m_readback_pool, 1, &segment.import_cmd);
+         segment.import_cmd = VK_NULL_HANDLE;
+      }
+      if (segment.import_buffer != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.DestroyBuffer(m_device, segment.import_buffer, get_allocation_callbacks());
+         segment.import_buffer = VK_NULL_HANDLE;
+      }
+      if (segment.import_memory != VK_NULL_HANDLE)
+      {
+         m_device_data.disp.FreeMemory(m_device, segment.import_memory, get_allocation_callbacks());
+         segment.import_memory = VK_NULL_HANDLE;
+      }
    }
-
-   return allocate_image(image_create_info, image_data);
 }
 
 void swapchain::present_event_thread()
 {
+   mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::PRESENT, "X11 present event");
    auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
    m_present_event_thread_run = true;
 
@@ -820,7 +2060,7 @@ void swapchain::present_event_thread()
             continue;
 
          auto data = reinterpret_cast<x11_image_data *>(image.data);
-         if (data->pending_completions.size() != 0)
+         if (data->pending_completions.size() != 0 || data->dri3_busy)
          {
             assume_forward_progress = true;
             break;
@@ -838,10 +2078,31 @@ void swapchain::present_event_thread()
          break;
       }
 
-      thread_status_lock.unlock();
+      if (m_present_special_event == nullptr)
+      {
+         /* Only the DRI3 path waits on the server; nothing else leaves work for this thread. */
+         m_thread_status_cond.wait(thread_status_lock);
+         continue;
+      }
 
+      /* Block until the server sends CompleteNotify or IdleNotify. xcb queues special events for us even
+       * when another thread is the one reading the connection. */
+      thread_status_lock.unlock();
+      xcb_generic_event_t *event = xcb_wait_for_special_event(m_connection, m_present_special_event);
       thread_status_lock.lock();
-      std::this_thread::sleep_for(std::chrono::milliseconds(1)); // Short polling interval
+
+      if (event == nullptr)
+      {
+         WSI_LOG_ERROR("X11 connection lost while waiting for Present events.");
+         set_error_state(VK_ERROR_SURFACE_LOST_KHR);
+         break;
+      }
+
+      do
+      {
+         handle_present_event(reinterpret_cast<const xcb_present_generic_event_t *>(event));
+         free(event);
+      } while ((event = xcb_poll_for_special_event(m_connection, m_present_special_event)) != nullptr);
    }
 
    m_present_event_thread_run = false;
@@ -850,10 +2111,134 @@ void swapchain::present_event_thread()
 
 void swapchain::present_image(const pending_present_request &pending_present)
 {
+   if (m_shm_mailbox_run)
+   {
+      if (pending_present.present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+      {
+         post_shm_mailbox(pending_present);
+         return;
+      }
+      /* Switched to FIFO: put the frames still in the mailbox first, then present on this thread. */
+      drain_shm_mailbox();
+   }
+   present_frame(pending_present);
+}
+
+void swapchain::drain_shm_mailbox()
+{
+   std::unique_lock<std::mutex> lock(m_shm_mailbox_mutex);
+   m_shm_mailbox_cond.wait(lock, [this]() {
+      return !m_shm_mailbox_run || (!m_shm_mailbox_request.has_value() && !m_shm_mailbox_busy);
+   });
+}
+
+void swapchain::post_shm_mailbox(const pending_present_request &pending_present)
+{
+   std::optional<pending_present_request> superseded;
+   {
+      std::lock_guard<std::mutex> lock(m_shm_mailbox_mutex);
+      superseded = m_shm_mailbox_request;
+      m_shm_mailbox_request = pending_present;
+      if (superseded.has_value())
+      {
+         /* The damage is relative to the frame that is dropped, not to the one last put. */
+         m_shm_mailbox_request->damage.rect_count = 0;
+         m_shm_mailbox_superseded++;
+      }
+   }
+   m_shm_mailbox_cond.notify_all();
+
+   if (!superseded.has_value())
+   {
+      return;
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   auto *timing = get_swapchain_extension<wsi_ext_present_timing_x11>();
+   if (timing != nullptr)
+   {
+      timing->report_presented(superseded->present_id, 0, 0);
+   }
+#endif
+   /* Its present id is reached once the newer frame is shown. The payload may still be running; queue_present
+    * waits for it before the image is presented again. */
+   unpresent_image(superseded->image_index);
+}
+
+void swapchain::shm_mailbox_thread()
+{
+   mali_wrapper::ApplyThreadPlacement(mali_wrapper::ThreadRole::PRESENT, "SHM mailbox");
+
+   std::unique_lock<std::mutex> lock(m_shm_mailbox_mutex);
+   for (;;)
+   {
+      m_shm_mailbox_cond.wait(lock, [this]() { return !m_shm_mailbox_run || m_shm_mailbox_request.has_value(); });
+      if (!m_shm_mailbox_run)
+      {
+         return;
+      }
+
+      const pending_present_request request = *m_shm_mailbox_request;
+      m_shm_mailbox_request.reset();
+      m_shm_mailbox_busy = true;
+      lock.unlock();
+
+      /* Presents arriving from here on supersede each other, not this frame. The presenter paces MAILBOX to
+       * the display, so the next frame is taken one interval later. */
+      const VkResult result = image_wait_present(m_swapchain_images[request.image_index], UINT64_MAX);
+      if (result == VK_SUCCESS)
+      {
+         present_frame(request);
+      }
+      else
+      {
+         WSI_LOG_ERROR("SHM mailbox: waiting for the present payload of image %u failed with %d",
+                       request.image_index, result);
+         set_error_state(result);
+         unpresent_image(request.image_index);
+      }
+
+      lock.lock();
+      m_shm_mailbox_busy = false;
+      m_shm_mailbox_cond.notify_all();
+   }
+}
+
+void swapchain::stop_shm_mailbox_thread()
+{
+   if (!m_shm_mailbox_thread.joinable())
+   {
+      return;
+   }
+
+   std::optional<pending_present_request> pending;
+   {
+      std::lock_guard<std::mutex> lock(m_shm_mailbox_mutex);
+      m_shm_mailbox_run = false;
+      pending = m_shm_mailbox_request;
+      m_shm_mailbox_request.reset();
+   }
+   m_shm_mailbox_cond.notify_all();
+   m_shm_mailbox_thread.join();
+
+   if (pending.has_value())
+   {
+      unpresent_image(pending->image_index);
+   }
+   if (m_shm_mailbox_superseded != 0)
+   {
+      WSI_LOG_INFO("SHM mailbox: %llu frames were superseded before they were copied.",
+                   static_cast<unsigned long long>(m_shm_mailbox_superseded));
+   }
+}
+
+void swapchain::present_frame(const pending_present_request &pending_present)
+{
+   util::allocation_free_scope no_allocations;
    auto image_data = reinterpret_cast<x11_image_data *>(m_swapchain_images[pending_present.image_index].data);
    auto thread_status_lock = std::unique_lock<std::mutex>(m_thread_status_lock);
 
-   while (image_data->pending_completions.size() == X11_SWAPCHAIN_MAX_PENDING_COMPLETIONS)
+   while (image_data->pending_completions.full())
    {
       if (!m_present_event_thread_run)
       {
@@ -871,6 +2256,7 @@ void swapchain::present_image(const pending_present_request &pending_present)
    uint32_t serial = (uint32_t)m_send_sbc;
 
    VkResult present_result = VK_SUCCESS;
+   uint32_t bridge_frame_id = 0;
    if (m_use_xwayland_bridge)
    {
       auto &external_mem = image_data->external_mem;
@@ -888,12 +2274,31 @@ void swapchain::present_image(const pending_present_request &pending_present)
       const auto &strides = external_mem.get_strides();
       const auto &fds = external_mem.get_buffer_fds();
 
+      /* image_wait_present() skipped the render fence; Xwayland waits for it instead. */
+      util::fd_owner acquire_fence;
+      if (m_xwayland_bridge && m_xwayland_bridge->is_acquire_fence_supported())
+      {
+         auto present_sync_fd = image_data->present_fence.export_sync_fd();
+         if (present_sync_fd.has_value())
+         {
+            acquire_fence = std::move(present_sync_fd.value());
+         }
+         else
+         {
+            WSI_LOG_WARNING("Xwayland bridge: failed to export the present fence, waiting for it instead.");
+         }
+      }
+      /* Returns at once when the fence was exported or already waited for. */
+      image_data->present_fence.wait_payload(UINT64_MAX);
+
       const bool bridge_ok =
          m_xwayland_bridge &&
          m_xwayland_bridge->present_frame(static_cast<uint32_t>(m_window), image_data->width, image_data->height,
                                           bridge_fourcc,
                                           m_image_creation_parameters.m_allocated_format.modifier,
-                                          external_mem.get_num_planes(), offsets.data(), strides.data(), fds.data());
+                                          external_mem.get_num_planes(), offsets.data(), strides.data(), fds.data(),
+                                          &bridge_frame_id, &image_data->bridge_buffer_id,
+                                          acquire_fence.is_valid() ? acquire_fence.get() : -1);
 
       if (!bridge_ok)
       {
@@ -904,17 +2309,26 @@ void swapchain::present_image(const pending_present_request &pending_present)
          present_result = VK_ERROR_OUT_OF_DATE_KHR;
          set_error_state(VK_ERROR_OUT_OF_DATE_KHR);
 
-         const bool was_disabled = g_disable_xwayland_bridge_runtime.exchange(true, std::memory_order_acq_rel);
-         if (!was_disabled)
+         if (disable_xwayland_bridge_for_window(m_window))
          {
-            WSI_LOG_WARNING(
-               "Disabling Xwayland bridge for this process due to runtime failure. Recreate swapchain to continue on SHM path.");
+            WSI_LOG_WARNING("Disabling Xwayland bridge for window 0x%x due to runtime failure. Recreate swapchain to "
+                            "continue on SHM path.",
+                            static_cast<unsigned>(m_window));
          }
       }
    }
+   else if (m_use_dri3)
+   {
+      present_result = present_dri3_image(thread_status_lock, image_data, serial, pending_present.present_id,
+                                          pending_present.target_present_time, pending_present.present_mode,
+                                          pending_present.queued_ns);
+   }
    else
    {
-      present_result = m_shm_presenter->present_image(image_data, serial);
+      present_result =
+         m_shm_presenter->present_image(image_data, serial, pending_present.damage, pending_present.frame_id,
+                                        pending_present.present_id, pending_present.target_present_time,
+                                        pending_present.present_mode, pending_present.queued_ns);
    }
 
    if (present_result != VK_SUCCESS)
@@ -922,6 +2336,15 @@ void swapchain::present_image(const pending_present_request &pending_present)
       WSI_LOG_ERROR("Failed to present image on X11 swapchain path: %d", present_result);
    }
 
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   /* Presents that never reached the server, and those through the bridge, which reports no display times. */
+   auto *timing = get_swapchain_extension<wsi_ext_present_timing_x11>();
+   if (timing != nullptr && (present_result != VK_SUCCESS || m_use_xwayland_bridge))
+   {
+      timing->report_presented(pending_present.present_id, 0, 0);
+   }
+#endif
+
    if (m_device_data.is_present_id_enabled())
    {
       auto *ext = get_swapchain_extension<wsi_ext_present_id>(true);
@@ -935,11 +2358,29 @@ void swapchain::present_image(const pending_present_request &pending_present)
    {
       /* Keep buffers unavailable to acquire until bridge pacing has been applied. */
       thread_status_lock.unlock();
+      const auto throttle_start = std::chrono::steady_clock::now();
       throttle_bridge_present_if_needed();
+      const uint64_t throttle_ns = static_cast<uint64_t>(
+         std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - throttle_start)
+            .count());
+      m_xwayland_bridge->record_throttle(throttle_ns);
+      record_frame_stage(wsi::frame_stage::pacing_sleep, throttle_ns, pending_present.frame_id);
+
+      auto &metrics = mali_wrapper::MetricsPage::Instance();
+      if (metrics.IsEnabled())
+      {
+         metrics.RecordBridgeStats(
+            static_cast<uint64_t>(reinterpret_cast<uintptr_t>(static_cast<wsi::swapchain_base *>(this))),
+            m_xwayland_bridge->get_stats());
+      }
       thread_status_lock.lock();
    }
 
-   if (!m_use_xwayland_bridge)
+   if (m_use_dri3 && present_result == VK_SUCCESS)
+   {
+      /* Released once the X server sends IdleNotify for the pixmap. */
+   }
+   else if (!m_use_xwayland_bridge)
    {
       image_index_to_unpresent = pending_present.image_index;
       should_unpresent = true;
@@ -949,22 +2390,28 @@ void swapchain::present_image(const pending_present_request &pending_present)
       /*
        * Do not release the just-submitted image immediately on bridge path.
        * Keep a small in-flight queue so we do not render into a buffer that
-       * may still be sampled by the compositor.
+       * may still be sampled by the compositor. With feedback, images go as
+       * soon as a later frame is acknowledged; the lag stays as an upper
+       * bound so a silent compositor cannot starve acquire.
        */
       const size_t release_lag_frames = (m_swapchain_images.size() > 1) ? (m_swapchain_images.size() - 1) : 1u;
+      const bool release_on_feedback = m_xwayland_bridge->is_feedback_available();
       if (!m_bridge_release_lag_logged)
       {
-         WSI_LOG_INFO("Xwayland bridge: delayed image release enabled (lag=%zu frame%s, swapchain_images=%zu)",
-                      release_lag_frames, (release_lag_frames == 1) ? "" : "s", m_swapchain_images.size());
+         WSI_LOG_INFO("Xwayland bridge: delayed image release enabled (%s, lag=%zu frame%s, swapchain_images=%zu)",
+                      release_on_feedback ? "on feedback" : "fixed lag", release_lag_frames,
+                      (release_lag_frames == 1) ? "" : "s", m_swapchain_images.size());
          m_bridge_release_lag_logged = true;
       }
-      m_bridge_pending_unpresent.push_back(pending_present.image_index);
+      /* Holds every image, so there is always room for the one just sent. */
+      const bool queued = m_bridge_pending_unpresent.push_back(bridge_pending_image{ pending_present.image_index,
+                                                                                      bridge_frame_id });
+      assert(queued);
+      (void)queued;
 
       while (m_bridge_pending_unpresent.size() > release_lag_frames)
       {
-         const uint32_t completed_index = m_bridge_pending_unpresent.front();
-         m_bridge_pending_unpresent.pop_front();
-         unpresent_image(completed_index);
+         unpresent_image(m_bridge_pending_unpresent.pop_front()->image_index);
       }
    }
    else
@@ -973,10 +2420,9 @@ void swapchain::present_image(const pending_present_request &pending_present)
       image_index_to_unpresent = pending_present.image_index;
       should_unpresent = true;
 
-      while (!m_bridge_pending_unpresent.empty())
+      while (auto pending = m_bridge_pending_unpresent.pop_front())
       {
-         unpresent_image(m_bridge_pending_unpresent.front());
-         m_bridge_pending_unpresent.pop_front();
+         unpresent_image(pending->image_index);
       }
    }
 
@@ -1057,6 +2503,18 @@ VkResult swapchain::get_free_buffer(uint64_t *timeout)
 void swapchain::destroy_image(wsi::swapchain_image &image)
 {
    std::unique_lock<std::recursive_mutex> image_status_lock(m_image_status_mutex);
+   /* Freeing the pixmap does not stop the X server or compositor reading the buffer: wsialloc only gets it back
+    * after IdleNotify, or once the image was given back on the bridge path. */
+   if (image.data != nullptr)
+   {
+      auto data = reinterpret_cast<x11_image_data *>(image.data);
+      if (data->dri3_busy || image.status == wsi::swapchain_image::PENDING ||
+          image.status == wsi::swapchain_image::PRESENTED)
+      {
+         data->external_mem.set_release_to_wsialloc(false);
+      }
+   }
+
    if (image.status != wsi::swapchain_image::INVALID)
    {
       if (image.image != VK_NULL_HANDLE)
@@ -1074,8 +2532,23 @@ void swapchain::destroy_image(wsi::swapchain_image &image)
    {
       auto data = reinterpret_cast<x11_image_data *>(image.data);
 
+      if (m_xwayland_bridge && data->bridge_buffer_id != 0)
+      {
+         m_xwayland_bridge->unregister_buffer(data->bridge_buffer_id);
+         data->bridge_buffer_id = 0;
+      }
+
+      if (data->pixmap != XCB_PIXMAP_NONE)
+      {
+         xcb_free_pixmap(m_connection, data->pixmap);
+         data->pixmap = XCB_PIXMAP_NONE;
+      }
+
       if (m_shm_presenter && data != nullptr)
       {
+         /* The imported memory aliases the segments, so release it before they are detached. */
+         destroy_shm_import(data);
+         destroy_shm_readback(data);
          m_shm_presenter->destroy_image_resources(data);
       }
 
@@ -1088,11 +2561,73 @@ VkResult swapchain::image_set_present_payload(swapchain_image &image, VkQueue qu
                                               const queue_submit_semaphores &semaphores, const void *submission_pnext)
 {
    auto data = reinterpret_cast<x11_image_data *>(image.data);
-   return data->present_fence.set_payload(queue, semaphores, submission_pnext);
+
+   /* The SHM copy riding on the payload, if any, then the frame dump copy. */
+   std::array<VkCommandBuffer, 2> command_buffers{};
+   uint32_t command_buffer_count = 0;
+   if (data->shm_gpu_writes_segments())
+   {
+      /* Pick the segment here rather than in the presenter: the copy into it is part of this submission. */
+      data->shm_active_segment = (data->shm_active_segment + 1) % data->shm_segment_count;
+      command_buffers[command_buffer_count++] = data->shm_segments[data->shm_active_segment].import_cmd;
+   }
+   else if (data->readback_cmd != VK_NULL_HANDLE)
+   {
+      data->readback_width = data->width;
+      data->readback_height = data->height;
+
+      /* A window smaller than the image only needs its own pixels read back. */
+      uint32_t target_width = 0;
+      uint32_t target_height = 0;
+      if (m_shm_gpu_downscale && m_shm_presenter->get_scale_target(&target_width, &target_height) &&
+          target_width <= data->width && target_height <= data->height &&
+          (target_width != data->width || target_height != data->height))
+      {
+         VkResult downscale_result = prepare_shm_downscale(image.image, data, target_width, target_height);
+         if (downscale_result == VK_SUCCESS)
+         {
+            data->readback_width = target_width;
+            data->readback_height = target_height;
+            command_buffers[command_buffer_count++] = data->downscale_cmd;
+         }
+         else
+         {
+            WSI_LOG_WARNING("SHM GPU downscale unavailable (result=%d), reading back whole frames.",
+                            downscale_result);
+            destroy_shm_downscale(data);
+            m_shm_gpu_downscale = false;
+         }
+      }
+      if (command_buffer_count == 0)
+      {
+         command_buffers[command_buffer_count++] = data->readback_cmd;
+      }
+   }
+
+   const VkCommandBuffer dump_copy = m_frame_dumper ? m_frame_dumper->begin_capture(image.image) : VK_NULL_HANDLE;
+   if (dump_copy != VK_NULL_HANDLE)
+   {
+      command_buffers[command_buffer_count++] = dump_copy;
+   }
+
+   VkResult result = data->present_fence.set_payload(queue, semaphores, submission_pnext,
+                                                     command_buffer_count != 0 ? command_buffers.data() : nullptr,
+                                                     command_buffer_count);
+   if (dump_copy != VK_NULL_HANDLE)
+   {
+      m_frame_dumper->end_capture(queue, result);
+   }
+   return result;
 }
 
 VkResult swapchain::image_wait_present(swapchain_image &image, uint64_t timeout)
 {
+   /* The bridge sends the render fence along with the frame rather than waiting for it here. */
+   if (m_use_xwayland_bridge && m_xwayland_bridge && m_xwayland_bridge->is_acquire_fence_supported())
+   {
+      return VK_SUCCESS;
+   }
+
    auto data = reinterpret_cast<x11_image_data *>(image.data);
    return data->present_fence.wait_payload(timeout);
 }
@@ -1108,9 +2643,6 @@ VkResult swapchain::bind_swapchain_image(VkDevice &device, const VkBindImageMemo
 
 VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCreateInfoKHR *swapchain_create_info)
 {
-   UNUSED(device);
-   UNUSED(swapchain_create_info);
-
    if (m_device_data.is_present_id_enabled())
    {
       if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_present_id>()))
@@ -1119,6 +2651,25 @@ VkResult swapchain::add_required_extensions(VkDevice device, const VkSwapchainCr
       }
    }
 
+   auto compression_control = wsi_ext_image_compression_control::create(device, swapchain_create_info);
+   if (compression_control)
+   {
+      if (!add_swapchain_extension(m_allocator.make_unique<wsi_ext_image_compression_control>(*compression_control)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+
+#if VULKAN_WSI_LAYER_EXPERIMENTAL
+   if (swapchain_create_info->flags & VK_SWAPCHAIN_CREATE_PRESENT_TIMING_BIT_EXT)
+   {
+      if (!add_swapchain_extension(wsi_ext_present_timing_x11::create(m_allocator)))
+      {
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+   }
+#endif
+
    return VK_SUCCESS;
 }
 
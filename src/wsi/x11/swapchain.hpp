@@ -44,17 +44,21 @@ extern "C" {
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
-#include <deque>
 #include <memory>
 #include <optional>
 #include <sys/shm.h>
 #include <xcb/xcb.h>
+#include <xcb/present.h>
 #include <xcb/shm.h>
+#include <xcb/sync.h>
 #include <xcb/xproto.h>
 
 #include "surface.hpp"
+#include "../layer_utils/ring_buffer.hpp"
+#include "../layer_utils/static_vector.hpp"
 #include "../layer_utils/wsialloc/wsialloc.h"
 #include "wsi/external_memory.hpp"
+#include "wsi/frame_dump.hpp"
 #include "shm_presenter.hpp"
 
 namespace wsi
@@ -68,8 +72,40 @@ struct pending_completion
    uint32_t serial;
    uint64_t present_id;
    std::optional<std::chrono::steady_clock::time_point> timestamp;
+   /* pending_present_request::queued_ns of the present, for the metrics page's display latency. */
+   uint64_t queued_ns{ 0 };
 };
 
+/**
+ * @brief One MIT-SHM segment of an image's ring.
+ */
+struct shm_segment
+{
+   xcb_shm_seg_t seg = XCB_NONE;
+   int shm_id = -1;
+   void *addr = nullptr;
+   size_t size = 0;
+
+   /* Triggered by the server right after the last put from this segment. While in_flight, fence_query (or
+    * focus_query without XSync) is the outstanding round trip that proves the server is done reading. */
+   xcb_sync_fence_t fence = XCB_NONE;
+   bool in_flight = false;
+   xcb_sync_query_fence_cookie_t fence_query{};
+   xcb_get_input_focus_cookie_t focus_query{};
+   /* Copied, and waiting for the SHM presenter's put thread. Guarded by the presenter's put mutex. */
+   bool put_queued = false;
+
+   /* addr imported through VK_EXT_external_memory_host, with the image copy recorded into it. */
+   VkBuffer import_buffer = VK_NULL_HANDLE;
+   VkDeviceMemory import_memory = VK_NULL_HANDLE;
+   VkCommandBuffer import_cmd = VK_NULL_HANDLE;
+};
+
+static constexpr uint32_t MAX_SHM_SEGMENTS = 4;
+
+/* Presents of one image that may wait for their CompleteNotify; present_image() blocks while an image is full. */
+static constexpr uint32_t MAX_PENDING_COMPLETIONS = 128;
+
 struct x11_image_data
 {
    x11_image_data(const VkDevice &device, const util::allocator &allocator)
@@ -79,19 +115,22 @@ struct x11_image_data
 
    external_memory external_mem;
    xcb_pixmap_t pixmap = XCB_PIXMAP_NONE;
-   std::vector<pending_completion> pending_completions;
+   util::static_vector<pending_completion, MAX_PENDING_COMPLETIONS> pending_completions;
+   /* DRI3 path: the X server may still read the pixmap until it sends IdleNotify for it. */
+   bool dri3_busy = false;
 
    fence_sync present_fence;
 
-   xcb_shm_seg_t shm_seg = XCB_NONE;
-   int shm_id = -1;
-   void *shm_addr = nullptr;
-   size_t shm_size = 0;
+   /* Xwayland bridge registration of this image's dmabuf, 0 until the first present registers it. */
+   uint32_t bridge_buffer_id = 0;
 
-   xcb_shm_seg_t shm_seg_alt = XCB_NONE;
-   int shm_id_alt = -1;
-   void *shm_addr_alt = nullptr;
-   bool use_alt_buffer = false;
+   /* Ring of segments the SHM presenter copies into; shm_active_segment is the one last written. */
+   shm_segment shm_segments[MAX_SHM_SEGMENTS];
+   uint32_t shm_segment_count = 0;
+   uint32_t shm_active_segment = 0;
+   size_t shm_size = 0;
+   /* WSI_LAZY_SWAPCHAIN_IMAGES: the segments are only created by the image's first present. */
+   bool shm_segments_deferred = false;
 
    uint32_t width = 0;
    uint32_t height = 0;
@@ -101,6 +140,31 @@ struct x11_image_data
    void *cpu_buffer = nullptr;
    size_t cpu_buffer_size = 0;
 
+   /* Cached copy of the image written by the GPU as part of the present payload. When set, the SHM
+    * presenter reads tightly packed rows from readback_ptr instead of the image memory. */
+   VkBuffer readback_buffer = VK_NULL_HANDLE;
+   VkDeviceMemory readback_memory = VK_NULL_HANDLE;
+   void *readback_ptr = nullptr;
+   VkCommandBuffer readback_cmd = VK_NULL_HANDLE;
+   /* Size of the frame the last present payload left in readback_ptr; smaller than the image when the
+    * payload blitted it down to the window first. */
+   uint32_t readback_width = 0;
+   uint32_t readback_height = 0;
+
+   /* Window sized target of that blit, and the command buffer recorded for downscale_width x downscale_height. */
+   VkImage downscale_image = VK_NULL_HANDLE;
+   VkDeviceMemory downscale_memory = VK_NULL_HANDLE;
+   VkCommandBuffer downscale_cmd = VK_NULL_HANDLE;
+   uint32_t downscale_width = 0;
+   uint32_t downscale_height = 0;
+
+   /* When the first segment has an import_cmd, the present payload advances shm_active_segment and copies
+    * the image straight into that segment, so the SHM presenter does no CPU copy at all. */
+   bool shm_gpu_writes_segments() const
+   {
+      return shm_segment_count > 0 && shm_segments[0].import_cmd != VK_NULL_HANDLE;
+   }
+
    VkDevice device = VK_NULL_HANDLE;
    wsi::device_private_data *device_data = nullptr;
 };
@@ -153,6 +217,22 @@ protected:
     */
    VkResult allocate_and_bind_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image) override;
 
+   /**
+    * @brief The dma-buf paths import their images without the X server; the SHM path sets up shared state per image.
+    */
+   bool can_allocate_images_in_parallel() const override
+   {
+      return m_use_dri3 || m_use_xwayland_bridge;
+   }
+
+   VkResult allocate_swapchain_image_memory(VkImageCreateInfo image_create_info, swapchain_image &image) override;
+
+   /**
+    * @brief Creates the DRI3 pixmap of the image. The bridge has nothing to create before the first present.
+    */
+   VkResult create_swapchain_image_presentable(const VkImageCreateInfo &image_create_info,
+                                              swapchain_image &image) override;
+
    /**
     * @brief Creates a new swapchain image.
     *
@@ -174,6 +254,22 @@ protected:
     */
    void present_image(const pending_present_request &pending_present) override;
 
+   uint32_t get_metrics_backend() const override
+   {
+      if (m_use_xwayland_bridge)
+      {
+         return mali_wrapper::metrics_backend::xwayland_bridge;
+      }
+      return m_use_dri3 ? mali_wrapper::metrics_backend::x11_dri3 : mali_wrapper::metrics_backend::x11_shm;
+   }
+
+   /**
+    * @brief Send the image to the active presentation path and release it when that path is done with it.
+    *
+    * present_image() calls this directly, except for SHM MAILBOX swapchains, where the mailbox thread does.
+    */
+   void present_frame(const pending_present_request &pending_present);
+
    /**
     * @brief Method to release a swapchain image
     *
@@ -245,7 +341,176 @@ private:
    void init_bridge_present_rate_limit();
    void throttle_bridge_present_if_needed();
 
+   /**
+    * @brief Release the bridge images that the compositor no longer shows, now that @p frame_id was acknowledged.
+    *
+    * Must be called with m_thread_status_lock held.
+    *
+    * @param displayed false if the compositor rejected the frame, so its own image can go as well.
+    */
+   void release_bridge_images(uint32_t frame_id, bool displayed);
+
+   /**
+    * @brief Track the compositor frame callback cadence from a displayed frame's feedback.
+    *
+    * Must be called with m_thread_status_lock held.
+    */
+   void update_bridge_frame_timing(uint64_t frame_time_ns);
+
+   /**
+    * @brief Sleep until shortly before the compositor frame after the one the frame just sent will reach.
+    *
+    * @return false if no frame timing is known yet, so timer pacing should apply instead.
+    */
+   bool wait_for_bridge_frame_deadline();
+
+   /**
+    * @brief Move this swapchain's requests and events to a connection of its own, when WSI_X11_PRIVATE_CONNECTION
+    *        asks for it.
+    *
+    * @return true when m_connection now is the private connection.
+    */
+   bool open_private_connection();
+
+   /**
+    * @brief Check whether the X server can present our dma-bufs through DRI3 and Present, and select the
+    *        Present events for the window if so.
+    *
+    * @return true when the DRI3 path should be used for this swapchain.
+    */
+   bool init_dri3_presentation();
+
+   /**
+    * @brief Create a swapchain image backed by a dma-buf with a modifier the X server accepts.
+    */
+   VkResult create_dri3_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image);
+
+   /**
+    * @brief Create a swapchain image backed by a dma-buf for the Xwayland bridge.
+    */
+   VkResult create_bridge_swapchain_image(VkImageCreateInfo image_create_info, swapchain_image &image);
+
+   /**
+    * @brief Whether a failure to import or share @p image can be retried with an uncompressed format.
+    *
+    * True when the swapchain's format is AFBC and @p image is its only image, so the format can still change.
+    */
+   bool can_retry_without_afbc(const swapchain_image &image) const;
+
+   /**
+    * @brief Disable AFBC, then create and bind @p image again with an uncompressed format.
+    */
+   VkResult retry_image_without_afbc(const VkImageCreateInfo &image_create_info, swapchain_image &image,
+                                     const char *reason);
+
+   /**
+    * @brief Wrap the image's dma-buf planes in an X pixmap with xcb_dri3_pixmap_from_buffers.
+    */
+   VkResult create_dri3_pixmap(x11_image_data *image_data);
+
+   /**
+    * @brief Queue the image's pixmap with xcb_present_pixmap. Called with m_thread_status_lock held.
+    *
+    * @param target_ns    CLOCK_MONOTONIC time the image should reach the display, or 0 for the next vblank the
+    *                     present mode allows. Turned into a target MSC from the vblanks Present reported so far.
+    * @param present_mode Mode of this present, which picks the Present options and the FIFO pacing.
+    * @param queued_ns    Time the present was queued, kept until its CompleteNotify to report the display latency.
+    */
+   VkResult present_dri3_image(std::unique_lock<std::mutex> &thread_status_lock, x11_image_data *image_data,
+                               uint32_t serial, uint64_t present_id, uint64_t target_ns,
+                               VkPresentModeKHR present_mode, uint64_t queued_ns);
+   void handle_present_event(const xcb_present_generic_event_t *event);
+
+   /**
+    * @brief Make the request the frame the SHM mailbox thread copies next.
+    *
+    * A request still waiting there was superseded and is released to the application at once.
+    */
+   void post_shm_mailbox(const pending_present_request &pending_present);
+
+   /**
+    * @brief Wait until the SHM mailbox thread has put every frame posted to it.
+    *
+    * Called before a FIFO present on a swapchain that switches between modes, so frames stay in order.
+    */
+   void drain_shm_mailbox();
+   void shm_mailbox_thread();
+   void stop_shm_mailbox_thread();
+
+   /**
+    * @brief Decide whether SHM presentation should read back through a host-cached staging buffer.
+    *
+    * @return true when WSI_SHM_GPU_READBACK allows it and the device can run the copy on the present queue.
+    */
+   bool init_shm_gpu_readback();
+
+   /**
+    * @brief Decide whether the SHM segments can be imported as Vulkan memory and written by the GPU.
+    *
+    * @return true when WSI_SHM_HOST_IMPORT allows it and VK_EXT_external_memory_host is enabled on the device.
+    */
+   bool init_shm_host_import();
+
+   VkResult ensure_readback_pool();
+
+   /**
+    * @brief Allocate and record a command buffer copying the whole image into a tightly packed buffer.
+    *
+    * @param image          The swapchain image, in PRESENT_SRC layout whenever the copy runs.
+    * @param buffer         Destination buffer of at least width * height * 4 bytes.
+    * @param width          Image width.
+    * @param height         Image height.
+    * @param command_buffer Receives the recorded command buffer.
+    *
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult record_shm_copy(VkImage image, VkBuffer buffer, uint32_t width, uint32_t height,
+                            VkCommandBuffer *command_buffer);
+
+   /**
+    * @brief Create the staging buffer and the pre-recorded image to buffer copy for one SHM image.
+    *
+    * @param image             The swapchain image, bound to its memory.
+    * @param image_create_info The image's create info.
+    * @param image_data        The image data receiving the readback resources.
+    *
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult create_shm_readback(VkImage image, const VkImageCreateInfo &image_create_info,
+                                x11_image_data *image_data);
+   void destroy_shm_readback(x11_image_data *image_data);
+
+   /**
+    * @brief Check that the SHM image format can be blitted, with linear filtering, from linear to optimal tiling.
+    */
+   bool check_shm_downscale_support(VkFormat format);
+
+   /**
+    * @brief Make the image's downscale command buffer blit to width x height and copy the result into the
+    *        readback buffer, recreating the target image when the size changed.
+    *
+    * @param image      The swapchain image, in PRESENT_SRC layout whenever the command buffer runs.
+    * @param image_data The image data holding the readback buffer.
+    *
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult prepare_shm_downscale(VkImage image, x11_image_data *image_data, uint32_t width, uint32_t height);
+   void destroy_shm_downscale(x11_image_data *image_data);
+
+   /**
+    * @brief Import the image's SHM segments and record the copies into them.
+    *
+    * @param image      The swapchain image, bound to its memory.
+    * @param image_data The image data whose segments have been created by the SHM presenter.
+    *
+    * @return VK_SUCCESS on success, other result codes on failure.
+    */
+   VkResult create_shm_import(VkImage image, x11_image_data *image_data);
+   void destroy_shm_import(x11_image_data *image_data);
+
    xcb_connection_t *m_connection;
+   /** Owned connection that m_connection points at, or nullptr when m_connection is the application's. */
+   xcb_connection_t *m_private_connection = nullptr;
    xcb_window_t m_window;
 
    /** Raw pointer to the WSI Surface that this swapchain was created from. The Vulkan specification ensures that the
@@ -261,14 +526,75 @@ private:
     * @brief Presentation strategy for this swapchain.
     */
    std::unique_ptr<shm_presenter> m_shm_presenter;
+
+   /**
+    * @brief MAILBOX on the SHM path: presents only replace the frame waiting in m_shm_mailbox_request, and a
+    *        thread copies and puts the newest waiting frame once per display interval.
+    */
+   std::thread m_shm_mailbox_thread;
+   std::mutex m_shm_mailbox_mutex;
+   std::condition_variable m_shm_mailbox_cond;
+   std::optional<pending_present_request> m_shm_mailbox_request;
+   bool m_shm_mailbox_run = false;
+   /** The mailbox thread is presenting a frame it already took from m_shm_mailbox_request. */
+   bool m_shm_mailbox_busy = false;
+   /** Frames released without being copied, reported when the swapchain is destroyed. */
+   uint64_t m_shm_mailbox_superseded = 0;
+
+   /** Dumps the SHM presenter's frames with MALI_WRAPPER_FRAME_DUMP, nullptr otherwise. */
+   std::unique_ptr<frame_dumper> m_frame_dumper;
+
+   /**
+    * @brief Command pool for the SHM readback copies, on queue family 0 like m_queue.
+    */
+   VkCommandPool m_readback_pool = VK_NULL_HANDLE;
+   bool m_shm_gpu_readback = false;
+   bool m_shm_gpu_readback_forced = false;
+   /** WSI_SHM_GPU_DOWNSCALE: blit frames down to a smaller window before the readback copy. */
+   bool m_shm_gpu_downscale = false;
+   VkFormat m_shm_image_format = VK_FORMAT_UNDEFINED;
+   bool m_shm_host_import = false;
+   VkDeviceSize m_host_pointer_alignment = 0;
    std::unique_ptr<xwayland_dmabuf_bridge_client> m_xwayland_bridge;
    bool m_use_xwayland_bridge = false;
+
+   /**
+    * @brief Native DRI3/Present presentation state.
+    */
+   bool m_use_dri3 = false;
+   int m_dri3_depth = 24;
+   uint32_t m_present_event_id = 0;
+   xcb_special_event_t *m_present_special_event = nullptr;
+   uint64_t m_last_complete_msc = 0;
+
    uint64_t m_bridge_present_interval_ns = 0;
    std::chrono::steady_clock::time_point m_bridge_next_present_time{};
    bool m_bridge_present_rate_limit_initialized = false;
    bool m_bridge_present_fps_override = false;
    bool m_bridge_release_lag_logged = false;
-   std::deque<uint32_t> m_bridge_pending_unpresent;
+
+   /**
+    * @brief XWL_DMABUF_BRIDGE_ADAPTIVE_PACING: pace against the frame callback times reported in bridge feedback.
+    */
+   bool m_bridge_adaptive_pacing = false;
+   /** Latest frame callback time and the estimated time between callbacks, guarded by m_thread_status_lock. */
+   uint64_t m_bridge_last_frame_time_ns = 0;
+   uint64_t m_bridge_frame_interval_ns = 0;
+   /** Frame callback the most recently sent frame is expected to reach. Present thread only. */
+   uint64_t m_bridge_target_frame_time_ns = 0;
+   /** Whether the compositor displayed any frame of this swapchain, guarded by m_thread_status_lock. */
+   bool m_bridge_frame_displayed = false;
+
+   /**
+    * @brief An image sent to the bridge, kept from the application until the compositor is done with it.
+    */
+   struct bridge_pending_image
+   {
+      uint32_t image_index;
+      uint32_t frame_id;
+   };
+   util::ring_buffer<bridge_pending_image, wsi::surface_properties::MAX_SWAPCHAIN_IMAGE_COUNT>
+      m_bridge_pending_unpresent;
 
    /**
     * @brief Image creation parameters used for all swapchain images.
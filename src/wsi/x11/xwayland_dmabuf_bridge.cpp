@@ -24,18 +24,25 @@
 
 #include "xwayland_dmabuf_bridge.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <system_error>
 
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
 
 #include "utils/logging.hpp"
+#include "utils/trace.hpp"
 
 namespace wsi
 {
@@ -49,12 +56,29 @@ constexpr uint16_t XWL_DMABUF_BRIDGE_OP_FRAME = 1;
 constexpr uint16_t XWL_DMABUF_BRIDGE_OP_STOP = 2;
 constexpr uint16_t XWL_DMABUF_BRIDGE_OP_HELLO = 3;
 constexpr uint16_t XWL_DMABUF_BRIDGE_OP_FEEDBACK = 4;
+constexpr uint16_t XWL_DMABUF_BRIDGE_OP_REGISTER_BUFFER = 5;
+constexpr uint16_t XWL_DMABUF_BRIDGE_OP_FRAME_BUFFER = 6;
+constexpr uint16_t XWL_DMABUF_BRIDGE_OP_UNREGISTER_BUFFER = 7;
 
 constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_FAILED = 1u << 0;
+constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_BUFFER = 1u << 1;
+constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_FRAME_TIME = 1u << 2;
 constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_CAP_SYNC = 1u << 16;
+constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_CAP_BUFFERS = 1u << 17;
+constexpr uint32_t XWL_DMABUF_BRIDGE_FEEDBACK_CAP_ACQUIRE_FENCE = 1u << 18;
 
 constexpr uint32_t XWL_DMABUF_BRIDGE_HELLO_FRAME_ID = 0x48454c4fu; /* "HELO" */
 constexpr uint32_t XWL_DMABUF_BRIDGE_MAX_PLANES = 4;
+/* Plane fds plus the acquire fence. */
+constexpr uint32_t XWL_DMABUF_BRIDGE_MAX_FDS = XWL_DMABUF_BRIDGE_MAX_PLANES + 1;
+constexpr uint32_t XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT = 8;
+
+uint64_t monotonic_now_ns()
+{
+   return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+         .count());
+}
 
 struct xwl_dmabuf_bridge_plane
 {
@@ -100,6 +124,18 @@ xwayland_dmabuf_bridge_client::xwayland_dmabuf_bridge_client(std::string socket_
       m_feedback_wait_enabled = true;
    }
 
+   const char *register_env = std::getenv("XWL_DMABUF_BRIDGE_REGISTER_BUFFERS");
+   if (register_env && register_env[0] == '0' && register_env[1] == '\0')
+   {
+      m_buffer_registration_enabled = false;
+   }
+
+   const char *fence_env = std::getenv("XWL_DMABUF_BRIDGE_ACQUIRE_FENCE");
+   if (fence_env && fence_env[0] == '0' && fence_env[1] == '\0')
+   {
+      m_acquire_fence_enabled = false;
+   }
+
    const char *timeout_env = std::getenv("XWL_DMABUF_BRIDGE_FEEDBACK_TIMEOUT_MS");
    if (timeout_env && timeout_env[0] != '\0')
    {
@@ -116,6 +152,24 @@ xwayland_dmabuf_bridge_client::xwayland_dmabuf_bridge_client(std::string socket_
                          timeout_env, m_feedback_timeout_ms);
       }
    }
+
+   const char *in_flight_env = std::getenv("XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT");
+   if (in_flight_env && in_flight_env[0] != '\0')
+   {
+      errno = 0;
+      char *end = nullptr;
+      unsigned long value = std::strtoul(in_flight_env, &end, 10);
+      if (errno == 0 && end != in_flight_env && *end == '\0' && value >= 1)
+      {
+         m_max_frames_in_flight = static_cast<uint32_t>(
+            value > XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT ? XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT : value);
+      }
+      else
+      {
+         WSI_LOG_WARNING("Xwayland bridge: invalid XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT='%s', using default %u",
+                         in_flight_env, m_max_frames_in_flight);
+      }
+   }
 }
 
 xwayland_dmabuf_bridge_client::~xwayland_dmabuf_bridge_client()
@@ -133,15 +187,44 @@ bool xwayland_dmabuf_bridge_client::is_feedback_sync_enabled() const
    return m_feedback_sync_available && m_feedback_wait_enabled;
 }
 
+bool xwayland_dmabuf_bridge_client::is_feedback_available()
+{
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   return m_feedback_sync_available && m_reader_running;
+}
+
+bool xwayland_dmabuf_bridge_client::is_acquire_fence_supported() const
+{
+   return m_acquire_fence_enabled && m_acquire_fence_available && m_socket_fd >= 0;
+}
+
+void xwayland_dmabuf_bridge_client::set_feedback_callback(feedback_callback callback)
+{
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   m_feedback_callback = std::move(callback);
+}
+
 bool xwayland_dmabuf_bridge_client::present_frame(uint32_t xid, uint32_t width, uint32_t height, uint32_t fourcc,
                                                   uint64_t modifier, uint32_t num_planes, const uint32_t *offsets,
-                                                  const int *strides, const int *plane_fds)
+                                                  const int *strides, const int *plane_fds, uint32_t *frame_id,
+                                                  uint32_t *buffer_id, int acquire_fence_fd)
 {
-   if (!is_enabled() || num_planes == 0 || num_planes > XWL_DMABUF_BRIDGE_MAX_PLANES)
+   if (!is_enabled() || num_planes == 0 || num_planes > XWL_DMABUF_BRIDGE_MAX_PLANES || !ensure_connected())
    {
       return false;
    }
 
+   const bool track_feedback = is_feedback_available();
+   if (track_feedback && m_feedback_wait_enabled && !wait_for_in_flight_slot())
+   {
+      WSI_LOG_WARNING("Xwayland bridge: timed out waiting for feedback (next frame=%u, xid=0x%x), disabling sync "
+                      "feedback",
+                      m_next_frame_id, xid);
+      m_feedback_sync_available = false;
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_stats.feedback_timeouts++;
+   }
+
    xwl_dmabuf_bridge_packet packet = {};
    packet.magic = XWL_DMABUF_BRIDGE_MAGIC;
    packet.version = XWL_DMABUF_BRIDGE_VERSION;
@@ -174,41 +257,163 @@ bool xwayland_dmabuf_bridge_client::present_frame(uint32_t xid, uint32_t width,
       packet.planes[i].modifier_lo = modifier_lo;
    }
 
-   if (!send_packet(&packet, sizeof(packet), plane_fds, num_planes))
+   /* Registration acks come through the reader, so without it every frame passes its fds. */
+   bool send_buffer_id = false;
+   if (buffer_id != nullptr && m_buffer_registration_enabled && m_buffer_registration_available)
+   {
+      bool register_now = false;
+      {
+         std::lock_guard<std::mutex> lock(m_frames_mutex);
+         const auto it = m_buffers.find(*buffer_id);
+         register_now = m_reader_running && it == m_buffers.end();
+         send_buffer_id = m_reader_running && it != m_buffers.end() && it->second == buffer_state::ready;
+      }
+      if (register_now)
+      {
+         *buffer_id = register_buffer(&packet, sizeof(packet), plane_fds, num_planes);
+      }
+   }
+
+   if (m_feedback_sync_available)
+   {
+      /* Listed before sending so the reader always finds the frame its feedback names. */
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_in_flight_frames.push_back({ packet.reserved, xid, monotonic_now_ns() });
+   }
+
+   /* The fence rides after the plane fds, or alone for a registered buffer. */
+   int frame_fds[XWL_DMABUF_BRIDGE_MAX_FDS];
+   uint32_t num_frame_fds = 0;
+   if (!send_buffer_id)
+   {
+      std::memcpy(frame_fds, plane_fds, sizeof(int) * num_planes);
+      num_frame_fds = num_planes;
+   }
+   if (acquire_fence_fd >= 0 && is_acquire_fence_supported())
+   {
+      frame_fds[num_frame_fds++] = acquire_fence_fd;
+   }
+   else if (acquire_fence_fd >= 0)
+   {
+      /* Reconnected to a server that would ignore the fence; a sync_file polls readable once signalled. */
+      pollfd pfd = {};
+      pfd.fd = acquire_fence_fd;
+      pfd.events = POLLIN;
+      while (poll(&pfd, 1, -1) < 0 && errno == EINTR)
+      {
+      }
+   }
+
+   if (send_buffer_id)
+   {
+      xwl_dmabuf_bridge_packet buffer_packet = {};
+      buffer_packet.magic = XWL_DMABUF_BRIDGE_MAGIC;
+      buffer_packet.version = XWL_DMABUF_BRIDGE_VERSION;
+      buffer_packet.opcode = XWL_DMABUF_BRIDGE_OP_FRAME_BUFFER;
+      buffer_packet.xid = xid;
+      buffer_packet.flags = *buffer_id;
+      buffer_packet.reserved = packet.reserved;
+      if (!send_packet(&buffer_packet, sizeof(buffer_packet), frame_fds, num_frame_fds))
+      {
+         return false;
+      }
+   }
+   else if (!send_packet(&packet, sizeof(packet), frame_fds, num_frame_fds))
    {
       return false;
    }
 
-   WSI_LOG_DEBUG("Xwayland bridge: submitted frame=%u xid=0x%x size=%ux%u format=0x%x modifier=0x%llx planes=%u",
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_stats.frames_sent++;
+   }
+
+   WSI_LOG_DEBUG("Xwayland bridge: submitted frame=%u xid=0x%x size=%ux%u format=0x%x modifier=0x%llx planes=%u "
+                 "buffer=%u",
                  packet.reserved, xid, width, height, fourcc,
-                 static_cast<unsigned long long>(modifier), num_planes);
+                 static_cast<unsigned long long>(modifier), num_planes, send_buffer_id ? *buffer_id : 0);
 
-   if (!m_feedback_sync_available || !m_feedback_wait_enabled)
+   if (frame_id != nullptr)
    {
-      return true;
+      *frame_id = packet.reserved;
+   }
+   return true;
+}
+
+uint32_t xwayland_dmabuf_bridge_client::register_buffer(const void *packet, size_t packet_size, const int *plane_fds,
+                                                        uint32_t num_planes)
+{
+   xwl_dmabuf_bridge_packet register_packet = {};
+   std::memcpy(&register_packet, packet, sizeof(register_packet) < packet_size ? sizeof(register_packet) : packet_size);
+   register_packet.opcode = XWL_DMABUF_BRIDGE_OP_REGISTER_BUFFER;
+   register_packet.reserved = m_next_buffer_id++;
+   if (register_packet.reserved == 0)
+   {
+      register_packet.reserved = m_next_buffer_id++;
    }
 
-   uint32_t feedback_flags = 0;
-   uint32_t feedback_xid = 0;
-   if (!wait_for_feedback(packet.reserved, m_feedback_timeout_ms, feedback_flags, feedback_xid))
    {
-      WSI_LOG_WARNING("Xwayland bridge: timed out waiting for feedback (frame=%u, xid=0x%x), disabling sync feedback",
-                      packet.reserved, xid);
-      m_feedback_sync_available = false;
-      return true;
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_buffers[register_packet.reserved] = buffer_state::pending;
+   }
+
+   if (!send_packet(&register_packet, sizeof(register_packet), plane_fds, num_planes))
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_buffers.erase(register_packet.reserved);
+      return 0;
    }
 
-   WSI_LOG_DEBUG("Xwayland bridge: feedback received for frame=%u xid=0x%x ack_xid=0x%x flags=0x%x",
-                 packet.reserved, xid, feedback_xid, feedback_flags);
+   WSI_LOG_DEBUG("Xwayland bridge: registering buffer=%u size=%ux%u", register_packet.reserved, register_packet.width,
+                 register_packet.height);
+   return register_packet.reserved;
+}
 
-   if (feedback_flags & XWL_DMABUF_BRIDGE_FEEDBACK_FAILED)
+void xwayland_dmabuf_bridge_client::unregister_buffer(uint32_t buffer_id)
+{
+   if (buffer_id == 0)
    {
-      WSI_LOG_WARNING("Xwayland bridge: compositor rejected frame via feedback (frame=%u, xid=0x%x ack_xid=0x%x)",
-                      packet.reserved, xid, feedback_xid);
-      return true;
+      return;
    }
 
-   return true;
+   bool registered = false;
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      const auto it = m_buffers.find(buffer_id);
+      if (it != m_buffers.end())
+      {
+         /* A rejected import is already gone on the server side. */
+         registered = it->second != buffer_state::failed;
+         m_buffers.erase(it);
+      }
+   }
+   if (!registered || m_socket_fd < 0)
+   {
+      return;
+   }
+
+   xwl_dmabuf_bridge_packet packet = {};
+   packet.magic = XWL_DMABUF_BRIDGE_MAGIC;
+   packet.version = XWL_DMABUF_BRIDGE_VERSION;
+   packet.opcode = XWL_DMABUF_BRIDGE_OP_UNREGISTER_BUFFER;
+   packet.reserved = buffer_id;
+
+   send_packet(&packet, sizeof(packet), nullptr, 0);
+}
+
+bool xwayland_dmabuf_bridge_client::wait_for_in_flight_slot()
+{
+   mali_wrapper::TraceScope trace_scope(mali_wrapper::TraceEvent::BRIDGE_FEEDBACK_WAIT, m_next_frame_id, 0);
+
+   std::unique_lock<std::mutex> lock(m_frames_mutex);
+   const bool slot_free =
+      m_frames_cond.wait_for(lock, std::chrono::milliseconds(m_feedback_timeout_ms), [this]() {
+         return !m_reader_running || m_in_flight_frames.size() < m_max_frames_in_flight;
+      }) &&
+      m_reader_running;
+
+   trace_scope.SetArgs(m_next_frame_id, slot_free ? 1 : 0);
+   return slot_free;
 }
 
 void xwayland_dmabuf_bridge_client::stop_stream(uint32_t xid)
@@ -218,6 +423,8 @@ void xwayland_dmabuf_bridge_client::stop_stream(uint32_t xid)
       return;
    }
 
+   log_stats(xid);
+
    xwl_dmabuf_bridge_packet packet = {};
    packet.magic = XWL_DMABUF_BRIDGE_MAGIC;
    packet.version = XWL_DMABUF_BRIDGE_VERSION;
@@ -227,6 +434,49 @@ void xwayland_dmabuf_bridge_client::stop_stream(uint32_t xid)
    send_packet(&packet, sizeof(packet), nullptr, 0);
 }
 
+mali_wrapper::MetricsBridgeStats xwayland_dmabuf_bridge_client::get_stats()
+{
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   return m_stats;
+}
+
+void xwayland_dmabuf_bridge_client::record_throttle(uint64_t throttle_ns)
+{
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   m_stats.throttle_total_ns += throttle_ns;
+   m_stats.throttle_max_ns = std::max(m_stats.throttle_max_ns, throttle_ns);
+   m_stats.throttle_samples++;
+}
+
+void xwayland_dmabuf_bridge_client::log_stats(uint32_t xid)
+{
+   const mali_wrapper::MetricsBridgeStats stats = get_stats();
+   if (stats.frames_sent == 0)
+   {
+      return;
+   }
+
+   const double latency_mean_ms =
+      stats.latency_samples > 0 ? static_cast<double>(stats.latency_total_ns) / stats.latency_samples / 1e6 : 0.0;
+   const double throttle_mean_us =
+      stats.throttle_samples > 0 ? static_cast<double>(stats.throttle_total_ns) / stats.throttle_samples / 1e3 : 0.0;
+   WSI_LOG_INFO("Xwayland bridge stats xid=0x%x: sent=%llu displayed=%llu failed=%llu feedback_timeouts=%llu "
+                "reconnects=%llu latency_ms mean=%.2f p50=%.1f p99=%.1f max=%.2f throttle_us mean=%.1f max=%.1f",
+                xid, static_cast<unsigned long long>(stats.frames_sent),
+                static_cast<unsigned long long>(stats.frames_displayed),
+                static_cast<unsigned long long>(stats.frames_failed),
+                static_cast<unsigned long long>(stats.feedback_timeouts),
+                static_cast<unsigned long long>(stats.reconnects), latency_mean_ms,
+                mali_wrapper::MetricsHistogramPercentileMs(stats.latency_histogram,
+                                                           mali_wrapper::kMetricsBridgeLatencyBuckets,
+                                                           mali_wrapper::kMetricsBridgeLatencyBucketUs, 0.50),
+                mali_wrapper::MetricsHistogramPercentileMs(stats.latency_histogram,
+                                                           mali_wrapper::kMetricsBridgeLatencyBuckets,
+                                                           mali_wrapper::kMetricsBridgeLatencyBucketUs, 0.99),
+                static_cast<double>(stats.latency_max_ns) / 1e6, throttle_mean_us,
+                static_cast<double>(stats.throttle_max_ns) / 1e3);
+}
+
 bool xwayland_dmabuf_bridge_client::ensure_connected()
 {
    if (!is_enabled())
@@ -236,7 +486,17 @@ bool xwayland_dmabuf_bridge_client::ensure_connected()
 
    if (m_socket_fd >= 0)
    {
-      return true;
+      bool reader_lost = false;
+      {
+         std::lock_guard<std::mutex> lock(m_frames_mutex);
+         reader_lost = m_feedback_sync_available && !m_reader_running;
+      }
+      if (!reader_lost)
+      {
+         return true;
+      }
+      /* The reader only stops on its own when the socket failed; reconnect. */
+      reset_connection();
    }
 
    if (m_connect_failed)
@@ -281,8 +541,14 @@ bool xwayland_dmabuf_bridge_client::ensure_connected()
    m_connect_failed = false;
    m_feedback_probe_done = false;
    m_feedback_sync_available = false;
+   m_buffer_registration_available = false;
+   m_acquire_fence_available = false;
    WSI_LOG_INFO("Connected to Xwayland dmabuf bridge at %s", m_socket_path.c_str());
-   (void) probe_feedback_support();
+   if (probe_feedback_support() && !start_feedback_reader())
+   {
+      WSI_LOG_WARNING("Xwayland bridge: cannot start the feedback reader, using fallback pacing");
+      m_feedback_sync_available = false;
+   }
    return true;
 }
 
@@ -314,12 +580,24 @@ bool xwayland_dmabuf_bridge_client::probe_feedback_support()
       return false;
    }
 
+   m_acquire_fence_available = (feedback_flags & XWL_DMABUF_BRIDGE_FEEDBACK_CAP_ACQUIRE_FENCE) != 0;
+   if (m_acquire_fence_available && m_acquire_fence_enabled)
+   {
+      WSI_LOG_INFO("Xwayland bridge: server waits for acquire fences, frames are sent before rendering finishes");
+   }
+
    if (feedback_flags & XWL_DMABUF_BRIDGE_FEEDBACK_CAP_SYNC)
    {
       m_feedback_sync_available = true;
+      m_buffer_registration_available = (feedback_flags & XWL_DMABUF_BRIDGE_FEEDBACK_CAP_BUFFERS) != 0;
+      if (m_buffer_registration_available && m_buffer_registration_enabled)
+      {
+         WSI_LOG_INFO("Xwayland bridge: server keeps registered buffers, fds are sent once per image");
+      }
       if (m_feedback_wait_enabled)
       {
-         WSI_LOG_INFO("Xwayland bridge: sync feedback enabled (blocking ACK wait)");
+         WSI_LOG_INFO("Xwayland bridge: sync feedback enabled (up to %u frame%s in flight)", m_max_frames_in_flight,
+                      m_max_frames_in_flight == 1 ? "" : "s");
       }
       else
       {
@@ -340,6 +618,7 @@ bool xwayland_dmabuf_bridge_client::wait_for_feedback(uint32_t expected_frame_id
       return false;
    }
 
+   mali_wrapper::TraceScope trace_scope(mali_wrapper::TraceEvent::BRIDGE_FEEDBACK_WAIT, expected_frame_id, 0);
    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
 
    while (true)
@@ -397,28 +676,15 @@ bool xwayland_dmabuf_bridge_client::wait_for_feedback(uint32_t expected_frame_id
       }
 
       xwl_dmabuf_bridge_packet packet = {};
-      ssize_t received = recv(m_socket_fd, &packet, sizeof(packet), MSG_DONTWAIT);
-      if (received < 0)
-      {
-         if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
-         {
-            continue;
-         }
-         WSI_LOG_WARNING("Xwayland bridge recv() failed while waiting feedback: %s", strerror(errno));
-         reset_connection();
-         return false;
-      }
-
-      if (received == 0)
+      const receive_result received = receive_packet(&packet, sizeof(packet));
+      if (received == receive_result::closed)
       {
          reset_connection();
          return false;
       }
 
-      if (static_cast<size_t>(received) != sizeof(packet))
+      if (received == receive_result::again)
       {
-         WSI_LOG_WARNING("Xwayland bridge feedback packet size mismatch: expected=%zu got=%zd", sizeof(packet),
-                         received);
          continue;
       }
 
@@ -439,10 +705,277 @@ bool xwayland_dmabuf_bridge_client::wait_for_feedback(uint32_t expected_frame_id
 
       feedback_flags = packet.flags;
       feedback_xid = packet.xid;
+      trace_scope.SetArgs(expected_frame_id, 1);
       return true;
    }
 }
 
+xwayland_dmabuf_bridge_client::receive_result xwayland_dmabuf_bridge_client::receive_packet(void *packet,
+                                                                                        size_t packet_size)
+{
+   ssize_t received = recv(m_socket_fd, packet, packet_size, MSG_DONTWAIT);
+   if (received < 0)
+   {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+         return receive_result::again;
+      }
+      WSI_LOG_WARNING("Xwayland bridge recv() failed while waiting feedback: %s", strerror(errno));
+      return receive_result::closed;
+   }
+
+   if (received == 0)
+   {
+      return receive_result::closed;
+   }
+
+   if (static_cast<size_t>(received) != packet_size)
+   {
+      WSI_LOG_WARNING("Xwayland bridge feedback packet size mismatch: expected=%zu got=%zd", packet_size, received);
+      return receive_result::again;
+   }
+   return receive_result::packet;
+}
+
+bool xwayland_dmabuf_bridge_client::start_feedback_reader()
+{
+   m_reader_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   m_reader_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   if (m_reader_wake_fd < 0 || m_reader_epoll_fd < 0)
+   {
+      stop_feedback_reader();
+      return false;
+   }
+
+   epoll_event socket_event = {};
+   socket_event.events = EPOLLIN;
+   socket_event.data.fd = m_socket_fd;
+   epoll_event wake_event = {};
+   wake_event.events = EPOLLIN;
+   wake_event.data.fd = m_reader_wake_fd;
+   if (epoll_ctl(m_reader_epoll_fd, EPOLL_CTL_ADD, m_socket_fd, &socket_event) != 0 ||
+       epoll_ctl(m_reader_epoll_fd, EPOLL_CTL_ADD, m_reader_wake_fd, &wake_event) != 0)
+   {
+      stop_feedback_reader();
+      return false;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_reader_running = true;
+   }
+   try
+   {
+      m_reader_thread = std::thread(&xwayland_dmabuf_bridge_client::feedback_reader_main, this);
+   }
+   catch (const std::system_error &)
+   {
+      stop_feedback_reader();
+      return false;
+   }
+   return true;
+}
+
+void xwayland_dmabuf_bridge_client::stop_feedback_reader()
+{
+   if (m_reader_thread.joinable())
+   {
+      const uint64_t wake = 1;
+      (void) write(m_reader_wake_fd, &wake, sizeof(wake));
+      m_reader_thread.join();
+   }
+
+   if (m_reader_epoll_fd >= 0)
+   {
+      close(m_reader_epoll_fd);
+      m_reader_epoll_fd = -1;
+   }
+   if (m_reader_wake_fd >= 0)
+   {
+      close(m_reader_wake_fd);
+      m_reader_wake_fd = -1;
+   }
+
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   m_reader_running = false;
+   m_in_flight_frames.clear();
+   m_buffers.clear();
+   m_frames_cond.notify_all();
+}
+
+void xwayland_dmabuf_bridge_client::feedback_reader_main()
+{
+   /* Leave the application's signal handlers to its own threads. */
+   sigset_t blocked;
+   sigfillset(&blocked);
+   sigdelset(&blocked, SIGSEGV);
+   sigdelset(&blocked, SIGBUS);
+   sigdelset(&blocked, SIGFPE);
+   sigdelset(&blocked, SIGILL);
+   pthread_sigmask(SIG_BLOCK, &blocked, nullptr);
+
+   bool closed = false;
+   while (!closed)
+   {
+      epoll_event events[2];
+      const int count = epoll_wait(m_reader_epoll_fd, events, 2, -1);
+      if (count < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         WSI_LOG_WARNING("Xwayland bridge epoll_wait() failed while reading feedback: %s", strerror(errno));
+         break;
+      }
+
+      bool stop = false;
+      bool readable = false;
+      for (int i = 0; i < count; i++)
+      {
+         if (events[i].data.fd == m_reader_wake_fd)
+         {
+            stop = true;
+         }
+         else
+         {
+            readable = true;
+            closed = (events[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+         }
+      }
+      if (stop)
+      {
+         break;
+      }
+
+      /* Drain everything queued, even after a hangup, so the last frames still get their feedback. */
+      while (readable)
+      {
+         xwl_dmabuf_bridge_packet packet = {};
+         const receive_result received = receive_packet(&packet, sizeof(packet));
+         if (received == receive_result::again)
+         {
+            break;
+         }
+         if (received == receive_result::closed)
+         {
+            closed = true;
+            break;
+         }
+
+         if (packet.magic != XWL_DMABUF_BRIDGE_MAGIC || packet.version != XWL_DMABUF_BRIDGE_VERSION ||
+             packet.opcode != XWL_DMABUF_BRIDGE_OP_FEEDBACK || packet.reserved == XWL_DMABUF_BRIDGE_HELLO_FRAME_ID)
+         {
+            continue;
+         }
+
+         if (packet.flags & XWL_DMABUF_BRIDGE_FEEDBACK_BUFFER)
+         {
+            handle_buffer_feedback(packet.reserved, packet.flags);
+         }
+         else
+         {
+            uint64_t frame_time_ns = 0;
+            if (packet.flags & XWL_DMABUF_BRIDGE_FEEDBACK_FRAME_TIME)
+            {
+               frame_time_ns = (static_cast<uint64_t>(packet.planes[0].modifier_hi) << 32) |
+                               packet.planes[0].modifier_lo;
+            }
+            else
+            {
+               frame_time_ns = monotonic_now_ns();
+            }
+            handle_feedback(packet.reserved, packet.flags, packet.xid, frame_time_ns);
+         }
+      }
+
+      if (closed)
+      {
+         WSI_LOG_WARNING("Xwayland bridge feedback channel closed");
+      }
+   }
+
+   std::lock_guard<std::mutex> lock(m_frames_mutex);
+   m_reader_running = false;
+   m_frames_cond.notify_all();
+}
+
+void xwayland_dmabuf_bridge_client::handle_feedback(uint32_t frame_id, uint32_t flags, uint32_t xid,
+                                                    uint64_t frame_time_ns)
+{
+   const bool displayed = (flags & XWL_DMABUF_BRIDGE_FEEDBACK_FAILED) == 0;
+   const uint64_t now_ns = monotonic_now_ns();
+   feedback_callback callback;
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      /* The server handles frames in order, so every frame up to this one is done. */
+      for (auto it = m_in_flight_frames.begin(); it != m_in_flight_frames.end(); ++it)
+      {
+         if (it->frame_id == frame_id)
+         {
+            const uint64_t latency_ns = now_ns > it->sent_ns ? now_ns - it->sent_ns : 0;
+            const uint64_t bucket = latency_ns / (mali_wrapper::kMetricsBridgeLatencyBucketUs * 1000ull);
+            m_stats.latency_histogram[std::min<uint64_t>(bucket, mali_wrapper::kMetricsBridgeLatencyBuckets - 1)]++;
+            m_stats.latency_total_ns += latency_ns;
+            m_stats.latency_max_ns = std::max(m_stats.latency_max_ns, latency_ns);
+            m_stats.latency_samples++;
+            m_in_flight_frames.erase(m_in_flight_frames.begin(), it + 1);
+            break;
+         }
+      }
+      if (displayed)
+      {
+         m_stats.frames_displayed++;
+      }
+      else
+      {
+         m_stats.frames_failed++;
+      }
+      callback = m_feedback_callback;
+      m_frames_cond.notify_all();
+   }
+
+   if (displayed)
+   {
+      WSI_LOG_DEBUG("Xwayland bridge: feedback received for frame=%u ack_xid=0x%x flags=0x%x", frame_id, xid, flags);
+   }
+   else
+   {
+      WSI_LOG_WARNING("Xwayland bridge: compositor rejected frame via feedback (frame=%u, ack_xid=0x%x)", frame_id,
+                      xid);
+   }
+
+   if (callback)
+   {
+      callback(frame_id, displayed, frame_time_ns);
+   }
+}
+
+void xwayland_dmabuf_bridge_client::handle_buffer_feedback(uint32_t buffer_id, uint32_t flags)
+{
+   const bool imported = (flags & XWL_DMABUF_BRIDGE_FEEDBACK_FAILED) == 0;
+   {
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      const auto it = m_buffers.find(buffer_id);
+      if (it == m_buffers.end())
+      {
+         return;
+      }
+      /* A failed buffer stays listed so it is not registered again; its frames keep passing fds. */
+      it->second = imported ? buffer_state::ready : buffer_state::failed;
+   }
+
+   if (imported)
+   {
+      WSI_LOG_DEBUG("Xwayland bridge: buffer=%u registered", buffer_id);
+   }
+   else
+   {
+      WSI_LOG_WARNING("Xwayland bridge: server could not register buffer=%u, passing its fds with every frame",
+                      buffer_id);
+   }
+}
+
 bool xwayland_dmabuf_bridge_client::send_packet(const void *packet, size_t packet_size, const int *fds, uint32_t num_fds)
 {
    if (!ensure_connected())
@@ -458,10 +991,10 @@ bool xwayland_dmabuf_bridge_client::send_packet(const void *packet, size_t packe
    msg.msg_iov = &iov;
    msg.msg_iovlen = 1;
 
-   char control[CMSG_SPACE(sizeof(int) * XWL_DMABUF_BRIDGE_MAX_PLANES)] = {};
+   char control[CMSG_SPACE(sizeof(int) * XWL_DMABUF_BRIDGE_MAX_FDS)] = {};
    if (fds && num_fds > 0)
    {
-      if (num_fds > XWL_DMABUF_BRIDGE_MAX_PLANES)
+      if (num_fds > XWL_DMABUF_BRIDGE_MAX_FDS)
       {
          return false;
       }
@@ -496,13 +1029,18 @@ bool xwayland_dmabuf_bridge_client::send_packet(const void *packet, size_t packe
 
 void xwayland_dmabuf_bridge_client::reset_connection()
 {
+   stop_feedback_reader();
    if (m_socket_fd >= 0)
    {
       close(m_socket_fd);
       m_socket_fd = -1;
+      std::lock_guard<std::mutex> lock(m_frames_mutex);
+      m_stats.reconnects++;
    }
    m_feedback_probe_done = false;
    m_feedback_sync_available = false;
+   m_buffer_registration_available = false;
+   m_acquire_fence_available = false;
 }
 
 } /* namespace x11 */
@@ -24,9 +24,17 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "core/metrics_page.hpp"
 
 namespace wsi
 {
@@ -46,20 +54,118 @@ public:
 
    bool is_enabled() const;
 
+   /**
+    * @brief Called from the feedback reader thread for every frame the server acknowledges.
+    *
+    * @p frame_id is the acknowledged frame, @p displayed is false if the compositor rejected it. Frames sent before
+    * it that got no feedback of their own are done with as well. @p frame_time_ns is the CLOCK_MONOTONIC time of the
+    * compositor frame callback when the server reports it, otherwise the time the feedback arrived.
+    */
+   using feedback_callback = std::function<void(uint32_t frame_id, bool displayed, uint64_t frame_time_ns)>;
+   void set_feedback_callback(feedback_callback callback);
+
+   /**
+    * @brief Send a frame to the bridge.
+    *
+    * With XWL_DMABUF_BRIDGE_WAIT_FOR_FEEDBACK, first waits until fewer than XWL_DMABUF_BRIDGE_MAX_FRAMES_IN_FLIGHT
+    * frames are unacknowledged.
+    *
+    * @param[out] frame_id Id the frame's feedback will carry. May be nullptr.
+    * @param[in,out] buffer_id Registration of this dmabuf with the server, 0 if it has none yet. When the server
+    *                supports it, the first frame registers the buffer and later frames only send its id instead of
+    *                passing the fds again. May be nullptr to always pass the fds.
+    * @param acquire_fence_fd sync_file that signals when rendering into the buffer is done, or -1 if it already is.
+    *                         Only pass one when is_acquire_fence_supported(); it is not closed.
+    */
    bool present_frame(uint32_t xid, uint32_t width, uint32_t height, uint32_t fourcc, uint64_t modifier,
-                      uint32_t num_planes, const uint32_t *offsets, const int *strides, const int *plane_fds);
+                      uint32_t num_planes, const uint32_t *offsets, const int *strides, const int *plane_fds,
+                      uint32_t *frame_id = nullptr, uint32_t *buffer_id = nullptr, int acquire_fence_fd = -1);
+
+   /**
+    * @brief Drop a registration made by present_frame() before the dmabuf is freed.
+    */
+   void unregister_buffer(uint32_t buffer_id);
 
    void stop_stream(uint32_t xid);
    bool is_feedback_sync_enabled() const;
 
+   /**
+    * @brief Whether frames get feedback, so their buffers can be released on it rather than after a fixed lag.
+    */
+   bool is_feedback_available();
+
+   /**
+    * @brief Whether the server waits for a frame's acquire fence, so frames can be sent before rendering finishes.
+    *
+    * Only known once connected, which the first present_frame() does.
+    */
+   bool is_acquire_fence_supported() const;
+
+   /**
+    * @brief Statistics since the client was created: latency from submit to feedback, failures, feedback
+    * timeouts, reconnects and time spent in bridge pacing.
+    */
+   mali_wrapper::MetricsBridgeStats get_stats();
+
+   /**
+    * @brief Account time the present thread slept pacing bridge frames.
+    */
+   void record_throttle(uint64_t throttle_ns);
+
 private:
+   /** Result of reading one packet from the socket. */
+   enum class receive_result
+   {
+      packet,
+      again,
+      closed,
+   };
+
+   struct in_flight_frame
+   {
+      uint32_t frame_id;
+      uint32_t xid;
+      /** CLOCK_MONOTONIC time the frame was sent. */
+      uint64_t sent_ns;
+   };
+
+   /** State of a buffer registration on the current connection. */
+   enum class buffer_state
+   {
+      pending,
+      ready,
+      failed,
+   };
+
    bool ensure_connected();
    bool probe_feedback_support();
    bool wait_for_feedback(uint32_t expected_frame_id, uint32_t timeout_ms, uint32_t &feedback_flags,
                           uint32_t &feedback_xid);
+
+   /**
+    * @brief Wait until a frame may be sent without exceeding the in-flight limit.
+    *
+    * @return false on timeout or when the reader stopped.
+    */
+   bool wait_for_in_flight_slot();
+
+   /**
+    * @brief Send OP_REGISTER_BUFFER for the dmabuf in @p packet, which must be a filled OP_FRAME packet.
+    *
+    * @return The new registration id, or 0 if the packet could not be sent.
+    */
+   uint32_t register_buffer(const void *packet, size_t packet_size, const int *plane_fds, uint32_t num_planes);
+   receive_result receive_packet(void *packet, size_t packet_size);
    bool send_packet(const void *packet, size_t packet_size, const int *fds, uint32_t num_fds);
    void reset_connection();
 
+   bool start_feedback_reader();
+   void stop_feedback_reader();
+   void feedback_reader_main();
+   void handle_feedback(uint32_t frame_id, uint32_t flags, uint32_t xid, uint64_t frame_time_ns);
+   void handle_buffer_feedback(uint32_t buffer_id, uint32_t flags);
+   void log_stats(uint32_t xid);
+
    std::string m_socket_path;
    int m_socket_fd = -1;
    bool m_connect_failed = false;
@@ -67,7 +173,29 @@ private:
    bool m_feedback_sync_available = false;
    bool m_feedback_wait_enabled = false;
    uint32_t m_feedback_timeout_ms = 250;
+   uint32_t m_max_frames_in_flight = 2;
    uint32_t m_next_frame_id = 1;
+   bool m_buffer_registration_enabled = true;
+   bool m_buffer_registration_available = false;
+   bool m_acquire_fence_enabled = true;
+   bool m_acquire_fence_available = false;
+   uint32_t m_next_buffer_id = 1;
+
+   /** Feedback reader: epoll on the socket and on m_reader_wake_fd, which stop_feedback_reader() signals. */
+   std::thread m_reader_thread;
+   int m_reader_epoll_fd = -1;
+   int m_reader_wake_fd = -1;
+
+   /** Protects the members below, which the reader updates. */
+   std::mutex m_frames_mutex;
+   std::condition_variable m_frames_cond;
+   /** Frames sent and not yet acknowledged, oldest first. */
+   std::deque<in_flight_frame> m_in_flight_frames;
+   /** Buffers registered on this connection; cleared when it is reset, as the server drops them with it. */
+   std::unordered_map<uint32_t, buffer_state> m_buffers;
+   bool m_reader_running = false;
+   feedback_callback m_feedback_callback;
+   mali_wrapper::MetricsBridgeStats m_stats = {};
 };
 
 } /* namespace x11 */